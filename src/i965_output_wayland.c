@@ -233,7 +233,7 @@ va_GetSurfaceBufferWl(
     if (!ensure_wl_output(ctx))
         return VA_STATUS_ERROR_INVALID_DISPLAY;
 
-    if (drm_intel_bo_flink(obj_surface->bo, &name) != 0)
+    if (media_bo_flink(obj_surface->bo, &name) != 0)
         return VA_STATUS_ERROR_INVALID_SURFACE;
 
     switch (obj_surface->fourcc) {
@@ -53,11 +53,11 @@ media_batchbuffer_reset (MEDIA_BATCH_BUFFER * batch, INT buffer_size)
 		    batch->flag == I915_EXEC_BSD ||
 		    batch->flag == I915_EXEC_VEBOX);
 
-  dri_bo_unreference (batch->buffer);
-  batch->buffer = dri_bo_alloc (drv_data->bufmgr,
-				"batch buffer", batch_size, 0x1000);
+  media_bo_unreference (batch->buffer);
+  batch->buffer = media_bo_alloc (drv_data->bufmgr,
+				  "batch buffer", batch_size, 0x1000);
   MEDIA_DRV_ASSERT (batch->buffer);
-  dri_bo_map (batch->buffer, 1);
+  media_bo_map (batch->buffer, 1);
   MEDIA_DRV_ASSERT (batch->buffer->virtual);
   batch->map = batch->buffer->virtual;
   batch->size = batch_size;
@@ -80,9 +80,9 @@ media_batchbuffer_submit (MEDIA_BATCH_BUFFER * batch)
 
   *(UINT *) batch->cmd_ptr = MI_BATCH_BUFFER_END;
   batch->cmd_ptr += 4;
-  dri_bo_unmap (batch->buffer);
+  media_bo_unmap (batch->buffer);
   used = batch->cmd_ptr - batch->map;
-  drm_intel_bo_mrb_exec (batch->buffer, used, 0, 0, 0, batch->flag);
+  media_bo_exec (batch->buffer, used, batch->flag);
   media_batchbuffer_free (batch);
 }
 
@@ -102,9 +102,9 @@ media_batchbuffer_flush (MEDIA_BATCH_BUFFER * batch)
 
   *(UINT *) batch->cmd_ptr = MI_BATCH_BUFFER_END;
   batch->cmd_ptr += 4;
-  dri_bo_unmap (batch->buffer);
+  media_bo_unmap (batch->buffer);
   used = batch->cmd_ptr - batch->map;
-  drm_intel_bo_mrb_exec (batch->buffer, used, 0, 0, 0, batch->flag);
+  media_bo_exec (batch->buffer, used, batch->flag);
   media_batchbuffer_reset (batch, batch->size);
 }
 
@@ -160,10 +160,39 @@ media_batchbuffer_emit_reloc (MEDIA_BATCH_BUFFER * batch, dri_bo * bo,
 			      UINT delta)
 {
   assert (batch->cmd_ptr - batch->map < batch->size);
-  dri_bo_emit_reloc (batch->buffer,/* I915_GEM_DOMAIN_RENDER*/ read_domains, write_domains,delta, batch->cmd_ptr - batch->map, bo);
+  media_bo_emit_reloc (batch->buffer,/* I915_GEM_DOMAIN_RENDER*/ read_domains, write_domains,delta, batch->cmd_ptr - batch->map, bo);
   media_batchbuffer_emit_dword (batch, bo->offset + delta);
 }
 
+UINT *
+media_batchbuffer_reserve (MEDIA_BATCH_BUFFER * batch, UINT dwords, INT flag)
+{
+  MEDIA_DRV_ASSERT (flag == batch->flag);
+  media_batchbuffer_require_space (batch, dwords * 4);
+  media_batchbuffer_begin (batch, dwords);
+  return (UINT *) batch->cmd_ptr;
+}
+
+VOID
+media_batchbuffer_commit (MEDIA_BATCH_BUFFER * batch, UINT * end)
+{
+  batch->cmd_ptr = (BYTE *) end;
+  media_batchbuffer_advance (batch);
+}
+
+/* dw points into the space returned by media_batchbuffer_reserve */
+VOID
+media_batchbuffer_reloc (MEDIA_BATCH_BUFFER * batch, UINT * dw, dri_bo * bo,
+			 UINT read_domains, UINT write_domains, UINT delta)
+{
+  UINT offset = (BYTE *) dw - batch->map;
+
+  MEDIA_DRV_ASSERT (offset < batch->size);
+  media_bo_emit_reloc (batch->buffer, read_domains, write_domains, delta,
+		       offset, bo);
+  *dw = bo->offset + delta;
+}
+
 MEDIA_BATCH_BUFFER *
 media_batchbuffer_new (struct media_driver_data * drv_data, INT flag,
 		       INT buffer_size)
@@ -193,11 +222,11 @@ media_batchbuffer_free (MEDIA_BATCH_BUFFER * batch)
 {
   if (batch->map)
     {
-      dri_bo_unmap (batch->buffer);
+      media_bo_unmap (batch->buffer);
       batch->map = NULL;
     }
 
-  dri_bo_unreference (batch->buffer);
+  media_bo_unreference (batch->buffer);
   media_drv_free_memory (batch);
 }
 
@@ -205,7 +234,7 @@ BOOL
 media_allocate_resource (MEDIA_RESOURCE * res, dri_bufmgr * bufmgr,
 			 const BYTE * name, UINT size, UINT align)
 {
-  res->bo = dri_bo_alloc (bufmgr,(const CHAR *) name, size, align);
+  res->bo = media_bo_alloc (bufmgr,(const CHAR *) name, size, align);
   res->bo_size = size;
   return SUCCESS;
 }
@@ -214,7 +243,7 @@ BOOL
 media_allocate_resource_ext (MEDIA_RESOURCE * res, dri_bufmgr * bufmgr,
 			     MEDIA_ALLOC_PARAMS * params, UINT align)
 {
-  res->bo = dri_bo_alloc (bufmgr,(const CHAR *) params->buf_name, params->bo_size, align);
+  res->bo = media_bo_alloc (bufmgr,(const CHAR *) params->buf_name, params->bo_size, align);
   res->bo_size = params->bo_size;
   res->width = params->width;
   res->height = params->height;
@@ -226,7 +255,7 @@ media_allocate_resource_ext (MEDIA_RESOURCE * res, dri_bufmgr * bufmgr,
 VOID *
 media_map_buffer_obj (dri_bo * bo)
 {
-  dri_bo_map (bo, 1);
+  media_bo_map (bo, 1);
   MEDIA_DRV_ASSERT (bo->virtual);
   return bo->virtual;
 }
@@ -234,7 +263,7 @@ media_map_buffer_obj (dri_bo * bo)
 BOOL
 media_unmap_buffer_obj (dri_bo * bo)
 {
-  dri_bo_unmap (bo);
+  media_bo_unmap (bo);
   return SUCCESS;
 }
 
@@ -69,6 +69,18 @@ media_batchbuffer_emit_reloc (MEDIA_BATCH_BUFFER * batch, dri_bo * bo,
 			      UINT delta);
 
 VOID media_batchbuffer_check_flag (MEDIA_BATCH_BUFFER * batch, INT flag);
+
+/*
+ * Bulk emission: the space for a whole command is checked once, the
+ * dwords are written through the returned pointer (or copied from a
+ * prebuilt template) and media_batchbuffer_commit advances the batch.
+ */
+UINT *media_batchbuffer_reserve (MEDIA_BATCH_BUFFER * batch, UINT dwords,
+				 INT flag);
+VOID media_batchbuffer_commit (MEDIA_BATCH_BUFFER * batch, UINT * end);
+VOID media_batchbuffer_reloc (MEDIA_BATCH_BUFFER * batch, UINT * dw,
+			      dri_bo * bo, UINT read_domains,
+			      UINT write_domains, UINT delta);
 #define __OUT_BATCH(batch, d) do {              \
        media_batchbuffer_emit_dword(batch, d); \
     } while (0)
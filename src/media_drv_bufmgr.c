@@ -0,0 +1,224 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "media_drv_bufmgr.h"
+
+static int
+media_bufmgr_gem_exec (dri_bo * bo, int used, unsigned int flags)
+{
+  return drm_intel_bo_mrb_exec (bo, used, NULL, 0, 0, flags);
+}
+
+static const MEDIA_BUFMGR_OPS media_bufmgr_gem_ops = {
+  drm_intel_bo_alloc,
+  drm_intel_bo_alloc_tiled,
+  drm_intel_bo_gem_create_from_name,
+  drm_intel_bo_gem_create_from_prime,
+  drm_intel_bo_reference,
+  drm_intel_bo_unreference,
+  drm_intel_bo_map,
+  drm_intel_bo_unmap,
+  drm_intel_gem_bo_map_gtt,
+  drm_intel_gem_bo_unmap_gtt,
+  drm_intel_bo_subdata,
+  drm_intel_bo_emit_reloc,
+  drm_intel_bo_get_tiling,
+  media_bufmgr_gem_exec,
+  drm_intel_bo_wait_rendering,
+  drm_intel_bo_busy,
+  drm_intel_bo_flink,
+  drm_intel_bo_gem_export_to_prime,
+  drm_intel_bo_disable_reuse,
+  drm_intel_bo_is_reusable,
+  drm_intel_bufmgr_destroy,
+};
+
+/* one backend per process, like the debug flags */
+static const MEDIA_BUFMGR_OPS *bufmgr_ops = &media_bufmgr_gem_ops;
+
+int
+media_bufmgr_is_mock (void)
+{
+  const char *env = getenv (MEDIA_BUFMGR_ENV);
+
+  return env && !strcmp (env, MEDIA_BUFMGR_MOCK);
+}
+
+dri_bufmgr *
+media_bufmgr_create (int fd, int batch_size)
+{
+  dri_bufmgr *bufmgr;
+
+  if (media_bufmgr_is_mock ())
+    {
+      bufmgr_ops = &media_bufmgr_mock_ops;
+      return media_bufmgr_mock_init (batch_size);
+    }
+  bufmgr_ops = &media_bufmgr_gem_ops;
+  bufmgr = intel_bufmgr_gem_init (fd, batch_size);
+  if (bufmgr)
+    intel_bufmgr_gem_enable_reuse (bufmgr);
+  return bufmgr;
+}
+
+void
+media_bufmgr_destroy (dri_bufmgr * bufmgr)
+{
+  if (bufmgr)
+    bufmgr_ops->bufmgr_destroy (bufmgr);
+}
+
+dri_bo *
+media_bo_alloc (dri_bufmgr * bufmgr, const char *name, unsigned long size,
+		unsigned int alignment)
+{
+  return bufmgr_ops->bo_alloc (bufmgr, name, size, alignment);
+}
+
+dri_bo *
+media_bo_alloc_tiled (dri_bufmgr * bufmgr, const char *name, int x, int y,
+		      int cpp, uint32_t * tiling_mode, unsigned long *pitch,
+		      unsigned long flags)
+{
+  return bufmgr_ops->bo_alloc_tiled (bufmgr, name, x, y, cpp, tiling_mode,
+				     pitch, flags);
+}
+
+dri_bo *
+media_bo_create_from_name (dri_bufmgr * bufmgr, const char *name,
+			   unsigned int handle)
+{
+  return bufmgr_ops->bo_create_from_name (bufmgr, name, handle);
+}
+
+dri_bo *
+media_bo_create_from_prime (dri_bufmgr * bufmgr, int prime_fd, int size)
+{
+  return bufmgr_ops->bo_create_from_prime (bufmgr, prime_fd, size);
+}
+
+void
+media_bo_reference (dri_bo * bo)
+{
+  bufmgr_ops->bo_reference (bo);
+}
+
+void
+media_bo_unreference (dri_bo * bo)
+{
+  if (bo)
+    bufmgr_ops->bo_unreference (bo);
+}
+
+int
+media_bo_map (dri_bo * bo, int write_enable)
+{
+  return bufmgr_ops->bo_map (bo, write_enable);
+}
+
+int
+media_bo_unmap (dri_bo * bo)
+{
+  return bufmgr_ops->bo_unmap (bo);
+}
+
+int
+media_bo_map_gtt (dri_bo * bo)
+{
+  return bufmgr_ops->bo_map_gtt (bo);
+}
+
+int
+media_bo_unmap_gtt (dri_bo * bo)
+{
+  return bufmgr_ops->bo_unmap_gtt (bo);
+}
+
+int
+media_bo_subdata (dri_bo * bo, unsigned long offset, unsigned long size,
+		  const void *data)
+{
+  return bufmgr_ops->bo_subdata (bo, offset, size, data);
+}
+
+int
+media_bo_emit_reloc (dri_bo * bo, uint32_t read_domains,
+		     uint32_t write_domain, uint32_t target_offset,
+		     uint32_t offset, dri_bo * target_bo)
+{
+  return bufmgr_ops->bo_emit_reloc (bo, offset, target_bo, target_offset,
+				    read_domains, write_domain);
+}
+
+int
+media_bo_get_tiling (dri_bo * bo, uint32_t * tiling_mode,
+		     uint32_t * swizzle_mode)
+{
+  return bufmgr_ops->bo_get_tiling (bo, tiling_mode, swizzle_mode);
+}
+
+int
+media_bo_exec (dri_bo * bo, int used, unsigned int flags)
+{
+  return bufmgr_ops->bo_exec (bo, used, flags);
+}
+
+void
+media_bo_wait_rendering (dri_bo * bo)
+{
+  bufmgr_ops->bo_wait_rendering (bo);
+}
+
+int
+media_bo_busy (dri_bo * bo)
+{
+  return bufmgr_ops->bo_busy (bo);
+}
+
+int
+media_bo_flink (dri_bo * bo, uint32_t * name)
+{
+  return bufmgr_ops->bo_flink (bo, name);
+}
+
+int
+media_bo_export_to_prime (dri_bo * bo, int *prime_fd)
+{
+  return bufmgr_ops->bo_export_to_prime (bo, prime_fd);
+}
+
+int
+media_bo_disable_reuse (dri_bo * bo)
+{
+  return bufmgr_ops->bo_disable_reuse (bo);
+}
+
+int
+media_bo_is_reusable (dri_bo * bo)
+{
+  return bufmgr_ops->bo_is_reusable (bo);
+}
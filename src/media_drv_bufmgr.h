@@ -0,0 +1,155 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _MEDIA__DRIVER_BUFMGR_H
+#define _MEDIA__DRIVER_BUFMGR_H
+#include <stdint.h>
+#include <intel_bufmgr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* VA_INTEL_HYBRID_BUFMGR=mock keeps every buffer in system memory */
+#define MEDIA_BUFMGR_ENV		"VA_INTEL_HYBRID_BUFMGR"
+#define MEDIA_BUFMGR_MOCK		"mock"
+/* device id the mock reports, Haswell GT2 if unset */
+#define MEDIA_BUFMGR_MOCK_DEVID_ENV	"VA_INTEL_HYBRID_MOCK_DEVID"
+/* set by programs that bring a CM runtime of their own working on the mock */
+#define MEDIA_BUFMGR_MOCK_CMRT_ENV	"VA_INTEL_HYBRID_MOCK_CMRT"
+
+/*
+ * Buffer object backend. The driver only talks to buffer objects through
+ * the media_bo_* calls below, which forward to the backend selected when
+ * the buffer manager is created: libdrm GEM or the CPU mock.
+ */
+typedef struct _media_bufmgr_ops
+{
+  dri_bo *(*bo_alloc) (dri_bufmgr * bufmgr, const char *name,
+		       unsigned long size, unsigned int alignment);
+  dri_bo *(*bo_alloc_tiled) (dri_bufmgr * bufmgr, const char *name,
+			     int x, int y, int cpp, uint32_t * tiling_mode,
+			     unsigned long *pitch, unsigned long flags);
+  dri_bo *(*bo_create_from_name) (dri_bufmgr * bufmgr, const char *name,
+				  unsigned int handle);
+  dri_bo *(*bo_create_from_prime) (dri_bufmgr * bufmgr, int prime_fd,
+				   int size);
+  void (*bo_reference) (dri_bo * bo);
+  void (*bo_unreference) (dri_bo * bo);
+  int (*bo_map) (dri_bo * bo, int write_enable);
+  int (*bo_unmap) (dri_bo * bo);
+  int (*bo_map_gtt) (dri_bo * bo);
+  int (*bo_unmap_gtt) (dri_bo * bo);
+  int (*bo_subdata) (dri_bo * bo, unsigned long offset, unsigned long size,
+		     const void *data);
+  int (*bo_emit_reloc) (dri_bo * bo, uint32_t offset, dri_bo * target_bo,
+			uint32_t target_offset, uint32_t read_domains,
+			uint32_t write_domain);
+  int (*bo_get_tiling) (dri_bo * bo, uint32_t * tiling_mode,
+			uint32_t * swizzle_mode);
+  int (*bo_exec) (dri_bo * bo, int used, unsigned int flags);
+  void (*bo_wait_rendering) (dri_bo * bo);
+  int (*bo_busy) (dri_bo * bo);
+  int (*bo_flink) (dri_bo * bo, uint32_t * name);
+  int (*bo_export_to_prime) (dri_bo * bo, int *prime_fd);
+  int (*bo_disable_reuse) (dri_bo * bo);
+  int (*bo_is_reusable) (dri_bo * bo);
+  void (*bufmgr_destroy) (dri_bufmgr * bufmgr);
+} MEDIA_BUFMGR_OPS;
+
+dri_bufmgr *media_bufmgr_create (int fd, int batch_size);
+int media_bufmgr_is_mock (void);
+void media_bufmgr_destroy (dri_bufmgr * bufmgr);
+
+dri_bo *media_bo_alloc (dri_bufmgr * bufmgr, const char *name,
+			unsigned long size, unsigned int alignment);
+dri_bo *media_bo_alloc_tiled (dri_bufmgr * bufmgr, const char *name,
+			      int x, int y, int cpp, uint32_t * tiling_mode,
+			      unsigned long *pitch, unsigned long flags);
+dri_bo *media_bo_create_from_name (dri_bufmgr * bufmgr, const char *name,
+				   unsigned int handle);
+dri_bo *media_bo_create_from_prime (dri_bufmgr * bufmgr, int prime_fd,
+				    int size);
+void media_bo_reference (dri_bo * bo);
+void media_bo_unreference (dri_bo * bo);
+int media_bo_map (dri_bo * bo, int write_enable);
+int media_bo_unmap (dri_bo * bo);
+int media_bo_map_gtt (dri_bo * bo);
+int media_bo_unmap_gtt (dri_bo * bo);
+int media_bo_subdata (dri_bo * bo, unsigned long offset, unsigned long size,
+		      const void *data);
+/* same argument order as the dri_bo_emit_reloc it replaces */
+int media_bo_emit_reloc (dri_bo * bo, uint32_t read_domains,
+			 uint32_t write_domain, uint32_t target_offset,
+			 uint32_t offset, dri_bo * target_bo);
+int media_bo_get_tiling (dri_bo * bo, uint32_t * tiling_mode,
+			 uint32_t * swizzle_mode);
+int media_bo_exec (dri_bo * bo, int used, unsigned int flags);
+void media_bo_wait_rendering (dri_bo * bo);
+int media_bo_busy (dri_bo * bo);
+int media_bo_flink (dri_bo * bo, uint32_t * name);
+int media_bo_export_to_prime (dri_bo * bo, int *prime_fd);
+int media_bo_disable_reuse (dri_bo * bo);
+/* false once the bo was flinked, exported or had reuse disabled */
+int media_bo_is_reusable (dri_bo * bo);
+
+/*
+ * CPU mock. Buffers live in malloc memory, every exec is recorded with a
+ * copy of the batch and its relocations, and all work completes at once.
+ */
+typedef struct _media_mock_reloc
+{
+  uint32_t offset;		/* in the batch */
+  uint32_t target_handle;
+  uint32_t target_offset;	/* delta */
+  uint32_t read_domains;
+  uint32_t write_domain;
+} MEDIA_MOCK_RELOC;
+
+typedef struct _media_mock_exec
+{
+  unsigned int ring;
+  unsigned int used;		/* bytes */
+  uint32_t *cmds;
+  unsigned int num_relocs;
+  MEDIA_MOCK_RELOC *relocs;
+} MEDIA_MOCK_EXEC;
+
+extern const MEDIA_BUFMGR_OPS media_bufmgr_mock_ops;
+dri_bufmgr *media_bufmgr_mock_init (int batch_size);
+__attribute__ ((visibility ("default")))
+unsigned int media_bufmgr_mock_num_execs (dri_bufmgr * bufmgr);
+__attribute__ ((visibility ("default")))
+const MEDIA_MOCK_EXEC *media_bufmgr_mock_get_exec (dri_bufmgr * bufmgr,
+						   unsigned int index);
+__attribute__ ((visibility ("default")))
+unsigned int media_bufmgr_mock_num_bos (dri_bufmgr * bufmgr);
+__attribute__ ((visibility ("default")))
+void media_bufmgr_mock_clear_execs (dri_bufmgr * bufmgr);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
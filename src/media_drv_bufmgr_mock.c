@@ -0,0 +1,475 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <i915_drm.h>
+#include "media_drv_bufmgr.h"
+
+/* fake GPU addresses stay below 4G so gen7 relocations fit in a dword */
+#define MOCK_GTT_START	0x00010000ULL
+#define MOCK_GTT_END	0xF0000000ULL
+#define MOCK_PAGE_SIZE	4096
+#define MOCK_ALIGN(x, a)	(((x) + (a) - 1) & ~((unsigned long) (a) - 1))
+
+typedef struct _media_mock_bufmgr MEDIA_MOCK_BUFMGR;
+
+typedef struct _media_mock_bo
+{
+  dri_bo base;			/* first, the driver only sees this */
+  MEDIA_MOCK_BUFMGR *mgr;
+  int refcount;
+  int reusable;
+  void *mem;
+  uint32_t tiling;
+  MEDIA_MOCK_RELOC *relocs;
+  dri_bo **targets;		/* referenced until the bo goes away */
+  unsigned int num_relocs;
+  unsigned int max_relocs;
+  struct _media_mock_bo *prev;
+  struct _media_mock_bo *next;
+} MEDIA_MOCK_BO;
+
+struct _media_mock_bufmgr
+{
+  pthread_mutex_t mutex;
+  int batch_size;
+  uint32_t next_handle;
+  uint64_t next_offset;
+  MEDIA_MOCK_BO *bos;
+  unsigned int num_bos;
+  MEDIA_MOCK_EXEC *execs;
+  unsigned int num_execs;
+  unsigned int max_execs;
+};
+
+static dri_bo *
+mock_bo_alloc (dri_bufmgr * bufmgr, const char *name, unsigned long size,
+	       unsigned int alignment)
+{
+  MEDIA_MOCK_BUFMGR *mgr = (MEDIA_MOCK_BUFMGR *) bufmgr;
+  MEDIA_MOCK_BO *bo;
+
+  (void) name;
+  if (alignment < MOCK_PAGE_SIZE)
+    alignment = MOCK_PAGE_SIZE;
+  /* GEM hands out whole pages and reports the rounded size, code that
+   * writes past the size it asked for relies on that */
+  size = MOCK_ALIGN (size ? size : 1, MOCK_PAGE_SIZE);
+  bo = calloc (1, sizeof (*bo));
+  if (bo == NULL)
+    return NULL;
+  bo->mem = calloc (1, size);
+  if (bo->mem == NULL)
+    {
+      free (bo);
+      return NULL;
+    }
+  bo->mgr = mgr;
+  bo->refcount = 1;
+  bo->reusable = 1;
+  bo->tiling = I915_TILING_NONE;
+  bo->base.size = size;
+  bo->base.align = alignment;
+  bo->base.bufmgr = bufmgr;
+
+  pthread_mutex_lock (&mgr->mutex);
+  bo->base.handle = mgr->next_handle++;
+  mgr->next_offset = MOCK_ALIGN (mgr->next_offset, alignment);
+  if (mgr->next_offset + size > MOCK_GTT_END)
+    mgr->next_offset = MOCK_GTT_START;
+  bo->base.offset = mgr->next_offset;
+  bo->base.offset64 = mgr->next_offset;
+  mgr->next_offset += size;
+  bo->next = mgr->bos;
+  if (mgr->bos)
+    mgr->bos->prev = bo;
+  mgr->bos = bo;
+  mgr->num_bos++;
+  pthread_mutex_unlock (&mgr->mutex);
+
+  return &bo->base;
+}
+
+static dri_bo *
+mock_bo_alloc_tiled (dri_bufmgr * bufmgr, const char *name, int x, int y,
+		     int cpp, uint32_t * tiling_mode, unsigned long *pitch,
+		     unsigned long flags)
+{
+  MEDIA_MOCK_BO *bo;
+  unsigned long stride = (unsigned long) x * cpp;
+  int height = y;
+
+  (void) flags;
+  switch (*tiling_mode)
+    {
+    case I915_TILING_X:
+      stride = MOCK_ALIGN (stride, 512);
+      height = MOCK_ALIGN (y, 8);
+      break;
+    case I915_TILING_Y:
+      stride = MOCK_ALIGN (stride, 128);
+      height = MOCK_ALIGN (y, 32);
+      break;
+    default:
+      stride = MOCK_ALIGN (stride, 64);
+      break;
+    }
+  bo = (MEDIA_MOCK_BO *) mock_bo_alloc (bufmgr, name, stride * height,
+					MOCK_PAGE_SIZE);
+  if (bo == NULL)
+    return NULL;
+  bo->tiling = *tiling_mode;
+  *pitch = stride;
+  return &bo->base;
+}
+
+static void
+mock_bo_reference (dri_bo * base)
+{
+  MEDIA_MOCK_BO *bo = (MEDIA_MOCK_BO *) base;
+
+  pthread_mutex_lock (&bo->mgr->mutex);
+  bo->refcount++;
+  pthread_mutex_unlock (&bo->mgr->mutex);
+}
+
+static void
+mock_bo_unreference (dri_bo * base)
+{
+  MEDIA_MOCK_BO *bo = (MEDIA_MOCK_BO *) base;
+  MEDIA_MOCK_BUFMGR *mgr = bo->mgr;
+  unsigned int i;
+
+  pthread_mutex_lock (&mgr->mutex);
+  if (--bo->refcount > 0)
+    {
+      pthread_mutex_unlock (&mgr->mutex);
+      return;
+    }
+  if (bo->prev)
+    bo->prev->next = bo->next;
+  else
+    mgr->bos = bo->next;
+  if (bo->next)
+    bo->next->prev = bo->prev;
+  mgr->num_bos--;
+  pthread_mutex_unlock (&mgr->mutex);
+
+  for (i = 0; i < bo->num_relocs; i++)
+    mock_bo_unreference (bo->targets[i]);
+  free (bo->relocs);
+  free (bo->targets);
+  free (bo->mem);
+  free (bo);
+}
+
+static dri_bo *
+mock_bo_create_from_name (dri_bufmgr * bufmgr, const char *name,
+			  unsigned int handle)
+{
+  MEDIA_MOCK_BUFMGR *mgr = (MEDIA_MOCK_BUFMGR *) bufmgr;
+  MEDIA_MOCK_BO *bo;
+
+  (void) name;
+  pthread_mutex_lock (&mgr->mutex);
+  for (bo = mgr->bos; bo; bo = bo->next)
+    if ((unsigned int) bo->base.handle == handle)
+      {
+	bo->refcount++;
+	break;
+      }
+  pthread_mutex_unlock (&mgr->mutex);
+  return bo ? &bo->base : NULL;
+}
+
+static dri_bo *
+mock_bo_create_from_prime (dri_bufmgr * bufmgr, int prime_fd, int size)
+{
+  (void) bufmgr;
+  (void) prime_fd;
+  (void) size;
+  return NULL;
+}
+
+static int
+mock_bo_map (dri_bo * base, int write_enable)
+{
+  (void) write_enable;
+  base->virtual = ((MEDIA_MOCK_BO *) base)->mem;
+  return 0;
+}
+
+static int
+mock_bo_unmap (dri_bo * base)
+{
+  base->virtual = NULL;
+  return 0;
+}
+
+static int
+mock_bo_map_gtt (dri_bo * base)
+{
+  return mock_bo_map (base, 1);
+}
+
+static int
+mock_bo_subdata (dri_bo * base, unsigned long offset, unsigned long size,
+		 const void *data)
+{
+  if (offset + size > base->size)
+    return -EINVAL;
+  memcpy ((char *) ((MEDIA_MOCK_BO *) base)->mem + offset, data, size);
+  return 0;
+}
+
+static int
+mock_bo_emit_reloc (dri_bo * base, uint32_t offset, dri_bo * target_bo,
+		    uint32_t target_offset, uint32_t read_domains,
+		    uint32_t write_domain)
+{
+  MEDIA_MOCK_BO *bo = (MEDIA_MOCK_BO *) base;
+  MEDIA_MOCK_RELOC *reloc;
+
+  if (bo->num_relocs == bo->max_relocs)
+    {
+      unsigned int max = bo->max_relocs ? bo->max_relocs * 2 : 64;
+      MEDIA_MOCK_RELOC *relocs;
+      dri_bo **targets;
+
+      relocs = realloc (bo->relocs, max * sizeof (*relocs));
+      if (relocs == NULL)
+	return -ENOMEM;
+      bo->relocs = relocs;
+      targets = realloc (bo->targets, max * sizeof (*targets));
+      if (targets == NULL)
+	return -ENOMEM;
+      bo->targets = targets;
+      bo->max_relocs = max;
+    }
+  reloc = &bo->relocs[bo->num_relocs];
+  reloc->offset = offset;
+  reloc->target_handle = target_bo->handle;
+  reloc->target_offset = target_offset;
+  reloc->read_domains = read_domains;
+  reloc->write_domain = write_domain;
+  bo->targets[bo->num_relocs++] = target_bo;
+  mock_bo_reference (target_bo);
+  return 0;
+}
+
+static int
+mock_bo_get_tiling (dri_bo * base, uint32_t * tiling_mode,
+		    uint32_t * swizzle_mode)
+{
+  *tiling_mode = ((MEDIA_MOCK_BO *) base)->tiling;
+  *swizzle_mode = I915_BIT_6_SWIZZLE_NONE;
+  return 0;
+}
+
+/* Records the batch and its relocations; the work is done right away. */
+static int
+mock_bo_exec (dri_bo * base, int used, unsigned int flags)
+{
+  MEDIA_MOCK_BO *bo = (MEDIA_MOCK_BO *) base;
+  MEDIA_MOCK_BUFMGR *mgr = bo->mgr;
+  MEDIA_MOCK_EXEC exec;
+
+  if (used < 0 || (unsigned long) used > base->size)
+    return -EINVAL;
+  exec.ring = flags & I915_EXEC_RING_MASK;
+  exec.used = used;
+  exec.num_relocs = bo->num_relocs;
+  exec.cmds = malloc (used ? used : 1);
+  exec.relocs = malloc ((bo->num_relocs ? bo->num_relocs : 1) *
+			sizeof (*exec.relocs));
+  if (exec.cmds == NULL || exec.relocs == NULL)
+    {
+      free (exec.cmds);
+      free (exec.relocs);
+      return -ENOMEM;
+    }
+  memcpy (exec.cmds, bo->mem, used);
+  memcpy (exec.relocs, bo->relocs, bo->num_relocs * sizeof (*exec.relocs));
+
+  pthread_mutex_lock (&mgr->mutex);
+  if (mgr->num_execs == mgr->max_execs)
+    {
+      unsigned int max = mgr->max_execs ? mgr->max_execs * 2 : 256;
+      MEDIA_MOCK_EXEC *execs = realloc (mgr->execs, max * sizeof (*execs));
+
+      if (execs == NULL)
+	{
+	  pthread_mutex_unlock (&mgr->mutex);
+	  free (exec.cmds);
+	  free (exec.relocs);
+	  return -ENOMEM;
+	}
+      mgr->execs = execs;
+      mgr->max_execs = max;
+    }
+  mgr->execs[mgr->num_execs++] = exec;
+  pthread_mutex_unlock (&mgr->mutex);
+  return 0;
+}
+
+static void
+mock_bo_wait_rendering (dri_bo * base)
+{
+  (void) base;
+}
+
+static int
+mock_bo_busy (dri_bo * base)
+{
+  (void) base;
+  return 0;
+}
+
+static int
+mock_bo_flink (dri_bo * base, uint32_t * name)
+{
+  ((MEDIA_MOCK_BO *) base)->reusable = 0;
+  *name = base->handle;
+  return 0;
+}
+
+static int
+mock_bo_export_to_prime (dri_bo * base, int *prime_fd)
+{
+  ((MEDIA_MOCK_BO *) base)->reusable = 0;
+  *prime_fd = -1;
+  return -ENODEV;
+}
+
+static int
+mock_bo_disable_reuse (dri_bo * base)
+{
+  ((MEDIA_MOCK_BO *) base)->reusable = 0;
+  return 0;
+}
+
+static int
+mock_bo_is_reusable (dri_bo * base)
+{
+  return ((MEDIA_MOCK_BO *) base)->reusable;
+}
+
+static void
+mock_bufmgr_destroy (dri_bufmgr * bufmgr)
+{
+  MEDIA_MOCK_BUFMGR *mgr = (MEDIA_MOCK_BUFMGR *) bufmgr;
+  MEDIA_MOCK_BO *bo, *next;
+
+  media_bufmgr_mock_clear_execs (bufmgr);
+  free (mgr->execs);
+  /* whatever the driver leaked; relocation targets are on this list too */
+  for (bo = mgr->bos; bo; bo = next)
+    {
+      next = bo->next;
+      free (bo->relocs);
+      free (bo->targets);
+      free (bo->mem);
+      free (bo);
+    }
+  pthread_mutex_destroy (&mgr->mutex);
+  free (mgr);
+}
+
+const MEDIA_BUFMGR_OPS media_bufmgr_mock_ops = {
+  mock_bo_alloc,
+  mock_bo_alloc_tiled,
+  mock_bo_create_from_name,
+  mock_bo_create_from_prime,
+  mock_bo_reference,
+  mock_bo_unreference,
+  mock_bo_map,
+  mock_bo_unmap,
+  mock_bo_map_gtt,
+  mock_bo_unmap,
+  mock_bo_subdata,
+  mock_bo_emit_reloc,
+  mock_bo_get_tiling,
+  mock_bo_exec,
+  mock_bo_wait_rendering,
+  mock_bo_busy,
+  mock_bo_flink,
+  mock_bo_export_to_prime,
+  mock_bo_disable_reuse,
+  mock_bo_is_reusable,
+  mock_bufmgr_destroy,
+};
+
+dri_bufmgr *
+media_bufmgr_mock_init (int batch_size)
+{
+  MEDIA_MOCK_BUFMGR *mgr = calloc (1, sizeof (*mgr));
+
+  if (mgr == NULL)
+    return NULL;
+  pthread_mutex_init (&mgr->mutex, NULL);
+  mgr->batch_size = batch_size;
+  mgr->next_handle = 1;
+  mgr->next_offset = MOCK_GTT_START;
+  return (dri_bufmgr *) mgr;
+}
+
+unsigned int
+media_bufmgr_mock_num_execs (dri_bufmgr * bufmgr)
+{
+  return ((MEDIA_MOCK_BUFMGR *) bufmgr)->num_execs;
+}
+
+const MEDIA_MOCK_EXEC *
+media_bufmgr_mock_get_exec (dri_bufmgr * bufmgr, unsigned int index)
+{
+  MEDIA_MOCK_BUFMGR *mgr = (MEDIA_MOCK_BUFMGR *) bufmgr;
+
+  return index < mgr->num_execs ? &mgr->execs[index] : NULL;
+}
+
+unsigned int
+media_bufmgr_mock_num_bos (dri_bufmgr * bufmgr)
+{
+  return ((MEDIA_MOCK_BUFMGR *) bufmgr)->num_bos;
+}
+
+void
+media_bufmgr_mock_clear_execs (dri_bufmgr * bufmgr)
+{
+  MEDIA_MOCK_BUFMGR *mgr = (MEDIA_MOCK_BUFMGR *) bufmgr;
+  unsigned int i;
+
+  pthread_mutex_lock (&mgr->mutex);
+  for (i = 0; i < mgr->num_execs; i++)
+    {
+      free (mgr->execs[i].cmds);
+      free (mgr->execs[i].relocs);
+    }
+  mgr->num_execs = 0;
+  pthread_mutex_unlock (&mgr->mutex);
+}
@@ -38,6 +38,7 @@
 #include "media_drv_hw_g75.h"
 #include "media_drv_hw_g7.h"
 #include "object_heap.h"
+#include "media_drv_slab.h"
 
 uint32_t g_intel_debug_option_flags = 0;
 
@@ -46,20 +47,19 @@ media_drv_intel_bufmgr_init (MEDIA_DRV_CONTEXT * drv_ctx)
 {
   BOOL status = SUCCESS;
   drv_ctx->drv_data.bufmgr =
-    intel_bufmgr_gem_init (drv_ctx->drv_data.fd, BATCH_BUF_SIZE);
+    media_bufmgr_create (drv_ctx->drv_data.fd, BATCH_BUF_SIZE);
   if (drv_ctx->drv_data.bufmgr == NULL)
     {
       //MEDIA_DRV_ASSERT (drv_ctx->bufmgr);
       return FAILED;
     }
-  intel_bufmgr_gem_enable_reuse (drv_ctx->drv_data.bufmgr);
   return status;
 }
 
 VOID
 media_drv_bufmgr_destroy (MEDIA_DRV_CONTEXT * drv_ctx)
 {
-  drm_intel_bufmgr_destroy (drv_ctx->drv_data.bufmgr);
+  media_bufmgr_destroy (drv_ctx->drv_data.bufmgr);
 }
 
 static VOID
@@ -92,6 +92,18 @@ media_drv_get_param (MEDIA_DRV_CONTEXT * drv_ctx, INT param, INT * value)
 {
   struct drm_i915_getparam gp;
 
+  /* without a GPU, pretend to be a Haswell with every ring */
+  if (media_bufmgr_is_mock ())
+    {
+      const CHAR *devid = getenv (MEDIA_BUFMGR_MOCK_DEVID_ENV);
+
+      if (param == I915_PARAM_CHIPSET_ID)
+	*value = devid ? strtol (devid, NULL, 0) : PCI_CHIP_HASWELL_GT2;
+      else
+	*value = 1;
+      return TRUE;
+    }
+
   gp.param = param;
   gp.value = value;
   return drmCommandWriteRead (drv_ctx->drv_data.fd, DRM_I915_GETPARAM, &gp,
@@ -153,6 +165,8 @@ media_driver_init (VADriverContextP ctx)
 
   media_driver_get_revid (&drv_ctx->drv_data.revision);
   media_drv_intel_bufmgr_init (drv_ctx);
+  media_surface_pool_init (&drv_ctx->surface_pool, drv_ctx->drv_data.bufmgr);
+  media_slab_init (&drv_ctx->slab);
   return TRUE;
 }
 
@@ -162,6 +176,20 @@ media_driver_terminate (VADriverContextP ctx)
   MEDIA_DRV_CONTEXT *drv_ctx = NULL;
   MEDIA_DRV_ASSERT (ctx);
   drv_ctx = ctx->pDriverData;
+  if (g_intel_debug_option_flags & VA_INTEL_HYBRID_POOL_STATS)
+    {
+      MEDIA_SURFACE_POOL_STATS stats;
+
+      media_surface_pool_get_stats (&drv_ctx->surface_pool, &stats);
+      media_drv_log_info (ctx, "surface bo pool: acquires=%u hits=%u "
+			  "misses=%u releases=%u rejected=%u trimmed=%u "
+			  "peak=%llu\n", stats.acquires, stats.hits,
+			  stats.misses, stats.releases, stats.rejected,
+			  stats.trimmed,
+			  (unsigned long long) stats.peak_cached_bytes);
+    }
+  media_surface_pool_destroy (&drv_ctx->surface_pool);
+  media_slab_destroy (&drv_ctx->slab);
   media_drv_bufmgr_destroy (drv_ctx);
   media_drv_mutex_destroy (&drv_ctx->ctxmutex);
 }
@@ -247,11 +275,10 @@ media_release_buffer_store (struct buffer_store ** ptr)
 
   if (buffer_store->ref_count == 0)
     {
-      dri_bo_unreference (buffer_store->bo);
-      media_drv_free_memory (buffer_store->buffer);
+      media_bo_unreference (buffer_store->bo);
       buffer_store->bo = NULL;
       buffer_store->buffer = NULL;
-      media_drv_free_memory (buffer_store);
+      media_slab_free (buffer_store);
     }
 
   *ptr = NULL;
@@ -311,6 +338,14 @@ media_destroy_context (struct object_heap *heap, struct object_base *obj)
 	media_release_buffer_store (&obj_context->codec_state.encode.
 				    misc_param[i]);
 
+      for (i = 0; i < MEDIA_MAX_TEMPORAL_LAYERS; i++)
+	{
+	  media_release_buffer_store (&obj_context->codec_state.encode.
+				      layer_rate_control[i]);
+	  media_release_buffer_store (&obj_context->codec_state.encode.
+				      layer_frame_rate[i]);
+	}
+
       for (i = 0; i < obj_context->codec_state.encode.num_slice_params_ext;
 	   i++)
 	media_release_buffer_store (&obj_context->codec_state.encode.
@@ -211,6 +211,38 @@
 
 #define VA_INTEL_HYBRID_PRE_DUMP	(1 << 2)
 #define VA_INTEL_HYBRID_POST_DUMP	(1 << 3)
+#define VA_INTEL_HYBRID_POOL_STATS	(1 << 4)
+#define VA_INTEL_HYBRID_MEM_REPORT	(1 << 5)
+#define VA_INTEL_HYBRID_PERF_COUNTERS	(1 << 6)
+#define VA_INTEL_HYBRID_GPU_TIMESTAMPS	(1 << 7)	/* encoder kernel phases */
+
+/* Per-frame counters and GPU timestamps go to this file if set, else the
+ * counters to stderr and the timestamps to the libva info callback */
+#define VA_INTEL_HYBRID_COUNTERS_FILE_ENV	"VA_INTEL_HYBRID_COUNTERS_FILE"
+
+/* Driver private surface attribute: non zero makes derived images of the
+ * surface map a cached linear copy instead of the tiled BO. Setting the
+ * environment variable below to 1 turns it on for every surface. */
+#define VASurfaceAttribHybridLinearShadow	((VASurfaceAttribType)0x40000001)
+#define VA_INTEL_HYBRID_LINEAR_SHADOW_ENV	"VA_INTEL_HYBRID_LINEAR_SHADOW"
+
+/* Driver private config attribute selecting the hybrid VP9 decode mode.
+ * Queried values are a mask of the supported modes below. */
+#define VAConfigAttribHybridDecodeMode	((VAConfigAttribType)0x40000001)
+#define VA_HYBRID_DECODE_MODE_NORMAL		0x00000000
+#define VA_HYBRID_DECODE_MODE_KEYFRAME_ONLY	0x00000001	/* non key frames are dropped */
+
+/* Driver private config attribute selecting what the VP8 encoder leaves in
+ * the coded buffer: the MBPAK records, or a complete frame packed on the
+ * CPU. Queried values are a mask of the supported outputs below. */
+#define VAConfigAttribHybridEncodeOutput	((VAConfigAttribType)0x40000002)
+#define VA_HYBRID_ENCODE_OUTPUT_MB_DATA		0x00000000
+#define VA_HYBRID_ENCODE_OUTPUT_BITSTREAM	0x00000001
+
+/* Coded buffer segment status bit set on frames the VP8 encoder turned into
+ * key frames at a scene cut. Only with the bitstream output and kf_auto;
+ * the application must treat the frame as refreshing every reference. */
+#define VA_CODED_BUF_STATUS_HYBRID_KEY_FRAME_INSERTED	0x40000000
 
 #define IS_HSW_GT3(devid)   	(devid == PCI_CHIP_HASWELL_GT3          || \
                                  devid == PCI_CHIP_HASWELL_M_GT3        || \
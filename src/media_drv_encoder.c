@@ -50,44 +50,44 @@ VOID
 media_free_resource_me (ME_CONTEXT * me_context)
 {
 
-  dri_bo_unreference (me_context->mv_distortion_surface_4x_me.bo);
+  media_bo_unreference (me_context->mv_distortion_surface_4x_me.bo);
   me_context->mv_distortion_surface_4x_me.bo = NULL;
 
-  dri_bo_unreference (me_context->mv_data_surface_16x_me.bo);
+  media_bo_unreference (me_context->mv_data_surface_16x_me.bo);
   me_context->mv_data_surface_16x_me.bo = NULL;
 
-  dri_bo_unreference (me_context->mv_data_surface_4x_me.bo);
+  media_bo_unreference (me_context->mv_data_surface_4x_me.bo);
   me_context->mv_data_surface_4x_me.bo = NULL;
 }
 
 VOID
 media_free_resource_mbenc (MBENC_CONTEXT * mbenc_context)
 {
-  dri_bo_unreference (mbenc_context->mb_mode_cost_luma_buffer.bo);
+  media_bo_unreference (mbenc_context->mb_mode_cost_luma_buffer.bo);
   mbenc_context->mb_mode_cost_luma_buffer.bo = NULL;
 
-  dri_bo_unreference (mbenc_context->block_mode_cost_buffer.bo);
+  media_bo_unreference (mbenc_context->block_mode_cost_buffer.bo);
   mbenc_context->block_mode_cost_buffer.bo = NULL;
 
-  dri_bo_unreference (mbenc_context->chroma_reconst_buffer.bo);
+  media_bo_unreference (mbenc_context->chroma_reconst_buffer.bo);
   mbenc_context->chroma_reconst_buffer.bo = NULL;
 
-  dri_bo_unreference (mbenc_context->histogram_buffer.bo);
+  media_bo_unreference (mbenc_context->histogram_buffer.bo);
   mbenc_context->histogram_buffer.bo = NULL;
 
-  dri_bo_unreference (mbenc_context->kernel_dump_buffer.bo);
+  media_bo_unreference (mbenc_context->kernel_dump_buffer.bo);
   mbenc_context->kernel_dump_buffer.bo = NULL;
 
-  dri_bo_unreference (mbenc_context->ref_frm_count_surface.bo);
+  media_bo_unreference (mbenc_context->ref_frm_count_surface.bo);
   mbenc_context->ref_frm_count_surface.bo = NULL;
 
-  dri_bo_unreference (mbenc_context->pred_mv_data_surface.bo);
+  media_bo_unreference (mbenc_context->pred_mv_data_surface.bo);
   mbenc_context->pred_mv_data_surface.bo = NULL;
 
-  dri_bo_unreference (mbenc_context->mode_cost_update_surface.bo);
+  media_bo_unreference (mbenc_context->mode_cost_update_surface.bo);
   mbenc_context->mode_cost_update_surface.bo = NULL;
 
-  dri_bo_unreference (mbenc_context->pred_mb_quant_data_surface.bo);
+  media_bo_unreference (mbenc_context->pred_mb_quant_data_surface.bo);
   mbenc_context->pred_mb_quant_data_surface.bo = NULL;
 }
 
@@ -95,19 +95,19 @@ VOID
 media_free_resource_mbpak (MBPAK_CONTEXT * mbpak_context)
 {
 
-  dri_bo_unreference (mbpak_context->row_buffer_y.bo);
+  media_bo_unreference (mbpak_context->row_buffer_y.bo);
   mbpak_context->row_buffer_y.bo = NULL;
 
-  dri_bo_unreference (mbpak_context->row_buffer_uv.bo);
+  media_bo_unreference (mbpak_context->row_buffer_uv.bo);
   mbpak_context->row_buffer_uv.bo = NULL;
 
-  dri_bo_unreference (mbpak_context->column_buffer_y.bo);
+  media_bo_unreference (mbpak_context->column_buffer_y.bo);
   mbpak_context->column_buffer_y.bo = NULL;
 
-  dri_bo_unreference (mbpak_context->column_buffer_uv.bo);
+  media_bo_unreference (mbpak_context->column_buffer_uv.bo);
   mbpak_context->column_buffer_uv.bo = NULL;
 
-  dri_bo_unreference (mbpak_context->kernel_dump_buffer.bo);
+  media_bo_unreference (mbpak_context->kernel_dump_buffer.bo);
   mbpak_context->kernel_dump_buffer.bo = NULL;
 
 }
@@ -145,13 +145,13 @@ VOID
 media_free_resource_scaling (SCALING_CONTEXT * scaling_context)
 {
 
-  dri_bo_unreference (scaling_context->scaled_4x_surface.bo);
+  media_bo_unreference (scaling_context->scaled_4x_surface.bo);
   scaling_context->scaled_4x_surface.bo = NULL;
 
-  dri_bo_unreference (scaling_context->scaled_16x_surface.bo);
+  media_bo_unreference (scaling_context->scaled_16x_surface.bo);
   scaling_context->scaled_16x_surface.bo = NULL;
 
-  dri_bo_unreference (scaling_context->scaled_32x_surface.bo);
+  media_bo_unreference (scaling_context->scaled_32x_surface.bo);
   scaling_context->scaled_32x_surface.bo = NULL;
 }
 
@@ -169,20 +169,20 @@ media_free_resource_brc_init_reset (BRC_INIT_RESET_CONTEXT * context)
 {
   int i;
 
-  dri_bo_unreference (context->brc_history.bo);
+  media_bo_unreference (context->brc_history.bo);
   context->brc_history.bo = NULL;
 
-  dri_bo_unreference (context->brc_distortion.bo);
+  media_bo_unreference (context->brc_distortion.bo);
   context->brc_distortion.bo = NULL;
 
-  dri_bo_unreference (context->brc_pak_qp_input_table.bo);
+  media_bo_unreference (context->brc_pak_qp_input_table.bo);
   context->brc_pak_qp_input_table.bo = NULL;
 
-  dri_bo_unreference (context->brc_constant_data.bo);
+  media_bo_unreference (context->brc_constant_data.bo);
   context->brc_constant_data.bo = NULL;
 
   for (i = 0; i < NUM_BRC_CONSTANT_DATA_BUFFERS; i++) {
-    dri_bo_unreference(context->brc_constant_buffer[i].bo);
+    media_bo_unreference(context->brc_constant_buffer[i].bo);
     context->brc_constant_buffer[i].bo = NULL;
   }
 }
@@ -211,10 +211,161 @@ media_brc_update_context_destroy (MEDIA_ENCODER_CTX *encoder_context)
   media_gpe_context_destroy (gpe_ctx);
 }
 
+#define MEDIA_TIMESTAMP_SLOT_SIZE	(MEDIA_TIMESTAMP_MAX_PHASES * 2 * 4)
+
+static VOID
+media_encoder_timestamps_create (VADriverContextP ctx,
+				 MEDIA_ENCODER_CTX * encoder_context)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = ctx->pDriverData;
+  MEDIA_GPU_TIMESTAMPS *ts;
+  const CHAR *name;
+  INT i;
+
+  ts = (MEDIA_GPU_TIMESTAMPS *)
+    media_drv_alloc_memory (sizeof (MEDIA_GPU_TIMESTAMPS));
+  if (ts == NULL)
+    return;
+  for (i = 0; i < VP8_ENCODE_FRAMES_IN_FLIGHT; i++)
+    {
+      ts->res[i].tiling = I915_TILING_NONE;
+      ts->res[i].bo_size = MEDIA_TIMESTAMP_SLOT_SIZE;
+      media_allocate_resource (&ts->res[i], drv_ctx->drv_data.bufmgr,
+			       (const BYTE *) "gpu timestamps",
+			       MEDIA_TIMESTAMP_SLOT_SIZE, 4096);
+      MEDIA_DRV_ASSERT (ts->res[i].bo);
+    }
+  ts->ctx = ctx;
+  name = getenv (VA_INTEL_HYBRID_COUNTERS_FILE_ENV);
+  ts->file = name ? fopen (name, "a") : NULL;
+  encoder_context->timestamps = ts;
+}
+
+static VOID
+media_encoder_timestamps_print (MEDIA_GPU_TIMESTAMPS * ts, UINT frame_num,
+				const CHAR * name, uint64_t ticks)
+{
+  DOUBLE us = ticks * MEDIA_GPU_TIMESTAMP_NS / 1000.0;
+
+  if (ts->file)
+    fprintf (ts->file, "frame %u %s: %.1f us\n", frame_num, name, us);
+  else
+    media_drv_log_info (ts->ctx, "frame %u %s: %.1f us\n", frame_num, name,
+			us);
+}
+
+/* Prints the phases a frame recorded into slot, waiting for it if needed. */
+static VOID
+media_encoder_timestamps_report (MEDIA_GPU_TIMESTAMPS * ts, UINT slot)
+{
+  const uint32_t *stamps;
+  uint64_t total = 0;
+  uint32_t ticks;
+  UINT i;
+
+  if (ts->num_phases[slot] == 0)
+    return;
+  stamps = (const uint32_t *) media_map_buffer_obj (ts->res[slot].bo);
+  if (stamps == NULL)
+    return;
+  for (i = 0; i < ts->num_phases[slot]; i++)
+    {
+      ticks = stamps[i * 2 + 1] - stamps[i * 2];
+      total += ticks;
+      media_encoder_timestamps_print (ts, ts->frame_num[slot],
+				      ts->phase_name[slot][i], ticks);
+    }
+  media_encoder_timestamps_print (ts, ts->frame_num[slot], "kernels", total);
+  if (ts->file)
+    fflush (ts->file);
+  media_unmap_buffer_obj (ts->res[slot].bo);
+  ts->num_phases[slot] = 0;
+}
+
+/* Moves to the slot of a new frame, reporting the frame that used it last. */
+static VOID
+media_encoder_timestamps_next_frame (MEDIA_GPU_TIMESTAMPS * ts,
+				     UINT frame_num)
+{
+  ts->slot = (ts->slot + 1) % VP8_ENCODE_FRAMES_IN_FLIGHT;
+  media_encoder_timestamps_report (ts, ts->slot);
+  ts->frame_num[ts->slot] = frame_num;
+  ts->phase_open = FALSE;
+}
+
+static VOID
+media_encoder_timestamps_begin (MEDIA_GPU_TIMESTAMPS * ts,
+				MEDIA_BATCH_BUFFER * batch, const CHAR * name)
+{
+  UINT idx;
+
+  if (ts == NULL || ts->num_phases[ts->slot] == MEDIA_TIMESTAMP_MAX_PHASES)
+    return;
+  idx = ts->num_phases[ts->slot]++;
+  ts->phase_name[ts->slot][idx] = name ? name : "kernel";
+  mediadrv_gen_mi_store_register_mem_cmd (batch, MEDIA_RCS_TIMESTAMP_REG,
+					  ts->res[ts->slot].bo, idx * 8);
+  ts->phase_open = TRUE;
+}
+
+static VOID
+media_encoder_timestamps_end (MEDIA_GPU_TIMESTAMPS * ts,
+			      MEDIA_BATCH_BUFFER * batch)
+{
+  if (ts == NULL || !ts->phase_open)
+    return;
+  mediadrv_gen_mi_store_register_mem_cmd (batch, MEDIA_RCS_TIMESTAMP_REG,
+					  ts->res[ts->slot].bo,
+					  (ts->num_phases[ts->slot] - 1) * 8 +
+					  4);
+  ts->phase_open = FALSE;
+}
+
+static VOID
+media_encoder_timestamps_destroy (MEDIA_ENCODER_CTX * encoder_context)
+{
+  MEDIA_GPU_TIMESTAMPS *ts = encoder_context->timestamps;
+  UINT i, slot;
+
+  if (ts == NULL)
+    return;
+  /* oldest frame first */
+  for (i = 1; i <= VP8_ENCODE_FRAMES_IN_FLIGHT; i++)
+    {
+      slot = (ts->slot + i) % VP8_ENCODE_FRAMES_IN_FLIGHT;
+      media_encoder_timestamps_report (ts, slot);
+      media_bo_unreference (ts->res[slot].bo);
+    }
+  if (ts->file)
+    fclose (ts->file);
+  media_drv_free_memory (ts);
+  encoder_context->timestamps = NULL;
+}
+
+static VOID
+media_encoder_temporal_layers_destroy (MEDIA_ENCODER_CTX * encoder_context)
+{
+  MEDIA_VP8_TEMPORAL_LAYERS *tl = encoder_context->temporal_layers;
+
+  if (tl == NULL)
+    return;
+  /* hand the base layer's BRC history back to the encoder */
+  encoder_context->brc_init_reset_context.brc_history =
+    tl->layers[0].brc_history;
+  media_vp8_temporal_layers_destroy (tl);
+  encoder_context->temporal_layers = NULL;
+  encoder_context->brc_layer = NULL;
+}
+
 static VOID
 media_encoder_context_destroy (VOID * hw_context)
 {
   MEDIA_ENCODER_CTX *encoder_context = (MEDIA_ENCODER_CTX *) hw_context;
+  media_vp8_packer_destroy (encoder_context->vp8_packer);
+  media_vp8_lookahead_destroy (encoder_context->lookahead);
+  media_vp8_scene_cut_destroy (encoder_context->scene_cut);
+  media_encoder_temporal_layers_destroy (encoder_context);
+  media_encoder_timestamps_destroy (encoder_context);
   media_scaling_context_destroy (encoder_context);
   media_me_context_destroy (encoder_context);
   media_mbenc_context_destroy (encoder_context);
@@ -275,6 +426,53 @@ gpe_context_vfe_scoreboardinit_pak_p2 (MEDIA_ENCODER_CTX * encoder_context,MEDIA
   gpe_context->vfe_state.vfe_desc7.scoreboard2.delta_x7 = 0;
   gpe_context->vfe_state.vfe_desc7.scoreboard2.delta_y7 = 0;
 }
+VOID
+media_encoder_gpe_contexts (MEDIA_ENCODER_CTX * encoder_context,
+			    MEDIA_GPE_CTX * gpe_ctx_list[VP8_ENCODE_NUM_GPE_CTX])
+{
+  gpe_ctx_list[0] = &encoder_context->scaling_context.gpe_context;
+  gpe_ctx_list[1] = &encoder_context->me_context.gpe_context;
+  gpe_ctx_list[2] = &encoder_context->mbenc_context.gpe_context;
+  gpe_ctx_list[3] = &encoder_context->mbpak_context.gpe_context;
+  gpe_ctx_list[4] = &encoder_context->mbpak_context.gpe_context2;
+  gpe_ctx_list[5] = &encoder_context->brc_init_reset_context.gpe_context;
+  gpe_ctx_list[6] = &encoder_context->brc_update_context.gpe_context;
+}
+
+/*
+ * The CURBE of every kernel is rewritten by the CPU for each frame. With a
+ * single dynamic state heap per kernel that write has to wait until the
+ * GPU is done with the previous frame, so each kernel gets a small ring of
+ * heaps instead. Surfaces only touched by the GPU stay single, the render
+ * ring executes the frames in order.
+ */
+static VOID
+media_encoder_alloc_frame_ring (VADriverContextP ctx,
+				MEDIA_ENCODER_CTX * encoder_context)
+{
+  MEDIA_GPE_CTX *gpe_ctx_list[VP8_ENCODE_NUM_GPE_CTX];
+  INT i;
+
+  media_encoder_gpe_contexts (encoder_context, gpe_ctx_list);
+  for (i = 0; i < VP8_ENCODE_NUM_GPE_CTX; i++)
+    media_gpe_context_alloc_dynamic_ring (ctx, gpe_ctx_list[i],
+					  VP8_ENCODE_FRAMES_IN_FLIGHT);
+}
+
+static VOID
+media_encoder_next_frame (MEDIA_ENCODER_CTX * encoder_context)
+{
+  MEDIA_GPE_CTX *gpe_ctx_list[VP8_ENCODE_NUM_GPE_CTX];
+  INT i;
+
+  media_encoder_gpe_contexts (encoder_context, gpe_ctx_list);
+  for (i = 0; i < VP8_ENCODE_NUM_GPE_CTX; i++)
+    media_gpe_context_next_frame (gpe_ctx_list[i]);
+  if (encoder_context->timestamps)
+    media_encoder_timestamps_next_frame (encoder_context->timestamps,
+					 encoder_context->frame_num);
+}
+
 BOOL
 media_encoder_init (VADriverContextP ctx, MEDIA_ENCODER_CTX * encoder_context)
 {
@@ -284,6 +482,9 @@ media_encoder_init (VADriverContextP ctx, MEDIA_ENCODER_CTX * encoder_context)
     {
     case CODEC_VP8:
       media_encoder_init_vp8 (ctx, encoder_context);
+      media_encoder_alloc_frame_ring (ctx, encoder_context);
+      if (g_intel_debug_option_flags & VA_INTEL_HYBRID_GPU_TIMESTAMPS)
+	media_encoder_timestamps_create (ctx, encoder_context);
       break;
     default:
       /* never get here */
@@ -343,11 +544,19 @@ media_enc_context_init (VADriverContextP ctx,
 	    break;
 	  }
 	}
+      else if (obj_config->attrib_list[i].type ==
+	       VAConfigAttribHybridEncodeOutput)
+	encoder_context->encode_output = obj_config->attrib_list[i].value;
     }
   encoder_context->picture_width = picture_width;
   encoder_context->picture_height = picture_height;
   media_encoder_init (ctx, encoder_context);
 
+  if (encoder_context->encode_output & VA_HYBRID_ENCODE_OUTPUT_BITSTREAM)
+    encoder_context->vp8_packer =
+      media_vp8_packer_create (WIDTH_IN_MACROBLOCKS (picture_width),
+			       HEIGHT_IN_MACROBLOCKS (picture_height));
+
   return (struct hw_context *) encoder_context;
 }
 
@@ -362,6 +571,27 @@ media_drv_status_report (VADriverContextP ctx, MEDIA_BATCH_BUFFER * batch,
   mediadrv_gen_pipe_ctrl_cmd (batch, &pipe_ctrl_params);
 }
 
+/*
+ * Upper bound of what one kernel phase records: the two timestamps and
+ * two cache flushes around it, the pipeline select or state flush, its
+ * state commands and a predicated pair of walkers.
+ */
+#define MEDIA_KERNEL_PHASE_DWORDS					\
+  (4 * 6 + 2 + MEDIA_GPE_STATE_CMDS_DWORDS +				\
+   2 * (CMD_MEDIA_OBJECT_WALKER_LEN + 2))
+
+/*
+ * Programs the media pipeline for one kernel phase. All phases of a frame
+ * are recorded into the same batch, so state already programmed by an
+ * earlier phase is not emitted again and caches are only flushed in front
+ * of phases that consume the output of the previous one. The state
+ * commands themselves are prebuilt per context.
+ *
+ * The space for the whole phase, including the walker the caller emits
+ * next, is reserved up front: a batch that fills up is flushed here, where
+ * the state is reprogrammed in the new batch, and never between the state
+ * commands and the walker that depends on them.
+ */
 VOID
 media_drv_generic_kernel_cmds (VADriverContextP ctx,
 			       MEDIA_ENCODER_CTX * encoder_context,
@@ -369,55 +599,138 @@ media_drv_generic_kernel_cmds (VADriverContextP ctx,
 			       MEDIA_GPE_CTX * gpe_context,
 			       GENERIC_KERNEL_PARAMS * params)
 {
+  MEDIA_BATCH_STATE *state = &encoder_context->batch_state;
   PIPE_CONTROL_PARAMS pipe_ctrl_params = { {NULL, 0, 0} };
-  STATE_BASE_ADDR_PARAMS state_base_addr_params;
-  VFE_STATE_PARAMS vfe_state_params;
+  MEDIA_GPE_STATE_CMDS *cmds;
   CURBE_LOAD_PARAMS curbe_load_params;
   ID_LOAD_PARAMS id_load_params;
+  BOOL base_changed = FALSE;
+  UINT mask = 0;
 
-  pipe_ctrl_params.flush_mode = FLUSH_WRITE_CACHE;
-  mediadrv_gen_pipe_ctrl_cmd (batch, &pipe_ctrl_params);
-  pipe_ctrl_params.immediate_data = encoder_context->frame_num;
-  pipe_ctrl_params.flush_mode = FLUSH_READ_CACHE;
-  mediadrv_gen_pipe_ctrl_cmd (batch, &pipe_ctrl_params);
+  media_batchbuffer_require_space (batch, MEDIA_KERNEL_PHASE_DWORDS * 4);
+  if (state->batch_bo != batch->buffer ||
+      (UINT) (batch->cmd_ptr - batch->map) < state->batch_offset)
+    {
+      media_drv_memset (state, sizeof (*state));
+      state->batch_bo = batch->buffer;
+    }
 
+  if (!state->pipeline_selected)
+    {
+      pipe_ctrl_params.flush_mode = FLUSH_WRITE_CACHE;
+      mediadrv_gen_pipe_ctrl_cmd (batch, &pipe_ctrl_params);
+      pipe_ctrl_params.immediate_data = encoder_context->frame_num;
+      pipe_ctrl_params.flush_mode = FLUSH_READ_CACHE;
+      mediadrv_gen_pipe_ctrl_cmd (batch, &pipe_ctrl_params);
 #if 0
 #ifdef STATUS_REPORT
-  media_drv_status_report (ctx, batch, gpe_context);
+      media_drv_status_report (ctx, batch, gpe_context);
 #endif
 #endif
-  mediadrv_gen_pipeline_select_cmd (batch);
-
-  state_base_addr_params.surface_state.bo =
-    /*batch->buffer; */ gpe_context->surface_state_binding_table.res.bo;
-  state_base_addr_params.dynamic_state.bo = gpe_context->dynamic_state.res.bo;
-  state_base_addr_params.indirect_object.bo = NULL;
-  state_base_addr_params.instruction_buffer.bo =
-    gpe_context->instruction_state.buff_obj.bo;
-
-  encoder_context->mediadrv_gen_state_base_address_cmd (batch, &state_base_addr_params);
-  vfe_state_params.gpgpu_mode = gpe_context->vfe_state.gpgpu_mode;
-  vfe_state_params.max_num_threads = gpe_context->vfe_state.max_num_threads;
-  vfe_state_params.num_urb_entries = gpe_context->vfe_state.num_urb_entries;
-  vfe_state_params.urb_entry_size = gpe_context->vfe_state.urb_entry_size;
-  vfe_state_params.curbe_allocation_size =
-    gpe_context->vfe_state.curbe_allocation_size;
-  vfe_state_params.scoreboard_enable = 1;
-  vfe_state_params.scoreboard_type = 0;
-  vfe_state_params.scoreboard_mask = 0;
-  vfe_state_params.scoreboardDW5 = gpe_context->vfe_state.vfe_desc5.dword;
-  vfe_state_params.scoreboardDW6 = gpe_context->vfe_state.vfe_desc6.dword;
-  vfe_state_params.scoreboardDW7 = gpe_context->vfe_state.vfe_desc7.dword;
-  encoder_context->mediadrv_gen_media_vfe_state_cmd (batch, &vfe_state_params);
+      mediadrv_gen_pipeline_select_cmd (batch);
+      state->pipeline_selected = TRUE;
+    }
+  else
+    {
+      mediadrv_gen_media_state_flush_cmd (batch);
+      if (params->dependent)
+	{
+	  pipe_ctrl_params.flush_mode = FLUSH_WRITE_CACHE;
+	  mediadrv_gen_pipe_ctrl_cmd (batch, &pipe_ctrl_params);
+	  pipe_ctrl_params.immediate_data = encoder_context->frame_num;
+	  pipe_ctrl_params.flush_mode = FLUSH_READ_CACHE;
+	  mediadrv_gen_pipe_ctrl_cmd (batch, &pipe_ctrl_params);
+	}
+    }
+  /* after the flushes, so a phase the next one waits for ends when it
+   * completed and the others when they stopped holding up the ring */
+  media_encoder_timestamps_end (encoder_context->timestamps, batch);
+
+  /* the phase may have switched the scoreboard of the context */
+  if (!gpe_context->state_cmds.valid ||
+      memcmp (&gpe_context->state_cmds.vfe_state, &gpe_context->vfe_state,
+	      sizeof (gpe_context->vfe_state)))
+    encoder_context->mediadrv_gen_state_cmds_build (gpe_context);
+  cmds = &gpe_context->state_cmds;
+
+  if (state->surface_state_bo != gpe_context->surface_state_binding_table.res.bo ||
+      state->dynamic_state_bo != gpe_context->dynamic_state.res.bo ||
+      state->instruction_bo != gpe_context->instruction_state.buff_obj.bo)
+    {
+      mask |= MEDIA_STATE_CMDS_SBA;
+      state->surface_state_bo = gpe_context->surface_state_binding_table.res.bo;
+      state->dynamic_state_bo = gpe_context->dynamic_state.res.bo;
+      state->instruction_bo = gpe_context->instruction_state.buff_obj.bo;
+      base_changed = TRUE;
+    }
+
+  if (state->vfe_len != cmds->vfe_len ||
+      memcmp (state->vfe, cmds->dw + cmds->vfe, cmds->vfe_len * sizeof (UINT)))
+    {
+      mask |= MEDIA_STATE_CMDS_VFE;
+      memcpy (state->vfe, cmds->dw + cmds->vfe, cmds->vfe_len * sizeof (UINT));
+      state->vfe_len = cmds->vfe_len;
+      /* the constant URB is reallocated by MEDIA_VFE_STATE */
+      base_changed = TRUE;
+    }
 
   curbe_load_params.curbe_size = gpe_context->curbe_size;
   curbe_load_params.curbe_offset = gpe_context->curbe_offset;
-  mediadrv_gen_media_curbe_load_cmd (batch, &curbe_load_params);
+  if (base_changed ||
+      state->curbe.curbe_size != curbe_load_params.curbe_size ||
+      state->curbe.curbe_offset != curbe_load_params.curbe_offset)
+    {
+      mask |= MEDIA_STATE_CMDS_CURBE_LOAD;
+      state->curbe = curbe_load_params;
+    }
+
   id_load_params.idrt_size = gpe_context->idrt_size;
   id_load_params.idrt_offset =
     (gpe_context->idrt_offset +
      (params->idrt_kernel_offset * gpe_context->idrt_size));
-  mediadrv_gen_media_id_load_cmd (batch, &id_load_params);
+  if (base_changed ||
+      state->idrt.idrt_size != id_load_params.idrt_size ||
+      state->idrt.idrt_offset != id_load_params.idrt_offset)
+    {
+      mask |= MEDIA_STATE_CMDS_ID_LOAD;
+      state->idrt = id_load_params;
+    }
+  mediadrv_gen_state_cmds_emit (batch, gpe_context, mask,
+				curbe_load_params.curbe_offset,
+				id_load_params.idrt_offset);
+  media_encoder_timestamps_begin (encoder_context->timestamps, batch,
+				  params->phase_name);
+  state->batch_offset = batch->cmd_ptr - batch->map;
+}
+
+/* Opens the batch the kernel phases of a frame are recorded into. */
+static VOID
+media_encoder_batch_begin (VADriverContextP ctx,
+			   MEDIA_ENCODER_CTX * encoder_context)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = ctx->pDriverData;
+
+  encoder_context->batch =
+    media_batchbuffer_new (&drv_ctx->drv_data, I915_EXEC_RENDER, 0);
+  media_drv_memset (&encoder_context->batch_state,
+		    sizeof (encoder_context->batch_state));
+}
+
+static VOID
+media_encoder_batch_end (MEDIA_ENCODER_CTX * encoder_context)
+{
+  MEDIA_GPU_TIMESTAMPS *ts = encoder_context->timestamps;
+  PIPE_CONTROL_PARAMS pipe_ctrl_params = { {NULL, 0, 0} };
+
+  /* nothing follows the last phase, waiting for it there costs nothing */
+  if (ts && ts->phase_open)
+    {
+      pipe_ctrl_params.flush_mode = FLUSH_WRITE_CACHE;
+      mediadrv_gen_pipe_ctrl_cmd (encoder_context->batch, &pipe_ctrl_params);
+    }
+  media_encoder_timestamps_end (ts, encoder_context->batch);
+  media_batchbuffer_submit (encoder_context->batch);
+  encoder_context->batch = NULL;
 }
 
 VOID
@@ -472,7 +785,6 @@ mediadrv_gen_encode_scaling (VADriverContextP ctx,
 {
   UINT pic_coding_type, down_scaled_width_mb, down_scaled_height_mb;
   SCALING_CURBE_PARAMS scaling_curbe_params;
-  MEDIA_DRV_CONTEXT *drv_ctx = ctx->pDriverData;
   SCALING_CONTEXT *scaling_ctx = &encoder_context->scaling_context;
   MEDIA_RESOURCE *scaling_input_surface, *scaling_output_surface, surface_2d, surface_2d_out;
   struct object_surface *obj_surface;
@@ -532,6 +844,7 @@ mediadrv_gen_encode_scaling (VADriverContextP ctx,
       output_height = encoder_context->down_scaled_height_mb4x;
     }
 
+  media_gpe_context_select_curbe (scaling_gpe_ctx, phase_16x ? 1 : 0);
   encoder_context->set_curbe_scaling (scaling_gpe_ctx, &scaling_curbe_params);
 
   scaling_sutface_params.scaling_input_surface = *scaling_input_surface;
@@ -544,7 +857,9 @@ mediadrv_gen_encode_scaling (VADriverContextP ctx,
   encoder_context->media_add_binding_table (scaling_gpe_ctx);
   encoder_context->surface_state_scaling (encoder_context, &scaling_sutface_params);
 
-  batch = media_batchbuffer_new (&drv_ctx->drv_data, I915_EXEC_RENDER, 0);
+  batch = encoder_context->batch;
+  kernel_params.dependent = phase_16x;
+  kernel_params.phase_name = phase_16x ? "scaling 16x" : "scaling 4x";
   //media_batchbuffer_start_atomic(batch, 0x4000);
   kernel_params.idrt_kernel_offset = 0;
   media_drv_generic_kernel_cmds (ctx, encoder_context, batch, scaling_gpe_ctx,
@@ -563,7 +878,6 @@ mediadrv_gen_encode_scaling (VADriverContextP ctx,
   media_drv_end_status_report (ctx, batch, scaling_gpe_ctx);
 #endif
 #endif
-  media_batchbuffer_submit (batch);
 
 }
 
@@ -573,7 +887,6 @@ mediadrv_gen_encode_mbpak (VADriverContextP ctx,
 			   struct encode_state *encode_state,
 			   UINT pak_phase_type)
 {
-  MEDIA_DRV_CONTEXT *drv_ctx = ctx->pDriverData;
   MBPAK_CONTEXT *mbpak_ctx = &encoder_context->mbpak_context;
   MEDIA_GPE_CTX *mbpak_gpe_ctx;
   MEDIA_BATCH_BUFFER *batch;
@@ -588,6 +901,7 @@ mediadrv_gen_encode_mbpak (VADriverContextP ctx,
       mbpak_gpe_ctx->surface_state_binding_table =
 	mbpak_ctx->surface_state_binding_table_mbpak_p1;
       kernel_params.idrt_kernel_offset = MBPAK_PHASE1_OFFSET;
+      kernel_params.phase_name = "MBPAK phase 1";
       encoder_context->gpe_context_vfe_scoreboardinit_pak_p1 (encoder_context,mbpak_gpe_ctx);
 #ifdef DEBUG
       //phase = 1;
@@ -599,6 +913,7 @@ mediadrv_gen_encode_mbpak (VADriverContextP ctx,
       mbpak_gpe_ctx->surface_state_binding_table =
 	mbpak_ctx->surface_state_binding_table_mbpak_p2;
       kernel_params.idrt_kernel_offset = MBPAK_PHASE2_OFFSET;
+      kernel_params.phase_name = "MBPAK phase 2";
       //FIXME:Need to find a better way to handle this..!
       encoder_context->gpe_context_vfe_scoreboardinit_pak_p2 (encoder_context,mbpak_gpe_ctx);
 #ifdef DEBUG
@@ -608,11 +923,11 @@ mediadrv_gen_encode_mbpak (VADriverContextP ctx,
 
   if (!encoder_context->mbpak_curbe_set_brc_update) {
     curbe_params.curbe_cmd_buff =
-      media_map_buffer_obj (mbpak_gpe_ctx->dynamic_state.res.bo);
+      media_gpe_context_curbe_begin (mbpak_gpe_ctx);
     curbe_params.updated = encoder_context->mbpak_curbe_set_brc_update;
     curbe_params.pak_phase_type = pak_phase_type;
     encoder_context->set_curbe_vp8_mbpak (encode_state, &curbe_params);
-    media_unmap_buffer_obj (mbpak_gpe_ctx->dynamic_state.res.bo);
+    media_gpe_context_curbe_end (mbpak_gpe_ctx);
   }
 
   media_drv_memset (&sutface_params, sizeof (sutface_params));
@@ -627,7 +942,8 @@ mediadrv_gen_encode_mbpak (VADriverContextP ctx,
   encoder_context->surface_state_vp8_mbpak (encoder_context, encode_state,
 					    &sutface_params);
 
-  batch = media_batchbuffer_new (&drv_ctx->drv_data, I915_EXEC_RENDER, 0);
+  batch = encoder_context->batch;
+  kernel_params.dependent = TRUE;
   //kernel_params.idrt_kernel_offset=0;
   media_drv_generic_kernel_cmds (ctx, encoder_context, batch, mbpak_gpe_ctx,
 				 &kernel_params);
@@ -638,7 +954,6 @@ mediadrv_gen_encode_mbpak (VADriverContextP ctx,
   media_drv_end_status_report (ctx, batch, mbpak_gpe_ctx);
 #endif
 #endif
-  media_batchbuffer_submit (batch);
 }
 
 VOID
@@ -648,13 +963,11 @@ mediadrv_gen_encode_mbenc (VADriverContextP ctx,
 			   BOOL mbenc_phase_2, BOOL mbenc_i_frame_dist_in_use)
 {
   //VAStatus status = VA_STATUS_SUCCESS;
-  MEDIA_DRV_CONTEXT *drv_ctx = ctx->pDriverData;
   MBENC_CONTEXT *mbenc_ctx = &encoder_context->mbenc_context;
   MEDIA_GPE_CTX *mbenc_gpe_ctx = &mbenc_ctx->gpe_context;
   VAEncPictureParameterBufferVP8 *pic_param =
     (VAEncPictureParameterBufferVP8 *) encode_state->pic_param_ext->buffer;
   MEDIA_BATCH_BUFFER *batch;
-  VOID *buf = NULL;
   MBENC_CONSTANT_BUFFER_PARAMS_VP8 const_buff_params;
   MEDIA_MBENC_CURBE_PARAMS_VP8 curbe_params;
   MBENC_SURFACE_PARAMS_VP8 mbenc_sutface_params;
@@ -663,19 +976,30 @@ mediadrv_gen_encode_mbenc (VADriverContextP ctx,
 
   UINT /*phase, */ ref_frame_flag_final, ref_frame_flag;
 
+  /* the I frame distortion pass runs in the same batch as the real MBEnc,
+   * whose CURBE has to stay in slot 0 for the BRC update kernel */
+  media_gpe_context_select_curbe (mbenc_gpe_ctx,
+				  mbenc_i_frame_dist_in_use ? 1 : 0);
   if (mbenc_i_frame_dist_in_use) {
       mbenc_gpe_ctx->surface_state_binding_table =
 	mbenc_ctx->surface_state_binding_table_mbenc_iframe_dist;
       kernel_params.idrt_kernel_offset = MBENC_IFRAME_DIST_OFFSET;
+      kernel_params.phase_name = "MBEnc I frame distortion";
   } else
   if (mbenc_phase_2 == FALSE)
     {
       mbenc_gpe_ctx->surface_state_binding_table =
 	mbenc_ctx->surface_state_binding_table_mbenc_p1;
       if (encoder_context->pic_coding_type == FRAME_TYPE_I)
-	kernel_params.idrt_kernel_offset = MBENC_ILUMA_START_OFFSET;
+	{
+	  kernel_params.idrt_kernel_offset = MBENC_ILUMA_START_OFFSET;
+	  kernel_params.phase_name = "MBEnc I luma";
+	}
       else
-	kernel_params.idrt_kernel_offset = MBENC_P_START_OFFSET;
+	{
+	  kernel_params.idrt_kernel_offset = MBENC_P_START_OFFSET;
+	  kernel_params.phase_name = "MBEnc P";
+	}
 #ifdef DEBUG
       //phase = 2;
 #endif
@@ -685,6 +1009,7 @@ mediadrv_gen_encode_mbenc (VADriverContextP ctx,
       mbenc_gpe_ctx->surface_state_binding_table =
 	mbenc_ctx->surface_state_binding_table_mbenc_p2;
       kernel_params.idrt_kernel_offset = MBENC_ICHROMA_START_OFFSET;
+      kernel_params.phase_name = "MBEnc I chroma";
 #ifdef DEBUG
       //phase = 1;
 #endif
@@ -745,20 +1070,20 @@ mediadrv_gen_encode_mbenc (VADriverContextP ctx,
 
       if (encoder_context->pic_coding_type == FRAME_TYPE_I)
 	{
-	  buf = media_map_buffer_obj (mbenc_gpe_ctx->dynamic_state.res.bo);
-	  curbe_params.curbe_cmd_buff = buf;
+	  curbe_params.curbe_cmd_buff =
+	    media_gpe_context_curbe_begin (mbenc_gpe_ctx);
 	  encoder_context->set_curbe_i_vp8_mbenc (encode_state,
 						  &curbe_params);
-	  media_unmap_buffer_obj (mbenc_gpe_ctx->dynamic_state.res.bo);
+	  media_gpe_context_curbe_end (mbenc_gpe_ctx);
 	}
       else if (encoder_context->pic_coding_type == FRAME_TYPE_P)
 	{
 
-	  buf = media_map_buffer_obj (mbenc_gpe_ctx->dynamic_state.res.bo);
-	  curbe_params.curbe_cmd_buff = buf;
+	  curbe_params.curbe_cmd_buff =
+	    media_gpe_context_curbe_begin (mbenc_gpe_ctx);
 	  encoder_context->set_curbe_p_vp8_mbenc (encode_state,
 						  &curbe_params);
-	  media_unmap_buffer_obj (mbenc_gpe_ctx->dynamic_state.res.bo);
+	  media_gpe_context_curbe_end (mbenc_gpe_ctx);
 	}
       }
 
@@ -791,7 +1116,8 @@ mediadrv_gen_encode_mbenc (VADriverContextP ctx,
 
   encoder_context->surface_state_vp8_mbenc (encoder_context, encode_state,
 					    &mbenc_sutface_params);
-  batch = media_batchbuffer_new (&drv_ctx->drv_data, I915_EXEC_RENDER, 0);
+  batch = encoder_context->batch;
+  kernel_params.dependent = TRUE;
   media_drv_generic_kernel_cmds (ctx, encoder_context, batch, mbenc_gpe_ctx,
 				 &kernel_params);
   encoder_context->media_object_walker_mbenc_init(mbenc_i_frame_dist_in_use,mbenc_phase_2,encoder_context,&media_obj_walker_params);
@@ -801,7 +1127,6 @@ mediadrv_gen_encode_mbenc (VADriverContextP ctx,
   media_drv_end_status_report (ctx, batch, mbenc_gpe_ctx);
 #endif
 #endif
-  media_batchbuffer_submit (batch);
 }
 
 VOID
@@ -809,11 +1134,9 @@ mediadrv_gen_encode_me (VADriverContextP ctx,
 			MEDIA_ENCODER_CTX * encoder_context,
 			struct encode_state *encode_state, BOOL me_phase)
 {
-  MEDIA_DRV_CONTEXT *drv_ctx = ctx->pDriverData;
   VP8_ME_CURBE_PARAMS me_curbe_params;
   ME_SURFACE_PARAMS_VP8 me_sutface_params;
   BOOL me_16x = encode_state->me_16x_enabled && !encode_state->me_16x_done;
-  VOID *buf = NULL;
   MEDIA_OBJ_WALKER_PARAMS media_obj_walker_params;
   MEDIA_BATCH_BUFFER *batch;
   ME_CONTEXT *me_ctx = &encoder_context->me_context;
@@ -838,25 +1161,25 @@ mediadrv_gen_encode_me (VADriverContextP ctx,
   me_curbe_params.me_16x = me_16x;
   me_curbe_params.me_16x_enabled = encode_state->me_16x_enabled;
   me_curbe_params.kernel_mode = encoder_context->kernel_mode;
-  buf = media_map_buffer_obj (me_gpe_ctx->dynamic_state.res.bo);
-  me_curbe_params.curbe_cmd_buff = buf;
+  /* 16x and 4x ME of a frame go into the same batch */
+  media_gpe_context_select_curbe (me_gpe_ctx, me_phase ? 0 : 1);
+  me_curbe_params.curbe_cmd_buff = media_gpe_context_curbe_begin (me_gpe_ctx);
   encoder_context->set_curbe_vp8_me (&me_curbe_params);
-  media_unmap_buffer_obj (me_gpe_ctx->dynamic_state.res.bo);
-  //batch = media_batchbuffer_new (&drv_ctx->drv_data, I915_EXEC_RENDER, 0);
-  //_(ctx, batch, me_gpe_ctx);
+  media_gpe_context_curbe_end (me_gpe_ctx);
 
   me_sutface_params.me_16x_in_use = me_16x;
   me_sutface_params.me_16x_enabled = encode_state->me_16x_enabled;
   me_sutface_params.me_surface_state_binding_table =
     &me_gpe_ctx->surface_state_binding_table;
 
-  //media_alloc_binding_surface_state(drv_ctx,&me_gpe_ctx->context->surface_state_binding_table);
   encoder_context->media_add_binding_table (me_gpe_ctx);
   encoder_context->surface_state_vp8_me (encoder_context, encode_state, &me_sutface_params);
 
 
-  batch = media_batchbuffer_new (&drv_ctx->drv_data, I915_EXEC_RENDER, 0);
+  batch = encoder_context->batch;
+  kernel_params.dependent = TRUE;
   kernel_params.idrt_kernel_offset = 0;
+  kernel_params.phase_name = me_16x ? "ME 16x" : "ME 4x";
   media_drv_generic_kernel_cmds (ctx, encoder_context, batch, me_gpe_ctx,
 				 &kernel_params);
 
@@ -877,7 +1200,6 @@ mediadrv_gen_encode_me (VADriverContextP ctx,
     (me_16x) ? encoder_context->down_scaled_width_mb16x : encoder_context->
     down_scaled_width_mb4x;
   encoder_context->media_object_walker_cmd (batch, &media_obj_walker_params);
-  media_batchbuffer_submit (batch);
 
   if (me_16x) {
     encode_state->me_16x_done = TRUE;
@@ -889,7 +1211,6 @@ mediadrv_gen_encode_brc_init_reset(VADriverContextP ctx,
                                    MEDIA_ENCODER_CTX * encoder_context,
                                    struct encode_state *encode_state)
 {
-  MEDIA_DRV_CONTEXT *drv_ctx = ctx->pDriverData;
   MEDIA_BRC_INIT_RESET_PARAMS_VP8 curbe_params;
   BRC_INIT_RESET_CONTEXT *brc_init_reset_context = &encoder_context->brc_init_reset_context;
   MEDIA_GPE_CTX *gpe_ctx = &brc_init_reset_context->gpe_context;
@@ -903,6 +1224,7 @@ mediadrv_gen_encode_brc_init_reset(VADriverContextP ctx,
     kernel_params.idrt_kernel_offset = BRC_INIT_OFFSET;
   else
     kernel_params.idrt_kernel_offset = BRC_RESET_OFFSET;
+  kernel_params.phase_name = "BRC init/reset";
 
   /* binding table */
   gpe_ctx->surface_state_binding_table =
@@ -929,11 +1251,22 @@ mediadrv_gen_encode_brc_init_reset(VADriverContextP ctx,
     &encoder_context->brc_init_reset_buf_size_in_bits;
   curbe_params.brc_init_reset_input_bits_per_frame =
     &encoder_context->brc_init_reset_input_bits_per_frame;
+  /* a temporal layer's BRC runs on the rate of its own frames */
+  if (encoder_context->brc_layer)
+    {
+      MEDIA_VP8_TEMPORAL_LAYER *layer = encoder_context->brc_layer;
+
+      curbe_params.target_bit_rate = layer->target_bit_rate;
+      curbe_params.max_bit_rate = layer->max_bit_rate;
+      curbe_params.min_bit_rate = layer->min_bit_rate;
+      curbe_params.init_vbv_buffer_fullness_in_bit =
+	layer->init_vbv_buffer_fullness_in_bit;
+      curbe_params.vbv_buffer_size_in_bit = layer->vbv_buffer_size_in_bit;
+    }
 
-  curbe_params.curbe_cmd_buff =
-    media_map_buffer_obj (gpe_ctx->dynamic_state.res.bo);
+  curbe_params.curbe_cmd_buff = media_gpe_context_curbe_begin (gpe_ctx);
   encoder_context->set_curbe_vp8_brc_init_reset(encode_state, &curbe_params);
-  media_unmap_buffer_obj (gpe_ctx->dynamic_state.res.bo);
+  media_gpe_context_curbe_end (gpe_ctx);
 
   /* surface & binding table */
   media_drv_memset (&surface_params, sizeof (surface_params));
@@ -944,7 +1277,8 @@ mediadrv_gen_encode_brc_init_reset(VADriverContextP ctx,
 						     &surface_params);
 
   /* kernels */
-  batch = media_batchbuffer_new (&drv_ctx->drv_data, I915_EXEC_RENDER, 0);
+  batch = encoder_context->batch;
+  kernel_params.dependent = FALSE;
   media_drv_generic_kernel_cmds (ctx,
 				 encoder_context,
 				 batch,
@@ -956,7 +1290,6 @@ mediadrv_gen_encode_brc_init_reset(VADriverContextP ctx,
   media_object_params.use_scoreboard = 0;
   media_object_cmd(batch, &media_object_params);
 
-  media_batchbuffer_submit (batch);
 }
 
 VOID
@@ -964,7 +1297,6 @@ mediadrv_gen_encode_brc_update(VADriverContextP ctx,
                                MEDIA_ENCODER_CTX * encoder_context,
                                struct encode_state *encode_state)
 {
-  MEDIA_DRV_CONTEXT *drv_ctx = ctx->pDriverData;
   MEDIA_BRC_UPDATE_PARAMS_VP8 curbe_params;
   BRC_UPDATE_CONTEXT *brc_update_context = &encoder_context->brc_update_context;
   MEDIA_GPE_CTX *gpe_ctx = &brc_update_context->gpe_context;
@@ -983,7 +1315,6 @@ mediadrv_gen_encode_brc_update(VADriverContextP ctx,
   BRC_INIT_RESET_CONTEXT *brc_init_reset_context = &encoder_context->brc_init_reset_context;
   BRC_UPDATE_CONSTANT_DATA_PARAMS_VP8 constant_data_params;
 
-  VOID *buf = NULL;
   UINT ref_frame_flag_final, ref_frame_flag;
 
   /* setup mbenc curbe ??? */
@@ -1038,8 +1369,10 @@ mediadrv_gen_encode_brc_update(VADriverContextP ctx,
   encoder_context->ref_frame_ctrl = ref_frame_flag_final;
   mbenc_curbe_params.ref_frame_ctrl = encoder_context->ref_frame_ctrl;
 
-  buf = media_map_buffer_obj (mbenc_gpe_ctx->dynamic_state.res.bo);
-  mbenc_curbe_params.curbe_cmd_buff = buf;
+  /* the BRC update kernel patches the MBEnc CURBE in slot 0 */
+  media_gpe_context_select_curbe (mbenc_gpe_ctx, 0);
+  mbenc_curbe_params.curbe_cmd_buff =
+    media_gpe_context_curbe_begin (mbenc_gpe_ctx);
 
   if (encoder_context->pic_coding_type == FRAME_TYPE_I) {
     encoder_context->set_curbe_i_vp8_mbenc (encode_state, &mbenc_curbe_params);
@@ -1047,31 +1380,32 @@ mediadrv_gen_encode_brc_update(VADriverContextP ctx,
     encoder_context->set_curbe_p_vp8_mbenc (encode_state, &mbenc_curbe_params);
   }
 
-  media_unmap_buffer_obj (mbenc_gpe_ctx->dynamic_state.res.bo);
+  media_gpe_context_curbe_end (mbenc_gpe_ctx);
 
   encoder_context->mbenc_curbe_set_brc_update = TRUE;
 
   /* setup mbpak curbe ??? */
   mbpak_gpe_ctx = &mbpak_ctx->gpe_context;
   mbpak_curbe_params.curbe_cmd_buff =
-    media_map_buffer_obj (mbpak_gpe_ctx->dynamic_state.res.bo);
+    media_gpe_context_curbe_begin (mbpak_gpe_ctx);
   mbpak_curbe_params.updated = 0;
   mbpak_curbe_params.pak_phase_type = MBPAK_HYBRID_STATE_P1;
   encoder_context->set_curbe_vp8_mbpak (encode_state, &mbpak_curbe_params);
-  media_unmap_buffer_obj (mbpak_gpe_ctx->dynamic_state.res.bo);
+  media_gpe_context_curbe_end (mbpak_gpe_ctx);
 
   mbpak_gpe_ctx = &mbpak_ctx->gpe_context2;
   mbpak_curbe_params.curbe_cmd_buff =
-    media_map_buffer_obj (mbpak_gpe_ctx->dynamic_state.res.bo);
+    media_gpe_context_curbe_begin (mbpak_gpe_ctx);
   mbpak_curbe_params.updated = 0;
   mbpak_curbe_params.pak_phase_type = MBPAK_HYBRID_STATE_P2;
   encoder_context->set_curbe_vp8_mbpak (encode_state, &mbpak_curbe_params);
-  media_unmap_buffer_obj (mbpak_gpe_ctx->dynamic_state.res.bo);
+  media_gpe_context_curbe_end (mbpak_gpe_ctx);
 
   encoder_context->mbpak_curbe_set_brc_update = TRUE;
 
   /* kernel id */
   kernel_params.idrt_kernel_offset = BRC_UPDATE_OFFSET;
+  kernel_params.phase_name = "BRC update";
 
   /* binding table */
   gpe_ctx->surface_state_binding_table =
@@ -1094,15 +1428,33 @@ mediadrv_gen_encode_brc_update(VADriverContextP ctx,
   curbe_params.brc_init_reset_input_bits_per_frame =
     encoder_context->brc_init_reset_input_bits_per_frame;
   curbe_params.frame_update = &encoder_context->frame_update;
-
-  curbe_params.curbe_cmd_buff =
-    media_map_buffer_obj (gpe_ctx->dynamic_state.res.bo);
+  curbe_params.lookahead_target_bits = 0;
+  curbe_params.qp_hint_valid = FALSE;
+  curbe_params.qp_hint = 0;
+  /* the lookahead models a single layer stream */
+  if (encoder_context->lookahead && !encoder_context->brc_layer)
+    curbe_params.qp_hint_valid =
+      media_vp8_lookahead_plan (encoder_context->lookahead,
+				encoder_context->pic_coding_type == FRAME_TYPE_I,
+				encoder_context->brc_init_reset_input_bits_per_frame,
+				encoder_context->frame_update.prev_frame_size,
+				encoder_context->frame_update.ref_q_index[2],
+				&curbe_params.lookahead_target_bits,
+				&curbe_params.qp_hint);
+
+  curbe_params.curbe_cmd_buff = media_gpe_context_curbe_begin (gpe_ctx);
   encoder_context->set_curbe_vp8_brc_update(encode_state, &curbe_params);
-  media_unmap_buffer_obj (gpe_ctx->dynamic_state.res.bo);
+  media_gpe_context_curbe_end (gpe_ctx);
 
-  /* init constant data surface */
-  constant_data_params.brc_update_constant_data = &brc_init_reset_context->brc_constant_data;
-  encoder_context->init_brc_update_constant_data_vp8(&constant_data_params);
+  /* init constant data surface, the tables never change so they are
+   * written once instead of mapping a buffer the GPU may still read */
+  if (!brc_init_reset_context->brc_constant_data_initted)
+    {
+      constant_data_params.brc_update_constant_data =
+	&brc_init_reset_context->brc_constant_data;
+      encoder_context->init_brc_update_constant_data_vp8 (&constant_data_params);
+      brc_init_reset_context->brc_constant_data_initted = TRUE;
+    }
 
   /* surface & binding table */
   media_drv_memset (&surface_params, sizeof (surface_params));
@@ -1113,7 +1465,8 @@ mediadrv_gen_encode_brc_update(VADriverContextP ctx,
 						 &surface_params);
 
   /* kernels */
-  batch = media_batchbuffer_new (&drv_ctx->drv_data, I915_EXEC_RENDER, 0);
+  batch = encoder_context->batch;
+  kernel_params.dependent = TRUE;
   media_drv_generic_kernel_cmds (ctx,
 				 encoder_context,
 				 batch,
@@ -1124,7 +1477,11 @@ mediadrv_gen_encode_brc_update(VADriverContextP ctx,
   media_object_params.interface_offset = 0;
   media_object_params.use_scoreboard = 0;
   media_object_cmd(batch, &media_object_params);
-  media_batchbuffer_submit (batch);
+
+  /* the kernel rewrites parts of the MBEnc and MBPAK CURBEs */
+  media_gpe_context_curbe_invalidate (mbenc_gpe_ctx, 0);
+  media_gpe_context_curbe_invalidate (&mbpak_ctx->gpe_context, 0);
+  media_gpe_context_curbe_invalidate (&mbpak_ctx->gpe_context2, 0);
 }
 
 VAStatus
@@ -1139,6 +1496,8 @@ media_encode_kernel_functions (VADriverContextP ctx,
   encoder_context->mbenc_curbe_set_brc_update = FALSE;
   encoder_context->mbpak_curbe_set_brc_update = FALSE;
 
+  media_encoder_batch_begin (ctx, encoder_context);
+
   if (encoder_context->brc_enabled) {
        if (!encoder_context->brc_initted ||
 	  encoder_context->brc_need_reset) {
@@ -1202,6 +1561,8 @@ media_encode_kernel_functions (VADriverContextP ctx,
   mediadrv_gen_encode_mbpak (ctx, encoder_context, encode_state,
 			     MBPAK_HYBRID_STATE_P2);
 
+  media_encoder_batch_end (encoder_context);
+
   if (encoder_context->brc_enabled) {
     encoder_context->mbenc_curbe_set_brc_update = FALSE;
     encoder_context->mbpak_curbe_set_brc_update = FALSE;
@@ -1336,7 +1697,6 @@ media_get_pic_params_vp8_encode (VADriverContextP ctx,
     (VAEncPictureParameterBufferVP8 *) encode_state->pic_param_ext->buffer;
   INT picture_coding_type;
   struct object_surface *obj_surface;
-  CHAR *coded_buf;
 
   encoder_context->pic_coding_type =
     pic_param->pic_flags.bits.frame_type ? FRAME_TYPE_P : FRAME_TYPE_I;
@@ -1380,10 +1740,9 @@ media_get_pic_params_vp8_encode (VADriverContextP ctx,
     return VA_STATUS_ERROR_INVALID_PARAMETER;
 
   encode_state->coded_buf_surface = obj_surface;
-  coded_buf =
-    (CHAR *) media_map_buffer_obj (encode_state->coded_buf_surface->bo);
-  media_drv_memset (coded_buf, encode_state->coded_buf_surface->bo->size);
-  media_unmap_buffer_obj (encode_state->coded_buf_surface->bo);
+  /* only an application reusing the coded buffer still being packed has
+   * to wait for the packer, other frames overlap with it */
+  media_vp8_packer_sync_surface (obj_surface);
 
   //ref frame
   if (pic_param->ref_last_frame != VA_INVALID_SURFACE)
@@ -1526,6 +1885,55 @@ media_get_frame_update_params_vp8_encode (VADriverContextP ctx,
   memcpy(&encoder_context->frame_update, misc, sizeof(MEDIA_FRAME_UPDATE));
 }
 
+VOID
+media_get_lookahead_params_vp8_encode (VADriverContextP ctx,
+                                       MEDIA_ENCODER_CTX *encoder_context,
+                                       VAEncMiscParameterVP8HybridLookahead *misc)
+{
+  MEDIA_VP8_LOOKAHEAD *lookahead = encoder_context->lookahead;
+
+  if (lookahead &&
+      (lookahead->mb_cols != encoder_context->picture_width_in_mbs ||
+       lookahead->mb_rows != encoder_context->picture_height_in_mbs)) {
+    media_vp8_lookahead_destroy (lookahead);
+    lookahead = NULL;
+  }
+  if (lookahead == NULL)
+    lookahead = media_vp8_lookahead_create (encoder_context->picture_width_in_mbs,
+					    encoder_context->picture_height_in_mbs);
+  encoder_context->lookahead = lookahead;
+  if (lookahead)
+    media_vp8_lookahead_set_window (lookahead, misc);
+}
+
+#if VA_CHECK_VERSION(0,40,0)
+VOID
+media_get_temporal_layer_params_vp8_encode (VADriverContextP ctx,
+                                            MEDIA_ENCODER_CTX *encoder_context,
+                                            VAEncMiscParameterTemporalLayerStructure *misc)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = ctx->pDriverData;
+  MEDIA_VP8_TEMPORAL_LAYERS *tl = encoder_context->temporal_layers;
+
+  /* the driver has to write the frame headers with the layer's flags */
+  if (tl == NULL && misc->number_of_layers > 1 && encoder_context->vp8_packer)
+    tl = media_vp8_temporal_layers_create (drv_ctx->drv_data.bufmgr,
+					   &encoder_context->
+					   brc_init_reset_context.brc_history);
+  if (tl == NULL)
+    return;
+  encoder_context->temporal_layers = tl;
+
+  if (!media_vp8_temporal_layers_set_structure (tl, misc->number_of_layers,
+						misc->periodicity,
+						misc->layer_id))
+    {
+      /* back to one layer, whose BRC state is stale */
+      media_encoder_temporal_layers_destroy (encoder_context);
+      encoder_context->brc_initted = 0;
+    }
+}
+#endif
 
 static VAStatus
 media_get_misc_params_vp8_encode (VADriverContextP ctx,
@@ -1579,6 +1987,22 @@ media_get_misc_params_vp8_encode (VADriverContextP ctx,
 					       (VAEncMiscParameterVP8HybridFrameUpdate *)misc_param->data);
       break;
 
+    case VAEncMiscParameterTypeVP8HybridLookahead:
+      media_get_lookahead_params_vp8_encode(ctx,
+					    encoder_context,
+					    (VAEncMiscParameterVP8HybridLookahead *)misc_param->data);
+      /* the window is only valid for the frame it came with */
+      media_release_buffer_store (&encode_state->misc_param[i]);
+      break;
+
+#if VA_CHECK_VERSION(0,40,0)
+    case VAEncMiscParameterTypeTemporalLayerStructure:
+      media_get_temporal_layer_params_vp8_encode(ctx,
+						 encoder_context,
+						 (VAEncMiscParameterTemporalLayerStructure *)misc_param->data);
+      break;
+#endif
+
     default:
       break;
     }
@@ -1587,6 +2011,282 @@ media_get_misc_params_vp8_encode (VADriverContextP ctx,
   return VA_STATUS_SUCCESS;
 }
 
+static VOID
+media_encoder_scene_cut_vp8 (VADriverContextP ctx,
+			     MEDIA_ENCODER_CTX * encoder_context,
+			     struct encode_state *encode_state)
+{
+  VAEncSequenceParameterBufferVP8 *seq_param =
+    (VAEncSequenceParameterBufferVP8 *) encode_state->seq_param_ext->buffer;
+  VAEncPictureParameterBufferVP8 *pic_param =
+    (VAEncPictureParameterBufferVP8 *) encode_state->pic_param_ext->buffer;
+  MEDIA_VP8_SCENE_CUT *scene_cut = encoder_context->scene_cut;
+
+  encoder_context->key_frame_inserted = FALSE;
+
+  /* with the MB data output the application writes the frame header */
+  if (!seq_param->kf_auto || !encoder_context->vp8_packer)
+    return;
+
+  if (scene_cut &&
+      (scene_cut->mb_cols != encoder_context->picture_width_in_mbs ||
+       scene_cut->mb_rows != encoder_context->picture_height_in_mbs))
+    {
+      media_vp8_scene_cut_destroy (scene_cut);
+      scene_cut = NULL;
+    }
+  if (scene_cut == NULL)
+    scene_cut =
+      media_vp8_scene_cut_create (encoder_context->picture_width_in_mbs,
+				  encoder_context->picture_height_in_mbs);
+  encoder_context->scene_cut = scene_cut;
+  if (scene_cut == NULL)
+    return;
+
+  if (!media_vp8_scene_cut_detect (ctx, scene_cut,
+				   encoder_context->input_yuv_surface,
+				   encoder_context->pic_coding_type ==
+				   FRAME_TYPE_I, seq_param->kf_min_dist))
+    return;
+
+  /* the picture parameters also drive the kernels and the packer */
+  pic_param->pic_flags.bits.frame_type = 0;
+  encoder_context->pic_coding_type = FRAME_TYPE_I;
+  encoder_context->ref_frame_ctrl = 0;
+  encode_state->hme_enabled = FALSE;
+  encode_state->me_16x_enabled = FALSE;
+  if (encoder_context->brc_enabled)
+    encoder_context->brc_need_reset = 1;
+  encoder_context->key_frame_inserted = TRUE;
+}
+
+/*
+ * Rates of the temporal layers as the application sent them, cumulative,
+ * 0 for a layer without its own RateControl. The top layer's also set
+ * the stream rate the encoder context got from the base layer's.
+ */
+static VOID
+media_encoder_temporal_layer_rates_vp8 (MEDIA_ENCODER_CTX * encoder_context,
+					struct encode_state *encode_state,
+					UINT * layer_bit_rate,
+					UINT * target_bit_rate,
+					UINT * max_bit_rate, UINT * min_bit_rate)
+{
+  MEDIA_VP8_TEMPORAL_LAYERS *tl = encoder_context->temporal_layers;
+  INT i;
+
+  *target_bit_rate = encoder_context->target_bit_rate;
+  *max_bit_rate = encoder_context->max_bit_rate;
+  *min_bit_rate = encoder_context->min_bit_rate;
+  media_drv_memset (layer_bit_rate, VP8_MAX_TEMPORAL_LAYERS * sizeof (UINT));
+
+#if VA_CHECK_VERSION(0,40,0)
+  for (i = 0; i < tl->num_layers; i++)
+    {
+      VAEncMiscParameterRateControl *rc;
+
+      if (!encode_state->layer_rate_control[i])
+	continue;
+      rc = (VAEncMiscParameterRateControl *)
+	((VAEncMiscParameterBuffer *) encode_state->layer_rate_control[i]->
+	 buffer)->data;
+      layer_bit_rate[i] = rc->bits_per_second;
+      if (encoder_context->rate_control_mode == VA_RC_VBR)
+	layer_bit_rate[i] =
+	  (UINT) ((uint64_t) rc->bits_per_second * rc->target_percentage / 100);
+
+      if (i == tl->num_layers - 1)
+	{
+	  *target_bit_rate = layer_bit_rate[i];
+	  *max_bit_rate = layer_bit_rate[i];
+	  *min_bit_rate = layer_bit_rate[i];
+	  if (encoder_context->rate_control_mode == VA_RC_VBR)
+	    {
+	      *max_bit_rate = rc->bits_per_second;
+	      *min_bit_rate = (UINT) ((uint64_t) rc->bits_per_second *
+				      (2 * rc->target_percentage - 100) / 100);
+	    }
+	}
+    }
+
+  i = tl->num_layers - 1;
+  if (encode_state->layer_frame_rate[i])
+    {
+      VAEncMiscParameterFrameRate *fr = (VAEncMiscParameterFrameRate *)
+	((VAEncMiscParameterBuffer *) encode_state->layer_frame_rate[i]->
+	 buffer)->data;
+
+      /* the BRC of every layer counts frames at the full frame rate */
+      if (fr->framerate >= 100)
+	encoder_context->frame_rate = fr->framerate / 100;
+    }
+#endif
+}
+
+/*
+ * Temporal layers: the layer of the frame picks the references and the
+ * slot it refreshes, written to the picture parameters the kernels and
+ * the packer read, and its BRC state is loaded in place of the stream's
+ * until media_encoder_temporal_layers_end_vp8.
+ */
+static VOID
+media_encoder_temporal_layers_vp8 (VADriverContextP ctx,
+				   MEDIA_ENCODER_CTX * encoder_context,
+				   struct encode_state *encode_state)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = ctx->pDriverData;
+  VAEncPictureParameterBufferVP8 *pic_param =
+    (VAEncPictureParameterBufferVP8 *) encode_state->pic_param_ext->buffer;
+  VAQMatrixBufferVP8 *quant_params =
+    (VAQMatrixBufferVP8 *) encode_state->q_matrix->buffer;
+  MEDIA_VP8_TEMPORAL_LAYERS *tl = encoder_context->temporal_layers;
+  MEDIA_VP8_TEMPORAL_REFS *refs = &encoder_context->temporal_refs;
+  MEDIA_VP8_TEMPORAL_LAYER *layer;
+  VASurfaceID *ref_id[VP8_NUM_REFS];
+  struct object_surface **ref_object[VP8_NUM_REFS];
+  struct object_surface *obj_surface;
+  UINT layer_bit_rate[VP8_MAX_TEMPORAL_LAYERS];
+  UINT target_bit_rate, max_bit_rate, min_bit_rate;
+  UINT ctrl;
+  BOOL key_frame;
+  INT i;
+
+  encoder_context->brc_layer = NULL;
+  if (tl == NULL)
+    return;
+
+  ref_id[VP8_REF_LAST] = &pic_param->ref_last_frame;
+  ref_id[VP8_REF_GOLDEN] = &pic_param->ref_gf_frame;
+  ref_id[VP8_REF_ALTREF] = &pic_param->ref_arf_frame;
+  ref_object[VP8_REF_LAST] = &encode_state->ref_last_frame;
+  ref_object[VP8_REF_GOLDEN] = &encode_state->ref_gf_frame;
+  ref_object[VP8_REF_ALTREF] = &encode_state->ref_arf_frame;
+
+  /* the first layered frame starts from the application's references */
+  if (!tl->prev_valid)
+    {
+      VASurfaceID surface[VP8_NUM_REFS];
+
+      for (i = 0; i < VP8_NUM_REFS; i++)
+	surface[i] = *ref_id[i];
+      media_vp8_temporal_layers_set_refs (tl, surface,
+					  encoder_context->frame_update.
+					  ref_q_index);
+    }
+  for (i = 0; i < VP8_NUM_REFS; i++)
+    {
+      obj_surface = NULL;
+      if (tl->ref_surface[i] != VA_INVALID_SURFACE)
+	obj_surface = SURFACE (tl->ref_surface[i]);
+      if (!obj_surface || !obj_surface->bo)
+	tl->ref_surface[i] = VA_INVALID_SURFACE;
+    }
+
+  key_frame = encoder_context->pic_coding_type == FRAME_TYPE_I;
+  if (!key_frame && tl->ref_surface[VP8_REF_LAST] == VA_INVALID_SURFACE)
+    {
+      /* nothing left the base layer may predict from */
+      pic_param->pic_flags.bits.frame_type = 0;
+      encoder_context->pic_coding_type = FRAME_TYPE_I;
+      encode_state->hme_enabled = FALSE;
+      encode_state->me_16x_enabled = FALSE;
+      if (encoder_context->brc_enabled)
+	encoder_context->brc_need_reset = 1;
+      encoder_context->key_frame_inserted = TRUE;
+      key_frame = TRUE;
+    }
+
+  media_vp8_temporal_layers_frame_size (tl,
+					encoder_context->frame_update.
+					prev_frame_size);
+  media_vp8_temporal_layers_next (tl, key_frame, refs);
+
+  ctrl = 0;
+  for (i = 0; i < VP8_NUM_REFS; i++)
+    {
+      *ref_id[i] = refs->surface[i];
+      *ref_object[i] = NULL;
+      if (refs->surface[i] != VA_INVALID_SURFACE)
+	*ref_object[i] = SURFACE (refs->surface[i]);
+      encoder_context->frame_update.ref_q_index[i] = refs->q_index[i];
+      if (refs->ref[i])
+	ctrl |= 1 << i;
+    }
+  if (encoder_context->disable_multi_ref)
+    ctrl &= 1;
+  encoder_context->ref_frame_ctrl = ctrl;
+
+  pic_param->ref_flags.bits.no_ref_last = !(ctrl & (1 << VP8_REF_LAST));
+  pic_param->ref_flags.bits.no_ref_gf = !(ctrl & (1 << VP8_REF_GOLDEN));
+  pic_param->ref_flags.bits.no_ref_arf = !(ctrl & (1 << VP8_REF_ALTREF));
+  pic_param->pic_flags.bits.refresh_last = refs->refresh[VP8_REF_LAST];
+  pic_param->pic_flags.bits.refresh_golden_frame =
+    refs->refresh[VP8_REF_GOLDEN];
+  pic_param->pic_flags.bits.refresh_alternate_frame =
+    refs->refresh[VP8_REF_ALTREF];
+  pic_param->pic_flags.bits.copy_buffer_to_golden = 0;
+  pic_param->pic_flags.bits.copy_buffer_to_alternate = 0;
+  pic_param->pic_flags.bits.sign_bias_golden = 0;
+  pic_param->pic_flags.bits.sign_bias_alternate = 0;
+  /* no decoder state may depend on a frame of a dropped layer */
+  if (!key_frame)
+    pic_param->pic_flags.bits.refresh_entropy_probs = 0;
+  if (pic_param->pic_flags.bits.segmentation_enabled)
+    {
+      pic_param->pic_flags.bits.update_mb_segmentation_map = 1;
+      pic_param->pic_flags.bits.update_segment_feature_data = 1;
+    }
+
+  media_vp8_temporal_layers_update (tl, refs, pic_param->reconstructed_frame,
+				    quant_params->quantization_index[0]);
+
+  if (!encoder_context->brc_enabled)
+    return;
+
+  media_encoder_temporal_layer_rates_vp8 (encoder_context, encode_state,
+					  layer_bit_rate, &target_bit_rate,
+					  &max_bit_rate, &min_bit_rate);
+  /* a stream wide reset, a key frame or a new rate, resets every layer */
+  if (encoder_context->brc_need_reset)
+    for (i = 0; i < tl->num_layers; i++)
+      if (tl->layers[i].brc_initted)
+	tl->layers[i].brc_need_reset = TRUE;
+  media_vp8_temporal_layers_set_rate (tl, refs->layer, layer_bit_rate,
+				      target_bit_rate, max_bit_rate,
+				      min_bit_rate,
+				      encoder_context->vbv_buffer_size_in_bit,
+				      encoder_context->
+				      init_vbv_buffer_fullness_in_bit);
+
+  layer = &tl->layers[refs->layer];
+  encoder_context->brc_initted = layer->brc_initted;
+  encoder_context->brc_need_reset = layer->brc_need_reset;
+  encoder_context->brc_init_current_target_buf_full_in_bits =
+    layer->buf_full_in_bits;
+  encoder_context->brc_init_reset_input_bits_per_frame =
+    layer->input_bits_per_frame;
+  encoder_context->brc_init_reset_buf_size_in_bits = layer->buf_size_in_bits;
+  encoder_context->frame_update.prev_frame_size = layer->prev_frame_size;
+  encoder_context->brc_init_reset_context.brc_history = layer->brc_history;
+  encoder_context->brc_layer = layer;
+}
+
+static VOID
+media_encoder_temporal_layers_end_vp8 (MEDIA_ENCODER_CTX * encoder_context)
+{
+  MEDIA_VP8_TEMPORAL_LAYER *layer = encoder_context->brc_layer;
+
+  if (layer == NULL)
+    return;
+  layer->brc_initted = encoder_context->brc_initted;
+  layer->brc_need_reset = FALSE;
+  layer->buf_full_in_bits =
+    encoder_context->brc_init_current_target_buf_full_in_bits;
+  layer->input_bits_per_frame =
+    encoder_context->brc_init_reset_input_bits_per_frame;
+  layer->buf_size_in_bits = encoder_context->brc_init_reset_buf_size_in_bits;
+}
+
 static VAStatus
 media_encoder_get_yuv_surface (VADriverContextP ctx,
 			       VAProfile profile,
@@ -1612,7 +2312,7 @@ media_encoder_get_yuv_surface (VADriverContextP ctx,
   if (obj_surface->fourcc == VA_FOURCC ('N', 'V', '1', '2'))
     {
       UINT tiling = 0, swizzle = 0;
-      dri_bo_get_tiling (obj_surface->bo, &tiling, &swizzle);
+      media_bo_get_tiling (obj_surface->bo, &tiling, &swizzle);
 
       if (tiling == I915_TILING_Y)
 	{
@@ -1718,7 +2418,7 @@ VOID
 media_free_binding_surface_state (SURFACE_STATE_BINDING_TABLE *
 				  surface_state_binding_table)
 {
-  dri_bo_unreference (surface_state_binding_table->res.bo);
+  media_bo_unreference (surface_state_binding_table->res.bo);
   surface_state_binding_table->res.bo = NULL;
 }
 
@@ -1929,7 +2629,33 @@ media_kernel_init (VADriverContextP ctx,
   return status;
 }
 
-static VAStatus
+/*
+ * Only clears the parts of the coded buffer no kernel writes this frame:
+ * the segment header and BRC frame header in front of the MB code, and
+ * the MV area on I frames, where MBEnc does not write MVs. MBEnc and
+ * MBPAK rewrite every MB code record, so clearing the whole buffer only
+ * cost megabytes of CPU writes per frame.
+ */
+static VOID
+media_encoder_clear_coded_buffer_vp8 (MEDIA_ENCODER_CTX * encoder_context,
+				      struct encode_state *encode_state)
+{
+  dri_bo *bo = encode_state->coded_buf_surface->bo;
+  UINT header_size = MAX (encoder_context->mb_data_offset,
+			  I965_CODEDBUFFER_HEADER_SIZE);
+  BYTE *coded_buf;
+
+  coded_buf = (BYTE *) media_map_buffer_obj (bo);
+  media_drv_memset (coded_buf, MIN (header_size, bo->size));
+  if (encoder_context->pic_coding_type == FRAME_TYPE_I &&
+      encoder_context->mv_offset < bo->size)
+    media_drv_memset (coded_buf + encoder_context->mv_offset,
+		      MIN (encoder_context->mv_in_bytes,
+			   bo->size - encoder_context->mv_offset));
+  media_unmap_buffer_obj (bo);
+}
+
+VAStatus
 media_encoder_picture_init (VADriverContextP ctx, VAProfile profile,
 			    MEDIA_ENCODER_CTX * encoder_context,
 			    struct encode_state *encode_state)
@@ -1956,12 +2682,16 @@ media_encoder_picture_init (VADriverContextP ctx, VAProfile profile,
   if (status != VA_STATUS_SUCCESS)
     return status;
 
+  if (encoder_context->lookahead)
+    encoder_context->lookahead->num_upcoming = 0;
   status =
     media_get_misc_params_vp8_encode (ctx, encoder_context, encode_state);
 
   if (status != VA_STATUS_SUCCESS)
     return status;
 
+  media_encoder_scene_cut_vp8 (ctx, encoder_context, encode_state);
+
   if (VA_RC_CQP == encoder_context->rate_control_mode) {
     encoder_context->internal_rate_mode = HB_BRC_CQP;
     encoder_context->target_bit_rate = 0;
@@ -1977,6 +2707,13 @@ media_encoder_picture_init (VADriverContextP ctx, VAProfile profile,
     encoder_context->internal_rate_mode = HB_BRC_VBR;
   }
 
+  media_encoder_temporal_layers_vp8 (ctx, encoder_context, encode_state);
+
+  if (encoder_context->lookahead && encoder_context->brc_enabled &&
+      !encoder_context->brc_layer)
+    media_vp8_lookahead_analyze (ctx, encoder_context->lookahead,
+				 encoder_context->input_yuv_surface);
+
   encoder_context->init_brc_distortion_buffer = 0;
   media_encoder_init_priv_surfaces(ctx,
 				   encoder_context,
@@ -1993,6 +2730,7 @@ media_encoder_picture_init (VADriverContextP ctx, VAProfile profile,
     }
   }
 
+  media_encoder_clear_coded_buffer_vp8 (encoder_context, encode_state);
   media_kernel_init (ctx, encoder_context, encode_state);
 
   return status;
@@ -2010,6 +2748,7 @@ media_encoder_picture (VADriverContextP ctx,
 #ifdef DEBUG
   printf ("media_encoder_picture\n");
 #endif
+  media_encoder_next_frame (encoder_context);
   status =
     media_encoder_picture_init (ctx, profile, encoder_context, encode_state);
 #if 0
@@ -2023,11 +2762,23 @@ media_encoder_picture (VADriverContextP ctx,
   if (status != VA_STATUS_SUCCESS)
     return status;
 #endif
+  media_encoder_temporal_layers_end_vp8 (encoder_context);
   status = media_kernel_dinit (ctx, encoder_context, encode_state);
 #if 0
   if (status != VA_STATUS_SUCCESS)
     return status;
 #endif
+  /* packs on its own thread once MBPAK has written the coded buffer */
+  if (encoder_context->vp8_packer)
+    status = media_vp8_packer_submit (encoder_context->vp8_packer,
+				      encode_state,
+				      encoder_context->mb_data_offset,
+				      MB_CODE_SIZE_VP8 * sizeof (UINT),
+				      encoder_context->mv_offset,
+				      MB_MV_CODE_SIZE_VP8,
+				      encoder_context->key_frame_inserted ?
+				      VA_CODED_BUF_STATUS_HYBRID_KEY_FRAME_INSERTED
+				      : 0);
 
   encoder_context->frame_num = encoder_context->frame_num + 1;
   encoder_context->brc_need_reset = 0;
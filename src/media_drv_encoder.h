@@ -32,6 +32,10 @@
 #include "media_drv_gpe_utils.h"
 #include "media_drv_util.h"
 #include "media_drv_hw.h"
+#include "media_drv_encoder_vp8_packer.h"
+#include "media_drv_encoder_vp8_lookahead.h"
+#include "media_drv_encoder_vp8_scenecut.h"
+#include "media_drv_encoder_vp8_tlayers.h"
 //#define WIDTH_IN_MACROBLOCKS(width)      (((width) + (16 - 1)) / 16)
 //#define HEIGHT_IN_MACROBLOCKS(height)    (((height) + (16 - 1)) / 16)
 
@@ -40,6 +44,32 @@
 #define HB_BRC_VBR	2
 #define HB_BRC_CQP	3
 
+/* frames whose kernel state may be queued on the GPU at the same time */
+#define VP8_ENCODE_FRAMES_IN_FLIGHT	3
+#define VP8_ENCODE_NUM_GPE_CTX		7
+
+#define MEDIA_TIMESTAMP_MAX_PHASES	16
+/* render engine timestamp at 80 ns, the low dword wraps after 343 s */
+#define MEDIA_GPU_TIMESTAMP_NS		80
+
+/*
+ * GPU timestamps before and after every kernel phase. Each frame in
+ * flight records into its own buffer, which is read back when a later
+ * frame reuses it.
+ */
+typedef struct _media_gpu_timestamps
+{
+  MEDIA_RESOURCE res[VP8_ENCODE_FRAMES_IN_FLIGHT];
+  UINT slot;
+  UINT frame_num[VP8_ENCODE_FRAMES_IN_FLIGHT];
+  UINT num_phases[VP8_ENCODE_FRAMES_IN_FLIGHT];
+  const CHAR *phase_name[VP8_ENCODE_FRAMES_IN_FLIGHT]
+    [MEDIA_TIMESTAMP_MAX_PHASES];
+  BOOL phase_open;
+  VADriverContextP ctx;
+  FILE *file;			/* the counters file, or NULL to log */
+} MEDIA_GPU_TIMESTAMPS;
+
 typedef struct _scaling_kernel_params
 {
   bool scaling_16x_en;
@@ -102,6 +132,7 @@ typedef struct _brc_init_reset_context
   MEDIA_RESOURCE brc_history;
   MEDIA_RESOURCE brc_pak_qp_input_table;
   MEDIA_RESOURCE brc_constant_data;
+  BOOL brc_constant_data_initted;
   MEDIA_RESOURCE brc_constant_buffer[NUM_BRC_CONSTANT_DATA_BUFFERS];
   SURFACE_STATE_BINDING_TABLE surface_state_binding_table_brc_init_reset;
 } BRC_INIT_RESET_CONTEXT;
@@ -126,6 +157,10 @@ typedef struct media_encoder_ctx
   SCALING_CONTEXT scaling_context;
   BRC_INIT_RESET_CONTEXT brc_init_reset_context;
   BRC_UPDATE_CONTEXT brc_update_context;
+  /* one batch records all kernel phases of a frame */
+  MEDIA_BATCH_BUFFER *batch;
+  MEDIA_BATCH_STATE batch_state;
+  MEDIA_GPU_TIMESTAMPS *timestamps;
   int num_of_kernels;
   unsigned int walker_mode;
   unsigned int kernel_mode;
@@ -190,6 +225,15 @@ typedef struct media_encoder_ctx
   ULONG init_vbv_buffer_fullness_in_bit;
   ULONG vbv_buffer_size_in_bit;
   MEDIA_FRAME_UPDATE frame_update;
+  UINT encode_output;
+  MEDIA_VP8_PACKER *vp8_packer;
+  MEDIA_VP8_LOOKAHEAD *lookahead;
+  MEDIA_VP8_SCENE_CUT *scene_cut;
+  BOOL key_frame_inserted;
+  MEDIA_VP8_TEMPORAL_LAYERS *temporal_layers;
+  MEDIA_VP8_TEMPORAL_REFS temporal_refs;
+  /* layer whose BRC state is loaded for the current frame */
+  MEDIA_VP8_TEMPORAL_LAYER *brc_layer;
 
   void (*set_curbe_i_vp8_mbenc) (struct encode_state * encode_state,
 				 MEDIA_MBENC_CURBE_PARAMS_VP8 * params);
@@ -222,8 +266,7 @@ typedef struct media_encoder_ctx
   void (*media_object_walker_mbenc_init)(BOOL mbenc_i_frame_dist_in_use,BOOL mbenc_phase_2,struct media_encoder_ctx * encoder_context,MEDIA_OBJ_WALKER_PARAMS *media_obj_walker_params);
   void (*gpe_context_vfe_scoreboardinit_pak_p1) (struct media_encoder_ctx * encoder_context,MEDIA_GPE_CTX * gpe_context);
   void (*gpe_context_vfe_scoreboardinit_pak_p2) (struct media_encoder_ctx * encoder_context,MEDIA_GPE_CTX * gpe_context);
-  STATUS (*mediadrv_gen_state_base_address_cmd) (MEDIA_BATCH_BUFFER * batch,STATE_BASE_ADDR_PARAMS * params);
-  STATUS (*mediadrv_gen_media_vfe_state_cmd) (MEDIA_BATCH_BUFFER * batch,VFE_STATE_PARAMS * params);
+  VOID (*mediadrv_gen_state_cmds_build) (MEDIA_GPE_CTX * gpe_context);
    STATUS (*media_object_walker_cmd) (MEDIA_BATCH_BUFFER * batch,MEDIA_OBJ_WALKER_PARAMS * params);
   STATUS (*set_curbe_scaling) (MEDIA_GPE_CTX * gpe_context, SCALING_CURBE_PARAMS * params);
   void (*surface_state_scaling) (struct media_encoder_ctx * encoder_context, SCALING_SURFACE_PARAMS * scaling_sutface_params);
@@ -264,6 +307,16 @@ media_encoder_picture (VADriverContextP ctx,
 		       VAProfile profile,
 		       union codec_state *codec_state,
 		       struct hw_context *hw_context);
+VOID
+media_drv_generic_kernel_cmds (VADriverContextP ctx,
+			       MEDIA_ENCODER_CTX * encoder_context,
+			       MEDIA_BATCH_BUFFER * batch,
+			       MEDIA_GPE_CTX * gpe_context,
+			       GENERIC_KERNEL_PARAMS * params);
+/* the kernel contexts that own a ring of per frame dynamic state */
+VOID
+media_encoder_gpe_contexts (MEDIA_ENCODER_CTX * encoder_context,
+			    MEDIA_GPE_CTX * gpe_ctx_list[VP8_ENCODE_NUM_GPE_CTX]);
 void
 gpe_context_vfe_scoreboardinit_pak_p1 (MEDIA_ENCODER_CTX * encoder_context,MEDIA_GPE_CTX * gpe_context);
 void
@@ -1167,10 +1167,8 @@ media_encoder_init_vp8 (VADriverContextP ctx,
       encoder_context->media_object_walker_mbenc_init =media_object_walker_mbenc_init;
       encoder_context->gpe_context_vfe_scoreboardinit_pak_p1=gpe_context_vfe_scoreboardinit_pak_p1;
       encoder_context->gpe_context_vfe_scoreboardinit_pak_p2=gpe_context_vfe_scoreboardinit_pak_p2;
-      encoder_context->mediadrv_gen_state_base_address_cmd =
-	mediadrv_gen_state_base_address_cmd;
-      encoder_context->mediadrv_gen_media_vfe_state_cmd =
-	mediadrv_gen_media_vfe_state_cmd;
+      encoder_context->mediadrv_gen_state_cmds_build =
+	mediadrv_gen_state_cmds_build;
       encoder_context->media_object_walker_cmd=
         media_object_walker_cmd;
       encoder_context->initialize_brc_distortion_buffer = media_init_brc_distortion_buffer_g75;
@@ -1214,10 +1212,8 @@ media_encoder_init_vp8 (VADriverContextP ctx,
       encoder_context->media_object_walker_mbenc_init =media_object_walker_mbenc_init;
       encoder_context->gpe_context_vfe_scoreboardinit_pak_p1=gpe_context_vfe_scoreboardinit_pak_p1;
       encoder_context->gpe_context_vfe_scoreboardinit_pak_p2=gpe_context_vfe_scoreboardinit_pak_p2;
-      encoder_context->mediadrv_gen_state_base_address_cmd =
-	mediadrv_gen_state_base_address_cmd;
-      encoder_context->mediadrv_gen_media_vfe_state_cmd =
-	mediadrv_gen_media_vfe_state_cmd;
+      encoder_context->mediadrv_gen_state_cmds_build =
+	mediadrv_gen_state_cmds_build;
       encoder_context->media_object_walker_cmd=
         media_object_walker_cmd;
       encoder_context->initialize_brc_distortion_buffer = media_init_brc_distortion_buffer_g7;
@@ -0,0 +1,338 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+/*
+ * Host side lookahead for VP8 BRC. Every source frame in the window is
+ * reduced to one averaged luma sample per MB; intra cost is the distance to
+ * the left/above average and inter cost the best +-1 MB match in the
+ * preceding frame. The relative costs split the bit budget of the window
+ * and a coded size model, calibrated on the frames already coded, turns
+ * the share of the current frame into a QP hint.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "media_drv_util.h"
+#include "media_drv_hw_g75.h"
+#include "media_drv_encoder_vp8_lookahead.h"
+
+#define VP8_LOOKAHEAD_WEIGHT_EXP	0.4
+#define VP8_LOOKAHEAD_MOTION_PENALTY	1
+
+MEDIA_VP8_LOOKAHEAD *
+media_vp8_lookahead_create (UINT mb_cols, UINT mb_rows)
+{
+  MEDIA_VP8_LOOKAHEAD *lookahead;
+  UINT num_mbs = mb_cols * mb_rows;
+  UINT i;
+
+  if (num_mbs == 0)
+    return NULL;
+  lookahead = calloc (1, sizeof (*lookahead));
+  if (lookahead == NULL)
+    return NULL;
+  lookahead->planes = calloc (VP8_LOOKAHEAD_MAX_DEPTH + 1, num_mbs);
+  if (lookahead->planes == NULL)
+    {
+      free (lookahead);
+      return NULL;
+    }
+  lookahead->depth = 1;
+  lookahead->mb_cols = mb_cols;
+  lookahead->mb_rows = mb_rows;
+  for (i = 0; i < VP8_LOOKAHEAD_MAX_DEPTH; i++)
+    lookahead->frames[i].luma_16x = lookahead->planes + i * num_mbs;
+  lookahead->prev_luma_16x =
+    lookahead->planes + VP8_LOOKAHEAD_MAX_DEPTH * num_mbs;
+
+  return lookahead;
+}
+
+VOID
+media_vp8_lookahead_destroy (MEDIA_VP8_LOOKAHEAD * lookahead)
+{
+  if (lookahead == NULL)
+    return;
+  free (lookahead->planes);
+  free (lookahead);
+}
+
+VOID
+media_vp8_lookahead_set_window (MEDIA_VP8_LOOKAHEAD * lookahead,
+				const VAEncMiscParameterVP8HybridLookahead *
+				param)
+{
+  UINT depth = param->depth;
+
+  if (depth < 1)
+    depth = 1;
+  if (depth > VP8_LOOKAHEAD_MAX_DEPTH)
+    depth = VP8_LOOKAHEAD_MAX_DEPTH;
+  lookahead->depth = depth;
+  lookahead->num_upcoming = MIN (param->num_surfaces, depth - 1);
+  memcpy (lookahead->upcoming, param->surfaces,
+	  lookahead->num_upcoming * sizeof (VASurfaceID));
+}
+
+BOOL
+media_vp8_luma_16x (VADriverContextP ctx, VASurfaceID surface,
+		    UINT mb_cols, UINT mb_rows, BYTE * luma_16x,
+		    UINT * histogram)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = (MEDIA_DRV_CONTEXT *) ctx->pDriverData;
+  struct object_surface *obj_surface = SURFACE (surface);
+  UINT tiling, swizzle;
+  UINT mb_x, mb_y, x, y;
+  BYTE *luma;
+
+  if (obj_surface == NULL || obj_surface->bo == NULL)
+    return FALSE;
+
+  media_bo_get_tiling (obj_surface->bo, &tiling, &swizzle);
+  if (tiling != I915_TILING_NONE)
+    media_bo_map_gtt (obj_surface->bo);
+  else
+    media_bo_map (obj_surface->bo, 0);
+  luma = (BYTE *) obj_surface->bo->virtual;
+  if (luma == NULL)
+    return FALSE;
+
+  if (histogram)
+    memset (histogram, 0, VP8_LUMA_HISTOGRAM_BINS * sizeof (UINT));
+  for (mb_y = 0; mb_y < mb_rows; mb_y++)
+    {
+      UINT y_end = MIN ((mb_y + 1) * 16, obj_surface->orig_height);
+
+      for (mb_x = 0; mb_x < mb_cols; mb_x++)
+	{
+	  UINT x_end = MIN ((mb_x + 1) * 16, obj_surface->orig_width);
+	  UINT sum = 0, count = 0;
+
+	  for (y = mb_y * 16; y < y_end; y++)
+	    {
+	      BYTE *row = luma + y * obj_surface->width;
+
+	      for (x = mb_x * 16; x < x_end; x++)
+		sum += row[x];
+	      if (histogram)
+		{
+		  for (x = mb_x * 16; x < x_end; x++)
+		    histogram[row[x] >> VP8_LUMA_HISTOGRAM_SHIFT]++;
+		}
+	      count += (x_end > mb_x * 16) ? x_end - mb_x * 16 : 0;
+	    }
+	  luma_16x[mb_y * mb_cols + mb_x] =
+	    count ? (sum + count / 2) / count : 128;
+	}
+    }
+
+  if (tiling != I915_TILING_NONE)
+    media_bo_unmap_gtt (obj_surface->bo);
+  else
+    media_bo_unmap (obj_surface->bo);
+
+  return TRUE;
+}
+
+static VOID
+media_vp8_lookahead_cost (MEDIA_VP8_LOOKAHEAD * lookahead,
+			  MEDIA_VP8_LOOKAHEAD_FRAME * frame,
+			  const BYTE * ref_luma_16x)
+{
+  const BYTE *cur = frame->luma_16x;
+  INT cols = lookahead->mb_cols;
+  INT rows = lookahead->mb_rows;
+  INT mb_x, mb_y, dx, dy;
+  UINT intra_cost = 0, cost = 0;
+
+  for (mb_y = 0; mb_y < rows; mb_y++)
+    {
+      for (mb_x = 0; mb_x < cols; mb_x++)
+	{
+	  INT sample = cur[mb_y * cols + mb_x];
+	  INT pred, intra, inter;
+
+	  if (mb_x > 0 && mb_y > 0)
+	    pred = (cur[mb_y * cols + mb_x - 1] +
+		    cur[(mb_y - 1) * cols + mb_x] + 1) >> 1;
+	  else if (mb_x > 0)
+	    pred = cur[mb_y * cols + mb_x - 1];
+	  else if (mb_y > 0)
+	    pred = cur[(mb_y - 1) * cols + mb_x];
+	  else
+	    pred = 128;
+	  intra = abs (sample - pred);
+	  intra_cost += intra;
+
+	  inter = intra;
+	  if (ref_luma_16x)
+	    {
+	      for (dy = -1; dy <= 1; dy++)
+		{
+		  if (mb_y + dy < 0 || mb_y + dy >= rows)
+		    continue;
+		  for (dx = -1; dx <= 1; dx++)
+		    {
+		      INT diff;
+
+		      if (mb_x + dx < 0 || mb_x + dx >= cols)
+			continue;
+		      diff =
+			abs (sample -
+			     ref_luma_16x[(mb_y + dy) * cols + mb_x + dx]);
+		      if (dx || dy)
+			diff += VP8_LOOKAHEAD_MOTION_PENALTY;
+		      inter = MIN (inter, diff);
+		    }
+		}
+	    }
+	  cost += inter;
+	}
+    }
+
+  frame->intra_cost = intra_cost;
+  frame->cost = cost;
+}
+
+VOID
+media_vp8_lookahead_analyze (VADriverContextP ctx,
+			     MEDIA_VP8_LOOKAHEAD * lookahead,
+			     VASurfaceID current)
+{
+  VASurfaceID window[VP8_LOOKAHEAD_MAX_DEPTH];
+  UINT num_window, i, valid;
+
+  /* the frame coded last time becomes the inter reference */
+  if (lookahead->num_frames > 0)
+    {
+      BYTE *plane = lookahead->prev_luma_16x;
+
+      lookahead->prev_luma_16x = lookahead->frames[0].luma_16x;
+      lookahead->prev_valid = TRUE;
+      memmove (&lookahead->frames[0], &lookahead->frames[1],
+	       (VP8_LOOKAHEAD_MAX_DEPTH - 1) * sizeof (lookahead->frames[0]));
+      lookahead->frames[VP8_LOOKAHEAD_MAX_DEPTH - 1].luma_16x = plane;
+      lookahead->num_frames--;
+    }
+
+  window[0] = current;
+  num_window = 1;
+  for (i = 0; i < lookahead->num_upcoming && num_window < lookahead->depth;
+       i++)
+    window[num_window++] = lookahead->upcoming[i];
+
+  /* the application may only append to the window it sent before */
+  for (valid = 0; valid < lookahead->num_frames && valid < num_window;
+       valid++)
+    {
+      if (lookahead->frames[valid].surface != window[valid])
+	break;
+    }
+
+  for (i = valid; i < num_window; i++)
+    {
+      MEDIA_VP8_LOOKAHEAD_FRAME *frame = &lookahead->frames[i];
+      const BYTE *ref;
+
+      if (!media_vp8_luma_16x (ctx, window[i], lookahead->mb_cols,
+			       lookahead->mb_rows, frame->luma_16x, NULL))
+	break;
+      frame->surface = window[i];
+      if (i > 0)
+	ref = lookahead->frames[i - 1].luma_16x;
+      else
+	ref = lookahead->prev_valid ? lookahead->prev_luma_16x : NULL;
+      media_vp8_lookahead_cost (lookahead, frame, ref);
+    }
+  lookahead->num_frames = i;
+}
+
+BOOL
+media_vp8_lookahead_plan (MEDIA_VP8_LOOKAHEAD * lookahead,
+			  BOOL key_frame, DOUBLE bits_per_frame,
+			  UINT prev_frame_bytes, UINT prev_qp,
+			  UINT * target_bits, UINT * qp_hint)
+{
+  UINT num_mbs = lookahead->mb_cols * lookahead->mb_rows;
+  DOUBLE cost, weight, sum_weight, target, qstep;
+  UINT i, qp;
+
+  *target_bits = (UINT) bits_per_frame;
+  *qp_hint = 0;
+  if (lookahead->num_frames == 0)
+    {
+      lookahead->last_planned = FALSE;
+      return FALSE;
+    }
+
+  /* calibrate the size model on the frame coded last */
+  if (lookahead->last_planned && prev_frame_bytes && lookahead->last_cost)
+    {
+      DOUBLE scale;
+
+      qp = prev_qp ? prev_qp : lookahead->last_qp;
+      scale = (DOUBLE) prev_frame_bytes * 8 * quant_ac_vp8_g75[qp] /
+	lookahead->last_cost;
+      if (lookahead->bits_scale > 0)
+	lookahead->bits_scale = 0.5 * lookahead->bits_scale + 0.5 * scale;
+      else
+	lookahead->bits_scale = scale;
+    }
+
+  /* per MB floor keeps static content from collapsing the weights */
+  cost = (key_frame ? lookahead->frames[0].intra_cost :
+	  lookahead->frames[0].cost) + num_mbs;
+  weight = pow (cost, VP8_LOOKAHEAD_WEIGHT_EXP);
+  sum_weight = weight;
+  for (i = 1; i < lookahead->num_frames; i++)
+    sum_weight += pow ((DOUBLE) lookahead->frames[i].cost + num_mbs,
+		       VP8_LOOKAHEAD_WEIGHT_EXP);
+
+  target = bits_per_frame * lookahead->num_frames * weight / sum_weight;
+  target = MAX (target, bits_per_frame / 4);
+  target = MIN (target, bits_per_frame * (key_frame ? 8 : 4));
+  *target_bits = (UINT) target;
+
+  lookahead->last_cost = (UINT) cost;
+  lookahead->last_planned = TRUE;
+  if (lookahead->bits_scale <= 0)
+    {
+      lookahead->last_qp = prev_qp;
+      return FALSE;
+    }
+
+  qstep = lookahead->bits_scale * cost / target;
+  for (qp = 0; qp < MAX_QP_VP8 - 1; qp++)
+    {
+      if (quant_ac_vp8_g75[qp] >= qstep)
+	break;
+    }
+  *qp_hint = qp;
+  lookahead->last_qp = qp;
+
+  return TRUE;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _MEDIA__DRIVER_ENCODER_VP8_LOOKAHEAD_H
+#define _MEDIA__DRIVER_ENCODER_VP8_LOOKAHEAD_H
+#include "media_drv_init.h"
+#include "media_drv_surface.h"
+#include "va_private.h"
+
+/* current frame included */
+#define VP8_LOOKAHEAD_MAX_DEPTH		VP8_HYBRID_LOOKAHEAD_MAX_DEPTH
+
+#define VP8_LUMA_HISTOGRAM_SHIFT	2
+#define VP8_LUMA_HISTOGRAM_BINS		(256 >> VP8_LUMA_HISTOGRAM_SHIFT)
+
+typedef struct _media_vp8_lookahead_frame
+{
+  VASurfaceID surface;
+  BYTE *luma_16x;		/* one averaged sample per MB */
+  UINT intra_cost;
+  UINT cost;			/* per MB minimum of intra and inter cost */
+} MEDIA_VP8_LOOKAHEAD_FRAME;
+
+typedef struct _media_vp8_lookahead
+{
+  UINT depth;
+  UINT mb_cols;
+  UINT mb_rows;
+
+  /* upcoming source surfaces as last sent by the application */
+  VASurfaceID upcoming[VP8_LOOKAHEAD_MAX_DEPTH];
+  UINT num_upcoming;
+
+  /* analysed window, frames[0] is the frame being encoded */
+  MEDIA_VP8_LOOKAHEAD_FRAME frames[VP8_LOOKAHEAD_MAX_DEPTH];
+  UINT num_frames;
+  BYTE *prev_luma_16x;
+  BOOL prev_valid;
+  BYTE *planes;
+
+  /* coded size model: bits = bits_scale * cost / qstep */
+  DOUBLE bits_scale;
+  UINT last_cost;
+  UINT last_qp;
+  BOOL last_planned;
+} MEDIA_VP8_LOOKAHEAD;
+
+BOOL media_vp8_luma_16x (VADriverContextP ctx, VASurfaceID surface,
+			 UINT mb_cols, UINT mb_rows, BYTE * luma_16x,
+			 UINT * histogram);
+MEDIA_VP8_LOOKAHEAD *media_vp8_lookahead_create (UINT mb_cols, UINT mb_rows);
+VOID media_vp8_lookahead_destroy (MEDIA_VP8_LOOKAHEAD * lookahead);
+VOID media_vp8_lookahead_set_window (MEDIA_VP8_LOOKAHEAD * lookahead,
+				     const VAEncMiscParameterVP8HybridLookahead
+				     * param);
+VOID media_vp8_lookahead_analyze (VADriverContextP ctx,
+				  MEDIA_VP8_LOOKAHEAD * lookahead,
+				  VASurfaceID current);
+BOOL media_vp8_lookahead_plan (MEDIA_VP8_LOOKAHEAD * lookahead,
+			       BOOL key_frame, DOUBLE bits_per_frame,
+			       UINT prev_frame_bytes, UINT prev_qp,
+			       UINT * target_bits, UINT * qp_hint);
+#endif
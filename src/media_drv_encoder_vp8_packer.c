@@ -0,0 +1,2116 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * CPU side VP8 bitstream packer. Turns the MB code and MV records left by
+ * MBPAK into a complete frame in the coded buffer. The first partition
+ * (header, modes and MVs) is written on the packer thread while every DCT
+ * token partition gets a thread of its own. Coefficient and MV
+ * probabilities are never updated, so the default tables from RFC 6386
+ * apply to every frame.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "media_drv_util.h"
+#include "media_drv_batchbuffer.h"
+#include "media_drv_surface.h"
+#include "media_drv_hw_g75.h"
+#include "media_drv_encoder_vp8_packer.h"
+
+/* Bytes reserved per MB in a token partition, overflow is reported */
+#define VP8_PACKER_MB_TOKEN_BYTES	1024
+#define VP8_PACKER_MB_MODE_BYTES	128
+#define VP8_PACKER_HEADER_BYTES		4096
+
+#define VP8_MAX_DCT_VALUE		2048
+#define VP8_MAX_MV_DELTA		1023
+
+enum
+{
+  VP8_DC_PRED,
+  VP8_V_PRED,
+  VP8_H_PRED,
+  VP8_TM_PRED,
+  VP8_B_PRED,
+  VP8_NEARESTMV,
+  VP8_NEARMV,
+  VP8_ZEROMV,
+  VP8_NEWMV,
+  VP8_SPLITMV,
+  VP8_MB_MODE_COUNT
+};
+
+enum
+{
+  VP8_B_DC_PRED,
+  VP8_B_TM_PRED,
+  VP8_B_VE_PRED,
+  VP8_B_HE_PRED,
+  VP8_B_LD_PRED,
+  VP8_B_RD_PRED,
+  VP8_B_VR_PRED,
+  VP8_B_VL_PRED,
+  VP8_B_HD_PRED,
+  VP8_B_HU_PRED,
+  VP8_B_MODE_COUNT
+};
+
+enum
+{
+  VP8_LEFT4X4,
+  VP8_ABOVE4X4,
+  VP8_ZERO4X4,
+  VP8_NEW4X4
+};
+
+enum
+{
+  VP8_INTRA_FRAME,
+  VP8_LAST_FRAME,
+  VP8_GOLDEN_FRAME,
+  VP8_ALTREF_FRAME
+};
+
+enum
+{
+  VP8_ZERO_TOKEN,
+  VP8_ONE_TOKEN,
+  VP8_TWO_TOKEN,
+  VP8_THREE_TOKEN,
+  VP8_FOUR_TOKEN,
+  VP8_DCT_CAT1,
+  VP8_DCT_CAT2,
+  VP8_DCT_CAT3,
+  VP8_DCT_CAT4,
+  VP8_DCT_CAT5,
+  VP8_DCT_CAT6,
+  VP8_DCT_EOB_TOKEN,
+  VP8_TOKEN_COUNT
+};
+
+/* MV probability layout */
+#define VP8_MVP_IS_SHORT	0
+#define VP8_MVP_SIGN		1
+#define VP8_MVP_SHORT		2
+#define VP8_MVP_BITS		9
+#define VP8_MVP_COUNT		19
+#define VP8_MV_LONG_BITS	10
+
+typedef struct _vp8_bool_encoder
+{
+  BYTE *buffer;
+  UINT size;
+  UINT pos;
+  UINT low;
+  UINT range;
+  INT count;
+  BOOL overflow;
+} VP8_BOOL_ENCODER;
+
+typedef struct _vp8_tree_token
+{
+  UINT16 value;
+  BYTE len;
+} VP8_TREE_TOKEN;
+
+typedef struct _vp8_packer_mv
+{
+  INT16 row;
+  INT16 col;
+} VP8_PACKER_MV;
+
+typedef struct _vp8_packer_mb
+{
+  BYTE y_mode;
+  BYTE uv_mode;
+  BYTE ref_frame;
+  BYTE segment_id;
+  BYTE skip;
+  BYTE has_y2;
+  BYTE split_type;
+  BYTE b_modes[16];
+  BYTE eob[25];
+  BYTE mode_probs[4];
+  VP8_PACKER_MV mv;
+  VP8_PACKER_MV best_mv;
+  VP8_PACKER_MV mvs[16];
+  const VP8_PAK_MB_CODE *code;
+} VP8_PACKER_MB;
+
+typedef struct _vp8_packer_partition
+{
+  MEDIA_VP8_PACKER *packer;
+  UINT index;
+  pthread_t thread;
+  BOOL running;
+  BYTE *buffer;
+  UINT capacity;
+  UINT limit;
+  VP8_BOOL_ENCODER bc;
+} VP8_PACKER_PARTITION;
+
+struct _media_vp8_packer
+{
+  UINT mb_cols;
+  UINT mb_rows;
+  UINT mb_stride;
+  VP8_PACKER_MB *mb_info;	/* includes a zeroed border row and column */
+  VP8_PACKER_MB *mbs;
+  BYTE *above_ctx_rows;		/* token contexts at the start of each row */
+  BYTE *mb_data;
+  UINT mb_data_size;
+  BYTE *first_part;
+  UINT first_part_capacity;
+  VP8_BOOL_ENCODER first_bc;
+  VP8_PACKER_PARTITION partitions[VP8_PACKER_MAX_PARTITIONS];
+  UINT num_partitions;
+
+  UINT segment_status;
+
+  /* per frame statistics feeding the header probabilities */
+  BOOL key_frame;
+  BOOL use_skip;
+  UINT segment_count[4];
+  UINT skip_count;
+  UINT intra_count;
+  UINT last_count;
+  UINT golden_count;
+  UINT altref_count;
+  BYTE prob_skip_false;
+  BYTE prob_intra;
+  BYTE prob_last;
+  BYTE prob_gf;
+  BYTE segment_probs[3];
+
+  /* in flight job */
+  pthread_t thread;
+  BOOL busy;
+  dri_bo *coded_bo;
+  struct object_surface *coded_surface;
+  UINT mb_code_offset;
+  UINT mb_code_stride;
+  UINT mv_offset;
+  UINT mv_stride;
+  VAEncSequenceParameterBufferVP8 seq_param;
+  VAEncPictureParameterBufferVP8 pic_param;
+  VAQMatrixBufferVP8 q_matrix;
+};
+
+#define VP8_PACKER_MB_AT(packer, row, col) \
+  ((packer)->mbs + (row) * (packer)->mb_stride + (col))
+
+static const BYTE vp8_norm[256] = {
+  0, 7, 6, 6, 5, 5, 5, 5, 4, 4, 4, 4, 4, 4, 4, 4,
+  3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+  2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+  2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+static const signed char vp8_ymode_tree[8] = {
+  -VP8_DC_PRED, 2, 4, 6, -VP8_V_PRED, -VP8_H_PRED, -VP8_TM_PRED, -VP8_B_PRED
+};
+
+static const signed char vp8_kf_ymode_tree[8] = {
+  -VP8_B_PRED, 2, 4, 6, -VP8_DC_PRED, -VP8_V_PRED, -VP8_H_PRED, -VP8_TM_PRED
+};
+
+static const signed char vp8_uv_mode_tree[6] = {
+  -VP8_DC_PRED, 2, -VP8_V_PRED, 4, -VP8_H_PRED, -VP8_TM_PRED
+};
+
+static const signed char vp8_bmode_tree[18] = {
+  -VP8_B_DC_PRED, 2,
+  -VP8_B_TM_PRED, 4,
+  -VP8_B_VE_PRED, 6,
+  8, 12,
+  -VP8_B_HE_PRED, 10,
+  -VP8_B_RD_PRED, -VP8_B_VR_PRED,
+  -VP8_B_LD_PRED, 14,
+  -VP8_B_VL_PRED, 16,
+  -VP8_B_HD_PRED, -VP8_B_HU_PRED
+};
+
+static const signed char vp8_mv_ref_tree[8] = {
+  -VP8_ZEROMV, 2, -VP8_NEARESTMV, 4, -VP8_NEARMV, 6, -VP8_NEWMV, -VP8_SPLITMV
+};
+
+static const signed char vp8_sub_mv_ref_tree[6] = {
+  -VP8_LEFT4X4, 2, -VP8_ABOVE4X4, 4, -VP8_ZERO4X4, -VP8_NEW4X4
+};
+
+static const signed char vp8_mbsplit_tree[6] = { -3, 2, -2, 4, -0, -1 };
+
+static const signed char vp8_small_mv_tree[14] = {
+  2, 8, 4, 6, -0, -1, -2, -3, 10, 12, -4, -5, -6, -7
+};
+
+static const signed char vp8_coef_tree[22] = {
+  -VP8_DCT_EOB_TOKEN, 2,
+  -VP8_ZERO_TOKEN, 4,
+  -VP8_ONE_TOKEN, 6,
+  8, 12,
+  -VP8_TWO_TOKEN, 10,
+  -VP8_THREE_TOKEN, -VP8_FOUR_TOKEN,
+  14, 16,
+  -VP8_DCT_CAT1, -VP8_DCT_CAT2,
+  18, 20,
+  -VP8_DCT_CAT3, -VP8_DCT_CAT4,
+  -VP8_DCT_CAT5, -VP8_DCT_CAT6
+};
+
+static VP8_TREE_TOKEN vp8_ymode_tokens[VP8_MB_MODE_COUNT];
+static VP8_TREE_TOKEN vp8_kf_ymode_tokens[VP8_MB_MODE_COUNT];
+static VP8_TREE_TOKEN vp8_uv_mode_tokens[VP8_MB_MODE_COUNT];
+static VP8_TREE_TOKEN vp8_bmode_tokens[VP8_B_MODE_COUNT];
+static VP8_TREE_TOKEN vp8_mv_ref_tokens[VP8_MB_MODE_COUNT];
+static VP8_TREE_TOKEN vp8_sub_mv_ref_tokens[4];
+static VP8_TREE_TOKEN vp8_mbsplit_tokens[4];
+static VP8_TREE_TOKEN vp8_small_mv_tokens[8];
+static VP8_TREE_TOKEN vp8_coef_tokens[VP8_TOKEN_COUNT];
+static pthread_once_t vp8_packer_tokens_once = PTHREAD_ONCE_INIT;
+
+static const BYTE vp8_kf_ymode_prob[4] = { 145, 156, 163, 128 };
+static const BYTE vp8_ymode_prob[4] = { 112, 86, 140, 37 };
+static const BYTE vp8_kf_uv_mode_prob[3] = { 142, 114, 183 };
+static const BYTE vp8_uv_mode_prob[3] = { 162, 101, 204 };
+static const BYTE vp8_bmode_prob[VP8_B_MODE_COUNT - 1] = {
+  120, 90, 79, 133, 87, 85, 80, 111, 151
+};
+
+static const BYTE vp8_mbsplit_probs[3] = { 110, 111, 150 };
+static const BYTE vp8_mbsplit_count[4] = { 2, 2, 4, 16 };
+static const BYTE vp8_mbsplits[4][16] = {
+  {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1},
+  {0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1},
+  {0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 3, 3, 2, 2, 3, 3},
+  {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15}
+};
+
+/* first block of every split partition */
+static const BYTE vp8_mbsplit_first[4][16] = {
+  {0, 8},
+  {0, 2},
+  {0, 2, 8, 10},
+  {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15}
+};
+
+static const BYTE vp8_sub_mv_ref_prob[5][3] = {
+  {147, 136, 18},
+  {106, 145, 1},
+  {179, 121, 1},
+  {223, 1, 34},
+  {208, 1, 1}
+};
+
+static const BYTE vp8_mode_contexts[6][4] = {
+  {7, 1, 1, 143},
+  {14, 18, 14, 107},
+  {135, 64, 57, 68},
+  {60, 56, 128, 65},
+  {159, 134, 128, 34},
+  {234, 188, 128, 28}
+};
+
+static const BYTE vp8_default_mv_probs[2][VP8_MVP_COUNT] = {
+  {162, 128, 225, 146, 172, 147, 214, 39, 156,
+   128, 129, 132, 75, 145, 178, 206, 239, 254, 254},
+  {164, 128, 204, 170, 119, 235, 140, 230, 228,
+   128, 130, 130, 74, 148, 180, 203, 236, 254, 254}
+};
+
+static const BYTE vp8_mv_update_probs[2][VP8_MVP_COUNT] = {
+  {237, 246, 253, 253, 254, 254, 254, 254, 254,
+   254, 254, 254, 254, 254, 250, 250, 252, 254, 254},
+  {231, 243, 245, 253, 254, 254, 254, 254, 254,
+   254, 254, 254, 254, 254, 251, 251, 254, 254, 254}
+};
+
+static const BYTE vp8_zigzag[16] = {
+  0, 1, 4, 8, 5, 2, 3, 6, 9, 12, 13, 10, 7, 11, 14, 15
+};
+
+static const BYTE vp8_coef_bands[16] = {
+  0, 1, 2, 3, 6, 4, 5, 6, 6, 6, 6, 6, 6, 6, 6, 7
+};
+
+static const BYTE vp8_cat1_prob[] = { 159 };
+static const BYTE vp8_cat2_prob[] = { 165, 145 };
+static const BYTE vp8_cat3_prob[] = { 173, 148, 140 };
+static const BYTE vp8_cat4_prob[] = { 176, 155, 140, 135 };
+static const BYTE vp8_cat5_prob[] = { 180, 157, 141, 134, 130 };
+static const BYTE vp8_cat6_prob[] = {
+  254, 254, 243, 230, 196, 177, 153, 140, 133, 130, 129
+};
+
+static const struct
+{
+  const BYTE *probs;
+  BYTE len;
+  UINT16 base;
+} vp8_extra_bits[VP8_DCT_CAT6 - VP8_DCT_CAT1 + 1] = {
+  {vp8_cat1_prob, 1, 5},
+  {vp8_cat2_prob, 2, 7},
+  {vp8_cat3_prob, 3, 11},
+  {vp8_cat4_prob, 4, 19},
+  {vp8_cat5_prob, 5, 35},
+  {vp8_cat6_prob, 11, 67}
+};
+
+static const BYTE vp8_kf_bmode_probs[VP8_B_MODE_COUNT][VP8_B_MODE_COUNT]
+  [VP8_B_MODE_COUNT - 1] = {
+  {
+   {231, 120, 48, 89, 115, 113, 120, 152, 112},
+   {152, 179, 64, 126, 170, 118, 46, 70, 95},
+   {175, 69, 143, 80, 85, 82, 72, 155, 103},
+   {56, 58, 10, 171, 218, 189, 17, 13, 152},
+   {144, 71, 10, 38, 171, 213, 144, 34, 26},
+   {114, 26, 17, 163, 44, 195, 21, 10, 173},
+   {121, 24, 80, 195, 26, 62, 44, 64, 85},
+   {170, 46, 55, 19, 136, 160, 33, 206, 71},
+   {63, 20, 8, 114, 114, 208, 12, 9, 226},
+   {81, 40, 11, 96, 182, 84, 29, 16, 36}
+   },
+  {
+   {134, 183, 89, 137, 98, 101, 106, 165, 148},
+   {72, 187, 100, 130, 157, 111, 32, 75, 80},
+   {66, 102, 167, 99, 74, 62, 40, 234, 128},
+   {41, 53, 9, 178, 241, 141, 26, 8, 107},
+   {104, 79, 12, 27, 217, 255, 87, 17, 7},
+   {74, 43, 26, 146, 73, 166, 49, 23, 157},
+   {65, 38, 105, 160, 51, 52, 31, 115, 128},
+   {87, 68, 71, 44, 114, 51, 15, 186, 23},
+   {47, 41, 14, 110, 182, 183, 21, 17, 194},
+   {66, 45, 25, 102, 197, 189, 23, 18, 22}
+   },
+  {
+   {88, 88, 147, 150, 42, 46, 45, 196, 205},
+   {43, 97, 183, 117, 85, 38, 35, 179, 61},
+   {39, 53, 200, 87, 26, 21, 43, 232, 171},
+   {56, 34, 51, 104, 114, 102, 29, 93, 77},
+   {107, 54, 32, 26, 51, 1, 81, 43, 31},
+   {39, 28, 85, 171, 58, 165, 90, 98, 64},
+   {34, 22, 116, 206, 23, 34, 43, 166, 73},
+   {68, 25, 106, 22, 64, 171, 36, 225, 114},
+   {34, 19, 21, 102, 132, 188, 16, 76, 124},
+   {62, 18, 78, 95, 85, 57, 50, 48, 51}
+   },
+  {
+   {193, 101, 35, 159, 215, 111, 89, 46, 111},
+   {60, 148, 31, 172, 219, 228, 21, 18, 111},
+   {112, 113, 77, 85, 179, 255, 38, 120, 114},
+   {40, 42, 1, 196, 245, 209, 10, 25, 109},
+   {100, 80, 8, 43, 154, 1, 51, 26, 71},
+   {88, 43, 29, 140, 166, 213, 37, 43, 154},
+   {61, 63, 30, 155, 67, 45, 68, 1, 209},
+   {142, 78, 78, 16, 255, 128, 34, 197, 171},
+   {41, 40, 5, 102, 211, 183, 4, 1, 221},
+   {51, 50, 17, 168, 209, 192, 23, 25, 82}
+   },
+  {
+   {125, 98, 42, 88, 104, 85, 117, 175, 82},
+   {95, 84, 53, 89, 128, 100, 113, 101, 45},
+   {75, 79, 123, 47, 51, 128, 81, 171, 1},
+   {57, 17, 5, 71, 102, 57, 53, 41, 49},
+   {115, 21, 2, 10, 102, 255, 166, 23, 6},
+   {38, 33, 13, 121, 57, 73, 26, 1, 85},
+   {41, 10, 67, 138, 77, 110, 90, 47, 114},
+   {101, 29, 16, 10, 85, 128, 101, 196, 26},
+   {57, 18, 10, 102, 102, 213, 34, 20, 43},
+   {117, 20, 15, 36, 163, 128, 68, 1, 26}
+   },
+  {
+   {138, 31, 36, 171, 27, 166, 38, 44, 229},
+   {67, 87, 58, 169, 82, 115, 26, 59, 179},
+   {63, 59, 90, 180, 59, 166, 93, 73, 154},
+   {40, 40, 21, 116, 143, 209, 34, 39, 175},
+   {57, 46, 22, 24, 128, 1, 54, 17, 37},
+   {47, 15, 16, 183, 34, 223, 49, 45, 183},
+   {46, 17, 33, 183, 6, 98, 15, 32, 183},
+   {65, 32, 73, 115, 28, 128, 23, 128, 205},
+   {40, 3, 9, 115, 51, 192, 18, 6, 223},
+   {87, 37, 9, 115, 59, 77, 64, 21, 47}
+   },
+  {
+   {104, 55, 44, 218, 9, 54, 53, 130, 226},
+   {64, 90, 70, 205, 40, 41, 23, 26, 57},
+   {54, 57, 112, 184, 5, 41, 38, 166, 213},
+   {30, 34, 26, 133, 152, 116, 10, 32, 134},
+   {75, 32, 12, 51, 192, 255, 160, 43, 51},
+   {39, 19, 53, 221, 26, 114, 32, 73, 255},
+   {31, 9, 65, 234, 2, 15, 1, 118, 73},
+   {88, 31, 35, 67, 102, 85, 55, 186, 85},
+   {56, 21, 23, 111, 59, 205, 45, 37, 192},
+   {55, 38, 70, 124, 73, 102, 1, 34, 98}
+   },
+  {
+   {102, 61, 71, 37, 34, 53, 31, 243, 192},
+   {69, 60, 71, 38, 73, 119, 28, 222, 37},
+   {68, 45, 128, 34, 1, 47, 11, 245, 171},
+   {62, 17, 19, 70, 146, 85, 55, 62, 70},
+   {75, 15, 9, 9, 64, 255, 184, 119, 16},
+   {37, 43, 37, 154, 100, 163, 85, 160, 1},
+   {63, 9, 92, 136, 28, 64, 32, 201, 85},
+   {86, 6, 28, 5, 64, 255, 25, 248, 1},
+   {56, 8, 17, 132, 137, 255, 55, 116, 128},
+   {58, 15, 20, 82, 135, 57, 26, 121, 40}
+   },
+  {
+   {164, 50, 31, 137, 154, 133, 25, 35, 218},
+   {51, 103, 44, 131, 131, 123, 31, 6, 158},
+   {86, 40, 64, 135, 148, 224, 45, 183, 128},
+   {22, 26, 17, 131, 240, 154, 14, 1, 209},
+   {83, 12, 13, 54, 192, 255, 68, 47, 28},
+   {45, 16, 21, 91, 64, 222, 7, 1, 197},
+   {56, 21, 39, 155, 60, 138, 23, 102, 213},
+   {85, 26, 85, 85, 128, 128, 32, 146, 171},
+   {18, 11, 7, 63, 144, 171, 4, 4, 246},
+   {35, 27, 10, 146, 174, 171, 12, 26, 128}
+   },
+  {
+   {190, 80, 35, 99, 180, 80, 126, 54, 45},
+   {85, 126, 47, 87, 176, 51, 41, 20, 32},
+   {101, 75, 128, 139, 118, 146, 116, 128, 85},
+   {56, 41, 15, 176, 236, 85, 37, 9, 62},
+   {146, 36, 19, 30, 171, 255, 97, 27, 20},
+   {71, 30, 17, 119, 118, 255, 17, 18, 138},
+   {101, 38, 60, 138, 55, 70, 43, 26, 142},
+   {138, 45, 61, 62, 219, 1, 81, 188, 64},
+   {32, 41, 20, 117, 151, 142, 20, 21, 163},
+   {112, 19, 12, 61, 195, 128, 48, 4, 24}
+   }
+};
+
+static const BYTE vp8_default_coef_probs[4][8][3][11] = {
+  {
+   {
+    {128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128},
+    {128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128},
+    {128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128}
+    },
+   {
+    {253, 136, 254, 255, 228, 219, 128, 128, 128, 128, 128},
+    {189, 129, 242, 255, 227, 213, 255, 219, 128, 128, 128},
+    {106, 126, 227, 252, 214, 209, 255, 255, 128, 128, 128}
+    },
+   {
+    {1, 98, 248, 255, 236, 226, 255, 255, 128, 128, 128},
+    {181, 133, 238, 254, 221, 234, 255, 154, 128, 128, 128},
+    {78, 134, 202, 247, 198, 180, 255, 219, 128, 128, 128}
+    },
+   {
+    {1, 185, 249, 255, 243, 255, 128, 128, 128, 128, 128},
+    {184, 150, 247, 255, 236, 224, 128, 128, 128, 128, 128},
+    {77, 110, 216, 255, 236, 230, 128, 128, 128, 128, 128}
+    },
+   {
+    {1, 101, 251, 255, 241, 255, 128, 128, 128, 128, 128},
+    {170, 139, 241, 252, 236, 209, 255, 255, 128, 128, 128},
+    {37, 116, 196, 243, 228, 255, 255, 255, 128, 128, 128}
+    },
+   {
+    {1, 204, 254, 255, 245, 255, 128, 128, 128, 128, 128},
+    {207, 160, 250, 255, 238, 128, 128, 128, 128, 128, 128},
+    {102, 103, 231, 255, 211, 171, 128, 128, 128, 128, 128}
+    },
+   {
+    {1, 152, 252, 255, 240, 255, 128, 128, 128, 128, 128},
+    {177, 135, 243, 255, 234, 225, 128, 128, 128, 128, 128},
+    {80, 129, 211, 255, 194, 224, 128, 128, 128, 128, 128}
+    },
+   {
+    {1, 1, 255, 128, 128, 128, 128, 128, 128, 128, 128},
+    {246, 1, 255, 128, 128, 128, 128, 128, 128, 128, 128},
+    {255, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128}
+    }
+   },
+  {
+   {
+    {198, 35, 237, 223, 193, 187, 162, 160, 145, 155, 62},
+    {131, 45, 198, 221, 172, 176, 220, 157, 252, 221, 1},
+    {68, 47, 146, 208, 149, 167, 221, 162, 255, 223, 128}
+    },
+   {
+    {1, 149, 241, 255, 221, 224, 255, 255, 128, 128, 128},
+    {184, 141, 234, 253, 222, 220, 255, 199, 128, 128, 128},
+    {81, 99, 181, 242, 176, 190, 249, 202, 255, 255, 128}
+    },
+   {
+    {1, 129, 232, 253, 214, 197, 242, 196, 255, 255, 128},
+    {99, 121, 210, 250, 201, 198, 255, 202, 128, 128, 128},
+    {23, 91, 163, 242, 170, 187, 247, 210, 255, 255, 128}
+    },
+   {
+    {1, 200, 246, 255, 234, 255, 128, 128, 128, 128, 128},
+    {109, 178, 241, 255, 231, 245, 255, 255, 128, 128, 128},
+    {44, 130, 201, 253, 205, 192, 255, 255, 128, 128, 128}
+    },
+   {
+    {1, 132, 239, 251, 219, 209, 255, 165, 128, 128, 128},
+    {94, 136, 225, 251, 218, 190, 255, 255, 128, 128, 128},
+    {22, 100, 174, 245, 186, 161, 255, 199, 128, 128, 128}
+    },
+   {
+    {1, 182, 249, 255, 232, 235, 128, 128, 128, 128, 128},
+    {124, 143, 241, 255, 227, 234, 128, 128, 128, 128, 128},
+    {35, 77, 181, 251, 193, 211, 255, 205, 128, 128, 128}
+    },
+   {
+    {1, 157, 247, 255, 236, 231, 255, 255, 128, 128, 128},
+    {121, 141, 235, 255, 225, 227, 255, 255, 128, 128, 128},
+    {45, 99, 188, 251, 195, 217, 255, 224, 128, 128, 128}
+    },
+   {
+    {1, 1, 251, 255, 213, 255, 128, 128, 128, 128, 128},
+    {203, 1, 248, 255, 255, 128, 128, 128, 128, 128, 128},
+    {137, 1, 177, 255, 224, 255, 128, 128, 128, 128, 128}
+    }
+   },
+  {
+   {
+    {253, 9, 248, 251, 207, 208, 255, 192, 128, 128, 128},
+    {175, 13, 224, 243, 193, 185, 249, 198, 255, 255, 128},
+    {73, 17, 171, 221, 161, 179, 236, 167, 255, 234, 128}
+    },
+   {
+    {1, 95, 247, 253, 212, 183, 255, 255, 128, 128, 128},
+    {239, 90, 244, 250, 211, 209, 255, 255, 128, 128, 128},
+    {155, 77, 195, 248, 188, 195, 255, 255, 128, 128, 128}
+    },
+   {
+    {1, 24, 239, 251, 218, 219, 255, 205, 128, 128, 128},
+    {201, 51, 219, 255, 196, 186, 128, 128, 128, 128, 128},
+    {69, 46, 190, 239, 201, 218, 255, 228, 128, 128, 128}
+    },
+   {
+    {1, 191, 251, 255, 255, 128, 128, 128, 128, 128, 128},
+    {223, 165, 249, 255, 213, 255, 128, 128, 128, 128, 128},
+    {141, 124, 248, 255, 255, 128, 128, 128, 128, 128, 128}
+    },
+   {
+    {1, 16, 248, 255, 255, 128, 128, 128, 128, 128, 128},
+    {190, 36, 230, 255, 236, 255, 128, 128, 128, 128, 128},
+    {149, 1, 255, 128, 128, 128, 128, 128, 128, 128, 128}
+    },
+   {
+    {1, 226, 255, 128, 128, 128, 128, 128, 128, 128, 128},
+    {247, 192, 255, 128, 128, 128, 128, 128, 128, 128, 128},
+    {240, 128, 255, 128, 128, 128, 128, 128, 128, 128, 128}
+    },
+   {
+    {1, 134, 252, 255, 255, 128, 128, 128, 128, 128, 128},
+    {213, 62, 250, 255, 255, 128, 128, 128, 128, 128, 128},
+    {55, 93, 255, 128, 128, 128, 128, 128, 128, 128, 128}
+    },
+   {
+    {128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128},
+    {128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128},
+    {128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128}
+    }
+   },
+  {
+   {
+    {202, 24, 213, 235, 186, 191, 220, 160, 240, 175, 255},
+    {126, 38, 182, 232, 169, 184, 228, 174, 255, 187, 128},
+    {61, 46, 138, 219, 151, 178, 240, 170, 255, 216, 128}
+    },
+   {
+    {1, 112, 230, 250, 199, 191, 247, 159, 255, 255, 128},
+    {166, 109, 228, 252, 211, 215, 255, 174, 128, 128, 128},
+    {39, 77, 162, 232, 172, 180, 245, 178, 255, 255, 128}
+    },
+   {
+    {1, 52, 220, 246, 198, 199, 249, 220, 255, 255, 128},
+    {124, 74, 191, 243, 183, 193, 250, 221, 255, 255, 128},
+    {24, 71, 130, 219, 154, 170, 243, 182, 255, 255, 128}
+    },
+   {
+    {1, 182, 225, 249, 219, 240, 255, 224, 128, 128, 128},
+    {149, 150, 226, 252, 216, 205, 255, 171, 128, 128, 128},
+    {28, 108, 170, 242, 183, 194, 254, 223, 255, 255, 128}
+    },
+   {
+    {1, 81, 230, 252, 204, 203, 255, 192, 128, 128, 128},
+    {123, 102, 209, 247, 188, 196, 255, 233, 128, 128, 128},
+    {20, 95, 153, 243, 164, 173, 255, 203, 128, 128, 128}
+    },
+   {
+    {1, 222, 248, 255, 216, 213, 128, 128, 128, 128, 128},
+    {168, 175, 246, 252, 235, 205, 255, 255, 128, 128, 128},
+    {47, 116, 215, 255, 211, 212, 255, 255, 128, 128, 128}
+    },
+   {
+    {1, 121, 236, 253, 212, 214, 255, 255, 128, 128, 128},
+    {141, 84, 213, 252, 201, 202, 255, 219, 128, 128, 128},
+    {42, 80, 160, 240, 162, 185, 255, 205, 128, 128, 128}
+    },
+   {
+    {1, 1, 255, 128, 128, 128, 128, 128, 128, 128, 128},
+    {244, 1, 255, 128, 128, 128, 128, 128, 128, 128, 128},
+    {238, 1, 255, 128, 128, 128, 128, 128, 128, 128, 128}
+    }
+   }
+};
+
+static const BYTE vp8_coef_update_probs[4][8][3][11] = {
+  {
+   {
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {176, 246, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {223, 241, 252, 255, 255, 255, 255, 255, 255, 255, 255},
+    {249, 253, 253, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 244, 252, 255, 255, 255, 255, 255, 255, 255, 255},
+    {234, 254, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {253, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 246, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {239, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {254, 255, 254, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 248, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {251, 255, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {251, 254, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {254, 255, 254, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 254, 253, 255, 254, 255, 255, 255, 255, 255, 255},
+    {250, 255, 254, 255, 254, 255, 255, 255, 255, 255, 255},
+    {254, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    }
+   },
+  {
+   {
+    {217, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {225, 252, 241, 253, 255, 255, 254, 255, 255, 255, 255},
+    {234, 250, 241, 250, 253, 255, 253, 254, 255, 255, 255}
+    },
+   {
+    {255, 254, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {223, 254, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {238, 253, 254, 254, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 248, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {249, 254, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 253, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {247, 254, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {252, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 254, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {253, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 254, 253, 255, 255, 255, 255, 255, 255, 255, 255},
+    {250, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {254, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    }
+   },
+  {
+   {
+    {186, 251, 250, 255, 255, 255, 255, 255, 255, 255, 255},
+    {234, 251, 244, 254, 255, 255, 255, 255, 255, 255, 255},
+    {251, 251, 243, 253, 254, 255, 254, 255, 255, 255, 255}
+    },
+   {
+    {255, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {236, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {251, 253, 253, 254, 254, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 254, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {254, 254, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 254, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {254, 254, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {254, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {254, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    }
+   },
+  {
+   {
+    {248, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {250, 254, 252, 254, 255, 255, 255, 255, 255, 255, 255},
+    {248, 254, 249, 253, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 253, 253, 255, 255, 255, 255, 255, 255, 255, 255},
+    {246, 253, 253, 255, 255, 255, 255, 255, 255, 255, 255},
+    {252, 254, 251, 254, 254, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 254, 252, 255, 255, 255, 255, 255, 255, 255, 255},
+    {248, 254, 253, 255, 255, 255, 255, 255, 255, 255, 255},
+    {253, 255, 254, 254, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 251, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {245, 251, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {253, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 251, 253, 255, 255, 255, 255, 255, 255, 255, 255},
+    {252, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 254, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 252, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {249, 255, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 254, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 255, 253, 255, 255, 255, 255, 255, 255, 255, 255},
+    {250, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {254, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    }
+   }
+};
+
+/* Bool encoder */
+
+static VOID
+media_vp8_bool_start (VP8_BOOL_ENCODER * bc, BYTE * buffer, UINT size)
+{
+  bc->buffer = buffer;
+  bc->size = size;
+  bc->pos = 0;
+  bc->low = 0;
+  bc->range = 255;
+  bc->count = -24;
+  bc->overflow = FALSE;
+}
+
+static inline VOID
+media_vp8_bool_write (VP8_BOOL_ENCODER * bc, INT bit, INT prob)
+{
+  UINT split = 1 + (((bc->range - 1) * prob) >> 8);
+  UINT range = split;
+  UINT low = bc->low;
+  INT shift;
+
+  if (bit)
+    {
+      low += split;
+      range = bc->range - split;
+    }
+
+  shift = vp8_norm[range];
+  range <<= shift;
+  bc->count += shift;
+
+  if (bc->count >= 0)
+    {
+      INT offset = shift - bc->count;
+
+      if ((low << (offset - 1)) & 0x80000000)
+	{
+	  INT x = bc->pos - 1;
+
+	  while (x >= 0 && bc->buffer[x] == 0xff)
+	    {
+	      bc->buffer[x] = 0;
+	      x--;
+	    }
+	  if (x >= 0)
+	    bc->buffer[x]++;
+	}
+
+      if (bc->pos < bc->size)
+	bc->buffer[bc->pos++] = (BYTE) (low >> (24 - offset));
+      else
+	bc->overflow = TRUE;
+
+      low <<= offset;
+      shift = bc->count;
+      low &= 0xffffff;
+      bc->count -= 8;
+    }
+
+  bc->low = low << shift;
+  bc->range = range;
+}
+
+static VOID
+media_vp8_bool_write_literal (VP8_BOOL_ENCODER * bc, UINT value, INT bits)
+{
+  while (bits--)
+    media_vp8_bool_write (bc, (value >> bits) & 1, 128);
+}
+
+/* flag, magnitude and sign as used by the header deltas */
+static VOID
+media_vp8_bool_write_signed (VP8_BOOL_ENCODER * bc, INT value, INT bits)
+{
+  if (!value)
+    {
+      media_vp8_bool_write_literal (bc, 0, 1);
+      return;
+    }
+  media_vp8_bool_write_literal (bc, 1, 1);
+  media_vp8_bool_write_literal (bc, value < 0 ? -value : value, bits);
+  media_vp8_bool_write_literal (bc, value < 0, 1);
+}
+
+static VOID
+media_vp8_bool_stop (VP8_BOOL_ENCODER * bc)
+{
+  INT i;
+
+  for (i = 0; i < 32; i++)
+    media_vp8_bool_write (bc, 0, 128);
+}
+
+/* Tree coding */
+
+static VOID
+media_vp8_tree_to_tokens (VP8_TREE_TOKEN * tokens, const signed char *tree,
+			  INT i, UINT value, INT len)
+{
+  value <<= 1;
+  len++;
+  do
+    {
+      INT j = tree[i++];
+
+      if (j <= 0)
+	{
+	  tokens[-j].value = value;
+	  tokens[-j].len = len;
+	}
+      else
+	media_vp8_tree_to_tokens (tokens, tree, j, value, len);
+    }
+  while (++value & 1);
+}
+
+static VOID
+media_vp8_packer_init_tokens (VOID)
+{
+  media_vp8_tree_to_tokens (vp8_ymode_tokens, vp8_ymode_tree, 0, 0, 0);
+  media_vp8_tree_to_tokens (vp8_kf_ymode_tokens, vp8_kf_ymode_tree, 0, 0, 0);
+  media_vp8_tree_to_tokens (vp8_uv_mode_tokens, vp8_uv_mode_tree, 0, 0, 0);
+  media_vp8_tree_to_tokens (vp8_bmode_tokens, vp8_bmode_tree, 0, 0, 0);
+  media_vp8_tree_to_tokens (vp8_mv_ref_tokens, vp8_mv_ref_tree, 0, 0, 0);
+  media_vp8_tree_to_tokens (vp8_sub_mv_ref_tokens, vp8_sub_mv_ref_tree,
+			    0, 0, 0);
+  media_vp8_tree_to_tokens (vp8_mbsplit_tokens, vp8_mbsplit_tree, 0, 0, 0);
+  media_vp8_tree_to_tokens (vp8_small_mv_tokens, vp8_small_mv_tree, 0, 0, 0);
+  media_vp8_tree_to_tokens (vp8_coef_tokens, vp8_coef_tree, 0, 0, 0);
+}
+
+/* start > 0 skips the leading branches, e.g. EOB after a zero token */
+static inline VOID
+media_vp8_write_tree (VP8_BOOL_ENCODER * bc, const signed char *tree,
+		      const BYTE * probs, const VP8_TREE_TOKEN * token,
+		      INT start)
+{
+  UINT value = token->value;
+  INT len = token->len - (start >> 1);
+  INT i = start;
+
+  do
+    {
+      INT bit = (value >> --len) & 1;
+
+      media_vp8_bool_write (bc, bit, probs[i >> 1]);
+      i = tree[i + bit];
+    }
+  while (len);
+}
+
+/* Motion vectors */
+
+static inline BOOL
+media_vp8_mv_equal (VP8_PACKER_MV a, VP8_PACKER_MV b)
+{
+  return a.row == b.row && a.col == b.col;
+}
+
+static inline BOOL
+media_vp8_mv_zero (VP8_PACKER_MV mv)
+{
+  return !mv.row && !mv.col;
+}
+
+static VOID
+media_vp8_write_mv_component (VP8_BOOL_ENCODER * bc, INT v, const BYTE * p)
+{
+  UINT x = v < 0 ? -v : v;
+  INT i;
+
+  if (x < 8)
+    {
+      media_vp8_bool_write (bc, 0, p[VP8_MVP_IS_SHORT]);
+      media_vp8_write_tree (bc, vp8_small_mv_tree, p + VP8_MVP_SHORT,
+			    &vp8_small_mv_tokens[x], 0);
+      if (!x)
+	return;
+    }
+  else
+    {
+      media_vp8_bool_write (bc, 1, p[VP8_MVP_IS_SHORT]);
+      for (i = 0; i < 3; i++)
+	media_vp8_bool_write (bc, (x >> i) & 1, p[VP8_MVP_BITS + i]);
+      for (i = VP8_MV_LONG_BITS - 1; i > 3; i--)
+	media_vp8_bool_write (bc, (x >> i) & 1, p[VP8_MVP_BITS + i]);
+      if (x & 0xfff0)
+	media_vp8_bool_write (bc, (x >> 3) & 1, p[VP8_MVP_BITS + 3]);
+    }
+  media_vp8_bool_write (bc, v < 0, p[VP8_MVP_SIGN]);
+}
+
+static VOID
+media_vp8_write_mv (VP8_BOOL_ENCODER * bc, VP8_PACKER_MV mv,
+		    VP8_PACKER_MV ref)
+{
+  INT row = mv.row - ref.row;
+  INT col = mv.col - ref.col;
+
+  row = MIN (MAX (row, -VP8_MAX_MV_DELTA), VP8_MAX_MV_DELTA);
+  col = MIN (MAX (col, -VP8_MAX_MV_DELTA), VP8_MAX_MV_DELTA);
+  media_vp8_write_mv_component (bc, row, vp8_default_mv_probs[0]);
+  media_vp8_write_mv_component (bc, col, vp8_default_mv_probs[1]);
+}
+
+static VP8_PACKER_MV
+media_vp8_clamp_mv (MEDIA_VP8_PACKER * packer, VP8_PACKER_MV mv,
+		    INT mb_row, INT mb_col)
+{
+  /* quarter pel, one MB of slack around the frame */
+  INT to_left = -(mb_col + 1) * 64;
+  INT to_right = (packer->mb_cols - mb_col) * 64;
+  INT to_top = -(mb_row + 1) * 64;
+  INT to_bottom = (packer->mb_rows - mb_row) * 64;
+
+  if (mv.col < to_left)
+    mv.col = to_left;
+  else if (mv.col > to_right)
+    mv.col = to_right;
+  if (mv.row < to_top)
+    mv.row = to_top;
+  else if (mv.row > to_bottom)
+    mv.row = to_bottom;
+  return mv;
+}
+
+static VOID
+media_vp8_find_near_mvs (MEDIA_VP8_PACKER * packer, VP8_PACKER_MB * mb,
+			 INT mb_row, INT mb_col, VP8_PACKER_MV * nearest,
+			 VP8_PACKER_MV * nearby)
+{
+  const VP8_PACKER_MB *above = mb - packer->mb_stride;
+  const VP8_PACKER_MB *neighbours[3] = { above, mb - 1, above - 1 };
+  static const INT weights[3] = { 2, 2, 1 };
+  INT sign_bias[4] = { 0, 0,
+    packer->pic_param.pic_flags.bits.sign_bias_golden,
+    packer->pic_param.pic_flags.bits.sign_bias_alternate
+  };
+  VP8_PACKER_MV near_mvs[4];
+  VP8_PACKER_MV *mv = near_mvs;
+  INT cnt[4] = { 0, 0, 0, 0 };
+  INT *cntx = cnt;
+  INT i;
+
+  memset (near_mvs, 0, sizeof (near_mvs));
+
+  for (i = 0; i < 3; i++)
+    {
+      const VP8_PACKER_MB *n = neighbours[i];
+      VP8_PACKER_MV this_mv;
+
+      if (n->ref_frame == VP8_INTRA_FRAME)
+	continue;
+
+      if (media_vp8_mv_zero (n->mv))
+	{
+	  cnt[0] += weights[i];
+	  continue;
+	}
+
+      this_mv = n->mv;
+      if (sign_bias[n->ref_frame] != sign_bias[mb->ref_frame])
+	{
+	  this_mv.row = -this_mv.row;
+	  this_mv.col = -this_mv.col;
+	}
+
+      /* the above MB always opens a new candidate */
+      if (!i || !media_vp8_mv_equal (this_mv, *mv))
+	{
+	  *++mv = this_mv;
+	  ++cntx;
+	}
+      *cntx += weights[i];
+    }
+
+  /* three distinct MVs, merge above-left into nearest when equal */
+  if (cnt[3] && media_vp8_mv_equal (*mv, near_mvs[1]))
+    cnt[1] += 1;
+
+  cnt[3] = (above->y_mode == VP8_SPLITMV) * 2 +
+    ((mb - 1)->y_mode == VP8_SPLITMV) * 2 +
+    ((above - 1)->y_mode == VP8_SPLITMV);
+
+  if (cnt[2] > cnt[1])
+    {
+      INT tmp = cnt[1];
+      VP8_PACKER_MV tmp_mv = near_mvs[1];
+
+      cnt[1] = cnt[2];
+      cnt[2] = tmp;
+      near_mvs[1] = near_mvs[2];
+      near_mvs[2] = tmp_mv;
+    }
+
+  if (cnt[1] >= cnt[0])
+    near_mvs[0] = near_mvs[1];
+
+  mb->best_mv = media_vp8_clamp_mv (packer, near_mvs[0], mb_row, mb_col);
+  *nearest = media_vp8_clamp_mv (packer, near_mvs[1], mb_row, mb_col);
+  *nearby = media_vp8_clamp_mv (packer, near_mvs[2], mb_row, mb_col);
+
+  for (i = 0; i < 4; i++)
+    mb->mode_probs[i] = vp8_mode_contexts[cnt[i]][i];
+}
+
+/* Tokens */
+
+static inline INT
+media_vp8_coef_token (UINT level)
+{
+  static const BYTE small_tokens[5] = {
+    VP8_ZERO_TOKEN, VP8_ONE_TOKEN, VP8_TWO_TOKEN, VP8_THREE_TOKEN,
+    VP8_FOUR_TOKEN
+  };
+
+  if (level < 5)
+    return small_tokens[level];
+  if (level < 7)
+    return VP8_DCT_CAT1;
+  if (level < 11)
+    return VP8_DCT_CAT2;
+  if (level < 19)
+    return VP8_DCT_CAT3;
+  if (level < 35)
+    return VP8_DCT_CAT4;
+  if (level < 67)
+    return VP8_DCT_CAT5;
+  return VP8_DCT_CAT6;
+}
+
+/* bc == NULL only tracks the above/left token contexts */
+static VOID
+media_vp8_write_block (VP8_BOOL_ENCODER * bc, INT type,
+		       const INT16 * coeffs, INT first, INT eob,
+		       BYTE * above, BYTE * left)
+{
+  if (bc)
+    {
+      const BYTE (*probs)[3][11] = vp8_default_coef_probs[type];
+      INT ctx = *above + *left;
+      INT start = 0;
+      INT i;
+
+      for (i = first; i < eob; i++)
+	{
+	  INT v = coeffs[vp8_zigzag[i]];
+	  UINT level = v < 0 ? -v : v;
+	  INT token;
+
+	  if (level > VP8_MAX_DCT_VALUE)
+	    level = VP8_MAX_DCT_VALUE;
+	  token = media_vp8_coef_token (level);
+	  media_vp8_write_tree (bc, vp8_coef_tree,
+				probs[vp8_coef_bands[i]][ctx],
+				&vp8_coef_tokens[token], start);
+
+	  if (token >= VP8_DCT_CAT1)
+	    {
+	      const BYTE *extra_probs =
+		vp8_extra_bits[token - VP8_DCT_CAT1].probs;
+	      INT len = vp8_extra_bits[token - VP8_DCT_CAT1].len;
+	      UINT extra = level - vp8_extra_bits[token - VP8_DCT_CAT1].base;
+	      INT j;
+
+	      for (j = 0; j < len; j++)
+		media_vp8_bool_write (bc, (extra >> (len - 1 - j)) & 1,
+				      extra_probs[j]);
+	    }
+
+	  if (level)
+	    media_vp8_bool_write (bc, v < 0, 128);
+
+	  ctx = level > 1 ? 2 : level;
+	  /* no EOB right after a zero */
+	  start = level ? 0 : 2;
+	}
+
+      if (eob < 16)
+	media_vp8_bool_write (bc, 0, probs[vp8_coef_bands[eob]][ctx][0]);
+    }
+
+  *above = *left = eob > first;
+}
+
+/*
+ * Context layout per MB: 0-3 Y, 4-5 U, 6-7 V, 8 Y2, as columns of the above
+ * row and rows of the left MB.
+ */
+static VOID
+media_vp8_write_mb_tokens (VP8_BOOL_ENCODER * bc, const VP8_PACKER_MB * mb,
+			   BYTE * above, BYTE * left)
+{
+  const INT16 (*coeffs)[16] = mb->code->coeffs;
+  INT first = mb->has_y2;
+  INT b;
+
+  if (mb->skip)
+    {
+      memset (above, 0, 8);
+      memset (left, 0, 8);
+      if (mb->has_y2)
+	above[8] = left[8] = 0;
+      return;
+    }
+
+  if (mb->has_y2)
+    media_vp8_write_block (bc, 1, coeffs[24], 0, mb->eob[24],
+			   above + 8, left + 8);
+
+  for (b = 0; b < 16; b++)
+    media_vp8_write_block (bc, mb->has_y2 ? 0 : 3, coeffs[b], first,
+			   mb->eob[b], above + (b & 3), left + (b >> 2));
+
+  for (b = 16; b < 24; b++)
+    {
+      INT plane = b < 20 ? 4 : 6;
+      INT sub = (b - 16) & 3;
+
+      media_vp8_write_block (bc, 2, coeffs[b], 0, mb->eob[b],
+			     above + plane + (sub & 1),
+			     left + plane + (sub >> 1));
+    }
+}
+
+static VOID *
+media_vp8_packer_token_thread (VOID * arg)
+{
+  VP8_PACKER_PARTITION *part = (VP8_PACKER_PARTITION *) arg;
+  MEDIA_VP8_PACKER *packer = part->packer;
+  BYTE left[9];
+  UINT row, col;
+
+  media_vp8_bool_start (&part->bc, part->buffer, part->limit);
+
+  for (row = part->index; row < packer->mb_rows;
+       row += packer->num_partitions)
+    {
+      BYTE *above = packer->above_ctx_rows + row * packer->mb_cols * 9;
+
+      memset (left, 0, sizeof (left));
+      for (col = 0; col < packer->mb_cols; col++)
+	media_vp8_write_mb_tokens (&part->bc,
+				   VP8_PACKER_MB_AT (packer, row, col),
+				   above + col * 9, left);
+    }
+
+  media_vp8_bool_stop (&part->bc);
+  return NULL;
+}
+
+/* Analysis */
+
+static BYTE
+media_vp8_packer_prob (UINT zeros, UINT total)
+{
+  UINT prob;
+
+  if (!total)
+    return 128;
+  prob = (zeros * 256 + (total >> 1)) / total;
+  return (BYTE) MIN (MAX (prob, 1), 255);
+}
+
+static VOID
+media_vp8_packer_analyze_mb (MEDIA_VP8_PACKER * packer, VP8_PACKER_MB * mb,
+			     INT mb_row, INT mb_col, const UINT * mv_record)
+{
+  VAEncPictureParameterBufferVP8 *pic_param = &packer->pic_param;
+  UINT dw0 = mb->code->dw0;
+  BOOL nonzero = FALSE;
+  INT i, b;
+
+  mb->segment_id = pic_param->pic_flags.bits.segmentation_enabled ?
+    VP8_PAK_MB_SEGMENT_ID (dw0) : 0;
+
+  if (packer->key_frame || !VP8_PAK_MB_INTER (dw0))
+    {
+      static const BYTE implied_b_mode[4] = {
+	VP8_B_DC_PRED, VP8_B_VE_PRED, VP8_B_HE_PRED, VP8_B_TM_PRED
+      };
+
+      mb->ref_frame = VP8_INTRA_FRAME;
+      mb->y_mode = MIN (VP8_PAK_MB_LUMA_MODE (dw0), VP8_B_PRED);
+      mb->uv_mode = VP8_PAK_MB_CHROMA_MODE (dw0);
+      for (i = 0; i < 16; i++)
+	{
+	  if (mb->y_mode == VP8_B_PRED)
+	    mb->b_modes[i] =
+	      MIN ((mb->code->sub_modes[i >> 3] >> ((i & 7) * 4)) & 0xf,
+		   VP8_B_HU_PRED);
+	  else
+	    mb->b_modes[i] = implied_b_mode[mb->y_mode];
+	}
+      memset (&mb->mv, 0, sizeof (mb->mv));
+      memset (mb->mvs, 0, sizeof (mb->mvs));
+      mb->has_y2 = mb->y_mode != VP8_B_PRED;
+      packer->intra_count++;
+    }
+  else
+    {
+      VP8_PACKER_MV nearest, nearby;
+
+      mb->ref_frame = VP8_PAK_MB_REF_FRAME (dw0);
+      if (mb->ref_frame == VP8_INTRA_FRAME)
+	mb->ref_frame = VP8_LAST_FRAME;
+      mb->uv_mode = VP8_DC_PRED;
+      memset (mb->b_modes, 0, sizeof (mb->b_modes));
+
+      if (VP8_PAK_MB_SPLIT (dw0))
+	{
+	  mb->y_mode = VP8_SPLITMV;
+	  mb->split_type = VP8_PAK_MB_SPLIT_TYPE (dw0);
+	}
+      else
+	mb->y_mode = VP8_NEWMV;
+
+      /* every block of a split partition carries the MV of its first block */
+      for (i = 0; i < 16; i++)
+	{
+	  UINT k = mb->y_mode == VP8_SPLITMV ?
+	    vp8_mbsplit_first[mb->split_type]
+	    [vp8_mbsplits[mb->split_type][i]] : 0;
+
+	  mb->mvs[i].col = (INT16) (mv_record[k] & 0xffff);
+	  mb->mvs[i].row = (INT16) (mv_record[k] >> 16);
+	}
+      mb->mv = mb->mvs[15];
+
+      media_vp8_find_near_mvs (packer, mb, mb_row, mb_col, &nearest, &nearby);
+
+      if (mb->y_mode != VP8_SPLITMV)
+	{
+	  if (media_vp8_mv_equal (mb->mv, nearest))
+	    mb->y_mode = VP8_NEARESTMV;
+	  else if (media_vp8_mv_equal (mb->mv, nearby))
+	    mb->y_mode = VP8_NEARMV;
+	  else if (media_vp8_mv_zero (mb->mv))
+	    mb->y_mode = VP8_ZEROMV;
+	}
+
+      mb->has_y2 = mb->y_mode != VP8_SPLITMV;
+      if (mb->ref_frame == VP8_LAST_FRAME)
+	packer->last_count++;
+      else if (mb->ref_frame == VP8_GOLDEN_FRAME)
+	packer->golden_count++;
+      else
+	packer->altref_count++;
+    }
+
+  for (b = 0; b < 25; b++)
+    {
+      INT first = (b < 16 && mb->has_y2) ? 1 : 0;
+      INT eob = first;
+
+      if (b == 24 && !mb->has_y2)
+	{
+	  mb->eob[b] = 0;
+	  continue;
+	}
+      for (i = 15; i >= first; i--)
+	{
+	  if (mb->code->coeffs[b][vp8_zigzag[i]])
+	    {
+	      eob = i + 1;
+	      break;
+	    }
+	}
+      mb->eob[b] = eob;
+      nonzero |= eob > first;
+    }
+
+  mb->skip = packer->use_skip && !nonzero;
+  packer->skip_count += mb->skip;
+  packer->segment_count[mb->segment_id]++;
+}
+
+/*
+ * Serial pass in raster order: decode the MB records, pick the inter
+ * modes, gather header statistics and snapshot the above token contexts
+ * at the start of every row so the token partitions are independent.
+ */
+static VOID
+media_vp8_packer_analyze (MEDIA_VP8_PACKER * packer)
+{
+  const BYTE *mv_data = packer->mb_data +
+    packer->mb_cols * packer->mb_rows * packer->mb_code_stride;
+  UINT row_ctx_size = packer->mb_cols * 9;
+  BYTE *running = packer->above_ctx_rows + packer->mb_rows * row_ctx_size;
+  BYTE left[9];
+  UINT row, col, index = 0;
+  UINT num_mbs = packer->mb_cols * packer->mb_rows;
+  UINT inter_count;
+
+  memset (packer->segment_count, 0, sizeof (packer->segment_count));
+  packer->skip_count = 0;
+  packer->intra_count = 0;
+  packer->last_count = 0;
+  packer->golden_count = 0;
+  packer->altref_count = 0;
+  memset (running, 0, row_ctx_size);
+
+  for (row = 0; row < packer->mb_rows; row++)
+    {
+      memcpy (packer->above_ctx_rows + row * row_ctx_size, running,
+	      row_ctx_size);
+      memset (left, 0, sizeof (left));
+
+      for (col = 0; col < packer->mb_cols; col++, index++)
+	{
+	  VP8_PACKER_MB *mb = VP8_PACKER_MB_AT (packer, row, col);
+
+	  memset (mb, 0, sizeof (*mb));
+	  mb->code = (const VP8_PAK_MB_CODE *)
+	    (packer->mb_data + index * packer->mb_code_stride);
+	  media_vp8_packer_analyze_mb (packer, mb, row, col,
+				       (const UINT *) (mv_data +
+						       index *
+						       packer->mv_stride));
+	  media_vp8_write_mb_tokens (NULL, mb, running + col * 9, left);
+	}
+    }
+
+  inter_count = num_mbs - packer->intra_count;
+  packer->prob_skip_false =
+    media_vp8_packer_prob (num_mbs - packer->skip_count, num_mbs);
+  packer->prob_intra = media_vp8_packer_prob (packer->intra_count, num_mbs);
+  packer->prob_last = media_vp8_packer_prob (packer->last_count, inter_count);
+  packer->prob_gf = media_vp8_packer_prob (packer->golden_count,
+					   packer->golden_count +
+					   packer->altref_count);
+  packer->segment_probs[0] =
+    media_vp8_packer_prob (packer->segment_count[0] +
+			   packer->segment_count[1], num_mbs);
+  packer->segment_probs[1] =
+    media_vp8_packer_prob (packer->segment_count[0],
+			   packer->segment_count[0] +
+			   packer->segment_count[1]);
+  packer->segment_probs[2] =
+    media_vp8_packer_prob (packer->segment_count[2],
+			   packer->segment_count[2] +
+			   packer->segment_count[3]);
+}
+
+/* First partition */
+
+static VOID
+media_vp8_packer_write_header (MEDIA_VP8_PACKER * packer,
+			       VP8_BOOL_ENCODER * bc)
+{
+  VAEncPictureParameterBufferVP8 *pic_param = &packer->pic_param;
+  VAQMatrixBufferVP8 *q_matrix = &packer->q_matrix;
+  INT i, j, k, l;
+
+  if (packer->key_frame)
+    {
+      media_vp8_bool_write_literal (bc, pic_param->pic_flags.bits.color_space,
+				    1);
+      media_vp8_bool_write_literal (bc,
+				    pic_param->pic_flags.bits.clamping_type,
+				    1);
+    }
+
+  media_vp8_bool_write_literal (bc,
+				pic_param->pic_flags.bits.segmentation_enabled,
+				1);
+  if (pic_param->pic_flags.bits.segmentation_enabled)
+    {
+      BOOL update_map = pic_param->pic_flags.bits.update_mb_segmentation_map;
+      BOOL update_data =
+	pic_param->pic_flags.bits.update_segment_feature_data;
+
+      media_vp8_bool_write_literal (bc, update_map, 1);
+      media_vp8_bool_write_literal (bc, update_data, 1);
+      if (update_data)
+	{
+	  /* absolute values */
+	  media_vp8_bool_write_literal (bc, 1, 1);
+	  for (i = 0; i < 4; i++)
+	    media_vp8_bool_write_signed (bc,
+					 q_matrix->quantization_index[i] &
+					 0x7f, 7);
+	  for (i = 0; i < 4; i++)
+	    media_vp8_bool_write_signed (bc,
+					 pic_param->loop_filter_level[i] &
+					 0x3f, 6);
+	}
+      if (update_map)
+	{
+	  for (i = 0; i < 3; i++)
+	    {
+	      media_vp8_bool_write_literal (bc, 1, 1);
+	      media_vp8_bool_write_literal (bc, packer->segment_probs[i], 8);
+	    }
+	}
+    }
+
+  media_vp8_bool_write_literal (bc,
+				pic_param->pic_flags.bits.loop_filter_type & 1,
+				1);
+  media_vp8_bool_write_literal (bc, pic_param->loop_filter_level[0] & 0x3f,
+				6);
+  media_vp8_bool_write_literal (bc, pic_param->sharpness_level & 0x7, 3);
+
+  media_vp8_bool_write_literal (bc,
+				pic_param->pic_flags.bits.
+				loop_filter_adj_enable, 1);
+  if (pic_param->pic_flags.bits.loop_filter_adj_enable)
+    {
+      media_vp8_bool_write_literal (bc, 1, 1);
+      for (i = 0; i < 4; i++)
+	media_vp8_bool_write_signed (bc, pic_param->ref_lf_delta[i], 6);
+      for (i = 0; i < 4; i++)
+	media_vp8_bool_write_signed (bc, pic_param->mode_lf_delta[i], 6);
+    }
+
+  media_vp8_bool_write_literal (bc,
+				pic_param->pic_flags.bits.num_token_partitions,
+				2);
+
+  media_vp8_bool_write_literal (bc, q_matrix->quantization_index[0] & 0x7f,
+				7);
+  media_vp8_bool_write_signed (bc,
+			       q_matrix->
+			       quantization_index_delta[QUAND_INDEX_Y1_DC_VP8],
+			       4);
+  media_vp8_bool_write_signed (bc,
+			       q_matrix->
+			       quantization_index_delta[QUAND_INDEX_Y2_DC_VP8],
+			       4);
+  media_vp8_bool_write_signed (bc,
+			       q_matrix->
+			       quantization_index_delta[QUAND_INDEX_Y2_AC_VP8],
+			       4);
+  media_vp8_bool_write_signed (bc,
+			       q_matrix->
+			       quantization_index_delta[QUAND_INDEX_UV_DC_VP8],
+			       4);
+  media_vp8_bool_write_signed (bc,
+			       q_matrix->
+			       quantization_index_delta[QUAND_INDEX_UV_AC_VP8],
+			       4);
+
+  if (packer->key_frame)
+    media_vp8_bool_write_literal (bc,
+				  pic_param->pic_flags.bits.
+				  refresh_entropy_probs, 1);
+  else
+    {
+      BOOL refresh_golden = pic_param->pic_flags.bits.refresh_golden_frame;
+      BOOL refresh_alt = pic_param->pic_flags.bits.refresh_alternate_frame;
+
+      media_vp8_bool_write_literal (bc, refresh_golden, 1);
+      media_vp8_bool_write_literal (bc, refresh_alt, 1);
+      if (!refresh_golden)
+	media_vp8_bool_write_literal (bc,
+				      pic_param->pic_flags.bits.
+				      copy_buffer_to_golden, 2);
+      if (!refresh_alt)
+	media_vp8_bool_write_literal (bc,
+				      pic_param->pic_flags.bits.
+				      copy_buffer_to_alternate, 2);
+      media_vp8_bool_write_literal (bc,
+				    pic_param->pic_flags.bits.
+				    sign_bias_golden, 1);
+      media_vp8_bool_write_literal (bc,
+				    pic_param->pic_flags.bits.
+				    sign_bias_alternate, 1);
+      media_vp8_bool_write_literal (bc,
+				    pic_param->pic_flags.bits.
+				    refresh_entropy_probs, 1);
+      media_vp8_bool_write_literal (bc, pic_param->pic_flags.bits.refresh_last,
+				    1);
+    }
+
+  /* default coefficient probabilities, no updates */
+  for (i = 0; i < 4; i++)
+    for (j = 0; j < 8; j++)
+      for (k = 0; k < 3; k++)
+	for (l = 0; l < 11; l++)
+	  media_vp8_bool_write (bc, 0, vp8_coef_update_probs[i][j][k][l]);
+
+  media_vp8_bool_write_literal (bc, packer->use_skip, 1);
+  if (packer->use_skip)
+    media_vp8_bool_write_literal (bc, packer->prob_skip_false, 8);
+
+  if (!packer->key_frame)
+    {
+      media_vp8_bool_write_literal (bc, packer->prob_intra, 8);
+      media_vp8_bool_write_literal (bc, packer->prob_last, 8);
+      media_vp8_bool_write_literal (bc, packer->prob_gf, 8);
+      /* no intra 16x16 / chroma mode probability updates */
+      media_vp8_bool_write_literal (bc, 0, 1);
+      media_vp8_bool_write_literal (bc, 0, 1);
+      for (i = 0; i < 2; i++)
+	for (j = 0; j < VP8_MVP_COUNT; j++)
+	  media_vp8_bool_write (bc, 0, vp8_mv_update_probs[i][j]);
+    }
+}
+
+static VOID
+media_vp8_packer_write_split_mv (VP8_BOOL_ENCODER * bc,
+				 const VP8_PACKER_MB * mb,
+				 const VP8_PACKER_MB * left,
+				 const VP8_PACKER_MB * above)
+{
+  INT split_type = mb->split_type;
+  INT j;
+
+  media_vp8_write_tree (bc, vp8_mbsplit_tree, vp8_mbsplit_probs,
+			&vp8_mbsplit_tokens[split_type], 0);
+
+  for (j = 0; j < vp8_mbsplit_count[split_type]; j++)
+    {
+      INT k = vp8_mbsplit_first[split_type][j];
+      VP8_PACKER_MV left_mv, above_mv, block_mv = mb->mvs[k];
+      INT context, sub_mode;
+
+      if (k & 3)
+	left_mv = mb->mvs[k - 1];
+      else
+	left_mv = left->y_mode == VP8_SPLITMV ? left->mvs[k + 3] : left->mv;
+
+      if (k > 3)
+	above_mv = mb->mvs[k - 4];
+      else
+	above_mv = above->y_mode == VP8_SPLITMV ?
+	  above->mvs[k + 12] : above->mv;
+
+      if (media_vp8_mv_equal (left_mv, above_mv))
+	context = media_vp8_mv_zero (above_mv) ? 4 : 3;
+      else if (media_vp8_mv_zero (above_mv))
+	context = 2;
+      else if (media_vp8_mv_zero (left_mv))
+	context = 1;
+      else
+	context = 0;
+
+      if (media_vp8_mv_equal (block_mv, left_mv))
+	sub_mode = VP8_LEFT4X4;
+      else if (media_vp8_mv_equal (block_mv, above_mv))
+	sub_mode = VP8_ABOVE4X4;
+      else if (media_vp8_mv_zero (block_mv))
+	sub_mode = VP8_ZERO4X4;
+      else
+	sub_mode = VP8_NEW4X4;
+
+      media_vp8_write_tree (bc, vp8_sub_mv_ref_tree,
+			    vp8_sub_mv_ref_prob[context],
+			    &vp8_sub_mv_ref_tokens[sub_mode], 0);
+      if (sub_mode == VP8_NEW4X4)
+	media_vp8_write_mv (bc, block_mv, mb->best_mv);
+    }
+}
+
+static VOID
+media_vp8_packer_write_modes (MEDIA_VP8_PACKER * packer,
+			      VP8_BOOL_ENCODER * bc)
+{
+  BOOL update_map = packer->pic_param.pic_flags.bits.segmentation_enabled &&
+    packer->pic_param.pic_flags.bits.update_mb_segmentation_map;
+  UINT row, col;
+  INT i;
+
+  for (row = 0; row < packer->mb_rows; row++)
+    {
+      for (col = 0; col < packer->mb_cols; col++)
+	{
+	  const VP8_PACKER_MB *mb = VP8_PACKER_MB_AT (packer, row, col);
+	  const VP8_PACKER_MB *left = mb - 1;
+	  const VP8_PACKER_MB *above = mb - packer->mb_stride;
+
+	  if (update_map)
+	    {
+	      media_vp8_bool_write (bc, mb->segment_id >> 1,
+				    packer->segment_probs[0]);
+	      media_vp8_bool_write (bc, mb->segment_id & 1,
+				    packer->segment_probs[1 +
+							  (mb->segment_id >>
+							   1)]);
+	    }
+	  if (packer->use_skip)
+	    media_vp8_bool_write (bc, mb->skip, packer->prob_skip_false);
+
+	  if (packer->key_frame)
+	    {
+	      media_vp8_write_tree (bc, vp8_kf_ymode_tree, vp8_kf_ymode_prob,
+				    &vp8_kf_ymode_tokens[mb->y_mode], 0);
+	      if (mb->y_mode == VP8_B_PRED)
+		{
+		  for (i = 0; i < 16; i++)
+		    {
+		      INT a = i < 4 ? above->b_modes[i + 12] :
+			mb->b_modes[i - 4];
+		      INT l = (i & 3) ? mb->b_modes[i - 1] :
+			left->b_modes[i + 3];
+
+		      media_vp8_write_tree (bc, vp8_bmode_tree,
+					    vp8_kf_bmode_probs[a][l],
+					    &vp8_bmode_tokens[mb->b_modes[i]],
+					    0);
+		    }
+		}
+	      media_vp8_write_tree (bc, vp8_uv_mode_tree, vp8_kf_uv_mode_prob,
+				    &vp8_uv_mode_tokens[mb->uv_mode], 0);
+	      continue;
+	    }
+
+	  media_vp8_bool_write (bc, mb->ref_frame != VP8_INTRA_FRAME,
+				packer->prob_intra);
+	  if (mb->ref_frame == VP8_INTRA_FRAME)
+	    {
+	      media_vp8_write_tree (bc, vp8_ymode_tree, vp8_ymode_prob,
+				    &vp8_ymode_tokens[mb->y_mode], 0);
+	      if (mb->y_mode == VP8_B_PRED)
+		{
+		  for (i = 0; i < 16; i++)
+		    media_vp8_write_tree (bc, vp8_bmode_tree, vp8_bmode_prob,
+					  &vp8_bmode_tokens[mb->b_modes[i]],
+					  0);
+		}
+	      media_vp8_write_tree (bc, vp8_uv_mode_tree, vp8_uv_mode_prob,
+				    &vp8_uv_mode_tokens[mb->uv_mode], 0);
+	      continue;
+	    }
+
+	  media_vp8_bool_write (bc, mb->ref_frame != VP8_LAST_FRAME,
+				packer->prob_last);
+	  if (mb->ref_frame != VP8_LAST_FRAME)
+	    media_vp8_bool_write (bc, mb->ref_frame == VP8_ALTREF_FRAME,
+				  packer->prob_gf);
+
+	  media_vp8_write_tree (bc, vp8_mv_ref_tree, mb->mode_probs,
+				&vp8_mv_ref_tokens[mb->y_mode], 0);
+	  if (mb->y_mode == VP8_NEWMV)
+	    media_vp8_write_mv (bc, mb->mv, mb->best_mv);
+	  else if (mb->y_mode == VP8_SPLITMV)
+	    media_vp8_packer_write_split_mv (bc, mb, left, above);
+	}
+    }
+}
+
+/* Frame assembly */
+
+static VOID
+media_vp8_packer_assemble (MEDIA_VP8_PACKER * packer, BYTE * coded)
+{
+  struct coded_buffer_segment *segment =
+    (struct coded_buffer_segment *) coded;
+  VAEncPictureParameterBufferVP8 *pic_param = &packer->pic_param;
+  VAEncSequenceParameterBufferVP8 *seq_param = &packer->seq_param;
+  BYTE *out = coded + I965_CODEDBUFFER_HEADER_SIZE;
+  UINT capacity = packer->coded_bo->size - I965_CODEDBUFFER_HEADER_SIZE;
+  UINT first_size = packer->first_bc.pos;
+  UINT total, tag, pos = 0;
+  BOOL overflow = packer->first_bc.overflow;
+  UINT i;
+
+  total = 3 + (packer->key_frame ? 7 : 0) + first_size +
+    3 * (packer->num_partitions - 1);
+  for (i = 0; i < packer->num_partitions; i++)
+    {
+      total += packer->partitions[i].bc.pos;
+      overflow |= packer->partitions[i].bc.overflow;
+    }
+
+  segment->base.bit_offset = 0;
+  segment->base.next = NULL;
+  segment->base.buf = out;
+  segment->mapped = 1;
+  segment->codec = CODEC_VP8;
+
+  if (overflow || total > capacity || first_size >= (1 << 19))
+    {
+      segment->base.size = 0;
+      segment->base.status = VA_CODED_BUF_STATUS_SLICE_OVERFLOW_MASK;
+      return;
+    }
+
+  tag = (!packer->key_frame) | (pic_param->pic_flags.bits.version << 1) |
+    (pic_param->pic_flags.bits.show_frame << 4) | (first_size << 5);
+  out[pos++] = tag & 0xff;
+  out[pos++] = (tag >> 8) & 0xff;
+  out[pos++] = (tag >> 16) & 0xff;
+
+  if (packer->key_frame)
+    {
+      UINT width = seq_param->frame_width | (seq_param->frame_width_scale << 14);
+      UINT height =
+	seq_param->frame_height | (seq_param->frame_height_scale << 14);
+
+      out[pos++] = 0x9d;
+      out[pos++] = 0x01;
+      out[pos++] = 0x2a;
+      out[pos++] = width & 0xff;
+      out[pos++] = (width >> 8) & 0xff;
+      out[pos++] = height & 0xff;
+      out[pos++] = (height >> 8) & 0xff;
+    }
+
+  memcpy (out + pos, packer->first_part, first_size);
+  pos += first_size;
+
+  for (i = 0; i + 1 < packer->num_partitions; i++)
+    {
+      UINT size = packer->partitions[i].bc.pos;
+
+      out[pos++] = size & 0xff;
+      out[pos++] = (size >> 8) & 0xff;
+      out[pos++] = (size >> 16) & 0xff;
+    }
+
+  for (i = 0; i < packer->num_partitions; i++)
+    {
+      memcpy (out + pos, packer->partitions[i].buffer,
+	      packer->partitions[i].bc.pos);
+      pos += packer->partitions[i].bc.pos;
+    }
+
+  segment->base.size = pos;
+  segment->base.status = packer->segment_status;
+}
+
+static BOOL
+media_vp8_packer_reserve (BYTE ** buffer, UINT * capacity, UINT size)
+{
+  BYTE *new_buffer;
+
+  if (*capacity >= size)
+    return TRUE;
+
+  new_buffer = (BYTE *) realloc (*buffer, size);
+  if (!new_buffer)
+    return FALSE;
+  *buffer = new_buffer;
+  *capacity = size;
+  return TRUE;
+}
+
+static VOID *
+media_vp8_packer_job (VOID * arg)
+{
+  MEDIA_VP8_PACKER *packer = (MEDIA_VP8_PACKER *) arg;
+  UINT num_mbs = packer->mb_cols * packer->mb_rows;
+  UINT coded_capacity =
+    packer->coded_bo->size - I965_CODEDBUFFER_HEADER_SIZE;
+  BYTE *coded;
+  UINT i;
+
+  /* maps once MBPAK is done with the buffer */
+  coded = (BYTE *) media_map_buffer_obj (packer->coded_bo);
+
+  /* the bitstream overwrites the MB records, work from a copy */
+  memcpy (packer->mb_data, coded + packer->mb_code_offset,
+	  num_mbs * packer->mb_code_stride);
+  memcpy (packer->mb_data + num_mbs * packer->mb_code_stride,
+	  coded + packer->mv_offset, num_mbs * packer->mv_stride);
+
+  media_vp8_packer_analyze (packer);
+
+  for (i = 0; i < packer->num_partitions; i++)
+    {
+      VP8_PACKER_PARTITION *part = &packer->partitions[i];
+      UINT rows = (packer->mb_rows - i + packer->num_partitions - 1) /
+	packer->num_partitions;
+      UINT size = MIN (rows * packer->mb_cols * VP8_PACKER_MB_TOKEN_BYTES +
+		       64, coded_capacity);
+
+      if (!media_vp8_packer_reserve (&part->buffer, &part->capacity, size))
+	size = part->capacity;
+      part->limit = size;
+      part->running =
+	pthread_create (&part->thread, NULL, media_vp8_packer_token_thread,
+			part) == 0;
+      if (!part->running)
+	media_vp8_packer_token_thread (part);
+    }
+
+  media_vp8_bool_start (&packer->first_bc, packer->first_part,
+			packer->first_part_capacity);
+  media_vp8_packer_write_header (packer, &packer->first_bc);
+  media_vp8_packer_write_modes (packer, &packer->first_bc);
+  media_vp8_bool_stop (&packer->first_bc);
+
+  for (i = 0; i < packer->num_partitions; i++)
+    {
+      if (packer->partitions[i].running)
+	pthread_join (packer->partitions[i].thread, NULL);
+      packer->partitions[i].running = FALSE;
+    }
+
+  media_vp8_packer_assemble (packer, coded);
+  media_unmap_buffer_obj (packer->coded_bo);
+  return NULL;
+}
+
+/* Coded surface hook, sync and destroy wait for the packed frame */
+
+static VOID
+media_vp8_packer_release_surface (VOID ** data)
+{
+  MEDIA_VP8_PACKER *packer = (MEDIA_VP8_PACKER *) * data;
+
+  if (packer)
+    media_vp8_packer_wait (packer);
+  *data = NULL;
+}
+
+BOOL
+media_vp8_packer_sync_surface (struct object_surface *obj_surface)
+{
+  if (!obj_surface ||
+      obj_surface->free_private_data != media_vp8_packer_release_surface ||
+      !obj_surface->private_data)
+    return FALSE;
+
+  media_vp8_packer_wait ((MEDIA_VP8_PACKER *) obj_surface->private_data);
+  return TRUE;
+}
+
+MEDIA_VP8_PACKER *
+media_vp8_packer_create (UINT mb_cols, UINT mb_rows)
+{
+  MEDIA_VP8_PACKER *packer;
+  UINT num_mbs = mb_cols * mb_rows;
+  UINT i;
+
+  pthread_once (&vp8_packer_tokens_once, media_vp8_packer_init_tokens);
+
+  packer = (MEDIA_VP8_PACKER *) media_drv_alloc_memory (sizeof (*packer));
+  if (!packer)
+    return NULL;
+
+  packer->mb_cols = mb_cols;
+  packer->mb_rows = mb_rows;
+  packer->mb_stride = mb_cols + 1;
+  packer->mb_info = (VP8_PACKER_MB *)
+    media_drv_alloc_memory (((mb_rows + 1) * packer->mb_stride + 1) *
+			    sizeof (VP8_PACKER_MB));
+  packer->above_ctx_rows =
+    (BYTE *) media_drv_alloc_memory ((mb_rows + 1) * mb_cols * 9);
+  packer->mb_data_size =
+    num_mbs * (MB_CODE_SIZE_VP8 * sizeof (UINT) + MB_MV_CODE_SIZE_VP8);
+  packer->mb_data = (BYTE *) media_drv_alloc_memory (packer->mb_data_size);
+  packer->first_part_capacity =
+    num_mbs * VP8_PACKER_MB_MODE_BYTES + VP8_PACKER_HEADER_BYTES;
+  packer->first_part =
+    (BYTE *) media_drv_alloc_memory (packer->first_part_capacity);
+
+  if (!packer->mb_info || !packer->above_ctx_rows || !packer->mb_data ||
+      !packer->first_part)
+    {
+      media_vp8_packer_destroy (packer);
+      return NULL;
+    }
+
+  packer->mbs = packer->mb_info + packer->mb_stride + 1;
+  for (i = 0; i < VP8_PACKER_MAX_PARTITIONS; i++)
+    {
+      packer->partitions[i].packer = packer;
+      packer->partitions[i].index = i;
+    }
+
+  return packer;
+}
+
+VOID
+media_vp8_packer_destroy (MEDIA_VP8_PACKER * packer)
+{
+  UINT i;
+
+  if (!packer)
+    return;
+
+  media_vp8_packer_wait (packer);
+  for (i = 0; i < VP8_PACKER_MAX_PARTITIONS; i++)
+    free (packer->partitions[i].buffer);
+  media_drv_free_memory (packer->first_part);
+  media_drv_free_memory (packer->mb_data);
+  media_drv_free_memory (packer->above_ctx_rows);
+  media_drv_free_memory (packer->mb_info);
+  media_drv_free_memory (packer);
+}
+
+VAStatus
+media_vp8_packer_submit (MEDIA_VP8_PACKER * packer,
+			 struct encode_state *encode_state,
+			 UINT mb_code_offset, UINT mb_code_stride,
+			 UINT mv_offset, UINT mv_stride, UINT segment_status)
+{
+  struct object_surface *coded_surface = encode_state->coded_buf_surface;
+  UINT num_mbs = packer->mb_cols * packer->mb_rows;
+
+  media_vp8_packer_wait (packer);
+
+  if (!coded_surface || !coded_surface->bo ||
+      coded_surface->bo->size <= I965_CODEDBUFFER_HEADER_SIZE ||
+      mb_code_offset + mb_code_stride * num_mbs > coded_surface->bo->size ||
+      mv_offset + mv_stride * num_mbs > coded_surface->bo->size ||
+      mb_code_stride * num_mbs + mv_stride * num_mbs > packer->mb_data_size)
+    return VA_STATUS_ERROR_INVALID_PARAMETER;
+
+  packer->seq_param =
+    *(VAEncSequenceParameterBufferVP8 *) encode_state->seq_param_ext->buffer;
+  packer->pic_param =
+    *(VAEncPictureParameterBufferVP8 *) encode_state->pic_param_ext->buffer;
+  packer->q_matrix = *(VAQMatrixBufferVP8 *) encode_state->q_matrix->buffer;
+  packer->key_frame = packer->pic_param.pic_flags.bits.frame_type == 0;
+  packer->use_skip = packer->pic_param.pic_flags.bits.mb_no_coeff_skip;
+  packer->num_partitions =
+    1 << packer->pic_param.pic_flags.bits.num_token_partitions;
+  packer->mb_code_offset = mb_code_offset;
+  packer->mb_code_stride = mb_code_stride;
+  packer->mv_offset = mv_offset;
+  packer->mv_stride = mv_stride;
+  packer->segment_status = segment_status;
+
+  packer->coded_bo = coded_surface->bo;
+  media_bo_reference (packer->coded_bo);
+  if (!coded_surface->private_data)
+    {
+      coded_surface->private_data = packer;
+      coded_surface->free_private_data = media_vp8_packer_release_surface;
+      packer->coded_surface = coded_surface;
+    }
+
+  packer->busy =
+    pthread_create (&packer->thread, NULL, media_vp8_packer_job, packer) == 0;
+  if (!packer->busy)
+    media_vp8_packer_job (packer);
+
+  return VA_STATUS_SUCCESS;
+}
+
+VOID
+media_vp8_packer_wait (MEDIA_VP8_PACKER * packer)
+{
+  if (packer->busy)
+    {
+      pthread_join (packer->thread, NULL);
+      packer->busy = FALSE;
+    }
+
+  if (packer->coded_surface)
+    {
+      packer->coded_surface->private_data = NULL;
+      packer->coded_surface->free_private_data = NULL;
+      packer->coded_surface = NULL;
+    }
+
+  if (packer->coded_bo)
+    {
+      media_bo_unreference (packer->coded_bo);
+      packer->coded_bo = NULL;
+    }
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _MEDIA__DRIVER_ENCODER_VP8_PACKER_H
+#define _MEDIA__DRIVER_ENCODER_VP8_PACKER_H
+#include <pthread.h>
+#include <va/va_enc_vp8.h>
+#include "media_drv_init.h"
+#include "media_drv_surface.h"
+
+#define VP8_PACKER_MAX_PARTITIONS	8
+
+/*
+ * One MB code record as left in the coded buffer by MBPAK
+ * (MB_CODE_SIZE_VP8 DWORDs). Coefficients are quantized levels in raster
+ * order inside each 4x4 block: Y 0-15, U 16-19, V 20-23, Y2 24. Modes use
+ * the bitstream numbering.
+ * The matching MV record holds 16 DWORDs, x in the low and y in the high
+ * word, quarter pel.
+ */
+typedef struct _vp8_pak_mb_code
+{
+  UINT dw0;
+  UINT sub_modes[2];		/* 4 bits per B_PRED sub block */
+  UINT reserved;
+  INT16 coeffs[25][16];
+} VP8_PAK_MB_CODE;
+
+#define VP8_PAK_MB_LUMA_MODE(dw0)	((dw0) & 0x7)
+#define VP8_PAK_MB_INTER(dw0)		(((dw0) >> 3) & 0x1)
+#define VP8_PAK_MB_CHROMA_MODE(dw0)	(((dw0) >> 4) & 0x3)
+#define VP8_PAK_MB_REF_FRAME(dw0)	(((dw0) >> 6) & 0x3)
+#define VP8_PAK_MB_SEGMENT_ID(dw0)	(((dw0) >> 8) & 0x3)
+#define VP8_PAK_MB_SPLIT(dw0)		(((dw0) >> 10) & 0x1)
+#define VP8_PAK_MB_SPLIT_TYPE(dw0)	(((dw0) >> 12) & 0x3)
+
+typedef struct _media_vp8_packer MEDIA_VP8_PACKER;
+
+MEDIA_VP8_PACKER *media_vp8_packer_create (UINT mb_cols, UINT mb_rows);
+VOID media_vp8_packer_destroy (MEDIA_VP8_PACKER * packer);
+VAStatus media_vp8_packer_submit (MEDIA_VP8_PACKER * packer,
+				  struct encode_state *encode_state,
+				  UINT mb_code_offset, UINT mb_code_stride,
+				  UINT mv_offset, UINT mv_stride,
+				  UINT segment_status);
+VOID media_vp8_packer_wait (MEDIA_VP8_PACKER * packer);
+BOOL media_vp8_packer_sync_surface (struct object_surface *obj_surface);
+#endif
@@ -0,0 +1,224 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+/*
+ * Scene cut detection for VP8 encode. Each source frame is compared with
+ * the one before it on two measures: the luma histogram distance, which
+ * is blind to motion, and the SAD of the 16x downscaled luma with a +-1 MB
+ * search, which also tells apart scenes of similar tone. A cut needs the
+ * SAD to jump well above the running average of the current scene while
+ * the histogram moves, or the histogram alone to change drastically.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "media_drv_util.h"
+#include "media_drv_encoder_vp8_scenecut.h"
+
+/* SAD on 8 bit per MB means */
+#define VP8_SCENE_CUT_MIN_SAD		4.0
+#define VP8_SCENE_CUT_SAD_RATIO		4.0
+/* histogram shape distance in luma levels */
+#define VP8_SCENE_CUT_HIST_DIST		1.0
+#define VP8_SCENE_CUT_HIST_DIST_STRONG	8.0
+
+MEDIA_VP8_SCENE_CUT *
+media_vp8_scene_cut_create (UINT mb_cols, UINT mb_rows)
+{
+  MEDIA_VP8_SCENE_CUT *scene_cut;
+  UINT num_mbs = mb_cols * mb_rows;
+
+  if (num_mbs == 0)
+    return NULL;
+  scene_cut = calloc (1, sizeof (*scene_cut));
+  if (scene_cut == NULL)
+    return NULL;
+  scene_cut->luma_16x[0] = calloc (2, num_mbs);
+  if (scene_cut->luma_16x[0] == NULL)
+    {
+      free (scene_cut);
+      return NULL;
+    }
+  scene_cut->luma_16x[1] = scene_cut->luma_16x[0] + num_mbs;
+  scene_cut->mb_cols = mb_cols;
+  scene_cut->mb_rows = mb_rows;
+
+  return scene_cut;
+}
+
+VOID
+media_vp8_scene_cut_destroy (MEDIA_VP8_SCENE_CUT * scene_cut)
+{
+  if (scene_cut == NULL)
+    return;
+  free (scene_cut->luma_16x[0]);
+  free (scene_cut);
+}
+
+/*
+ * Earth mover's distance between the two histograms less the distance of
+ * their means, in luma levels. A pure brightness shift scores 0.
+ */
+static DOUBLE
+media_vp8_scene_cut_hist_dist (const UINT * cur, const UINT * prev)
+{
+  DOUBLE cdf_cur = 0, cdf_prev = 0, emd = 0, mean_cur = 0, mean_prev = 0;
+  DOUBLE total_cur = 0, total_prev = 0;
+  INT i;
+
+  for (i = 0; i < VP8_LUMA_HISTOGRAM_BINS; i++)
+    {
+      total_cur += cur[i];
+      total_prev += prev[i];
+    }
+  if (total_cur == 0 || total_prev == 0)
+    return 0;
+
+  for (i = 0; i < VP8_LUMA_HISTOGRAM_BINS; i++)
+    {
+      cdf_cur += cur[i] / total_cur;
+      cdf_prev += prev[i] / total_prev;
+      emd += fabs (cdf_cur - cdf_prev);
+      mean_cur += i * cur[i] / total_cur;
+      mean_prev += i * prev[i] / total_prev;
+    }
+
+  return (emd - fabs (mean_cur - mean_prev)) *
+    (1 << VP8_LUMA_HISTOGRAM_SHIFT);
+}
+
+static INT
+media_vp8_scene_cut_mean (MEDIA_VP8_SCENE_CUT * scene_cut, const BYTE * luma)
+{
+  UINT num_mbs = scene_cut->mb_cols * scene_cut->mb_rows;
+  UINT sum = 0, i;
+
+  for (i = 0; i < num_mbs; i++)
+    sum += luma[i];
+
+  return (sum + num_mbs / 2) / num_mbs;
+}
+
+static DOUBLE
+media_vp8_scene_cut_sad (MEDIA_VP8_SCENE_CUT * scene_cut,
+			 const BYTE * cur, const BYTE * prev, INT offset)
+{
+  INT cols = scene_cut->mb_cols;
+  INT rows = scene_cut->mb_rows;
+  INT mb_x, mb_y, dx, dy;
+  UINT sad = 0;
+
+  for (mb_y = 0; mb_y < rows; mb_y++)
+    {
+      for (mb_x = 0; mb_x < cols; mb_x++)
+	{
+	  /* a flash saturates, so must the compensated sample */
+	  INT sample = MIN (MAX (cur[mb_y * cols + mb_x] + offset, 0), 255);
+	  INT best = 255;
+
+	  for (dy = -1; dy <= 1; dy++)
+	    {
+	      if (mb_y + dy < 0 || mb_y + dy >= rows)
+		continue;
+	      for (dx = -1; dx <= 1; dx++)
+		{
+		  if (mb_x + dx < 0 || mb_x + dx >= cols)
+		    continue;
+		  best =
+		    MIN (best,
+			 abs (sample - prev[(mb_y + dy) * cols + mb_x + dx]));
+		}
+	    }
+	  sad += best;
+	}
+    }
+
+  return (DOUBLE) sad / (cols * rows);
+}
+
+BOOL
+media_vp8_scene_cut_detect (VADriverContextP ctx,
+			    MEDIA_VP8_SCENE_CUT * scene_cut,
+			    VASurfaceID surface, BOOL key_frame,
+			    UINT min_key_dist)
+{
+  UINT cur = scene_cut->cur, prev = !scene_cut->cur;
+  DOUBLE sad, hist_dist, threshold;
+  INT offset;
+  BOOL cut = FALSE;
+
+  if (!media_vp8_luma_16x (ctx, surface, scene_cut->mb_cols,
+			   scene_cut->mb_rows, scene_cut->luma_16x[cur],
+			   scene_cut->histogram[cur]))
+    {
+      scene_cut->prev_valid = FALSE;
+      return FALSE;
+    }
+
+  if (key_frame || !scene_cut->prev_valid)
+    {
+      scene_cut->frames_since_key = 0;
+      scene_cut->avg_sad = 0;
+    }
+  else
+    {
+      /* both measures are mean compensated so flashes and fades pass */
+      offset = media_vp8_scene_cut_mean (scene_cut, scene_cut->luma_16x[prev]) -
+	media_vp8_scene_cut_mean (scene_cut, scene_cut->luma_16x[cur]);
+      sad = media_vp8_scene_cut_sad (scene_cut, scene_cut->luma_16x[cur],
+				     scene_cut->luma_16x[prev], offset);
+      hist_dist =
+	media_vp8_scene_cut_hist_dist (scene_cut->histogram[cur],
+				       scene_cut->histogram[prev]);
+
+      scene_cut->frames_since_key++;
+      threshold = MAX (VP8_SCENE_CUT_MIN_SAD,
+		       VP8_SCENE_CUT_SAD_RATIO * scene_cut->avg_sad);
+      cut = sad > 1.5 * threshold ||
+	hist_dist > VP8_SCENE_CUT_HIST_DIST_STRONG ||
+	(sad > threshold && hist_dist > VP8_SCENE_CUT_HIST_DIST);
+
+      /* a cut held off by the key frame distance still starts a scene */
+      if (cut)
+	{
+	  if (scene_cut->frames_since_key >= MAX (min_key_dist, 1))
+	    scene_cut->frames_since_key = 0;
+	  else
+	    cut = FALSE;
+	  scene_cut->avg_sad = 0;
+	}
+      else if (scene_cut->avg_sad > 0)
+	scene_cut->avg_sad = 0.875 * scene_cut->avg_sad + 0.125 * sad;
+      else
+	scene_cut->avg_sad = sad;
+    }
+
+  scene_cut->prev_valid = TRUE;
+  scene_cut->cur = prev;
+
+  return cut;
+}
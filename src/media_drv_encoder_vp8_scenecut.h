@@ -0,0 +1,49 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef _MEDIA__DRIVER_ENCODER_VP8_SCENECUT_H
+#define _MEDIA__DRIVER_ENCODER_VP8_SCENECUT_H
+#include "media_drv_encoder_vp8_lookahead.h"
+
+typedef struct _media_vp8_scene_cut
+{
+  UINT mb_cols;
+  UINT mb_rows;
+  BYTE *luma_16x[2];
+  UINT histogram[2][VP8_LUMA_HISTOGRAM_BINS];
+  UINT cur;
+  BOOL prev_valid;
+  DOUBLE avg_sad;		/* per MB, over the frames since the last cut */
+  UINT frames_since_key;
+} MEDIA_VP8_SCENE_CUT;
+
+MEDIA_VP8_SCENE_CUT *media_vp8_scene_cut_create (UINT mb_cols, UINT mb_rows);
+VOID media_vp8_scene_cut_destroy (MEDIA_VP8_SCENE_CUT * scene_cut);
+BOOL media_vp8_scene_cut_detect (VADriverContextP ctx,
+				 MEDIA_VP8_SCENE_CUT * scene_cut,
+				 VASurfaceID surface, BOOL key_frame,
+				 UINT min_key_dist);
+#endif
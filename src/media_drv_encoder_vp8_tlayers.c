@@ -0,0 +1,298 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Temporal scalability for VP8 encode. A repeating pattern assigns each
+ * frame a temporal layer, the layer decides which of LAST, GOLDEN and
+ * ALTREF the frame predicts from and which one it refreshes. Every layer
+ * keeps its own BRC buffer model over its own frames only.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "media_drv_util.h"
+#include "media_drv_encoder_vp8_tlayers.h"
+
+static const BYTE vp8_temporal_pattern_2[] = { 0, 1 };
+static const BYTE vp8_temporal_pattern_3[] = { 0, 2, 1, 2 };
+
+/*
+ * The base layer keeps the encoder's own BRC history buffer, the upper
+ * ones get a buffer of the same size.
+ */
+MEDIA_VP8_TEMPORAL_LAYERS *
+media_vp8_temporal_layers_create (dri_bufmgr * bufmgr,
+				  const MEDIA_RESOURCE * brc_history)
+{
+  MEDIA_VP8_TEMPORAL_LAYERS *tl;
+  INT i;
+
+  tl = calloc (1, sizeof (*tl));
+  if (tl == NULL)
+    return NULL;
+
+  tl->layers[0].brc_history = *brc_history;
+  for (i = 1; i < VP8_MAX_TEMPORAL_LAYERS; i++)
+    {
+      tl->layers[i].brc_history = *brc_history;
+      media_allocate_resource (&tl->layers[i].brc_history, bufmgr,
+			       (const BYTE *) "BRC layer history buffer",
+			       brc_history->bo_size, 4096);
+      if (tl->layers[i].brc_history.bo == NULL)
+	{
+	  media_vp8_temporal_layers_destroy (tl);
+	  return NULL;
+	}
+    }
+  for (i = 0; i < VP8_NUM_REFS; i++)
+    tl->ref_surface[i] = VA_INVALID_SURFACE;
+
+  return tl;
+}
+
+VOID
+media_vp8_temporal_layers_destroy (MEDIA_VP8_TEMPORAL_LAYERS * tl)
+{
+  INT i;
+
+  if (tl == NULL)
+    return;
+  for (i = 1; i < VP8_MAX_TEMPORAL_LAYERS; i++)
+    media_bo_unreference (tl->layers[i].brc_history.bo);
+  free (tl);
+}
+
+static BOOL
+media_vp8_temporal_pattern_valid (UINT num_layers, UINT periodicity,
+				  const UINT * layer_id)
+{
+  BOOL used[VP8_MAX_TEMPORAL_LAYERS] = { FALSE };
+  UINT i;
+
+  if (periodicity == 0 || periodicity > VP8_TEMPORAL_MAX_PERIODICITY ||
+      layer_id[0] != 0)
+    return FALSE;
+  for (i = 0; i < periodicity; i++)
+    {
+      if (layer_id[i] >= num_layers)
+	return FALSE;
+      used[layer_id[i]] = TRUE;
+    }
+  for (i = 0; i < num_layers; i++)
+    if (!used[i])
+      return FALSE;
+
+  return TRUE;
+}
+
+/*
+ * Takes the application's pattern when every layer shows up in it and it
+ * starts on the base layer, else the 0-1 or 0-2-1-2 default. A changed
+ * structure restarts the pattern and sets every layer's BRC up again.
+ */
+BOOL
+media_vp8_temporal_layers_set_structure (MEDIA_VP8_TEMPORAL_LAYERS * tl,
+					 UINT num_layers, UINT periodicity,
+					 const UINT * layer_id)
+{
+  BYTE pattern[VP8_TEMPORAL_MAX_PERIODICITY];
+  UINT i;
+
+  if (num_layers < 2 || num_layers > VP8_MAX_TEMPORAL_LAYERS)
+    return FALSE;
+
+  if (layer_id &&
+      media_vp8_temporal_pattern_valid (num_layers, periodicity, layer_id))
+    {
+      for (i = 0; i < periodicity; i++)
+	pattern[i] = layer_id[i];
+    }
+  else if (num_layers == 2)
+    {
+      periodicity = ARRAY_ELEMS (vp8_temporal_pattern_2);
+      memcpy (pattern, vp8_temporal_pattern_2, periodicity);
+    }
+  else
+    {
+      periodicity = ARRAY_ELEMS (vp8_temporal_pattern_3);
+      memcpy (pattern, vp8_temporal_pattern_3, periodicity);
+    }
+
+  if (tl->num_layers == num_layers && tl->periodicity == periodicity &&
+      !memcmp (tl->layer_id, pattern, periodicity))
+    return TRUE;
+
+  tl->num_layers = num_layers;
+  tl->periodicity = periodicity;
+  memcpy (tl->layer_id, pattern, periodicity);
+  tl->pattern_index = 0;
+  for (i = 0; i < VP8_MAX_TEMPORAL_LAYERS; i++)
+    {
+      tl->layers[i].frames_per_period = 0;
+      tl->layers[i].brc_initted = FALSE;
+      tl->layers[i].brc_need_reset = FALSE;
+    }
+  for (i = 0; i < periodicity; i++)
+    tl->layers[pattern[i]].frames_per_period++;
+
+  return TRUE;
+}
+
+VOID
+media_vp8_temporal_layers_set_refs (MEDIA_VP8_TEMPORAL_LAYERS * tl,
+				    const VASurfaceID * surface,
+				    const BYTE * q_index)
+{
+  INT i;
+
+  for (i = 0; i < VP8_NUM_REFS; i++)
+    {
+      tl->ref_surface[i] = surface[i];
+      tl->ref_q_index[i] = q_index[i];
+    }
+}
+
+/*
+ * Picks the layer of the next frame and its references. Key frames
+ * restart the pattern and refresh every slot. A slot holding the same
+ * surface as a lower one is not referenced twice.
+ */
+VOID
+media_vp8_temporal_layers_next (MEDIA_VP8_TEMPORAL_LAYERS * tl,
+				BOOL key_frame,
+				MEDIA_VP8_TEMPORAL_REFS * refs)
+{
+  UINT layer, i, j;
+
+  if (key_frame)
+    tl->pattern_index = 0;
+  layer = tl->layer_id[tl->pattern_index];
+  tl->pattern_index = (tl->pattern_index + 1) % tl->periodicity;
+
+  media_drv_memset (refs, sizeof (*refs));
+  refs->layer = layer;
+  for (i = 0; i < VP8_NUM_REFS; i++)
+    {
+      refs->surface[i] = tl->ref_surface[i];
+      refs->q_index[i] = tl->ref_q_index[i];
+    }
+
+  if (key_frame)
+    {
+      for (i = 0; i < VP8_NUM_REFS; i++)
+	refs->refresh[i] = TRUE;
+      return;
+    }
+
+  /* the slot index of a layer is the one it refreshes */
+  for (i = 0; i <= layer; i++)
+    {
+      if (tl->ref_surface[i] == VA_INVALID_SURFACE)
+	continue;
+      refs->ref[i] = TRUE;
+      for (j = 0; j < i; j++)
+	if (refs->ref[j] && tl->ref_surface[j] == tl->ref_surface[i])
+	  refs->ref[i] = FALSE;
+    }
+  refs->refresh[layer] = TRUE;
+}
+
+VOID
+media_vp8_temporal_layers_update (MEDIA_VP8_TEMPORAL_LAYERS * tl,
+				  const MEDIA_VP8_TEMPORAL_REFS * refs,
+				  VASurfaceID reconstructed, BYTE q_index)
+{
+  INT i;
+
+  for (i = 0; i < VP8_NUM_REFS; i++)
+    if (refs->refresh[i])
+      {
+	tl->ref_surface[i] = reconstructed;
+	tl->ref_q_index[i] = q_index;
+      }
+  tl->prev_layer = refs->layer;
+  tl->prev_valid = TRUE;
+}
+
+/* the size the application reports is the one of the previous frame */
+VOID
+media_vp8_temporal_layers_frame_size (MEDIA_VP8_TEMPORAL_LAYERS * tl,
+				      UINT prev_frame_size)
+{
+  if (tl->prev_valid)
+    tl->layers[tl->prev_layer].prev_frame_size = prev_frame_size;
+}
+
+/*
+ * BRC inputs of a layer. Its BRC only sees its own frames, so it gets the
+ * rate of those frames as if they came at the full frame rate, which
+ * keeps the bits per frame, and buffer sizes scaled the same way. The
+ * per layer rates are cumulative as in VA, 0 where the application sent
+ * none; a layer without one gets the same bits per frame as the stream.
+ */
+VOID
+media_vp8_temporal_layers_set_rate (MEDIA_VP8_TEMPORAL_LAYERS * tl,
+				    UINT layer, const UINT * layer_bit_rate,
+				    UINT target_bit_rate, UINT max_bit_rate,
+				    UINT min_bit_rate,
+				    ULONG vbv_buffer_size_in_bit,
+				    ULONG init_vbv_buffer_fullness_in_bit)
+{
+  MEDIA_VP8_TEMPORAL_LAYER *l = &tl->layers[layer];
+  UINT frames = l->frames_per_period;
+  uint64_t own;
+  DOUBLE scale;
+  UINT rate;
+
+  if (frames == 0 || target_bit_rate == 0)
+    {
+      rate = target_bit_rate;
+      scale = 1.0;
+    }
+  else
+    {
+      if (layer_bit_rate[layer] &&
+	  (layer == 0 || (layer_bit_rate[layer - 1] &&
+			  layer_bit_rate[layer] > layer_bit_rate[layer - 1])))
+	own = layer_bit_rate[layer] - (layer ? layer_bit_rate[layer - 1] : 0);
+      else
+	own = (uint64_t) target_bit_rate * frames / tl->periodicity;
+      rate = (UINT) (own * tl->periodicity / frames);
+      scale = (DOUBLE) rate / target_bit_rate;
+    }
+
+  if (l->brc_initted &&
+      (l->target_bit_rate != rate ||
+       l->max_bit_rate != (UINT) (max_bit_rate * scale) ||
+       l->vbv_buffer_size_in_bit != (ULONG) (vbv_buffer_size_in_bit * scale)))
+    l->brc_need_reset = TRUE;
+
+  l->target_bit_rate = rate;
+  l->max_bit_rate = (UINT) (max_bit_rate * scale);
+  l->min_bit_rate = (UINT) (min_bit_rate * scale);
+  l->vbv_buffer_size_in_bit = (ULONG) (vbv_buffer_size_in_bit * scale);
+  l->init_vbv_buffer_fullness_in_bit =
+    (ULONG) (init_vbv_buffer_fullness_in_bit * scale);
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _MEDIA__DRIVER_ENCODER_VP8_TLAYERS_H
+#define _MEDIA__DRIVER_ENCODER_VP8_TLAYERS_H
+#include "media_drv_batchbuffer.h"
+
+#define VP8_MAX_TEMPORAL_LAYERS		3
+#define VP8_TEMPORAL_MAX_PERIODICITY	16
+
+/* reference slots, also the MBEnc ref_frame_ctrl bit order */
+#define VP8_REF_LAST			0
+#define VP8_REF_GOLDEN			1
+#define VP8_REF_ALTREF			2
+#define VP8_NUM_REFS			3
+
+typedef struct _media_vp8_temporal_layer
+{
+  UINT frames_per_period;
+  /* BRC rate inputs: the layer's own frames as if at the full frame rate */
+  UINT target_bit_rate;
+  UINT max_bit_rate;
+  UINT min_bit_rate;
+  ULONG vbv_buffer_size_in_bit;
+  ULONG init_vbv_buffer_fullness_in_bit;
+  /* BRC state of the layer, swapped into the encoder while it codes */
+  MEDIA_RESOURCE brc_history;
+  BOOL brc_initted;
+  BOOL brc_need_reset;
+  DOUBLE buf_full_in_bits;
+  DOUBLE input_bits_per_frame;
+  UINT buf_size_in_bits;
+  UINT prev_frame_size;		/* coded bytes of its last frame */
+} MEDIA_VP8_TEMPORAL_LAYER;
+
+typedef struct _media_vp8_temporal_refs
+{
+  UINT layer;
+  BOOL ref[VP8_NUM_REFS];
+  BOOL refresh[VP8_NUM_REFS];
+  VASurfaceID surface[VP8_NUM_REFS];
+  BYTE q_index[VP8_NUM_REFS];
+} MEDIA_VP8_TEMPORAL_REFS;
+
+/*
+ * Layer 0 only predicts from and refreshes LAST, layer 1 also predicts
+ * from GOLDEN and refreshes it, layer 2 predicts from all three and
+ * refreshes ALTREF, so dropping the upper layers leaves a decodable
+ * stream. The driver picks the references among the reconstructed
+ * surfaces it was given; the application keeps the ones of the last
+ * periodicity frames alive.
+ */
+typedef struct _media_vp8_temporal_layers
+{
+  UINT num_layers;
+  UINT periodicity;
+  BYTE layer_id[VP8_TEMPORAL_MAX_PERIODICITY];
+  UINT pattern_index;
+  UINT prev_layer;
+  BOOL prev_valid;
+  VASurfaceID ref_surface[VP8_NUM_REFS];
+  BYTE ref_q_index[VP8_NUM_REFS];
+  MEDIA_VP8_TEMPORAL_LAYER layers[VP8_MAX_TEMPORAL_LAYERS];
+} MEDIA_VP8_TEMPORAL_LAYERS;
+
+MEDIA_VP8_TEMPORAL_LAYERS *media_vp8_temporal_layers_create (dri_bufmgr *
+							     bufmgr,
+							     const
+							     MEDIA_RESOURCE *
+							     brc_history);
+VOID media_vp8_temporal_layers_destroy (MEDIA_VP8_TEMPORAL_LAYERS * tl);
+BOOL media_vp8_temporal_layers_set_structure (MEDIA_VP8_TEMPORAL_LAYERS * tl,
+					      UINT num_layers,
+					      UINT periodicity,
+					      const UINT * layer_id);
+VOID media_vp8_temporal_layers_set_refs (MEDIA_VP8_TEMPORAL_LAYERS * tl,
+					 const VASurfaceID * surface,
+					 const BYTE * q_index);
+VOID media_vp8_temporal_layers_next (MEDIA_VP8_TEMPORAL_LAYERS * tl,
+				     BOOL key_frame,
+				     MEDIA_VP8_TEMPORAL_REFS * refs);
+VOID media_vp8_temporal_layers_update (MEDIA_VP8_TEMPORAL_LAYERS * tl,
+				       const MEDIA_VP8_TEMPORAL_REFS * refs,
+				       VASurfaceID reconstructed,
+				       BYTE q_index);
+VOID media_vp8_temporal_layers_frame_size (MEDIA_VP8_TEMPORAL_LAYERS * tl,
+					   UINT prev_frame_size);
+VOID media_vp8_temporal_layers_set_rate (MEDIA_VP8_TEMPORAL_LAYERS * tl,
+					 UINT layer,
+					 const UINT * layer_bit_rate,
+					 UINT target_bit_rate,
+					 UINT max_bit_rate, UINT min_bit_rate,
+					 ULONG vbv_buffer_size_in_bit,
+					 ULONG init_vbv_buffer_fullness_in_bit);
+#endif
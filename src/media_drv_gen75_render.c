@@ -129,7 +129,7 @@ i965_render_cc_viewport(VADriverContextP ctx)
     struct media_render_state *render_state = &drv_ctx->render_state;
     struct i965_cc_viewport *cc_viewport;
 
-    dri_bo_map(render_state->cc.viewport, 1);
+    media_bo_map(render_state->cc.viewport, 1);
     assert(render_state->cc.viewport->virtual);
     cc_viewport = render_state->cc.viewport->virtual;
     memset(cc_viewport, 0, sizeof(*cc_viewport));
@@ -137,7 +137,7 @@ i965_render_cc_viewport(VADriverContextP ctx)
     cc_viewport->min_depth = -1.e35;
     cc_viewport->max_depth = 1.e35;
 
-    dri_bo_unmap(render_state->cc.viewport);
+    media_bo_unmap(render_state->cc.viewport);
 }
 
 static void
@@ -196,7 +196,7 @@ gen7_render_set_surface_state(
 
     ss->ss3.pitch = pitch - 1;
 
-    dri_bo_get_tiling(bo, &tiling, &swizzle);
+    media_bo_get_tiling(bo, &tiling, &swizzle);
     gen7_render_set_surface_tiling(ss, tiling);
 }
 
@@ -221,7 +221,7 @@ i965_render_src_surface_state(
 
     assert(index < MAX_RENDER_SURFACES);
 
-    dri_bo_map(ss_bo, 1);
+    media_bo_map(ss_bo, 1);
     assert(ss_bo->virtual);
     ss = (char *)ss_bo->virtual + RENDER_SURFACE_STATE_OFFSET(index);
 
@@ -230,14 +230,14 @@ i965_render_src_surface_state(
                                       w, h,
                                       pitch, format, flags);
         gen7_render_set_surface_scs(ss);
-        dri_bo_emit_reloc(ss_bo,
-                          I915_GEM_DOMAIN_SAMPLER, 0,
-                          offset,
-                          RENDER_SURFACE_STATE_OFFSET(index) + offsetof(struct gen7_surface_state, ss1),
-                          region);
+        media_bo_emit_reloc(ss_bo,
+                            I915_GEM_DOMAIN_SAMPLER, 0,
+                            offset,
+                            RENDER_SURFACE_STATE_OFFSET(index) + offsetof(struct gen7_surface_state, ss1),
+                            region);
 
     ((unsigned int *)((char *)ss_bo->virtual + RENDER_BINDING_TABLE_OFFSET))[index] = RENDER_SURFACE_STATE_OFFSET(index);
-    dri_bo_unmap(ss_bo);
+    media_bo_unmap(ss_bo);
     render_state->wm.sampler_count++;
 }
 
@@ -309,7 +309,7 @@ i965_render_dest_surface_state(VADriverContextP ctx, int index)
         format = I965_SURFACEFORMAT_B8G8R8A8_UNORM;
     }
 
-    dri_bo_map(ss_bo, 1);
+    media_bo_map(ss_bo, 1);
     assert(ss_bo->virtual);
     ss = (char *)ss_bo->virtual + RENDER_SURFACE_STATE_OFFSET(index);
 
@@ -318,14 +318,14 @@ i965_render_dest_surface_state(VADriverContextP ctx, int index)
                                       dest_region->width, dest_region->height,
                                       dest_region->pitch, format, 0);
         gen7_render_set_surface_scs(ss);
-        dri_bo_emit_reloc(ss_bo,
-                          I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER,
-                          0,
-                          RENDER_SURFACE_STATE_OFFSET(index) + offsetof(struct gen7_surface_state, ss1),
-                          dest_region->bo);
+        media_bo_emit_reloc(ss_bo,
+                            I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER,
+                            0,
+                            RENDER_SURFACE_STATE_OFFSET(index) + offsetof(struct gen7_surface_state, ss1),
+                            dest_region->bo);
 
     ((unsigned int *)((char *)ss_bo->virtual + RENDER_BINDING_TABLE_OFFSET))[index] = RENDER_SURFACE_STATE_OFFSET(index);
-    dri_bo_unmap(ss_bo);
+    media_bo_unmap(ss_bo);
 }
 
 static void
@@ -365,7 +365,7 @@ i965_fill_vertex_buffer(
     vb[10] = vid_coords[X1];
     vb[11] = vid_coords[Y1];
 
-    dri_bo_subdata(drv_ctx->render_state.vb.vertex_buffer, 0, sizeof(vb), vb);
+    media_bo_subdata(drv_ctx->render_state.vb.vertex_buffer, 0, sizeof(vb), vb);
 }
 
 static void
@@ -416,7 +416,7 @@ i965_render_upload_constants(VADriverContextP ctx,
     float *yuv_to_rgb;
     unsigned int color_flag;
 
-    dri_bo_map(render_state->curbe.bo, 1);
+    media_bo_map(render_state->curbe.bo, 1);
     assert(render_state->curbe.bo->virtual);
     constant_buffer = render_state->curbe.bo->virtual;
 
@@ -454,7 +454,7 @@ i965_render_upload_constants(VADriverContextP ctx,
     else
         memcpy(yuv_to_rgb, yuv_to_rgb_bt601, sizeof(yuv_to_rgb_bt601));
 
-    dri_bo_unmap(render_state->curbe.bo);
+    media_bo_unmap(render_state->curbe.bo);
 }
 
 
@@ -530,67 +530,68 @@ gen7_render_initialize(VADriverContextP ctx)
     dri_bo *bo;
 
     /* VERTEX BUFFER */
-    dri_bo_unreference(render_state->vb.vertex_buffer);
-    bo = dri_bo_alloc(drv_ctx->drv_data.bufmgr,
-                      "vertex buffer",
-                      4096,
-                      4096);
+    media_bo_unreference(render_state->vb.vertex_buffer);
+    bo = media_bo_alloc(drv_ctx->drv_data.bufmgr,
+                        "vertex buffer",
+                        4096,
+                        4096);
     assert(bo);
     render_state->vb.vertex_buffer = bo;
 
     /* WM */
-    dri_bo_unreference(render_state->wm.surface_state_binding_table_bo);
-    bo = dri_bo_alloc(drv_ctx->drv_data.bufmgr,
-                      "surface state & binding table",
-                      (SURFACE_STATE_PADDED_SIZE + sizeof(unsigned int)) * MAX_RENDER_SURFACES,
-                      4096);
+    media_bo_unreference(render_state->wm.surface_state_binding_table_bo);
+    bo = media_bo_alloc(drv_ctx->drv_data.bufmgr,
+                        "surface state & binding table",
+                        (SURFACE_STATE_PADDED_SIZE + sizeof(unsigned int)) * MAX_RENDER_SURFACES,
+                        4096);
     assert(bo);
     render_state->wm.surface_state_binding_table_bo = bo;
 
-    dri_bo_unreference(render_state->wm.sampler);
-    bo = dri_bo_alloc(drv_ctx->drv_data.bufmgr,
-                      "sampler state",
-                      MAX_SAMPLERS * sizeof(struct gen7_sampler_state),
-                      4096);
-    assert(bo);
-    render_state->wm.sampler = bo;
     render_state->wm.sampler_count = 0;
 
-    /* COLOR CALCULATOR */
-    dri_bo_unreference(render_state->cc.state);
-    bo = dri_bo_alloc(drv_ctx->drv_data.bufmgr,
-                      "color calc state",
-                      sizeof(struct gen6_color_calc_state),
-                      4096);
-    assert(bo);
-    render_state->cc.state = bo;
-
-    /* CC VIEWPORT */
-    dri_bo_unreference(render_state->cc.viewport);
-    bo = dri_bo_alloc(drv_ctx->drv_data.bufmgr,
-                      "cc viewport",
-                      sizeof(struct i965_cc_viewport),
-                      4096);
-    assert(bo);
-    render_state->cc.viewport = bo;
-
-    /* BLEND STATE */
-    dri_bo_unreference(render_state->cc.blend);
-    bo = dri_bo_alloc(drv_ctx->drv_data.bufmgr,
-                      "blend state",
-                      sizeof(struct gen6_blend_state),
-                      4096);
-    assert(bo);
-    render_state->cc.blend = bo;
-
-    /* DEPTH & STENCIL STATE */
-    dri_bo_unreference(render_state->cc.depth_stencil);
-    bo = dri_bo_alloc(drv_ctx->drv_data.bufmgr,
-                      "depth & stencil state",
-                      sizeof(struct gen6_depth_stencil_state),
-                      4096);
-    assert(bo);
-    render_state->cc.depth_stencil = bo;
+    /* the static state BOs are kept across calls, see media_render_cache_update() */
+    if (!render_state->wm.sampler) {
+        bo = media_bo_alloc(drv_ctx->drv_data.bufmgr,
+                            "sampler state",
+                            MAX_SAMPLERS * sizeof(struct gen7_sampler_state),
+                            4096);
+        assert(bo);
+        render_state->wm.sampler = bo;
+
+        /* COLOR CALCULATOR */
+        bo = media_bo_alloc(drv_ctx->drv_data.bufmgr,
+                            "color calc state",
+                            sizeof(struct gen6_color_calc_state),
+                            4096);
+        assert(bo);
+        render_state->cc.state = bo;
+
+        /* CC VIEWPORT */
+        bo = media_bo_alloc(drv_ctx->drv_data.bufmgr,
+                            "cc viewport",
+                            sizeof(struct i965_cc_viewport),
+                            4096);
+        assert(bo);
+        render_state->cc.viewport = bo;
+
+        /* BLEND STATE */
+        bo = media_bo_alloc(drv_ctx->drv_data.bufmgr,
+                            "blend state",
+                            sizeof(struct gen6_blend_state),
+                            4096);
+        assert(bo);
+        render_state->cc.blend = bo;
+
+        /* DEPTH & STENCIL STATE */
+        bo = media_bo_alloc(drv_ctx->drv_data.bufmgr,
+                            "depth & stencil state",
+                            sizeof(struct gen6_depth_stencil_state),
+                            4096);
+        assert(bo);
+        render_state->cc.depth_stencil = bo;
+
+        render_state->cache_valid = FALSE;
+    }
 }
 
 static void
@@ -600,7 +601,7 @@ gen7_render_color_calc_state(VADriverContextP ctx)
     struct media_render_state *render_state = &drv_ctx->render_state;
     struct gen6_color_calc_state *color_calc_state;
 
-    dri_bo_map(render_state->cc.state, 1);
+    media_bo_map(render_state->cc.state, 1);
     assert(render_state->cc.state->virtual);
     color_calc_state = render_state->cc.state->virtual;
     memset(color_calc_state, 0, sizeof(*color_calc_state));
@@ -608,7 +609,7 @@ gen7_render_color_calc_state(VADriverContextP ctx)
     color_calc_state->constant_g = 0.0;
     color_calc_state->constant_b = 1.0;
     color_calc_state->constant_a = 1.0;
-    dri_bo_unmap(render_state->cc.state);
+    media_bo_unmap(render_state->cc.state);
 }
 
 static void
@@ -618,14 +619,14 @@ gen7_render_blend_state(VADriverContextP ctx)
     struct media_render_state *render_state = &drv_ctx->render_state;
     struct gen6_blend_state *blend_state;
 
-    dri_bo_map(render_state->cc.blend, 1);
+    media_bo_map(render_state->cc.blend, 1);
     assert(render_state->cc.blend->virtual);
     blend_state = render_state->cc.blend->virtual;
     memset(blend_state, 0, sizeof(*blend_state));
     blend_state->blend1.logic_op_enable = 1;
     blend_state->blend1.logic_op_func = 0xc;
     blend_state->blend1.pre_blend_clamp_enable = 1;
-    dri_bo_unmap(render_state->cc.blend);
+    media_bo_unmap(render_state->cc.blend);
 }
 
 static void
@@ -635,11 +636,11 @@ gen7_render_depth_stencil_state(VADriverContextP ctx)
     struct media_render_state *render_state = &drv_ctx->render_state;
     struct gen6_depth_stencil_state *depth_stencil_state;
 
-    dri_bo_map(render_state->cc.depth_stencil, 1);
+    media_bo_map(render_state->cc.depth_stencil, 1);
     assert(render_state->cc.depth_stencil->virtual);
     depth_stencil_state = render_state->cc.depth_stencil->virtual;
     memset(depth_stencil_state, 0, sizeof(*depth_stencil_state));
-    dri_bo_unmap(render_state->cc.depth_stencil);
+    media_bo_unmap(render_state->cc.depth_stencil);
 }
 
 static void
@@ -653,7 +654,7 @@ gen7_render_sampler(VADriverContextP ctx)
     assert(render_state->wm.sampler_count > 0);
     assert(render_state->wm.sampler_count <= MAX_SAMPLERS);
 
-    dri_bo_map(render_state->wm.sampler, 1);
+    media_bo_map(render_state->wm.sampler, 1);
     assert(render_state->wm.sampler->virtual);
     sampler_state = render_state->wm.sampler->virtual;
     for (i = 0; i < render_state->wm.sampler_count; i++) {
@@ -666,7 +667,7 @@ gen7_render_sampler(VADriverContextP ctx)
         sampler_state++;
     }
 
-    dri_bo_unmap(render_state->wm.sampler);
+    media_bo_unmap(render_state->wm.sampler);
 }
 
 
@@ -681,12 +682,16 @@ gen7_render_setup_states(
 {
     i965_render_dest_surface_state(ctx, 0);
     i965_render_src_surfaces_state(ctx, obj_surface, flags);
-    gen7_render_sampler(ctx);
-    i965_render_cc_viewport(ctx);
-    gen7_render_color_calc_state(ctx);
-    gen7_render_blend_state(ctx);
-    gen7_render_depth_stencil_state(ctx);
-    i965_render_upload_constants(ctx, obj_surface, flags);
+
+    if (media_render_cache_update(ctx, obj_surface, flags)) {
+        gen7_render_sampler(ctx);
+        i965_render_cc_viewport(ctx);
+        gen7_render_color_calc_state(ctx);
+        gen7_render_blend_state(ctx);
+        gen7_render_depth_stencil_state(ctx);
+        i965_render_upload_constants(ctx, obj_surface, flags);
+    }
+
     i965_render_upload_vertex(ctx, obj_surface, src_rect, dst_rect);
 }
 
@@ -1235,8 +1240,8 @@ gen7_subpicture_render_blend_state(VADriverContextP ctx)
     struct media_render_state *render_state = &drv_ctx->render_state;
     struct gen6_blend_state *blend_state;
 
-    dri_bo_unmap(render_state->cc.state);
-    dri_bo_map(render_state->cc.blend, 1);
+    media_bo_unmap(render_state->cc.state);
+    media_bo_map(render_state->cc.blend, 1);
     assert(render_state->cc.blend->virtual);
     blend_state = render_state->cc.blend->virtual;
     memset(blend_state, 0, sizeof(*blend_state));
@@ -1247,7 +1252,7 @@ gen7_subpicture_render_blend_state(VADriverContextP ctx)
     blend_state->blend1.post_blend_clamp_enable = 1;
     blend_state->blend1.pre_blend_clamp_enable = 1;
     blend_state->blend1.clamp_range = 0; /* clamp range [0, 1] */
-    dri_bo_unmap(render_state->cc.blend);
+    media_bo_unmap(render_state->cc.blend);
 }
 
 static void
@@ -1265,13 +1270,13 @@ i965_subpic_render_upload_constants(VADriverContextP ctx,
         global_alpha = obj_subpic->global_alpha;
     }
 
-    dri_bo_map(render_state->curbe.bo, 1);
+    media_bo_map(render_state->curbe.bo, 1);
 
     assert(render_state->curbe.bo->virtual);
     constant_buffer = render_state->curbe.bo->virtual;
     *constant_buffer = global_alpha;
 
-    dri_bo_unmap(render_state->curbe.bo);
+    media_bo_unmap(render_state->curbe.bo);
 }
 
 static void
@@ -1316,6 +1321,7 @@ gen7_subpicture_render_setup_states(
     const VARectangle *dst_rect
 )
 {
+    media_render_cache_invalidate(ctx);
     i965_render_dest_surface_state(ctx, 0);
     i965_subpic_render_src_surfaces_state(ctx, obj_surface);
     gen7_render_sampler(ctx);
@@ -1405,38 +1411,38 @@ genx_render_terminate(VADriverContextP ctx)
     MEDIA_DRV_CONTEXT *drv_ctx = (MEDIA_DRV_CONTEXT *) (ctx->pDriverData);
     struct media_render_state *render_state = &drv_ctx->render_state;
 
-    dri_bo_unreference(render_state->curbe.bo);
+    media_bo_unreference(render_state->curbe.bo);
     render_state->curbe.bo = NULL;
 
     for (i = 0; i < sizeof(render_kernels_gen7_haswell) / sizeof(struct media_render_kernel); i++) {
         struct media_render_kernel *kernel = &render_state->render_kernels[i];
 
-        dri_bo_unreference(kernel->bo);
+        media_bo_unreference(kernel->bo);
         kernel->bo = NULL;
     }
 
-    dri_bo_unreference(render_state->vb.vertex_buffer);
+    media_bo_unreference(render_state->vb.vertex_buffer);
     render_state->vb.vertex_buffer = NULL;
-    dri_bo_unreference(render_state->vs.state);
+    media_bo_unreference(render_state->vs.state);
     render_state->vs.state = NULL;
-    dri_bo_unreference(render_state->sf.state);
+    media_bo_unreference(render_state->sf.state);
     render_state->sf.state = NULL;
-    dri_bo_unreference(render_state->wm.sampler);
+    media_bo_unreference(render_state->wm.sampler);
     render_state->wm.sampler = NULL;
-    dri_bo_unreference(render_state->wm.state);
+    media_bo_unreference(render_state->wm.state);
     render_state->wm.state = NULL;
-    dri_bo_unreference(render_state->wm.surface_state_binding_table_bo);
-    dri_bo_unreference(render_state->cc.viewport);
+    media_bo_unreference(render_state->wm.surface_state_binding_table_bo);
+    media_bo_unreference(render_state->cc.viewport);
     render_state->cc.viewport = NULL;
-    dri_bo_unreference(render_state->cc.state);
+    media_bo_unreference(render_state->cc.state);
     render_state->cc.state = NULL;
-    dri_bo_unreference(render_state->cc.blend);
+    media_bo_unreference(render_state->cc.blend);
     render_state->cc.blend = NULL;
-    dri_bo_unreference(render_state->cc.depth_stencil);
+    media_bo_unreference(render_state->cc.depth_stencil);
     render_state->cc.depth_stencil = NULL;
 
     if (render_state->draw_region) {
-        dri_bo_unreference(render_state->draw_region->bo);
+        media_bo_unreference(render_state->draw_region->bo);
         free(render_state->draw_region);
         render_state->draw_region = NULL;
     }
@@ -1480,14 +1486,14 @@ media_drv_gen75_render_init(VADriverContextP ctx)
         if (!kernel->size)
             continue;
 
-        kernel->bo = dri_bo_alloc(drv_ctx->drv_data.bufmgr, kernel->name,
-                                  kernel->size, 0x1000);
+        kernel->bo = media_bo_alloc(drv_ctx->drv_data.bufmgr, kernel->name,
+                                    kernel->size, 0x1000);
         assert(kernel->bo);
-        dri_bo_subdata(kernel->bo, 0, kernel->size, kernel->bin);
+        media_bo_subdata(kernel->bo, 0, kernel->size, kernel->bin);
     }
 
     /* constant buffer */
-    render_state->curbe.bo = dri_bo_alloc(drv_ctx->drv_data.bufmgr,
+    render_state->curbe.bo = media_bo_alloc(drv_ctx->drv_data.bufmgr,
                       "constant buffer",
                       4096, 64);
     assert(render_state->curbe.bo);
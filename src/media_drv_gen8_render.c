@@ -198,7 +198,7 @@ gen8_render_set_surface_state(
     ss->ss0.vertical_alignment = 1;
     ss->ss0.horizontal_alignment = 1;
 
-    dri_bo_get_tiling(bo, &tiling, &swizzle);
+    media_bo_get_tiling(bo, &tiling, &swizzle);
     gen8_render_set_surface_tiling(ss, tiling);
 }
 
@@ -222,7 +222,7 @@ gen8_render_src_surface_state(
 
     assert(index < MAX_RENDER_SURFACES);
 
-    dri_bo_map(ss_bo, 1);
+    media_bo_map(ss_bo, 1);
     assert(ss_bo->virtual);
     ss = (char *)ss_bo->virtual + RENDER_SURFACE_STATE_OFFSET(index);
 
@@ -231,14 +231,14 @@ gen8_render_src_surface_state(
                                   w, h,
                                   pitch, format, flags);
     gen8_render_set_surface_scs(ss);
-    dri_bo_emit_reloc(ss_bo,
-                      I915_GEM_DOMAIN_SAMPLER, 0,
-                      offset,
-                      RENDER_SURFACE_STATE_OFFSET(index) + offsetof(struct gen8_surface_state, ss8),
-                      region);
+    media_bo_emit_reloc(ss_bo,
+                        I915_GEM_DOMAIN_SAMPLER, 0,
+                        offset,
+                        RENDER_SURFACE_STATE_OFFSET(index) + offsetof(struct gen8_surface_state, ss8),
+                        region);
 
     ((unsigned int *)((char *)ss_bo->virtual + RENDER_BINDING_TABLE_OFFSET))[index] = RENDER_SURFACE_STATE_OFFSET(index);
-    dri_bo_unmap(ss_bo);
+    media_bo_unmap(ss_bo);
     render_state->wm.sampler_count++;
 }
 
@@ -327,7 +327,7 @@ gen8_render_dest_surface_state(VADriverContextP ctx, int index)
 	format = I965_SURFACEFORMAT_B8G8R8A8_UNORM;
     }
 
-    dri_bo_map(ss_bo, 1);
+    media_bo_map(ss_bo, 1);
     assert(ss_bo->virtual);
     ss = (char *)ss_bo->virtual + RENDER_SURFACE_STATE_OFFSET(index);
 
@@ -336,14 +336,14 @@ gen8_render_dest_surface_state(VADriverContextP ctx, int index)
                                   dest_region->width, dest_region->height,
                                   dest_region->pitch, format, 0);
     gen8_render_set_surface_scs(ss);
-    dri_bo_emit_reloc(ss_bo,
-                      I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER,
-                      0,
-                      RENDER_SURFACE_STATE_OFFSET(index) + offsetof(struct gen8_surface_state, ss8),
-                      dest_region->bo);
+    media_bo_emit_reloc(ss_bo,
+                        I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER,
+                        0,
+                        RENDER_SURFACE_STATE_OFFSET(index) + offsetof(struct gen8_surface_state, ss8),
+                        dest_region->bo);
 
     ((unsigned int *)((char *)ss_bo->virtual + RENDER_BINDING_TABLE_OFFSET))[index] = RENDER_SURFACE_STATE_OFFSET(index);
-    dri_bo_unmap(ss_bo);
+    media_bo_unmap(ss_bo);
 }
 
 static void
@@ -383,7 +383,7 @@ i965_fill_vertex_buffer(
     vb[10] = vid_coords[X1];
     vb[11] = vid_coords[Y1];
 
-    dri_bo_subdata(drv_ctx->render_state.vb.vertex_buffer, 0, sizeof(vb), vb);
+    media_bo_subdata(drv_ctx->render_state.vb.vertex_buffer, 0, sizeof(vb), vb);
 }
 
 static void
@@ -529,27 +529,31 @@ gen8_render_initialize(VADriverContextP ctx)
     unsigned int end_offset;
 
     /* VERTEX BUFFER */
-    dri_bo_unreference(render_state->vb.vertex_buffer);
-    bo = dri_bo_alloc(drv_ctx->drv_data.bufmgr,
-                      "vertex buffer",
-                      4096,
-                      4096);
+    media_bo_unreference(render_state->vb.vertex_buffer);
+    bo = media_bo_alloc(drv_ctx->drv_data.bufmgr,
+                        "vertex buffer",
+                        4096,
+                        4096);
     assert(bo);
     render_state->vb.vertex_buffer = bo;
 
     /* WM */
-    dri_bo_unreference(render_state->wm.surface_state_binding_table_bo);
-    bo = dri_bo_alloc(drv_ctx->drv_data.bufmgr,
-                      "surface state & binding table",
-                      (SURFACE_STATE_PADDED_SIZE + sizeof(unsigned int)) * MAX_RENDER_SURFACES,
-                      4096);
+    media_bo_unreference(render_state->wm.surface_state_binding_table_bo);
+    bo = media_bo_alloc(drv_ctx->drv_data.bufmgr,
+                        "surface state & binding table",
+                        (SURFACE_STATE_PADDED_SIZE + sizeof(unsigned int)) * MAX_RENDER_SURFACES,
+                        4096);
     assert(bo);
     render_state->wm.surface_state_binding_table_bo = bo;
 
-    render_state->curbe_size = 256;
-
     render_state->wm.sampler_count = 0;
 
+    /* DYNAMIC STATE is kept across calls, see media_render_cache_update() */
+    if (render_state->dynamic_state.bo)
+        return;
+
+    render_state->curbe_size = 256;
+
     render_state->sampler_size = MAX_SAMPLERS * sizeof(struct gen8_sampler_state);
 
     render_state->cc_state_size = sizeof(struct gen6_color_calc_state);
@@ -571,13 +575,13 @@ gen8_render_initialize(VADriverContextP ctx)
         ALIGN(render_state->sf_clip_size, ALIGNMENT) +
         ALIGN(render_state->scissor_size, ALIGNMENT);
 
-    dri_bo_unreference(render_state->dynamic_state.bo);
-    bo = dri_bo_alloc(drv_ctx->drv_data.bufmgr,
-                      "dynamic_state",
-                      size,
-                      4096);
+    bo = media_bo_alloc(drv_ctx->drv_data.bufmgr,
+                        "dynamic_state",
+                        size,
+                        4096);
 
     render_state->dynamic_state.bo = bo;
+    render_state->cache_valid = FALSE;
 
     end_offset = 0;
     render_state->dynamic_state.end_offset = 0;
@@ -627,7 +631,7 @@ gen8_render_sampler(VADriverContextP ctx)
     assert(render_state->wm.sampler_count > 0);
     assert(render_state->wm.sampler_count <= MAX_SAMPLERS);
 
-    dri_bo_map(render_state->dynamic_state.bo, 1);
+    media_bo_map(render_state->dynamic_state.bo, 1);
     assert(render_state->dynamic_state.bo->virtual);
 
     cc_ptr = (unsigned char *) render_state->dynamic_state.bo->virtual +
@@ -645,7 +649,7 @@ gen8_render_sampler(VADriverContextP ctx)
         sampler_state++;
     }
 
-    dri_bo_unmap(render_state->dynamic_state.bo);
+    media_bo_unmap(render_state->dynamic_state.bo);
 }
 
 static void
@@ -657,7 +661,7 @@ gen8_render_blend_state(VADriverContextP ctx)
     struct gen8_blend_state_rt *blend_state;
     unsigned char *cc_ptr;
 
-    dri_bo_map(render_state->dynamic_state.bo, 1);
+    media_bo_map(render_state->dynamic_state.bo, 1);
     assert(render_state->dynamic_state.bo->virtual);
 
     cc_ptr = (unsigned char *) render_state->dynamic_state.bo->virtual +
@@ -672,7 +676,7 @@ gen8_render_blend_state(VADriverContextP ctx)
     blend_state->blend1.logic_op_func = 0xc;
     blend_state->blend1.pre_blend_clamp_enable = 1;
 
-    dri_bo_unmap(render_state->dynamic_state.bo);
+    media_bo_unmap(render_state->dynamic_state.bo);
 }
 
 
@@ -684,7 +688,7 @@ gen8_render_cc_viewport(VADriverContextP ctx)
     struct i965_cc_viewport *cc_viewport;
     unsigned char *cc_ptr;
 
-    dri_bo_map(render_state->dynamic_state.bo, 1);
+    media_bo_map(render_state->dynamic_state.bo, 1);
     assert(render_state->dynamic_state.bo->virtual);
 
     cc_ptr = (unsigned char *) render_state->dynamic_state.bo->virtual +
@@ -697,7 +701,7 @@ gen8_render_cc_viewport(VADriverContextP ctx)
     cc_viewport->min_depth = -1.e35;
     cc_viewport->max_depth = 1.e35;
 
-    dri_bo_unmap(render_state->dynamic_state.bo);
+    media_bo_unmap(render_state->dynamic_state.bo);
 }
 
 static void
@@ -708,7 +712,7 @@ gen8_render_color_calc_state(VADriverContextP ctx)
     struct gen6_color_calc_state *color_calc_state;
     unsigned char *cc_ptr;
 
-    dri_bo_map(render_state->dynamic_state.bo, 1);
+    media_bo_map(render_state->dynamic_state.bo, 1);
     assert(render_state->dynamic_state.bo->virtual);
 
     cc_ptr = (unsigned char *) render_state->dynamic_state.bo->virtual +
@@ -721,7 +725,7 @@ gen8_render_color_calc_state(VADriverContextP ctx)
     color_calc_state->constant_g = 0.0;
     color_calc_state->constant_b = 1.0;
     color_calc_state->constant_a = 1.0;
-    dri_bo_unmap(render_state->dynamic_state.bo);
+    media_bo_unmap(render_state->dynamic_state.bo);
 }
 
 #define PI  3.1415926
@@ -743,7 +747,7 @@ gen8_render_upload_constants(VADriverContextP ctx,
     float *yuv_to_rgb;
     unsigned int color_flag;
 
-    dri_bo_map(render_state->dynamic_state.bo, 1);
+    media_bo_map(render_state->dynamic_state.bo, 1);
     assert(render_state->dynamic_state.bo->virtual);
 
     cc_ptr = (unsigned char *) render_state->dynamic_state.bo->virtual +
@@ -785,7 +789,7 @@ gen8_render_upload_constants(VADriverContextP ctx,
     else
         memcpy(yuv_to_rgb, yuv_to_rgb_bt601, sizeof(yuv_to_rgb_bt601));
 
-    dri_bo_unmap(render_state->dynamic_state.bo);
+    media_bo_unmap(render_state->dynamic_state.bo);
 }
 
 static void
@@ -799,11 +803,15 @@ gen8_render_setup_states(
 {
     gen8_render_dest_surface_state(ctx, 0);
     gen8_render_src_surfaces_state(ctx, obj_surface, flags);
-    gen8_render_sampler(ctx);
-    gen8_render_cc_viewport(ctx);
-    gen8_render_color_calc_state(ctx);
-    gen8_render_blend_state(ctx);
-    gen8_render_upload_constants(ctx, obj_surface, flags);
+
+    if (media_render_cache_update(ctx, obj_surface, flags)) {
+        gen8_render_sampler(ctx);
+        gen8_render_cc_viewport(ctx);
+        gen8_render_color_calc_state(ctx);
+        gen8_render_blend_state(ctx);
+        gen8_render_upload_constants(ctx, obj_surface, flags);
+    }
+
     i965_render_upload_vertex(ctx, obj_surface, src_rect, dst_rect);
 }
 
@@ -1599,7 +1607,7 @@ gen8_subpicture_render_blend_state(VADriverContextP ctx)
     struct gen8_blend_state_rt *blend_state;
     unsigned char *cc_ptr;
 
-    dri_bo_map(render_state->dynamic_state.bo, 1);
+    media_bo_map(render_state->dynamic_state.bo, 1);
     assert(render_state->dynamic_state.bo->virtual);
 
     cc_ptr = (unsigned char *) render_state->dynamic_state.bo->virtual +
@@ -1621,7 +1629,7 @@ gen8_subpicture_render_blend_state(VADriverContextP ctx)
     blend_state->blend1.pre_blend_clamp_enable = 1;
     blend_state->blend1.clamp_range = 0; /* clamp range [0, 1] */
 
-    dri_bo_unmap(render_state->dynamic_state.bo);
+    media_bo_unmap(render_state->dynamic_state.bo);
 }
 
 static void
@@ -1641,7 +1649,7 @@ gen8_subpic_render_upload_constants(VADriverContextP ctx,
     }
 
 
-    dri_bo_map(render_state->dynamic_state.bo, 1);
+    media_bo_map(render_state->dynamic_state.bo, 1);
     assert(render_state->dynamic_state.bo->virtual);
 
     cc_ptr = (unsigned char *) render_state->dynamic_state.bo->virtual +
@@ -1650,7 +1658,7 @@ gen8_subpic_render_upload_constants(VADriverContextP ctx,
     constant_buffer = (float *) cc_ptr;
     *constant_buffer = global_alpha;
 
-    dri_bo_unmap(render_state->dynamic_state.bo);
+    media_bo_unmap(render_state->dynamic_state.bo);
 }
 
 static void
@@ -1661,6 +1669,7 @@ gen8_subpicture_render_setup_states(
     const VARectangle *dst_rect
 )
 {
+    media_render_cache_invalidate(ctx);
     gen8_render_dest_surface_state(ctx, 0);
     gen8_subpic_render_src_surfaces_state(ctx, obj_surface);
     gen8_render_sampler(ctx);
@@ -1697,29 +1706,29 @@ gen8_render_terminate(VADriverContextP ctx)
     MEDIA_DRV_CONTEXT *drv_ctx = (MEDIA_DRV_CONTEXT *) (ctx->pDriverData);
     struct media_render_state *render_state = &drv_ctx->render_state;
 
-    dri_bo_unreference(render_state->vb.vertex_buffer);
+    media_bo_unreference(render_state->vb.vertex_buffer);
     render_state->vb.vertex_buffer = NULL;
 
-    dri_bo_unreference(render_state->wm.surface_state_binding_table_bo);
+    media_bo_unreference(render_state->wm.surface_state_binding_table_bo);
     render_state->wm.surface_state_binding_table_bo = NULL;
 
     if (render_state->instruction_state.bo) {
-        dri_bo_unreference(render_state->instruction_state.bo);
+        media_bo_unreference(render_state->instruction_state.bo);
         render_state->instruction_state.bo = NULL;
     }
 
     if (render_state->dynamic_state.bo) {
-        dri_bo_unreference(render_state->dynamic_state.bo);
+        media_bo_unreference(render_state->dynamic_state.bo);
         render_state->dynamic_state.bo = NULL;
     }
 
     if (render_state->indirect_state.bo) {
-        dri_bo_unreference(render_state->indirect_state.bo);
+        media_bo_unreference(render_state->indirect_state.bo);
         render_state->indirect_state.bo = NULL;
     }
 
     if (render_state->draw_region) {
-        dri_bo_unreference(render_state->draw_region->bo);
+        media_bo_unreference(render_state->draw_region->bo);
         free(render_state->draw_region);
         render_state->draw_region = NULL;
     }
@@ -1754,7 +1763,7 @@ media_drv_gen8_render_init(VADriverContextP ctx)
         kernel_size += ALIGN(kernel->size, 64);
     }
 
-    render_state->instruction_state.bo = dri_bo_alloc(drv_ctx->drv_data.bufmgr,
+    render_state->instruction_state.bo = media_bo_alloc(drv_ctx->drv_data.bufmgr,
                                   "kernel shader",
                                   kernel_size,
                                   0x1000);
@@ -1768,7 +1777,7 @@ media_drv_gen8_render_init(VADriverContextP ctx)
     render_state->instruction_state.end_offset = 0;
     end_offset = 0;
 
-    dri_bo_map(render_state->instruction_state.bo, 1);
+    media_bo_map(render_state->instruction_state.bo, 1);
     kernel_ptr = (unsigned char *)(render_state->instruction_state.bo->virtual);
     for (i = 0; i < sizeof(render_kernels_gen8) / sizeof(struct media_render_kernel); i++) {
         kernel = &render_state->render_kernels[i];
@@ -1785,7 +1794,7 @@ media_drv_gen8_render_init(VADriverContextP ctx)
 
     render_state->instruction_state.end_offset = end_offset;
 
-    dri_bo_unmap(render_state->instruction_state.bo);
+    media_bo_unmap(render_state->instruction_state.bo);
 
     return true;
 }
@@ -30,62 +30,137 @@
 #include "media_drv_util.h"
 #include "media_drv_gpe_utils.h"
 #include "media_drv_batchbuffer.h"
+/*
+ * Kernel binaries never change, so GPE contexts that load the same kernels
+ * on the same bufmgr share one instruction BO. Entries are keyed by the
+ * kernel table slice the caller passes and live while a context uses them.
+ */
+typedef struct _media_kernel_cache_entry
+{
+  struct _media_kernel_cache_entry *next;
+  dri_bufmgr *bufmgr;
+  const MEDIA_KERNEL *kernel_list;
+  UINT num_kernels;
+  dri_bo *bo;
+  UINT bo_size;
+  UINT kernel_offset[MAX_GPE_KERNELS];
+  UINT end_offset;
+  INT refcount;
+} MEDIA_KERNEL_CACHE_ENTRY;
+
+static MEDIA_DRV_MUTEX kernel_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static MEDIA_KERNEL_CACHE_ENTRY *kernel_cache;
+
+static MEDIA_KERNEL_CACHE_ENTRY *
+media_kernel_cache_create (dri_bufmgr * bufmgr,
+			   const MEDIA_KERNEL * kernel_list, UINT num_kernels)
+{
+  MEDIA_KERNEL_CACHE_ENTRY *entry;
+  UINT i, kernel_size = 0, end_offset = 0;
+  BYTE *kernel_ptr;
+
+  for (i = 0; i < num_kernels; i++)
+    kernel_size += ALIGN (kernel_list[i].size, 64);
+
+  entry = media_drv_alloc_memory (sizeof (*entry));
+  if (entry == NULL)
+    return NULL;
+  entry->bo = media_bo_alloc (bufmgr, "kernel shader", kernel_size, 0x4096);
+  if (entry->bo == NULL)
+    {
+      printf ("failure to allocate the buffer space for kernel shader\n");
+      media_drv_free_memory (entry);
+      return NULL;
+    }
+  entry->bufmgr = bufmgr;
+  entry->kernel_list = kernel_list;
+  entry->num_kernels = num_kernels;
+  entry->bo_size = kernel_size;
+
+  media_bo_map (entry->bo, 1);
+  memset (entry->bo->virtual, 0, entry->bo->size);
+  kernel_ptr = (BYTE *) (entry->bo->virtual);
+  for (i = 0; i < num_kernels; i++)
+    {
+      entry->kernel_offset[i] = end_offset;
+      if (kernel_list[i].size)
+	{
+	  media_drv_memcpy ((UINT *) (kernel_ptr + end_offset),
+			    (kernel_size - end_offset), kernel_list[i].bin,
+			    kernel_list[i].size);
+	  end_offset += ALIGN (kernel_list[i].size, 64);
+	}
+    }
+  media_bo_unmap (entry->bo);
+  entry->end_offset = end_offset;
+
+  entry->next = kernel_cache;
+  kernel_cache = entry;
+  return entry;
+}
+
+/* drops the reference a context took in media_gpe_load_kernels */
+static VOID
+media_kernel_cache_release (dri_bo * bo)
+{
+  MEDIA_KERNEL_CACHE_ENTRY **link, *entry;
+
+  media_drv_mutex_lock (&kernel_cache_mutex);
+  for (link = &kernel_cache; (entry = *link) != NULL; link = &entry->next)
+    {
+      if (entry->bo != bo)
+	continue;
+      if (--entry->refcount == 0)
+	{
+	  *link = entry->next;
+	  media_bo_unreference (entry->bo);
+	  media_drv_free_memory (entry);
+	}
+      break;
+    }
+  media_drv_mutex_unlock (&kernel_cache_mutex);
+}
+
 VOID
 media_gpe_load_kernels (VADriverContextP ctx,
 			MEDIA_GPE_CTX * gpe_context,
 			MEDIA_KERNEL * kernel_list, UINT num_kernels)
 {
   MEDIA_DRV_CONTEXT *i965 = (MEDIA_DRV_CONTEXT *) (ctx->pDriverData);
-  INT i;
-  UINT kernel_offset, end_offset, kernel_size = 0;
-  BYTE *kernel_ptr;
-  MEDIA_KERNEL *kernel;
+  MEDIA_KERNEL_CACHE_ENTRY *entry;
   INSTRUCTION_TYPE *instruction_state = &gpe_context->instruction_state;
+  UINT i;
   MEDIA_DRV_ASSERT (num_kernels <= MAX_GPE_KERNELS);
   media_drv_memcpy (gpe_context->kernels,
 		    (MAX_GPE_KERNELS * sizeof (MEDIA_KERNEL)), kernel_list,
 		    (sizeof (MEDIA_KERNEL) * num_kernels));
   gpe_context->num_kernels = num_kernels;
-  for (i = 0; i < num_kernels; i++)
+
+  media_drv_mutex_lock (&kernel_cache_mutex);
+  for (entry = kernel_cache; entry != NULL; entry = entry->next)
     {
-      kernel = &gpe_context->kernels[i];
-      kernel_size += ALIGN(kernel->size, 64);
+      if (entry->bufmgr == i965->drv_data.bufmgr &&
+	  entry->kernel_list == kernel_list &&
+	  entry->num_kernels == num_kernels)
+	break;
     }
-  media_allocate_resource (&instruction_state->buff_obj,
-			   i965->drv_data.bufmgr,
-			   (const BYTE *) "kernel shader", kernel_size,
-			   0x4096);
-  if (instruction_state->buff_obj.bo == NULL)
+  if (entry == NULL)
+    entry = media_kernel_cache_create (i965->drv_data.bufmgr, kernel_list,
+				       num_kernels);
+  if (entry == NULL)
     {
-      printf ("failure to allocate the buffer space for kernel shader\n");
+      media_drv_mutex_unlock (&kernel_cache_mutex);
       return;
     }
+  entry->refcount++;
+  media_bo_reference (entry->bo);
+  media_drv_mutex_unlock (&kernel_cache_mutex);
 
-  MEDIA_DRV_ASSERT (instruction_state->buff_obj.bo);
-
-  instruction_state->buff_obj.bo_size = kernel_size;
-  instruction_state->end_offset = 0;
-  end_offset = 0;
-  dri_bo_map (instruction_state->buff_obj.bo, 1);
-  memset (instruction_state->buff_obj.bo->virtual, 0,
-	  instruction_state->buff_obj.bo->size);
-  kernel_ptr = (BYTE *) (instruction_state->buff_obj.bo->virtual);
+  instruction_state->buff_obj.bo = entry->bo;
+  instruction_state->buff_obj.bo_size = entry->bo_size;
+  instruction_state->end_offset = entry->end_offset;
   for (i = 0; i < num_kernels; i++)
-    {
-      kernel_offset = end_offset;
-      kernel = &gpe_context->kernels[i];
-      kernel->kernel_offset = kernel_offset;	//>0?kernel_offset:1;
-      if (kernel->size)
-	{
-	  media_drv_memcpy ((UINT *) (kernel_ptr + kernel_offset),
-			    (kernel_size - end_offset), kernel->bin,
-			    kernel->size);
-	  end_offset = kernel_offset + ALIGN(kernel->size, 64);
-	}
-    }
-  instruction_state->end_offset = end_offset;
-  dri_bo_unmap (instruction_state->buff_obj.bo);
-  return;
+    gpe_context->kernels[i].kernel_offset = entry->kernel_offset[i];
 }
 
 VOID
@@ -93,12 +168,25 @@ media_gpe_context_dinit (MEDIA_GPE_CTX * gpe_context)
 {
   if (gpe_context->surface_state_binding_table.res.bo != NULL)
     {
-      dri_bo_unreference (gpe_context->surface_state_binding_table.res.bo);
+      media_bo_unreference (gpe_context->surface_state_binding_table.res.bo);
       gpe_context->surface_state_binding_table.res.bo = NULL;
     }
+  if (gpe_context->dynamic_state.ring_size)
+    {
+      UINT i;
+
+      /* res aliases one of the ring entries */
+      for (i = 0; i < gpe_context->dynamic_state.ring_size; i++)
+	{
+	  media_bo_unreference (gpe_context->dynamic_state.ring[i].bo);
+	  gpe_context->dynamic_state.ring[i].bo = NULL;
+	}
+      gpe_context->dynamic_state.ring_size = 0;
+      gpe_context->dynamic_state.res.bo = NULL;
+    }
   if (gpe_context->dynamic_state.res.bo != NULL)
     {
-      dri_bo_unreference (gpe_context->dynamic_state.res.bo);
+      media_bo_unreference (gpe_context->dynamic_state.res.bo);
       gpe_context->dynamic_state.res.bo = NULL;
     }
 
@@ -107,25 +195,36 @@ media_gpe_context_dinit (MEDIA_GPE_CTX * gpe_context)
 VOID
 media_gpe_context_destroy (MEDIA_GPE_CTX * gpe_context)
 {
-  INT i;
+  INT i, j;
 
 
   media_gpe_context_dinit (gpe_context);
 
+  for (i = 0; i < MEDIA_GPE_MAX_FRAMES_IN_FLIGHT; i++)
+    for (j = 0; j < MEDIA_GPE_MAX_CURBE_SLOTS; j++)
+      {
+	media_drv_free_memory (gpe_context->curbe_shadow[i][j]);
+	gpe_context->curbe_shadow[i][j] = NULL;
+	gpe_context->curbe_shadow_valid[i][j] = FALSE;
+      }
+  media_drv_free_memory (gpe_context->curbe_scratch);
+  gpe_context->curbe_scratch = NULL;
+
   if (gpe_context->status_buffer.res.bo != NULL)
     {
-      dri_bo_unreference (gpe_context->status_buffer.res.bo);
+      media_bo_unreference (gpe_context->status_buffer.res.bo);
       gpe_context->status_buffer.res.bo = NULL;
     }
   for (i = 0; i < gpe_context->num_kernels; i++)
     {
       MEDIA_KERNEL *kernel = &gpe_context->kernels[i];
-      dri_bo_unreference (kernel->bo);
+      media_bo_unreference (kernel->bo);
       kernel->bo = NULL;
     }
   if (gpe_context->instruction_state.buff_obj.bo != NULL)
     {
-      dri_bo_unreference (gpe_context->instruction_state.buff_obj.bo);
+      media_kernel_cache_release (gpe_context->instruction_state.buff_obj.bo);
+      media_bo_unreference (gpe_context->instruction_state.buff_obj.bo);
       gpe_context->instruction_state.buff_obj.bo = NULL;
     }
 
@@ -136,13 +235,15 @@ media_gpe_context_init (VADriverContextP ctx, MEDIA_GPE_CTX * gpe_context)
 {
   INT stat_buff_sz = 0;
   UINT start_offset, end_offset, bo_size = 0;
+  UINT i;
   MEDIA_DRV_CONTEXT *i965 = (MEDIA_DRV_CONTEXT *) (ctx->pDriverData);
   DYNAMIC_STATE *dynamic_state = &gpe_context->dynamic_state;
   STATUS_BUFFER *status_buffer = &gpe_context->status_buffer;
   bo_size =
     (gpe_context->idrt_size * MAX_INTERFACE_DESC_GEN6) +
     gpe_context->curbe_size +
-    (gpe_context->sampler_size * MAX_INTERFACE_DESC_GEN6) + 192;
+    (gpe_context->sampler_size * MAX_INTERFACE_DESC_GEN6) + 192 +
+    (MEDIA_GPE_MAX_CURBE_SLOTS - 1) * (gpe_context->curbe_size + 64);
   media_allocate_resource (&dynamic_state->res, i965->drv_data.bufmgr,
 			   (const BYTE *) "dynamic state heap", bo_size,
 			   4096);
@@ -166,8 +267,18 @@ media_gpe_context_init (VADriverContextP ctx, MEDIA_GPE_CTX * gpe_context)
   end_offset =
     start_offset + (gpe_context->sampler_size * MAX_INTERFACE_DESC_GEN6);
 
+  /* Additional constant buffers, slot 0 is the one at curbe_offset */
+  gpe_context->curbe_slot_offset[0] = gpe_context->curbe_offset;
+  for (i = 1; i < MEDIA_GPE_MAX_CURBE_SLOTS; i++)
+    {
+      start_offset = ALIGN (end_offset, 64);
+      gpe_context->curbe_slot_offset[i] = start_offset;
+      end_offset = start_offset + gpe_context->curbe_size;
+    }
+
   /* update the end offset of dynamic_state */
   dynamic_state->end_offset = end_offset;
+  gpe_context->state_cmds.valid = FALSE;
 /*FIXME:Hardcoded the size need to change this*/
   stat_buff_sz = 0x8000;
   media_allocate_resource (&status_buffer->res, i965->drv_data.bufmgr,
@@ -176,3 +287,161 @@ media_gpe_context_init (VADriverContextP ctx, MEDIA_GPE_CTX * gpe_context)
   MEDIA_DRV_ASSERT (status_buffer->res.bo);
 
 }
+
+/*
+ * Gives the context one dynamic state heap per frame in flight. Must be
+ * called after the interface descriptors have been written, they are
+ * copied into every entry since only the CURBE changes per frame.
+ */
+BOOL
+media_gpe_context_alloc_dynamic_ring (VADriverContextP ctx,
+				      MEDIA_GPE_CTX * gpe_context,
+				      UINT frames)
+{
+  MEDIA_DRV_CONTEXT *i965 = (MEDIA_DRV_CONTEXT *) (ctx->pDriverData);
+  DYNAMIC_STATE *dynamic_state = &gpe_context->dynamic_state;
+  MEDIA_RESOURCE *first = &dynamic_state->ring[0];
+  UINT i;
+
+  if (dynamic_state->ring_size || dynamic_state->res.bo == NULL)
+    return FALSE;
+  if (frames > MEDIA_GPE_MAX_FRAMES_IN_FLIGHT)
+    frames = MEDIA_GPE_MAX_FRAMES_IN_FLIGHT;
+  if (frames < 2)
+    return TRUE;
+
+  *first = dynamic_state->res;
+  dynamic_state->ring_size = 1;
+  dynamic_state->ring_index = 0;
+  media_map_buffer_obj (first->bo);
+  for (i = 1; i < frames; i++)
+    {
+      MEDIA_RESOURCE *res = &dynamic_state->ring[i];
+
+      media_allocate_resource (res, i965->drv_data.bufmgr,
+			       (const BYTE *) "dynamic state heap",
+			       first->bo_size, 4096);
+      if (res->bo == NULL)
+	break;
+      media_map_buffer_obj (res->bo);
+      memcpy (res->bo->virtual, first->bo->virtual, first->bo_size);
+      media_unmap_buffer_obj (res->bo);
+      dynamic_state->ring_size++;
+    }
+  media_unmap_buffer_obj (first->bo);
+
+  return dynamic_state->ring_size == frames;
+}
+
+/* Moves the context to the dynamic state heap of the next frame. */
+VOID
+media_gpe_context_next_frame (MEDIA_GPE_CTX * gpe_context)
+{
+  DYNAMIC_STATE *dynamic_state = &gpe_context->dynamic_state;
+
+  if (dynamic_state->ring_size < 2)
+    return;
+  dynamic_state->ring_index =
+    (dynamic_state->ring_index + 1) % dynamic_state->ring_size;
+  dynamic_state->res = dynamic_state->ring[dynamic_state->ring_index];
+}
+
+/*
+ * Points the context at one of its CURBE slots, so phases of one frame
+ * that share the context do not overwrite each other's constants before
+ * the batch holding them has run.
+ */
+VOID
+media_gpe_context_select_curbe (MEDIA_GPE_CTX * gpe_context, UINT slot)
+{
+  MEDIA_DRV_ASSERT (slot < MEDIA_GPE_MAX_CURBE_SLOTS);
+  gpe_context->curbe_offset = gpe_context->curbe_slot_offset[slot];
+  gpe_context->curbe_slot = slot;
+}
+
+/*
+ * Returns a CPU buffer holding the current content of the selected CURBE
+ * of the current dynamic state heap. The caller rebuilds the CURBE in it
+ * and hands it back with media_gpe_context_curbe_end().
+ *
+ * A shadow invalidated by media_gpe_context_curbe_invalidate() is read
+ * back from the heap. Mapping the heap waits for the batch that last used
+ * it, which with a ring of N heaps is the frame recorded N frames ago; the
+ * BRC update of the VP8 encoder hits this once per frame, N frames after
+ * the one that patched the CURBEs. It is the same wait curbe_end pays
+ * whenever a dword changed, and that every CURBE write paid before the
+ * shadows, so it only stalls when the GPU is N frames behind.
+ */
+VOID *
+media_gpe_context_curbe_begin (MEDIA_GPE_CTX * gpe_context)
+{
+  UINT heap = gpe_context->dynamic_state.ring_index;
+  UINT slot = gpe_context->curbe_slot;
+  UINT size = gpe_context->curbe_size;
+  BYTE *shadow;
+
+  if (!gpe_context->curbe_scratch)
+    gpe_context->curbe_scratch = media_drv_alloc_memory (size);
+  if (!gpe_context->curbe_shadow[heap][slot])
+    gpe_context->curbe_shadow[heap][slot] = media_drv_alloc_memory (size);
+  shadow = gpe_context->curbe_shadow[heap][slot];
+  MEDIA_DRV_ASSERT (gpe_context->curbe_scratch && shadow);
+
+  if (!gpe_context->curbe_shadow_valid[heap][slot])
+    {
+      BYTE *heap_ptr =
+	media_map_buffer_obj (gpe_context->dynamic_state.res.bo);
+
+      memcpy (shadow, heap_ptr + gpe_context->curbe_offset, size);
+      media_unmap_buffer_obj (gpe_context->dynamic_state.res.bo);
+      gpe_context->curbe_shadow_valid[heap][slot] = TRUE;
+    }
+  memcpy (gpe_context->curbe_scratch, shadow, size);
+
+  return gpe_context->curbe_scratch;
+}
+
+/* Writes the dwords of the rebuilt CURBE that differ from the heap. */
+VOID
+media_gpe_context_curbe_end (MEDIA_GPE_CTX * gpe_context)
+{
+  UINT heap = gpe_context->dynamic_state.ring_index;
+  UINT slot = gpe_context->curbe_slot;
+  UINT size = gpe_context->curbe_size;
+  UINT *shadow = (UINT *) gpe_context->curbe_shadow[heap][slot];
+  UINT *scratch = (UINT *) gpe_context->curbe_scratch;
+  UINT *dst;
+  UINT i;
+
+  if (!memcmp (shadow, scratch, size))
+    return;
+
+  dst = (UINT *) ((BYTE *)
+		  media_map_buffer_obj (gpe_context->dynamic_state.res.bo) +
+		  gpe_context->curbe_offset);
+  for (i = 0; i < size / 4; i++)
+    {
+      if (shadow[i] != scratch[i])
+	{
+	  dst[i] = scratch[i];
+	  shadow[i] = scratch[i];
+	}
+    }
+  if (size & 3)
+    {
+      memcpy ((BYTE *) dst + (size & ~3), (BYTE *) scratch + (size & ~3),
+	      size & 3);
+      memcpy ((BYTE *) shadow + (size & ~3), (BYTE *) scratch + (size & ~3),
+	      size & 3);
+    }
+  media_unmap_buffer_obj (gpe_context->dynamic_state.res.bo);
+}
+
+/* The GPU is about to modify a CURBE of the current heap. */
+VOID
+media_gpe_context_curbe_invalidate (MEDIA_GPE_CTX * gpe_context, UINT slot)
+{
+  MEDIA_DRV_ASSERT (slot < MEDIA_GPE_MAX_CURBE_SLOTS);
+  gpe_context->curbe_shadow_valid[gpe_context->dynamic_state.ring_index][slot]
+    = FALSE;
+}
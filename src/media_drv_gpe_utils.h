@@ -30,7 +30,7 @@
 #define _MEDIA__DRIVER_UTILS_H
 #include "media_drv_defines.h"
 #include "media_drv_util.h"
-#include <intel_bufmgr.h>
+#include "media_drv_bufmgr.h"
 #include <va/va.h>
 #include <va/va_backend.h>
 #define MAX_GPE_KERNELS    32
@@ -72,10 +72,19 @@ typedef struct _surface_state_binding_table
 } SURFACE_STATE_BINDING_TABLE;
 
 
+#define MEDIA_GPE_MAX_FRAMES_IN_FLIGHT	4
+/* CURBEs of phases sharing a context but recorded into the same batch */
+#define MEDIA_GPE_MAX_CURBE_SLOTS	2
+
 typedef struct _dynamic_state
 {
-  MEDIA_RESOURCE res;
+  MEDIA_RESOURCE res;		/* copy used by the frame being built */
   UINT end_offset;
+  /* per frame copies, so the CPU can write the next frame's CURBE while
+   * the GPU still reads the previous ones; unused when ring_size is 0 */
+  MEDIA_RESOURCE ring[MEDIA_GPE_MAX_FRAMES_IN_FLIGHT];
+  UINT ring_size;
+  UINT ring_index;
 } DYNAMIC_STATE;
 typedef struct _idrt
 {
@@ -151,6 +160,31 @@ typedef struct _status_buffer
   MEDIA_RESOURCE res;
 } STATUS_BUFFER;
 
+/* largest STATE_BASE_ADDRESS + MEDIA_VFE_STATE + CURBE and ID loads */
+#define MEDIA_GPE_STATE_CMDS_DWORDS	40
+
+/*
+ * The state commands of a context, encoded once for the generation in use.
+ * Only the base address relocations and the CURBE and interface descriptor
+ * offsets change between phases, they are patched when the commands are
+ * copied into a batch. Offsets and lengths are in dwords.
+ */
+typedef struct _media_gpe_state_cmds
+{
+  BOOL valid;
+  VFE_STATE vfe_state;		/* what the MEDIA_VFE_STATE was encoded from */
+  UINT dw[MEDIA_GPE_STATE_CMDS_DWORDS];
+  UINT sba;
+  UINT sba_len;
+  UINT sba_surface_state;	/* relocation slots, relative to sba */
+  UINT sba_dynamic_state;
+  UINT sba_instruction;
+  UINT vfe;
+  UINT vfe_len;
+  UINT curbe_load;
+  UINT id_load;
+} MEDIA_GPE_STATE_CMDS;
+
 typedef struct _media_gpe_context
 {
   MEDIA_KERNEL kernels[MAX_GPE_KERNELS];
@@ -168,6 +202,15 @@ typedef struct _media_gpe_context
   INT idrt_size;
   UINT curbe_offset;
   INT curbe_size;
+  UINT curbe_slot_offset[MEDIA_GPE_MAX_CURBE_SLOTS];
+  UINT curbe_slot;
+  /* CPU copies of what each dynamic state heap holds in each CURBE slot,
+   * so only the dwords that changed since the heap was last used are
+   * written */
+  BYTE *curbe_shadow[MEDIA_GPE_MAX_FRAMES_IN_FLIGHT][MEDIA_GPE_MAX_CURBE_SLOTS];
+  BOOL curbe_shadow_valid[MEDIA_GPE_MAX_FRAMES_IN_FLIGHT][MEDIA_GPE_MAX_CURBE_SLOTS];
+  BYTE *curbe_scratch;
+  MEDIA_GPE_STATE_CMDS state_cmds;
 } MEDIA_GPE_CTX;
 VOID
 media_gpe_context_init (VADriverContextP ctx, MEDIA_GPE_CTX * gpe_context);
@@ -176,4 +219,14 @@ media_gpe_load_kernels (VADriverContextP ctx,
 			MEDIA_GPE_CTX * gpe_context,
 			MEDIA_KERNEL * kernel_list, UINT num_kernels);
 VOID media_gpe_context_destroy (MEDIA_GPE_CTX * gpe_context);
+BOOL
+media_gpe_context_alloc_dynamic_ring (VADriverContextP ctx,
+				      MEDIA_GPE_CTX * gpe_context,
+				      UINT frames);
+VOID media_gpe_context_next_frame (MEDIA_GPE_CTX * gpe_context);
+VOID media_gpe_context_select_curbe (MEDIA_GPE_CTX * gpe_context, UINT slot);
+VOID *media_gpe_context_curbe_begin (MEDIA_GPE_CTX * gpe_context);
+VOID media_gpe_context_curbe_end (MEDIA_GPE_CTX * gpe_context);
+VOID media_gpe_context_curbe_invalidate (MEDIA_GPE_CTX * gpe_context,
+					 UINT slot);
 #endif
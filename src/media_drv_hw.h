@@ -50,6 +50,8 @@ extern "C" {
 typedef struct generic_kernel_params
 {
   UINT idrt_kernel_offset;
+  BOOL dependent;		/* reads what the previous phase wrote */
+  const CHAR *phase_name;	/* labels its GPU timestamps */
 }GENERIC_KERNEL_PARAMS;
 
 typedef struct _MEDIA_FRAME_UPDATE
@@ -126,6 +128,9 @@ typedef struct _media_brc_distortion_params_vp8
   DOUBLE brc_init_reset_input_bits_per_frame;
   UINT brc_init_reset_buf_size_in_bits;
   MEDIA_FRAME_UPDATE *frame_update;
+  UINT lookahead_target_bits;	/* 0 when no lookahead runs */
+  BOOL qp_hint_valid;
+  UINT qp_hint;
   VOID *curbe_cmd_buff;
 } MEDIA_BRC_UPDATE_PARAMS_VP8;
 
@@ -302,6 +307,24 @@ typedef struct pipe_control_params
   UINT immediate_data;
 } PIPE_CONTROL_PARAMS;
 
+#define MEDIA_VFE_STATE_MAX_DWORDS	9
+
+/* media pipeline state last programmed in a batch that holds several
+ * kernel phases */
+typedef struct media_batch_state
+{
+  dri_bo *batch_bo;
+  UINT batch_offset;
+  BOOL pipeline_selected;
+  dri_bo *surface_state_bo;
+  dri_bo *dynamic_state_bo;
+  dri_bo *instruction_bo;
+  UINT vfe[MEDIA_VFE_STATE_MAX_DWORDS];
+  UINT vfe_len;			/* 0 until MEDIA_VFE_STATE was emitted */
+  CURBE_LOAD_PARAMS curbe;
+  ID_LOAD_PARAMS idrt;
+} MEDIA_BATCH_STATE;
+
 typedef struct scaling_curbe_params
 {
   UINT input_pic_height;
@@ -509,7 +509,7 @@ media_sampler_setup_mbenc_g7 (MEDIA_ENCODER_CTX * encoder_context)
   BYTE *sampler_ptr, *sampler_start_ptr;
 
   bo = mbenc_ctx->gpe_context.dynamic_state.res.bo;
-  dri_bo_map (bo, 1);
+  media_bo_map (bo, 1);
   MEDIA_DRV_ASSERT (bo->virtual);
   sampler_start_ptr = (BYTE *) bo->virtual + mbenc_gpe_ctx->sampler_offset;
 #if 0
@@ -529,7 +529,7 @@ media_sampler_setup_mbenc_g7 (MEDIA_ENCODER_CTX * encoder_context)
   sampler_ptr = sampler_start_ptr + (sampler_size * MBENC_IFRAME_DIST_OFFSET);
   media_drv_memset(sampler_ptr, sampler_size);
 
-  dri_bo_unmap (bo);
+  media_bo_unmap (bo);
 }
 
 VOID
@@ -2708,6 +2708,14 @@ media_set_curbe_vp8_brc_update_g7(struct encode_state *encode_state,
   cmd->dw2.picture_header_size = 0; // matching kernel value
   cmd->dw5.target_size_flag= 0;
 
+  /* move this frame's share of the budget as planned by the lookahead */
+  if (params->lookahead_target_bits) {
+    *params->brc_init_current_target_buf_full_in_bits +=
+      (DOUBLE)params->lookahead_target_bits - params->brc_init_reset_input_bits_per_frame;
+    if (*params->brc_init_current_target_buf_full_in_bits < 0)
+      *params->brc_init_current_target_buf_full_in_bits = 0;
+  }
+
   if (*params->brc_init_current_target_buf_full_in_bits > (DOUBLE)params->brc_init_reset_buf_size_in_bits) {
     *params->brc_init_current_target_buf_full_in_bits -= (DOUBLE)params->brc_init_reset_buf_size_in_bits;
     cmd->dw5.target_size_flag = 1;
@@ -2780,12 +2788,27 @@ media_set_curbe_vp8_brc_update_g7(struct encode_state *encode_state,
   cmd->dw17.key_frame_qp_seg2 = quant_params->quantization_index[2];
   cmd->dw17.key_frame_qp_seg3 = quant_params->quantization_index[3];
 
+  if (params->qp_hint_valid && params->pic_coding_type == FRAME_TYPE_I) {
+    INT base = quant_params->quantization_index[0];
+    INT hint = params->qp_hint;
+
+    cmd->dw17.key_frame_qp_seg0 = hint;
+    cmd->dw17.key_frame_qp_seg1 =
+      MIN (MAX (hint + quant_params->quantization_index[1] - base, 0), MAX_QP_VP8_G75);
+    cmd->dw17.key_frame_qp_seg2 =
+      MIN (MAX (hint + quant_params->quantization_index[2] - base, 0), MAX_QP_VP8_G75);
+    cmd->dw17.key_frame_qp_seg3 =
+      MIN (MAX (hint + quant_params->quantization_index[3] - base, 0), MAX_QP_VP8_G75);
+  }
+
   cmd->dw18.qp_delta_plane0 = quant_params->quantization_index_delta[0];
   cmd->dw18.qp_delta_plane1 = quant_params->quantization_index_delta[4];
   cmd->dw18.qp_delta_plane2 = quant_params->quantization_index_delta[3];
   cmd->dw18.qp_delta_plane3 = quant_params->quantization_index_delta[2];
 
   cmd->dw19.qp = quant_params->quantization_index[0];
+  if (params->qp_hint_valid)
+    cmd->dw19.qp = params->qp_hint;
   cmd->dw19.qp_delta_plane4 = quant_params->quantization_index_delta[1];
   cmd->dw19.reserved = 9;
 
@@ -3250,7 +3273,7 @@ media_sampler_setup_me_g7 (MEDIA_ENCODER_CTX * encoder_context)
   int i;
 
   bo = me_gpe_ctx->dynamic_state.res.bo;
-  dri_bo_map (bo, 1);
+  media_bo_map (bo, 1);
   MEDIA_DRV_ASSERT (bo->virtual);
   sampler_ptr = (BYTE *) bo->virtual + me_gpe_ctx->sampler_offset;
   MEDIA_DRV_ASSERT (sampler_size == 32 * sizeof(int));
@@ -3262,7 +3285,7 @@ media_sampler_setup_me_g7 (MEDIA_ENCODER_CTX * encoder_context)
     sampler_ptr += sampler_size;
   }
 
-  dri_bo_unmap (bo);
+  media_bo_unmap (bo);
 }
 
 VOID
@@ -1683,7 +1683,7 @@ media_gpe_interface_setup (MEDIA_GPE_CTX *gpe_ctx)
   BYTE *desc_ptr;
 
   bo = gpe_ctx->dynamic_state.res.bo;
-  dri_bo_map (bo, 1);
+  media_bo_map (bo, 1);
   MEDIA_DRV_ASSERT (bo->virtual);
   desc_ptr = (BYTE *) bo->virtual + gpe_ctx->idrt_offset;
 
@@ -1705,7 +1705,7 @@ media_gpe_interface_setup (MEDIA_GPE_CTX *gpe_ctx)
     desc->desc4.constant_urb_entry_read_length = (gpe_ctx->curbe_size + 31) >> 5;
     desc++;
   }
-  dri_bo_unmap (bo);
+  media_bo_unmap (bo);
 }
 
 VOID
@@ -1732,7 +1732,7 @@ media_interface_setup_mbpak (MEDIA_GPE_CTX *mbpak_gpe_ctx)
   dri_bo *bo;
   BYTE *desc_ptr;
   bo = mbpak_gpe_ctx->dynamic_state.res.bo;
-  dri_bo_map (bo, 1);
+  media_bo_map (bo, 1);
   MEDIA_DRV_ASSERT (bo->virtual);
   desc_ptr = (BYTE *) bo->virtual + mbpak_gpe_ctx->idrt_offset;
   desc = (struct gen6_interface_descriptor_data *) desc_ptr;
@@ -1753,7 +1753,7 @@ media_interface_setup_mbpak (MEDIA_GPE_CTX *mbpak_gpe_ctx)
       desc->desc4.constant_urb_entry_read_length = (mbpak_gpe_ctx->curbe_size + 31) >> 5;	//CURBE_URB_ENTRY_LENGTH;
       desc++;
     }
-  dri_bo_unmap (bo);
+  media_bo_unmap (bo);
 }
 
 VOID
@@ -1766,7 +1766,7 @@ media_interface_setup_mbenc (MEDIA_ENCODER_CTX * encoder_context)
   dri_bo *bo;
   BYTE *desc_ptr;
   bo = mbenc_ctx->gpe_context.dynamic_state.res.bo;
-  dri_bo_map (bo, 1);
+  media_bo_map (bo, 1);
   MEDIA_DRV_ASSERT (bo->virtual);
   desc_ptr = (BYTE *) bo->virtual + mbenc_gpe_ctx->idrt_offset;
 
@@ -1789,7 +1789,7 @@ media_interface_setup_mbenc (MEDIA_ENCODER_CTX * encoder_context)
       desc->desc4.constant_urb_entry_read_length = (mbenc_gpe_ctx->curbe_size + 31) >> 5;	//CURBE_URB_ENTRY_LENGTH;
       desc++;
     }
-  dri_bo_unmap (bo);
+  media_bo_unmap (bo);
 }
 
 VOID
@@ -1802,7 +1802,7 @@ media_interface_setup_brc_init_reset (MEDIA_ENCODER_CTX * encoder_context)
   dri_bo *bo;
   BYTE *desc_ptr;
   bo = gpe_ctx->dynamic_state.res.bo;
-  dri_bo_map (bo, 1);
+  media_bo_map (bo, 1);
   MEDIA_DRV_ASSERT (bo->virtual);
   desc_ptr = (BYTE *) bo->virtual + gpe_ctx->idrt_offset;
   desc = (struct gen6_interface_descriptor_data *) desc_ptr;
@@ -1822,7 +1822,7 @@ media_interface_setup_brc_init_reset (MEDIA_ENCODER_CTX * encoder_context)
     desc->desc4.constant_urb_entry_read_length = (gpe_ctx->curbe_size + 31) >> 5;	//CURBE_URB_ENTRY_LENGTH;
     desc++;
   }
-  dri_bo_unmap (bo);
+  media_bo_unmap (bo);
 }
 
 VOID
@@ -1835,7 +1835,7 @@ media_interface_setup_brc_update (MEDIA_ENCODER_CTX * encoder_context)
   dri_bo *bo;
   BYTE *desc_ptr;
   bo = gpe_ctx->dynamic_state.res.bo;
-  dri_bo_map (bo, 1);
+  media_bo_map (bo, 1);
   MEDIA_DRV_ASSERT (bo->virtual);
   desc_ptr = (BYTE *) bo->virtual + gpe_ctx->idrt_offset;
   desc = (struct gen6_interface_descriptor_data *) desc_ptr;
@@ -1856,7 +1856,7 @@ media_interface_setup_brc_update (MEDIA_ENCODER_CTX * encoder_context)
     desc->desc4.constant_urb_entry_read_length = (gpe_ctx->curbe_size + 31) >> 5;	//CURBE_URB_ENTRY_LENGTH;
     desc++;
   }
-  dri_bo_unmap (bo);
+  media_bo_unmap (bo);
 }
 
 VOID
@@ -3520,13 +3520,13 @@ media_add_surface_state (SURFACE_SET_PARAMS * params)
       media_set_surface_state_2d_surface (cmd, params, params->format, width,
 					  height, 0, 0, 0);
 
-      dri_bo_emit_reloc (params->binding_surface_state.bo,
-			 I915_GEM_DOMAIN_RENDER,
-			 write_domain,
-			 0,
-			 params->surface_state_offset +
-			 offsetof (SURFACE_STATE_G7, dw1),
-			 params->surface_2d->bo);
+      media_bo_emit_reloc (params->binding_surface_state.bo,
+			   I915_GEM_DOMAIN_RENDER,
+			   write_domain,
+			   0,
+			   params->surface_state_offset +
+			   offsetof (SURFACE_STATE_G7, dw1),
+			   params->surface_2d->bo);
 
       *((UINT *) ((CHAR *) params->binding_surface_state.buf +
 		  params->binding_table_offset)) =
@@ -3563,13 +3563,13 @@ media_add_surface_state (SURFACE_SET_PARAMS * params)
 					  STATE_SURFACEFORMAT_R16_UINT, width,
 					  height, 0, cbcr_offset, y_offset);
 
-      dri_bo_emit_reloc (params->binding_surface_state.bo,
-			 I915_GEM_DOMAIN_RENDER,
-			 write_domain,
-			 cbcr_offset,
-			 params->surface_state_offset +
-			 offsetof (SURFACE_STATE_G7, dw1),
-			 params->surface_2d->bo);
+      media_bo_emit_reloc (params->binding_surface_state.bo,
+			   I915_GEM_DOMAIN_RENDER,
+			   write_domain,
+			   cbcr_offset,
+			   params->surface_state_offset +
+			   offsetof (SURFACE_STATE_G7, dw1),
+			   params->surface_2d->bo);
 
       *((UINT *) ((CHAR *) params->binding_surface_state.buf +
 		  params->binding_table_offset)) =
@@ -3584,13 +3584,13 @@ media_add_surface_state (SURFACE_SET_PARAMS * params)
       *cmd = SURFACE_STATE_ADV_INIT_G7;
       media_set_surface_state_adv (cmd, params, MFX_SURFACE_PLANAR_420_8);
 
-      dri_bo_emit_reloc (params->binding_surface_state.bo,
-			 I915_GEM_DOMAIN_RENDER,
-			 write_domain,
-			 params->offset,
-			 params->surface_state_offset +
-			 offsetof (SURFACE_STATE_ADV_G7, ss0),
-			 params->surface_2d->bo);
+      media_bo_emit_reloc (params->binding_surface_state.bo,
+			   I915_GEM_DOMAIN_RENDER,
+			   write_domain,
+			   params->offset,
+			   params->surface_state_offset +
+			   offsetof (SURFACE_STATE_ADV_G7, ss0),
+			   params->surface_2d->bo);
       *((UINT *) ((CHAR *) params->binding_surface_state.buf +
 		  params->binding_table_offset)) =
 	params->surface_state_offset /*<< BINDING_TABLE_SURFACE_SHIFT */ ;
@@ -3616,13 +3616,13 @@ media_add_surface_state (SURFACE_SET_PARAMS * params)
 	}
 
       media_set_surface_state_buffer_surface (cmd, params, format, pitch);
-      dri_bo_emit_reloc (params->binding_surface_state.bo,
-			 I915_GEM_DOMAIN_RENDER,
-			 write_domain,
-			 params->offset,
-			 params->surface_state_offset +
-			 offsetof (SURFACE_STATE_G7, dw1),
-			 params->buf_object.bo);
+      media_bo_emit_reloc (params->binding_surface_state.bo,
+			   I915_GEM_DOMAIN_RENDER,
+			   write_domain,
+			   params->offset,
+			   params->surface_state_offset +
+			   offsetof (SURFACE_STATE_G7, dw1),
+			   params->buf_object.bo);
 
       *((UINT *) ((CHAR *) params->binding_surface_state.buf +
 		  params->binding_table_offset)) =
@@ -4892,6 +4892,14 @@ media_set_curbe_vp8_brc_update(struct encode_state *encode_state,
   cmd->dw2.picture_header_size = 0; // matching kernel value
   cmd->dw5.target_size_flag= 0;
 
+  /* move this frame's share of the budget as planned by the lookahead */
+  if (params->lookahead_target_bits) {
+    *params->brc_init_current_target_buf_full_in_bits +=
+      (DOUBLE)params->lookahead_target_bits - params->brc_init_reset_input_bits_per_frame;
+    if (*params->brc_init_current_target_buf_full_in_bits < 0)
+      *params->brc_init_current_target_buf_full_in_bits = 0;
+  }
+
   if (*params->brc_init_current_target_buf_full_in_bits > (DOUBLE)params->brc_init_reset_buf_size_in_bits) {
     *params->brc_init_current_target_buf_full_in_bits -= (DOUBLE)params->brc_init_reset_buf_size_in_bits;
     cmd->dw5.target_size_flag = 1;
@@ -4964,12 +4972,27 @@ media_set_curbe_vp8_brc_update(struct encode_state *encode_state,
   cmd->dw17.key_frame_qp_seg2 = quant_params->quantization_index[2];
   cmd->dw17.key_frame_qp_seg3 = quant_params->quantization_index[3];
 
+  if (params->qp_hint_valid && params->pic_coding_type == FRAME_TYPE_I) {
+    INT base = quant_params->quantization_index[0];
+    INT hint = params->qp_hint;
+
+    cmd->dw17.key_frame_qp_seg0 = hint;
+    cmd->dw17.key_frame_qp_seg1 =
+      MIN (MAX (hint + quant_params->quantization_index[1] - base, 0), MAX_QP_VP8_G75);
+    cmd->dw17.key_frame_qp_seg2 =
+      MIN (MAX (hint + quant_params->quantization_index[2] - base, 0), MAX_QP_VP8_G75);
+    cmd->dw17.key_frame_qp_seg3 =
+      MIN (MAX (hint + quant_params->quantization_index[3] - base, 0), MAX_QP_VP8_G75);
+  }
+
   cmd->dw18.qp_delta_plane0 = quant_params->quantization_index_delta[0];
   cmd->dw18.qp_delta_plane1 = quant_params->quantization_index_delta[4];
   cmd->dw18.qp_delta_plane2 = quant_params->quantization_index_delta[3];
   cmd->dw18.qp_delta_plane3 = quant_params->quantization_index_delta[2];
 
   cmd->dw19.qp = 0;
+  if (params->qp_hint_valid)
+    cmd->dw19.qp = params->qp_hint;
   cmd->dw19.qp_delta_plane4 = quant_params->quantization_index_delta[1];
   cmd->dw19.reserved = 9;
 
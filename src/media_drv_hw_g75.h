@@ -89,7 +89,7 @@ extern const UINT16 brc_skip_mv_threshold_table_vp8_g75 [128];
      surface_2d.bo=obj_surface->bo;                                            \
      surface_2d.bo_size=0;     \
      surface_2d.pitch=obj_surface->width;    \
-     dri_bo_get_tiling(obj_surface->bo, &surface_2d.tiling, &surface_2d.swizzle);    \
+     media_bo_get_tiling(obj_surface->bo, &surface_2d.tiling, &surface_2d.swizzle);    \
      surface_2d.buf=NULL;     \
      surface_2d.surface_array_spacing=0;   \
      surface_2d.cb_cr_pitch=obj_surface->cb_cr_pitch; \
@@ -98,78 +98,91 @@ mediadrv_gen_pipeline_select_cmd (MEDIA_BATCH_BUFFER * batch)
   return status;
 }
 
+/* STATE_BASE_ADDRESS with every base left unset */
+static const UINT state_base_address_template[CMD_STATE_BASE_ADDRESS_LEN] = {
+  CMD_STATE_BASE_ADDRESS | (CMD_STATE_BASE_ADDRESS_LEN - 2),
+  0,				/* General State Base Address */
+  0,				/* Surface State Base Address */
+  0,				/* Dynamic State Base Address */
+  0,				/* Indirect Object Base Address */
+  BASE_ADDRESS_MODIFY,		/* Instruction Base Address */
+  0,				/* General State Access Upper Bound */
+  0xFFFFF000 | BASE_ADDRESS_MODIFY,	/* Dynamic State Access Upper Bound */
+  0,				/* Indirect Object Access Upper Bound */
+  0xFFFFF000 | BASE_ADDRESS_MODIFY,	/* Instruction Access Upper Bound */
+  0,
+  0,
+};
+
 STATUS
 mediadrv_gen_state_base_address_cmd (MEDIA_BATCH_BUFFER * batch,
 				     STATE_BASE_ADDR_PARAMS * params)
 {
   STATUS status = SUCCESS;
-  BEGIN_BATCH (batch, CMD_STATE_BASE_ADDRESS_LEN);
-  OUT_BATCH (batch, (CMD_STATE_BASE_ADDRESS | (CMD_STATE_BASE_ADDRESS_LEN-2)));
-  OUT_BATCH (batch, 0 /*| BASE_ADDRESS_MODIFY*/);	//General State Base Address
-  /*DW4 Surface state base address */
-  if (params->surface_state.bo) {
-   OUT_RELOC (batch, params->surface_state.bo, I915_GEM_DOMAIN_INSTRUCTION, 0, BASE_ADDRESS_MODIFY);	/* Surface state base address */
-  }
-  else
-    OUT_BATCH (batch, 0 /*| BASE_ADDRESS_MODIFY */ );
-  /*DW6. Dynamic state base address */
+  UINT *cmd;
+
+  cmd = media_batchbuffer_reserve (batch, CMD_STATE_BASE_ADDRESS_LEN,
+				   I915_EXEC_RENDER);
+  memcpy (cmd, state_base_address_template,
+	  sizeof (state_base_address_template));
+  if (params->surface_state.bo)
+    media_batchbuffer_reloc (batch, &cmd[2], params->surface_state.bo,
+			     I915_GEM_DOMAIN_INSTRUCTION, 0,
+			     BASE_ADDRESS_MODIFY);
   if (params->dynamic_state.bo)
-    OUT_RELOC (batch, params->dynamic_state.bo,
-	       I915_GEM_DOMAIN_RENDER | I915_GEM_DOMAIN_SAMPLER,
-	       0, BASE_ADDRESS_MODIFY);
-  else
-    OUT_BATCH (batch, 0 /*| BASE_ADDRESS_MODIFY*/);
-  /*DW8. Indirect Object base address */
+    media_batchbuffer_reloc (batch, &cmd[3], params->dynamic_state.bo,
+			     I915_GEM_DOMAIN_RENDER | I915_GEM_DOMAIN_SAMPLER,
+			     0, BASE_ADDRESS_MODIFY);
   if (params->indirect_object.bo)
-    OUT_RELOC (batch, params->indirect_object.bo,
-	       I915_GEM_DOMAIN_SAMPLER, 0, BASE_ADDRESS_MODIFY);
-  else
-    OUT_BATCH (batch, 0 /*| BASE_ADDRESS_MODIFY*/);
-  /*DW10. Instruct base address */
+    media_batchbuffer_reloc (batch, &cmd[4], params->indirect_object.bo,
+			     I915_GEM_DOMAIN_SAMPLER, 0, BASE_ADDRESS_MODIFY);
   if (params->instruction_buffer.bo)
-    OUT_RELOC (batch, params->instruction_buffer.bo,
-	       I915_GEM_DOMAIN_INSTRUCTION, 0, BASE_ADDRESS_MODIFY);
-  else
-    OUT_BATCH (batch, 0 | BASE_ADDRESS_MODIFY);
-  /* DW12. Size limitation */
-  OUT_BATCH (batch, 0 /*| BASE_ADDRESS_MODIFY */ );	//General State Access Upper Bound      
-  OUT_BATCH (batch,0xFFFFF000 | BASE_ADDRESS_MODIFY);	//Dynamic State Access Upper Bound
-  OUT_BATCH (batch, 0 /*| BASE_ADDRESS_MODIFY */ );	//Indirect Object Access Upper Bound
-  OUT_BATCH (batch,0xFFFFF000 | BASE_ADDRESS_MODIFY);	//Instruction Access Upper Bound
-  OUT_BATCH (batch, 0 /*| BASE_ADDRESS_MODIFY*/);
-  OUT_BATCH (batch, 0 /*| BASE_ADDRESS_MODIFY*/);
-  ADVANCE_BATCH (batch);
+    media_batchbuffer_reloc (batch, &cmd[5], params->instruction_buffer.bo,
+			     I915_GEM_DOMAIN_INSTRUCTION, 0,
+			     BASE_ADDRESS_MODIFY);
+  media_batchbuffer_commit (batch, cmd + CMD_STATE_BASE_ADDRESS_LEN);
   return status;
 }
 
-STATUS
-mediadrv_gen_media_vfe_state_cmd (MEDIA_BATCH_BUFFER * batch,
-				  VFE_STATE_PARAMS * params)
+/* writes MEDIA_VFE_STATE to cmd, returns its length in dwords */
+static UINT
+mediadrv_gen_media_vfe_state_fill (UINT * cmd, VFE_STATE_PARAMS * params)
 {
-  STATUS status = SUCCESS;
-  BEGIN_BATCH (batch, CMD_MEDIA_VFE_STATE_LEN);
-  OUT_BATCH (batch, CMD_MEDIA_VFE_STATE | (CMD_MEDIA_VFE_STATE_LEN - 2));
-  OUT_BATCH (batch, 0);		/* Scratch Space Base Pointer and Space */
-  OUT_BATCH (batch, params->max_num_threads << 16 |	/* Maximum Number of Threads */
-	     params->num_urb_entries << 8 |	/* Number of URB Entries */
-	     params->gpgpu_mode << 2);	/* MEDIA Mode */
-  OUT_BATCH (batch, 0);		/* Debug: Object ID */
-  OUT_BATCH (batch, params->urb_entry_size << 16 |	/* URB Entry Allocation Size */
-	     params->curbe_allocation_size);	/* CURBE Allocation Size */
+  cmd[0] = CMD_MEDIA_VFE_STATE | (CMD_MEDIA_VFE_STATE_LEN - 2);
+  cmd[1] = 0;			/* Scratch Space Base Pointer and Space */
+  cmd[2] = params->max_num_threads << 16 |	/* Maximum Number of Threads */
+    params->num_urb_entries << 8 |	/* Number of URB Entries */
+    params->gpgpu_mode << 2;	/* MEDIA Mode */
+  cmd[3] = 0;			/* Debug: Object ID */
+  cmd[4] = params->urb_entry_size << 16 |	/* URB Entry Allocation Size */
+    params->curbe_allocation_size;	/* CURBE Allocation Size */
   /* the vfe_desc5/6/7 will decide whether the scoreboard is used. */
   if (params->scoreboard_enable)
     {
-      OUT_BATCH (batch, params->scoreboardDW5);
-      OUT_BATCH (batch, params->scoreboardDW6);
-      OUT_BATCH (batch, params->scoreboardDW7);
+      cmd[5] = params->scoreboardDW5;
+      cmd[6] = params->scoreboardDW6;
+      cmd[7] = params->scoreboardDW7;
     }
   else
     {
-      OUT_BATCH (batch, 0);
-      OUT_BATCH (batch, 0);
-      OUT_BATCH (batch, 0);
+      cmd[5] = 0;
+      cmd[6] = 0;
+      cmd[7] = 0;
     }
-  ADVANCE_BATCH (batch);
+  return CMD_MEDIA_VFE_STATE_LEN;
+}
+
+STATUS
+mediadrv_gen_media_vfe_state_cmd (MEDIA_BATCH_BUFFER * batch,
+				  VFE_STATE_PARAMS * params)
+{
+  STATUS status = SUCCESS;
+  UINT *cmd;
+
+  cmd = media_batchbuffer_reserve (batch, CMD_MEDIA_VFE_STATE_LEN,
+				   I915_EXEC_RENDER);
+  cmd += mediadrv_gen_media_vfe_state_fill (cmd, params);
+  media_batchbuffer_commit (batch, cmd);
   return status;
 
 }
@@ -179,12 +192,14 @@ mediadrv_gen_media_curbe_load_cmd (MEDIA_BATCH_BUFFER * batch,
 				   CURBE_LOAD_PARAMS * params)
 {
   STATUS status = SUCCESS;
-  BEGIN_BATCH (batch, 4);
-  OUT_BATCH (batch, CMD_MEDIA_CURBE_LOAD | (4 - 2));
-  OUT_BATCH (batch, 0);
-  OUT_BATCH (batch, params->curbe_size);
-  OUT_BATCH (batch, params->curbe_offset);
-  ADVANCE_BATCH (batch);
+  UINT *cmd;
+
+  cmd = media_batchbuffer_reserve (batch, 4, I915_EXEC_RENDER);
+  cmd[0] = CMD_MEDIA_CURBE_LOAD | (4 - 2);
+  cmd[1] = 0;
+  cmd[2] = params->curbe_size;
+  cmd[3] = params->curbe_offset;
+  media_batchbuffer_commit (batch, cmd + 4);
   return status;
 }
 
@@ -193,11 +208,166 @@ mediadrv_gen_media_id_load_cmd (MEDIA_BATCH_BUFFER * batch,
 				ID_LOAD_PARAMS * params)
 {
   STATUS status = SUCCESS;
-  BEGIN_BATCH (batch, 4);
-  OUT_BATCH (batch, CMD_MEDIA_INTERFACE_LOAD | (4 - 2));
+  UINT *cmd;
+
+  cmd = media_batchbuffer_reserve (batch, 4, I915_EXEC_RENDER);
+  cmd[0] = CMD_MEDIA_INTERFACE_LOAD | (4 - 2);
+  cmd[1] = 0;
+  cmd[2] = params->idrt_size;
+  cmd[3] = params->idrt_offset;
+  media_batchbuffer_commit (batch, cmd + 4);
+  return status;
+}
+
+/* encodes the state commands of gpe_context for gen7 and gen7.5 */
+VOID
+mediadrv_gen_state_cmds_build (MEDIA_GPE_CTX * gpe_context)
+{
+  MEDIA_GPE_STATE_CMDS *cmds = &gpe_context->state_cmds;
+  VFE_STATE_PARAMS vfe_state_params;
+  UINT *cmd = cmds->dw;
+
+  cmds->sba = 0;
+  cmds->sba_len = CMD_STATE_BASE_ADDRESS_LEN;
+  cmds->sba_surface_state = 2;
+  cmds->sba_dynamic_state = 3;
+  cmds->sba_instruction = 5;
+  memcpy (cmd, state_base_address_template,
+	  sizeof (state_base_address_template));
+  cmd += cmds->sba_len;
+
+  media_drv_memset (&vfe_state_params, sizeof (vfe_state_params));
+  vfe_state_params.gpgpu_mode = gpe_context->vfe_state.gpgpu_mode;
+  vfe_state_params.max_num_threads = gpe_context->vfe_state.max_num_threads;
+  vfe_state_params.num_urb_entries = gpe_context->vfe_state.num_urb_entries;
+  vfe_state_params.urb_entry_size = gpe_context->vfe_state.urb_entry_size;
+  vfe_state_params.curbe_allocation_size =
+    gpe_context->vfe_state.curbe_allocation_size;
+  vfe_state_params.scoreboard_enable = 1;
+  vfe_state_params.scoreboard_type = 0;
+  vfe_state_params.scoreboard_mask = 0;
+  vfe_state_params.scoreboardDW5 = gpe_context->vfe_state.vfe_desc5.dword;
+  vfe_state_params.scoreboardDW6 = gpe_context->vfe_state.vfe_desc6.dword;
+  vfe_state_params.scoreboardDW7 = gpe_context->vfe_state.vfe_desc7.dword;
+  cmds->vfe = cmd - cmds->dw;
+  cmds->vfe_len = mediadrv_gen_media_vfe_state_fill (cmd, &vfe_state_params);
+  cmd += cmds->vfe_len;
+
+  cmds->curbe_load = cmd - cmds->dw;
+  cmd[0] = CMD_MEDIA_CURBE_LOAD | (4 - 2);
+  cmd[1] = 0;
+  cmd[2] = gpe_context->curbe_size;
+  cmd[3] = 0;			/* patched with the selected CURBE slot */
+  cmd += 4;
+
+  cmds->id_load = cmd - cmds->dw;
+  cmd[0] = CMD_MEDIA_INTERFACE_LOAD | (4 - 2);
+  cmd[1] = 0;
+  cmd[2] = gpe_context->idrt_size;
+  cmd[3] = 0;			/* patched with the kernel's descriptor */
+  cmd += 4;
+
+  MEDIA_DRV_ASSERT (cmd - cmds->dw <= MEDIA_GPE_STATE_CMDS_DWORDS);
+  cmds->vfe_state = gpe_context->vfe_state;
+  cmds->valid = TRUE;
+}
+
+/*
+ * Copies the selected state commands of gpe_context into the batch under
+ * a single space check, then patches the relocations and load offsets.
+ * The caller has reserved the space of the whole kernel phase, so the
+ * mask it computed for this batch still holds: a flush here would leave
+ * the new batch without the state that was left out.
+ */
+VOID
+mediadrv_gen_state_cmds_emit (MEDIA_BATCH_BUFFER * batch,
+			      MEDIA_GPE_CTX * gpe_context, UINT mask,
+			      UINT curbe_offset, UINT idrt_offset)
+{
+  MEDIA_GPE_STATE_CMDS *cmds = &gpe_context->state_cmds;
+  dri_bo *batch_bo = batch->buffer;
+  UINT len = 0;
+  UINT *cmd;
+
+  MEDIA_DRV_ASSERT (cmds->valid);
+  if (mask & MEDIA_STATE_CMDS_SBA)
+    len += cmds->sba_len;
+  if (mask & MEDIA_STATE_CMDS_VFE)
+    len += cmds->vfe_len;
+  if (mask & MEDIA_STATE_CMDS_CURBE_LOAD)
+    len += 4;
+  if (mask & MEDIA_STATE_CMDS_ID_LOAD)
+    len += 4;
+  if (len == 0)
+    return;
+
+  cmd = media_batchbuffer_reserve (batch, len, I915_EXEC_RENDER);
+  MEDIA_DRV_ASSERT (batch->buffer == batch_bo);
+  if (mask & MEDIA_STATE_CMDS_SBA)
+    {
+      memcpy (cmd, cmds->dw + cmds->sba, cmds->sba_len * sizeof (UINT));
+      if (gpe_context->surface_state_binding_table.res.bo)
+	media_batchbuffer_reloc (batch, &cmd[cmds->sba_surface_state],
+				 gpe_context->surface_state_binding_table.res.bo,
+				 I915_GEM_DOMAIN_INSTRUCTION, 0,
+				 BASE_ADDRESS_MODIFY);
+      if (gpe_context->dynamic_state.res.bo)
+	media_batchbuffer_reloc (batch, &cmd[cmds->sba_dynamic_state],
+				 gpe_context->dynamic_state.res.bo,
+				 I915_GEM_DOMAIN_RENDER |
+				 I915_GEM_DOMAIN_SAMPLER, 0,
+				 BASE_ADDRESS_MODIFY);
+      if (gpe_context->instruction_state.buff_obj.bo)
+	media_batchbuffer_reloc (batch, &cmd[cmds->sba_instruction],
+				 gpe_context->instruction_state.buff_obj.bo,
+				 I915_GEM_DOMAIN_INSTRUCTION, 0,
+				 BASE_ADDRESS_MODIFY);
+      cmd += cmds->sba_len;
+    }
+  if (mask & MEDIA_STATE_CMDS_VFE)
+    {
+      memcpy (cmd, cmds->dw + cmds->vfe, cmds->vfe_len * sizeof (UINT));
+      cmd += cmds->vfe_len;
+    }
+  if (mask & MEDIA_STATE_CMDS_CURBE_LOAD)
+    {
+      memcpy (cmd, cmds->dw + cmds->curbe_load, 4 * sizeof (UINT));
+      cmd[3] = curbe_offset;
+      cmd += 4;
+    }
+  if (mask & MEDIA_STATE_CMDS_ID_LOAD)
+    {
+      memcpy (cmd, cmds->dw + cmds->id_load, 4 * sizeof (UINT));
+      cmd[3] = idrt_offset;
+      cmd += 4;
+    }
+  media_batchbuffer_commit (batch, cmd);
+}
+
+STATUS
+mediadrv_gen_media_state_flush_cmd (MEDIA_BATCH_BUFFER * batch)
+{
+  STATUS status = SUCCESS;
+  BEGIN_BATCH (batch, 2);
+  OUT_BATCH (batch, CMD_MEDIA_STATE_FLUSH | (2 - 2));
   OUT_BATCH (batch, 0);
-  OUT_BATCH (batch, params->idrt_size);
-  OUT_BATCH (batch, params->idrt_offset);
+  ADVANCE_BATCH (batch);
+  return status;
+}
+
+/* Stores the register to bo + offset when the command streamer gets
+ * there, without waiting for the work in front of it. */
+STATUS
+mediadrv_gen_mi_store_register_mem_cmd (MEDIA_BATCH_BUFFER * batch, UINT reg,
+					dri_bo * bo, UINT offset)
+{
+  STATUS status = SUCCESS;
+  BEGIN_BATCH (batch, CMD_MI_STORE_REGISTER_MEM_LEN);
+  OUT_BATCH (batch,
+	     CMD_MI_STORE_REGISTER_MEM | (CMD_MI_STORE_REGISTER_MEM_LEN - 2));
+  OUT_BATCH (batch, reg);
+  OUT_RELOC (batch, bo, I915_GEM_DOMAIN_INSTRUCTION,
+	     I915_GEM_DOMAIN_INSTRUCTION, offset);
   ADVANCE_BATCH (batch);
   return status;
 }
@@ -213,6 +383,36 @@ mediadrv_media_mi_set_predicate_cmd (MEDIA_BATCH_BUFFER * batch,
   return status;
 }
 
+/* MEDIA_OBJECT_WALKER, the dwords every walker shares */
+static const UINT media_object_walker_template[CMD_MEDIA_OBJECT_WALKER_LEN] = {
+  CMD_MEDIA_OBJECT_WALKER | (CMD_MEDIA_OBJECT_WALKER_LEN - 2),
+  0, 0, 0, 0, 0, 0,
+  (0x3FF << 16) | 0x3FF,	/* Local Loop Exec Count */
+  0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+/* shared by the gen7 and gen8 walkers, which only differ in dw5/10-12 */
+VOID
+media_object_walker_fill (UINT * cmd, UINT use_scoreboard, UINT dw5_cmd,
+			  UINT dw6_cmd, UINT dw10_cmd, UINT dw11_cmd,
+			  UINT dw12_cmd, MEDIA_OBJ_WALKER_PARAMS * params)
+{
+  UINT size = (params->frmfield_h_in_mb << 16) | params->frm_w_in_mb;
+
+  memcpy (cmd, media_object_walker_template,
+	  sizeof (media_object_walker_template));
+  cmd[2] = use_scoreboard << 21;
+  cmd[5] = dw5_cmd;
+  cmd[6] = dw6_cmd;
+  cmd[8] = size;		/* Global Loop Exec Count */
+  cmd[10] = dw10_cmd;
+  cmd[11] = dw11_cmd;
+  cmd[12] = dw12_cmd;
+  cmd[13] = size;		/* Global Resolution */
+  cmd[15] = params->frm_w_in_mb;
+  cmd[16] = params->frmfield_h_in_mb << 16;
+}
+
 STATUS
 media_object_walker_cmd (MEDIA_BATCH_BUFFER * batch,
 			 MEDIA_OBJ_WALKER_PARAMS * params)
@@ -223,7 +423,9 @@ media_object_walker_cmd (MEDIA_BATCH_BUFFER * batch,
   UINT repel = (mode == SINGLE_MODE) ? 1 : 0;
   UINT dual_mode = (mode == DUAL_MODE) ? 1 : 0;
   UINT quad_mode = (mode == QUAD_MODE) ? 1 : 0;
-  BEGIN_BATCH (batch, CMD_MEDIA_OBJECT_WALKER_LEN /*17 */ );
+  UINT *cmd;
+  cmd = media_batchbuffer_reserve (batch, CMD_MEDIA_OBJECT_WALKER_LEN,
+				   I915_EXEC_RENDER);
   if (params->mb_enc_iframe_dist_en || params->me_in_use)
     {
       use_scoreboard=0;
@@ -262,24 +464,10 @@ media_object_walker_cmd (MEDIA_BATCH_BUFFER * batch,
 	}
 
     }
-  OUT_BATCH (batch,CMD_MEDIA_OBJECT_WALKER | (CMD_MEDIA_OBJECT_WALKER_LEN - 2));
-  OUT_BATCH (batch, 0);
-  OUT_BATCH (batch,use_scoreboard << 21);
-  OUT_BATCH (batch, 0);
-  OUT_BATCH (batch, 0);
-  OUT_BATCH (batch, dw5_cmd);
-  OUT_BATCH (batch, ((dual_mode << 31) | (repel << 30) | (quad_mode << 29)));
-  OUT_BATCH (batch, ((0x3FF << 16) | 0x3FF));
-  OUT_BATCH (batch, ((params->frmfield_h_in_mb << 16) | params->frm_w_in_mb));
-  OUT_BATCH (batch, 0);
-  OUT_BATCH (batch, dw10_cmd);
-  OUT_BATCH (batch, dw11_cmd);
-  OUT_BATCH (batch, dw12_cmd);
-  OUT_BATCH (batch, ((params->frmfield_h_in_mb << 16) | params->frm_w_in_mb));
-  OUT_BATCH (batch, 0);
-  OUT_BATCH (batch, (0 | params->frm_w_in_mb));
-  OUT_BATCH (batch, (0 | (params->frmfield_h_in_mb << 16)));
-  ADVANCE_BATCH (batch);
+  media_object_walker_fill (cmd, use_scoreboard, dw5_cmd,
+			    (dual_mode << 31) | (repel << 30) | (quad_mode << 29),
+			    dw10_cmd, dw11_cmd, dw12_cmd, params);
+  media_batchbuffer_commit (batch, cmd + CMD_MEDIA_OBJECT_WALKER_LEN);
   return status;
 }
 
@@ -323,16 +511,12 @@ mediadrv_set_curbe_scaling (MEDIA_GPE_CTX * gpe_context,
 {
   STATUS status = SUCCESS;
   CURBE_SCALING_DATA *cmd;
-  dri_bo_map (gpe_context->dynamic_state.res.bo, 1);
-  MEDIA_DRV_ASSERT (gpe_context->dynamic_state.res.bo->virtual);
-  cmd = (CURBE_SCALING_DATA *) gpe_context->dynamic_state.res.bo->virtual +
-    gpe_context->curbe_offset;
+  cmd = (CURBE_SCALING_DATA *) media_gpe_context_curbe_begin (gpe_context);
   cmd->input_pic_height = params->input_pic_height;
   cmd->input_pic_width = params->input_pic_width;
   cmd->src_planar_y = SCALE_SRC_Y;
   cmd->dest_planar_y = SCALE_DST_Y;
-
-  dri_bo_unmap (gpe_context->dynamic_state.res.bo);
+  media_gpe_context_curbe_end (gpe_context);
 
   return status;
 }
@@ -84,6 +84,9 @@
 //ID LOAD
 #define CMD_MEDIA_INTERFACE_LOAD                CMD(2, 0, 2)
 
+//MEDIA STATE FLUSH
+#define CMD_MEDIA_STATE_FLUSH                   CMD(2, 0, 4)
+
 //MI PREDICATE
 #define CMD_MI_SET_PREDICATE    (CMD_MI | (1<<23))
 
@@ -98,6 +101,13 @@
 //MI STORE DATA IMM
 #define CMD_MI_STORE_DATA_IMM   (CMD_MI | (1<<28))
 
+//MI STORE REGISTER MEM
+#define CMD_MI_STORE_REGISTER_MEM_LEN	3
+#define CMD_MI_STORE_REGISTER_MEM	(CMD_MI | (0x24 << 23))
+
+/* render engine TIMESTAMP register, low dword */
+#define MEDIA_RCS_TIMESTAMP_REG		0x2358
+
 #define FLUSH_NONE      0x00
 #define FLUSH_WRITE_CACHE  0x01
 #define FLUSH_READ_CACHE   0x02
@@ -128,6 +138,9 @@ STATUS mediadrv_mi_store_data_imm_cmd (MEDIA_BATCH_BUFFER * batch,
 				       MI_STORE_DATA_IMM_PARAMS * params);
 STATUS media_object_walker_cmd (MEDIA_BATCH_BUFFER * batch,
 				MEDIA_OBJ_WALKER_PARAMS * params);
+VOID media_object_walker_fill (UINT * cmd, UINT use_scoreboard, UINT dw5_cmd,
+			       UINT dw6_cmd, UINT dw10_cmd, UINT dw11_cmd,
+			       UINT dw12_cmd, MEDIA_OBJ_WALKER_PARAMS * params);
 STATUS mediadrv_media_mi_set_predicate_cmd (MEDIA_BATCH_BUFFER * batch,
 					    MI_SET_PREDICATE_PARAMS * params);
 STATUS mediadrv_gen_media_curbe_load_cmd (MEDIA_BATCH_BUFFER * batch,
@@ -138,9 +151,23 @@ STATUS mediadrv_gen_media_vfe_state_cmd (MEDIA_BATCH_BUFFER * batch,
 					 VFE_STATE_PARAMS * params);
 STATUS mediadrv_gen_state_base_address_cmd (MEDIA_BATCH_BUFFER * batch,
 					    STATE_BASE_ADDR_PARAMS * params);
+
+/* which of the prebuilt state commands of a context to emit */
+#define MEDIA_STATE_CMDS_SBA		(1 << 0)
+#define MEDIA_STATE_CMDS_VFE		(1 << 1)
+#define MEDIA_STATE_CMDS_CURBE_LOAD	(1 << 2)
+#define MEDIA_STATE_CMDS_ID_LOAD	(1 << 3)
+VOID mediadrv_gen_state_cmds_build (MEDIA_GPE_CTX * gpe_context);
+VOID mediadrv_gen_state_cmds_emit (MEDIA_BATCH_BUFFER * batch,
+				   MEDIA_GPE_CTX * gpe_context, UINT mask,
+				   UINT curbe_offset, UINT idrt_offset);
 STATUS mediadrv_gen_pipeline_select_cmd (MEDIA_BATCH_BUFFER * batch);
+STATUS mediadrv_gen_media_state_flush_cmd (MEDIA_BATCH_BUFFER * batch);
 STATUS mediadrv_gen_pipe_ctrl_cmd (MEDIA_BATCH_BUFFER * batch,
 				   PIPE_CONTROL_PARAMS * params);
+STATUS mediadrv_gen_mi_store_register_mem_cmd (MEDIA_BATCH_BUFFER * batch,
+					       UINT reg, dri_bo * bo,
+					       UINT offset);
 
 STATUS
 media_object_cmd (MEDIA_BATCH_BUFFER *batch,
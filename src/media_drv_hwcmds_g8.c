@@ -42,7 +42,9 @@ media_object_walker_cmd_g8 (MEDIA_BATCH_BUFFER * batch,
   UINT repel = (mode == SINGLE_MODE) ? 1 : 0;
   UINT dual_mode = (mode == DUAL_MODE) ? 1 : 0;
   UINT quad_mode = (mode == QUAD_MODE) ? 1 : 0;
-  BEGIN_BATCH (batch, CMD_MEDIA_OBJECT_WALKER_LEN /*17 */ );
+  UINT *cmd;
+  cmd = media_batchbuffer_reserve (batch, CMD_MEDIA_OBJECT_WALKER_LEN,
+				   I915_EXEC_RENDER);
   if (params->mb_enc_iframe_dist_en || params->me_in_use)
     {
       //use_scoreboard=0;
@@ -90,25 +92,10 @@ media_object_walker_cmd_g8 (MEDIA_BATCH_BUFFER * batch,
 	}
 
     }
-  OUT_BATCH (batch,
-	     CMD_MEDIA_OBJECT_WALKER | (CMD_MEDIA_OBJECT_WALKER_LEN - 2));
-  OUT_BATCH (batch, 0);
-  OUT_BATCH (batch, params->use_scoreboard << 21);
-  OUT_BATCH (batch, 0);
-  OUT_BATCH (batch, 0);
-  OUT_BATCH (batch, dw5_cmd);
-  OUT_BATCH (batch, ((dual_mode << 31) | (repel << 30) | (quad_mode << 29)));
-  OUT_BATCH (batch, ((0x3FF << 16) | 0x3FF));
-  OUT_BATCH (batch, ((params->frmfield_h_in_mb << 16) | params->frm_w_in_mb));
-  OUT_BATCH (batch, 0);
-  OUT_BATCH (batch, dw10_cmd);
-  OUT_BATCH (batch, dw11_cmd);
-  OUT_BATCH (batch, dw12_cmd);
-  OUT_BATCH (batch, ((params->frmfield_h_in_mb << 16) | params->frm_w_in_mb));
-  OUT_BATCH (batch, 0);
-  OUT_BATCH (batch, (0 | params->frm_w_in_mb));
-  OUT_BATCH (batch, (0 | (params->frmfield_h_in_mb << 16)));
-  ADVANCE_BATCH (batch);
+  media_object_walker_fill (cmd, params->use_scoreboard, dw5_cmd,
+			    (dual_mode << 31) | (repel << 30) | (quad_mode << 29),
+			    dw10_cmd, dw11_cmd, dw12_cmd, params);
+  media_batchbuffer_commit (batch, cmd + CMD_MEDIA_OBJECT_WALKER_LEN);
   return status;
 }
 #if 0
@@ -179,72 +166,48 @@ mediadrv_gen_pipe_ctrl_cmd_g8 (MEDIA_BATCH_BUFFER * batch,
   return status;
 }
 #endif
+/* gen8 STATE_BASE_ADDRESS with every base left unset */
+static const UINT state_base_address_template_g8[16] = {
+  CMD_STATE_BASE_ADDRESS | (16 - 2),
+  0 | BASE_ADDRESS_MODIFY, 0,	/* General State Base Address */
+  0,
+  0, 0,				/* Surface State Base Address */
+  0, 0,				/* Dynamic State Base Address */
+  0, 0,				/* Indirect Object Base Address */
+  0 | BASE_ADDRESS_MODIFY, 0,	/* Instruction Base Address */
+  0xFFFFF000 | BASE_ADDRESS_MODIFY,	/* General State Access Upper Bound */
+  0xFFFFF000 | BASE_ADDRESS_MODIFY,	/* Dynamic State Access Upper Bound */
+  0xFFFFF000 | BASE_ADDRESS_MODIFY,	/* Indirect Object Access Upper Bound */
+  0xFFFFF000 | BASE_ADDRESS_MODIFY,	/* Instruction Access Upper Bound */
+};
+
 STATUS
 mediadrv_gen_state_base_address_cmd_g8 (MEDIA_BATCH_BUFFER * batch,
 					STATE_BASE_ADDR_PARAMS * params)
 {
   STATUS status = SUCCESS;
-  BEGIN_BATCH (batch, 16);
-  OUT_BATCH (batch, (CMD_STATE_BASE_ADDRESS | (16 - 2)));
-  OUT_BATCH (batch, 0 | BASE_ADDRESS_MODIFY);	//General State Base Address
-  OUT_BATCH (batch, 0);
-  OUT_BATCH (batch, 0);
-  /*DW4 Surface state base address */
+  UINT *cmd;
+
+  cmd = media_batchbuffer_reserve (batch, 16, I915_EXEC_RENDER);
+  memcpy (cmd, state_base_address_template_g8,
+	  sizeof (state_base_address_template_g8));
+  /* the high dwords of the 48 bit addresses stay 0 */
   if (params->surface_state.bo)
-    {
-      OUT_RELOC (batch, params->surface_state.bo, I915_GEM_DOMAIN_INSTRUCTION, 0, BASE_ADDRESS_MODIFY);	/* Surface state base address */
-      OUT_BATCH (batch, 0);
-    }
-  else
-    {
-      OUT_BATCH (batch, 0 /*| BASE_ADDRESS_MODIFY */ );
-      OUT_BATCH (batch, 0);
-    }
-  /*DW6. Dynamic state base address */
+    media_batchbuffer_reloc (batch, &cmd[4], params->surface_state.bo,
+			     I915_GEM_DOMAIN_INSTRUCTION, 0,
+			     BASE_ADDRESS_MODIFY);
   if (params->dynamic_state.bo)
-    {
-      OUT_RELOC (batch, params->dynamic_state.bo,
-		 I915_GEM_DOMAIN_RENDER | I915_GEM_DOMAIN_SAMPLER,
-		 0, BASE_ADDRESS_MODIFY);
-      OUT_BATCH (batch, 0);
-    }
-  else
-    {
-      OUT_BATCH (batch, 0 /*| BASE_ADDRESS_MODIFY */ );
-      OUT_BATCH (batch, 0);
-    }
-  /*DW8. Indirect Object base address */
+    media_batchbuffer_reloc (batch, &cmd[6], params->dynamic_state.bo,
+			     I915_GEM_DOMAIN_RENDER | I915_GEM_DOMAIN_SAMPLER,
+			     0, BASE_ADDRESS_MODIFY);
   if (params->indirect_object.bo)
-    {
-      OUT_RELOC (batch, params->indirect_object.bo,
-		 I915_GEM_DOMAIN_SAMPLER, 0, BASE_ADDRESS_MODIFY);
-      OUT_BATCH (batch, 0);
-    }
-  else
-    {
-      OUT_BATCH (batch, 0 /*| BASE_ADDRESS_MODIFY */ );
-      OUT_BATCH (batch, 0);
-    }
-  /*DW10. Instruct base address */
+    media_batchbuffer_reloc (batch, &cmd[8], params->indirect_object.bo,
+			     I915_GEM_DOMAIN_SAMPLER, 0, BASE_ADDRESS_MODIFY);
   if (params->instruction_buffer.bo)
-    {
-      OUT_RELOC (batch, params->instruction_buffer.bo,
-		 I915_GEM_DOMAIN_INSTRUCTION, 0, BASE_ADDRESS_MODIFY);
-      OUT_BATCH (batch, 0);
-    }
-  else
-    {
-      OUT_BATCH (batch, 0 | BASE_ADDRESS_MODIFY);
-      OUT_BATCH (batch, 0);
-    }
-  /* DW12. Size limitation */
-  OUT_BATCH (batch, 0xFFFFF000 | BASE_ADDRESS_MODIFY);	//General State Access Upper Bound
-  OUT_BATCH (batch, 0xFFFFF000 | BASE_ADDRESS_MODIFY);	//Dynamic State Access Upper Bound
-  OUT_BATCH (batch, 0xFFFFF000 | BASE_ADDRESS_MODIFY);	//Indirect Object Access Upper Bound
-  OUT_BATCH (batch, 0xFFFFF000 | BASE_ADDRESS_MODIFY);	//Instruction Access Upper Bound
-  //OUT_BATCH (batch, 0 /*| BASE_ADDRESS_MODIFY*/);
-  //OUT_BATCH (batch, 0 /*| BASE_ADDRESS_MODIFY*/);
-  ADVANCE_BATCH (batch);
+    media_batchbuffer_reloc (batch, &cmd[10], params->instruction_buffer.bo,
+			     I915_GEM_DOMAIN_INSTRUCTION, 0,
+			     BASE_ADDRESS_MODIFY);
+  media_batchbuffer_commit (batch, cmd + 16);
   return status;
 }
 
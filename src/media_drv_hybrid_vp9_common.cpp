@@ -33,9 +33,20 @@
 extern struct hw_context *
 media_hybrid_dec_hw_context_init(VADriverContextP ctx, struct object_config *obj_config)
 {
-  void *vp9_context = calloc(1, sizeof(hybrid_vp9_hw_context));
+  hybrid_vp9_hw_context *vp9_context;
+  int i;
 
-  Intel_HybridVp9Decode_Initialize(ctx, (void *)vp9_context);
+  vp9_context = (hybrid_vp9_hw_context *) calloc(1, sizeof(hybrid_vp9_hw_context));
+
+  for (i = 0; i < obj_config->num_attribs; i++) {
+    if (obj_config->attrib_list[i].type == VAConfigAttribHybridDecodeMode)
+      vp9_context->vp9_state.dwDecodeMode = obj_config->attrib_list[i].value;
+  }
+
+  if (Intel_HybridVp9Decode_Initialize(ctx, (void *)vp9_context) != VA_STATUS_SUCCESS) {
+    vp9_context->context.destroy((void *)vp9_context);
+    return NULL;
+  }
 
   return (struct hw_context *)(vp9_context);
 }
@@ -0,0 +1,719 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * vaGetImage/vaPutImage copies between surfaces and images. Tiled
+ * surfaces are converted to and from linear memory on the CPU, one 16 byte
+ * tile column at a time, and NV12 chroma is split into or merged from
+ * separate U and V planes row by row while the row is still in cache.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "media_drv_util.h"
+#include "media_drv_image.h"
+
+/* X tiles are 512 bytes by 8 rows, Y tiles 128 bytes by 32 rows of
+ * 16 byte columns; both are 4K */
+#define TILE_SIZE		4096
+#define TILE_X_WIDTH		512
+#define TILE_X_HEIGHT		8
+#define TILE_Y_WIDTH		128
+#define TILE_Y_HEIGHT		32
+#define TILE_Y_COLUMN		16
+
+BOOL
+media_image_swizzle_supported (UINT tiling, UINT swizzle)
+{
+  if (tiling == I915_TILING_NONE)
+    return TRUE;
+  return swizzle == I915_BIT_6_SWIZZLE_NONE ||
+    swizzle == I915_BIT_6_SWIZZLE_9 || swizzle == I915_BIT_6_SWIZZLE_9_10;
+}
+
+/* Byte offset of (x, y) in a tiled plane; y counts from the buffer top. */
+static inline UINT
+media_image_tiled_offset (const MEDIA_IMAGE_PLANE * plane, UINT x, UINT y)
+{
+  UINT offset;
+
+  if (plane->tiling == I915_TILING_Y)
+    offset = ((y / TILE_Y_HEIGHT) * (plane->pitch / TILE_Y_WIDTH) +
+	      x / TILE_Y_WIDTH) * TILE_SIZE +
+      (x % TILE_Y_WIDTH / TILE_Y_COLUMN) * (TILE_Y_HEIGHT * TILE_Y_COLUMN) +
+      (y % TILE_Y_HEIGHT) * TILE_Y_COLUMN + x % TILE_Y_COLUMN;
+  else
+    offset = ((y / TILE_X_HEIGHT) * (plane->pitch / TILE_X_WIDTH) +
+	      x / TILE_X_WIDTH) * TILE_SIZE +
+      (y % TILE_X_HEIGHT) * TILE_X_WIDTH + x % TILE_X_WIDTH;
+
+  if (plane->swizzle == I915_BIT_6_SWIZZLE_9)
+    offset ^= (offset >> 3) & 64;
+  else if (plane->swizzle == I915_BIT_6_SWIZZLE_9_10)
+    offset ^= ((offset >> 3) ^ (offset >> 4)) & 64;
+  return offset;
+}
+
+static inline BYTE *
+media_image_linear (const MEDIA_IMAGE_PLANE * plane, UINT x, UINT y)
+{
+  return plane->base + plane->offset + y * plane->pitch + x;
+}
+
+/*
+ * Neither tiling nor swizzling breaks up an aligned 16 byte column, so
+ * rows are moved in such columns with only the ends done bytewise.
+ */
+VOID
+media_image_read_row (const MEDIA_IMAGE_PLANE * plane, UINT x, UINT y,
+		      UINT bytes, BYTE * dst)
+{
+  UINT row = plane->offset / plane->pitch + y;
+  UINT chunk;
+  const BYTE *src;
+
+  if (plane->tiling == I915_TILING_NONE)
+    {
+      memcpy (dst, media_image_linear (plane, x, y), bytes);
+      return;
+    }
+  while (bytes)
+    {
+      chunk = MIN (TILE_Y_COLUMN - (x & (TILE_Y_COLUMN - 1)), bytes);
+      src = plane->base + media_image_tiled_offset (plane, x, row);
+#ifdef __SSE2__
+      if (chunk == TILE_Y_COLUMN)
+	_mm_storeu_si128 ((__m128i *) dst,
+			  _mm_load_si128 ((const __m128i *) src));
+      else
+#endif
+	memcpy (dst, src, chunk);
+      x += chunk;
+      dst += chunk;
+      bytes -= chunk;
+    }
+}
+
+VOID
+media_image_write_row (const MEDIA_IMAGE_PLANE * plane, UINT x, UINT y,
+		       UINT bytes, const BYTE * src)
+{
+  UINT row = plane->offset / plane->pitch + y;
+  UINT chunk;
+  BYTE *dst;
+
+  if (plane->tiling == I915_TILING_NONE)
+    {
+      memcpy (media_image_linear (plane, x, y), src, bytes);
+      return;
+    }
+  while (bytes)
+    {
+      chunk = MIN (TILE_Y_COLUMN - (x & (TILE_Y_COLUMN - 1)), bytes);
+      dst = plane->base + media_image_tiled_offset (plane, x, row);
+#ifdef __SSE2__
+      if (chunk == TILE_Y_COLUMN)
+	_mm_store_si128 ((__m128i *) dst,
+			 _mm_loadu_si128 ((const __m128i *) src));
+      else
+#endif
+	memcpy (dst, src, chunk);
+      x += chunk;
+      src += chunk;
+      bytes -= chunk;
+    }
+}
+
+VOID
+media_image_split_uv_row (const BYTE * uv, BYTE * u, BYTE * v, UINT pairs)
+{
+  UINT i = 0;
+
+#ifdef __SSE2__
+  const __m128i mask = _mm_set1_epi16 (0x00ff);
+
+  for (; i + 16 <= pairs; i += 16)
+    {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) (uv + 2 * i));
+      __m128i b = _mm_loadu_si128 ((const __m128i *) (uv + 2 * i + 16));
+
+      _mm_storeu_si128 ((__m128i *) (u + i),
+			_mm_packus_epi16 (_mm_and_si128 (a, mask),
+					  _mm_and_si128 (b, mask)));
+      _mm_storeu_si128 ((__m128i *) (v + i),
+			_mm_packus_epi16 (_mm_srli_epi16 (a, 8),
+					  _mm_srli_epi16 (b, 8)));
+    }
+#endif
+  for (; i < pairs; i++)
+    {
+      u[i] = uv[2 * i];
+      v[i] = uv[2 * i + 1];
+    }
+}
+
+VOID
+media_image_merge_uv_row (const BYTE * u, const BYTE * v, BYTE * uv,
+			  UINT pairs)
+{
+  UINT i = 0;
+
+#ifdef __SSE2__
+  for (; i + 16 <= pairs; i += 16)
+    {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) (u + i));
+      __m128i b = _mm_loadu_si128 ((const __m128i *) (v + i));
+
+      _mm_storeu_si128 ((__m128i *) (uv + 2 * i), _mm_unpacklo_epi8 (a, b));
+      _mm_storeu_si128 ((__m128i *) (uv + 2 * i + 16),
+			_mm_unpackhi_epi8 (a, b));
+    }
+#endif
+  for (; i < pairs; i++)
+    {
+      uv[2 * i] = u[i];
+      uv[2 * i + 1] = v[i];
+    }
+}
+
+static VOID
+media_image_copy_plane (const MEDIA_IMAGE_PLANE * dst, UINT dst_x,
+			UINT dst_y, const MEDIA_IMAGE_PLANE * src,
+			UINT src_x, UINT src_y, UINT bytes, UINT rows,
+			BYTE * tmp)
+{
+  UINT i;
+
+  for (i = 0; i < rows; i++)
+    {
+      if (dst->tiling == I915_TILING_NONE)
+	media_image_read_row (src, src_x, src_y + i, bytes,
+			      media_image_linear (dst, dst_x, dst_y + i));
+      else if (src->tiling == I915_TILING_NONE)
+	media_image_write_row (dst, dst_x, dst_y + i, bytes,
+			       media_image_linear (src, src_x, src_y + i));
+      else
+	{
+	  media_image_read_row (src, src_x, src_y + i, bytes, tmp);
+	  media_image_write_row (dst, dst_x, dst_y + i, bytes, tmp);
+	}
+    }
+}
+
+/* x in chroma samples; tmp holds three rows of 2 * pairs bytes */
+static VOID
+media_image_split_plane (const MEDIA_IMAGE_PLANE * dst_u,
+			 const MEDIA_IMAGE_PLANE * dst_v, UINT dst_x,
+			 UINT dst_y, const MEDIA_IMAGE_PLANE * src_uv,
+			 UINT src_x, UINT src_y, UINT pairs, UINT rows,
+			 BYTE * tmp)
+{
+  const BYTE *uv;
+  BYTE *u, *v;
+  UINT i;
+
+  for (i = 0; i < rows; i++)
+    {
+      if (src_uv->tiling == I915_TILING_NONE)
+	uv = media_image_linear (src_uv, src_x * 2, src_y + i);
+      else
+	{
+	  media_image_read_row (src_uv, src_x * 2, src_y + i, pairs * 2, tmp);
+	  uv = tmp;
+	}
+      u = dst_u->tiling == I915_TILING_NONE ?
+	media_image_linear (dst_u, dst_x, dst_y + i) : tmp + pairs * 2;
+      v = dst_v->tiling == I915_TILING_NONE ?
+	media_image_linear (dst_v, dst_x, dst_y + i) : tmp + pairs * 3;
+      media_image_split_uv_row (uv, u, v, pairs);
+      if (dst_u->tiling != I915_TILING_NONE)
+	media_image_write_row (dst_u, dst_x, dst_y + i, pairs, u);
+      if (dst_v->tiling != I915_TILING_NONE)
+	media_image_write_row (dst_v, dst_x, dst_y + i, pairs, v);
+    }
+}
+
+static VOID
+media_image_merge_plane (const MEDIA_IMAGE_PLANE * dst_uv, UINT dst_x,
+			 UINT dst_y, const MEDIA_IMAGE_PLANE * src_u,
+			 const MEDIA_IMAGE_PLANE * src_v, UINT src_x,
+			 UINT src_y, UINT pairs, UINT rows, BYTE * tmp)
+{
+  const BYTE *u, *v;
+  BYTE *uv;
+  UINT i;
+
+  for (i = 0; i < rows; i++)
+    {
+      if (src_u->tiling == I915_TILING_NONE)
+	u = media_image_linear (src_u, src_x, src_y + i);
+      else
+	{
+	  media_image_read_row (src_u, src_x, src_y + i, pairs, tmp + pairs * 2);
+	  u = tmp + pairs * 2;
+	}
+      if (src_v->tiling == I915_TILING_NONE)
+	v = media_image_linear (src_v, src_x, src_y + i);
+      else
+	{
+	  media_image_read_row (src_v, src_x, src_y + i, pairs, tmp + pairs * 3);
+	  v = tmp + pairs * 3;
+	}
+      uv = dst_uv->tiling == I915_TILING_NONE ?
+	media_image_linear (dst_uv, dst_x * 2, dst_y + i) : tmp;
+      media_image_merge_uv_row (u, v, uv, pairs);
+      if (dst_uv->tiling != I915_TILING_NONE)
+	media_image_write_row (dst_uv, dst_x * 2, dst_y + i, pairs * 2, uv);
+    }
+}
+
+/*
+ * Copies a width x height rectangle. Packed formats have to match, 4:2:0
+ * formats convert between NV12 and the three plane layouts on the way.
+ */
+VAStatus
+media_image_transfer (const MEDIA_IMAGE_LAYOUT * dst, INT dst_x, INT dst_y,
+		      const MEDIA_IMAGE_LAYOUT * src, INT src_x, INT src_y,
+		      UINT width, UINT height)
+{
+  UINT chroma_width, chroma_height;
+  UINT dst_cx, dst_cy, src_cx, src_cy;
+  BYTE *tmp;
+
+  if (src->num_planes == 1 || dst->num_planes == 1)
+    {
+      if (src->fourcc != dst->fourcc)
+	return VA_STATUS_ERROR_INVALID_IMAGE_FORMAT;
+      tmp = (BYTE *) malloc (width * src->cpp);
+      if (tmp == NULL)
+	return VA_STATUS_ERROR_ALLOCATION_FAILED;
+      media_image_copy_plane (&dst->plane[0], dst_x * dst->cpp, dst_y,
+			      &src->plane[0], src_x * src->cpp, src_y,
+			      width * src->cpp, height, tmp);
+      free (tmp);
+      return VA_STATUS_SUCCESS;
+    }
+
+  /* chroma covers every sample a luma pixel of the rectangle maps to, on
+   * both sides, which differ by one when x or y differ in parity */
+  src_cx = src_x / 2;
+  src_cy = src_y / 2;
+  dst_cx = dst_x / 2;
+  dst_cy = dst_y / 2;
+  chroma_width = MIN ((src_x + width + 1) / 2 - src_cx,
+		      (dst_x + width + 1) / 2 - dst_cx);
+  chroma_height = MIN ((src_y + height + 1) / 2 - src_cy,
+		       (dst_y + height + 1) / 2 - dst_cy);
+
+  tmp = (BYTE *) malloc (MAX (width, chroma_width * 4));
+  if (tmp == NULL)
+    return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+  media_image_copy_plane (&dst->plane[0], dst_x, dst_y, &src->plane[0],
+			  src_x, src_y, width, height, tmp);
+  if (src->num_planes == 2 && dst->num_planes == 2)
+    media_image_copy_plane (&dst->plane[1], dst_cx * 2, dst_cy,
+			    &src->plane[1], src_cx * 2, src_cy,
+			    chroma_width * 2, chroma_height, tmp);
+  else if (src->num_planes == 2)
+    media_image_split_plane (&dst->plane[1], &dst->plane[2], dst_cx, dst_cy,
+			     &src->plane[1], src_cx, src_cy, chroma_width,
+			     chroma_height, tmp);
+  else if (dst->num_planes == 2)
+    media_image_merge_plane (&dst->plane[1], dst_cx, dst_cy, &src->plane[1],
+			     &src->plane[2], src_cx, src_cy, chroma_width,
+			     chroma_height, tmp);
+  else
+    {
+      media_image_copy_plane (&dst->plane[1], dst_cx, dst_cy,
+			      &src->plane[1], src_cx, src_cy, chroma_width,
+			      chroma_height, tmp);
+      media_image_copy_plane (&dst->plane[2], dst_cx, dst_cy,
+			      &src->plane[2], src_cx, src_cy, chroma_width,
+			      chroma_height, tmp);
+    }
+  free (tmp);
+  return VA_STATUS_SUCCESS;
+}
+
+/* A mapped buffer. Swizzles the CPU can't undo go through the GTT. */
+typedef struct _media_image_mapping
+{
+  dri_bo *bo;
+  BOOL gtt;
+  UINT tiling;
+  UINT swizzle;
+} MEDIA_IMAGE_MAPPING;
+
+static BYTE *
+media_image_map (MEDIA_IMAGE_MAPPING * map, dri_bo * bo, BOOL write)
+{
+  map->bo = bo;
+  media_bo_get_tiling (bo, &map->tiling, &map->swizzle);
+  map->gtt = !media_image_swizzle_supported (map->tiling, map->swizzle);
+  if (map->gtt)
+    {
+      media_bo_map_gtt (bo);
+      map->tiling = I915_TILING_NONE;
+    }
+  else
+    media_bo_map (bo, write);
+  return (BYTE *) bo->virtual;
+}
+
+static VOID
+media_image_unmap (MEDIA_IMAGE_MAPPING * map)
+{
+  if (map->gtt)
+    media_bo_unmap_gtt (map->bo);
+  else
+    media_bo_unmap (map->bo);
+}
+
+static VOID
+media_image_set_plane (MEDIA_IMAGE_PLANE * plane,
+		       const MEDIA_IMAGE_MAPPING * map, BYTE * base,
+		       UINT offset, UINT pitch)
+{
+  plane->base = base;
+  plane->offset = offset;
+  plane->pitch = pitch;
+  plane->tiling = map->tiling;
+  plane->swizzle = map->swizzle;
+}
+
+static BOOL
+media_image_layout_fourcc (UINT fourcc, UINT * num_planes, UINT * cpp)
+{
+  switch (fourcc)
+    {
+    case VA_FOURCC ('N', 'V', '1', '2'):
+      *num_planes = 2;
+      *cpp = 1;
+      return TRUE;
+    case VA_FOURCC ('I', '4', '2', '0'):
+    case VA_FOURCC ('I', 'Y', 'U', 'V'):
+    case VA_FOURCC ('Y', 'V', '1', '2'):
+      *num_planes = 3;
+      *cpp = 1;
+      return TRUE;
+    case VA_FOURCC ('Y', 'U', 'Y', '2'):
+    case VA_FOURCC ('U', 'Y', 'V', 'Y'):
+      *num_planes = 1;
+      *cpp = 2;
+      return TRUE;
+    case VA_FOURCC ('R', 'G', 'B', 'A'):
+    case VA_FOURCC ('R', 'G', 'B', 'X'):
+    case VA_FOURCC ('B', 'G', 'R', 'A'):
+    case VA_FOURCC ('B', 'G', 'R', 'X'):
+      *num_planes = 1;
+      *cpp = 4;
+      return TRUE;
+    default:
+      return FALSE;
+    }
+}
+
+static BOOL
+media_image_surface_layout (MEDIA_IMAGE_LAYOUT * layout,
+			    struct object_surface *obj_surface,
+			    const MEDIA_IMAGE_MAPPING * map, BYTE * base)
+{
+  layout->fourcc = obj_surface->fourcc;
+  if (!media_image_layout_fourcc (layout->fourcc, &layout->num_planes,
+				  &layout->cpp))
+    return FALSE;
+  media_image_set_plane (&layout->plane[0], map, base, 0,
+			 obj_surface->width);
+  if (layout->num_planes > 1)
+    media_image_set_plane (&layout->plane[1], map, base,
+			   obj_surface->width * obj_surface->y_cb_offset,
+			   obj_surface->cb_cr_pitch);
+  if (layout->num_planes > 2)
+    media_image_set_plane (&layout->plane[2], map, base,
+			   obj_surface->width * obj_surface->y_cr_offset,
+			   obj_surface->cb_cr_pitch);
+  return TRUE;
+}
+
+static BOOL
+media_image_image_layout (MEDIA_IMAGE_LAYOUT * layout, const VAImage * image,
+			  const MEDIA_IMAGE_MAPPING * map, BYTE * base)
+{
+  /* YV12 stores V before U */
+  BOOL swap_uv = image->format.fourcc == VA_FOURCC ('Y', 'V', '1', '2');
+  UINT i, plane;
+
+  layout->fourcc = image->format.fourcc;
+  if (!media_image_layout_fourcc (layout->fourcc, &layout->num_planes,
+				  &layout->cpp) ||
+      image->num_planes < layout->num_planes)
+    return FALSE;
+  for (i = 0; i < layout->num_planes; i++)
+    {
+      plane = (swap_uv && i) ? 3 - i : i;
+      media_image_set_plane (&layout->plane[i], map, base,
+			     image->offsets[plane], image->pitches[plane]);
+    }
+  return TRUE;
+}
+
+static VAStatus
+media_image_copy (struct object_surface *obj_surface,
+		  struct object_image *obj_image, BOOL to_image,
+		  INT surface_x, INT surface_y, INT image_x, INT image_y,
+		  UINT width, UINT height)
+{
+  MEDIA_IMAGE_MAPPING surface_map, image_map;
+  MEDIA_IMAGE_LAYOUT surface_layout, image_layout;
+  BYTE *surface_base, *image_base;
+  VAStatus status;
+
+  if (obj_image->bo == NULL || obj_image->bo == obj_surface->bo)
+    return VA_STATUS_ERROR_OPERATION_FAILED;
+
+  surface_base = media_image_map (&surface_map, obj_surface->bo, !to_image);
+  image_base = media_image_map (&image_map, obj_image->bo, to_image);
+  if (surface_base == NULL || image_base == NULL)
+    status = VA_STATUS_ERROR_OPERATION_FAILED;
+  else if (!media_image_surface_layout (&surface_layout, obj_surface,
+					&surface_map, surface_base) ||
+	   !media_image_image_layout (&image_layout, &obj_image->image,
+				      &image_map, image_base))
+    status = VA_STATUS_ERROR_INVALID_IMAGE_FORMAT;
+  else if (to_image)
+    status = media_image_transfer (&image_layout, image_x, image_y,
+				   &surface_layout, surface_x, surface_y,
+				   width, height);
+  else
+    {
+      status = media_image_transfer (&surface_layout, surface_x, surface_y,
+				     &image_layout, image_x, image_y,
+				     width, height);
+      obj_surface->generation++;
+    }
+  media_image_unmap (&image_map);
+  media_image_unmap (&surface_map);
+  return status;
+}
+
+VAStatus
+media_image_get (struct object_surface *obj_surface, INT x, INT y,
+		 UINT width, UINT height, struct object_image *obj_image)
+{
+  const VAImage *image = &obj_image->image;
+
+  if (x < 0 || y < 0 ||
+      x + width > obj_surface->orig_width ||
+      y + height > obj_surface->orig_height ||
+      width > image->width || height > image->height)
+    return VA_STATUS_ERROR_INVALID_PARAMETER;
+  return media_image_copy (obj_surface, obj_image, TRUE, x, y, 0, 0,
+			   width, height);
+}
+
+VAStatus
+media_image_put (struct object_surface *obj_surface,
+		 struct object_image *obj_image, INT src_x, INT src_y,
+		 UINT width, UINT height, INT dest_x, INT dest_y)
+{
+  const VAImage *image = &obj_image->image;
+
+  if (src_x < 0 || src_y < 0 || dest_x < 0 || dest_y < 0 ||
+      src_x + width > image->width || src_y + height > image->height ||
+      dest_x + width > obj_surface->orig_width ||
+      dest_y + height > obj_surface->orig_height)
+    return VA_STATUS_ERROR_INVALID_PARAMETER;
+  return media_image_copy (obj_surface, obj_image, FALSE, dest_x, dest_y,
+			   src_x, src_y, width, height);
+}
+
+static uint64_t
+media_image_row_hash (const BYTE * row, UINT bytes)
+{
+  uint64_t lane[4] = { 0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL,
+    0xcbf29ce4ULL, 0x84222325ULL
+  };
+  uint64_t word[4], hash;
+  UINT i, j;
+
+  /* every step is a bijection, so a single changed word always shows;
+   * four lanes keep four multiplies in flight instead of one */
+  for (i = 0; i + sizeof (word) <= bytes; i += sizeof (word))
+    {
+      memcpy (word, row + i, sizeof (word));
+      for (j = 0; j < 4; j++)
+	lane[j] = (lane[j] ^ word[j]) * 0x100000001b3ULL;
+    }
+  hash = lane[0];
+  for (j = 1; j < 4; j++)
+    hash = (hash ^ lane[j]) * 0x100000001b3ULL;
+  for (; i < bytes; i++)
+    hash = (hash ^ row[i]) * 0x100000001b3ULL;
+  return hash;
+}
+
+static MEDIA_SURFACE_SHADOW *
+media_image_shadow_alloc (struct object_surface *obj_surface)
+{
+  MEDIA_SURFACE_SHADOW *shadow;
+
+  shadow = (MEDIA_SURFACE_SHADOW *) calloc (1, sizeof (*shadow));
+  if (shadow == NULL)
+    return NULL;
+  shadow->pitch = obj_surface->width;
+  shadow->rows = obj_surface->bo->size / shadow->pitch;
+  shadow->data = (BYTE *) malloc (shadow->pitch * shadow->rows);
+  shadow->row_hash = (uint64_t *) malloc (shadow->rows * sizeof (uint64_t));
+  if (shadow->data == NULL || shadow->row_hash == NULL)
+    {
+      free (shadow->data);
+      free (shadow->row_hash);
+      free (shadow);
+      return NULL;
+    }
+  return shadow;
+}
+
+static VOID
+media_image_shadow_fill (MEDIA_SURFACE_SHADOW * shadow,
+			 struct object_surface *obj_surface)
+{
+  MEDIA_IMAGE_MAPPING map;
+  MEDIA_IMAGE_PLANE plane;
+  BYTE *base, *row;
+  UINT y;
+
+  base = media_image_map (&map, obj_surface->bo, FALSE);
+  media_image_set_plane (&plane, &map, base, 0, shadow->pitch);
+  for (y = 0; y < shadow->rows; y++)
+    {
+      row = shadow->data + y * shadow->pitch;
+      media_image_read_row (&plane, 0, y, shadow->pitch, row);
+      shadow->row_hash[y] = media_image_row_hash (row, shadow->pitch);
+    }
+  media_image_unmap (&map);
+  shadow->generation = obj_surface->generation;
+}
+
+/*
+ * Returns the linear copy to hand out for a derived image map, or NULL
+ * when the BO itself should be mapped: shadows not requested, or a
+ * linear BO which is already cached on the CPU.
+ */
+BYTE *
+media_image_shadow_map (struct object_surface *obj_surface)
+{
+  MEDIA_SURFACE_SHADOW *shadow = obj_surface->shadow;
+  UINT tiling, swizzle;
+
+  if (shadow != NULL && shadow->map_count > 0)
+    {
+      shadow->map_count++;
+      return shadow->data;
+    }
+  if (!(obj_surface->flags & SURFACE_LINEAR_SHADOW) || !obj_surface->bo)
+    return NULL;
+  if (shadow == NULL)
+    {
+      media_bo_get_tiling (obj_surface->bo, &tiling, &swizzle);
+      if (tiling == I915_TILING_NONE)
+	return NULL;
+      shadow = media_image_shadow_alloc (obj_surface);
+      if (shadow == NULL)
+	return NULL;
+      media_image_shadow_fill (shadow, obj_surface);
+      obj_surface->shadow = shadow;
+    }
+  else if (shadow->generation != obj_surface->generation)
+    media_image_shadow_fill (shadow, obj_surface);
+  shadow->map_count++;
+  return shadow->data;
+}
+
+/* FALSE if the shadow was not mapped and the BO has to be unmapped */
+BOOL
+media_image_shadow_unmap (struct object_surface *obj_surface)
+{
+  MEDIA_SURFACE_SHADOW *shadow = obj_surface->shadow;
+  MEDIA_IMAGE_MAPPING map;
+  MEDIA_IMAGE_PLANE plane;
+  BYTE *base = NULL, *row;
+  uint64_t hash;
+  UINT y;
+
+  if (shadow == NULL || shadow->map_count == 0)
+    return FALSE;
+  if (--shadow->map_count)
+    return TRUE;
+  for (y = 0; y < shadow->rows; y++)
+    {
+      row = shadow->data + y * shadow->pitch;
+      hash = media_image_row_hash (row, shadow->pitch);
+      if (hash == shadow->row_hash[y])
+	continue;
+      if (base == NULL)
+	{
+	  base = media_image_map (&map, obj_surface->bo, TRUE);
+	  media_image_set_plane (&plane, &map, base, 0, shadow->pitch);
+	}
+      media_image_write_row (&plane, 0, y, shadow->pitch, row);
+      shadow->row_hash[y] = hash;
+    }
+  if (base)
+    media_image_unmap (&map);
+  if (!(obj_surface->flags & SURFACE_LINEAR_SHADOW))
+    media_image_shadow_free (obj_surface);
+  return TRUE;
+}
+
+/*
+ * The BO is shared outside the driver, whose writes do not move the
+ * generation: maps go to the BO from now on, and the copy is dropped as
+ * soon as nothing maps it.
+ */
+VOID
+media_image_shadow_export (struct object_surface *obj_surface)
+{
+  obj_surface->flags &= ~SURFACE_LINEAR_SHADOW;
+  if (obj_surface->shadow && obj_surface->shadow->map_count == 0)
+    media_image_shadow_free (obj_surface);
+}
+
+VOID
+media_image_shadow_free (struct object_surface *obj_surface)
+{
+  MEDIA_SURFACE_SHADOW *shadow = obj_surface->shadow;
+
+  if (shadow == NULL)
+    return;
+  free (shadow->data);
+  free (shadow->row_hash);
+  free (shadow);
+  obj_surface->shadow = NULL;
+}
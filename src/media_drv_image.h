@@ -0,0 +1,96 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _MEDIA__DRIVER_IMAGE_H
+#define _MEDIA__DRIVER_IMAGE_H
+#include "media_drv_init.h"
+#include "media_drv_surface.h"
+
+/*
+ * One plane of a mapped buffer. Tiled planes are walked through the
+ * tiling (and bit 6 swizzle) of the buffer, so surfaces are read and
+ * written through the cached CPU mapping instead of the GTT.
+ */
+typedef struct _media_image_plane
+{
+  BYTE *base;			/* start of the mapping */
+  UINT offset;			/* bytes, a whole number of rows if tiled */
+  UINT pitch;
+  UINT tiling;
+  UINT swizzle;
+} MEDIA_IMAGE_PLANE;
+
+/* Y, then U and V or the interleaved UV plane */
+typedef struct _media_image_layout
+{
+  UINT fourcc;
+  UINT num_planes;
+  UINT cpp;			/* bytes per pixel of plane 0 */
+  MEDIA_IMAGE_PLANE plane[3];
+} MEDIA_IMAGE_LAYOUT;
+
+BOOL media_image_swizzle_supported (UINT tiling, UINT swizzle);
+VOID media_image_read_row (const MEDIA_IMAGE_PLANE * plane, UINT x, UINT y,
+			   UINT bytes, BYTE * dst);
+VOID media_image_write_row (const MEDIA_IMAGE_PLANE * plane, UINT x, UINT y,
+			    UINT bytes, const BYTE * src);
+VOID media_image_split_uv_row (const BYTE * uv, BYTE * u, BYTE * v,
+			       UINT pairs);
+VOID media_image_merge_uv_row (const BYTE * u, const BYTE * v, BYTE * uv,
+			       UINT pairs);
+VAStatus media_image_transfer (const MEDIA_IMAGE_LAYOUT * dst, INT dst_x,
+			       INT dst_y, const MEDIA_IMAGE_LAYOUT * src,
+			       INT src_x, INT src_y, UINT width, UINT height);
+
+/*
+ * Cached linear copy of a tiled surface, handed out instead of the BO when
+ * a derived image is mapped. It is refilled only when the surface
+ * generation moved since the last fill, and on unmap only rows whose hash
+ * changed are written back into the BO. A surface whose BO is exported
+ * is no longer shadowed.
+ */
+typedef struct _media_surface_shadow
+{
+  BYTE *data;
+  UINT pitch;
+  UINT rows;
+  UINT generation;
+  uint64_t *row_hash;
+  INT map_count;
+} MEDIA_SURFACE_SHADOW;
+
+BYTE *media_image_shadow_map (struct object_surface *obj_surface);
+BOOL media_image_shadow_unmap (struct object_surface *obj_surface);
+VOID media_image_shadow_free (struct object_surface *obj_surface);
+VOID media_image_shadow_export (struct object_surface *obj_surface);
+
+VAStatus media_image_get (struct object_surface *obj_surface, INT x, INT y,
+			  UINT width, UINT height,
+			  struct object_image *obj_image);
+VAStatus media_image_put (struct object_surface *obj_surface,
+			  struct object_image *obj_image, INT src_x,
+			  INT src_y, UINT width, UINT height, INT dest_x,
+			  INT dest_y);
+#endif
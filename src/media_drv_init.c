@@ -39,6 +39,8 @@
 #include "media_drv_driver.h"
 #include "media_drv_init.h"
 #include "media_drv_decoder.h"
+#include "media_drv_image.h"
+#include "media_drv_slab.h"
 
 //#define DEBUG 
 #define DEFAULT_BRIGHTNESS      0
@@ -197,6 +199,8 @@ media_CreateSurfaces2 (VADriverContextP ctx,
   INT memory_type = I965_SURFACE_MEM_NATIVE;	/* native */
   UINT surface_usage_hint = VA_SURFACE_ATTRIB_USAGE_HINT_GENERIC;
   VASurfaceAttribExternalBuffers *memory_attibute = NULL;
+  const CHAR *env = getenv (VA_INTEL_HYBRID_LINEAR_SHADOW_ENV);
+  BOOL linear_shadow = env && atoi (env) != 0;
   input_surf_params params;
   VAStatus status = VA_STATUS_SUCCESS;
   MEDIA_DRV_CONTEXT *drv_ctx = (MEDIA_DRV_CONTEXT *) ctx->pDriverData;
@@ -254,6 +258,11 @@ media_CreateSurfaces2 (VADriverContextP ctx,
 		value.p;
 
 	      break;
+	    case VASurfaceAttribHybridLinearShadow:
+	      MEDIA_DRV_ASSERT (attrib_list[i].value.type ==
+				VAGenericValueTypeInteger);
+	      linear_shadow = attrib_list[i].value.value.i != 0;
+	      break;
 
 	    default:
 	      printf ("media_CreateSurface2:attrib type not supported\n");
@@ -269,6 +278,7 @@ media_CreateSurfaces2 (VADriverContextP ctx,
   params.surfaces = surfaces;
   params.memory_attibute = memory_attibute;
   params.surface_usage_hint = surface_usage_hint;
+  params.linear_shadow = linear_shadow;
   for (i = 0; i < num_surfaces; i++)
     {
       params.index = i;
@@ -347,6 +357,12 @@ media_QuerySurfaceAttributes (VADriverContextP ctx,
   attribs[i].value.value.p = NULL; /* ignore */
   i++;
 
+  attribs[i].type = VASurfaceAttribHybridLinearShadow;
+  attribs[i].value.type = VAGenericValueTypeInteger;
+  attribs[i].flags = VA_SURFACE_ATTRIB_GETTABLE | VA_SURFACE_ATTRIB_SETTABLE;
+  attribs[i].value.value.i = 0;
+  i++;
+
   if (i > *num_attribs) {
     *num_attribs = i;
     free(attribs);
@@ -677,7 +693,29 @@ media_PutImage (VADriverContextP ctx,
 		UINT src_height,
 		INT dest_x, INT dest_y, UINT dest_width, UINT dest_height)
 {
-  return VA_STATUS_ERROR_UNIMPLEMENTED;
+  MEDIA_DRV_CONTEXT *drv_ctx = (MEDIA_DRV_CONTEXT *) ctx->pDriverData;
+  struct object_surface *obj_surface = SURFACE (surface);
+  struct object_image *obj_image = IMAGE (image);
+
+  if (!obj_surface)
+    return VA_STATUS_ERROR_INVALID_SURFACE;
+  if (!obj_image)
+    return VA_STATUS_ERROR_INVALID_IMAGE;
+  /* no scaler on the CPU path */
+  if (src_width != dest_width || src_height != dest_height)
+    return VA_STATUS_ERROR_UNIMPLEMENTED;
+
+  if (!obj_surface->bo)
+    {
+      UINT is_tiled = 0;
+      UINT fourcc = obj_image->image.format.fourcc;
+      media_guess_surface_format (ctx, surface, &fourcc, &is_tiled);
+      INT sampling = get_sampling_from_fourcc (fourcc);
+      media_alloc_surface_bo (ctx, obj_surface, is_tiled, fourcc, sampling);
+    }
+  media_sync_surface (drv_ctx, surface);
+  return media_image_put (obj_surface, obj_image, src_x, src_y, src_width,
+			  src_height, dest_x, dest_y);
 }
 
 VAStatus
@@ -685,8 +723,20 @@ media_GetImage (VADriverContextP ctx, VASurfaceID surface, INT x,	/* coordinates
 		INT y, UINT width,	/* width and height of the region */
 		UINT height, VAImageID image)
 {
+  MEDIA_DRV_CONTEXT *drv_ctx = (MEDIA_DRV_CONTEXT *) ctx->pDriverData;
+  struct object_surface *obj_surface = SURFACE (surface);
+  struct object_image *obj_image = IMAGE (image);
 
-  return VA_STATUS_ERROR_UNIMPLEMENTED;
+  if (!obj_surface)
+    return VA_STATUS_ERROR_INVALID_SURFACE;
+  if (!obj_image)
+    return VA_STATUS_ERROR_INVALID_IMAGE;
+  /* nothing was ever rendered to it */
+  if (!obj_surface->bo)
+    return VA_STATUS_SUCCESS;
+
+  media_sync_surface (drv_ctx, surface);
+  return media_image_get (obj_surface, x, y, width, height, obj_image);
 }
 
 VAStatus
@@ -731,6 +781,26 @@ media_CreateImage (VADriverContextP ctx, VAImageFormat * format, INT width, INT
   memset(image->component_order, 0, sizeof(image->component_order));
 
   switch (format->fourcc) {
+  case VA_FOURCC_NV12:
+    image->num_planes = 2;
+    image->pitches[0] = awidth;
+    image->offsets[0] = 0;
+    image->pitches[1] = awidth;
+    image->offsets[1] = awidth * aheight;
+    image->data_size  = awidth * aheight * 3 / 2;
+    break;
+  case VA_FOURCC_I420:
+  case VA_FOURCC_YV12:
+    /* planes 1 and 2 are U and V for I420, V and U for YV12 */
+    image->num_planes = 3;
+    image->pitches[0] = awidth;
+    image->offsets[0] = 0;
+    image->pitches[1] = awidth / 2;
+    image->offsets[1] = awidth * aheight;
+    image->pitches[2] = awidth / 2;
+    image->offsets[2] = awidth * aheight + awidth * aheight / 4;
+    image->data_size  = awidth * aheight * 3 / 2;
+    break;
   case VA_FOURCC_BGRX:
   case VA_FOURCC_RGBX:
   case VA_FOURCC_BGRA:
@@ -757,7 +827,7 @@ media_CreateImage (VADriverContextP ctx, VAImageFormat * format, INT width, INT
     return VA_STATUS_ERROR_ALLOCATION_FAILED;
 
   obj_image->bo = obj_buffer->buffer_store->bo;
-  dri_bo_reference(obj_image->bo);
+  media_bo_reference(obj_image->bo);
 
   image->image_id             = image_id;
   image->format               = *format;
@@ -793,6 +863,8 @@ media_create_buffer (MEDIA_DRV_CONTEXT * drv_ctx, VABufferType type,
   INT bufferID;
   struct object_buffer *obj_buffer = NULL;
   struct buffer_store *buffer_store = NULL;
+  BOOL bo_store;
+  UINT msize = 0;
   bufferID = NEW_BUFFER_ID ();
   obj_buffer = BUFFER (bufferID);
   if (NULL == obj_buffer)
@@ -809,32 +881,39 @@ media_create_buffer (MEDIA_DRV_CONTEXT * drv_ctx, VABufferType type,
   obj_buffer->size_element = size;
   obj_buffer->type = type;
   obj_buffer->buffer_store = NULL;
+  obj_buffer->shadow_surface = VA_INVALID_ID;
   obj_buffer->export_refcount = 0;
 #if VA_CHECK_VERSION(0,36,0)
   memset(&obj_buffer->export_state, 0, sizeof(VABufferInfo));
 #endif
-  buffer_store = media_drv_alloc_memory (sizeof (struct buffer_store));
+  bo_store = store_bo != NULL || type == VASliceDataBufferType ||
+    type == VAImageBufferType || type == VAEncCodedBufferType ||
+    type == VAProbabilityBufferType;
+  if (!bo_store)
+    msize = type == VAEncPackedHeaderDataBufferType ? ALIGN (size, 4) : size;
+  /* CPU payloads live right behind the store, in the same slab block */
+  buffer_store =
+    media_slab_alloc (&drv_ctx->slab,
+		      MEDIA_BUFFER_STORE_SIZE + msize * num_elements);
   MEDIA_DRV_ASSERT (buffer_store);
   buffer_store->ref_count = 1;
   if (store_bo != NULL)
     {
       buffer_store->bo = store_bo;
-      dri_bo_reference (buffer_store->bo);
+      media_bo_reference (buffer_store->bo);
       if (data)
-	dri_bo_subdata (buffer_store->bo, 0, size * num_elements, data);
+	media_bo_subdata (buffer_store->bo, 0, size * num_elements, data);
     }
-  else if (type == VASliceDataBufferType ||
-	   type == VAImageBufferType ||
-	   type == VAEncCodedBufferType || type == VAProbabilityBufferType)
+  else if (bo_store)
     {
-      buffer_store->bo = dri_bo_alloc (drv_ctx->drv_data.bufmgr,
-				       "Buffer", size * num_elements, 64);
+      buffer_store->bo = media_bo_alloc (drv_ctx->drv_data.bufmgr,
+					 "Buffer", size * num_elements, 64);
       MEDIA_DRV_ASSERT (buffer_store->bo);
 
       if (type == VAEncCodedBufferType)
 	{
 	  struct coded_buffer_segment *coded_buffer_segment;
-	  dri_bo_map (buffer_store->bo, 1);
+	  media_bo_map (buffer_store->bo, 1);
 	  coded_buffer_segment =
 	    (struct coded_buffer_segment *) buffer_store->bo->virtual;
 	  coded_buffer_segment->base.size =
@@ -846,24 +925,17 @@ media_create_buffer (MEDIA_DRV_CONTEXT * drv_ctx, VABufferType type,
 	  coded_buffer_segment->mapped = 0;
 	  /*FIXME:currently only vp8 is supported so seeting codec to CODEC_VP8 */
 	  coded_buffer_segment->codec = CODEC_VP8;
-	  dri_bo_unmap (buffer_store->bo);
+	  media_bo_unmap (buffer_store->bo);
 	}
       else if (data)
 	{
-	  dri_bo_subdata (buffer_store->bo, 0, size * num_elements, data);
+	  media_bo_subdata (buffer_store->bo, 0, size * num_elements, data);
 	}
 
     }
   else
     {
-      INT msize = size;
-
-      if (type == VAEncPackedHeaderDataBufferType)
-	{
-	  msize = ALIGN (size, 4);
-	}
-      buffer_store->buffer = media_drv_alloc_memory (msize * num_elements);
-      MEDIA_DRV_ASSERT (buffer_store->buffer);
+      buffer_store->buffer = (BYTE *) buffer_store + MEDIA_BUFFER_STORE_SIZE;
 
       if (data)
 	media_drv_memcpy (buffer_store->buffer, (msize * num_elements), data,
@@ -984,7 +1056,7 @@ media_DestroyImage (VADriverContextP ctx, VAImageID image)
   if (!obj_image)
     return VA_STATUS_SUCCESS;
 
-  dri_bo_unreference (obj_image->bo);
+  media_bo_unreference (obj_image->bo);
   obj_image->bo = NULL;
 
   if (obj_image->image.buf != VA_INVALID_ID)
@@ -1025,7 +1097,7 @@ media_drv_acquire_buffer_handle(struct object_buffer *obj_buffer,
     return VA_STATUS_ERROR_INVALID_BUFFER;
 
   /* Synchronization point */
-  drm_intel_bo_wait_rendering(buffer_store->bo);
+  media_bo_wait_rendering(buffer_store->bo);
 
   if (obj_buffer->export_refcount > 0) {
     if (obj_buffer->export_state.mem_type != mem_type)
@@ -1037,14 +1109,14 @@ media_drv_acquire_buffer_handle(struct object_buffer *obj_buffer,
     switch (mem_type) {
     case VA_SURFACE_ATTRIB_MEM_TYPE_KERNEL_DRM: {
       uint32_t name;
-      if (drm_intel_bo_flink(buffer_store->bo, &name) != 0)
+      if (media_bo_flink(buffer_store->bo, &name) != 0)
         return VA_STATUS_ERROR_INVALID_BUFFER;
       buf_info->handle = name;
       break;
       }
     case VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME: {
       int fd;
-      if (drm_intel_bo_gem_export_to_prime(buffer_store->bo, &fd) != 0)
+      if (media_bo_export_to_prime(buffer_store->bo, &fd) != 0)
         return VA_STATUS_ERROR_INVALID_BUFFER;
       buf_info->handle = (intptr_t)fd;
       break;
@@ -1069,7 +1141,9 @@ media_drv_AcquireBufferHandle(VADriverContextP ctx, VABufferID buf_id,
 {
   MEDIA_DRV_CONTEXT *drv_ctx = (MEDIA_DRV_CONTEXT *) (ctx->pDriverData);
   struct object_buffer * const obj_buffer = BUFFER(buf_id);
+  struct object_surface *obj_surface;
   uint32_t i, mem_type;
+  VAStatus status;
 
   /* List of supported memory types, in preferred order */
   static const uint32_t mem_types[] = {
@@ -1101,7 +1175,15 @@ media_drv_AcquireBufferHandle(VADriverContextP ctx, VABufferID buf_id,
     if (!mem_type)
       return VA_STATUS_ERROR_UNSUPPORTED_MEMORY_TYPE;
   }
-  return media_drv_acquire_buffer_handle(obj_buffer, mem_type, buf_info);
+  status = media_drv_acquire_buffer_handle(obj_buffer, mem_type, buf_info);
+  if (status != VA_STATUS_SUCCESS)
+    return status;
+
+  /* the surface of a derived image is now written behind the driver */
+  obj_surface = SURFACE(obj_buffer->shadow_surface);
+  if (obj_surface)
+    media_image_shadow_export(obj_surface);
+  return VA_STATUS_SUCCESS;
 }
 
 /* Releases buffer handle after usage (internal implementation) */
@@ -1265,7 +1347,9 @@ media_DeriveImage (VADriverContextP ctx, VASurfaceID surface, VAImage * out_imag
     return VA_STATUS_ERROR_ALLOCATION_FAILED;
 
   obj_image->bo = obj_buffer->buffer_store->bo;
-  dri_bo_reference (obj_image->bo);
+  media_bo_reference (obj_image->bo);
+  if (obj_surface->flags & SURFACE_LINEAR_SHADOW)
+    obj_buffer->shadow_surface = surface;
 
   if (image->num_palette_entries > 0 && image->entry_bytes > 0)
     {
@@ -1302,6 +1386,12 @@ media_image_formats_map[MEDIA_GEN_MAX_IMAGE_FORMATS + 1] = {
     { VA_FOURCC_RGBX, VA_LSB_FIRST, 32, 24, 0x000000ff, 0x0000ff00, 0x00ff0000 } },
   { MEDIA_SURFACETYPE_RGBA,
     { VA_FOURCC_BGRX, VA_LSB_FIRST, 32, 24, 0x00ff0000, 0x0000ff00, 0x000000ff } },
+  { MEDIA_SURFACETYPE_YUV,
+    { VA_FOURCC_NV12, VA_LSB_FIRST, 12, } },
+  { MEDIA_SURFACETYPE_YUV,
+    { VA_FOURCC_I420, VA_LSB_FIRST, 12, } },
+  { MEDIA_SURFACETYPE_YUV,
+    { VA_FOURCC_YV12, VA_LSB_FIRST, 12, } },
 };
 
 
@@ -1360,7 +1450,7 @@ media_QuerySurfaceStatus (VADriverContextP ctx, VASurfaceID render_target, VASur
   MEDIA_DRV_ASSERT (obj_surface);
   if (obj_surface->bo)
     {
-      if (drm_intel_bo_busy (obj_surface->bo))
+      if (media_bo_busy (obj_surface->bo))
 	{
 	  *status = VASurfaceRendering;
 	}
@@ -1394,6 +1484,7 @@ media_EndPicture (VADriverContextP ctx, VAContextID context)
   MEDIA_DRV_CONTEXT *drv_ctx;
   struct object_context *obj_context;
   struct object_config *obj_config;
+  struct object_surface *obj_surface;
   MEDIA_DRV_ASSERT (ctx);
   drv_ctx = (MEDIA_DRV_CONTEXT *) ctx->pDriverData;
   obj_context = CONTEXT (context);
@@ -1425,6 +1516,15 @@ media_EndPicture (VADriverContextP ctx, VAContextID context)
 	media_encoder_picture (ctx, obj_config->profile,
 			       &obj_context->codec_state,
 			       obj_context->hw_context);
+
+      /* the input and the reconstructed frame of this picture */
+      obj_surface =
+	SURFACE (obj_context->codec_state.encode.current_render_target);
+      if (obj_surface)
+	obj_surface->generation++;
+      obj_surface = obj_context->codec_state.encode.reconstructed_object;
+      if (obj_surface)
+	obj_surface->generation++;
     }
   else if (obj_context->codec_type == CODEC_DEC) {
     if (obj_context->codec_state.decode.pic_param == NULL) {
@@ -1442,6 +1542,11 @@ media_EndPicture (VADriverContextP ctx, VAContextID context)
       return VA_STATUS_ERROR_INVALID_PARAMETER;
     }
 
+    obj_surface =
+      SURFACE (obj_context->codec_state.decode.current_render_target);
+    if (obj_surface)
+      obj_surface->generation++;
+
     if (obj_context->hw_context && obj_context->hw_context->run)
       return obj_context->hw_context->run(ctx, obj_config->profile,
                                         &obj_context->codec_state,
@@ -1479,9 +1584,11 @@ media_EndPicture (VADriverContextP ctx, VAContextID context)
     {                                                                   \
         struct category##_state *category = &obj_context->codec_state.category; \
         if (category->num_##member == category->max_##member) {         \
-            category->member = realloc(category->member, (category->max_##member + NUM_SLICES) * sizeof(*category->member)); \
-            memset(category->member + category->max_##member, 0, NUM_SLICES * sizeof(*category->member)); \
-            category->max_##member += NUM_SLICES;                       \
+            /* doubled, so the array settles after a few frames */      \
+            INT grow = MAX(category->max_##member, NUM_SLICES);          \
+            category->member = realloc(category->member, (category->max_##member + grow) * sizeof(*category->member)); \
+            memset(category->member + category->max_##member, 0, grow * sizeof(*category->member)); \
+            category->max_##member += grow;                             \
         }                                                               \
         media_release_buffer_store(&category->member[category->num_##member]); \
         media_reference_buffer_store(&category->member[category->num_##member], obj_buffer->buffer_store); \
@@ -1560,6 +1667,38 @@ media_encoder_render_misc_parameter_buffer (VADriverContextP ctx,
   if (index == -1)
     return VA_STATUS_ERROR_UNIMPLEMENTED;
 
+#if VA_CHECK_VERSION(0,40,0)
+  /* with temporal layers each layer sends its own rate and frame rate */
+  if (param->type == VAEncMiscParameterTypeRateControl ||
+      param->type == VAEncMiscParameterTypeFrameRate)
+    {
+      struct buffer_store **layer_param;
+      UINT temporal_id;
+
+      if (param->type == VAEncMiscParameterTypeRateControl)
+	{
+	  temporal_id = ((VAEncMiscParameterRateControl *) param->data)->
+	    rc_flags.bits.temporal_id;
+	  layer_param = encode->layer_rate_control;
+	}
+      else
+	{
+	  temporal_id = ((VAEncMiscParameterFrameRate *) param->data)->
+	    framerate_flags.bits.temporal_id;
+	  layer_param = encode->layer_frame_rate;
+	}
+
+      if (temporal_id >= MEDIA_MAX_TEMPORAL_LAYERS)
+	return VA_STATUS_ERROR_INVALID_PARAMETER;
+
+      media_release_buffer_store (&layer_param[temporal_id]);
+      media_reference_buffer_store (&layer_param[temporal_id],
+				    obj_buffer->buffer_store);
+      if (temporal_id != 0)
+	return VA_STATUS_SUCCESS;
+    }
+#endif
+
   media_release_buffer_store (&encode->misc_param[index]);
   media_reference_buffer_store (&encode->misc_param[index],
 				obj_buffer->buffer_store);
@@ -1927,6 +2066,7 @@ media_UnmapBuffer (VADriverContextP ctx, VABufferID buf_id)
 {
   MEDIA_DRV_CONTEXT *drv_ctx = (MEDIA_DRV_CONTEXT *) ctx->pDriverData;
   struct object_buffer *obj_buffer = BUFFER (buf_id);
+  struct object_surface *obj_surface;
   VAStatus status = VA_STATUS_ERROR_UNKNOWN;
   MEDIA_DRV_ASSERT (ctx);
 
@@ -1943,16 +2083,19 @@ media_UnmapBuffer (VADriverContextP ctx, VABufferID buf_id)
   if (!obj_buffer || !obj_buffer->buffer_store)
     return VA_STATUS_ERROR_INVALID_BUFFER;
 
-  if (NULL != obj_buffer->buffer_store->bo)
+  obj_surface = SURFACE (obj_buffer->shadow_surface);
+  if (obj_surface && media_image_shadow_unmap (obj_surface))
+    status = VA_STATUS_SUCCESS;
+  else if (NULL != obj_buffer->buffer_store->bo)
     {
       UINT tiling, swizzle;
 
-      dri_bo_get_tiling (obj_buffer->buffer_store->bo, &tiling, &swizzle);
+      media_bo_get_tiling (obj_buffer->buffer_store->bo, &tiling, &swizzle);
 
       if (tiling != I915_TILING_NONE)
-	drm_intel_gem_bo_unmap_gtt (obj_buffer->buffer_store->bo);
+	media_bo_unmap_gtt (obj_buffer->buffer_store->bo);
       else
-	dri_bo_unmap (obj_buffer->buffer_store->bo);
+	media_bo_unmap (obj_buffer->buffer_store->bo);
       status = VA_STATUS_SUCCESS;
     }
   else if (NULL != obj_buffer->buffer_store->buffer)
@@ -1969,6 +2112,8 @@ media_MapBuffer (VADriverContextP ctx, VABufferID buf_id,	/* in */
 {
   MEDIA_DRV_CONTEXT *drv_ctx;
   struct object_buffer *obj_buffer;
+  struct object_surface *obj_surface;
+  BYTE *shadow;
   VAStatus status = VA_STATUS_ERROR_UNKNOWN;
   MEDIA_DRV_ASSERT (ctx);
   drv_ctx = (MEDIA_DRV_CONTEXT *) ctx->pDriverData;
@@ -1983,16 +2128,23 @@ media_MapBuffer (VADriverContextP ctx, VABufferID buf_id,	/* in */
   if (!obj_buffer || !obj_buffer->buffer_store)
     return VA_STATUS_ERROR_INVALID_BUFFER;
 
-  if (NULL != obj_buffer->buffer_store->bo)
+  obj_surface = SURFACE (obj_buffer->shadow_surface);
+  shadow = obj_surface ? media_image_shadow_map (obj_surface) : NULL;
+  if (shadow)
+    {
+      *pbuf = shadow;
+      status = VA_STATUS_SUCCESS;
+    }
+  else if (NULL != obj_buffer->buffer_store->bo)
     {
       UINT tiling, swizzle;
-      drm_intel_bo_wait_rendering (obj_buffer->buffer_store->bo);
-      dri_bo_get_tiling (obj_buffer->buffer_store->bo, &tiling, &swizzle);
+      media_bo_wait_rendering (obj_buffer->buffer_store->bo);
+      media_bo_get_tiling (obj_buffer->buffer_store->bo, &tiling, &swizzle);
 
       if (tiling != I915_TILING_NONE)
-	drm_intel_gem_bo_map_gtt (obj_buffer->buffer_store->bo);
+	media_bo_map_gtt (obj_buffer->buffer_store->bo);
       else
-	dri_bo_map (obj_buffer->buffer_store->bo, 1);
+	media_bo_map (obj_buffer->buffer_store->bo, 1);
 
       MEDIA_DRV_ASSERT (obj_buffer->buffer_store->bo->virtual);
       *pbuf = obj_buffer->buffer_store->bo->virtual;
@@ -2165,6 +2317,8 @@ media_CreateContext (VADriverContextP ctx, VAConfigID config_id, INT picture_wid
                                                             sizeof(*obj_context->codec_state.decode.slice_datas));
 
           obj_context->hw_context = media_dec_hw_context_init(ctx, obj_config);
+          if (obj_context->hw_context == NULL)
+            status = VA_STATUS_ERROR_ALLOCATION_FAILED;
         }
     }
   /* Error recovery */
@@ -2254,6 +2408,23 @@ media_GetConfigAttributes (VADriverContextP ctx, VAProfile profile, VAEntrypoint
           attrib_list[i].value = VA_DEC_SLICE_MODE_NORMAL;
           break;
 
+        case VAConfigAttribHybridDecodeMode:
+          if (profile == VAProfileVP9Profile0 && entrypoint == VAEntrypointVLD)
+            attrib_list[i].value = VA_HYBRID_DECODE_MODE_NORMAL |
+                                   VA_HYBRID_DECODE_MODE_KEYFRAME_ONLY;
+          else
+            attrib_list[i].value = VA_ATTRIB_NOT_SUPPORTED;
+          break;
+
+        case VAConfigAttribHybridEncodeOutput:
+          if (profile == VAProfileVP8Version0_3 &&
+              entrypoint == VAEntrypointEncSlice)
+            attrib_list[i].value = VA_HYBRID_ENCODE_OUTPUT_MB_DATA |
+                                   VA_HYBRID_ENCODE_OUTPUT_BITSTREAM;
+          else
+            attrib_list[i].value = VA_ATTRIB_NOT_SUPPORTED;
+          break;
+
 	default:
 	  attrib_list[i].value = VA_ATTRIB_NOT_SUPPORTED;
 	  break;
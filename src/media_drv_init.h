@@ -43,7 +43,7 @@ extern "C" {
 
 #include <drm.h>
 #include <i915_drm.h>
-#include <intel_bufmgr.h>
+#include "media_drv_bufmgr.h"
 
 
 #ifdef __cplusplus
@@ -55,9 +55,12 @@ extern "C" {
 #include "object_heap.h"
 #include "media_drv_render.h"
 #include "media_drv_hw.h"
+#include "media_drv_surface_pool.h"
+#include "media_drv_slab.h"
 
 #define I965_PACKED_HEADER_BASE         0
 #define I965_PACKED_MISC_HEADER_BASE    3
+#define MEDIA_MAX_TEMPORAL_LAYERS       4
 
 #define NEW_CONFIG_ID() object_heap_allocate(&drv_ctx->config_heap);
 #define CONFIG(id) ((struct object_config *)object_heap_lookup(&drv_ctx->config_heap, id))
@@ -91,6 +94,7 @@ struct object_buffer
   INT num_elements;
   INT size_element;
   VABufferType type;
+  VASurfaceID shadow_surface;	/* derived image mapped through its shadow */
   unsigned int export_refcount;
 #if VA_CHECK_VERSION(0,36,0)
   VABufferInfo export_state;
@@ -103,6 +107,8 @@ struct buffer_store
   INT ref_count;
   INT num_elements;
 };
+/* offset of a CPU payload allocated along with its store */
+#define MEDIA_BUFFER_STORE_SIZE ALIGN (sizeof (struct buffer_store), 16)
 
 struct object_subpic
 {
@@ -148,6 +154,10 @@ struct encode_state
   INT num_slice_params_ext;
   INT last_packed_header_type;
   struct buffer_store *misc_param[16];
+  /* RateControl and FrameRate by temporal_id, the base layer ones are
+   * also in misc_param */
+  struct buffer_store *layer_rate_control[MEDIA_MAX_TEMPORAL_LAYERS];
+  struct buffer_store *layer_frame_rate[MEDIA_MAX_TEMPORAL_LAYERS];
   VASurfaceID current_render_target;
   struct object_surface *input_yuv_object;
   struct object_surface *reconstructed_object;
@@ -234,6 +244,8 @@ typedef struct _media_drv_context
   struct object_heap buffer_heap;
   struct object_heap subpic_heap;
   struct object_heap image_heap;
+  MEDIA_SURFACE_POOL surface_pool;
+  MEDIA_SLAB slab;
   struct hw_codec_info *codec_info;
   INT locked;
   MEDIA_DRV_MUTEX ctxmutex;
@@ -43,7 +43,7 @@ extern "C"
 
 #include <drm.h>
 #include <i915_drm.h>
-#include <intel_bufmgr.h>
+#include "media_drv_bufmgr.h"
 
 
 #ifdef __cplusplus
@@ -181,11 +181,11 @@ media_put_surface_dri(
   dest_region = render_state->draw_region;
 
   if (dest_region) {
-    dri_bo_flink(dest_region->bo, &name);
+    media_bo_flink(dest_region->bo, &name);
 
     if (buffer->dri2.name != name) {
       new_region = True;
-      dri_bo_unreference(dest_region->bo);
+      media_bo_unreference(dest_region->bo);
     }
   } else {
     dest_region = (struct region *)calloc(1, sizeof(*dest_region));
@@ -203,7 +203,7 @@ media_put_surface_dri(
 
     dest_region->bo = intel_bo_gem_create_from_name(drv_ctx->drv_data.bufmgr, "rendering buffer", buffer->dri2.name);
 
-    dri_bo_get_tiling(dest_region->bo, &(dest_region->tiling), &(dest_region->swizzle));
+    media_bo_get_tiling(dest_region->bo, &(dest_region->tiling), &(dest_region->swizzle));
   }
 
   color_flag = flags & VA_SRC_COLOR_MASK;
@@ -31,8 +31,50 @@
 #include "media_drv_util.h"
 #include "media_drv_driver.h"
 #include "media_drv_render.h"
+#include "media_drv_surface.h"
 #include "media_drv_hw.h"
 
+/*
+ * Returns TRUE when the static state must be written for this PutSurface,
+ * and remembers its key so the next call with the same inputs can skip it.
+ */
+BOOL
+media_render_cache_update (VADriverContextP ctx,
+			   struct object_surface *obj_surface, UINT flags)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = ctx->pDriverData;
+  struct media_render_state *render_state = &drv_ctx->render_state;
+  struct media_render_cache_key key;
+
+  memset (&key, 0, sizeof (key));
+  key.src_fourcc = obj_surface->fourcc;
+  key.src_subsampling = obj_surface->subsampling;
+  key.dst_cpp = render_state->draw_region->cpp;
+  key.sampler_count = render_state->wm.sampler_count;
+  key.flags = flags & (VA_SRC_COLOR_MASK | VA_FILTER_SCALING_MASK);
+  key.contrast = drv_ctx->contrast_attrib->value;
+  key.brightness = drv_ctx->brightness_attrib->value;
+  key.hue = drv_ctx->hue_attrib->value;
+  key.saturation = drv_ctx->saturation_attrib->value;
+
+  if (render_state->cache_valid &&
+      !memcmp (&render_state->cache_key, &key, sizeof (key)))
+    return FALSE;
+
+  render_state->cache_key = key;
+  render_state->cache_valid = TRUE;
+  return TRUE;
+}
+
+/* the subpicture path writes its own blend state and constants */
+VOID
+media_render_cache_invalidate (VADriverContextP ctx)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = ctx->pDriverData;
+
+  drv_ctx->render_state.cache_valid = FALSE;
+}
+
 BOOL
 media_render_init (VADriverContextP ctx)
 {
@@ -55,4 +97,5 @@ media_render_terminate (VADriverContextP ctx)
 
   if (render_state->render_terminate)
     render_state->render_terminate(ctx);
+  render_state->cache_valid = FALSE;
 }
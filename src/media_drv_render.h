@@ -39,6 +39,10 @@
 #define VA_SRC_COLOR_MASK      0x000000f0
 #endif
 
+#ifndef VA_FILTER_SCALING_MASK
+#define VA_FILTER_SCALING_MASK 0x00000f00
+#endif
+
 struct media_render_kernel
 {
   CHAR *name;
@@ -51,6 +55,24 @@ struct media_render_kernel
 
 struct object_surface;
 
+/*
+ * Everything the sampler, cc, blend and constant state of a PutSurface
+ * depends on. While it is unchanged that state is left in place and only
+ * the surface states and vertices are written again.
+ */
+struct media_render_cache_key
+{
+  UINT src_fourcc;
+  UINT src_subsampling;
+  UINT dst_cpp;
+  INT sampler_count;
+  UINT flags;			/* color standard and scaling bits */
+  INT contrast;
+  INT brightness;
+  INT hue;
+  INT saturation;
+};
+
 struct media_render_state
 {
   struct
@@ -139,6 +161,9 @@ struct media_render_state
   UINT scissor_offset;
   INT scissor_size;
 
+  struct media_render_cache_key cache_key;
+  BOOL cache_valid;
+
   void (*render_put_surface)(VADriverContextP ctx, struct object_surface *,
                              const VARectangle *src_rec,
                              const VARectangle *dst_rect,
@@ -171,6 +196,11 @@ media_render_put_subpicture(
     const VARectangle *dst_rect
 );
 
+BOOL media_render_cache_update (VADriverContextP ctx,
+				struct object_surface *obj_surface,
+				UINT flags);
+VOID media_render_cache_invalidate (VADriverContextP ctx);
+
 BOOL media_render_init (VADriverContextP ctx);
 VOID media_render_terminate (VADriverContextP ctx);
 
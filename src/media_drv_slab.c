@@ -0,0 +1,135 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "media_drv_slab.h"
+#include "media_drv_util.h"
+
+#define MEDIA_SLAB_LARGE	MEDIA_SLAB_CLASSES
+
+/* sits in the first MEDIA_SLAB_HEADER_SIZE bytes of every block */
+union _media_slab_header
+{
+  MEDIA_SLAB_HEADER *next;	/* while cached */
+  struct
+  {
+    MEDIA_SLAB *slab;
+    UINT slab_class;
+  } owner;			/* while handed out */
+};
+
+VOID
+media_slab_init (MEDIA_SLAB * slab)
+{
+  memset (slab, 0, sizeof (*slab));
+  media_drv_mutex_init (&slab->mutex);
+}
+
+VOID
+media_slab_destroy (MEDIA_SLAB * slab)
+{
+  MEDIA_SLAB_HEADER *block;
+  UINT i;
+
+  for (i = 0; i < MEDIA_SLAB_CLASSES; i++)
+    while ((block = slab->free_list[i]) != NULL)
+      {
+	slab->free_list[i] = block->next;
+	free (block);
+      }
+  media_drv_mutex_destroy (&slab->mutex);
+}
+
+static UINT
+media_slab_class (UINT size)
+{
+  UINT slab_class = 0;
+
+  if (size > MEDIA_SLAB_MAX_SIZE)
+    return MEDIA_SLAB_LARGE;
+  while ((1U << (MEDIA_SLAB_MIN_SHIFT + slab_class)) <
+	 size + MEDIA_SLAB_HEADER_SIZE)
+    slab_class++;
+  return slab_class;
+}
+
+VOID *
+media_slab_alloc (MEDIA_SLAB * slab, UINT size)
+{
+  UINT slab_class = media_slab_class (size);
+  MEDIA_SLAB_HEADER *block = NULL;
+
+  if (slab_class == MEDIA_SLAB_LARGE)
+    block = (MEDIA_SLAB_HEADER *) calloc (1, MEDIA_SLAB_HEADER_SIZE + size);
+  else
+    {
+      media_drv_mutex_lock (&slab->mutex);
+      block = slab->free_list[slab_class];
+      if (block)
+	{
+	  slab->free_list[slab_class] = block->next;
+	  slab->num_free[slab_class]--;
+	}
+      media_drv_mutex_unlock (&slab->mutex);
+      if (block == NULL)
+	block = (MEDIA_SLAB_HEADER *)
+	  malloc (1U << (MEDIA_SLAB_MIN_SHIFT + slab_class));
+      if (block)
+	memset ((BYTE *) block + MEDIA_SLAB_HEADER_SIZE, 0, size);
+    }
+  if (block == NULL)
+    return NULL;
+  block->owner.slab = slab;
+  block->owner.slab_class = slab_class;
+  return (BYTE *) block + MEDIA_SLAB_HEADER_SIZE;
+}
+
+VOID
+media_slab_free (VOID * ptr)
+{
+  MEDIA_SLAB_HEADER *block;
+  MEDIA_SLAB *slab;
+  UINT slab_class;
+
+  if (ptr == NULL)
+    return;
+  block = (MEDIA_SLAB_HEADER *) ((BYTE *) ptr - MEDIA_SLAB_HEADER_SIZE);
+  slab = block->owner.slab;
+  slab_class = block->owner.slab_class;
+  if (slab_class != MEDIA_SLAB_LARGE)
+    {
+      media_drv_mutex_lock (&slab->mutex);
+      if (slab->num_free[slab_class] < MEDIA_SLAB_CACHE_DEPTH)
+	{
+	  block->next = slab->free_list[slab_class];
+	  slab->free_list[slab_class] = block;
+	  slab->num_free[slab_class]++;
+	  block = NULL;
+	}
+      media_drv_mutex_unlock (&slab->mutex);
+    }
+  free (block);
+}
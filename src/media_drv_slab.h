@@ -0,0 +1,60 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _MEDIA__DRIVER_SLAB_H
+#define _MEDIA__DRIVER_SLAB_H
+#include "media_drv_defines.h"
+#include "media_drv_data.h"
+
+/*
+ * Size-classed allocator for the small blocks every frame creates and
+ * destroys (parameter buffer stores and their payloads). Freed blocks go
+ * back to the cache of the driver instance they came from, which
+ * media_slab_destroy() empties at vaTerminate, so nothing of the driver
+ * outlives it. Requests above MEDIA_SLAB_MAX_SIZE go straight to calloc.
+ */
+#define MEDIA_SLAB_MIN_SHIFT	6	/* 64 byte class */
+#define MEDIA_SLAB_MAX_SHIFT	12	/* 4 KiB class */
+#define MEDIA_SLAB_CLASSES	(MEDIA_SLAB_MAX_SHIFT - MEDIA_SLAB_MIN_SHIFT + 1)
+#define MEDIA_SLAB_HEADER_SIZE	16
+#define MEDIA_SLAB_MAX_SIZE	((1 << MEDIA_SLAB_MAX_SHIFT) - MEDIA_SLAB_HEADER_SIZE)
+#define MEDIA_SLAB_CACHE_DEPTH	32	/* cached blocks per class */
+
+typedef union _media_slab_header MEDIA_SLAB_HEADER;
+
+typedef struct _media_slab
+{
+  MEDIA_DRV_MUTEX mutex;
+  MEDIA_SLAB_HEADER *free_list[MEDIA_SLAB_CLASSES];
+  UINT num_free[MEDIA_SLAB_CLASSES];
+} MEDIA_SLAB;
+
+VOID media_slab_init (MEDIA_SLAB * slab);
+/* every block must have been freed */
+VOID media_slab_destroy (MEDIA_SLAB * slab);
+/* zeroed, like media_drv_alloc_memory() */
+VOID *media_slab_alloc (MEDIA_SLAB * slab, UINT size);
+VOID media_slab_free (VOID * ptr);
+#endif
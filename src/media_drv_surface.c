@@ -33,6 +33,8 @@
 #include "media_drv_hw.h"
 #include "media_drv_util.h"
 #include "media_drv_surface.h"
+#include "media_drv_image.h"
+#include "media_drv_encoder_vp8_packer.h"
 
 //#define DEBUG
 VAStatus
@@ -44,7 +46,8 @@ media_sync_surface (MEDIA_DRV_CONTEXT * drv_ctx, VASurfaceID render_target)
   MEDIA_DRV_ASSERT (obj_surface);
 
   if (obj_surface->bo)
-    drm_intel_bo_wait_rendering (obj_surface->bo);
+    media_bo_wait_rendering (obj_surface->bo);
+  media_vp8_packer_sync_surface (obj_surface);
 
   return VA_STATUS_SUCCESS;
 }
@@ -236,14 +239,14 @@ media_suface_external_memory (VADriverContextP ctx,
 
   if (external_memory_type == I965_SURFACE_MEM_GEM_FLINK)
     obj_surface->bo =
-      drm_intel_bo_gem_create_from_name (drv_ctx->drv_data.bufmgr,
-					 "gem flinked vaapi surface",
-					 memory_attibute->buffers[index]);
+      media_bo_create_from_name (drv_ctx->drv_data.bufmgr,
+				 "gem flinked vaapi surface",
+				 memory_attibute->buffers[index]);
   else if (external_memory_type == I965_SURFACE_MEM_DRM_PRIME)
     obj_surface->bo =
-      drm_intel_bo_gem_create_from_prime (drv_ctx->drv_data.bufmgr,
-					  memory_attibute->buffers[index],
-					  obj_surface->size);
+      media_bo_create_from_prime (drv_ctx->drv_data.bufmgr,
+				  memory_attibute->buffers[index],
+				  obj_surface->size);
 
   if (!obj_surface->bo)
     return VA_STATUS_ERROR_INVALID_PARAMETER;
@@ -501,23 +504,25 @@ media_alloc_surface_bo (VADriverContextP ctx,
 
   if (tiled)
     {
-      UINT tiling_mode = I915_TILING_Y;	/* always uses Y-tiled format */
-      ULONG pitch;
-
-      obj_surface->bo = drm_intel_bo_alloc_tiled (drv_ctx->drv_data.bufmgr,
-						  "vaapi surface",
-						  region_width,
-						  region_height,
-						  1, &tiling_mode, &pitch, 0);
-      MEDIA_DRV_ASSERT (tiling_mode == I915_TILING_Y);
-      MEDIA_DRV_ASSERT (pitch == obj_surface->width);
+      /* always uses Y-tiled format */
+      obj_surface->pool_entry =
+	media_surface_pool_acquire (&drv_ctx->surface_pool, I915_TILING_Y,
+				    region_width, region_height,
+				    obj_surface->size);
+      MEDIA_DRV_ASSERT (!obj_surface->pool_entry ||
+			(obj_surface->pool_entry->tiling == I915_TILING_Y &&
+			 obj_surface->pool_entry->pitch ==
+			 obj_surface->width));
     }
   else
     {
-      obj_surface->bo = dri_bo_alloc (drv_ctx->drv_data.bufmgr,
-				      "vaapi surface",
-				      obj_surface->size, 0x1000);
+      obj_surface->pool_entry =
+	media_surface_pool_acquire (&drv_ctx->surface_pool,
+				    I915_TILING_NONE, obj_surface->width,
+				    region_height, obj_surface->size);
     }
+  if (obj_surface->pool_entry)
+    obj_surface->bo = obj_surface->pool_entry->bo;
 
   obj_surface->fourcc = fourcc;
   obj_surface->subsampling = subsampling;
@@ -592,6 +597,12 @@ media_drv_create_surface (VADriverContextP ctx, input_surf_params * params)
   obj_surface->private_data = NULL;
   obj_surface->free_private_data = NULL;
   obj_surface->subsampling = SUBSAMPLE_YUV420;
+  obj_surface->generation = 0;
+  obj_surface->shadow = NULL;
+  obj_surface->pool_entry = NULL;
+  if (params->linear_shadow &&
+      params->memory_type == I965_SURFACE_MEM_NATIVE)
+    obj_surface->flags |= SURFACE_LINEAR_SHADOW;
 
   switch (params->memory_type)
     {
@@ -616,8 +627,7 @@ VOID
 media_destroy_surface (struct object_heap * heap, struct object_base * obj)
 {
   struct object_surface *obj_surface = (struct object_surface *) obj;
-  dri_bo_unreference (obj_surface->bo);
-  obj_surface->bo = NULL;
+  media_image_shadow_free (obj_surface);
 
   if (obj_surface->free_private_data != NULL)
     {
@@ -628,5 +638,14 @@ media_destroy_surface (struct object_heap * heap, struct object_base * obj)
       }
       obj_surface->private_data = NULL;
     }
+
+  /* a derived image may still hold the BO */
+  if (obj_surface->pool_entry)
+    media_surface_pool_release (obj_surface->pool_entry,
+				!(obj_surface->flags & SURFACE_DERIVED));
+  else
+    media_bo_unreference (obj_surface->bo);
+  obj_surface->pool_entry = NULL;
+  obj_surface->bo = NULL;
   object_heap_free (heap, obj);
 }
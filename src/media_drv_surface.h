@@ -37,7 +37,7 @@ extern "C" {
 
 #include <drm.h>
 #include <i915_drm.h>
-#include <intel_bufmgr.h>
+#include "media_drv_bufmgr.h"
 
 #ifdef __cplusplus
 }
@@ -50,6 +50,7 @@ extern "C" {
 #define SURFACE_REFERENCED      (1 << 0)
 #define SURFACE_DISPLAYED       (1 << 1)
 #define SURFACE_DERIVED         (1 << 2)
+#define SURFACE_LINEAR_SHADOW   (1 << 3)	/* derived images map a linear copy */
 #define SURFACE_REF_DIS_MASK    ((SURFACE_REFERENCED) | \
                                  (SURFACE_DISPLAYED))
 #define SURFACE_ALL_MASK        ((SURFACE_REFERENCED) | \
@@ -70,6 +71,7 @@ typedef struct _input_surf_params
   INT memory_type;
   UINT index;
   UINT surface_usage_hint;
+  BOOL linear_shadow;
   VASurfaceID *surfaces;
   VASurfaceAttribExternalBuffers *memory_attibute;
 } input_surf_params;
@@ -102,6 +104,9 @@ struct object_surface
   INT cb_cr_width;
   INT cb_cr_height;
   INT cb_cr_pitch;
+  UINT generation;		/* bumped when a picture or put rewrites it */
+  struct _media_surface_shadow *shadow;
+  MEDIA_SURFACE_POOL_ENTRY *pool_entry;	/* owns bo, NULL for imported BOs */
 };
 struct gen7_surface_state
 {
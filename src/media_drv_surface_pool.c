@@ -0,0 +1,212 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "media_drv_util.h"
+#include "media_drv_surface_pool.h"
+
+#define MEDIA_SURFACE_POOL_PAGE_SIZE	4096
+
+static uint64_t
+media_surface_pool_now_ms (VOID)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* pages rounded up to MEDIA_SURFACE_POOL_CLASS_STEPS classes per octave */
+static ULONG
+media_surface_pool_class_size (ULONG size)
+{
+  ULONG pages = ALIGN (size, MEDIA_SURFACE_POOL_PAGE_SIZE) /
+    MEDIA_SURFACE_POOL_PAGE_SIZE;
+  ULONG step = 1;
+
+  while (step * MEDIA_SURFACE_POOL_CLASS_STEPS * 2 <= pages)
+    step <<= 1;
+  return ALIGN (pages, step) * MEDIA_SURFACE_POOL_PAGE_SIZE;
+}
+
+static VOID
+media_surface_pool_free_entry (MEDIA_SURFACE_POOL_ENTRY * entry)
+{
+  media_bo_unreference (entry->bo);
+  free (entry);
+}
+
+/* called with the mutex held */
+static VOID
+media_surface_pool_trim_locked (MEDIA_SURFACE_POOL * pool, uint64_t max_bytes,
+				UINT max_age_ms, uint64_t now)
+{
+  MEDIA_SURFACE_POOL_ENTRY *entry, **link = &pool->cached;
+  uint64_t kept = 0;
+
+  /* newest first, so whatever is over the byte limit is also the oldest */
+  while ((entry = *link) != NULL)
+    {
+      if (kept + entry->bo->size <= max_bytes &&
+	  now - entry->released_ms <= max_age_ms)
+	{
+	  kept += entry->bo->size;
+	  link = &entry->next;
+	  continue;
+	}
+      *link = entry->next;
+      pool->stats.cached_bytes -= entry->bo->size;
+      pool->stats.trimmed++;
+      media_surface_pool_free_entry (entry);
+    }
+}
+
+VOID
+media_surface_pool_init (MEDIA_SURFACE_POOL * pool, dri_bufmgr * bufmgr)
+{
+  memset (pool, 0, sizeof (*pool));
+  pool->bufmgr = bufmgr;
+  media_drv_mutex_init (&pool->mutex);
+}
+
+VOID
+media_surface_pool_destroy (MEDIA_SURFACE_POOL * pool)
+{
+  media_surface_pool_trim (pool, 0, 0);
+  media_drv_mutex_destroy (&pool->mutex);
+}
+
+/*
+ * Returns a cached BO matching the key, or a new one. A cached BO holds
+ * whatever its last surface left in it: surfaces are written by a decode,
+ * an encode or a put before anything reads them, and clearing would cost
+ * a CPU pass over the whole BO on every hit. BOs the GPU is still busy
+ * with stay cached. The BO belongs to the entry until
+ * media_surface_pool_release().
+ */
+MEDIA_SURFACE_POOL_ENTRY *
+media_surface_pool_acquire (MEDIA_SURFACE_POOL * pool, UINT tiling,
+			    UINT pitch, UINT height, ULONG size)
+{
+  MEDIA_SURFACE_POOL_ENTRY *entry, **link;
+  ULONG class_size = media_surface_pool_class_size (size);
+  ULONG bo_pitch;
+
+  media_drv_mutex_lock (&pool->mutex);
+  pool->stats.acquires++;
+  for (link = &pool->cached; (entry = *link) != NULL; link = &entry->next)
+    {
+      if (entry->tiling == tiling && entry->pitch == pitch &&
+	  entry->height >= height && entry->class_size == class_size &&
+	  entry->bo->size >= size && !media_bo_busy (entry->bo))
+	{
+	  *link = entry->next;
+	  entry->next = NULL;
+	  pool->stats.cached_bytes -= entry->bo->size;
+	  pool->stats.hits++;
+	  media_drv_mutex_unlock (&pool->mutex);
+	  return entry;
+	}
+    }
+  pool->stats.misses++;
+  media_drv_mutex_unlock (&pool->mutex);
+
+  entry = (MEDIA_SURFACE_POOL_ENTRY *) calloc (1, sizeof (*entry));
+  if (entry == NULL)
+    return NULL;
+  entry->pool = pool;
+  entry->tiling = tiling;
+  entry->pitch = pitch;
+  entry->height = height;
+  entry->class_size = class_size;
+  if (tiling != I915_TILING_NONE)
+    {
+      entry->bo = media_bo_alloc_tiled (pool->bufmgr, "vaapi surface",
+					pitch, height, 1, &entry->tiling,
+					&bo_pitch, 0);
+      entry->pitch = bo_pitch;
+    }
+  else
+    entry->bo = media_bo_alloc (pool->bufmgr, "vaapi surface", size, 0x1000);
+  if (entry->bo == NULL)
+    {
+      free (entry);
+      return NULL;
+    }
+  return entry;
+}
+
+/*
+ * reuse is FALSE while someone else may still hold the BO. BOs that left
+ * the process through flink or prime are never reused either. Releases
+ * are where the cache grows, so that is where it is trimmed.
+ */
+VOID
+media_surface_pool_release (MEDIA_SURFACE_POOL_ENTRY * entry, BOOL reuse)
+{
+  MEDIA_SURFACE_POOL *pool = entry->pool;
+
+  media_drv_mutex_lock (&pool->mutex);
+  pool->stats.releases++;
+  if (!reuse || !media_bo_is_reusable (entry->bo))
+    {
+      pool->stats.rejected++;
+      media_drv_mutex_unlock (&pool->mutex);
+      media_surface_pool_free_entry (entry);
+      return;
+    }
+  entry->released_ms = media_surface_pool_now_ms ();
+  entry->next = pool->cached;
+  pool->cached = entry;
+  pool->stats.cached_bytes += entry->bo->size;
+  if (pool->stats.cached_bytes > pool->stats.peak_cached_bytes)
+    pool->stats.peak_cached_bytes = pool->stats.cached_bytes;
+  media_surface_pool_trim_locked (pool, MEDIA_SURFACE_POOL_MAX_CACHED_SIZE,
+				  MEDIA_SURFACE_POOL_MAX_AGE_MS,
+				  entry->released_ms);
+  media_drv_mutex_unlock (&pool->mutex);
+}
+
+VOID
+media_surface_pool_trim (MEDIA_SURFACE_POOL * pool, uint64_t max_bytes,
+			 UINT max_age_ms)
+{
+  uint64_t now = media_surface_pool_now_ms ();
+
+  media_drv_mutex_lock (&pool->mutex);
+  media_surface_pool_trim_locked (pool, max_bytes, max_age_ms, now);
+  media_drv_mutex_unlock (&pool->mutex);
+}
+
+VOID
+media_surface_pool_get_stats (MEDIA_SURFACE_POOL * pool,
+			      MEDIA_SURFACE_POOL_STATS * stats)
+{
+  media_drv_mutex_lock (&pool->mutex);
+  *stats = pool->stats;
+  media_drv_mutex_unlock (&pool->mutex);
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _MEDIA__DRIVER_SURFACE_POOL_H
+#define _MEDIA__DRIVER_SURFACE_POOL_H
+#include "media_drv_defines.h"
+#include "media_drv_data.h"
+
+/*
+ * Cache of surface BOs. Destroyed surfaces leave their BO here, and a
+ * later surface with the same tiling and pitch, at least as many rows and
+ * the same size class takes it back as it is instead of allocating (and
+ * faulting in) a new one. Whenever a surface is released, cached BOs idle
+ * for more than MEDIA_SURFACE_POOL_MAX_AGE_MS are dropped, and so are the
+ * oldest ones beyond MEDIA_SURFACE_POOL_MAX_CACHED_SIZE.
+ */
+#define MEDIA_SURFACE_POOL_CLASS_STEPS		4	/* size classes per power of two */
+#define MEDIA_SURFACE_POOL_MAX_AGE_MS		10000
+#define MEDIA_SURFACE_POOL_MAX_CACHED_SIZE	(256 * 1024 * 1024)
+
+typedef struct _media_surface_pool MEDIA_SURFACE_POOL;
+
+typedef struct _media_surface_pool_entry
+{
+  struct _media_surface_pool_entry *next;
+  MEDIA_SURFACE_POOL *pool;
+  dri_bo *bo;
+  UINT tiling;
+  UINT pitch;
+  UINT height;			/* rows */
+  ULONG class_size;
+  uint64_t released_ms;
+} MEDIA_SURFACE_POOL_ENTRY;
+
+typedef struct _media_surface_pool_stats
+{
+  UINT acquires;
+  UINT hits;
+  UINT misses;
+  UINT releases;
+  UINT rejected;		/* exported BOs, never cached */
+  UINT trimmed;
+  uint64_t cached_bytes;
+  uint64_t peak_cached_bytes;
+} MEDIA_SURFACE_POOL_STATS;
+
+struct _media_surface_pool
+{
+  MEDIA_DRV_MUTEX mutex;
+  dri_bufmgr *bufmgr;
+  MEDIA_SURFACE_POOL_ENTRY *cached;	/* most recently released first */
+  MEDIA_SURFACE_POOL_STATS stats;
+};
+
+VOID media_surface_pool_init (MEDIA_SURFACE_POOL * pool, dri_bufmgr * bufmgr);
+VOID media_surface_pool_destroy (MEDIA_SURFACE_POOL * pool);
+MEDIA_SURFACE_POOL_ENTRY *media_surface_pool_acquire (MEDIA_SURFACE_POOL *
+						      pool, UINT tiling,
+						      UINT pitch, UINT height,
+						      ULONG size);
+VOID media_surface_pool_release (MEDIA_SURFACE_POOL_ENTRY * entry,
+				 BOOL reuse);
+VOID media_surface_pool_trim (MEDIA_SURFACE_POOL * pool, uint64_t max_bytes,
+			      UINT max_age_ms);
+VOID media_surface_pool_get_stats (MEDIA_SURFACE_POOL * pool,
+				   MEDIA_SURFACE_POOL_STATS * stats);
+#endif
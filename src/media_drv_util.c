@@ -26,6 +26,7 @@
  *
  */
 
+#include <stdarg.h>
 #include "media_drv_util.h"
 #include "media_drv_data.h"
 #include "media_drv_driver.h"
@@ -277,11 +278,11 @@ VOID
 media_drv_dump_bo_buf_to_file (CHAR * filename, dri_bo * bo)
 {
   FILE *fp;
-  dri_bo_map (bo, 1);
+  media_bo_map (bo, 1);
   fp = fopen (filename, "w+");
   fwrite (bo->virtual, bo->size, 1, fp);
   fclose (fp);
-  dri_bo_unmap (bo);
+  media_bo_unmap (bo);
 
 }
 
@@ -294,11 +295,11 @@ media_drv_dump_bo_buf_to_file_v2 (dri_bo * bo, UINT frame_num,
   CHAR filename[100];
   sprintf (filename, "%s%s%d_%s_%s%d_%s", "/tmp/otc_dump/", "Frame",
 	   frame_num, func_name, "Phase", phase, buf_name);
-  dri_bo_map (bo, 1);
+  media_bo_map (bo, 1);
   fp = fopen (filename, "w+");
   fwrite (bo->virtual, bo->size, 1, fp);
   fclose (fp);
-  dri_bo_unmap (bo);
+  media_bo_unmap (bo);
 
 }
 
@@ -309,6 +310,10 @@ static VAEncMiscParameterType media_drv_va_misc_types[] = {
   VAEncMiscParameterTypePrivate,
   VAEncMiscParameterTypeVP8HybridFrameUpdate,
   VAEncMiscParameterTypeVP8SegmentMapParams,
+  VAEncMiscParameterTypeVP8HybridLookahead,
+#if VA_CHECK_VERSION(0,40,0)
+  VAEncMiscParameterTypeTemporalLayerStructure,
+#endif
 };
 
 int media_drv_va_misc_type_to_index(VAEncMiscParameterType type)
@@ -330,3 +335,23 @@ VAEncMiscParameterType media_drv_index_to_va_misc_type(int index)
 
   return media_drv_va_misc_types[index];
 }
+
+VOID
+media_drv_log_info (VADriverContextP ctx, const CHAR * format, ...)
+{
+  va_list args;
+
+  va_start (args, format);
+#if VA_CHECK_VERSION(1,0,0)
+  if (ctx && ctx->info_callback)
+    {
+      CHAR tmp[1024];
+
+      vsnprintf (tmp, sizeof (tmp), format, args);
+      ctx->info_callback (ctx, tmp);
+    }
+  else
+#endif
+    vfprintf (stderr, format, args);
+  va_end (args);
+}
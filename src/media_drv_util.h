@@ -56,6 +56,8 @@ media_drv_memcpy (VOID * dst_ptr, size_t dst_len, const VOID * src_ptr,
 
 VOID media_drv_mutex_init (MEDIA_DRV_MUTEX * mutex);
 VOID media_drv_mutex_destroy (MEDIA_DRV_MUTEX * mutex);
+VOID media_drv_mutex_lock (MEDIA_DRV_MUTEX * mutex);
+VOID media_drv_mutex_unlock (MEDIA_DRV_MUTEX * mutex);
 INT media_get_sampling_from_fourcc (UINT fourcc);
 VOID *media_drv_alloc_memory ( /*size_t */ UINT size);
 VOID media_drv_free_memory (VOID * ptr);
@@ -68,4 +70,16 @@ VOID media_drv_memset (VOID * dest_ptr, size_t len);
 int media_drv_va_misc_type_to_index(VAEncMiscParameterType type);
 VAEncMiscParameterType media_drv_index_to_va_misc_type(int index);
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Informational messages go to libva's info callback when there is one. */
+VOID media_drv_log_info (VADriverContextP ctx, const CHAR * format, ...)
+  __attribute__ ((format (printf, 2, 3)));
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -9,7 +9,7 @@ extern "C"
 
 #include <drm.h>
 #include <i915_drm.h>
-#include <intel_bufmgr.h>
+#include "media_drv_bufmgr.h"
 
 
 #ifdef __cplusplus
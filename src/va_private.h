@@ -29,6 +29,7 @@
 #define VAEncMbDataBufferType	        -4
 #define VAEncMiscParameterTypeVP8HybridFrameUpdate      -3
 #define VAEncMiscParameterTypeVP8SegmentMapParams	-4
+#define VAEncMiscParameterTypeVP8HybridLookahead	-5
 
 typedef struct _VAEncMbDataLayout
 {
@@ -53,6 +54,18 @@ typedef struct _VAEncMiscParameterVP8HybridFrameUpdate
     unsigned char   ref_q_index[3];
 } VAEncMiscParameterVP8HybridFrameUpdate;
 
+#define VP8_HYBRID_LOOKAHEAD_MAX_DEPTH	40
+
+/* Source surfaces following the current one in encode order. They must
+ * hold their final content when the current frame is rendered. Only the
+ * frame it is rendered with sees the list. */
+typedef struct _VAEncMiscParameterVP8HybridLookahead
+{
+    unsigned int    depth;          /* 1 to 40, current frame included */
+    unsigned int    num_surfaces;
+    unsigned int    surfaces[VP8_HYBRID_LOOKAHEAD_MAX_DEPTH - 1];
+} VAEncMiscParameterVP8HybridLookahead;
+
 typedef struct _VAEncMiscParameterVP8FrameRate
 {
     unsigned int    frame_rate;
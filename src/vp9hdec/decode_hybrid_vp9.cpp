@@ -63,6 +63,7 @@
 
 #include "media_drv_driver.h"
 #include "media_drv_surface.h"
+#include "media_drv_bufmgr.h"
 #include <fcntl.h>
 #include "cmrt_api.h"
 #include "decode_hybrid_vp9.h"
@@ -257,7 +258,7 @@ int16_t g_FiltersBilinear[16][8] =
  */
 static VAStatus
 INTEL_HYBRID_VP9_ALLOCATE_MDF_2DUP_BUFFER_UINT8(
-	VADriverContextP ctx,
+	PINTEL_HYBRID_VP9_BUFFER_POOL pPool,
 	CmDevice    *pMdfDevice,
 	INTEL_DECODE_HYBRID_VP9_MDF_2D_BUFFER *pMdfBuffer2D,
 	int Width, int Height)
@@ -302,7 +303,7 @@ allocation_fail:
 
 static
 VAStatus INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT8(
-	VADriverContextP ctx,
+	PINTEL_HYBRID_VP9_BUFFER_POOL pPool,
 	CmDevice    *pMdfDevice,
 	INTEL_DECODE_HYBRID_VP9_MDF_1D_BUFFER *pMdfBuffer1D,
 	int dwBufferSize)
@@ -324,7 +325,7 @@ VAStatus INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT8(
 
 static VAStatus
 INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT16(
-	VADriverContextP ctx,
+	PINTEL_HYBRID_VP9_BUFFER_POOL pPool,
 	CmDevice    *pMdfDevice,
 	INTEL_DECODE_HYBRID_VP9_MDF_1D_BUFFER *pMdfBuffer1D,
 	int dwBufferSize)
@@ -346,7 +347,7 @@ INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT16(
 
 static VAStatus
 INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT64(
-	VADriverContextP ctx,
+	PINTEL_HYBRID_VP9_BUFFER_POOL pPool,
 	CmDevice    *pMdfDevice,
 	INTEL_DECODE_HYBRID_VP9_MDF_1D_BUFFER *pMdfBuffer1D,
 	int dwBufferSize)
@@ -439,15 +440,15 @@ void GetCmOsResourceFor2DBuffer(
 
 static VAStatus
 INTEL_HYBRID_VP9_ALLOCATE_MDF_2DUP_BUFFER_UINT8(
-	VADriverContextP ctx,
+	PINTEL_HYBRID_VP9_BUFFER_POOL pPool,
 	CmDevice    *pMdfDevice,
 	INTEL_DECODE_HYBRID_VP9_MDF_2D_BUFFER *pMdfBuffer2D,
 	int Width, int Height)
 {
     int buf_size;
     INT cm_status;
-    MEDIA_DRV_CONTEXT *drv_ctx = (MEDIA_DRV_CONTEXT *) (ctx->pDriverData);
     CmOsResource target_resource;
+    PINTEL_HYBRID_VP9_POOL_BLOCK pBlock;
 
     pMdfBuffer2D->dwWidth           = Width;
     pMdfBuffer2D->dwHeight          = Height;
@@ -463,29 +464,12 @@ INTEL_HYBRID_VP9_ALLOCATE_MDF_2DUP_BUFFER_UINT8(
 
     buf_size = ALIGN(pMdfBuffer2D->dwSize, INTEL_HYBRID_VP9_PAGE_SIZE);
 
-      
-    pMdfBuffer2D->bo  = dri_bo_alloc(drv_ctx->drv_data.bufmgr, 
-                                        "Buffer", 
-                                        buf_size, 4096);
-
-   {
-        struct drm_i915_gem_caching bo_cache;
-
-        memset(&bo_cache, 0, sizeof(bo_cache));
-        bo_cache.handle = pMdfBuffer2D->bo->handle;
-        bo_cache.caching = I915_CACHING_CACHED;
-
-        drmIoctl(drv_ctx->drv_data.fd, DRM_IOCTL_I915_GEM_SET_CACHING, &bo_cache);
-    }
+    /* The bo is cached, mapped and CPU coherent; see the buffer pool */
+    pBlock = Intel_HybridVp9_BufferPool_Acquire(pPool, INTEL_HYBRID_VP9_POOL_BO, buf_size);
+    if (pBlock == NULL)
+	goto allocation_fail;
 
-    /* Disable reuse this bo which set I915_CACHING_CACHED on CHV/BSW without LLC.
-     * Otherwise if it was reused and GTT mapped later, SIGBUS when access the GTT virtual addr.
-     * Because drm:i915 "i915_gem_fault", the page fault handler for GTT map pages,
-     * checks it as incoherent for accessing snoopable pages through the GTT on GPU without LLC.
-     */
-    if (IS_CHERRYVIEW(drv_ctx->drv_data.device_id)) {
-        drm_intel_bo_disable_reuse(pMdfBuffer2D->bo);
-    }
+    pMdfBuffer2D->bo = pBlock->bo;
 
     memset(&target_resource, 0, sizeof(target_resource));
 
@@ -495,14 +479,14 @@ INTEL_HYBRID_VP9_ALLOCATE_MDF_2DUP_BUFFER_UINT8(
 	pMdfBuffer2D->pMdfSurface);
 
     if (cm_status != CM_SUCCESS) {
-	dri_bo_unreference(pMdfBuffer2D->bo);
+	Intel_HybridVp9_BufferPool_Release(pPool, pBlock);
 	pMdfBuffer2D->bo = NULL;
 
 	goto allocation_fail;
     }
-    dri_bo_map(pMdfBuffer2D->bo, 1);
-    memset(pMdfBuffer2D->bo->virt, 0, buf_size);
-    pMdfBuffer2D->pBuffer = pMdfBuffer2D->bo->virt;
+    memset(pBlock->pBuffer, 0, buf_size);
+    pMdfBuffer2D->pBuffer = pBlock->pBuffer;
+    pMdfBuffer2D->pPoolBlock = pBlock;
     pMdfBuffer2D->bo_mapped = 1;
 
     return VA_STATUS_SUCCESS;
@@ -533,60 +517,46 @@ void GetCmOsResourceFor1DBuffer(
 }
 
 static
-VAStatus INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT8(
-	VADriverContextP ctx,
+VAStatus INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER(
+	PINTEL_HYBRID_VP9_BUFFER_POOL pPool,
 	CmDevice    *pMdfDevice,
 	INTEL_DECODE_HYBRID_VP9_MDF_1D_BUFFER *pMdfBuffer1D,
-	int dwBufferSize)
+	int dwBufferSize,
+	int bpp)
 {
-    MEDIA_DRV_CONTEXT *drv_ctx = (MEDIA_DRV_CONTEXT *) (ctx->pDriverData);
     int buf_size, cm_status;
     CmOsResource target_resource;
+    PINTEL_HYBRID_VP9_POOL_BLOCK pBlock;
 
-    buf_size = ALIGN((dwBufferSize) * sizeof(uint8_t), INTEL_HYBRID_VP9_PAGE_SIZE);
+    buf_size = ALIGN((dwBufferSize) * bpp, INTEL_HYBRID_VP9_PAGE_SIZE);
 
     pMdfBuffer1D->dwSize    = (dwBufferSize);
+    pMdfBuffer1D->bo_mapped = 0;
+    pMdfBuffer1D->pBuffer   = NULL;
 
-    pMdfBuffer1D->bo  = dri_bo_alloc(drv_ctx->drv_data.bufmgr, 
-                                        "Buffer", 
-                                        buf_size, 64);
-   {
-        struct drm_i915_gem_caching bo_cache;
-
-        memset(&bo_cache, 0, sizeof(bo_cache));
-        bo_cache.handle = pMdfBuffer1D->bo->handle;
-        bo_cache.caching = I915_CACHING_CACHED;
-
-        drmIoctl(drv_ctx->drv_data.fd, DRM_IOCTL_I915_GEM_SET_CACHING, &bo_cache);
-    }
-
-    /* Disable reuse this bo which set I915_CACHING_CACHED on CHV/BSW without LLC.
-     * Otherwise if it was reused and GTT mapped later, SIGBUS when access the GTT virtual addr.
-     */
-    if (IS_CHERRYVIEW(drv_ctx->drv_data.device_id)) {
-        drm_intel_bo_disable_reuse(pMdfBuffer1D->bo);
-    }
+    /* The bo is cached, mapped and CPU coherent; see the buffer pool */
+    pBlock = Intel_HybridVp9_BufferPool_Acquire(pPool, INTEL_HYBRID_VP9_POOL_BO, buf_size);
+    if (pBlock == NULL)
+	goto allocation_fail;
 
-    pMdfBuffer1D->bo_mapped = 0;
-    
-    pMdfBuffer1D->pu8Buffer = NULL;
+    pMdfBuffer1D->bo = pBlock->bo;
 
     memset(&target_resource, 0, sizeof(target_resource));
-    GetCmOsResourceFor1DBuffer(&target_resource, pMdfBuffer1D, pMdfBuffer1D->bo, 1);
-        
+    GetCmOsResourceFor1DBuffer(&target_resource, pMdfBuffer1D, pMdfBuffer1D->bo, bpp);
+
     cm_status = pMdfDevice->CreateBuffer(&target_resource,pMdfBuffer1D->pMdfBuffer);
 
     if (cm_status != CM_SUCCESS) {
-	dri_bo_unreference(pMdfBuffer1D->bo);
+	Intel_HybridVp9_BufferPool_Release(pPool, pBlock);
 	pMdfBuffer1D->bo = NULL;
 	goto allocation_fail;
     }
-  
-    dri_bo_map(pMdfBuffer1D->bo, 1);
-    memset(pMdfBuffer1D->bo->virt, 0, buf_size);
-    pMdfBuffer1D->pu8Buffer = (UINT8 *)pMdfBuffer1D->bo->virt;
+
+    memset(pBlock->pBuffer, 0, buf_size);
+    pMdfBuffer1D->pBuffer = pBlock->pBuffer;
+    pMdfBuffer1D->pPoolBlock = pBlock;
     pMdfBuffer1D->bo_mapped = 1;
-    
+
     return VA_STATUS_SUCCESS;
 
 allocation_fail:
@@ -594,126 +564,33 @@ allocation_fail:
 }
 
 static VAStatus
-INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT16(
-	VADriverContextP ctx,
+INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT8(
+	PINTEL_HYBRID_VP9_BUFFER_POOL pPool,
 	CmDevice    *pMdfDevice,
 	INTEL_DECODE_HYBRID_VP9_MDF_1D_BUFFER *pMdfBuffer1D,
 	int dwBufferSize)
 {
-    MEDIA_DRV_CONTEXT *drv_ctx = (MEDIA_DRV_CONTEXT *) (ctx->pDriverData);
-    int buf_size, cm_status;
-    CmOsResource target_resource;
-
-    buf_size = ALIGN((dwBufferSize) * sizeof(uint16_t), INTEL_HYBRID_VP9_PAGE_SIZE);
-
-    pMdfBuffer1D->dwSize    = (dwBufferSize);
-    pMdfBuffer1D->bo  = dri_bo_alloc(drv_ctx->drv_data.bufmgr, 
-                                        "Buffer", 
-                                        buf_size, 64);
-   {
-        struct drm_i915_gem_caching bo_cache;
-
-        memset(&bo_cache, 0, sizeof(bo_cache));
-        bo_cache.handle = pMdfBuffer1D->bo->handle;
-        bo_cache.caching = I915_CACHING_CACHED;
-
-        drmIoctl(drv_ctx->drv_data.fd, DRM_IOCTL_I915_GEM_SET_CACHING, &bo_cache);
-    }
-
-    /* Disable reuse this bo which set I915_CACHING_CACHED on CHV/BSW without LLC.
-     * Otherwise if it was reused and GTT mapped later, SIGBUS when access the GTT virtual addr.
-     */
-    if (IS_CHERRYVIEW(drv_ctx->drv_data.device_id)) {
-        drm_intel_bo_disable_reuse(pMdfBuffer1D->bo);
-    }
-
-    pMdfBuffer1D->bo_mapped = 0;
-    
-    pMdfBuffer1D->pu16Buffer = NULL;
-
-    memset(&target_resource, 0, sizeof(target_resource));
-
-    memset(&target_resource, 0, sizeof(target_resource));
-    GetCmOsResourceFor1DBuffer(&target_resource, pMdfBuffer1D, pMdfBuffer1D->bo, 2);
-    cm_status = pMdfDevice->CreateBuffer(&target_resource,pMdfBuffer1D->pMdfBuffer);
-
-    if (cm_status != CM_SUCCESS) {
-	dri_bo_unreference(pMdfBuffer1D->bo);
-	pMdfBuffer1D->bo = NULL;
-	goto allocation_fail;
-    }
-  
-    dri_bo_map(pMdfBuffer1D->bo, 1);
-    memset(pMdfBuffer1D->bo->virt, 0, buf_size);
-    pMdfBuffer1D->pu16Buffer = (UINT16 *) pMdfBuffer1D->bo->virt;
-    pMdfBuffer1D->bo_mapped = 1;
-
-    return VA_STATUS_SUCCESS;
+    return INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER(pPool, pMdfDevice, pMdfBuffer1D, dwBufferSize, sizeof(uint8_t));
+}
 
-allocation_fail:
-    return VA_STATUS_ERROR_ALLOCATION_FAILED;
-    
+static VAStatus
+INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT16(
+	PINTEL_HYBRID_VP9_BUFFER_POOL pPool,
+	CmDevice    *pMdfDevice,
+	INTEL_DECODE_HYBRID_VP9_MDF_1D_BUFFER *pMdfBuffer1D,
+	int dwBufferSize)
+{
+    return INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER(pPool, pMdfDevice, pMdfBuffer1D, dwBufferSize, sizeof(uint16_t));
 }
 
 static VAStatus
 INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT64(
-	VADriverContextP ctx,
+	PINTEL_HYBRID_VP9_BUFFER_POOL pPool,
 	CmDevice    *pMdfDevice,
 	INTEL_DECODE_HYBRID_VP9_MDF_1D_BUFFER *pMdfBuffer1D,
 	int dwBufferSize)
 {
-    int buf_size, cm_status;
-    MEDIA_DRV_CONTEXT *drv_ctx = (MEDIA_DRV_CONTEXT *) (ctx->pDriverData);
-    CmOsResource target_resource;
-
-    buf_size = ALIGN((dwBufferSize) * sizeof(uint64_t), INTEL_HYBRID_VP9_PAGE_SIZE);
-
-    pMdfBuffer1D->dwSize    = (dwBufferSize);
-
-    pMdfBuffer1D->bo  = dri_bo_alloc(drv_ctx->drv_data.bufmgr, 
-                                        "Buffer", 
-                                        buf_size, 64);
-   {
-        struct drm_i915_gem_caching bo_cache;
-
-        memset(&bo_cache, 0, sizeof(bo_cache));
-        bo_cache.handle = pMdfBuffer1D->bo->handle;
-        bo_cache.caching = I915_CACHING_CACHED;
-
-        drmIoctl(drv_ctx->drv_data.fd, DRM_IOCTL_I915_GEM_SET_CACHING, &bo_cache);
-    }
-
-    /* Disable reuse this bo which set I915_CACHING_CACHED on CHV/BSW without LLC.
-     * Otherwise if it was reused and GTT mapped later, SIGBUS when access the GTT virtual addr.
-     */
-    if (IS_CHERRYVIEW(drv_ctx->drv_data.device_id)) {
-        drm_intel_bo_disable_reuse(pMdfBuffer1D->bo);
-    }
-
-    pMdfBuffer1D->bo_mapped = 0;
-    
-    pMdfBuffer1D->pu64Buffer = NULL;
-
-    memset(&target_resource, 0, sizeof(target_resource));
-    GetCmOsResourceFor1DBuffer(&target_resource, pMdfBuffer1D, pMdfBuffer1D->bo, 8);
-
-    cm_status = pMdfDevice->CreateBuffer(&target_resource,pMdfBuffer1D->pMdfBuffer);
-
-    if (cm_status != CM_SUCCESS) {
-	dri_bo_unreference(pMdfBuffer1D->bo);
-	pMdfBuffer1D->bo = NULL;
-	goto allocation_fail;
-    }
-  
-    dri_bo_map(pMdfBuffer1D->bo, 1);
-    memset(pMdfBuffer1D->bo->virt, 0, buf_size);
-    pMdfBuffer1D->pu64Buffer = (UINT64 *)pMdfBuffer1D->bo->virt;
-    pMdfBuffer1D->bo_mapped = 1;
-
-    return VA_STATUS_SUCCESS;
-
-allocation_fail:
-    return VA_STATUS_ERROR_ALLOCATION_FAILED;
+    return INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER(pPool, pMdfDevice, pMdfBuffer1D, dwBufferSize, sizeof(uint64_t));
 }
 
 
@@ -739,11 +616,12 @@ static void INTEL_HYBRID_VP9_DESTROY_MDF_2DUP_BUFFER(
 	pMdfBuffer2D->pMdfSurface = NULL;
     }
 
-    if (pMdfBuffer2D->bo)
+    /* the bo goes back to the pool which keeps it mapped */
+    if (pMdfBuffer2D->pPoolBlock)
     {
-        if (pMdfBuffer2D->pBuffer)
-		dri_bo_unmap(pMdfBuffer2D->bo);
-	dri_bo_unreference(pMdfBuffer2D->bo);
+	Intel_HybridVp9_BufferPool_Release(pMdfBuffer2D->pPoolBlock->pPool, pMdfBuffer2D->pPoolBlock);
+	pMdfBuffer2D->pPoolBlock = NULL;
+	pMdfBuffer2D->bo_mapped = 0;
 	pMdfBuffer2D->pBuffer = NULL;
 	pMdfBuffer2D->bo = NULL;
     }
@@ -761,19 +639,173 @@ static void INTEL_HYBRID_VP9_DESTROY_MDF_1D_BUFFER(
 	pMdfBuffer1D->pMdfBuffer = NULL;
     }
 
-    if (pMdfBuffer1D->bo)
+    /* the bo goes back to the pool which keeps it mapped */
+    if (pMdfBuffer1D->pPoolBlock)
     {
-        if (pMdfBuffer1D->bo_mapped)
-		dri_bo_unmap(pMdfBuffer1D->bo);
+	Intel_HybridVp9_BufferPool_Release(pMdfBuffer1D->pPoolBlock->pPool, pMdfBuffer1D->pPoolBlock);
+	pMdfBuffer1D->pPoolBlock = NULL;
 	pMdfBuffer1D->bo_mapped = 0;
 	pMdfBuffer1D->pBuffer = NULL;
-	dri_bo_unreference(pMdfBuffer1D->bo);
 	pMdfBuffer1D->bo = NULL;
     }
 }
 
 #endif
 
+static VAStatus INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+	PINTEL_HYBRID_VP9_BUFFER_POOL pPool,
+	CmDevice    *pMdfDevice,
+	INTEL_DECODE_HYBRID_VP9_MDF_1D_BUFFER *pMdfBuffer1D,
+	PINTEL_HYBRID_VP9_MDF_FRAME_LAYOUT pLayout,
+	INTEL_HYBRID_VP9_MDF_PLANE ePlane)
+{
+    PINTEL_HYBRID_VP9_MDF_PLANE_LAYOUT pPlane = &pLayout->Plane[ePlane];
+
+    switch (pPlane->dwBpp)
+    {
+    case sizeof(uint64_t):
+	return INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT64(pPool, pMdfDevice, pMdfBuffer1D, pPlane->dwWidth);
+    case sizeof(uint16_t):
+	return INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT16(pPool, pMdfDevice, pMdfBuffer1D, pPlane->dwWidth);
+    default:
+	return INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT8(pPool, pMdfDevice, pMdfBuffer1D, pPlane->dwWidth);
+    }
+}
+
+static VAStatus INTEL_HYBRID_VP9_ALLOCATE_MDF_2D_PLANE(
+	PINTEL_HYBRID_VP9_BUFFER_POOL pPool,
+	CmDevice    *pMdfDevice,
+	INTEL_DECODE_HYBRID_VP9_MDF_2D_BUFFER *pMdfBuffer2D,
+	PINTEL_HYBRID_VP9_MDF_FRAME_LAYOUT pLayout,
+	INTEL_HYBRID_VP9_MDF_PLANE ePlane)
+{
+    PINTEL_HYBRID_VP9_MDF_PLANE_LAYOUT pPlane = &pLayout->Plane[ePlane];
+
+    return INTEL_HYBRID_VP9_ALLOCATE_MDF_2DUP_BUFFER_UINT8(pPool, pMdfDevice, pMdfBuffer2D,
+	pPlane->dwWidth, pPlane->dwHeight);
+}
+
+static VOID Intel_HybridVp9Decode_MdfHost_SetPlane(
+    PINTEL_HYBRID_VP9_MDF_FRAME_LAYOUT       pLayout,
+    INTEL_HYBRID_VP9_MDF_PLANE               ePlane,
+    uint32_t                                 dwWidth,
+    uint32_t                                 dwHeight,
+    uint32_t                                 dwBpp)
+{
+    PINTEL_HYBRID_VP9_MDF_PLANE_LAYOUT pPlane = &pLayout->Plane[ePlane];
+
+    pPlane->dwWidth     = dwWidth;
+    pPlane->dwHeight    = dwHeight;
+    pPlane->dwBpp       = dwBpp;
+    pPlane->dwSize      = ALIGN(dwWidth * dwHeight * dwBpp, INTEL_HYBRID_VP9_PAGE_SIZE);
+}
+
+// Compute the size of every per-frame host plane from the frame dimensions.
+// Each plane is still its own pool bo, since a CmOsResource can't describe
+// a range inside a bo; dwTotalSize is what the planes of one slot add up to.
+VAStatus Intel_HybridVp9Decode_MdfHost_PlanLayout(
+    PINTEL_DECODE_HYBRID_VP9_MDF_FRAME   pMdfDecodeFrame,
+    CmDevice                                *pMdfDevice,
+    PINTEL_HYBRID_VP9_MDF_FRAME_LAYOUT      pLayout)
+{
+    PINTEL_HYBRID_VP9_MDF_PLANE_LAYOUT   pPlane;
+    DWORD                                   dwAlignedWidth;
+    DWORD                                   dwAlignedHeight;
+    DWORD                                   dwWidthB8;
+    DWORD                                   dwHeightB8;
+    DWORD                                   dwTotalSize;
+    UINT                                    uiPitch, uiSize;
+    unsigned int                            i;
+    VAStatus                                eStatus = VA_STATUS_SUCCESS;
+
+    dwAlignedWidth   = pMdfDecodeFrame->dwAlignedWidth;
+    dwAlignedHeight  = pMdfDecodeFrame->dwAlignedHeight;
+    dwWidthB8        = pMdfDecodeFrame->dwWidthB8;
+    dwHeightB8       = pMdfDecodeFrame->dwHeightB8;
+
+    // 1D planes (element count, bytes per element)
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_COEFF_Y,
+        dwAlignedWidth * dwAlignedHeight, 1, sizeof(uint16_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_COEFF_U,
+        (dwAlignedWidth >> 1) * (dwAlignedHeight >> 1), 1, sizeof(uint16_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_COEFF_V,
+        (dwAlignedWidth >> 1) * (dwAlignedHeight >> 1), 1, sizeof(uint16_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_TX_SIZE_Y,
+        (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3), 1, sizeof(uint8_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_TX_SIZE_UV,
+        (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3), 1, sizeof(uint8_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_COEFF_STATUS_Y,
+        (dwAlignedWidth >> 2) * (dwAlignedHeight >> 2), 1, sizeof(uint8_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_COEFF_STATUS_UV,
+        (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3), 1, sizeof(uint8_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_QP_Y,
+        (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3) * 2, 1, sizeof(uint16_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_QP_UV,
+        (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3) * 2, 1, sizeof(uint16_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_TX_TYPE,
+        (dwAlignedWidth >> 2) * (dwAlignedHeight >> 2), 1, sizeof(uint8_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_TILE_INDEX,
+        (dwAlignedWidth >> 5) + 2, 1, sizeof(uint8_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_PRED_MODE_Y,
+        (dwAlignedWidth >> 2) * (dwAlignedHeight >> 2), 1, sizeof(uint8_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_PRED_MODE_UV,
+        (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3), 1, sizeof(uint8_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_BLOCK_SIZE,
+        (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3), 1, sizeof(uint8_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_REF_FRAME,
+        (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3), 1, sizeof(uint16_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_FILTER_TYPE,
+        (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3), 1, sizeof(uint8_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_MV,
+        (dwAlignedWidth >> 2) * (dwAlignedHeight >> 2), 1, sizeof(uint64_t));
+
+    // 2D planes (uint8 surfaces, size comes from the surface pitch below)
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_VERT_EDGE_Y,
+        (dwWidthB8 + 1) >> 1, dwHeightB8, sizeof(uint8_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_VERT_EDGE_UV,
+        (dwWidthB8 + 3) >> 2, (dwHeightB8 + 1) >> 1, sizeof(uint8_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_HORZ_EDGE_Y,
+        (dwWidthB8 + 1) >> 1, dwHeightB8, sizeof(uint8_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_HORZ_EDGE_UV,
+        (dwWidthB8 + 3) >> 2, (dwHeightB8 + 1) >> 1, sizeof(uint8_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_FILTER_LEVEL,
+        dwWidthB8, dwHeightB8, sizeof(uint8_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_THRESHOLD,
+        4, 64, sizeof(uint8_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_DEBLOCK_MASK_Y,
+        dwAlignedWidth >> 2, dwAlignedHeight >> 3, sizeof(uint8_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_DEBLOCK_MASK_UV,
+        dwAlignedWidth >> 3, dwAlignedHeight >> 4, sizeof(uint8_t));
+
+    for (i = INTEL_HYBRID_VP9_MDF_PLANE_VERT_EDGE_Y; i <= INTEL_HYBRID_VP9_MDF_PLANE_DEBLOCK_MASK_UV; i++)
+    {
+        pPlane = &pLayout->Plane[i];
+        INTEL_DECODE_CHK_MDF_STATUS(pMdfDevice->GetSurface2DInfo(
+            pPlane->dwWidth,
+            pPlane->dwHeight,
+            VA_CM_FMT_A8,
+            uiPitch,
+            uiSize));
+        pPlane->dwSize = ALIGN(uiSize, INTEL_HYBRID_VP9_PAGE_SIZE);
+    }
+
+    // previous frame planes mirror the current frame ones
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_PREV_REF_FRAME,
+        (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3), 1, sizeof(uint16_t));
+    Intel_HybridVp9Decode_MdfHost_SetPlane(pLayout, INTEL_HYBRID_VP9_MDF_PLANE_PREV_MV,
+        (dwAlignedWidth >> 2) * (dwAlignedHeight >> 2), 1, sizeof(uint64_t));
+
+    dwTotalSize = 0;
+    for (i = 0; i < INTEL_HYBRID_VP9_MDF_PLANE_NUMBER; i++)
+    {
+        dwTotalSize += pLayout->Plane[i].dwSize;
+    }
+    pLayout->dwTotalSize = dwTotalSize;
+
+finish:
+    return eStatus;
+}
+
 void Intel_HybridVp9Decode_ConstructCombinedFilters(PVOID pCombinedFilters)
 {
     int8_t  *pi8CombinedFilters;
@@ -988,9 +1020,12 @@ VAStatus Intel_HybridVp9Decode_MdfHost_SetKernelThreadCount (
     pMdfDecodeEngine->pKernelInter->SetThreadCount(
         pMdfDecodeFrame->dwWidthB16 * pMdfDecodeFrame->dwHeightB16);
 
-    // Inter Prediction Scaling kernels
-    pMdfDecodeEngine->pKernelInterScaling->SetThreadCount(
-        pMdfDecodeFrame->dwWidthB16 * pMdfDecodeFrame->dwHeightB16);
+    // Inter Prediction Scaling kernels, created on first use
+    if (pMdfDecodeEngine->pKernelInterScaling)
+    {
+        pMdfDecodeEngine->pKernelInterScaling->SetThreadCount(
+            pMdfDecodeFrame->dwWidthB16 * pMdfDecodeFrame->dwHeightB16);
+    }
 
     // Deblocking kernels
     pMdfDecodeEngine->pKernelDeblock[INTEL_HYBRID_VP9_MDF_YUV_PLANE_Y][INTEL_HYBRID_VP9_MDF_DEBLOCK_LEFT_TOP]->SetThreadCount(
@@ -1221,36 +1256,6 @@ VAStatus Intel_HybridVp9Decode_MdfHost_CreateKernels (
         pProgram, MDF_KERNEL_FUNCTION_REF_Y_ONLY_PADDING,
         pMdfDecodeEngine->pKernelRefPaddingYOnly));
 
-    // Inter Prediction with Scaling kernel
-    if (IS_HASWELL(drv_ctx->drv_data.device_id))
-    {
-        INTEL_DECODE_CHK_MDF_STATUS(pMdfDevice->LoadProgram(
-            &Vp9InterPredScaling_g75, Vp9InterPredScaling_g75_size, pProgram, "-nojitter"));
-    }
-    else if (IS_BROADWELL(drv_ctx->drv_data.device_id))
-    {
-        INTEL_DECODE_CHK_MDF_STATUS(pMdfDevice->LoadProgram(
-            &Vp9InterPredScaling_g8, Vp9InterPredScaling_g8_size, pProgram, "-nojitter"));
-    }
-    else if (IS_CHERRYVIEW(drv_ctx->drv_data.device_id))
-    {
-        INTEL_DECODE_CHK_MDF_STATUS(pMdfDevice->LoadProgram(
-            &Vp9InterPredScaling_g8lp, Vp9InterPredScaling_g8lp_size, pProgram, "-nojitter"));
-    }
-    else if (IS_SKYLAKE(drv_ctx->drv_data.device_id))
-    {
-        INTEL_DECODE_CHK_MDF_STATUS(pMdfDevice->LoadProgram(
-            &Vp9InterPredScaling_g9, Vp9InterPredScaling_g9_size, pProgram, "-nojitter"));
-    }
-    else
-    {
-        return VA_STATUS_ERROR_INVALID_PARAMETER;
-    }
-
-    INTEL_DECODE_CHK_MDF_STATUS(pMdfDevice->CreateKernel(
-        pProgram, MDF_KERNEL_FUNCTION_INTER_PRED_SCALING,
-        pMdfDecodeEngine->pKernelInterScaling));
-
     // Deblocking kernels
     if (IS_HASWELL(drv_ctx->drv_data.device_id))
     {
@@ -1503,6 +1508,98 @@ finish:
     return eStatus;
 }
 
+/*
+ * Every stage enqueues tasks holding exactly one kernel, so one task per
+ * kernel is built on first use and re-enqueued afterwards. Enqueue takes
+ * a snapshot of the kernel arguments, so the arguments set for a frame
+ * do not leak into the previous one.
+ */
+static INT Intel_HybridVp9Decode_MdfHost_GetTask (
+    PINTEL_DECODE_HYBRID_VP9_MDF_ENGINE  pMdfDecodeEngine,
+    CmKernel                            *pKernel,
+    CmTask                             *&pTask)
+{
+    DWORD   i;
+    INT     cm_status;
+
+    for (i = 0; i < pMdfDecodeEngine->dwNumTasks; i++)
+    {
+        if (pMdfDecodeEngine->TaskCache[i].pKernel == pKernel)
+        {
+            pTask = pMdfDecodeEngine->TaskCache[i].pTask;
+            return CM_SUCCESS;
+        }
+    }
+
+    if (pMdfDecodeEngine->dwNumTasks >= INTEL_HYBRID_VP9_MDF_MAX_TASKS)
+    {
+        return CM_FAILURE;
+    }
+
+    cm_status = pMdfDecodeEngine->pMdfDevice->CreateTask(pTask);
+    if (cm_status != CM_SUCCESS)
+    {
+        return cm_status;
+    }
+    cm_status = pTask->AddKernel(pKernel);
+    if (cm_status != CM_SUCCESS)
+    {
+        pMdfDecodeEngine->pMdfDevice->DestroyTask(pTask);
+        return cm_status;
+    }
+
+    pMdfDecodeEngine->TaskCache[i].pKernel = pKernel;
+    pMdfDecodeEngine->TaskCache[i].pTask   = pTask;
+    pMdfDecodeEngine->dwNumTasks++;
+    pMdfDecodeEngine->dwTaskCreates++;
+
+    return CM_SUCCESS;
+}
+
+static VOID Intel_HybridVp9Decode_MdfHost_DestroyTasks (
+    PINTEL_DECODE_HYBRID_VP9_MDF_ENGINE  pMdfDecodeEngine,
+    CmDevice                                *pMdfDevice)
+{
+    DWORD   i;
+
+    for (i = 0; i < pMdfDecodeEngine->dwNumTasks; i++)
+    {
+        pMdfDevice->DestroyTask(pMdfDecodeEngine->TaskCache[i].pTask);
+        pMdfDecodeEngine->TaskCache[i].pTask   = NULL;
+        pMdfDecodeEngine->TaskCache[i].pKernel = NULL;
+    }
+    pMdfDecodeEngine->dwNumTasks = 0;
+}
+
+/*
+ * Waits for the tasks of every frame slot and for the last padding task.
+ * Enqueued tasks refer to the thread spaces, which must outlive them.
+ */
+static VOID Intel_HybridVp9Decode_MdfHost_WaitIdle (
+    PINTEL_DECODE_HYBRID_VP9_MDF_ENGINE  pMdfDecodeEngine)
+{
+    PINTEL_DECODE_HYBRID_VP9_MDF_FRAME   pMdfDecodeFrame;
+    DWORD   i;
+
+    for (i = 0; pMdfDecodeEngine->pMdfDecodeFrame && i < pMdfDecodeEngine->dwMdfBufferSize; i++)
+    {
+        pMdfDecodeFrame = pMdfDecodeEngine->pMdfDecodeFrame + i;
+        if (pMdfDecodeFrame->pMdfEvent)
+        {
+            pMdfDecodeFrame->pMdfEvent->WaitForTaskFinished(5000);
+            pMdfDecodeFrame->pMdfQueue->DestroyEvent(pMdfDecodeFrame->pMdfEvent);
+            pMdfDecodeFrame->pMdfEvent = NULL;
+        }
+    }
+
+    if (pMdfDecodeEngine->pPaddingEvent)
+    {
+        pMdfDecodeEngine->pPaddingEvent->WaitForTaskFinished(5000);
+        pMdfDecodeEngine->pPaddingQueue->DestroyEvent(pMdfDecodeEngine->pPaddingEvent);
+        pMdfDecodeEngine->pPaddingEvent = NULL;
+    }
+}
+
 VAStatus Intel_HybridVp9Decode_MdfHost_DestroyThreadSpaces (
     PINTEL_DECODE_HYBRID_VP9_MDF_ENGINE  pMdfDecodeEngine,
     CmDevice                                *pMdfDevice)
@@ -1510,6 +1607,8 @@ VAStatus Intel_HybridVp9Decode_MdfHost_DestroyThreadSpaces (
     INT         i, j;
     VAStatus  eStatus = VA_STATUS_SUCCESS;
 
+    Intel_HybridVp9Decode_MdfHost_WaitIdle(pMdfDecodeEngine);
+
     for (i = INTEL_HYBRID_VP9_MDF_YUV_PLANE_Y; i < INTEL_HYBRID_VP9_MDF_YUV_PLANE_NUMBER; i++)
     {
         INTEL_DECODE_HYBRID_VP9_DESTROY_THREADSPACE(pMdfDecodeEngine->pThreadSpaceIqIt[i]);
@@ -1522,6 +1621,8 @@ VAStatus Intel_HybridVp9Decode_MdfHost_DestroyThreadSpaces (
     }
 
     INTEL_DECODE_HYBRID_VP9_DESTROY_THREADSPACE(pMdfDecodeEngine->pThreadSpaceInter);
+    INTEL_DECODE_HYBRID_VP9_DESTROY_THREADSPACE(pMdfDecodeEngine->pThreadSpacePadding);
+    pMdfDecodeEngine->dwPaddingThreadCount = 0;
 
     return eStatus;
 }
@@ -1536,16 +1637,20 @@ VAStatus Intel_HybridVp9Decode_MdfHost_Allocate(
     PINTEL_DECODE_HYBRID_VP9_MDF_2D_BUFFER   pMdfBuffer2D;
     DWORD                                       dwAlignedWidth;     // SB64 aligned Width
     DWORD                                       dwAlignedHeight;    // SB64 aligned Height
-    DWORD                                       dwWidthB8;
-    DWORD                                       dwHeightB8;
+    PINTEL_HYBRID_VP9_MDF_FRAME_LAYOUT       pLayout;
     VAStatus                                  eStatus = VA_STATUS_SUCCESS;
-    VADriverContextP		ctx = (VADriverContextP) (pHybridVp9State->driver_context);
+    PINTEL_HYBRID_VP9_BUFFER_POOL             pPool = &pHybridVp9State->MdfDecodeEngine.BufferPool;
 
     pMdfDecodeBuffer = &pMdfDecodeFrame->MdfDecodeBuffer;
     dwAlignedWidth   = pMdfDecodeFrame->dwAlignedWidth;
     dwAlignedHeight  = pMdfDecodeFrame->dwAlignedHeight;
-    dwWidthB8        = pMdfDecodeFrame->dwWidthB8;
-    dwHeightB8       = pMdfDecodeFrame->dwHeightB8;
+    pLayout          = &pMdfDecodeFrame->Layout;
+
+    eStatus = Intel_HybridVp9Decode_MdfHost_PlanLayout(pMdfDecodeFrame, pMdfDevice, pLayout);
+    if (eStatus != VA_STATUS_SUCCESS)
+    {
+        goto finish;
+    }
 
     // Create surfaces of current frame
     if (dwFlags & VP9_HYBRID_DECODE_CURRENT_FRAME)
@@ -1591,203 +1696,222 @@ VAStatus Intel_HybridVp9Decode_MdfHost_Allocate(
         }
         
         // transform coefficient - Luma (1D uint16 per pixel; Packed in Z-order)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT16(
-            ctx,
-            pMdfDevice, 
-            &pMdfDecodeBuffer->TransformCoeff[INTEL_HYBRID_VP9_MDF_YUV_PLANE_Y], 
-            dwAlignedWidth * dwAlignedHeight);
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+            pPool,
+            pMdfDevice,
+            &pMdfDecodeBuffer->TransformCoeff[INTEL_HYBRID_VP9_MDF_YUV_PLANE_Y],
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_COEFF_Y);
 
         // transform coefficient - Chroma Cb (1D uint16 per pixel; Packed in Z-order)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT16(
-            ctx,
-            pMdfDevice, 
-            &pMdfDecodeBuffer->TransformCoeff[INTEL_HYBRID_VP9_MDF_YUV_PLANE_U], 
-            (dwAlignedWidth >> 1) * (dwAlignedHeight >> 1));
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+            pPool,
+            pMdfDevice,
+            &pMdfDecodeBuffer->TransformCoeff[INTEL_HYBRID_VP9_MDF_YUV_PLANE_U],
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_COEFF_U);
 
         // transform coefficient - Chroma Cr (1D uint16 per pixel; Packed in Z-order)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT16(
-            ctx,
-            pMdfDevice, 
-            &pMdfDecodeBuffer->TransformCoeff[INTEL_HYBRID_VP9_MDF_YUV_PLANE_V], 
-            (dwAlignedWidth >> 1) * (dwAlignedHeight >> 1));
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+            pPool,
+            pMdfDevice,
+            &pMdfDecodeBuffer->TransformCoeff[INTEL_HYBRID_VP9_MDF_YUV_PLANE_V],
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_COEFF_V);
 
         // transform size - Luma (uint8 per 8x8; Packed in Z-order)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT8(
-            ctx,
-            pMdfDevice, 
-            &pMdfDecodeBuffer->TransformSize[INTEL_HYBRID_VP9_MDF_YUV_PLANE_Y], 
-            (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3));
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+            pPool,
+            pMdfDevice,
+            &pMdfDecodeBuffer->TransformSize[INTEL_HYBRID_VP9_MDF_YUV_PLANE_Y],
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_TX_SIZE_Y);
 
         // transform size - Chroma (uint8 per 4x4; Packed in Z-order, shared U & V)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT8(
-            ctx,
-            pMdfDevice, 
-            &pMdfDecodeBuffer->TransformSize[INTEL_HYBRID_VP9_MDF_YUV_PLANE_UV], 
-            (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3));
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+            pPool,
+            pMdfDevice,
+            &pMdfDecodeBuffer->TransformSize[INTEL_HYBRID_VP9_MDF_YUV_PLANE_UV],
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_TX_SIZE_UV);
 
         // coefficient status flag - Luma (uint8 per 4x4; Packed in Z-order)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT8(
-            ctx,
-            pMdfDevice, 
-            &pMdfDecodeBuffer->CoeffStatus[INTEL_HYBRID_VP9_MDF_YUV_PLANE_Y], 
-            (dwAlignedWidth >> 2) * (dwAlignedHeight >> 2));
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+            pPool,
+            pMdfDevice,
+            &pMdfDecodeBuffer->CoeffStatus[INTEL_HYBRID_VP9_MDF_YUV_PLANE_Y],
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_COEFF_STATUS_Y);
 
         // coefficient status flag - Chroma (uint8 per 4x4; Packed in Z-order, packed U & V)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT8(
-            ctx,
-            pMdfDevice, 
-            &pMdfDecodeBuffer->CoeffStatus[INTEL_HYBRID_VP9_MDF_YUV_PLANE_UV], 
-            (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3));
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+            pPool,
+            pMdfDevice,
+            &pMdfDecodeBuffer->CoeffStatus[INTEL_HYBRID_VP9_MDF_YUV_PLANE_UV],
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_COEFF_STATUS_UV);
 
         // QP - Luma (2 * uint16 per 8x8; Packed in Z-order)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT16(
-            ctx,
-            pMdfDevice, 
-            &pMdfDecodeBuffer->QP[INTEL_HYBRID_VP9_MDF_YUV_PLANE_Y], 
-            (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3) * 2);
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+            pPool,
+            pMdfDevice,
+            &pMdfDecodeBuffer->QP[INTEL_HYBRID_VP9_MDF_YUV_PLANE_Y],
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_QP_Y);
 
         // QP - Chroma (2 * uint16 per 4x4; Packed in Z-order, packed U & V)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT16(
-            ctx,
-            pMdfDevice, 
-            &pMdfDecodeBuffer->QP[INTEL_HYBRID_VP9_MDF_YUV_PLANE_UV], 
-            (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3) * 2);
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+            pPool,
+            pMdfDevice,
+            &pMdfDecodeBuffer->QP[INTEL_HYBRID_VP9_MDF_YUV_PLANE_UV],
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_QP_UV);
 
         // transform type - Luma (uint8 per 4x4; Packed in Z-order)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT8(
-            ctx,
-            pMdfDevice, 
-            &pMdfDecodeBuffer->TransformType, 
-            (dwAlignedWidth >> 2) * (dwAlignedHeight >> 2));
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+            pPool,
+            pMdfDevice,
+            &pMdfDecodeBuffer->TransformType,
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_TX_TYPE);
 
         // Tile Index (uint8 per 32-pixel width column + 2; shared Y, U & V)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT8(
-            ctx,
-            pMdfDevice, 
-            &pMdfDecodeBuffer->TileIndex, 
-            (dwAlignedWidth >> 5) + 2);
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+            pPool,
+            pMdfDevice,
+            &pMdfDecodeBuffer->TileIndex,
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_TILE_INDEX);
 
         // Prediction mode flags - Luma (uint8 per 4x4; Packed in Z-order)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT8(
-            ctx,
-            pMdfDevice, 
-            &pMdfDecodeBuffer->PredictionMode[INTEL_HYBRID_VP9_MDF_YUV_PLANE_Y], 
-            (dwAlignedWidth >> 2) * (dwAlignedHeight >> 2));
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+            pPool,
+            pMdfDevice,
+            &pMdfDecodeBuffer->PredictionMode[INTEL_HYBRID_VP9_MDF_YUV_PLANE_Y],
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_PRED_MODE_Y);
 
         // Prediction mode flags - Chroma (uint8 per 4x4; Packed in Z-order)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT8(
-            ctx,
-            pMdfDevice, 
-            &pMdfDecodeBuffer->PredictionMode[INTEL_HYBRID_VP9_MDF_YUV_PLANE_UV], 
-            (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3));
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+            pPool,
+            pMdfDevice,
+            &pMdfDecodeBuffer->PredictionMode[INTEL_HYBRID_VP9_MDF_YUV_PLANE_UV],
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_PRED_MODE_UV);
 
         // Block size (uint8 per 8x8; Packed in Z-order, shared Y, U & V)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT8(
-            ctx,
-            pMdfDevice, 
-            &pMdfDecodeBuffer->BlockSize, 
-            (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3));
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+            pPool,
+            pMdfDevice,
+            &pMdfDecodeBuffer->BlockSize,
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_BLOCK_SIZE);
 
         // Reference frame index (uint16 per 8x8; Packed in Z-order, shared Y, U & V)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT16(
-            ctx,
-            pMdfDevice, 
-            &pMdfDecodeBuffer->ReferenceFrame, 
-            (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3));
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+            pPool,
+            pMdfDevice,
+            &pMdfDecodeBuffer->ReferenceFrame,
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_REF_FRAME);
 
         // Interpolation filter type (uint8 per 8x8; Packed in Z-order, shared Y, U & V)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT8(
-            ctx,
-            pMdfDevice, 
-            &pMdfDecodeBuffer->FilterType, 
-            (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3));
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+            pPool,
+            pMdfDevice,
+            &pMdfDecodeBuffer->FilterType,
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_FILTER_TYPE);
 
         // Motion vector (uint8 per 4x4; Packed in Z-order, shared Y, U & V)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT64(
-            ctx,
-            pMdfDevice, 
-            &pMdfDecodeBuffer->MotionVector, 
-            (dwAlignedWidth >> 2) * (dwAlignedHeight >> 2));
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+            pPool,
+            pMdfDevice,
+            &pMdfDecodeBuffer->MotionVector,
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_MV);
 
         // Vertical edge mask - Luma (2D; uint8 per 16x8)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_2DUP_BUFFER_UINT8(
-            ctx,
-            pMdfDevice, 
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_2D_PLANE(
+            pPool,
+            pMdfDevice,
             &pMdfDecodeBuffer->VerticalEdgeMask[INTEL_HYBRID_VP9_MDF_YUV_PLANE_Y],
-            (dwWidthB8 + 1) >> 1,
-            dwHeightB8);
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_VERT_EDGE_Y);
 
         // Vertical edge mask - Chroma (2D; uint8 per 16x8)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_2DUP_BUFFER_UINT8(
-            ctx,
-            pMdfDevice, 
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_2D_PLANE(
+            pPool,
+            pMdfDevice,
             &pMdfDecodeBuffer->VerticalEdgeMask[INTEL_HYBRID_VP9_MDF_YUV_PLANE_UV],
-            (dwWidthB8 + 3) >> 2,
-            (dwHeightB8 + 1) >> 1);
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_VERT_EDGE_UV);
 
         // Horizontal edge mask - Luma (2D; uint8 per 16x8)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_2DUP_BUFFER_UINT8(
-            ctx,
-            pMdfDevice, 
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_2D_PLANE(
+            pPool,
+            pMdfDevice,
             &pMdfDecodeBuffer->HorizontalEdgeMask[INTEL_HYBRID_VP9_MDF_YUV_PLANE_Y],
-            (dwWidthB8 + 1) >> 1,
-            dwHeightB8);
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_HORZ_EDGE_Y);
 
         // Horizontal edge mask - Chroma (2D; uint8 per 16x8)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_2DUP_BUFFER_UINT8(
-            ctx,
-            pMdfDevice, 
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_2D_PLANE(
+            pPool,
+            pMdfDevice,
             &pMdfDecodeBuffer->HorizontalEdgeMask[INTEL_HYBRID_VP9_MDF_YUV_PLANE_UV],
-            (dwWidthB8 + 3) >> 2,
-            (dwHeightB8 + 1) >> 1);
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_HORZ_EDGE_UV);
 
         // filter level (2D; uint8 per 8x8, shared Y, U & V)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_2DUP_BUFFER_UINT8(
-            ctx,
-            pMdfDevice, 
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_2D_PLANE(
+            pPool,
+            pMdfDevice,
             &pMdfDecodeBuffer->FilterLevel,
-            dwWidthB8,
-            dwHeightB8);
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_FILTER_LEVEL);
 
         // threshold (2D; 4 * 64, shared Y, U & V)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_2DUP_BUFFER_UINT8(
-            ctx,
-            pMdfDevice, 
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_2D_PLANE(
+            pPool,
+            pMdfDevice,
             &pMdfDecodeBuffer->Threshold,
-            4,
-            64);
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_THRESHOLD);
 
         // On-the-fly mask buffers for deblocking
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_2DUP_BUFFER_UINT8(
-            ctx,
-            pMdfDevice, 
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_2D_PLANE(
+            pPool,
+            pMdfDevice,
             &pMdfDecodeBuffer->DeblockOntheFlyThreadMask[INTEL_HYBRID_VP9_MDF_YUV_PLANE_Y],
-            dwAlignedWidth >> 2,
-            dwAlignedHeight >> 3);
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_2DUP_BUFFER_UINT8(
-            ctx,
-            pMdfDevice, 
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_DEBLOCK_MASK_Y);
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_2D_PLANE(
+            pPool,
+            pMdfDevice,
             &pMdfDecodeBuffer->DeblockOntheFlyThreadMask[INTEL_HYBRID_VP9_MDF_YUV_PLANE_UV],
-            dwAlignedWidth >> 3,
-            dwAlignedHeight >> 4);
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_DEBLOCK_MASK_UV);
     }
 
     // Create previous frame/motion_vector for current frame
     if (dwFlags & VP9_HYBRID_DECODE_PREVIOUS_FRAME)
     {
         // Previous frame reference frame index (uint16 per 8x8; Packed in Z-order, shared Y, U & V)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT16(
-            ctx,
-            pMdfDevice, 
-            &pMdfDecodeBuffer->PrevReferenceFrame, 
-            (dwAlignedWidth >> 3) * (dwAlignedHeight >> 3));
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+            pPool,
+            pMdfDevice,
+            &pMdfDecodeBuffer->PrevReferenceFrame,
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_PREV_REF_FRAME);
 
         // Previous frame motion vector (uint8 per 4x4; Packed in Z-order, shared Y, U & V)
-        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT64(
-            ctx,
-            pMdfDevice, 
-            &pMdfDecodeBuffer->PrevMotionVector, 
-            (dwAlignedWidth >> 2) * (dwAlignedHeight >> 2));
+        INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+            pPool,
+            pMdfDevice,
+            &pMdfDecodeBuffer->PrevMotionVector,
+            pLayout,
+            INTEL_HYBRID_VP9_MDF_PLANE_PREV_MV);
     }
 
 finish:
@@ -1849,7 +1973,10 @@ VAStatus Intel_HybridVp9Decode_MdfHost_Create (
     VAStatus                              eStatus = VA_STATUS_SUCCESS;
     int				          cm_status;
 
+    PINTEL_HYBRID_VP9_BUFFER_POOL           pPool;
+
     pMdfDecodeEngine    = &pHybridVp9State->MdfDecodeEngine;
+    pPool               = &pMdfDecodeEngine->BufferPool;
 
     pMdfDecodeEngine->dwMdfBufferSize           = pHybridVp9State->dwMdfBufferSize;
 
@@ -1880,6 +2007,10 @@ VAStatus Intel_HybridVp9Decode_MdfHost_Create (
 	driver_context.device_rev = drv_ctx->drv_data.revision;
         driver_context.shared_bufmgr = 1;
 
+	/* the CM runtime talks to the kernel through the bufmgr it is given */
+	if (media_bufmgr_is_mock() && !getenv(MEDIA_BUFMGR_MOCK_CMRT_ENV))
+		return VA_STATUS_ERROR_UNIMPLEMENTED;
+
 	cm_version = CM_4_0;
         cm_status = CreateCmDevice(pMdfDevice, cm_version, &driver_context, CM_DEVICE_CREATE_OPTION_FOR_VP9);
         if (cm_status != CM_SUCCESS) {
@@ -1907,7 +2038,7 @@ VAStatus Intel_HybridVp9Decode_MdfHost_Create (
     }
 
     // Allocate and initialize combined filter coefficient buffer
-    INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT16(ctx, pMdfDevice, &pMdfDecodeEngine->CombinedFilters, VP9_HYBRID_DECODE_COMBINED_FILETER_SIZE);
+    INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT16(pPool, pMdfDevice, &pMdfDecodeEngine->CombinedFilters, VP9_HYBRID_DECODE_COMBINED_FILETER_SIZE);
     Intel_HybridVp9Decode_ConstructCombinedFilters(pMdfDecodeEngine->CombinedFilters.pBuffer);
 
 finish:
@@ -1992,7 +2123,8 @@ void Intel_HybridVp9Decode_MdfHost_Destroy (
     
     pMdfDevice = pMdfDecodeEngine->pMdfDevice;
 
-    for (i = 0; i < pMdfDecodeEngine->dwMdfBufferSize; i++)
+    // the frames are only allocated once the CM device has been created
+    for (i = 0; pMdfDecodeEngine->pMdfDecodeFrame && i < pMdfDecodeEngine->dwMdfBufferSize; i++)
     {
         pMdfDecodeFrame = pMdfDecodeEngine->pMdfDecodeFrame + i;
         Intel_HybridVp9Decode_MdfHost_Release(pMdfDecodeFrame, pMdfDevice, VP9_HYBRID_DECODE_ALL_FRAMES);
@@ -2001,9 +2133,27 @@ void Intel_HybridVp9Decode_MdfHost_Destroy (
     Intel_HybridVp9Decode_MdfHost_ReleaseResidue(pMdfDecodeEngine, pMdfDevice);
 
     Intel_HybridVp9Decode_MdfHost_DestroyThreadSpaces(pMdfDecodeEngine, pMdfDevice);
+    Intel_HybridVp9Decode_MdfHost_DestroyTasks(pMdfDecodeEngine, pMdfDevice);
 
     INTEL_HYBRID_VP9_DESTROY_MDF_1D_BUFFER(pMdfDevice, &pMdfDecodeEngine->CombinedFilters);
 
+    if (g_intel_debug_option_flags & VA_INTEL_HYBRID_POOL_STATS)
+    {
+        INTEL_HYBRID_VP9_POOL_STATS PoolStats;
+
+        Intel_HybridVp9_BufferPool_GetStats(&pMdfDecodeEngine->BufferPool, &PoolStats);
+        media_drv_log_info(pMdfDecodeEngine->BufferPool.ctx,
+            "vp9 buffer pool: acquires=%u hits=%u misses=%u reallocations=%u releases=%u trimmed=%u peak=%llu cache limit=%llu\n",
+            PoolStats.dwAcquires, PoolStats.dwHits, PoolStats.dwMisses, PoolStats.dwReallocations,
+            PoolStats.dwReleases, PoolStats.dwTrimmed, (unsigned long long)PoolStats.PeakBytes,
+            (unsigned long long)PoolStats.MaxCachedBytes);
+        media_drv_log_info(pMdfDecodeEngine->BufferPool.ctx, "vp9 mdf objects: tasks=%u padding_thread_spaces=%u\n",
+            pMdfDecodeEngine->dwTaskCreates, pMdfDecodeEngine->dwThreadSpaceCreates);
+    }
+
+    // all host buffers have been returned; drop the cached bos while the device is alive
+    Intel_HybridVp9_BufferPool_Destroy(&pMdfDecodeEngine->BufferPool);
+
     for (i = 0; i < INTEL_NUM_UNCOMPRESSED_SURFACE_VP9; i++)
     {
         pFrame = &pMdfDecodeEngine->FrameList[i];
@@ -2047,16 +2197,17 @@ VAStatus Intel_HybridVp9Decode_MdfHost_ReallocateMvBuffer (
     CmDevice                                *pMdfDevice)
 {
     VAStatus eStatus = VA_STATUS_SUCCESS;
-    VADriverContextP		ctx = (VADriverContextP) (pHybridVp9State->driver_context);
+    PINTEL_HYBRID_VP9_BUFFER_POOL pPool = &pHybridVp9State->MdfDecodeEngine.BufferPool;
 
     INTEL_HYBRID_VP9_DESTROY_MDF_1D_BUFFER(pMdfDevice, &pMdfDecodeFrame->MdfDecodeBuffer.MotionVector);
 
     // Motion vector (uint8 per 4x4; Packed in Z-order, shared Y, U & V)
-    INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT64(
-        ctx,
+    eStatus = INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+        pPool,
         pMdfDevice,
         &pMdfDecodeFrame->MdfDecodeBuffer.MotionVector,
-        (pMdfDecodeFrame->dwAlignedWidth >> 2) * (pMdfDecodeFrame->dwAlignedHeight >> 2));
+        &pMdfDecodeFrame->Layout,
+        INTEL_HYBRID_VP9_MDF_PLANE_MV);
 
     return eStatus;
 }
@@ -2068,16 +2219,17 @@ VAStatus Intel_HybridVp9Decode_MdfHost_ReallocateRefFrameIndexBuffer(
     CmDevice                                *pMdfDevice)
 {
     VAStatus eStatus = VA_STATUS_SUCCESS;
-    VADriverContextP		ctx = (VADriverContextP) (pHybridVp9State->driver_context);
+    PINTEL_HYBRID_VP9_BUFFER_POOL pPool = &pHybridVp9State->MdfDecodeEngine.BufferPool;
 
     INTEL_HYBRID_VP9_DESTROY_MDF_1D_BUFFER(pMdfDevice, &pMdfDecodeFrame->MdfDecodeBuffer.ReferenceFrame);
 
     // Reference frame index (uint16 per 8x8; Packed in Z-order, shared Y, U & V)
-    INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_BUFFER_UINT16(
-	ctx,
-	pMdfDevice,
+    eStatus = INTEL_HYBRID_VP9_ALLOCATE_MDF_1D_PLANE(
+        pPool,
+        pMdfDevice,
         &pMdfDecodeFrame->MdfDecodeBuffer.ReferenceFrame,
-        (pMdfDecodeFrame->dwAlignedWidth >> 3) * (pMdfDecodeFrame->dwAlignedHeight >> 3));
+        &pMdfDecodeFrame->Layout,
+        INTEL_HYBRID_VP9_MDF_PLANE_REF_FRAME);
 
     return eStatus;
 }
@@ -2291,9 +2443,6 @@ VAStatus Intel_HybridVp9Decode_MdfHost_PadFrame (
     uint32_t                                       dwWidth, dwHeight;
     VAStatus                                  eStatus = VA_STATUS_SUCCESS;
     struct object_surface *surface;
-    CmEvent *pMdfEvent;
-
-    pMdfEvent = CM_NO_EVENT;
 
     surface = SURFACE(ucFrameIndex); 
 
@@ -2318,7 +2467,6 @@ VAStatus Intel_HybridVp9Decode_MdfHost_PadFrame (
     {
         CmKernel        *pKernel;
         CmTask          *pTask;
-        CmThreadSpace   *pThreadSpace;
         SurfaceIndex    *pSurfaceIndex = NULL;
         uint32_t           dwThreadCount;
         uint32_t           dwLastDwOffset, dwWidthMod4Minus1;
@@ -2336,25 +2484,41 @@ VAStatus Intel_HybridVp9Decode_MdfHost_PadFrame (
         pKernel->SetKernelArg(1, sizeof(DWORD), &dwLastDwOffset);
         pKernel->SetKernelArg(2, sizeof(DWORD), &dwWidthMod4Minus1);
 
-        // Create thread space
-        INTEL_DECODE_CHK_MDF_STATUS(pMdfDecodeEngine->pMdfDevice->CreateThreadSpace(
-            1, 
-            dwThreadCount, 
-            pThreadSpace));
+        // Thread space is kept until a frame of another height is padded
+        if (pMdfDecodeEngine->dwPaddingThreadCount != dwThreadCount)
+        {
+            if (pMdfDecodeEngine->pThreadSpacePadding)
+            {
+                // the references of one frame may differ in height
+                Intel_HybridVp9Decode_MdfHost_WaitIdle(pMdfDecodeEngine);
+                pMdfDecodeEngine->pMdfDevice->DestroyThreadSpace(pMdfDecodeEngine->pThreadSpacePadding);
+                pMdfDecodeEngine->pThreadSpacePadding  = NULL;
+                pMdfDecodeEngine->dwPaddingThreadCount = 0;
+            }
+            INTEL_DECODE_CHK_MDF_STATUS(pMdfDecodeEngine->pMdfDevice->CreateThreadSpace(
+                1, 
+                dwThreadCount, 
+                pMdfDecodeEngine->pThreadSpacePadding));
+            pMdfDecodeEngine->dwPaddingThreadCount = dwThreadCount;
+            pMdfDecodeEngine->dwThreadSpaceCreates++;
+        }
+
+        INTEL_DECODE_CHK_MDF_STATUS(Intel_HybridVp9Decode_MdfHost_GetTask(
+            pMdfDecodeEngine, pKernel, pTask));
 
-        // Create MDF Tasks and add kernels
-        INTEL_DECODE_CHK_MDF_STATUS(pMdfDecodeEngine->pMdfDevice->CreateTask(pTask));
-        INTEL_DECODE_CHK_MDF_STATUS(pTask->AddKernel(pKernel));
+        // an earlier padding task is covered by the new event or by its frame's one
+        if (pMdfDecodeEngine->pPaddingEvent)
+        {
+            pMdfDecodeEngine->pPaddingQueue->DestroyEvent(pMdfDecodeEngine->pPaddingEvent);
+            pMdfDecodeEngine->pPaddingEvent = NULL;
+        }
 
         // enqueue tasks
         INTEL_DECODE_CHK_MDF_STATUS(pMdfDecodeFrame->pMdfQueue->Enqueue(
             pTask, 
-            pMdfEvent,
-            pThreadSpace));
-
-        // destroy MDF tasks
-        pMdfDecodeEngine->pMdfDevice->DestroyTask(pTask);
-        pMdfDecodeEngine->pMdfDevice->DestroyThreadSpace(pThreadSpace);
+            pMdfDecodeEngine->pPaddingEvent,
+            pMdfDecodeEngine->pThreadSpacePadding));
+        pMdfDecodeEngine->pPaddingQueue = pMdfDecodeFrame->pMdfQueue;
 
         pFrameResource->bHasPadding = TRUE;
     }
@@ -2464,7 +2628,7 @@ VOID Intel_HybridVp9Decode_MdfHost_SetScaleFactors(
 }
 
 VAStatus Intel_HybridVp9Decode_MdfHost_ZeroFillThreadInfo(
-    CmDevice        *pMdfDevice,
+    PINTEL_DECODE_HYBRID_VP9_MDF_ENGINE  pMdfDecodeEngine,
     CmKernel        *pKernel,
     CmQueue         *pMdfQueue, 
     CmThreadSpace   *pThreadSpaceZeroFill,
@@ -2477,9 +2641,8 @@ VAStatus Intel_HybridVp9Decode_MdfHost_ZeroFillThreadInfo(
     pMdfEvent = CM_NO_EVENT;
     pKernel->SetKernelArg(0, sizeof(SurfaceIndex), pSurfaceIndexThreadInfo);
 
-    // Create MDF Tasks and add kernels
-    INTEL_DECODE_CHK_MDF_STATUS(pMdfDevice->CreateTask(pTask));
-    INTEL_DECODE_CHK_MDF_STATUS(pTask->AddKernel(pKernel));
+    INTEL_DECODE_CHK_MDF_STATUS(Intel_HybridVp9Decode_MdfHost_GetTask(
+        pMdfDecodeEngine, pKernel, pTask));
 
     // enqueue tasks
     INTEL_DECODE_CHK_MDF_STATUS(pMdfQueue->Enqueue(
@@ -2487,8 +2650,56 @@ VAStatus Intel_HybridVp9Decode_MdfHost_ZeroFillThreadInfo(
         pMdfEvent,
         pThreadSpaceZeroFill));
 
-    // destroy MDF tasks
-    pMdfDevice->DestroyTask(pTask);
+finish:
+    return eStatus;
+}
+
+/*
+ * The scaling inter prediction program is only needed once a reference
+ * frame differs in size from the frame being decoded, so it is loaded on
+ * first use instead of for every decode context.
+ */
+static VAStatus Intel_HybridVp9Decode_MdfHost_CreateScalingKernel (
+    VADriverContextP ctx,
+    PINTEL_DECODE_HYBRID_VP9_MDF_ENGINE  pMdfDecodeEngine,
+    PINTEL_DECODE_HYBRID_VP9_MDF_FRAME   pMdfDecodeFrame)
+{
+    MEDIA_DRV_CONTEXT *drv_ctx = (MEDIA_DRV_CONTEXT *) (ctx->pDriverData);
+    CmDevice    *pMdfDevice = pMdfDecodeEngine->pMdfDevice;
+    CmProgram   *pProgram;
+    VAStatus  eStatus = VA_STATUS_SUCCESS;
+
+    if (IS_HASWELL(drv_ctx->drv_data.device_id))
+    {
+        INTEL_DECODE_CHK_MDF_STATUS(pMdfDevice->LoadProgram(
+            &Vp9InterPredScaling_g75, Vp9InterPredScaling_g75_size, pProgram, "-nojitter"));
+    }
+    else if (IS_BROADWELL(drv_ctx->drv_data.device_id))
+    {
+        INTEL_DECODE_CHK_MDF_STATUS(pMdfDevice->LoadProgram(
+            &Vp9InterPredScaling_g8, Vp9InterPredScaling_g8_size, pProgram, "-nojitter"));
+    }
+    else if (IS_CHERRYVIEW(drv_ctx->drv_data.device_id))
+    {
+        INTEL_DECODE_CHK_MDF_STATUS(pMdfDevice->LoadProgram(
+            &Vp9InterPredScaling_g8lp, Vp9InterPredScaling_g8lp_size, pProgram, "-nojitter"));
+    }
+    else if (IS_SKYLAKE(drv_ctx->drv_data.device_id))
+    {
+        INTEL_DECODE_CHK_MDF_STATUS(pMdfDevice->LoadProgram(
+            &Vp9InterPredScaling_g9, Vp9InterPredScaling_g9_size, pProgram, "-nojitter"));
+    }
+    else
+    {
+        return VA_STATUS_ERROR_INVALID_PARAMETER;
+    }
+
+    INTEL_DECODE_CHK_MDF_STATUS(pMdfDevice->CreateKernel(
+        pProgram, MDF_KERNEL_FUNCTION_INTER_PRED_SCALING,
+        pMdfDecodeEngine->pKernelInterScaling));
+
+    pMdfDecodeEngine->pKernelInterScaling->SetThreadCount(
+        pMdfDecodeFrame->dwWidthB16 * pMdfDecodeFrame->dwHeightB16);
 
 finish:
     return eStatus;
@@ -2583,9 +2794,8 @@ VAStatus Intel_HybridVp9Decode_MdfHost_Execute (
         pKernel->SetKernelArg(uiArgIndex++, sizeof(UINT16), &pMdfDecodeFrame->dwWidth);        
         pKernel->SetKernelArg(uiArgIndex++, sizeof(UINT16), &pMdfDecodeFrame->dwHeight);    
 
-        // Create MDF Tasks and add kernels
-        INTEL_DECODE_CHK_MDF_STATUS(pMdfDecodeEngine->pMdfDevice->CreateTask(pMdfDecodeEngine->pTaskIqIt[i]));
-        INTEL_DECODE_CHK_MDF_STATUS(pMdfDecodeEngine->pTaskIqIt[i]->AddKernel(pKernel));
+        INTEL_DECODE_CHK_MDF_STATUS(Intel_HybridVp9Decode_MdfHost_GetTask(
+            pMdfDecodeEngine, pKernel, pMdfDecodeEngine->pTaskIqIt[i]));
 
         /* Enqueue will reset pCmNoEvent to NULL. Set to CM_NO_EVENT here in each Enqueue iteration,
          * otherwise new CmEvent will be allocated for each iteration leading to large number of
@@ -2598,9 +2808,6 @@ VAStatus Intel_HybridVp9Decode_MdfHost_Execute (
             pMdfDecodeEngine->pTaskIqIt[i],
             pCmNoEvent,
             pMdfDecodeEngine->pThreadSpaceIqIt[i]));
-
-        // destroy MDF tasks
-        pMdfDecodeEngine->pMdfDevice->DestroyTask(pMdfDecodeEngine->pTaskIqIt[i]);
     }
 
     /////////////////// Inter Prediction ///////////////////
@@ -2621,6 +2828,14 @@ VAStatus Intel_HybridVp9Decode_MdfHost_Execute (
 	Intel_HybridVp9Decode_MdfHost_PadFrame(ctx,
             pMdfDecodeEngine, pMdfDecodeFrame, pMdfDecodeFrame->ucAltRefIndex);
 
+        if (bScaling && !pMdfDecodeEngine->pKernelInterScaling)
+        {
+            eStatus = Intel_HybridVp9Decode_MdfHost_CreateScalingKernel(ctx,
+                pMdfDecodeEngine, pMdfDecodeFrame);
+            if (eStatus != VA_STATUS_SUCCESS)
+                goto finish;
+        }
+
         pKernel = bScaling ? pMdfDecodeEngine->pKernelInterScaling : pMdfDecodeEngine->pKernelInter;
 
         // set arguments
@@ -2713,9 +2928,8 @@ VAStatus Intel_HybridVp9Decode_MdfHost_Execute (
             pKernel->SetKernelArg(uiArgIndex++, VP9_HYBRID_DECODE_COMBINED_FILETER_SIZE, pMdfDecodeEngine->CombinedFilters.pu8Buffer);
         }
 
-        // Create MDF Tasks and add kernels
-        INTEL_DECODE_CHK_MDF_STATUS(pMdfDecodeEngine->pMdfDevice->CreateTask(pMdfDecodeEngine->pTaskInter));
-        INTEL_DECODE_CHK_MDF_STATUS(pMdfDecodeEngine->pTaskInter->AddKernel(pKernel));
+        INTEL_DECODE_CHK_MDF_STATUS(Intel_HybridVp9Decode_MdfHost_GetTask(
+            pMdfDecodeEngine, pKernel, pMdfDecodeEngine->pTaskInter));
 
         // Enqueue will reset pCmNoEvent to NULL. Set to CM_NO_EVENT here in each Enqueue iteration.
         pCmNoEvent = CM_NO_EVENT;
@@ -2725,9 +2939,6 @@ VAStatus Intel_HybridVp9Decode_MdfHost_Execute (
             pMdfDecodeEngine->pTaskInter,
             pCmNoEvent,
             pMdfDecodeEngine->pThreadSpaceInter));
-
-        // destroy MDF tasks
-        pMdfDecodeEngine->pMdfDevice->DestroyTask(pMdfDecodeEngine->pTaskInter);
     }
 
     for (i = INTEL_HYBRID_VP9_MDF_YUV_PLANE_Y; i < INTEL_HYBRID_VP9_MDF_YUV_PLANE_NUMBER; i++)
@@ -2765,7 +2976,7 @@ VAStatus Intel_HybridVp9Decode_MdfHost_Execute (
             pMdfBuffer->ThreadInfo[i].pMdfSurface->GetIndex(pSurfaceIndexThreadInfo[i]);
 
             Intel_HybridVp9Decode_MdfHost_ZeroFillThreadInfo(
-                pMdfDecodeEngine->pMdfDevice, 
+                pMdfDecodeEngine, 
                 pMdfDecodeEngine->pKernelZeroFill[i], 
                 pMdfDecodeFrame->pMdfQueue, 
                 pMdfDecodeEngine->pThreadSpaceZeroFill[i],
@@ -2777,9 +2988,8 @@ VAStatus Intel_HybridVp9Decode_MdfHost_Execute (
         pMdfDecodeEngine->pKernelIntra[i]->SetKernelArg(uiArgIndex++, sizeof(UINT16), &pMdfDecodeFrame->dwWidth);        
         pMdfDecodeEngine->pKernelIntra[i]->SetKernelArg(uiArgIndex++, sizeof(UINT16), &pMdfDecodeFrame->dwHeight);        
 
-        // Create MDF Tasks and add kernels
-        INTEL_DECODE_CHK_MDF_STATUS(pMdfDecodeEngine->pMdfDevice->CreateTask(pMdfDecodeEngine->pTaskIntra[i]));
-        INTEL_DECODE_CHK_MDF_STATUS(pMdfDecodeEngine->pTaskIntra[i]->AddKernel(pMdfDecodeEngine->pKernelIntra[i]));
+        INTEL_DECODE_CHK_MDF_STATUS(Intel_HybridVp9Decode_MdfHost_GetTask(
+            pMdfDecodeEngine, pMdfDecodeEngine->pKernelIntra[i], pMdfDecodeEngine->pTaskIntra[i]));
 
         // enqueue tasks
         if (((i + 1) == INTEL_HYBRID_VP9_MDF_YUV_PLANE_NUMBER) && !pMdfDecodeFrame->bNeedDeblock)
@@ -2791,9 +3001,6 @@ VAStatus Intel_HybridVp9Decode_MdfHost_Execute (
         INTEL_DECODE_CHK_MDF_STATUS(pMdfDecodeFrame->pMdfQueue->Enqueue(
             pMdfDecodeEngine->pTaskIntra[i],
             (last_task ? pMdfDecodeFrame->pMdfEvent : pCmNoEvent)));
-
-        // destroy MDF tasks
-        pMdfDecodeEngine->pMdfDevice->DestroyTask(pMdfDecodeEngine->pTaskIntra[i]);
     }
 
     /////////////////// Loopfilter/Deblocking ///////////////////
@@ -2834,9 +3041,8 @@ VAStatus Intel_HybridVp9Decode_MdfHost_Execute (
                 pKernel->SetKernelArg(6, sizeof(DWORD), &dwRegion);
             }
 
-            // Create MDF Tasks and add kernels
-            INTEL_DECODE_CHK_MDF_STATUS(pMdfDecodeEngine->pMdfDevice->CreateTask(pMdfDecodeEngine->pTaskDeblock[i]));
-            INTEL_DECODE_CHK_MDF_STATUS(pMdfDecodeEngine->pTaskDeblock[i]->AddKernel(pKernel));
+            INTEL_DECODE_CHK_MDF_STATUS(Intel_HybridVp9Decode_MdfHost_GetTask(
+                pMdfDecodeEngine, pKernel, pMdfDecodeEngine->pTaskDeblock[i]));
 
             if (((i + 1) == INTEL_HYBRID_VP9_MDF_YUV_PLANE_NUMBER))
 		last_task = 1;
@@ -2849,9 +3055,6 @@ VAStatus Intel_HybridVp9Decode_MdfHost_Execute (
                 pMdfDecodeEngine->pTaskDeblock[i],
                 (last_task ? pMdfDecodeFrame->pMdfEvent : pCmNoEvent)));
 
-            // destroy MDF tasks
-            pMdfDecodeEngine->pMdfDevice->DestroyTask(pMdfDecodeEngine->pTaskDeblock[i]);
-
             // Enqueue more deblocking tasks for blocks out of 4080x4088 bound
             for (dwRegion = INTEL_HYBRID_VP9_MDF_DEBLOCK_RIGHT_TOP;
                 dwRegion < INTEL_HYBRID_VP9_MDF_DEBLOCK_REGIONS;
@@ -2868,17 +3071,13 @@ VAStatus Intel_HybridVp9Decode_MdfHost_Execute (
                     pKernel->SetKernelArg(5, sizeof(SurfaceIndex), pSurfaceThreadDependency);
                     pKernel->SetKernelArg(6, sizeof(DWORD), &dwRegion);
 
-                    // Create MDF Tasks and add kernels
-                    INTEL_DECODE_CHK_MDF_STATUS(pMdfDecodeEngine->pMdfDevice->CreateTask(pMdfDecodeEngine->pTaskDeblock[i]));
-                    INTEL_DECODE_CHK_MDF_STATUS(pMdfDecodeEngine->pTaskDeblock[i]->AddKernel(pKernel));
+                    INTEL_DECODE_CHK_MDF_STATUS(Intel_HybridVp9Decode_MdfHost_GetTask(
+                        pMdfDecodeEngine, pKernel, pMdfDecodeEngine->pTaskDeblock[i]));
 
                     // enqueue tasks
                     INTEL_DECODE_CHK_MDF_STATUS(pMdfDecodeFrame->pMdfQueue->Enqueue(
                         pMdfDecodeEngine->pTaskDeblock[i],
                         pMdfDecodeFrame->pMdfEvent));
-
-                    // destroy MDF tasks
-                    pMdfDecodeEngine->pMdfDevice->DestroyTask(pMdfDecodeEngine->pTaskDeblock[i]);
                 }
             }
         }
@@ -3312,6 +3511,56 @@ VAStatus Intel_HybridVp9Decode_HostVldRenderCb (
     return eStatus;
 }
 
+// Dump the host memory held by this decode context (VA_INTEL_DEBUG mem report bit)
+void Intel_HybridVp9Decode_ReportMemoryUsage(
+    PINTEL_DECODE_HYBRID_VP9_STATE   pHybridVp9State,
+    const char                          *pszEvent)
+{
+    PINTEL_DECODE_HYBRID_VP9_MDF_ENGINE  pMdfDecodeEngine;
+    PINTEL_DECODE_HYBRID_VP9_MDF_FRAME   pMdfDecodeFrame;
+    VADriverContextP                     ctx;
+    INTEL_HYBRID_VP9_POOL_STATS          PoolStats;
+    uint64_t                             FrameBytes = 0;
+    uint32_t                             dwResidueBytes, dwHostVldBytes = 0;
+    unsigned int                         i;
+
+    if (!(g_intel_debug_option_flags & VA_INTEL_HYBRID_MEM_REPORT))
+    {
+        return;
+    }
+
+    pMdfDecodeEngine = &pHybridVp9State->MdfDecodeEngine;
+    ctx              = (VADriverContextP)pHybridVp9State->driver_context;
+
+    media_drv_log_info(ctx, "vp9 memory report (%s) context %p:\n", pszEvent, (void *)pHybridVp9State);
+    for (i = 0; i < pMdfDecodeEngine->dwMdfBufferSize; i++)
+    {
+        pMdfDecodeFrame = pMdfDecodeEngine->pMdfDecodeFrame + i;
+        media_drv_log_info(ctx, "  frame slot %u: %ux%u (max %ux%u) planes %u bytes\n", i,
+            pMdfDecodeFrame->dwWidth, pMdfDecodeFrame->dwHeight,
+            pMdfDecodeFrame->dwMaxWidth, pMdfDecodeFrame->dwMaxHeight,
+            pMdfDecodeFrame->Layout.dwTotalSize);
+        FrameBytes += pMdfDecodeFrame->Layout.dwTotalSize;
+    }
+
+    dwResidueBytes = pMdfDecodeEngine->Residue[INTEL_HYBRID_VP9_MDF_YUV_PLANE_Y].dwSize +
+                     pMdfDecodeEngine->Residue[INTEL_HYBRID_VP9_MDF_YUV_PLANE_UV].dwSize;
+
+    if (pHybridVp9State->hHostVld)
+    {
+        Intel_HostvldVp9_QueryMemoryUsage(pHybridVp9State->hHostVld, &dwHostVldBytes);
+    }
+
+    Intel_HybridVp9_BufferPool_GetStats(&pMdfDecodeEngine->BufferPool, &PoolStats);
+
+    media_drv_log_info(ctx, "  frame planes %llu, residue %u, hostvld %u bytes\n",
+        (unsigned long long)FrameBytes, dwResidueBytes, dwHostVldBytes);
+    media_drv_log_info(ctx, "  pool in use %llu, cached %llu, peak %llu bytes\n",
+        (unsigned long long)PoolStats.InUseBytes,
+        (unsigned long long)PoolStats.CachedBytes,
+        (unsigned long long)PoolStats.PeakBytes);
+}
+
 VAStatus Intel_HybridVp9Decode_HostVldSyncResourceCb (
     void                               *pvStandardState, 
     PINTEL_HOSTVLD_VP9_VIDEO_BUFFER  pHostVldVideoBuf, 
@@ -3343,6 +3592,9 @@ VAStatus Intel_HybridVp9Decode_HostVldSyncResourceCb (
     // make sure the last frame is not using the MDF host buffers
     Intel_HybridVp9Decode_MdfHost_SyncResource(pMdfDecodeFrame);
 
+    // advance the buffer pool clock so that idle cached blocks get trimmed
+    Intel_HybridVp9_BufferPool_Tick(&pMdfDecodeEngine->BufferPool);
+
     pMdfDecodeFrame->CurrPic            = pVp9PicParams->CurrPic;
     pMdfDecodeFrame->ucCurrIndex        = pVp9PicParams->CurrPic;
 	/* Use the VASurfaceID directly to simplify the RefFrameList logic */
@@ -3379,41 +3631,71 @@ VAStatus Intel_HybridVp9Decode_HostVldSyncResourceCb (
         pMdfDecodeFrame->dwWidthB64         = pMdfDecodeFrame->dwAlignedWidth >> 6;
         pMdfDecodeFrame->dwHeightB64        = pMdfDecodeFrame->dwAlignedHeight >> 6;
 
+        eStatus = Intel_HybridVp9Decode_MdfHost_PlanLayout(
+            pMdfDecodeFrame, pMdfDecodeEngine->pMdfDevice, &pMdfDecodeFrame->Layout);
+        if (eStatus != VA_STATUS_SUCCESS)
+        {
+            // plan again on the next frame instead of trusting a partial layout
+            pMdfDecodeFrame->dwWidth = 0;
+            goto finish;
+        }
+
         if ((pMdfDecodeFrame->dwWidth  > pMdfDecodeFrame->dwMaxWidth) ||
             (pMdfDecodeFrame->dwHeight > pMdfDecodeFrame->dwMaxHeight))
         {
-            pMdfDecodeFrame->dwMaxWidth  = dwWidth;
-            pMdfDecodeFrame->dwMaxHeight = dwHeight;
-
             // Reallocate host buffers of current frame if resolution changed
-            Intel_HybridVp9Decode_MdfHost_ReallocateCurrentFrame(
+            eStatus = Intel_HybridVp9Decode_MdfHost_ReallocateCurrentFrame(
 		pHybridVp9State,
                 pMdfDecodeFrame, pMdfDecodeEngine->pMdfDevice);
+            if (eStatus != VA_STATUS_SUCCESS)
+            {
+                // the planes were released; reallocate whatever the next frame size is
+                pMdfDecodeFrame->dwWidth     = 0;
+                pMdfDecodeFrame->dwMaxWidth  = 0;
+                pMdfDecodeFrame->dwMaxHeight = 0;
+                goto finish;
+            }
+
+            pMdfDecodeFrame->dwMaxWidth  = dwWidth;
+            pMdfDecodeFrame->dwMaxHeight = dwHeight;
 
             // update HostVLD output buffers
             Intel_HybridVp9Decode_SetHostBuffers(pHybridVp9State, uiCurrIndex);
+            pHostVldVideoBuf->dwReallocCount++;
+
+            Intel_HybridVp9Decode_ReportMemoryUsage(pHybridVp9State, "realloc");
         }
     }
 
     // If motion vector buffer and reference frame index buffer are not big enough, reallocate them.
-    dwBufferSize = (pMdfDecodeFrame->dwAlignedWidth >> 2) * (pMdfDecodeFrame->dwAlignedHeight >> 2);
+    dwBufferSize = pMdfDecodeFrame->Layout.Plane[INTEL_HYBRID_VP9_MDF_PLANE_MV].dwWidth;
     if (pMdfDecodeFrame->MdfDecodeBuffer.MotionVector.dwSize < dwBufferSize)
     {
-        Intel_HybridVp9Decode_MdfHost_ReallocateMvBuffer(
+        eStatus = Intel_HybridVp9Decode_MdfHost_ReallocateMvBuffer(
 	    pHybridVp9State,
             pMdfDecodeFrame, pMdfDecodeEngine->pMdfDevice);
+        if (eStatus != VA_STATUS_SUCCESS)
+        {
+            goto finish;
+        }
         pHostVldOutputBuf->MotionVector.pu8Buffer   = pMdfDecodeFrame->MdfDecodeBuffer.MotionVector.pu8Buffer;
         pHostVldOutputBuf->MotionVector.dwSize      = pMdfDecodeFrame->MdfDecodeBuffer.MotionVector.dwSize;
+        pHostVldVideoBuf->dwReallocCount++;
     }
 
-    dwBufferSize >>= 2;
+    dwBufferSize = pMdfDecodeFrame->Layout.Plane[INTEL_HYBRID_VP9_MDF_PLANE_REF_FRAME].dwWidth;
     if (pMdfDecodeFrame->MdfDecodeBuffer.ReferenceFrame.dwSize < dwBufferSize)
     {
-        Intel_HybridVp9Decode_MdfHost_ReallocateRefFrameIndexBuffer(
+        eStatus = Intel_HybridVp9Decode_MdfHost_ReallocateRefFrameIndexBuffer(
 	    pHybridVp9State,
             pMdfDecodeFrame, pMdfDecodeEngine->pMdfDevice);
+        if (eStatus != VA_STATUS_SUCCESS)
+        {
+            goto finish;
+        }
         pHostVldOutputBuf->ReferenceFrame.pu8Buffer = pMdfDecodeFrame->MdfDecodeBuffer.ReferenceFrame.pu8Buffer;
         pHostVldOutputBuf->ReferenceFrame.dwSize    = pMdfDecodeFrame->MdfDecodeBuffer.ReferenceFrame.dwSize;
+        pHostVldVideoBuf->dwReallocCount++;
     }
 
 
@@ -3453,6 +3735,7 @@ VAStatus Intel_HybridVp9Decode_HostVldSyncResourceCb (
     pBuffer = &pHostVldOutputBuf->CoeffStatus[INTEL_HOSTVLD_VP9_YUV_PLANE_UV];
     memset(pBuffer->pu8Buffer, 0, pBuffer->dwSize * sizeof (uint8_t));
 
+finish:
     return eStatus;
 }
 
@@ -3463,10 +3746,19 @@ VAStatus Intel_HybridVp9Decode_AllocateResources (
     INTEL_HOSTVLD_VP9_CALLBACKS  HostVldCallbacks;
     VAStatus                      eStatus = VA_STATUS_SUCCESS;
 
+    // Buffer pool shared by HostVLD and MDF host
+    eStatus = Intel_HybridVp9_BufferPool_Init(&pHybridVp9State->MdfDecodeEngine.BufferPool, ctx);
+
+    if (eStatus != VA_STATUS_SUCCESS)
+	goto error_status;
+
     // Create HostVLD
     HostVldCallbacks.pvStandardState        = pHybridVp9State;
     HostVldCallbacks.pfnHostVldRenderCb     = Intel_HybridVp9Decode_HostVldRenderCb;
     HostVldCallbacks.pfnHostVldSyncCb       = Intel_HybridVp9Decode_HostVldSyncResourceCb;
+    HostVldCallbacks.pBufferPool            = &pHybridVp9State->MdfDecodeEngine.BufferPool;
+    HostVldCallbacks.bKeyFrameOnly          =
+        (pHybridVp9State->dwDecodeMode & VA_HYBRID_DECODE_MODE_KEYFRAME_ONLY) ? TRUE : FALSE;
 
     eStatus = Intel_HostvldVp9_Create(
         &pHybridVp9State->hHostVld, 
@@ -3510,6 +3802,8 @@ void Intel_HybridVp9Decode_Destroy(
 
     pHybridVp9State = &vp9_context->vp9_state;
 
+    Intel_HybridVp9Decode_ReportMemoryUsage(pHybridVp9State, "destroy");
+
     // destroy HostVLD
     if (pHybridVp9State->hHostVld)
     {
@@ -3622,7 +3916,7 @@ VAStatus Intel_HybridVp9_DecodeInitialize(
     slice_data_bo = decode_state->slice_datas[0]->bo;
 
     if (slice_data_bo) {
-	dri_bo_map(slice_data_bo, 0);
+	media_bo_map(slice_data_bo, 0);
 	pHostVldVideoBuffer->slice_data_bo = slice_data_bo;
 	pHostVldVideoBuffer->pbBitsData = (uint8_t *)slice_data_bo->virt;
 	pHostVldVideoBuffer->dwBitsSize = pVp9PicParams->BSBytesInBuffer;
@@ -3657,7 +3951,7 @@ VAStatus Intel_HybridVp9_DecodeSliceLevel(
     VAStatus                              eStatus = VA_STATUS_SUCCESS;
 
     // execute HostVLD to parse bitstream and prepare MDF resources for kernels
-    Intel_HostvldVp9_Execute(pHybridVp9State->hHostVld);
+    eStatus = Intel_HostvldVp9_Execute(pHybridVp9State->hHostVld);
 
     return eStatus;
 }
@@ -3673,12 +3967,24 @@ intel_hybrid_vp9_check_rendertarget(VADriverContextP ctx,
     struct decode_state *decode_state = &codec_state->decode;
     struct object_surface *obj_surface;
     hybrid_vp9_hw_context *vp9_context = (hybrid_vp9_hw_context *) hw_context;
+    VADecPictureParameterBufferVP9 *pPP;
     
     if (decode_state->current_render_target == VA_INVALID_SURFACE)
 	return VA_STATUS_ERROR_INVALID_PARAMETER;
 
     obj_surface = SURFACE(decode_state->current_render_target);
- 
+    if (obj_surface == NULL)
+	return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    /* 8-bit 4:2:0 only */
+    pPP = decode_state->pic_param ?
+          (VADecPictureParameterBufferVP9 *)decode_state->pic_param->buffer : NULL;
+    if (pPP && pPP->profile != 0)
+	return VA_STATUS_ERROR_UNSUPPORTED_PROFILE;
+
+    if (obj_surface->bo && obj_surface->fourcc != VA_FOURCC_NV12)
+	return VA_STATUS_ERROR_INVALID_SURFACE;
+
     media_alloc_surface_bo(ctx, obj_surface, 1, VA_FOURCC_NV12, SUBSAMPLE_YUV420);
 
     vp9_context->sDestSurface = obj_surface;
@@ -3820,6 +4126,30 @@ intel_hybrid_vp9_convert_slice(VADriverContextP ctx,
     return VA_STATUS_SUCCESS;
 }
 
+/* In key frame only mode everything but key frames is dropped here, before
+ * any parameter conversion or bitstream parsing. The render target is left
+ * untouched for dropped frames.
+ */
+static bool
+intel_hybrid_vp9_skip_picture(union codec_state *codec_state,
+                        struct hw_context *hw_context)
+{
+    hybrid_vp9_hw_context *vp9_context = (hybrid_vp9_hw_context *) hw_context;
+    struct decode_state *decode_state = &codec_state->decode;
+    VADecPictureParameterBufferVP9 *pPP;
+
+    if (!(vp9_context->vp9_state.dwDecodeMode & VA_HYBRID_DECODE_MODE_KEYFRAME_ONLY))
+        return false;
+
+    if (decode_state->pic_param == NULL)
+        return false;
+
+    pPP = (VADecPictureParameterBufferVP9 *)(decode_state->pic_param->buffer);
+    if (pPP == NULL)
+        return false;
+
+    return pPP->pic_fields.bits.frame_type != INTEL_HYBRID_VP9_KEY_FRAME;
+}
 
  VAStatus
 intel_hybrid_decode_picture(VADriverContextP ctx, 
@@ -3834,6 +4164,9 @@ intel_hybrid_decode_picture(VADriverContextP ctx,
     
     pHybridVp9State = &vp9_context->vp9_state;
 
+    if (intel_hybrid_vp9_skip_picture(codec_state, hw_context))
+	return VA_STATUS_SUCCESS;
+
     /* Assure that the render_target surface is initialized */
     eStatus = intel_hybrid_vp9_check_rendertarget(ctx, codec_state, hw_context);
 
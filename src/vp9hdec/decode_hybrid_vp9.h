@@ -91,6 +91,7 @@ typedef struct _INTEL_DECODE_HYBRID_VP9_MDF_1D_BUFFER
     uint32_t           dwSize;     // size in bytes or words depending on the buffer data
     dri_bo	*bo;
     int bo_mapped; /* indicate whether bo is mapped */
+    PINTEL_HYBRID_VP9_POOL_BLOCK    pPoolBlock; /* backing block when bo comes from the buffer pool */
 } INTEL_DECODE_HYBRID_VP9_MDF_1D_BUFFER, *PINTEL_DECODE_HYBRID_VP9_MDF_1D_BUFFER;
 
 typedef struct _INTEL_DECODE_HYBRID_VP9_MDF_2D_BUFFER
@@ -111,6 +112,7 @@ typedef struct _INTEL_DECODE_HYBRID_VP9_MDF_2D_BUFFER
     uint32_t           dwSize;
     dri_bo	*bo;
     int bo_mapped; /* indicate whether bo is mapped */
+    PINTEL_HYBRID_VP9_POOL_BLOCK    pPoolBlock; /* backing block when bo comes from the buffer pool */
 } INTEL_DECODE_HYBRID_VP9_MDF_2D_BUFFER, *PINTEL_DECODE_HYBRID_VP9_MDF_2D_BUFFER;
 
 typedef struct _INTEL_DECODE_HYBRID_VP9_MDF_FRAME_SOURCE
@@ -151,6 +153,53 @@ typedef struct _INTEL_DECODE_HYBRID_VP9_MDF_BUFFER
     INTEL_DECODE_HYBRID_VP9_MDF_1D_BUFFER    PrevReferenceFrame; // Previous frame reference frame index buffer
 } INTEL_DECODE_HYBRID_VP9_MDF_BUFFER, *PINTEL_DECODE_HYBRID_VP9_MDF_BUFFER;
 
+// Per-frame MDF host planes, in the order the layout planner packs them
+typedef enum _INTEL_HYBRID_VP9_MDF_PLANE
+{
+    INTEL_HYBRID_VP9_MDF_PLANE_COEFF_Y = 0,
+    INTEL_HYBRID_VP9_MDF_PLANE_COEFF_U,
+    INTEL_HYBRID_VP9_MDF_PLANE_COEFF_V,
+    INTEL_HYBRID_VP9_MDF_PLANE_TX_SIZE_Y,
+    INTEL_HYBRID_VP9_MDF_PLANE_TX_SIZE_UV,
+    INTEL_HYBRID_VP9_MDF_PLANE_COEFF_STATUS_Y,
+    INTEL_HYBRID_VP9_MDF_PLANE_COEFF_STATUS_UV,
+    INTEL_HYBRID_VP9_MDF_PLANE_QP_Y,
+    INTEL_HYBRID_VP9_MDF_PLANE_QP_UV,
+    INTEL_HYBRID_VP9_MDF_PLANE_TX_TYPE,
+    INTEL_HYBRID_VP9_MDF_PLANE_TILE_INDEX,
+    INTEL_HYBRID_VP9_MDF_PLANE_PRED_MODE_Y,
+    INTEL_HYBRID_VP9_MDF_PLANE_PRED_MODE_UV,
+    INTEL_HYBRID_VP9_MDF_PLANE_BLOCK_SIZE,
+    INTEL_HYBRID_VP9_MDF_PLANE_REF_FRAME,
+    INTEL_HYBRID_VP9_MDF_PLANE_FILTER_TYPE,
+    INTEL_HYBRID_VP9_MDF_PLANE_MV,
+    INTEL_HYBRID_VP9_MDF_PLANE_VERT_EDGE_Y,          // 2D planes from here on
+    INTEL_HYBRID_VP9_MDF_PLANE_VERT_EDGE_UV,
+    INTEL_HYBRID_VP9_MDF_PLANE_HORZ_EDGE_Y,
+    INTEL_HYBRID_VP9_MDF_PLANE_HORZ_EDGE_UV,
+    INTEL_HYBRID_VP9_MDF_PLANE_FILTER_LEVEL,
+    INTEL_HYBRID_VP9_MDF_PLANE_THRESHOLD,
+    INTEL_HYBRID_VP9_MDF_PLANE_DEBLOCK_MASK_Y,
+    INTEL_HYBRID_VP9_MDF_PLANE_DEBLOCK_MASK_UV,
+    INTEL_HYBRID_VP9_MDF_PLANE_PREV_REF_FRAME,      // previous frame planes
+    INTEL_HYBRID_VP9_MDF_PLANE_PREV_MV,
+    INTEL_HYBRID_VP9_MDF_PLANE_NUMBER
+} INTEL_HYBRID_VP9_MDF_PLANE;
+
+typedef struct _INTEL_HYBRID_VP9_MDF_PLANE_LAYOUT
+{
+    uint32_t        dwWidth;        // element count for 1D planes
+    uint32_t        dwHeight;       // 1 for 1D planes
+    uint32_t        dwBpp;
+    uint32_t        dwSize;         // page aligned bytes
+} INTEL_HYBRID_VP9_MDF_PLANE_LAYOUT, *PINTEL_HYBRID_VP9_MDF_PLANE_LAYOUT;
+
+typedef struct _INTEL_HYBRID_VP9_MDF_FRAME_LAYOUT
+{
+    INTEL_HYBRID_VP9_MDF_PLANE_LAYOUT    Plane[INTEL_HYBRID_VP9_MDF_PLANE_NUMBER];
+    uint32_t                             dwTotalSize;    // sum of the plane bos of one slot
+} INTEL_HYBRID_VP9_MDF_FRAME_LAYOUT, *PINTEL_HYBRID_VP9_MDF_FRAME_LAYOUT;
+
 typedef struct _INTEL_DECODE_HYBRID_VP9_MDF_FRAME
 {
     // Host Buffers
@@ -193,10 +242,16 @@ typedef struct _INTEL_DECODE_HYBRID_VP9_MDF_FRAME
     bool            bPrevShowFrame;
 
     uint32_t           dwIntraPredKernelMode[INTEL_HYBRID_VP9_MDF_YUV_PLANE_NUMBER];
+
+    // plane sizes for the current dimensions, see Intel_HybridVp9Decode_MdfHost_PlanLayout
+    INTEL_HYBRID_VP9_MDF_FRAME_LAYOUT    Layout;
 } INTEL_DECODE_HYBRID_VP9_MDF_FRAME, *PINTEL_DECODE_HYBRID_VP9_MDF_FRAME;
 
 #define INTEL_NUM_UNCOMPRESSED_SURFACE_VP9   128
 
+// one cached task per kernel, see Intel_HybridVp9Decode_MdfHost_GetTask
+#define INTEL_HYBRID_VP9_MDF_MAX_TASKS       24
+
 typedef struct _INTEL_DECODE_HYBRID_VP9_MDF_ENGINE
 {
     CmKernel        *pKernelIqIt[INTEL_HYBRID_VP9_MDF_YUV_PLANE_NUMBER];
@@ -222,6 +277,24 @@ typedef struct _INTEL_DECODE_HYBRID_VP9_MDF_ENGINE
     CmTask          *pTaskInter;
     CmTask          *pTaskDeblock[INTEL_HYBRID_VP9_MDF_YUV_PLANE_NUMBER];
 
+    // Tasks hold a single kernel and are re-enqueued every frame
+    struct
+    {
+        CmKernel    *pKernel;
+        CmTask      *pTask;
+    } TaskCache[INTEL_HYBRID_VP9_MDF_MAX_TASKS];
+    DWORD           dwNumTasks;
+
+    // Reference padding thread space, rebuilt only when the height changes
+    CmThreadSpace   *pThreadSpacePadding;
+    DWORD           dwPaddingThreadCount;
+    // Last padding task, waited for before its thread space is destroyed
+    CmQueue         *pPaddingQueue;
+    CmEvent         *pPaddingEvent;
+
+    DWORD           dwTaskCreates;
+    DWORD           dwThreadSpaceCreates;
+
     CmDevice        *pMdfDevice;
     uint64_t        iMdfDeviceTsc;
 
@@ -234,6 +307,9 @@ typedef struct _INTEL_DECODE_HYBRID_VP9_MDF_ENGINE
     // Combined 3x8-tap filter coefficients (each filter is 16x8 bytes).
     INTEL_DECODE_HYBRID_VP9_MDF_1D_BUFFER    CombinedFilters;
 
+    // Size-class pool backing the per-frame host buffers (shared with HostVLD)
+    INTEL_HYBRID_VP9_BUFFER_POOL             BufferPool;
+
     // kernel related
     uint32_t           dwLumaDeblockThreadWidth;
     uint32_t           dwLumaDeblockThreadHeight;
@@ -276,6 +352,7 @@ struct _INTEL_DECODE_HYBRID_VP9_STATE
     PINTEL_VP9_PIC_PARAMS                 pVp9PicParams;
     bool                                  bStatusReportingEnabled;
     void                                  *pDecodeStatusBuf;
+    uint32_t                              dwDecodeMode;       // VA_HYBRID_DECODE_MODE_*
 
     /* This is to keep the VADriverContextP */
     void	*driver_context;
@@ -77,28 +77,90 @@
 #define INTEL_HOSTVLD_VP9_PAGE_SIZE      0x1000
 #define INTEL_HOSTVLD_VP9_EARLY_DECODE_BUFFER_NUM  3
 
-#define VP9_ALIGNED_FREE_MEMORY(pAlignedBuffer)                \
+#define VP9_POOL_FREE_MEMORY(pPool, pAlignedBuffer)           \
 do {                                                           \
-    if (pAlignedBuffer)                                        \
-    {                                                          \
-        free(pAlignedBuffer);                                  \
-    }                                                          \
+    Intel_HybridVp9_BufferPool_FreeHost(pPool, pAlignedBuffer); \
+    pAlignedBuffer = NULL;                                     \
 } while(0)
 
-#define VP9_REALLOCATE_ABOVE_CTX_BUFFER(pAboveCtxBuffer, size) \
-do {                                                           \
-    VP9_ALIGNED_FREE_MEMORY(pAboveCtxBuffer);                                     \
-    pAboveCtxBuffer = (PUINT8)memalign(INTEL_HOSTVLD_VP9_PAGE_SIZE, size); \
-} while(0)
-
-#define VP9_REALLOCATE_HOSTVLD_1D_BUFFER_UINT8(pHostvldBuffer, dwBufferSize)    \
+#define VP9_REALLOCATE_HOSTVLD_1D_BUFFER_UINT8(pPool, pHostvldBuffer, dwBufferSize)    \
 do                                                                              \
 {                                                                               \
-    VP9_ALIGNED_FREE_MEMORY((pHostvldBuffer)->pu8Buffer);                       \
+    VP9_POOL_FREE_MEMORY(pPool, (pHostvldBuffer)->pu8Buffer);                   \
     (pHostvldBuffer)->dwSize = dwBufferSize;                                    \
-    (pHostvldBuffer)->pu8Buffer = (PUINT8)memalign(INTEL_HOSTVLD_VP9_PAGE_SIZE, dwBufferSize); \
+    (pHostvldBuffer)->pu8Buffer = (PUINT8)Intel_HybridVp9_BufferPool_AllocHost(pPool, dwBufferSize); \
 } while (0)
 
+#define INTEL_HOSTVLD_VP9_CACHELINE_SIZE 64
+
+// Compute where each per-frame host plane lives inside the frame arena
+static VOID Intel_HostvldVp9_PlanFrameLayout(
+    PINTEL_HOSTVLD_VP9_FRAME_LAYOUT  pLayout,
+    DWORD                               dwNumAboveCtx,
+    DWORD                               dwModeInfoNum)
+{
+    DWORD   dwOffset = 0;
+
+    pLayout->dwContextAboveOffset = dwOffset;
+    pLayout->dwContextAboveSize   = dwNumAboveCtx * sizeof(INTEL_HOSTVLD_VP9_NEIGHBOR);
+    dwOffset += ALIGN(pLayout->dwContextAboveSize, INTEL_HOSTVLD_VP9_CACHELINE_SIZE);
+
+    // per 4x4 block, Y followed by U and V
+    pLayout->dwEntropyAboveOffset = dwOffset;
+    pLayout->dwEntropyAboveSize   = (dwNumAboveCtx << 1) * sizeof(UINT8) * 2;
+    dwOffset += ALIGN(pLayout->dwEntropyAboveSize, INTEL_HOSTVLD_VP9_CACHELINE_SIZE);
+
+    pLayout->dwModeInfoOffset     = dwOffset;
+    pLayout->dwModeInfoSize       = dwModeInfoNum * sizeof(INTEL_HOSTVLD_VP9_MODE_INFO);
+    dwOffset += pLayout->dwModeInfoSize;
+
+    pLayout->dwTotalSize          = ALIGN(dwOffset, INTEL_HOSTVLD_VP9_PAGE_SIZE);
+}
+
+// One JSON object per line, so the file can be streamed into any log tool
+static VOID Intel_HostvldVp9_WritePerfCounters(
+    PINTEL_HOSTVLD_VP9_FRAME_STATE   pFrameState)
+{
+    PINTEL_HOSTVLD_VP9_STATE         pVp9HostVld;
+    PINTEL_HOSTVLD_VP9_PERF_COUNTERS pCounters;
+    PINTEL_HOSTVLD_VP9_FRAME_INFO    pFrameInfo;
+    FILE                                *pFile;
+    DWORD                               i;
+
+    pVp9HostVld = pFrameState->pVp9HostVld;
+    pCounters   = &pFrameState->PerfCounters;
+    pFrameInfo  = &pFrameState->FrameInfo;
+    pFile       = pVp9HostVld->pPerfFile;
+
+    fprintf(pFile,
+        "{\"frame\":%u,\"width\":%u,\"height\":%u,\"key\":%d,\"bytes\":%u,"
+        "\"pre_parse_ns\":%llu,\"tile_parse_ns\":%llu,\"adaptation_ns\":%llu,"
+        "\"lf_mask_ns\":%llu,\"render_ns\":%llu,"
+        "\"coded_sb\":%u,\"skipped_sb\":%u,\"tokens\":%u,\"reallocs\":%u,"
+        "\"tile_column_ns\":[",
+        pVp9HostVld->dwPerfFrameCount++,
+        pFrameInfo->dwPicWidthCropped,
+        pFrameInfo->dwPicHeightCropped,
+        pFrameInfo->bIsKeyFrame ? 1 : 0,
+        pCounters->dwBitstreamBytes,
+        (unsigned long long)pCounters->u64StageTime[INTEL_HOSTVLD_VP9_PERF_STAGE_PRE_PARSE],
+        (unsigned long long)pCounters->u64StageTime[INTEL_HOSTVLD_VP9_PERF_STAGE_TILE_PARSE],
+        (unsigned long long)pCounters->u64StageTime[INTEL_HOSTVLD_VP9_PERF_STAGE_ADAPTATION],
+        (unsigned long long)pCounters->u64StageTime[INTEL_HOSTVLD_VP9_PERF_STAGE_LOOP_FILTER_MASK],
+        (unsigned long long)pCounters->u64StageTime[INTEL_HOSTVLD_VP9_PERF_STAGE_RENDER],
+        pCounters->dwCodedSuperBlocks,
+        pCounters->dwSkippedSuperBlocks,
+        pCounters->dwTokens,
+        pCounters->dwReallocations);
+
+    for (i = 0; i < pFrameInfo->dwTileColumns; i++)
+    {
+        fprintf(pFile, i ? ",%llu" : "%llu", (unsigned long long)pCounters->u64TileParseTime[i]);
+    }
+    fprintf(pFile, "]}\n");
+    fflush(pFile);
+}
+
 VAStatus Intel_HostvldVp9_Execute_MT (
     INTEL_HOSTVLD_VP9_HANDLE         hHostVld);
 
@@ -168,12 +230,21 @@ VAStatus Intel_HostvldVp9_Create (
     pVp9HostVld->pfnRenderCb        = pCallbacks->pfnHostVldRenderCb;
     pVp9HostVld->pfnSyncCb          = pCallbacks->pfnHostVldSyncCb;
     pVp9HostVld->pvStandardState    = pCallbacks->pvStandardState;
+    pVp9HostVld->pBufferPool        = pCallbacks->pBufferPool;
+    pVp9HostVld->bKeyFrameOnly      = pCallbacks->bKeyFrameOnly;
     pVp9HostVld->dwThreadNumber     = dwThreadNumber;
     pVp9HostVld->dwBufferNumber     = INTEL_HOSTVLD_VP9_HOSTBUF_NUM;
     pVp9HostVld->dwDDIBufNumber     = dwThreadNumber;
     pVp9HostVld->ui8BufNumEarlyDec  = 1; //not early decode for Sinlge thread case
     pVp9HostVld->PrevParserID       = -1;
 
+    if (g_intel_debug_option_flags & VA_INTEL_HYBRID_PERF_COUNTERS)
+    {
+        const char *pszFileName = getenv(VA_INTEL_HYBRID_COUNTERS_FILE_ENV);
+
+        pVp9HostVld->pPerfFile = pszFileName ? fopen(pszFileName, "a") : stderr;
+    }
+
     pthread_mutex_init(&pVp9HostVld->MutexSync, NULL);
     // Create Frame State
     pFrameState = (PINTEL_HOSTVLD_VP9_FRAME_STATE)calloc(pVp9HostVld->dwBufferNumber, sizeof(*pFrameState));
@@ -237,6 +308,34 @@ VAStatus Intel_HostvldVp9_QueryBufferSize (
     return eStatus;
 }
 
+VAStatus Intel_HostvldVp9_QueryMemoryUsage (
+    INTEL_HOSTVLD_VP9_HANDLE         hHostVld,
+    uint32_t                             *pdwBytes)
+{
+    PINTEL_HOSTVLD_VP9_STATE pVp9HostVld = NULL;
+    VAStatus                  eStatus     = VA_STATUS_SUCCESS;
+    uint32_t                  dwBytes     = 0;
+    uint32_t                  i;
+
+    pVp9HostVld = (PINTEL_HOSTVLD_VP9_STATE)hHostVld;
+
+    for (i = 0; i < pVp9HostVld->dwBufferNumber; i++)
+    {
+        dwBytes += pVp9HostVld->pFrameStateBase[i].FrameInfo.Arena.dwSize;
+    }
+    for (i = 0; i < pVp9HostVld->ui8BufNumEarlyDec; i++)
+    {
+        dwBytes += pVp9HostVld->pEarlyDecBufferBase[i].LastSegId.dwSize;
+    }
+
+    if (pdwBytes)
+    {
+        *pdwBytes = dwBytes;
+    }
+
+    return eStatus;
+}
+
 VAStatus Intel_HostvldVp9_SetOutputBuffer (
     INTEL_HOSTVLD_VP9_HANDLE         hHostVld,
     PINTEL_HOSTVLD_VP9_OUTPUT_BUFFER pOutputBuffer)
@@ -296,10 +395,11 @@ VAStatus Intel_HostvldVp9_PreParser (PVOID pVp9FrameState)
     PINTEL_VP9_PIC_PARAMS            pPicParams;
     PINTEL_VP9_SEGMENT_PARAMS        pSegmentData;
     INT                                 iMarkerBit;
-    DWORD                               dwNumAboveCtx, dwSize, i;
+    DWORD                               dwNumAboveCtx, dwModeInfoSize, dwSize, i;
     DWORD                               dwPrevPicWidth, dwPrevPicHeight;
     BOOL                                bPrevShowFrame;
     BOOL                                bResetLastSegId = FALSE;
+    UINT64                              u64Start = 0, u64SyncTime = 0;
     VAStatus                          eStatus     = VA_STATUS_SUCCESS;
 
 
@@ -310,6 +410,13 @@ VAStatus Intel_HostvldVp9_PreParser (PVOID pVp9FrameState)
     pOutputBuffer   = pFrameState->pOutputBuffer;
     pFrameInfo      = &pFrameState->FrameInfo;
 
+    memset(&pFrameState->PerfCounters, 0, sizeof(pFrameState->PerfCounters));
+    if (INTEL_HOSTVLD_VP9_PERF_ENABLED(pVp9HostVld))
+    {
+        u64Start = Intel_HostvldVp9_PerfTimeNs();
+    }
+    pFrameState->PerfCounters.dwBitstreamBytes = pVideoBuffer->dwBitsSize;
+
     pPrevFrameState = pFrameState->pVp9HostVld->pFrameStateBase + pFrameState->dwPrevIndex;
     dwPrevPicWidth  = pPrevFrameState->FrameInfo.dwPicWidthCropped;
     dwPrevPicHeight = pPrevFrameState->FrameInfo.dwPicHeightCropped;
@@ -412,50 +519,73 @@ VAStatus Intel_HostvldVp9_PreParser (PVOID pVp9FrameState)
     for (i = 0; i < pFrameState->dwTileStatesInUse; i++)
     {
         memset(&(pTileState->Count), 0, sizeof(pTileState->Count));
+        pTileState->dwCodedSuperBlocks   = 0;
+        pTileState->dwSkippedSuperBlocks = 0;
+        pTileState->dwTokens             = 0;
         pTileState++;
     }
     
-    // Only reallocate above context buffers when picture width becomes bigger           //Need To Check
-    dwNumAboveCtx = pFrameInfo->dwPicWidthAligned >> VP9_LOG2_B8_SIZE;
-    if (dwNumAboveCtx > pFrameInfo->dwNumAboveCtx)
+    // Above contexts and mode info are carved out of one arena per frame state.
+    // Only reallocate it when the picture needs more entries than it holds.
+    dwNumAboveCtx  = pFrameInfo->dwPicWidthAligned >> VP9_LOG2_B8_SIZE;
+    dwModeInfoSize = pFrameInfo->dwB8ColumnsAligned * pFrameInfo->dwB8RowsAligned;
+    if ((dwNumAboveCtx > pFrameInfo->dwNumAboveCtx) ||
+        (dwModeInfoSize > pFrameInfo->ModeInfo.dwSize))
     {
-        pFrameInfo->dwNumAboveCtx = dwNumAboveCtx;
-    
-        // allocate above context
-        dwSize = dwNumAboveCtx * sizeof(*pFrameInfo->pContextAbove);
-        VP9_ALIGNED_FREE_MEMORY(pFrameInfo->pContextAbove);
-        pFrameInfo->pContextAbove =
-            (PINTEL_HOSTVLD_VP9_NEIGHBOR)memalign(INTEL_HOSTVLD_VP9_PAGE_SIZE, dwSize);
-
-        dwNumAboveCtx <<= 1;
-        // Entropy context, per 4x4 block. Allocate once for all the planes
-        dwSize = dwNumAboveCtx * sizeof(*pFrameInfo->pEntropyContextAbove[VP9_CODED_YUV_PLANE_Y]) * 2;
-        VP9_REALLOCATE_ABOVE_CTX_BUFFER(pFrameInfo->EntropyContextAbove.pu8Buffer, dwSize);
-        pFrameInfo->EntropyContextAbove.dwSize = dwSize;
+        INTEL_HOSTVLD_VP9_FRAME_LAYOUT   Layout;
+        PUINT8                              pu8Arena;
+
+        dwNumAboveCtx  = MAX(dwNumAboveCtx, pFrameInfo->dwNumAboveCtx);
+        dwModeInfoSize = MAX(dwModeInfoSize, pFrameInfo->ModeInfo.dwSize);
+        Intel_HostvldVp9_PlanFrameLayout(&Layout, dwNumAboveCtx, dwModeInfoSize);
+
+        VP9_POOL_FREE_MEMORY(pVp9HostVld->pBufferPool, pFrameInfo->Arena.pu8Buffer);
+        pFrameInfo->dwNumAboveCtx   = 0;
+        pFrameInfo->ModeInfo.dwSize = 0;
+        pFrameInfo->Arena.dwSize    = 0;
+
+        pu8Arena = (PUINT8)Intel_HybridVp9_BufferPool_AllocHost(pVp9HostVld->pBufferPool, Layout.dwTotalSize);
+        if (pu8Arena == NULL)
+        {
+            eStatus = VA_STATUS_ERROR_ALLOCATION_FAILED;
+            goto finish;
+        }
+        // Blocks below or right of the picture only get their size parsed, and the
+        // loop filter flushes the rest of their mode info. Don't let that be
+        // whatever the pool block held before.
+        memset(pu8Arena, 0, Layout.dwTotalSize);
+        pFrameInfo->Arena.pu8Buffer = pu8Arena;
+        pFrameInfo->Arena.dwSize    = Layout.dwTotalSize;
+        pFrameState->PerfCounters.dwReallocations++;
+
+        pFrameInfo->dwNumAboveCtx   = dwNumAboveCtx;
+        pFrameInfo->pContextAbove   =
+            (PINTEL_HOSTVLD_VP9_NEIGHBOR)(pu8Arena + Layout.dwContextAboveOffset);
+
+        // Entropy context, per 4x4 block. One region for all the planes
+        dwSize = Layout.dwEntropyAboveSize;
+        pFrameInfo->EntropyContextAbove.pu8Buffer = pu8Arena + Layout.dwEntropyAboveOffset;
+        pFrameInfo->EntropyContextAbove.dwSize    = dwSize;
         pFrameInfo->pEntropyContextAbove[VP9_CODED_YUV_PLANE_Y] =
             pFrameInfo->EntropyContextAbove.pu8Buffer;
         pFrameInfo->pEntropyContextAbove[VP9_CODED_YUV_PLANE_U] =
             pFrameInfo->pEntropyContextAbove[VP9_CODED_YUV_PLANE_Y] + (dwSize >> 1);
         pFrameInfo->pEntropyContextAbove[VP9_CODED_YUV_PLANE_V] =
             pFrameInfo->pEntropyContextAbove[VP9_CODED_YUV_PLANE_U] + (dwSize >> 2); // we only support 4:2:0 so far.
+
+        pFrameInfo->ModeInfo.pBuffer = pu8Arena + Layout.dwModeInfoOffset;
+        pFrameInfo->ModeInfo.dwSize  = dwModeInfoSize;
     }
 
-    // Reallocate mode info buffer if changed to bigger resolution
     dwSize = pFrameInfo->dwB8ColumnsAligned * pFrameInfo->dwB8RowsAligned;
-    if (dwSize > pFrameInfo->ModeInfo.dwSize)
-    {
-        VP9_ALIGNED_FREE_MEMORY(pFrameInfo->ModeInfo.pBuffer);
-        pFrameInfo->ModeInfo.pBuffer = memalign(INTEL_HOSTVLD_VP9_PAGE_SIZE,
-            dwSize * sizeof(INTEL_HOSTVLD_VP9_MODE_INFO));
-        pFrameInfo->ModeInfo.dwSize  = dwSize;
-    }
 
     // Zero last segment id buffer if resolution changed
     if (dwSize > pFrameState->pLastSegIdBuf->dwSize)
     {
         // Per 8x8 block, UINT8
-        VP9_REALLOCATE_HOSTVLD_1D_BUFFER_UINT8(pFrameState->pLastSegIdBuf, dwSize);
+        VP9_REALLOCATE_HOSTVLD_1D_BUFFER_UINT8(pVp9HostVld->pBufferPool, pFrameState->pLastSegIdBuf, dwSize);
         bResetLastSegId |= TRUE;
+        pFrameState->PerfCounters.dwReallocations++;
     }
     if ((pFrameInfo->dwPicWidthCropped  != dwPrevPicWidth) || 
         (pFrameInfo->dwPicHeightCropped != dwPrevPicHeight) ||
@@ -472,11 +602,30 @@ VAStatus Intel_HostvldVp9_PreParser (PVOID pVp9FrameState)
     
     if (pVp9HostVld->pfnSyncCb)
     {
-        pVp9HostVld->pfnSyncCb(
+        // the sync callback waits for the GPU, keep it out of the pre-parse time
+        if (INTEL_HOSTVLD_VP9_PERF_ENABLED(pVp9HostVld))
+        {
+            u64SyncTime = Intel_HostvldVp9_PerfTimeNs();
+        }
+
+        pVideoBuffer->dwReallocCount = 0;
+        eStatus = pVp9HostVld->pfnSyncCb(
             pVp9HostVld->pvStandardState, 
             pVideoBuffer, 
             pFrameState->dwCurrIndex, 
             pFrameState->dwPrevIndex);
+        pFrameState->PerfCounters.dwReallocations += pVideoBuffer->dwReallocCount;
+
+        if (INTEL_HOSTVLD_VP9_PERF_ENABLED(pVp9HostVld))
+        {
+            u64SyncTime = Intel_HostvldVp9_PerfTimeNs() - u64SyncTime;
+        }
+
+        // the output buffers may not match the frame size; don't parse into them
+        if (eStatus != VA_STATUS_SUCCESS)
+        {
+            goto finish;
+        }
     }
     
     pFrameInfo->bHasPrevFrame = 
@@ -496,6 +645,11 @@ VAStatus Intel_HostvldVp9_PreParser (PVOID pVp9FrameState)
     Intel_HostvldVp9_PreParseTiles(pFrameState);
 
 finish:
+    if (INTEL_HOSTVLD_VP9_PERF_ENABLED(pVp9HostVld))
+    {
+        pFrameState->PerfCounters.u64StageTime[INTEL_HOSTVLD_VP9_PERF_STAGE_PRE_PARSE] =
+            Intel_HostvldVp9_PerfTimeNs() - u64Start - u64SyncTime;
+    }
     return eStatus;
 }
 
@@ -505,6 +659,9 @@ VAStatus Intel_HostvldVp9_PostParser (PVOID pVp9FrameState)
     PINTEL_HOSTVLD_VP9_STATE         pVp9HostVld = NULL;
     PINTEL_HOSTVLD_VP9_FRAME_STATE   pFrameState = NULL;
     PINTEL_HOSTVLD_VP9_FRAME_INFO    pFrameInfo  = NULL;
+    PINTEL_HOSTVLD_VP9_TILE_STATE    pTileState  = NULL;
+    UINT64                              u64Start    = 0;
+    DWORD                               i;
     VAStatus                          eStatus     = VA_STATUS_SUCCESS;
 
 
@@ -514,14 +671,39 @@ VAStatus Intel_HostvldVp9_PostParser (PVOID pVp9FrameState)
 
     Intel_HostvldVp9_PostParseTiles(pFrameState);
 
-    if (pFrameInfo->bIsIntraOnly || pFrameInfo->bErrorResilientMode)
+    pTileState = pFrameState->pTileStateBase;
+    for (i = 0; i < pFrameState->dwTileStatesInUse; i++)
     {
-        Intel_HostvldVp9_UpdateContextTables(pVp9HostVld->ContextTable, pFrameInfo);
+        pFrameState->PerfCounters.dwCodedSuperBlocks   += pTileState->dwCodedSuperBlocks;
+        pFrameState->PerfCounters.dwSkippedSuperBlocks += pTileState->dwSkippedSuperBlocks;
+        pFrameState->PerfCounters.dwTokens             += pTileState->dwTokens;
+        pTileState++;
     }
 
-    Intel_HostvldVp9_AdaptProbabilities(pFrameState);
+    if (INTEL_HOSTVLD_VP9_PERF_ENABLED(pVp9HostVld))
+    {
+        u64Start = Intel_HostvldVp9_PerfTimeNs();
+    }
+
+    // Key frames reset the current context on their own. When only key frames
+    // are decoded nothing reads the context tables, so skip adaptation too.
+    if (!pVp9HostVld->bKeyFrameOnly)
+    {
+        if (pFrameInfo->bIsIntraOnly || pFrameInfo->bErrorResilientMode)
+        {
+            Intel_HostvldVp9_UpdateContextTables(pVp9HostVld->ContextTable, pFrameInfo);
+        }
 
-    Intel_HostvldVp9_RefreshFrameContext(pVp9HostVld->ContextTable, pFrameInfo);
+        Intel_HostvldVp9_AdaptProbabilities(pFrameState);
+
+        Intel_HostvldVp9_RefreshFrameContext(pVp9HostVld->ContextTable, pFrameInfo);
+    }
+
+    if (INTEL_HOSTVLD_VP9_PERF_ENABLED(pVp9HostVld))
+    {
+        pFrameState->PerfCounters.u64StageTime[INTEL_HOSTVLD_VP9_PERF_STAGE_ADAPTATION] =
+            Intel_HostvldVp9_PerfTimeNs() - u64Start;
+    }
 
     pFrameState->ReferenceFrame.pu16Buffer = pFrameState->pOutputBuffer->ReferenceFrame.pu16Buffer;
     pFrameState->ReferenceFrame.dwSize     = pFrameState->pOutputBuffer->ReferenceFrame.dwSize;
@@ -561,8 +743,16 @@ VAStatus Intel_HostvldVp9_Parser (PVOID pVp9FrameState)
 
 
     eStatus = Intel_HostvldVp9_PreParser(pVp9FrameState);
+    if (eStatus != VA_STATUS_SUCCESS)
+    {
+        return eStatus;
+    }
 
     eStatus = Intel_HostvldVp9_ParseTiles((PINTEL_HOSTVLD_VP9_FRAME_STATE)pVp9FrameState);
+    if (eStatus != VA_STATUS_SUCCESS)
+    {
+        return eStatus;
+    }
 
     if (((PINTEL_HOSTVLD_VP9_FRAME_STATE)pVp9FrameState)->pVp9HostVld->dwThreadNumber == 1)
     {
@@ -613,6 +803,7 @@ VAStatus Intel_HostvldVp9_LoopfilterFrame(PVOID pVp9FrameState)
     PINTEL_HOSTVLD_VP9_FRAME_INFO    pFrameInfo  = NULL;
     PINTEL_HOSTVLD_VP9_TILE_STATE    pTileState  = NULL;
     DWORD                               dwTileX;
+    UINT64                              u64Start    = 0;
     VAStatus                            eStatus     = VA_STATUS_SUCCESS;
 
     pFrameState = (PINTEL_HOSTVLD_VP9_FRAME_STATE)pVp9FrameState;
@@ -621,6 +812,11 @@ VAStatus Intel_HostvldVp9_LoopfilterFrame(PVOID pVp9FrameState)
     pTileState              = pFrameState->pTileStateBase;
     pTileState->pFrameState = pFrameState;
 
+    if (INTEL_HOSTVLD_VP9_PERF_ENABLED(pFrameState->pVp9HostVld))
+    {
+        u64Start = Intel_HostvldVp9_PerfTimeNs();
+    }
+
     // decode tiles
     for (dwTileX = 0; dwTileX < pFrameInfo->dwTileColumns; dwTileX++)
     {
@@ -629,6 +825,12 @@ VAStatus Intel_HostvldVp9_LoopfilterFrame(PVOID pVp9FrameState)
 
     Intel_HostvldVp9_PostLoopFilter(pFrameState);
 
+    if (INTEL_HOSTVLD_VP9_PERF_ENABLED(pFrameState->pVp9HostVld))
+    {
+        pFrameState->PerfCounters.u64StageTime[INTEL_HOSTVLD_VP9_PERF_STAGE_LOOP_FILTER_MASK] =
+            Intel_HostvldVp9_PerfTimeNs() - u64Start;
+    }
+
     return eStatus;
 }
 
@@ -641,6 +843,12 @@ VAStatus Intel_HostvldVp9_Render (PVOID pVp9FrameState)
     pFrameState     = (PINTEL_HOSTVLD_VP9_FRAME_STATE)pVp9FrameState;
     pVp9HostVld     = pFrameState->pVp9HostVld;
 
+    if (INTEL_HOSTVLD_VP9_PERF_ENABLED(pVp9HostVld))
+    {
+        pFrameState->PerfCounters.u64StageTime[INTEL_HOSTVLD_VP9_PERF_STAGE_RENDER] =
+            Intel_HostvldVp9_PerfTimeNs();
+    }
+
     if (pVp9HostVld->pfnRenderCb)
     {
         pVp9HostVld->pfnRenderCb(
@@ -649,6 +857,13 @@ VAStatus Intel_HostvldVp9_Render (PVOID pVp9FrameState)
             pFrameState->dwPrevIndex);
     }
 
+    if (INTEL_HOSTVLD_VP9_PERF_ENABLED(pVp9HostVld))
+    {
+        pFrameState->PerfCounters.u64StageTime[INTEL_HOSTVLD_VP9_PERF_STAGE_RENDER] =
+            Intel_HostvldVp9_PerfTimeNs() - pFrameState->PerfCounters.u64StageTime[INTEL_HOSTVLD_VP9_PERF_STAGE_RENDER];
+        Intel_HostvldVp9_WritePerfCounters(pFrameState);
+    }
+
     return eStatus;
 }
 
@@ -676,7 +891,7 @@ VAStatus Intel_HostvldVp9_Execute (
     pVp9VideoBuffer = pFrameState->pVideoBuffer;
 
     if (pVp9VideoBuffer->slice_data_bo) {
-        dri_bo_unmap(pVp9VideoBuffer->slice_data_bo);
+        media_bo_unmap(pVp9VideoBuffer->slice_data_bo);
 	pVp9VideoBuffer->slice_data_bo = NULL;
     }
 
@@ -739,9 +954,7 @@ VAStatus Intel_HostvldVp9_Destroy (
             {
                 if (pFrameState)
                 {
-                    VP9_ALIGNED_FREE_MEMORY(pFrameState->FrameInfo.pContextAbove);
-                    VP9_ALIGNED_FREE_MEMORY(pFrameState->FrameInfo.EntropyContextAbove.pu8Buffer);
-                    VP9_ALIGNED_FREE_MEMORY(pFrameState->FrameInfo.ModeInfo.pBuffer);
+                    VP9_POOL_FREE_MEMORY(pVp9HostVld->pBufferPool, pFrameState->FrameInfo.Arena.pu8Buffer);
                     VP9_SafeFreeMemory(pFrameState->pTileStateBase);
                 }
                 pFrameState++;
@@ -752,7 +965,7 @@ VAStatus Intel_HostvldVp9_Destroy (
         pEarlyDecBufferBase = pVp9HostVld->pEarlyDecBufferBase;
         for (i = 0; i< pVp9HostVld->ui8BufNumEarlyDec; i++)
         {
-            VP9_ALIGNED_FREE_MEMORY(pEarlyDecBufferBase->LastSegId.pu8Buffer);
+            VP9_POOL_FREE_MEMORY(pVp9HostVld->pBufferPool, pEarlyDecBufferBase->LastSegId.pu8Buffer);
 
             pEarlyDecBufferBase++;
         }
@@ -761,6 +974,11 @@ VAStatus Intel_HostvldVp9_Destroy (
 
         pthread_mutex_destroy(&pVp9HostVld->MutexSync);
 
+        if (pVp9HostVld->pPerfFile && (pVp9HostVld->pPerfFile != stderr))
+        {
+            fclose(pVp9HostVld->pPerfFile);
+        }
+
         free(pVp9HostVld);
     }
 
@@ -31,6 +31,7 @@
 #include "pthread.h"
 #include "media_drv_driver.h"
 #include "intel_hybrid_common_vp9.h"
+#include "intel_hybrid_vp9_buffer_pool.h"
 
 typedef enum _INTEL_HOSTVLD_VP9_YUV_PLANE
 {
@@ -80,6 +81,7 @@ typedef struct _INTEL_HOSTVLD_VP9_VIDEO_BUFFER
     uint32_t                           dwBitsSize;     // bitstream size
 
     BOOL                            bResolutionChanged;
+    uint32_t                           dwReallocCount; // buffers reallocated by the sync callback for this frame
 
     /* Added by Zhao Yakui */
     dri_bo			*slice_data_bo;
@@ -131,8 +133,46 @@ typedef struct _INTEL_HOSTVLD_VP9_CALLBACKS
     PFNINTEL_HOSTVLD_VP9_RENDERCB  pfnHostVldRenderCb;
     PFNINTEL_HOSTVLD_VP9_SYNCCB    pfnHostVldSyncCb;
     void                             *pvStandardState;
+    PINTEL_HYBRID_VP9_BUFFER_POOL    pBufferPool;
+    BOOL                             bKeyFrameOnly;     // only key frames are submitted
 } INTEL_HOSTVLD_VP9_CALLBACKS, *PINTEL_HOSTVLD_VP9_CALLBACKS;
 
+#define INTEL_HOSTVLD_VP9_REF_SLOT_NUM   8
+#define INTEL_HOSTVLD_VP9_ACTIVE_REF_NUM 3
+
+// Frame header fields that can be read from a slice data buffer before the
+// frame is handed to HostVLD, see Intel_HostvldVp9_PeekFrameHeader
+typedef struct _INTEL_HOSTVLD_VP9_FRAME_HEADER_INFO
+{
+    // Input: size of each reference slot. Only used by inter frames which
+    // inherit their size from a reference; leave zero when unknown.
+    uint32_t        dwRefSlotWidth[INTEL_HOSTVLD_VP9_REF_SLOT_NUM];
+    uint32_t        dwRefSlotHeight[INTEL_HOSTVLD_VP9_REF_SLOT_NUM];
+
+    uint32_t        dwProfile;
+    uint32_t        dwBitDepth;             // 0 for inter frames of profile 2/3 (inherited)
+    BOOL            bShowExistingFrame;
+    uint32_t        dwFrameToShow;          // slot index, valid if bShowExistingFrame
+    BOOL            bKeyFrame;
+    BOOL            bIntraOnly;
+    BOOL            bShowFrame;
+    BOOL            bErrorResilientMode;
+    uint32_t        dwRefreshFrameFlags;
+    uint32_t        dwRefFrameIdx[INTEL_HOSTVLD_VP9_ACTIVE_REF_NUM];   // last, golden, altref
+
+    // Fields below are only valid if bSizeKnown
+    BOOL            bSizeKnown;             // FALSE if the size comes from a reference of unknown size
+    uint32_t        dwWidth;
+    uint32_t        dwHeight;
+    uint32_t        dwBaseQIndex;
+    BOOL            bLossless;
+    uint32_t        dwLog2TileColumns;
+    uint32_t        dwLog2TileRows;
+    uint32_t        dwTxMode;               // first syntax element of the compressed header
+    uint32_t        dwUncompressedHeaderSize;
+    uint32_t        dwCompressedHeaderSize;
+} INTEL_HOSTVLD_VP9_FRAME_HEADER_INFO, *PINTEL_HOSTVLD_VP9_FRAME_HEADER_INFO;
+
 // function interface
 //
 VAStatus Intel_HostvldVp9_Create (
@@ -143,6 +183,11 @@ VAStatus Intel_HostvldVp9_QueryBufferSize (
     INTEL_HOSTVLD_VP9_HANDLE         hHostVld,
     uint32_t                            *pdwBufferSize);
 
+// bytes of host memory held by HostVLD for per-frame planes
+VAStatus Intel_HostvldVp9_QueryMemoryUsage (
+    INTEL_HOSTVLD_VP9_HANDLE         hHostVld,
+    uint32_t                            *pdwBytes);
+
 VAStatus Intel_HostvldVp9_SetOutputBuffer (
     INTEL_HOSTVLD_VP9_HANDLE         hHostVld,
     PINTEL_HOSTVLD_VP9_OUTPUT_BUFFER pOutputBuffer);
@@ -157,4 +202,11 @@ VAStatus Intel_HostvldVp9_Execute (
 VAStatus Intel_HostvldVp9_Destroy (
     INTEL_HOSTVLD_VP9_HANDLE         hHostVld);
 
+// Parse the uncompressed header and the transform mode of a frame without
+// touching any HostVLD state; safe to call from any thread.
+VAStatus Intel_HostvldVp9_PeekFrameHeader (
+    const uint8_t                          *pbBitsData,
+    uint32_t                                dwBitsSize,
+    PINTEL_HOSTVLD_VP9_FRAME_HEADER_INFO pHeaderInfo);
+
 #endif // __INTEL_HOSTVLD_VP9_H__
@@ -67,6 +67,8 @@
 #include "media_drv_driver.h"
 #include <pthread.h>
 #include <semaphore.h>
+#include <stdio.h>
+#include <time.h>
 #include "cmrt_api.h"
 #include "intel_hybrid_hostvld_vp9.h"
 #include "intel_hybrid_common_vp9.h"
@@ -697,6 +699,18 @@ typedef struct _INTEL_HOSTVLD_VP9_MB_INFO
     PDWORD  pdwTxTypeLuma;
 } INTEL_HOSTVLD_VP9_MB_INFO, *PINTEL_HOSTVLD_VP9_MB_INFO;
 
+// Offsets of the per-frame host planes inside the frame arena
+typedef struct _INTEL_HOSTVLD_VP9_FRAME_LAYOUT
+{
+    DWORD   dwContextAboveOffset;
+    DWORD   dwContextAboveSize;
+    DWORD   dwEntropyAboveOffset;
+    DWORD   dwEntropyAboveSize;
+    DWORD   dwModeInfoOffset;
+    DWORD   dwModeInfoSize;
+    DWORD   dwTotalSize;
+} INTEL_HOSTVLD_VP9_FRAME_LAYOUT, *PINTEL_HOSTVLD_VP9_FRAME_LAYOUT;
+
 // Frame level info
 typedef struct _INTEL_HOSTVLD_VP9_FRAME_INFO
 {
@@ -748,6 +762,7 @@ typedef struct _INTEL_HOSTVLD_VP9_FRAME_INFO
     PINTEL_HOSTVLD_VP9_FRAME_CONTEXT pContext;
 	INTEL_HOSTVLD_VP9_TILE_INFO      TileInfo[VP9_MAX_TILES];
 
+    INTEL_HOSTVLD_VP9_1D_BUFFER      Arena;     // one allocation backing mode info and above contexts
     INTEL_HOSTVLD_VP9_1D_BUFFER      ModeInfo;
 
 	// Above context related
@@ -804,6 +819,38 @@ typedef struct _INTEL_HOSTVLD_VP9_TASK_USERDATA
     PINTEL_HOSTVLD_VP9_1D_BUFFER     pLastSegIdBuf;
 } INTEL_HOSTVLD_VP9_TASK_USERDATA, *PINTEL_HOSTVLD_VP9_TASK_USERDATA;
 
+// Per-frame decode counters, written out when VA_INTEL_HYBRID_PERF_COUNTERS is set
+typedef enum _INTEL_HOSTVLD_VP9_PERF_STAGE
+{
+    INTEL_HOSTVLD_VP9_PERF_STAGE_PRE_PARSE = 0,
+    INTEL_HOSTVLD_VP9_PERF_STAGE_TILE_PARSE,       // sum of all tile columns
+    INTEL_HOSTVLD_VP9_PERF_STAGE_ADAPTATION,
+    INTEL_HOSTVLD_VP9_PERF_STAGE_LOOP_FILTER_MASK,
+    INTEL_HOSTVLD_VP9_PERF_STAGE_RENDER,
+    INTEL_HOSTVLD_VP9_PERF_STAGE_NUMBER
+} INTEL_HOSTVLD_VP9_PERF_STAGE;
+
+typedef struct _INTEL_HOSTVLD_VP9_PERF_COUNTERS
+{
+    UINT64      u64StageTime[INTEL_HOSTVLD_VP9_PERF_STAGE_NUMBER];  // nanoseconds
+    UINT64      u64TileParseTime[VP9_MAX_TILE_COLUMNS];             // nanoseconds
+    DWORD       dwBitstreamBytes;
+    DWORD       dwCodedSuperBlocks;
+    DWORD       dwSkippedSuperBlocks;                               // no coefficient in the whole 64x64
+    DWORD       dwTokens;
+    DWORD       dwReallocations;
+} INTEL_HOSTVLD_VP9_PERF_COUNTERS, *PINTEL_HOSTVLD_VP9_PERF_COUNTERS;
+
+#define INTEL_HOSTVLD_VP9_PERF_ENABLED(pVp9HostVld) ((pVp9HostVld)->pPerfFile != NULL)
+
+static inline UINT64 Intel_HostvldVp9_PerfTimeNs()
+{
+    struct timespec Time;
+
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return (UINT64)Time.tv_sec * 1000000000ULL + Time.tv_nsec;
+}
+
 struct _INTEL_HOSTVLD_VP9_TILE_STATE
 {
     PINTEL_HOSTVLD_VP9_FRAME_STATE   pFrameState;
@@ -811,6 +858,11 @@ struct _INTEL_HOSTVLD_VP9_TILE_STATE
     INTEL_HOSTVLD_VP9_MB_INFO        MbInfo;
     INTEL_HOSTVLD_VP9_COUNT          Count;
     DWORD                               dwCurrColIndex;
+
+    // always counted, it is one add per block
+    DWORD                               dwCodedSuperBlocks;
+    DWORD                               dwSkippedSuperBlocks;
+    DWORD                               dwTokens;
 };
 
 struct _INTEL_HOSTVLD_VP9_FRAME_STATE
@@ -832,6 +884,8 @@ struct _INTEL_HOSTVLD_VP9_FRAME_STATE
 
     DWORD                               dwLastTaskID;
     INTEL_HOSTVLD_VP9_FRAME_TYPE        LastFrameType;
+
+    INTEL_HOSTVLD_VP9_PERF_COUNTERS     PerfCounters;
 };
 
 typedef struct _INTEL_HOSTVLD_VP9_EARLY_DEC_BUFFER
@@ -883,6 +937,10 @@ struct _INTEL_HOSTVLD_VP9_STATE
     UINT8                                   ui8BufIdxEarlyDec;        //buffer index to pEarlyDecBufferBase
 
     PVOID pvStandardState;
+    PINTEL_HYBRID_VP9_BUFFER_POOL       pBufferPool;              //shared with MDF host, may be NULL
+    BOOL                                bKeyFrameOnly;            //no frame ever depends on the context tables
+    FILE                                *pPerfFile;               //NULL unless VA_INTEL_HYBRID_PERF_COUNTERS is set
+    DWORD                               dwPerfFrameCount;
 
 };
 
@@ -603,6 +603,7 @@ VAStatus Intel_HostvldVp9_ParseIntraFrameModeInfo(
         pTileState->Count.MbSkipCounts[ui8Ctx][ui8SkipCoeff] += pFrameInfo->bFrameParallelDisabled;
     }
     pMode->DW1.ui8Flags = ui8SkipCoeff; // "is inter" flag is FALSE
+    pMode->DW1.ui8FilterType = VP9_INTERP_EIGHTTAP; // unused, but flushed to the output
 
 	// transform size
     Intel_HostvldVp9_ParseTransformSize(pTileState, pMbInfo, pBacEngine, ui8LSkip, ui8ASkip);
@@ -742,6 +743,7 @@ static VAStatus Intel_HostvldVp9_ParseIntraBlockModeInfo(
     pMbInfo->pRefFrameIndex[0] = VP9_REF_FRAME_INTRA;
     pMbInfo->pRefFrameIndex[1] = VP9_REF_FRAME_INTRA;
     VP9_PROP8x8_WORD(pMbInfo->pReferenceFrame, *((PUINT16)pMbInfo->pRefFrameIndex));
+    pMode->DW1.ui8FilterType = VP9_INTERP_EIGHTTAP;
 
     if (pMbInfo->iB4Number >= 4)
     {
@@ -3262,6 +3264,8 @@ finish_block:
 
         // Set skip flag if block >= 8x8 and no non-zero coefficient
         pMbInfo->pMode->DW1.ui8Flags |= (UINT8)((uiEobTotal == 0) && (pMbInfo->iB4Number >= 4) && bIsInterFlag) << VP9_SKIP_FLAG;
+
+        pTileState->dwTokens += uiEobTotal;
     } //!bSkipCoeffFlag
 
     return eStatus;
@@ -3563,6 +3567,7 @@ VAStatus Intel_HostvldVp9_ParseOneTile(
     PINTEL_HOSTVLD_VP9_FRAME_INFO      pFrameInfo;
     PINTEL_HOSTVLD_VP9_MB_INFO         pMbInfo;
     DWORD                              dwB8X, dwB8Y, dwTileBottomB8, dwTileRightB8, dwLineDist;
+    DWORD                              dwTokens;
     VAStatus                           eStatus = VA_STATUS_SUCCESS;
 
     pFrameState                = pTileState->pFrameState;
@@ -3590,12 +3595,23 @@ VAStatus Intel_HostvldVp9_ParseOneTile(
         // Deocde one row
         for (dwB8X = pTileInfo->dwTileLeft; dwB8X < dwTileRightB8; dwB8X += VP9_B64_SIZE_IN_B8)
         {
+            dwTokens = pTileState->dwTokens;
+
             Intel_HostvldVp9_ParseSuperBlock(
                 pTileState, 
                 dwB8X, 
                 dwB8Y, 
                 BLOCK_64X64);
 
+            if (pTileState->dwTokens == dwTokens)
+            {
+                pTileState->dwSkippedSuperBlocks++;
+            }
+            else
+            {
+                pTileState->dwCodedSuperBlocks++;
+            }
+
             pMbInfo->dwMbOffset     += VP9_B64_SIZE;
             pMbInfo->pModeInfoCache += VP9_B64_SIZE;
         }
@@ -3901,8 +3917,28 @@ VAStatus Intel_HostvldVp9_ParseTiles(
     // decode tile columns
     for (dwTileX = 0; dwTileX < pFrameInfo->dwTileColumns; dwTileX++)
     {
-        Intel_HostvldVp9_ParseTileColumn(pTileState, dwTileX);
+        if (INTEL_HOSTVLD_VP9_PERF_ENABLED(pFrameState->pVp9HostVld))
+        {
+            UINT64 u64Start = Intel_HostvldVp9_PerfTimeNs();
+
+            eStatus = Intel_HostvldVp9_ParseTileColumn(pTileState, dwTileX);
+
+            pFrameState->PerfCounters.u64TileParseTime[dwTileX] = Intel_HostvldVp9_PerfTimeNs() - u64Start;
+            pFrameState->PerfCounters.u64StageTime[INTEL_HOSTVLD_VP9_PERF_STAGE_TILE_PARSE] +=
+                pFrameState->PerfCounters.u64TileParseTime[dwTileX];
+        }
+        else
+        {
+            eStatus = Intel_HostvldVp9_ParseTileColumn(pTileState, dwTileX);
+        }
+
+        // a tile that was not parsed leaves its mode info for the loop filter undefined
+        if (eStatus != VA_STATUS_SUCCESS)
+        {
+            goto finish;
+        }
     }
 
+finish:
     return eStatus;
 }
@@ -0,0 +1,423 @@
+/*
+ * Copyright © 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Lightweight VP9 frame header peek.
+ *
+ * Reads the uncompressed header with a plain MSB-first bit reader and the
+ * transform mode at the start of the compressed header with the BAC engine.
+ * Nothing here touches HostVLD frame or tile state, so the scheduler can
+ * call it on a slice data buffer before deciding whether (and with how many
+ * threads) to decode the frame.
+ */
+
+#include <stddef.h>
+#include "intel_hybrid_hostvld_vp9_internal.h"
+#include "intel_hybrid_hostvld_vp9_engine.h"
+
+#define VP9_FRAME_MARKER            2
+#define VP9_SYNC_CODE_0             0x49
+#define VP9_SYNC_CODE_1             0x83
+#define VP9_SYNC_CODE_2             0x42
+#define VP9_CS_SRGB                 7
+#define VP9_MIN_TILE_WIDTH_B64      4
+#define VP9_MAX_TILE_WIDTH_B64      64
+#define VP9_LF_REF_DELTAS           4
+#define VP9_LF_MODE_DELTAS          2
+#define VP9_SEG_TREE_PROBS          7
+#define VP9_SEG_FEATURES            4
+
+typedef struct _INTEL_HOSTVLD_VP9_BIT_READER
+{
+    const UINT8     *pbData;
+    DWORD           dwSize;
+    DWORD           dwBitOffset;
+    BOOL            bOverrun;
+} INTEL_HOSTVLD_VP9_BIT_READER, *PINTEL_HOSTVLD_VP9_BIT_READER;
+
+static const DWORD g_Vp9SegFeatureBits[VP9_SEG_FEATURES]   = { 8, 6, 2, 0 };
+static const BOOL  g_Vp9SegFeatureSigned[VP9_SEG_FEATURES] = { TRUE, TRUE, FALSE, FALSE };
+
+static DWORD Intel_HostvldVp9_PeekReadBits(
+    PINTEL_HOSTVLD_VP9_BIT_READER    pReader,
+    DWORD                               dwNumBits)
+{
+    DWORD   dwValue = 0;
+    DWORD   dwByte;
+
+    while (dwNumBits--)
+    {
+        dwByte = pReader->dwBitOffset >> 3;
+        if (dwByte >= pReader->dwSize)
+        {
+            pReader->bOverrun = TRUE;
+            return 0;
+        }
+        dwValue = (dwValue << 1) | ((pReader->pbData[dwByte] >> (7 - (pReader->dwBitOffset & 7))) & 1);
+        pReader->dwBitOffset++;
+    }
+
+    return dwValue;
+}
+
+#define VP9_PEEK_BITS(n)    Intel_HostvldVp9_PeekReadBits(&Reader, (n))
+#define VP9_PEEK_BIT        Intel_HostvldVp9_PeekReadBits(&Reader, 1)
+
+// signed value: magnitude then sign
+static INT Intel_HostvldVp9_PeekReadSigned(
+    PINTEL_HOSTVLD_VP9_BIT_READER    pReader,
+    DWORD                               dwNumBits)
+{
+    INT iValue = (INT)Intel_HostvldVp9_PeekReadBits(pReader, dwNumBits);
+
+    return Intel_HostvldVp9_PeekReadBits(pReader, 1) ? -iValue : iValue;
+}
+
+static BOOL Intel_HostvldVp9_PeekSyncCode(
+    PINTEL_HOSTVLD_VP9_BIT_READER    pReader)
+{
+    return (Intel_HostvldVp9_PeekReadBits(pReader, 8) == VP9_SYNC_CODE_0) &&
+           (Intel_HostvldVp9_PeekReadBits(pReader, 8) == VP9_SYNC_CODE_1) &&
+           (Intel_HostvldVp9_PeekReadBits(pReader, 8) == VP9_SYNC_CODE_2);
+}
+
+static VOID Intel_HostvldVp9_PeekColorConfig(
+    PINTEL_HOSTVLD_VP9_BIT_READER        pReader,
+    PINTEL_HOSTVLD_VP9_FRAME_HEADER_INFO pHeaderInfo)
+{
+    DWORD   dwColorSpace;
+
+    pHeaderInfo->dwBitDepth = 8;
+    if (pHeaderInfo->dwProfile >= 2)
+    {
+        pHeaderInfo->dwBitDepth = Intel_HostvldVp9_PeekReadBits(pReader, 1) ? 12 : 10;
+    }
+
+    dwColorSpace = Intel_HostvldVp9_PeekReadBits(pReader, 3);
+    if (dwColorSpace != VP9_CS_SRGB)
+    {
+        Intel_HostvldVp9_PeekReadBits(pReader, 1);      // color range
+        if ((pHeaderInfo->dwProfile == 1) || (pHeaderInfo->dwProfile == 3))
+        {
+            Intel_HostvldVp9_PeekReadBits(pReader, 3);  // subsampling x/y, reserved
+        }
+    }
+    else if ((pHeaderInfo->dwProfile == 1) || (pHeaderInfo->dwProfile == 3))
+    {
+        Intel_HostvldVp9_PeekReadBits(pReader, 1);      // reserved
+    }
+}
+
+static VOID Intel_HostvldVp9_PeekFrameSize(
+    PINTEL_HOSTVLD_VP9_BIT_READER        pReader,
+    PINTEL_HOSTVLD_VP9_FRAME_HEADER_INFO pHeaderInfo)
+{
+    pHeaderInfo->dwWidth    = Intel_HostvldVp9_PeekReadBits(pReader, 16) + 1;
+    pHeaderInfo->dwHeight   = Intel_HostvldVp9_PeekReadBits(pReader, 16) + 1;
+    pHeaderInfo->bSizeKnown = TRUE;
+}
+
+static VOID Intel_HostvldVp9_PeekRenderSize(
+    PINTEL_HOSTVLD_VP9_BIT_READER        pReader)
+{
+    if (Intel_HostvldVp9_PeekReadBits(pReader, 1))
+    {
+        Intel_HostvldVp9_PeekReadBits(pReader, 32);
+    }
+}
+
+VAStatus Intel_HostvldVp9_PeekFrameHeader (
+    const uint8_t                          *pbBitsData,
+    uint32_t                                dwBitsSize,
+    PINTEL_HOSTVLD_VP9_FRAME_HEADER_INFO pHeaderInfo)
+{
+    INTEL_HOSTVLD_VP9_BIT_READER     Reader;
+    INTEL_HOSTVLD_VP9_BAC_ENGINE     BacEngine;
+    DWORD                               dwSb64Cols, dwMinLog2, dwMaxLog2;
+    DWORD                               i, j;
+    INT                                 iDeltaQYDc, iDeltaQUvDc, iDeltaQUvAc;
+    VAStatus                            eStatus = VA_STATUS_SUCCESS;
+
+    if ((pbBitsData == NULL) || (pHeaderInfo == NULL) || (dwBitsSize == 0))
+    {
+        return VA_STATUS_ERROR_INVALID_PARAMETER;
+    }
+
+    // keep the caller supplied reference slot sizes, reset everything else
+    memset(&pHeaderInfo->dwProfile, 0,
+        sizeof(*pHeaderInfo) - offsetof(INTEL_HOSTVLD_VP9_FRAME_HEADER_INFO, dwProfile));
+
+    Reader.pbData       = pbBitsData;
+    Reader.dwSize       = dwBitsSize;
+    Reader.dwBitOffset  = 0;
+    Reader.bOverrun     = FALSE;
+
+    if (VP9_PEEK_BITS(2) != VP9_FRAME_MARKER)
+    {
+        eStatus = VA_STATUS_ERROR_INVALID_PARAMETER;
+        goto finish;
+    }
+
+    pHeaderInfo->dwProfile  = VP9_PEEK_BIT;
+    pHeaderInfo->dwProfile |= VP9_PEEK_BIT << 1;
+    if (pHeaderInfo->dwProfile == 3)
+    {
+        VP9_PEEK_BIT;   // reserved
+    }
+
+    pHeaderInfo->bShowExistingFrame = VP9_PEEK_BIT;
+    if (pHeaderInfo->bShowExistingFrame)
+    {
+        pHeaderInfo->dwFrameToShow = VP9_PEEK_BITS(3);
+        pHeaderInfo->bShowFrame    = TRUE;
+        goto finish;
+    }
+
+    pHeaderInfo->bKeyFrame              = !VP9_PEEK_BIT;
+    pHeaderInfo->bShowFrame             = VP9_PEEK_BIT;
+    pHeaderInfo->bErrorResilientMode    = VP9_PEEK_BIT;
+
+    if (pHeaderInfo->bKeyFrame)
+    {
+        if (!Intel_HostvldVp9_PeekSyncCode(&Reader))
+        {
+            eStatus = VA_STATUS_ERROR_INVALID_PARAMETER;
+            goto finish;
+        }
+        Intel_HostvldVp9_PeekColorConfig(&Reader, pHeaderInfo);
+        Intel_HostvldVp9_PeekFrameSize(&Reader, pHeaderInfo);
+        Intel_HostvldVp9_PeekRenderSize(&Reader);
+        pHeaderInfo->dwRefreshFrameFlags = (1 << INTEL_HOSTVLD_VP9_REF_SLOT_NUM) - 1;
+    }
+    else
+    {
+        pHeaderInfo->bIntraOnly = pHeaderInfo->bShowFrame ? FALSE : VP9_PEEK_BIT;
+        if (!pHeaderInfo->bErrorResilientMode)
+        {
+            VP9_PEEK_BITS(2);   // reset frame context
+        }
+
+        if (pHeaderInfo->bIntraOnly)
+        {
+            if (!Intel_HostvldVp9_PeekSyncCode(&Reader))
+            {
+                eStatus = VA_STATUS_ERROR_INVALID_PARAMETER;
+                goto finish;
+            }
+            if (pHeaderInfo->dwProfile > 0)
+            {
+                Intel_HostvldVp9_PeekColorConfig(&Reader, pHeaderInfo);
+            }
+            else
+            {
+                pHeaderInfo->dwBitDepth = 8;
+            }
+            pHeaderInfo->dwRefreshFrameFlags = VP9_PEEK_BITS(INTEL_HOSTVLD_VP9_REF_SLOT_NUM);
+            Intel_HostvldVp9_PeekFrameSize(&Reader, pHeaderInfo);
+            Intel_HostvldVp9_PeekRenderSize(&Reader);
+        }
+        else
+        {
+            // inter frames inherit the bit depth from the sequence
+            pHeaderInfo->dwBitDepth = (pHeaderInfo->dwProfile >= 2) ? 0 : 8;
+            pHeaderInfo->dwRefreshFrameFlags = VP9_PEEK_BITS(INTEL_HOSTVLD_VP9_REF_SLOT_NUM);
+            for (i = 0; i < INTEL_HOSTVLD_VP9_ACTIVE_REF_NUM; i++)
+            {
+                pHeaderInfo->dwRefFrameIdx[i] = VP9_PEEK_BITS(3);
+                VP9_PEEK_BIT;   // sign bias
+            }
+
+            // frame size with refs
+            for (i = 0; i < INTEL_HOSTVLD_VP9_ACTIVE_REF_NUM; i++)
+            {
+                if (VP9_PEEK_BIT)
+                {
+                    j = pHeaderInfo->dwRefFrameIdx[i];
+                    pHeaderInfo->dwWidth    = pHeaderInfo->dwRefSlotWidth[j];
+                    pHeaderInfo->dwHeight   = pHeaderInfo->dwRefSlotHeight[j];
+                    pHeaderInfo->bSizeKnown = (pHeaderInfo->dwWidth > 0) && (pHeaderInfo->dwHeight > 0);
+                    break;
+                }
+            }
+            if (i == INTEL_HOSTVLD_VP9_ACTIVE_REF_NUM)
+            {
+                Intel_HostvldVp9_PeekFrameSize(&Reader, pHeaderInfo);
+            }
+            Intel_HostvldVp9_PeekRenderSize(&Reader);
+
+            // the tile syntax depends on the width; nothing more can be read without it
+            if (!pHeaderInfo->bSizeKnown)
+            {
+                goto finish;
+            }
+
+            VP9_PEEK_BIT;       // allow high precision mv
+            if (!VP9_PEEK_BIT)  // switchable interpolation filter
+            {
+                VP9_PEEK_BITS(2);
+            }
+        }
+    }
+
+    if (!pHeaderInfo->bErrorResilientMode)
+    {
+        VP9_PEEK_BITS(2);       // refresh frame context, frame parallel decoding mode
+    }
+    VP9_PEEK_BITS(2);           // frame context index
+
+    // loop filter
+    VP9_PEEK_BITS(6 + 3);       // level, sharpness
+    if (VP9_PEEK_BIT)           // mode ref delta enabled
+    {
+        if (VP9_PEEK_BIT)       // mode ref delta update
+        {
+            for (i = 0; i < VP9_LF_REF_DELTAS + VP9_LF_MODE_DELTAS; i++)
+            {
+                if (VP9_PEEK_BIT)
+                {
+                    VP9_PEEK_BITS(6 + 1);
+                }
+            }
+        }
+    }
+
+    // quantization
+    pHeaderInfo->dwBaseQIndex = VP9_PEEK_BITS(8);
+    iDeltaQYDc  = VP9_PEEK_BIT ? Intel_HostvldVp9_PeekReadSigned(&Reader, 4) : 0;
+    iDeltaQUvDc = VP9_PEEK_BIT ? Intel_HostvldVp9_PeekReadSigned(&Reader, 4) : 0;
+    iDeltaQUvAc = VP9_PEEK_BIT ? Intel_HostvldVp9_PeekReadSigned(&Reader, 4) : 0;
+    pHeaderInfo->bLossless = (pHeaderInfo->dwBaseQIndex == 0) &&
+        (iDeltaQYDc == 0) && (iDeltaQUvDc == 0) && (iDeltaQUvAc == 0);
+
+    // segmentation
+    if (VP9_PEEK_BIT)
+    {
+        if (VP9_PEEK_BIT)       // update map
+        {
+            for (i = 0; i < VP9_SEG_TREE_PROBS; i++)
+            {
+                if (VP9_PEEK_BIT)
+                {
+                    VP9_PEEK_BITS(8);
+                }
+            }
+            if (VP9_PEEK_BIT)   // temporal update
+            {
+                for (i = 0; i < VP9_SEG_PRED_PROBS; i++)
+                {
+                    if (VP9_PEEK_BIT)
+                    {
+                        VP9_PEEK_BITS(8);
+                    }
+                }
+            }
+        }
+        if (VP9_PEEK_BIT)       // update data
+        {
+            VP9_PEEK_BIT;       // abs or delta
+            for (i = 0; i < VP9_MAX_SEGMENTS; i++)
+            {
+                for (j = 0; j < VP9_SEG_FEATURES; j++)
+                {
+                    if (VP9_PEEK_BIT)
+                    {
+                        VP9_PEEK_BITS(g_Vp9SegFeatureBits[j] + (g_Vp9SegFeatureSigned[j] ? 1 : 0));
+                    }
+                }
+            }
+        }
+    }
+
+    // tile info
+    dwSb64Cols = (ALIGN(pHeaderInfo->dwWidth, 8) >> VP9_LOG2_B8_SIZE);
+    dwSb64Cols = ALIGN(dwSb64Cols, VP9_B64_SIZE_IN_B8) >> VP9_LOG2_B64_SIZE_IN_B8;
+    dwMinLog2  = 0;
+    while ((DWORD)(VP9_MAX_TILE_WIDTH_B64 << dwMinLog2) < dwSb64Cols)
+    {
+        dwMinLog2++;
+    }
+    dwMaxLog2 = 1;
+    while ((dwSb64Cols >> dwMaxLog2) >= VP9_MIN_TILE_WIDTH_B64)
+    {
+        dwMaxLog2++;
+    }
+    dwMaxLog2--;
+
+    pHeaderInfo->dwLog2TileColumns = dwMinLog2;
+    while (pHeaderInfo->dwLog2TileColumns < dwMaxLog2)
+    {
+        if (!VP9_PEEK_BIT)
+        {
+            break;
+        }
+        pHeaderInfo->dwLog2TileColumns++;
+    }
+    pHeaderInfo->dwLog2TileRows = VP9_PEEK_BIT;
+    if (pHeaderInfo->dwLog2TileRows)
+    {
+        pHeaderInfo->dwLog2TileRows += VP9_PEEK_BIT;
+    }
+
+    pHeaderInfo->dwCompressedHeaderSize     = VP9_PEEK_BITS(16);
+    pHeaderInfo->dwUncompressedHeaderSize   = (Reader.dwBitOffset + 7) >> 3;
+
+    if (Reader.bOverrun ||
+        (pHeaderInfo->dwCompressedHeaderSize == 0) ||
+        (pHeaderInfo->dwUncompressedHeaderSize + pHeaderInfo->dwCompressedHeaderSize > dwBitsSize))
+    {
+        eStatus = VA_STATUS_ERROR_INVALID_PARAMETER;
+        goto finish;
+    }
+
+    // Transform mode, the first element of the compressed header. The BAC
+    // engine always loads 4 bytes at init; tile data follows the header so
+    // this only matters for truncated buffers.
+    pHeaderInfo->dwTxMode = ONLY_4X4;
+    if (!pHeaderInfo->bLossless &&
+        (dwBitsSize - pHeaderInfo->dwUncompressedHeaderSize >= sizeof(UINT32)))
+    {
+        if (Intel_HostvldVp9_BacEngineInit(
+                &BacEngine,
+                (PUCHAR)pbBitsData + pHeaderInfo->dwUncompressedHeaderSize,
+                pHeaderInfo->dwCompressedHeaderSize) != 0)
+        {
+            // marker bit must be zero
+            eStatus = VA_STATUS_ERROR_INVALID_PARAMETER;
+            goto finish;
+        }
+        pHeaderInfo->dwTxMode = Intel_HostvldVp9_BacEngineReadMultiBits(&BacEngine, 2);
+        if (pHeaderInfo->dwTxMode == ALLOW_32X32)
+        {
+            pHeaderInfo->dwTxMode += Intel_HostvldVp9_BacEngineReadSingleBit(&BacEngine);
+        }
+    }
+
+finish:
+    if (Reader.bOverrun)
+    {
+        eStatus = VA_STATUS_ERROR_INVALID_PARAMETER;
+    }
+    return eStatus;
+}
@@ -0,0 +1,492 @@
+/*
+ * Copyright © 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <malloc.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include "intel_hybrid_vp9_buffer_pool.h"
+
+static PINTEL_HYBRID_VP9_POOL_BLOCK Intel_HybridVp9_BufferPool_AllocBlock(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool,
+    INTEL_HYBRID_VP9_POOL_TYPE      eType,
+    size_t                          ClassSize)
+{
+    PINTEL_HYBRID_VP9_POOL_BLOCK    pBlock;
+
+    pBlock = (PINTEL_HYBRID_VP9_POOL_BLOCK)calloc(1, sizeof(*pBlock));
+    if (pBlock == NULL)
+    {
+        return NULL;
+    }
+
+    pBlock->pPool       = pPool;
+    pBlock->eType       = eType;
+    pBlock->ClassSize   = ClassSize;
+
+    if (eType == INTEL_HYBRID_VP9_POOL_HOST)
+    {
+        if (ClassSize >= INTEL_HYBRID_VP9_POOL_HUGE_PAGE_SIZE)
+        {
+            // Large planes (mode info of 4K streams) are walked linearly every
+            // frame; back them with transparent huge pages to cut TLB misses.
+            pBlock->pBuffer = memalign(INTEL_HYBRID_VP9_POOL_HUGE_PAGE_SIZE, ClassSize);
+#ifdef MADV_HUGEPAGE
+            if (pBlock->pBuffer)
+            {
+                madvise(pBlock->pBuffer, ClassSize, MADV_HUGEPAGE);
+            }
+#endif
+        }
+        else
+        {
+            pBlock->pBuffer = memalign(INTEL_HYBRID_VP9_POOL_PAGE_SIZE, ClassSize);
+        }
+    }
+    else
+    {
+        MEDIA_DRV_CONTEXT *drv_ctx = (MEDIA_DRV_CONTEXT *) (pPool->ctx->pDriverData);
+        struct drm_i915_gem_caching bo_cache;
+
+        pBlock->bo = media_bo_alloc(drv_ctx->drv_data.bufmgr,
+                                    "Buffer",
+                                    ClassSize, 4096);
+        if (pBlock->bo)
+        {
+            memset(&bo_cache, 0, sizeof(bo_cache));
+            bo_cache.handle = pBlock->bo->handle;
+            bo_cache.caching = I915_CACHING_CACHED;
+
+            drmIoctl(drv_ctx->drv_data.fd, DRM_IOCTL_I915_GEM_SET_CACHING, &bo_cache);
+
+            /* Disable reuse this bo which set I915_CACHING_CACHED on CHV/BSW without LLC.
+             * Otherwise if it was reused and GTT mapped later, SIGBUS when access the GTT virtual addr.
+             */
+            if (IS_CHERRYVIEW(drv_ctx->drv_data.device_id)) {
+                media_bo_disable_reuse(pBlock->bo);
+            }
+
+            media_bo_map(pBlock->bo, 1);
+            pBlock->pBuffer = pBlock->bo->virt;
+        }
+    }
+
+    if (pBlock->pBuffer == NULL)
+    {
+        if (pBlock->bo)
+        {
+            media_bo_unreference(pBlock->bo);
+        }
+        free(pBlock);
+        return NULL;
+    }
+
+    return pBlock;
+}
+
+static void Intel_HybridVp9_BufferPool_FreeBlock(
+    PINTEL_HYBRID_VP9_POOL_BLOCK    pBlock)
+{
+    if (pBlock->bo)
+    {
+        media_bo_unmap(pBlock->bo);
+        media_bo_unreference(pBlock->bo);
+    }
+    else
+    {
+        free(pBlock->pBuffer);
+    }
+
+    free(pBlock);
+}
+
+static void Intel_HybridVp9_BufferPool_FreeBlocks(
+    PINTEL_HYBRID_VP9_POOL_BLOCK    pBlock)
+{
+    PINTEL_HYBRID_VP9_POOL_BLOCK    pNext;
+
+    for (; pBlock; pBlock = pNext)
+    {
+        pNext = pBlock->pNext;
+        Intel_HybridVp9_BufferPool_FreeBlock(pBlock);
+    }
+}
+
+static inline uint32_t Intel_HybridVp9_BufferPool_IndexHash(
+    void                            *pBuffer)
+{
+    return (uint32_t)(((uintptr_t)pBuffer / INTEL_HYBRID_VP9_POOL_PAGE_SIZE) % INTEL_HYBRID_VP9_POOL_INDEX_SIZE);
+}
+
+// Used list and host index bookkeeping, with the mutex held
+static void Intel_HybridVp9_BufferPool_LinkUsed(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool,
+    PINTEL_HYBRID_VP9_POOL_BLOCK    pBlock)
+{
+    PINTEL_HYBRID_VP9_POOL_BLOCK    *ppBucket;
+
+    pBlock->pPrev = NULL;
+    pBlock->pNext = pPool->pUsedList;
+    if (pPool->pUsedList)
+    {
+        pPool->pUsedList->pPrev = pBlock;
+    }
+    pPool->pUsedList = pBlock;
+
+    if (pBlock->eType == INTEL_HYBRID_VP9_POOL_HOST)
+    {
+        ppBucket            = &pPool->pHostIndex[Intel_HybridVp9_BufferPool_IndexHash(pBlock->pBuffer)];
+        pBlock->pIndexNext  = *ppBucket;
+        *ppBucket           = pBlock;
+    }
+}
+
+static void Intel_HybridVp9_BufferPool_UnlinkUsed(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool,
+    PINTEL_HYBRID_VP9_POOL_BLOCK    pBlock)
+{
+    PINTEL_HYBRID_VP9_POOL_BLOCK    *ppBlock;
+
+    if (pBlock->pPrev)
+    {
+        pBlock->pPrev->pNext = pBlock->pNext;
+    }
+    else
+    {
+        pPool->pUsedList = pBlock->pNext;
+    }
+    if (pBlock->pNext)
+    {
+        pBlock->pNext->pPrev = pBlock->pPrev;
+    }
+    pBlock->pPrev = NULL;
+
+    if (pBlock->eType == INTEL_HYBRID_VP9_POOL_HOST)
+    {
+        ppBlock = &pPool->pHostIndex[Intel_HybridVp9_BufferPool_IndexHash(pBlock->pBuffer)];
+        while (*ppBlock != pBlock)
+        {
+            ppBlock = &(*ppBlock)->pIndexNext;
+        }
+        *ppBlock            = pBlock->pIndexNext;
+        pBlock->pIndexNext  = NULL;
+    }
+}
+
+// Unlink cached blocks until the cache fits under the limit, oldest first.
+// Returns the unlinked blocks for the caller to free once the mutex is dropped.
+static PINTEL_HYBRID_VP9_POOL_BLOCK Intel_HybridVp9_BufferPool_Trim(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool)
+{
+    PINTEL_HYBRID_VP9_POOL_BLOCK    *ppBlock, *ppOldest;
+    PINTEL_HYBRID_VP9_POOL_BLOCK    pBlock, pTrimmed;
+
+    pTrimmed = NULL;
+
+    // drop blocks which have been idle for too long
+    ppBlock = &pPool->pFreeList;
+    while (*ppBlock)
+    {
+        pBlock = *ppBlock;
+        if (pPool->dwFrameCount - pBlock->dwLastUse > INTEL_HYBRID_VP9_POOL_IDLE_FRAMES)
+        {
+            *ppBlock = pBlock->pNext;
+            pPool->Stats.CachedBytes -= pBlock->ClassSize;
+            pPool->Stats.dwTrimmed++;
+            pBlock->pNext = pTrimmed;
+            pTrimmed      = pBlock;
+        }
+        else
+        {
+            ppBlock = &pBlock->pNext;
+        }
+    }
+
+    // enforce the cache size limit
+    while (pPool->Stats.CachedBytes > pPool->Stats.MaxCachedBytes)
+    {
+        ppOldest = &pPool->pFreeList;
+        for (ppBlock = &pPool->pFreeList; *ppBlock; ppBlock = &(*ppBlock)->pNext)
+        {
+            if ((int32_t)((*ppBlock)->dwLastUse - (*ppOldest)->dwLastUse) < 0)
+            {
+                ppOldest = ppBlock;
+            }
+        }
+
+        pBlock    = *ppOldest;
+        *ppOldest = pBlock->pNext;
+        pPool->Stats.CachedBytes -= pBlock->ClassSize;
+        pPool->Stats.dwTrimmed++;
+        pBlock->pNext = pTrimmed;
+        pTrimmed      = pBlock;
+    }
+
+    return pTrimmed;
+}
+
+VAStatus Intel_HybridVp9_BufferPool_Init(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool,
+    VADriverContextP                ctx)
+{
+    memset(pPool, 0, sizeof(*pPool));
+    pPool->ctx = ctx;
+    pPool->Stats.MaxCachedBytes = INTEL_HYBRID_VP9_POOL_MIN_CACHED_SIZE;
+    pthread_mutex_init(&pPool->Mutex, NULL);
+    pPool->bInitialized = true;
+
+    return VA_STATUS_SUCCESS;
+}
+
+void Intel_HybridVp9_BufferPool_Destroy(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool)
+{
+    PINTEL_HYBRID_VP9_POOL_BLOCK    pBlock;
+
+    if (!pPool->bInitialized)
+    {
+        return;
+    }
+
+    // Blocks still in use belong to buffers the caller forgot to release.
+    // Free them as well so that nothing outlives the device.
+    while ((pBlock = pPool->pUsedList) != NULL)
+    {
+        Intel_HybridVp9_BufferPool_UnlinkUsed(pPool, pBlock);
+        Intel_HybridVp9_BufferPool_FreeBlock(pBlock);
+    }
+
+    Intel_HybridVp9_BufferPool_FreeBlocks(pPool->pFreeList);
+    pPool->pFreeList = NULL;
+
+    pthread_mutex_destroy(&pPool->Mutex);
+    pPool->bInitialized = false;
+}
+
+size_t Intel_HybridVp9_BufferPool_ClassSize(
+    size_t                          Size)
+{
+    size_t  Pages, Step;
+
+    Pages = (Size + INTEL_HYBRID_VP9_POOL_PAGE_SIZE - 1) / INTEL_HYBRID_VP9_POOL_PAGE_SIZE;
+    if (Pages == 0)
+    {
+        Pages = 1;
+    }
+
+    // 4 classes per power of two: 4, 5, 6, 7, 8, 10, 12, 14, 16, 20, ... pages
+    Step = 1;
+    while ((Step * INTEL_HYBRID_VP9_POOL_CLASS_STEPS * 2) <= Pages)
+    {
+        Step <<= 1;
+    }
+    Pages = (Pages + Step - 1) & ~(Step - 1);
+
+    return Pages * INTEL_HYBRID_VP9_POOL_PAGE_SIZE;
+}
+
+PINTEL_HYBRID_VP9_POOL_BLOCK Intel_HybridVp9_BufferPool_Acquire(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool,
+    INTEL_HYBRID_VP9_POOL_TYPE      eType,
+    size_t                          Size)
+{
+    PINTEL_HYBRID_VP9_POOL_BLOCK    *ppBlock, *ppBest;
+    PINTEL_HYBRID_VP9_POOL_BLOCK    pBlock;
+    size_t                          ClassSize;
+
+    ClassSize = Intel_HybridVp9_BufferPool_ClassSize(Size);
+
+    pthread_mutex_lock(&pPool->Mutex);
+
+    pPool->Stats.dwAcquires++;
+
+    // best fit among cached blocks of the same type which are not too big
+    ppBest = NULL;
+    for (ppBlock = &pPool->pFreeList; *ppBlock; ppBlock = &(*ppBlock)->pNext)
+    {
+        pBlock = *ppBlock;
+        if ((pBlock->eType == eType)          &&
+            (pBlock->ClassSize >= ClassSize)  &&
+            (pBlock->ClassSize <= ClassSize * INTEL_HYBRID_VP9_POOL_MAX_SLACK) &&
+            ((ppBest == NULL) || (pBlock->ClassSize < (*ppBest)->ClassSize)))
+        {
+            ppBest = ppBlock;
+        }
+    }
+
+    if (ppBest)
+    {
+        pBlock  = *ppBest;
+        *ppBest = pBlock->pNext;
+        pPool->Stats.CachedBytes -= pBlock->ClassSize;
+        pPool->Stats.dwHits++;
+    }
+    else
+    {
+        // the allocation may map pages and issue ioctls; don't block other threads on it
+        pthread_mutex_unlock(&pPool->Mutex);
+        pBlock = Intel_HybridVp9_BufferPool_AllocBlock(pPool, eType, ClassSize);
+        if (pBlock == NULL)
+        {
+            return NULL;
+        }
+        pthread_mutex_lock(&pPool->Mutex);
+
+        pPool->Stats.dwMisses++;
+        if (pPool->dwFrameCount > 0)
+        {
+            pPool->Stats.dwReallocations++;
+        }
+    }
+
+    Intel_HybridVp9_BufferPool_LinkUsed(pPool, pBlock);
+    pPool->Stats.InUseBytes += pBlock->ClassSize;
+    if (pPool->Stats.InUseBytes > pPool->Stats.PeakInUseBytes)
+    {
+        pPool->Stats.PeakInUseBytes = pPool->Stats.InUseBytes;
+        pPool->Stats.MaxCachedBytes = pPool->Stats.PeakInUseBytes * INTEL_HYBRID_VP9_POOL_CACHED_WORKING_SETS;
+        if (pPool->Stats.MaxCachedBytes < INTEL_HYBRID_VP9_POOL_MIN_CACHED_SIZE)
+        {
+            pPool->Stats.MaxCachedBytes = INTEL_HYBRID_VP9_POOL_MIN_CACHED_SIZE;
+        }
+    }
+    if (pPool->Stats.InUseBytes + pPool->Stats.CachedBytes > pPool->Stats.PeakBytes)
+    {
+        pPool->Stats.PeakBytes = pPool->Stats.InUseBytes + pPool->Stats.CachedBytes;
+    }
+
+    pthread_mutex_unlock(&pPool->Mutex);
+
+    return pBlock;
+}
+
+void Intel_HybridVp9_BufferPool_Release(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool,
+    PINTEL_HYBRID_VP9_POOL_BLOCK    pBlock)
+{
+    PINTEL_HYBRID_VP9_POOL_BLOCK    pTrimmed;
+
+    if (pBlock == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pPool->Mutex);
+
+    Intel_HybridVp9_BufferPool_UnlinkUsed(pPool, pBlock);
+
+    pPool->Stats.dwReleases++;
+    pPool->Stats.InUseBytes  -= pBlock->ClassSize;
+    pPool->Stats.CachedBytes += pBlock->ClassSize;
+
+    pBlock->dwLastUse = pPool->dwFrameCount;
+    pBlock->pNext     = pPool->pFreeList;
+    pPool->pFreeList  = pBlock;
+
+    pTrimmed = Intel_HybridVp9_BufferPool_Trim(pPool);
+
+    pthread_mutex_unlock(&pPool->Mutex);
+
+    Intel_HybridVp9_BufferPool_FreeBlocks(pTrimmed);
+}
+
+void *Intel_HybridVp9_BufferPool_AllocHost(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool,
+    size_t                          Size)
+{
+    PINTEL_HYBRID_VP9_POOL_BLOCK    pBlock;
+
+    if ((pPool == NULL) || !pPool->bInitialized)
+    {
+        return memalign(INTEL_HYBRID_VP9_POOL_PAGE_SIZE, Size);
+    }
+
+    pBlock = Intel_HybridVp9_BufferPool_Acquire(pPool, INTEL_HYBRID_VP9_POOL_HOST, Size);
+
+    return pBlock ? pBlock->pBuffer : NULL;
+}
+
+void Intel_HybridVp9_BufferPool_FreeHost(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool,
+    void                            *pBuffer)
+{
+    PINTEL_HYBRID_VP9_POOL_BLOCK    pBlock;
+
+    if (pBuffer == NULL)
+    {
+        return;
+    }
+
+    if ((pPool == NULL) || !pPool->bInitialized)
+    {
+        free(pBuffer);
+        return;
+    }
+
+    pthread_mutex_lock(&pPool->Mutex);
+    for (pBlock = pPool->pHostIndex[Intel_HybridVp9_BufferPool_IndexHash(pBuffer)]; pBlock; pBlock = pBlock->pIndexNext)
+    {
+        if (pBlock->pBuffer == pBuffer)
+        {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pPool->Mutex);
+
+    if (pBlock)
+    {
+        Intel_HybridVp9_BufferPool_Release(pPool, pBlock);
+    }
+    else
+    {
+        free(pBuffer);
+    }
+}
+
+void Intel_HybridVp9_BufferPool_Tick(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool)
+{
+    PINTEL_HYBRID_VP9_POOL_BLOCK    pTrimmed;
+
+    if (!pPool->bInitialized)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pPool->Mutex);
+    pPool->dwFrameCount++;
+    pTrimmed = Intel_HybridVp9_BufferPool_Trim(pPool);
+    pthread_mutex_unlock(&pPool->Mutex);
+
+    Intel_HybridVp9_BufferPool_FreeBlocks(pTrimmed);
+}
+
+void Intel_HybridVp9_BufferPool_GetStats(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool,
+    PINTEL_HYBRID_VP9_POOL_STATS    pStats)
+{
+    pthread_mutex_lock(&pPool->Mutex);
+    *pStats = pPool->Stats;
+    pthread_mutex_unlock(&pPool->Mutex);
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright © 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _INTEL_HYBRID_VP9_BUFFER_POOL_H_
+#define _INTEL_HYBRID_VP9_BUFFER_POOL_H_
+
+#include <pthread.h>
+#include "media_drv_driver.h"
+
+/*
+ * Size-class pool for the per-frame planes of the hybrid VP9 decoder.
+ *
+ * Both the MDF host (dri_bo backed kernel buffers) and HostVLD (host
+ * memory for mode info and above contexts) allocate from one pool per
+ * decode context. Requests are rounded up to a size class (4 classes per
+ * power of two pages), and released blocks stay cached until they have
+ * been idle for INTEL_HYBRID_VP9_POOL_IDLE_FRAMES frames or the cached
+ * bytes exceed INTEL_HYBRID_VP9_POOL_CACHED_WORKING_SETS times the largest
+ * amount the decoder has had in use at once. This hysteresis keeps streams
+ * that switch resolution back and forth from hitting the kernel for every
+ * plane on every switch, and the limit follows the frame size instead of
+ * being a fixed number of bytes.
+ *
+ * The pool mutex only protects the lists; new blocks are allocated and
+ * trimmed blocks are freed outside of it.
+ */
+
+#define INTEL_HYBRID_VP9_POOL_PAGE_SIZE          0x1000
+#define INTEL_HYBRID_VP9_POOL_HUGE_PAGE_SIZE     0x200000  // host blocks this large are THP aligned
+#define INTEL_HYBRID_VP9_POOL_CLASS_STEPS        4
+#define INTEL_HYBRID_VP9_POOL_MAX_SLACK          2     // a cached block may be up to 2x the request
+#define INTEL_HYBRID_VP9_POOL_IDLE_FRAMES        256
+#define INTEL_HYBRID_VP9_POOL_CACHED_WORKING_SETS 2     // cache limit, in multiples of the peak in use
+#define INTEL_HYBRID_VP9_POOL_MIN_CACHED_SIZE    (4 * 1024 * 1024)
+#define INTEL_HYBRID_VP9_POOL_INDEX_SIZE         64    // buckets of the host block index
+
+typedef enum _INTEL_HYBRID_VP9_POOL_TYPE
+{
+    INTEL_HYBRID_VP9_POOL_HOST = 0,     // page aligned host memory
+    INTEL_HYBRID_VP9_POOL_BO,           // mapped, CPU cached dri_bo
+    INTEL_HYBRID_VP9_POOL_TYPE_NUMBER
+} INTEL_HYBRID_VP9_POOL_TYPE;
+
+typedef struct _INTEL_HYBRID_VP9_BUFFER_POOL INTEL_HYBRID_VP9_BUFFER_POOL, *PINTEL_HYBRID_VP9_BUFFER_POOL;
+
+typedef struct _INTEL_HYBRID_VP9_POOL_BLOCK
+{
+    struct _INTEL_HYBRID_VP9_POOL_BLOCK     *pNext;
+    struct _INTEL_HYBRID_VP9_POOL_BLOCK     *pPrev;     // used list only
+    struct _INTEL_HYBRID_VP9_POOL_BLOCK     *pIndexNext;// host index chain, while in use
+    PINTEL_HYBRID_VP9_BUFFER_POOL           pPool;      // owner
+    INTEL_HYBRID_VP9_POOL_TYPE              eType;
+    size_t                                  ClassSize;  // bytes actually backing the block
+    uint32_t                                dwLastUse;  // pool frame count when released
+    void                                    *pBuffer;   // CPU address
+    dri_bo                                  *bo;        // NULL for host blocks
+} INTEL_HYBRID_VP9_POOL_BLOCK, *PINTEL_HYBRID_VP9_POOL_BLOCK;
+
+typedef struct _INTEL_HYBRID_VP9_POOL_STATS
+{
+    uint32_t        dwAcquires;         // total requests
+    uint32_t        dwHits;             // served from cached blocks
+    uint32_t        dwMisses;           // new allocations
+    uint32_t        dwReallocations;    // misses after the first frame, i.e. resolution driven
+    uint32_t        dwReleases;
+    uint32_t        dwTrimmed;          // cached blocks returned to the system
+    uint64_t        CachedBytes;
+    uint64_t        InUseBytes;
+    uint64_t        PeakBytes;          // peak of cached + in use
+    uint64_t        PeakInUseBytes;
+    uint64_t        MaxCachedBytes;     // current cache limit
+} INTEL_HYBRID_VP9_POOL_STATS, *PINTEL_HYBRID_VP9_POOL_STATS;
+
+struct _INTEL_HYBRID_VP9_BUFFER_POOL
+{
+    VADriverContextP                        ctx;        // needed for bo blocks only
+    PINTEL_HYBRID_VP9_POOL_BLOCK            pFreeList;
+    PINTEL_HYBRID_VP9_POOL_BLOCK            pUsedList;
+    PINTEL_HYBRID_VP9_POOL_BLOCK            pHostIndex[INTEL_HYBRID_VP9_POOL_INDEX_SIZE];   // used host blocks by address
+    uint32_t                                dwFrameCount;
+    INTEL_HYBRID_VP9_POOL_STATS             Stats;
+    pthread_mutex_t                         Mutex;
+    bool                                    bInitialized;
+};
+
+VAStatus Intel_HybridVp9_BufferPool_Init(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool,
+    VADriverContextP                ctx);
+
+void Intel_HybridVp9_BufferPool_Destroy(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool);
+
+size_t Intel_HybridVp9_BufferPool_ClassSize(
+    size_t                          Size);
+
+PINTEL_HYBRID_VP9_POOL_BLOCK Intel_HybridVp9_BufferPool_Acquire(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool,
+    INTEL_HYBRID_VP9_POOL_TYPE      eType,
+    size_t                          Size);
+
+void Intel_HybridVp9_BufferPool_Release(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool,
+    PINTEL_HYBRID_VP9_POOL_BLOCK    pBlock);
+
+// Host memory helpers; fall back to memalign/free when pPool is NULL
+void *Intel_HybridVp9_BufferPool_AllocHost(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool,
+    size_t                          Size);
+
+void Intel_HybridVp9_BufferPool_FreeHost(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool,
+    void                            *pBuffer);
+
+// Advance the pool clock by one frame and trim idle blocks
+void Intel_HybridVp9_BufferPool_Tick(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool);
+
+void Intel_HybridVp9_BufferPool_GetStats(
+    PINTEL_HYBRID_VP9_BUFFER_POOL   pPool,
+    PINTEL_HYBRID_VP9_POOL_STATS    pStats);
+
+#endif // _INTEL_HYBRID_VP9_BUFFER_POOL_H_
@@ -0,0 +1,121 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Latency of vaCreateContext plus vaDestroyContext:
+ *
+ *   bench_context_create [iterations]
+ *
+ * VP8 encode contexts are created alone, so that each one fills the
+ * kernel BOs, and next to an open context whose kernel BOs they share.
+ * VP9 decode contexts run on the mock CM runtime, which loads programs
+ * for free; the programs each context loads are counted instead. On the
+ * mock bufmgr a BO costs a calloc, so the BOs and programs a context
+ * creates say more of its cost on hardware than the time does.
+ */
+
+#include <stdlib.h>
+#include "test_cmrt.h"
+
+static VOID
+bench (TEST_VA * t, const char *name, VAConfigID config, INT width,
+       INT height, VASurfaceID * surfaces, UINT num_surfaces,
+       UINT iterations)
+{
+  dri_bufmgr *bufmgr = test_va_bufmgr (t);
+  unsigned long long start, elapsed;
+  TEST_CMRT_STATS stats;
+  VAContextID context;
+  UINT bos, i;
+
+  /* the BOs of a context, once the surface pool is warm */
+  for (i = 0; i < 2; i++)
+    {
+      bos = media_bufmgr_mock_num_bos (bufmgr);
+      TEST_CHECK_VA (t->vtable.vaCreateContext (&t->ctx, config, width,
+						height, VA_PROGRESSIVE,
+						surfaces, num_surfaces,
+						&context));
+      bos = media_bufmgr_mock_num_bos (bufmgr) - bos;
+      TEST_CHECK_VA (t->vtable.vaDestroyContext (&t->ctx, context));
+    }
+
+  test_cmrt_reset_stats ();
+  start = test_now_ns ();
+  for (i = 0; i < iterations; i++)
+    {
+      TEST_CHECK_VA (t->vtable.vaCreateContext (&t->ctx, config, width,
+						height, VA_PROGRESSIVE,
+						surfaces, num_surfaces,
+						&context));
+      TEST_CHECK_VA (t->vtable.vaDestroyContext (&t->ctx, context));
+    }
+  elapsed = test_now_ns () - start;
+  test_cmrt_get_stats (&stats);
+
+  printf ("%-26s %9.1f us/context %4u BOs/context %4.1f programs/context\n",
+	  name, (double) elapsed / (iterations * 1e3), bos,
+	  (double) stats.programs / iterations);
+}
+
+int
+main (int argc, char **argv)
+{
+  UINT iterations = argc > 1 ? atoi (argv[1]) : 200;
+  TEST_VP8_ENCODER enc;
+  TEST_VP9_DECODER dec;
+  VASurfaceID surfaces[TEST_VP8_NUM_SURFACES + 1];
+  TEST_VA t;
+  UINT i;
+
+  if (iterations == 0 || !test_va_open (&t))
+    return 1;
+  test_cmrt_enable ();
+
+  TEST_CHECK_VA (test_vp8_encoder_open (&t, &enc, 1920, 1080,
+					VA_HYBRID_ENCODE_OUTPUT_MB_DATA));
+  surfaces[0] = enc.input;
+  for (i = 0; i < TEST_VP8_NUM_SURFACES; i++)
+    surfaces[i + 1] = enc.recon[i];
+  TEST_CHECK_VA (t.vtable.vaDestroyContext (&t.ctx, enc.context));
+  bench (&t, "vp8 encode, alone", enc.config, 1920, 1080, surfaces,
+	 TEST_VP8_NUM_SURFACES + 1, iterations);
+  TEST_CHECK_VA (t.vtable.vaCreateContext (&t.ctx, enc.config, 1920, 1080,
+					   VA_PROGRESSIVE, surfaces,
+					   TEST_VP8_NUM_SURFACES + 1,
+					   &enc.context));
+  bench (&t, "vp8 encode, shared kernels", enc.config, 1920, 1080, surfaces,
+	 TEST_VP8_NUM_SURFACES + 1, iterations);
+  test_vp8_encoder_close (&t, &enc);
+
+  TEST_CHECK_VA (test_vp9_decoder_open (&t, &dec, 1920, 1080,
+					VA_HYBRID_DECODE_MODE_NORMAL));
+  bench (&t, "vp9 decode", dec.config, 1920, 1080, dec.surfaces,
+	 TEST_VP9_NUM_SURFACES, iterations);
+  test_vp9_decoder_close (&t, &dec);
+
+  test_va_close (&t);
+  return 0;
+}
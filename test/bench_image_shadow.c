@@ -0,0 +1,130 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Map-and-read bandwidth of a derived 1080p NV12 image, with and without
+ * the linear shadow:
+ *
+ *   bench_image_shadow [frames]
+ *
+ * Every frame maps the image, sums all its bytes and unmaps it. With the
+ * shadow, the surface is either left alone, so maps skip the detile, or
+ * marked rewritten each frame the way a decode does, so each map detiles
+ * it, or a few rows are changed through the map, so the unmap retiles
+ * them. Every unmap hashes the rows to find the changed ones. On the mock
+ * the BO is cached memory; on hardware the read without a shadow goes
+ * through the uncached GTT mapping and is far slower than shown.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_va.h"
+#include "media_drv_image.h"
+
+#define WIDTH		1920
+#define HEIGHT		1080
+#define DIRTY_ROWS	16
+
+enum
+{
+  BENCH_NO_SHADOW,
+  BENCH_UNCHANGED,
+  BENCH_DECODED,
+  BENCH_WRITTEN,
+};
+
+static const char *const bench_names[] = {
+  "no shadow",
+  "shadow, unchanged",
+  "shadow, decoded",
+  "shadow, rows written",
+};
+
+/* keeps the reads */
+static volatile BYTE bench_sink;
+
+static VOID
+bench (TEST_VA * t, UINT mode, UINT frames)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = test_va_driver (t);
+  struct object_surface *obj_surface;
+  unsigned long long start, elapsed;
+  VASurfaceAttrib attrib;
+  VASurfaceID surface;
+  VAImage image;
+  BYTE sum = 0;
+  UINT frame, i;
+  BYTE *map;
+
+  memset (&attrib, 0, sizeof (attrib));
+  attrib.type = VASurfaceAttribHybridLinearShadow;
+  attrib.flags = VA_SURFACE_ATTRIB_SETTABLE;
+  attrib.value.type = VAGenericValueTypeInteger;
+  attrib.value.value.i = mode != BENCH_NO_SHADOW;
+  TEST_CHECK_VA (t->vtable.vaCreateSurfaces2 (&t->ctx, VA_RT_FORMAT_YUV420,
+					      WIDTH, HEIGHT, &surface, 1,
+					      &attrib, 1));
+  obj_surface = SURFACE (surface);
+  TEST_CHECK_VA (t->vtable.vaDeriveImage (&t->ctx, surface, &image));
+
+  start = test_now_ns ();
+  for (frame = 0; frame < frames; frame++)
+    {
+      if (mode == BENCH_DECODED)
+	obj_surface->generation++;
+      TEST_CHECK_VA (t->vtable.vaMapBuffer (&t->ctx, image.buf,
+					    (VOID **) & map));
+      for (i = 0; i < image.data_size; i++)
+	sum += map[i];
+      if (mode == BENCH_WRITTEN)
+	for (i = 0; i < DIRTY_ROWS; i++)
+	  map[(frame * 7 + i * 61) % HEIGHT * image.pitches[0]]++;
+      TEST_CHECK_VA (t->vtable.vaUnmapBuffer (&t->ctx, image.buf));
+    }
+  elapsed = test_now_ns () - start;
+  bench_sink = sum;
+
+  printf ("%-22s %8.1f MB/s %8.2f ms/frame\n", bench_names[mode],
+	  (double) image.data_size * frames * 1e3 / elapsed,
+	  (double) elapsed / (frames * 1e6));
+  TEST_CHECK_VA (t->vtable.vaDestroyImage (&t->ctx, image.image_id));
+  TEST_CHECK_VA (t->vtable.vaDestroySurfaces (&t->ctx, &surface, 1));
+}
+
+int
+main (int argc, char **argv)
+{
+  UINT frames = argc > 1 ? atoi (argv[1]) : 200;
+  TEST_VA t;
+  UINT mode;
+
+  unsetenv (VA_INTEL_HYBRID_LINEAR_SHADOW_ENV);
+  if (frames == 0 || !test_va_open (&t))
+    return 1;
+  for (mode = BENCH_NO_SHADOW; mode <= BENCH_WRITTEN; mode++)
+    bench (&t, mode, frames);
+  test_va_close (&t);
+  return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Throughput of the vaGetImage/vaPutImage copies on CPU buffers:
+ *
+ *   bench_image_transfer [passes]
+ *
+ * A 1080p NV12 frame, Y tiled with the bit 9 swizzle, is read into and
+ * written back from NV12 and I420 images. A byte at a time detile and a
+ * plain memcpy of the same amount of data are timed next to it, as the
+ * floor and the ceiling.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_va.h"
+#include "media_drv_image.h"
+
+#define WIDTH		1920
+#define HEIGHT		1088
+#define FRAME_SIZE	(WIDTH * HEIGHT * 3 / 2)
+
+static VOID
+surface_layout (MEDIA_IMAGE_LAYOUT * layout, BYTE * base)
+{
+  UINT i;
+
+  memset (layout, 0, sizeof (*layout));
+  layout->fourcc = VA_FOURCC ('N', 'V', '1', '2');
+  layout->num_planes = 2;
+  layout->cpp = 1;
+  for (i = 0; i < 2; i++)
+    {
+      layout->plane[i].base = base;
+      layout->plane[i].offset = i * WIDTH * HEIGHT;
+      layout->plane[i].pitch = WIDTH;
+      layout->plane[i].tiling = I915_TILING_Y;
+      layout->plane[i].swizzle = I915_BIT_6_SWIZZLE_9;
+    }
+}
+
+static VOID
+image_layout (MEDIA_IMAGE_LAYOUT * layout, BYTE * base, UINT fourcc)
+{
+  memset (layout, 0, sizeof (*layout));
+  layout->fourcc = fourcc;
+  layout->cpp = 1;
+  layout->plane[0].base = base;
+  layout->plane[0].pitch = WIDTH;
+  layout->plane[1].base = base;
+  layout->plane[1].offset = WIDTH * HEIGHT;
+  if (fourcc == VA_FOURCC ('N', 'V', '1', '2'))
+    {
+      layout->num_planes = 2;
+      layout->plane[1].pitch = WIDTH;
+    }
+  else
+    {
+      layout->num_planes = 3;
+      layout->plane[1].pitch = WIDTH / 2;
+      layout->plane[2].base = base;
+      layout->plane[2].offset = WIDTH * HEIGHT * 5 / 4;
+      layout->plane[2].pitch = WIDTH / 2;
+    }
+}
+
+/* the whole frame as one Y tiled plane, without the swizzle */
+static VOID
+detile_bytewise (BYTE * dst, const BYTE * src)
+{
+  UINT x, y;
+
+  for (y = 0; y < HEIGHT * 3 / 2; y++)
+    for (x = 0; x < WIDTH; x++)
+      dst[y * WIDTH + x] = src[(y / 32 * (WIDTH / 128) + x / 128) * 4096
+			       + x % 128 / 16 * 512 + y % 32 * 16 + x % 16];
+}
+
+static VOID
+report (const char *name, unsigned long long elapsed, UINT passes)
+{
+  printf ("%-24s %8.1f MB/s %8.2f ms/frame\n", name,
+	  (double) FRAME_SIZE * passes * 1e3 / elapsed,
+	  (double) elapsed / (passes * 1e6));
+}
+
+int
+main (int argc, char **argv)
+{
+  static const UINT fourccs[] = { VA_FOURCC ('N', 'V', '1', '2'),
+    VA_FOURCC ('I', '4', '2', '0')
+  };
+  MEDIA_IMAGE_LAYOUT surface, image;
+  unsigned long long start;
+  BYTE *surface_base, *image_base;
+  UINT passes, pass, i;
+  char name[32];
+
+  passes = argc > 1 ? atoi (argv[1]) : 50;
+  surface_base = aligned_alloc (4096, FRAME_SIZE);
+  image_base = malloc (FRAME_SIZE);
+  if (surface_base == NULL || image_base == NULL || passes == 0)
+    return 1;
+  for (i = 0; i < FRAME_SIZE; i++)
+    surface_base[i] = i * 7 + (i >> 12);
+  memset (image_base, 0, FRAME_SIZE);
+  surface_layout (&surface, surface_base);
+
+  for (i = 0; i < ARRAY_ELEMS (fourccs); i++)
+    {
+      image_layout (&image, image_base, fourccs[i]);
+
+      start = test_now_ns ();
+      for (pass = 0; pass < passes; pass++)
+	media_image_transfer (&image, 0, 0, &surface, 0, 0, WIDTH, HEIGHT);
+      sprintf (name, "get %.4s", (const char *) &fourccs[i]);
+      report (name, test_now_ns () - start, passes);
+
+      start = test_now_ns ();
+      for (pass = 0; pass < passes; pass++)
+	media_image_transfer (&surface, 0, 0, &image, 0, 0, WIDTH, HEIGHT);
+      sprintf (name, "put %.4s", (const char *) &fourccs[i]);
+      report (name, test_now_ns () - start, passes);
+    }
+
+  start = test_now_ns ();
+  for (pass = 0; pass < passes; pass++)
+    detile_bytewise (image_base, surface_base);
+  report ("bytewise detile", test_now_ns () - start, passes);
+
+  start = test_now_ns ();
+  for (pass = 0; pass < passes; pass++)
+    memcpy (image_base, surface_base, FRAME_SIZE);
+  report ("memcpy", test_now_ns () - start, passes);
+
+  free (surface_base);
+  free (image_base);
+  return 0;
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Cost of the parameter buffers of a frame:
+ *
+ *   bench_va_buffers [frames [threads]]
+ *
+ * First the block allocator alone: the buffer store and payload sizes of a
+ * VP8 encode frame, allocated and freed with the slab and with calloc.
+ * Then whole CreateBuffer/BeginPicture/RenderPicture/DestroyBuffer cycles
+ * of those buffers, without EndPicture, on one VP8 encode context per
+ * thread of one driver instance on the mock.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_va.h"
+#include "media_drv_slab.h"
+
+#define NUM_BUFFERS	5
+
+typedef struct _bench_thread
+{
+  pthread_t thread;
+  TEST_VA *t;
+  BOOL slab;
+  UINT frames;
+  VAContextID context;
+  VASurfaceID input;
+} BENCH_THREAD;
+
+static const UINT payload_sizes[NUM_BUFFERS] = {
+  sizeof (VAEncSequenceParameterBufferVP8),
+  sizeof (VAEncPictureParameterBufferVP8),
+  sizeof (VAQMatrixBufferVP8),
+  sizeof (VAEncMiscParameterBuffer) + sizeof (VAEncMiscParameterFrameRate),
+  sizeof (VAEncMiscParameterBuffer) + sizeof (VAEncMiscParameterRateControl),
+};
+
+static VOID *
+alloc_main (VOID * arg)
+{
+  BENCH_THREAD *b = (BENCH_THREAD *) arg;
+  VOID *blocks[NUM_BUFFERS];
+  UINT frame, i;
+
+  for (frame = 0; frame < b->frames; frame++)
+    {
+      for (i = 0; i < NUM_BUFFERS; i++)
+	{
+	  UINT size = MEDIA_BUFFER_STORE_SIZE + payload_sizes[i];
+
+	  blocks[i] = b->slab ? media_slab_alloc (&test_va_driver (b->t)->slab,
+						  size) : calloc (1, size);
+	  ((BYTE *) blocks[i])[size - 1] = frame;
+	}
+      for (i = 0; i < NUM_BUFFERS; i++)
+	{
+	  if (b->slab)
+	    media_slab_free (blocks[i]);
+	  else
+	    free (blocks[i]);
+	}
+    }
+  return NULL;
+}
+
+static VOID *
+render_main (VOID * arg)
+{
+  BENCH_THREAD *b = (BENCH_THREAD *) arg;
+  struct VADriverVTable *vtable = &b->t->vtable;
+  VADriverContextP ctx = &b->t->ctx;
+  BYTE payload[NUM_BUFFERS][256];
+  VAEncMiscParameterBuffer *misc;
+  VABufferID buffers[NUM_BUFFERS];
+  VABufferType types[NUM_BUFFERS] = { VAEncSequenceParameterBufferType,
+    VAEncPictureParameterBufferType, VAQMatrixBufferType,
+    VAEncMiscParameterBufferType, VAEncMiscParameterBufferType
+  };
+  UINT frame, i;
+
+  memset (payload, 0, sizeof (payload));
+  misc = (VAEncMiscParameterBuffer *) payload[3];
+  misc->type = VAEncMiscParameterTypeFrameRate;
+  ((VAEncMiscParameterFrameRate *) misc->data)->framerate = 30;
+  misc = (VAEncMiscParameterBuffer *) payload[4];
+  misc->type = VAEncMiscParameterTypeRateControl;
+  ((VAEncMiscParameterRateControl *) misc->data)->bits_per_second = 1000000;
+
+  for (frame = 0; frame < b->frames; frame++)
+    {
+      for (i = 0; i < NUM_BUFFERS; i++)
+	TEST_CHECK_VA (vtable->vaCreateBuffer (ctx, b->context, types[i],
+					       payload_sizes[i], 1,
+					       payload[i], &buffers[i]));
+      TEST_CHECK_VA (vtable->vaBeginPicture (ctx, b->context, b->input));
+      TEST_CHECK_VA (vtable->vaRenderPicture (ctx, b->context, buffers,
+					      NUM_BUFFERS));
+      for (i = 0; i < NUM_BUFFERS; i++)
+	TEST_CHECK_VA (vtable->vaDestroyBuffer (ctx, buffers[i]));
+    }
+  return NULL;
+}
+
+static VOID
+run (BENCH_THREAD * threads, UINT num_threads, VOID * (*main) (VOID *),
+     const char *name)
+{
+  unsigned long long start, elapsed;
+  UINT i;
+
+  start = test_now_ns ();
+  for (i = 0; i < num_threads; i++)
+    TEST_CHECK (pthread_create (&threads[i].thread, NULL, main,
+				&threads[i]) == 0);
+  for (i = 0; i < num_threads; i++)
+    pthread_join (threads[i].thread, NULL);
+  elapsed = test_now_ns () - start;
+
+  printf ("%-16s %u threads %10.0f frames/s %10.0f buffers/s\n", name,
+	  num_threads,
+	  (double) threads[0].frames * num_threads * 1e9 / elapsed,
+	  (double) threads[0].frames * num_threads * NUM_BUFFERS * 1e9 /
+	  elapsed);
+}
+
+int
+main (int argc, char **argv)
+{
+  UINT frames = argc > 1 ? atoi (argv[1]) : 200000;
+  UINT num_threads = argc > 2 ? atoi (argv[2]) : 4;
+  TEST_VP8_ENCODER *encoders;
+  BENCH_THREAD *threads;
+  TEST_VA t;
+  UINT i;
+
+  if (frames == 0 || num_threads == 0 || !test_va_open (&t))
+    return 1;
+  threads = calloc (num_threads, sizeof (*threads));
+  encoders = calloc (num_threads, sizeof (*encoders));
+  TEST_CHECK (threads && encoders);
+  for (i = 0; i < num_threads; i++)
+    {
+      TEST_CHECK_VA (test_vp8_encoder_open (&t, &encoders[i], 176, 144,
+					    VA_HYBRID_ENCODE_OUTPUT_MB_DATA));
+      threads[i].t = &t;
+      threads[i].frames = frames;
+      threads[i].context = encoders[i].context;
+      threads[i].input = encoders[i].input;
+    }
+
+  run (threads, 1, alloc_main, "calloc");
+  run (threads, num_threads, alloc_main, "calloc");
+  for (i = 0; i < num_threads; i++)
+    threads[i].slab = TRUE;
+  run (threads, 1, alloc_main, "slab");
+  run (threads, num_threads, alloc_main, "slab");
+  run (threads, 1, render_main, "render cycle");
+  run (threads, num_threads, render_main, "render cycle");
+
+  for (i = 0; i < num_threads; i++)
+    test_vp8_encoder_close (&t, &encoders[i]);
+  test_va_close (&t);
+  free (encoders);
+  free (threads);
+  return 0;
+}
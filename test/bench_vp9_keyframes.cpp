@@ -0,0 +1,134 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Key frames per second through HostVLD on a synthetic 1080p stream:
+ *
+ *   bench_vp9_keyframes [frames [gop]]
+ *
+ * The normal mode has to parse every frame to reach the key frames, the
+ * key frame only mode is handed the key frames alone, the way the decoder
+ * drops the others before they reach HostVLD.
+ */
+
+#include <stdlib.h>
+#include "test_vp9_hostvld.h"
+
+#define WIDTH			1920
+#define HEIGHT			1080
+#define KEY_TILE_BYTES		(192 * 1024)
+#define INTER_TILE_BYTES	(32 * 1024)
+#define MAX_FRAME_SIZE		(KEY_TILE_BYTES + 1024)
+
+typedef struct _bench_frame
+{
+  TEST_VP9_FRAME f;
+  BYTE *data;
+  UINT size;
+} BENCH_FRAME;
+
+static VOID
+make_frame (UINT n, UINT gop, BENCH_FRAME * frame)
+{
+  TEST_VP9_FRAME *f = &frame->f;
+
+  memset (f, 0, sizeof (*f));
+  f->width = WIDTH;
+  f->height = HEIGHT;
+  f->key_frame = n % gop == 0;
+  f->show_frame = TRUE;
+  f->refresh_frame_flags = f->key_frame ? 0xff : 0x01;
+  f->ref_frame_idx[1] = 1;
+  f->ref_frame_idx[2] = 2;
+  f->size_from_ref = 0;
+  f->interp_filter = 4;
+  f->filter_level = 20;
+  f->lf_deltas = TRUE;
+  f->base_q_idx = 40 + n % 60;
+  f->log2_tile_cols = 2;
+  f->tx_mode = 4;
+
+  frame->data = (BYTE *) malloc (MAX_FRAME_SIZE);
+  TEST_CHECK (frame->data != NULL);
+  frame->size = test_vp9_write_tiled_frame (f, f->key_frame ? KEY_TILE_BYTES
+					    : INTER_TILE_BYTES, n,
+					    frame->data, MAX_FRAME_SIZE);
+}
+
+/* Returns the key frames decoded per second. */
+static double
+run (BENCH_FRAME * frames, UINT num_frames, BOOL key_frame_only)
+{
+  TEST_HOSTVLD h;
+  unsigned long long start;
+  UINT n, key_frames = 0;
+
+  TEST_CHECK (test_hostvld_open (&h, key_frame_only));
+  start = test_now_ns ();
+  for (n = 0; n < num_frames; n++)
+    {
+      if (key_frame_only && !frames[n].f.key_frame)
+	continue;
+      TEST_CHECK_VA (test_hostvld_decode (&h, &frames[n].f, frames[n].data,
+					  frames[n].size));
+      key_frames += frames[n].f.key_frame;
+    }
+  start = test_now_ns () - start;
+  test_hostvld_close (&h);
+  return key_frames * 1e9 / start;
+}
+
+int
+main (int argc, char **argv)
+{
+  UINT num_frames = argc > 1 ? atoi (argv[1]) : 240;
+  UINT gop = argc > 2 ? atoi (argv[2]) : 30;
+  BENCH_FRAME *frames;
+  double normal, key_only;
+  UINT n;
+
+  if (num_frames == 0 || gop == 0)
+    {
+      fprintf (stderr, "usage: %s [frames [gop]]\n", argv[0]);
+      return 1;
+    }
+  frames = (BENCH_FRAME *) calloc (num_frames, sizeof (*frames));
+  TEST_CHECK (frames != NULL);
+  for (n = 0; n < num_frames; n++)
+    make_frame (n, gop, &frames[n]);
+
+  normal = run (frames, num_frames, FALSE);
+  key_only = run (frames, num_frames, TRUE);
+  printf ("%ux%u, %u frames, key frame every %u\n", WIDTH, HEIGHT,
+	  num_frames, gop);
+  printf ("normal:         %8.1f key frames/s\n", normal);
+  printf ("key frame only: %8.1f key frames/s (%.1fx)\n", key_only,
+	  key_only / normal);
+
+  for (n = 0; n < num_frames; n++)
+    free (frames[n].data);
+  free (frames);
+  return 0;
+}
@@ -0,0 +1,277 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Throughput of Intel_HostvldVp9_PeekFrameHeader over an IVF file:
+ *
+ *   bench_vp9_peek [file.ivf [passes]]
+ *
+ * Superframes are split with their index, and the reference slot sizes
+ * are tracked the way a scheduler would, so inter frames that inherit
+ * their size are peeked all the way to the transform mode. Without a file
+ * a synthetic 1080p stream is used.
+ */
+
+#include <stdlib.h>
+#include "test_va.h"
+#include "intel_hybrid_hostvld_vp9.h"
+
+#define IVF_FILE_HEADER_SIZE	32
+#define IVF_FRAME_HEADER_SIZE	12
+#define SYNTHETIC_FRAMES	3000
+
+typedef struct _bench_frame
+{
+  const BYTE *data;
+  UINT size;
+} BENCH_FRAME;
+
+static UINT
+get_le32 (const BYTE * p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((UINT) p[3] << 24);
+}
+
+static VOID
+put_le32 (BYTE * p, UINT value)
+{
+  p[0] = value;
+  p[1] = value >> 8;
+  p[2] = value >> 16;
+  p[3] = value >> 24;
+}
+
+static BYTE *
+read_file (const char *path, UINT * size)
+{
+  FILE *file = fopen (path, "rb");
+  BYTE *data;
+  long length;
+
+  if (file == NULL)
+    return NULL;
+  fseek (file, 0, SEEK_END);
+  length = ftell (file);
+  fseek (file, 0, SEEK_SET);
+  data = (BYTE *) malloc (length);
+  if (data && fread (data, 1, length, file) != (size_t) length)
+    {
+      free (data);
+      data = NULL;
+    }
+  fclose (file);
+  *size = length;
+  return data;
+}
+
+/* A 1080p stream: a key frame every 120 frames, inter frames taking their
+ * size from LAST, and a hidden altref every 8 frames packed into a
+ * superframe with the frame after it, the way libvpx writes them. */
+static BYTE *
+synthetic_ivf (UINT * size)
+{
+  TEST_VP9_FRAME f;
+  BYTE *ivf, *p, *q;
+  UINT n, frame_size, hidden_size = 0;
+
+  ivf = (BYTE *) malloc (IVF_FILE_HEADER_SIZE
+			 + SYNTHETIC_FRAMES * (IVF_FRAME_HEADER_SIZE + 512 + 6));
+  memset (ivf, 0, IVF_FILE_HEADER_SIZE);
+  memcpy (ivf, "DKIF", 4);
+  memcpy (ivf + 8, "VP90", 4);
+  p = ivf + IVF_FILE_HEADER_SIZE;
+  for (n = 0; n < SYNTHETIC_FRAMES; n++)
+    {
+      memset (&f, 0, sizeof (f));
+      f.key_frame = n % 120 == 0;
+      f.show_frame = n % 8 != 7;
+      f.width = 1920;
+      f.height = 1080;
+      f.refresh_frame_flags = f.show_frame ? 0x01 : 0x04;
+      f.ref_frame_idx[1] = 1;
+      f.ref_frame_idx[2] = 2;
+      f.size_from_ref = 0;
+      f.interp_filter = 4;
+      f.filter_level = 20;
+      f.lf_deltas = TRUE;
+      f.base_q_idx = 40 + n % 60;
+      f.segmentation = n % 4 == 0;
+      f.log2_tile_cols = 2;
+      f.tx_mode = 4;
+      f.tile_bytes = 256;
+      q = p + IVF_FRAME_HEADER_SIZE + hidden_size;
+      frame_size = test_vp9_write_frame (&f, q, 512);
+      if (!f.show_frame)
+	{
+	  hidden_size = frame_size;
+	  continue;
+	}
+      if (hidden_size)
+	{
+	  /* index: marker, two 16-bit sizes, marker */
+	  q += frame_size;
+	  q[0] = q[5] = 0xc0 | (1 << 3) | 1;
+	  q[1] = hidden_size;
+	  q[2] = hidden_size >> 8;
+	  q[3] = frame_size;
+	  q[4] = frame_size >> 8;
+	  frame_size += hidden_size + 6;
+	  hidden_size = 0;
+	}
+      put_le32 (p, frame_size);
+      memset (p + 4, 0, 8);
+      p += IVF_FRAME_HEADER_SIZE + frame_size;
+    }
+  *size = p - ivf;
+  return ivf;
+}
+
+/* Splits one IVF frame into its VP9 frames using the superframe index. */
+static UINT
+split_superframe (const BYTE * data, UINT size, BENCH_FRAME * frames)
+{
+  BYTE marker = data[size - 1];
+  UINT num_frames, mag, index_size, offset, i, j, frame_size;
+
+  if ((marker & 0xe0) == 0xc0)
+    {
+      num_frames = (marker & 0x7) + 1;
+      mag = ((marker >> 3) & 0x3) + 1;
+      index_size = 2 + mag * num_frames;
+      if (size >= index_size && data[size - index_size] == marker)
+	{
+	  const BYTE *index = data + size - index_size + 1;
+
+	  offset = 0;
+	  for (i = 0; i < num_frames; i++)
+	    {
+	      frame_size = 0;
+	      for (j = 0; j < mag; j++)
+		frame_size |= index[i * mag + j] << (8 * j);
+	      if (offset + frame_size > size - index_size)
+		break;
+	      frames[i].data = data + offset;
+	      frames[i].size = frame_size;
+	      offset += frame_size;
+	    }
+	  return i;
+	}
+    }
+  frames[0].data = data;
+  frames[0].size = size;
+  return 1;
+}
+
+static UINT
+collect_frames (const BYTE * ivf, UINT ivf_size, BENCH_FRAME ** out)
+{
+  BENCH_FRAME *frames = NULL;
+  UINT num = 0, alloc = 0, offset, size;
+
+  offset = get_le32 (ivf + 4) >> 16;	/* header length */
+  if (offset < IVF_FILE_HEADER_SIZE)
+    offset = IVF_FILE_HEADER_SIZE;
+  while (offset + IVF_FRAME_HEADER_SIZE <= ivf_size)
+    {
+      size = get_le32 (ivf + offset);
+      offset += IVF_FRAME_HEADER_SIZE;
+      if (size == 0 || offset + size > ivf_size)
+	break;
+      if (num + 8 > alloc)
+	{
+	  alloc = alloc ? alloc * 2 : 1024;
+	  frames = (BENCH_FRAME *) realloc (frames, alloc * sizeof (*frames));
+	}
+      num += split_superframe (ivf + offset, size, frames + num);
+      offset += size;
+    }
+  *out = frames;
+  return num;
+}
+
+int
+main (int argc, char **argv)
+{
+  INTEL_HOSTVLD_VP9_FRAME_HEADER_INFO info;
+  BENCH_FRAME *frames;
+  BYTE *ivf;
+  UINT ivf_size, num_frames, passes, pass, i, slot;
+  UINT keys = 0, hidden = 0, unknown = 0, errors = 0;
+  unsigned long long bytes = 0, start, elapsed;
+
+  ivf = argc > 1 ? read_file (argv[1], &ivf_size) : synthetic_ivf (&ivf_size);
+  if (ivf == NULL || ivf_size < IVF_FILE_HEADER_SIZE
+      || memcmp (ivf, "DKIF", 4) != 0)
+    {
+      fprintf (stderr, "%s: not an IVF file\n", argc > 1 ? argv[1] : "");
+      return 1;
+    }
+  passes = argc > 2 ? atoi (argv[2]) : 20;
+  num_frames = collect_frames (ivf, ivf_size, &frames);
+  if (num_frames == 0)
+    {
+      fprintf (stderr, "no frames\n");
+      return 1;
+    }
+
+  memset (&info, 0, sizeof (info));
+  start = test_now_ns ();
+  for (pass = 0; pass < passes; pass++)
+    for (i = 0; i < num_frames; i++)
+      {
+	if (Intel_HostvldVp9_PeekFrameHeader (frames[i].data, frames[i].size,
+					      &info) != VA_STATUS_SUCCESS)
+	  {
+	    errors++;
+	    continue;
+	  }
+	bytes += info.dwUncompressedHeaderSize + info.dwCompressedHeaderSize;
+	if (pass == 0)
+	  {
+	    keys += info.bKeyFrame;
+	    hidden += !info.bShowFrame;
+	    unknown += !info.bSizeKnown;
+	  }
+	if (info.bShowExistingFrame || !info.bSizeKnown)
+	  continue;
+	for (slot = 0; slot < INTEL_HOSTVLD_VP9_REF_SLOT_NUM; slot++)
+	  if (info.dwRefreshFrameFlags & (1 << slot))
+	    {
+	      info.dwRefSlotWidth[slot] = info.dwWidth;
+	      info.dwRefSlotHeight[slot] = info.dwHeight;
+	    }
+      }
+  elapsed = test_now_ns () - start;
+
+  printf ("%u frames (%u key, %u hidden, %u of unknown size, %u errors) x %u passes\n",
+	  num_frames, keys, hidden, unknown, errors / passes, passes);
+  printf ("%.0f frames/s, %.1f ns/frame, %.1f MB/s of headers\n",
+	  (double) num_frames * passes * 1e9 / elapsed,
+	  (double) elapsed / ((double) num_frames * passes),
+	  (double) bytes * 1e3 / elapsed);
+  free (frames);
+  free (ivf);
+  return 0;
+}
@@ -0,0 +1,341 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * The command list of a whole VP8 I frame and P frame, decoded from the
+ * one batch the mock records for each. The pipeline is selected once, and
+ * every later phase opens with a media state flush. The caches are
+ * flushed and invalidated ahead of a later phase only when it depends on
+ * the one before. A state command is only emitted where the phase needs
+ * other state than the batch holds, and each phase runs on the binding
+ * table and VFE state of its own kernel. Phases recorded by hand cover
+ * the phase that depends on nothing, which no frame on this device has.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_va.h"
+#include "media_drv_hwcmds.h"
+#include "media_drv_encoder.h"
+
+#define MAX_PHASES	16
+
+/*
+ * What a phase expects to run on. The binding tables only live for the
+ * frame, so they are told apart by number.
+ */
+typedef struct _expected_phase
+{
+  MEDIA_GPE_CTX *gpe_context;
+  UINT binding_table;
+  BOOL dependent;
+} EXPECTED_PHASE;
+
+/* the commands in front of a walker, and the state it runs on */
+typedef struct _phase
+{
+  UINT pipeline_selects;
+  UINT state_flushes;
+  UINT write_flushes;
+  UINT read_flushes;
+  UINT sba, vfe, curbe_load, id_load;	/* emitted in this phase */
+  UINT sba_targets[3];		/* surface, dynamic, instruction state */
+  UINT vfe_dw[MEDIA_GPE_STATE_CMDS_DWORDS];
+  UINT vfe_len;
+  UINT curbe_dw[4];
+  UINT id_dw[4];
+} PHASE;
+
+static UINT
+reloc_target (const MEDIA_MOCK_EXEC * exec, UINT dw)
+{
+  UINT i;
+
+  for (i = 0; i < exec->num_relocs; i++)
+    if (exec->relocs[i].offset == dw * 4)
+      return exec->relocs[i].target_handle;
+  return 0;
+}
+
+/* Returns the number of phases, the state carried from one to the next. */
+static UINT
+decode_exec (const MEDIA_MOCK_EXEC * exec, PHASE * phases)
+{
+  PHASE cur;
+  UINT i, len, op, n = 0;
+
+  memset (&cur, 0, sizeof (cur));
+  for (i = 0; i < exec->used / 4; i += len)
+    {
+      len = test_cmd_len (exec->cmds[i]);
+      op = test_cmd_op (exec->cmds[i]);
+      if (op == CMD_PIPELINE_SELECT)
+	cur.pipeline_selects++;
+      else if (op == CMD_MEDIA_STATE_FLUSH)
+	cur.state_flushes++;
+      else if (op == test_cmd_op (CMD_PIPE_CONTROL))
+	{
+	  /* a write flush must come right before its read invalidate */
+	  if (exec->cmds[i + 1] & CMD_PIPE_CONTROL_DC_FLUSH)
+	    cur.write_flushes++;
+	  else if (exec->cmds[i + 1] & CMD_PIPE_CONTROL_INSTR_CI_ENABLE)
+	    {
+	      TEST_CHECK (cur.write_flushes == cur.read_flushes + 1);
+	      cur.read_flushes++;
+	    }
+	}
+      else if (op == CMD_STATE_BASE_ADDRESS)
+	{
+	  cur.sba++;
+	  cur.sba_targets[0] = reloc_target (exec, i + 2);
+	  cur.sba_targets[1] = reloc_target (exec, i + 3);
+	  cur.sba_targets[2] = reloc_target (exec, i + 5);
+	}
+      else if (op == CMD_MEDIA_VFE_STATE)
+	{
+	  TEST_CHECK (len <= MEDIA_GPE_STATE_CMDS_DWORDS);
+	  cur.vfe++;
+	  cur.vfe_len = len;
+	  memcpy (cur.vfe_dw, exec->cmds + i, len * sizeof (UINT));
+	}
+      else if (op == CMD_MEDIA_CURBE_LOAD)
+	{
+	  TEST_CHECK (len == 4);
+	  cur.curbe_load++;
+	  memcpy (cur.curbe_dw, exec->cmds + i, sizeof (cur.curbe_dw));
+	}
+      else if (op == CMD_MEDIA_INTERFACE_LOAD)
+	{
+	  TEST_CHECK (len == 4);
+	  cur.id_load++;
+	  memcpy (cur.id_dw, exec->cmds + i, sizeof (cur.id_dw));
+	}
+      else if (op == CMD_MEDIA_OBJECT_WALKER)
+	{
+	  TEST_CHECK (n < MAX_PHASES);
+	  phases[n++] = cur;
+	  cur.pipeline_selects = cur.state_flushes = 0;
+	  cur.write_flushes = cur.read_flushes = 0;
+	  cur.sba = cur.vfe = cur.curbe_load = cur.id_load = 0;
+	}
+      else if (op == MI_BATCH_BUFFER_END)
+	break;
+    }
+  /* nothing but flushes after the last walker */
+  TEST_CHECK (cur.pipeline_selects == 0);
+  TEST_CHECK (cur.sba + cur.vfe + cur.curbe_load + cur.id_load == 0);
+  return n;
+}
+
+static VOID
+check_phases (const MEDIA_MOCK_EXEC * exec, const EXPECTED_PHASE * expected,
+	      UINT num_expected)
+{
+  PHASE phases[MAX_PHASES];
+  UINT sba_changes = 0, vfe_changes = 0, curbe_changes = 0, id_changes = 0;
+  UINT sba = 0, vfe = 0, curbe_load = 0, id_load = 0;
+  UINT pipeline_selects = 0, j, k;
+
+  TEST_CHECK (decode_exec (exec, phases) == num_expected);
+  for (k = 0; k < num_expected; k++)
+    {
+      const PHASE *p = &phases[k], *prev = k ? &phases[k - 1] : NULL;
+      MEDIA_GPE_CTX *gpe_context = expected[k].gpe_context;
+      MEDIA_GPE_STATE_CMDS *cmds = &gpe_context->state_cmds;
+      BOOL sba_changed, vfe_changed;
+
+      pipeline_selects += p->pipeline_selects;
+      if (k == 0)
+	{
+	  TEST_CHECK (p->pipeline_selects == 1);
+	  TEST_CHECK (p->state_flushes == 0);
+	  TEST_CHECK (p->write_flushes == 1 && p->read_flushes == 1);
+	}
+      else
+	{
+	  TEST_CHECK (p->state_flushes == 1);
+	  TEST_CHECK (p->write_flushes == (UINT) expected[k].dependent);
+	  TEST_CHECK (p->read_flushes == p->write_flushes);
+	}
+
+      /* the state the phase runs on is the state of its kernel */
+      for (j = 0; j < k; j++)
+	TEST_CHECK ((phases[j].sba_targets[0] == p->sba_targets[0]) ==
+		    (expected[j].binding_table == expected[k].binding_table));
+      TEST_CHECK (p->sba_targets[1] ==
+		  gpe_context->dynamic_state.res.bo->handle);
+      TEST_CHECK (p->sba_targets[2] ==
+		  (gpe_context->instruction_state.buff_obj.bo ?
+		   (UINT) gpe_context->instruction_state.buff_obj.bo->handle :
+		   0));
+      TEST_CHECK (cmds->valid && p->vfe_len == cmds->vfe_len);
+      TEST_CHECK (!memcmp (p->vfe_dw, cmds->dw + cmds->vfe,
+			   p->vfe_len * sizeof (UINT)));
+
+      /* each state command at most once, and only where the state changed;
+       * the loads follow a new base or a new VFE state */
+      TEST_CHECK (p->sba <= 1 && p->vfe <= 1);
+      TEST_CHECK (p->curbe_load <= 1 && p->id_load <= 1);
+      sba_changed = !prev || memcmp (p->sba_targets, prev->sba_targets,
+				     sizeof (p->sba_targets));
+      vfe_changed = !prev || p->vfe_len != prev->vfe_len ||
+	memcmp (p->vfe_dw, prev->vfe_dw, p->vfe_len * sizeof (UINT));
+      sba_changes += sba_changed;
+      vfe_changes += vfe_changed;
+      curbe_changes += sba_changed || vfe_changed ||
+	memcmp (p->curbe_dw, prev->curbe_dw, sizeof (p->curbe_dw));
+      id_changes += sba_changed || vfe_changed ||
+	memcmp (p->id_dw, prev->id_dw, sizeof (p->id_dw));
+      sba += p->sba;
+      vfe += p->vfe;
+      curbe_load += p->curbe_load;
+      id_load += p->id_load;
+    }
+  TEST_CHECK (pipeline_selects == 1);
+  TEST_CHECK (sba == sba_changes);
+  TEST_CHECK (vfe == vfe_changes);
+  TEST_CHECK (curbe_load == curbe_changes);
+  TEST_CHECK (id_load == id_changes);
+}
+
+static const MEDIA_MOCK_EXEC *
+encode_frame (TEST_VA * t, TEST_VP8_ENCODER * enc, BOOL key_frame)
+{
+  dri_bufmgr *bufmgr = test_va_bufmgr (t);
+
+  media_bufmgr_mock_clear_execs (bufmgr);
+  TEST_CHECK_VA (test_vp8_encode_frame (t, enc, key_frame));
+  TEST_CHECK (media_bufmgr_mock_num_execs (bufmgr) == 1);
+  return media_bufmgr_mock_get_exec (bufmgr, 0);
+}
+
+static VOID
+test_frames (TEST_VA * t, MEDIA_ENCODER_CTX * encoder_context,
+	     TEST_VP8_ENCODER * enc)
+{
+  MBENC_CONTEXT *mbenc_ctx = &encoder_context->mbenc_context;
+  MBPAK_CONTEXT *mbpak_ctx = &encoder_context->mbpak_context;
+  /* MBEnc luma and chroma, MBPAK phase 2 */
+  const EXPECTED_PHASE i_frame[] = {
+    {&mbenc_ctx->gpe_context, 0, TRUE},
+    {&mbenc_ctx->gpe_context, 1, TRUE},
+    {&mbpak_ctx->gpe_context2, 2, TRUE},
+  };
+  /* MBEnc, MBPAK phases 1 and 2 */
+  const EXPECTED_PHASE p_frame[] = {
+    {&mbenc_ctx->gpe_context, 0, TRUE},
+    {&mbpak_ctx->gpe_context, 1, TRUE},
+    {&mbpak_ctx->gpe_context2, 2, TRUE},
+  };
+  const MEDIA_MOCK_EXEC *exec;
+
+  /* the CQP clip on this device: no scaling, ME or BRC kernels */
+  TEST_CHECK (!encoder_context->brc_enabled);
+  TEST_CHECK (encoder_context->mbenc_chroma_kernel);
+
+  exec = encode_frame (t, enc, TRUE);
+  check_phases (exec, i_frame, sizeof (i_frame) / sizeof (i_frame[0]));
+  exec = encode_frame (t, enc, FALSE);
+  check_phases (exec, p_frame, sizeof (p_frame) / sizeof (p_frame[0]));
+  exec = encode_frame (t, enc, FALSE);
+  check_phases (exec, p_frame, sizeof (p_frame) / sizeof (p_frame[0]));
+}
+
+static VOID
+test_independent_phase (TEST_VA * t, MEDIA_ENCODER_CTX * encoder_context)
+{
+  dri_bufmgr *bufmgr = test_va_bufmgr (t);
+  MBPAK_CONTEXT *mbpak_ctx = &encoder_context->mbpak_context;
+  dri_bo *binding_tables[2];
+  EXPECTED_PHASE phases[3];
+  GENERIC_KERNEL_PARAMS kernel_params;
+  MEDIA_OBJ_WALKER_PARAMS walker_params;
+  MEDIA_BATCH_BUFFER *batch;
+  UINT k;
+
+  /* the same kernel twice, then another one that does not wait for it */
+  phases[0].gpe_context = &mbpak_ctx->gpe_context2;
+  phases[0].binding_table = 0;
+  phases[0].dependent = FALSE;
+  phases[1].gpe_context = &mbpak_ctx->gpe_context2;
+  phases[1].binding_table = 0;
+  phases[1].dependent = TRUE;
+  phases[2].gpe_context = &mbpak_ctx->gpe_context;
+  phases[2].binding_table = 1;
+  phases[2].dependent = FALSE;
+  for (k = 0; k < 2; k++)
+    binding_tables[k] = media_bo_alloc (bufmgr, "binding table", 4096, 4096);
+
+  media_bufmgr_mock_clear_execs (bufmgr);
+  batch = test_va_batch (t);
+  media_drv_memset (&encoder_context->batch_state,
+		    sizeof (encoder_context->batch_state));
+  for (k = 0; k < 3; k++)
+    {
+      phases[k].gpe_context->surface_state_binding_table.res.bo =
+	binding_tables[phases[k].binding_table];
+      media_drv_memset (&kernel_params, sizeof (kernel_params));
+      kernel_params.dependent = phases[k].dependent;
+      kernel_params.phase_name = "phases";
+      media_drv_generic_kernel_cmds (&t->ctx, encoder_context, batch,
+				     phases[k].gpe_context, &kernel_params);
+      media_drv_memset (&walker_params, sizeof (walker_params));
+      walker_params.walker_mode = SINGLE_MODE;
+      walker_params.frmfield_h_in_mb = 1;
+      walker_params.frm_w_in_mb = 1;
+      encoder_context->media_object_walker_cmd (batch, &walker_params);
+    }
+  media_batchbuffer_submit (batch);
+  TEST_CHECK (media_bufmgr_mock_num_execs (bufmgr) == 1);
+  check_phases (media_bufmgr_mock_get_exec (bufmgr, 0), phases, 3);
+  mbpak_ctx->gpe_context.surface_state_binding_table.res.bo = NULL;
+  mbpak_ctx->gpe_context2.surface_state_binding_table.res.bo = NULL;
+  for (k = 0; k < 2; k++)
+    media_bo_unreference (binding_tables[k]);
+}
+
+int
+main (int argc, char **argv)
+{
+  TEST_VA t;
+  TEST_VP8_ENCODER enc;
+  MEDIA_DRV_CONTEXT *drv_ctx;
+  MEDIA_ENCODER_CTX *encoder_context;
+
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+  drv_ctx = test_va_driver (&t);
+  TEST_CHECK_VA (test_vp8_encoder_open (&t, &enc, 176, 144,
+					VA_HYBRID_ENCODE_OUTPUT_MB_DATA));
+  encoder_context =
+    (MEDIA_ENCODER_CTX *) CONTEXT (enc.context)->hw_context;
+
+  test_frames (&t, encoder_context, &enc);
+  test_independent_phase (&t, encoder_context);
+
+  test_vp8_encoder_close (&t, &enc);
+  test_va_close (&t);
+  return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+/*
+ * Records one kernel phase into a batch that has only a few dwords left,
+ * for every amount of room up to more than a phase needs, both as the
+ * first phase of the batch and after a phase that already programmed the
+ * same state. Wherever the batch rolls over, each walker must run in a
+ * batch that also carries the pipeline select and the state commands it
+ * depends on.
+ */
+
+#include <stdlib.h>
+#include "test_va.h"
+#include "media_drv_hwcmds.h"
+#include "media_drv_encoder.h"
+
+#define MAX_ROOM	256
+
+static VOID
+fill_batch (MEDIA_BATCH_BUFFER * batch, UINT room)
+{
+  UINT n = (batch->size - BATCH_RESERVED) / 4 -
+    (batch->cmd_ptr - batch->map) / 4;
+  UINT c, *cmd;
+
+  n = n > room ? n - room : 0;
+  while (n > 0)
+    {
+      c = n < 4096 ? n : 4096;
+      cmd = media_batchbuffer_reserve (batch, c, I915_EXEC_RENDER);
+      memset (cmd, 0, c * 4);	/* MI_NOOP */
+      media_batchbuffer_commit (batch, cmd + c);
+      n -= c;
+    }
+}
+
+/* Returns the number of walkers in the exec. */
+static UINT
+check_exec (const MEDIA_MOCK_EXEC * exec)
+{
+  UINT seen = 0, walkers = 0, i, op;
+
+  for (i = 0; i < exec->used / 4; i += test_cmd_len (exec->cmds[i]))
+    {
+      op = test_cmd_op (exec->cmds[i]);
+      if (op == CMD_PIPELINE_SELECT)
+	seen |= 1;
+      else if (op == CMD_STATE_BASE_ADDRESS)
+	seen |= 2;
+      else if (op == CMD_MEDIA_VFE_STATE)
+	seen |= 4;
+      else if (op == CMD_MEDIA_CURBE_LOAD)
+	seen |= 8;
+      else if (op == CMD_MEDIA_INTERFACE_LOAD)
+	seen |= 16;
+      else if (op == CMD_MEDIA_OBJECT_WALKER)
+	{
+	  TEST_CHECK (seen == 31);
+	  walkers++;
+	}
+      else if (op == MI_BATCH_BUFFER_END)
+	break;
+    }
+  return walkers;
+}
+
+static VOID
+run_phase (TEST_VA * t, MEDIA_ENCODER_CTX * encoder_context,
+	   MEDIA_BATCH_BUFFER * batch)
+{
+  GENERIC_KERNEL_PARAMS kernel_params;
+  MEDIA_OBJ_WALKER_PARAMS walker_params;
+
+  media_drv_memset (&kernel_params, sizeof (kernel_params));
+  kernel_params.phase_name = "rollover";
+  media_drv_generic_kernel_cmds (&t->ctx, encoder_context, batch,
+				 &encoder_context->scaling_context.gpe_context,
+				 &kernel_params);
+  media_drv_memset (&walker_params, sizeof (walker_params));
+  walker_params.walker_mode = SINGLE_MODE;
+  walker_params.frmfield_h_in_mb = 1;
+  walker_params.frm_w_in_mb = 1;
+  encoder_context->media_object_walker_cmd (batch, &walker_params);
+}
+
+int
+main (int argc, char **argv)
+{
+  TEST_VA t;
+  TEST_VP8_ENCODER enc;
+  MEDIA_DRV_CONTEXT *drv_ctx;
+  MEDIA_ENCODER_CTX *encoder_context;
+  MEDIA_BATCH_BUFFER *batch;
+  dri_bufmgr *bufmgr;
+  UINT room, warm, i, walkers;
+
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+  drv_ctx = test_va_driver (&t);
+  bufmgr = test_va_bufmgr (&t);
+  TEST_CHECK_VA (test_vp8_encoder_open (&t, &enc, 176, 144,
+					VA_HYBRID_ENCODE_OUTPUT_MB_DATA));
+  TEST_CHECK_VA (test_vp8_encode_frame (&t, &enc, TRUE));
+  encoder_context =
+    (MEDIA_ENCODER_CTX *) CONTEXT (enc.context)->hw_context;
+
+  for (room = 0; room <= MAX_ROOM; room++)
+    for (warm = 0; warm < 2; warm++)
+      {
+	media_bufmgr_mock_clear_execs (bufmgr);
+	batch = test_va_batch (&t);
+	media_drv_memset (&encoder_context->batch_state,
+			  sizeof (encoder_context->batch_state));
+	/* a warm batch has the state programmed, the next phase emits none */
+	if (warm)
+	  run_phase (&t, encoder_context, batch);
+	fill_batch (batch, room);
+	run_phase (&t, encoder_context, batch);
+	media_batchbuffer_submit (batch);
+
+	walkers = 0;
+	for (i = 0; i < media_bufmgr_mock_num_execs (bufmgr); i++)
+	  walkers += check_exec (media_bufmgr_mock_get_exec (bufmgr, i));
+	TEST_CHECK (walkers == 1 + warm);
+      }
+
+  test_vp8_encoder_close (&t, &enc);
+  test_va_close (&t);
+  return 0;
+}
@@ -0,0 +1,761 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * The CM runtime of test_cmrt.h. Every object of a device is kept on the
+ * device's list and freed with it, the way the runtime reclaims programs,
+ * kernels and events the driver never destroys. A queue keeps a record of
+ * every enqueue until an event at or after it is waited for.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_cmrt.h"
+#include <va/va_dec_vp9.h>
+#include "cmrt_api.h"
+#include "intel_hybrid_hostvld_vp9.h"
+
+#define TEST_ALIGN(x, a)	(((x) + (a) - 1) & ~((a) - 1))
+
+static TEST_CMRT_STATS cmrt_stats;
+static UINT cmrt_next_index;
+
+class TestCmDevice;
+
+class TestCmObject
+{
+public:
+  TestCmObject (TestCmDevice * device);
+  virtual ~TestCmObject ();
+
+  TestCmDevice *device;
+  TestCmObject *prev, *next;
+};
+
+class TestCmDevice:public CmDevice
+{
+public:
+  TestCmDevice ()
+  {
+    objects = NULL;
+    cmrt_stats.devices++;
+    cmrt_stats.live_devices++;
+  }
+  ~TestCmDevice ()
+  {
+    while (objects)
+      delete objects;
+    cmrt_stats.live_devices--;
+  }
+
+  INT CreateBuffer (UINT size, CmBuffer * &pSurface);
+  INT CreateBuffer (CmOsResource * pCmOsResource, CmBuffer * &pSurface);
+  INT CreateSurface2D (UINT width, UINT height, CM_SURFACE_FORMAT format,
+		       CmSurface2D * &pSurface);
+  INT CreateSurface2D (CmOsResource * pCmOsResource,
+		       CmSurface2D * &pSurface);
+  INT DestroySurface (CmBuffer * &pSurface);
+  INT DestroySurface (CmSurface2D * &pSurface);
+  INT CreateQueue (CmQueue * &pQueue);
+  INT LoadProgram (void *pCommonISACode, const UINT size,
+		   CmProgram * &pProgram, const char *options);
+  INT CreateKernel (CmProgram * pProgram, const char *kernelName,
+		    CmKernel * &pKernel, const char *options);
+  INT DestroyKernel (CmKernel * &pKernel);
+  INT DestroyProgram (CmProgram * &pProgram);
+  INT CreateTask (CmTask * &pTask);
+  INT DestroyTask (CmTask * &pTask);
+  INT CreateThreadSpace (UINT width, UINT height, CmThreadSpace * &pTS);
+  INT DestroyThreadSpace (CmThreadSpace * &pTS);
+  /* the decoder only allocates surfaces on its own BOs */
+  INT CreateBufferUP (UINT size, void *pSystMem, CmBufferUP * &pSurface)
+  {
+    return CM_FAILURE;
+  }
+  INT DestroyBufferUP (CmBufferUP * &pSurface)
+  {
+    return CM_FAILURE;
+  }
+  INT GetSurface2DInfo (UINT width, UINT height, CM_SURFACE_FORMAT format,
+			UINT & pitch, UINT & physicalSize);
+  INT CreateSurface2DUP (UINT width, UINT height, CM_SURFACE_FORMAT format,
+			 void *pSysMem, CmSurface2DUP * &pSurface)
+  {
+    return CM_FAILURE;
+  }
+  INT DestroySurface2DUP (CmSurface2DUP * &pSurface)
+  {
+    return CM_FAILURE;
+  }
+
+  BOOL busy (const void *task_or_thread_space);
+
+  TestCmObject *objects;
+};
+
+TestCmObject::TestCmObject (TestCmDevice * device):device (device)
+{
+  prev = NULL;
+  next = device->objects;
+  if (next)
+    next->prev = this;
+  device->objects = this;
+}
+
+TestCmObject::~TestCmObject ()
+{
+  if (prev)
+    prev->next = next;
+  else
+    device->objects = next;
+  if (next)
+    next->prev = prev;
+}
+
+class CmProgram:public TestCmObject
+{
+public:
+  CmProgram (TestCmDevice * device):TestCmObject (device)
+  {
+    cmrt_stats.programs++;
+    cmrt_stats.live_programs++;
+  }
+  ~CmProgram ()
+  {
+    cmrt_stats.live_programs--;
+  }
+};
+
+class TestCmKernel:public CmKernel, public TestCmObject
+{
+public:
+  TestCmKernel (TestCmDevice * device):TestCmObject (device)
+  {
+    cmrt_stats.kernels++;
+  }
+
+  INT SetThreadCount (UINT count)
+  {
+    return CM_SUCCESS;
+  }
+  INT SetKernelArg (UINT index, size_t size, const void *pValue)
+  {
+    return pValue ? CM_SUCCESS : CM_FAILURE;
+  }
+  INT SetThreadArg (UINT threadId, UINT index, size_t size,
+		    const void *pValue)
+  {
+    return pValue ? CM_SUCCESS : CM_FAILURE;
+  }
+  INT AssociateThreadSpace (CmThreadSpace * &pTS)
+  {
+    return CM_SUCCESS;
+  }
+};
+
+class TestCmTask:public CmTask, public TestCmObject
+{
+public:
+  TestCmTask (TestCmDevice * device):TestCmObject (device)
+  {
+    num_kernels = 0;
+    cmrt_stats.tasks++;
+    cmrt_stats.live_tasks++;
+  }
+  ~TestCmTask ()
+  {
+    cmrt_stats.live_tasks--;
+  }
+
+  INT AddKernel (CmKernel * pKernel)
+  {
+    num_kernels++;
+    return pKernel ? CM_SUCCESS : CM_FAILURE;
+  }
+  INT Reset (void)
+  {
+    num_kernels = 0;
+    return CM_SUCCESS;
+  }
+  INT AddSync (void)
+  {
+    return CM_SUCCESS;
+  }
+
+  UINT num_kernels;
+};
+
+class TestCmThreadSpace:public CmThreadSpace, public TestCmObject
+{
+public:
+  TestCmThreadSpace (TestCmDevice * device):TestCmObject (device)
+  {
+    cmrt_stats.thread_spaces++;
+    cmrt_stats.live_thread_spaces++;
+  }
+  ~TestCmThreadSpace ()
+  {
+    cmrt_stats.live_thread_spaces--;
+  }
+
+  INT AssociateThread (UINT x, UINT y, CmKernel * pKernel, UINT threadId)
+  {
+    return CM_SUCCESS;
+  }
+  INT SelectThreadDependencyPattern (CM_DEPENDENCY_PATTERN pattern)
+  {
+    return CM_SUCCESS;
+  }
+  INT Set26ZIDispatchPattern (CM_26ZI_DISPATCH_PATTERN pattern)
+  {
+    return CM_SUCCESS;
+  }
+  INT Set26ZIMacroBlockSize (UINT width, UINT height)
+  {
+    return CM_SUCCESS;
+  }
+};
+
+/* 1D buffers and 2D surfaces alike; nothing runs, so nothing is read back */
+class TestCmSurface:public CmBuffer, public CmSurface2D, public TestCmObject
+{
+public:
+  TestCmSurface (TestCmDevice * device):TestCmObject (device),
+    index (++cmrt_next_index)
+  {
+    cmrt_stats.surfaces++;
+  }
+
+  INT GetIndex (SurfaceIndex * &pIndex)
+  {
+    pIndex = &index;
+    return CM_SUCCESS;
+  }
+  INT ReadSurface (unsigned char *pSysMem, CmEvent * pEvent,
+		   UINT64 sysMemSize)
+  {
+    return CM_FAILURE;
+  }
+  INT WriteSurface (const unsigned char *pSysMem, CmEvent * pEvent,
+		    UINT64 sysMemSize)
+  {
+    return CM_SUCCESS;
+  }
+  INT InitSurface (const DWORD initValue, CmEvent * pEvent)
+  {
+    return CM_SUCCESS;
+  }
+  INT SetSurfaceStateDimensions (UINT iWidth, UINT iHeight)
+  {
+    return CM_SUCCESS;
+  }
+
+  SurfaceIndex index;
+};
+
+typedef struct _test_cm_enqueue
+{
+  UINT seq;
+  const void *task;
+  const void *thread_space;
+  struct _test_cm_enqueue *next;
+} TEST_CM_ENQUEUE;
+
+class TestCmQueue;
+
+class TestCmEvent:public CmEvent, public TestCmObject
+{
+public:
+  TestCmEvent (TestCmDevice * device, TestCmQueue * queue,
+	       UINT seq):TestCmObject (device), queue (queue), seq (seq)
+  {
+    cmrt_stats.events++;
+    cmrt_stats.live_events++;
+  }
+  ~TestCmEvent ()
+  {
+    cmrt_stats.live_events--;
+  }
+
+  INT GetStatus (CM_STATUS & status);
+  INT GetExecutionTime (UINT64 & time)
+  {
+    time = 0;
+    return CM_SUCCESS;
+  }
+  INT WaitForTaskFinished (DWORD dwTimeOutMs);
+
+  TestCmQueue *queue;
+  UINT seq;
+};
+
+class TestCmQueue:public CmQueue, public TestCmObject
+{
+public:
+  TestCmQueue (TestCmDevice * device):TestCmObject (device)
+  {
+    running = NULL;
+    last_seq = 0;
+  }
+  ~TestCmQueue ()
+  {
+    finish (last_seq);
+  }
+
+  INT Enqueue (CmTask * pTask, CmEvent * &pEvent, const CmThreadSpace * pTS)
+  {
+    TEST_CM_ENQUEUE *e, **tail;
+
+    if (!pTask || !((TestCmTask *) pTask)->num_kernels)
+      return CM_FAILURE;
+    e = (TEST_CM_ENQUEUE *) calloc (1, sizeof (*e));
+    TEST_CHECK (e != NULL);
+    e->seq = ++last_seq;
+    e->task = (TestCmTask *) pTask;
+    e->thread_space = (const TestCmThreadSpace *) pTS;
+    for (tail = &running; *tail; tail = &(*tail)->next)
+      ;
+    *tail = e;
+    cmrt_stats.enqueues++;
+
+    if (pEvent == CM_NO_EVENT)
+      pEvent = NULL;
+    else
+      pEvent = new TestCmEvent ((TestCmDevice *) device, this, e->seq);
+    return CM_SUCCESS;
+  }
+  INT DestroyEvent (CmEvent * &pEvent)
+  {
+    if (!pEvent)
+      return CM_FAILURE;
+    delete (TestCmEvent *) pEvent;
+    pEvent = NULL;
+    return CM_SUCCESS;
+  }
+
+  /* Everything up to seq is done. */
+  VOID finish (UINT seq)
+  {
+    TEST_CM_ENQUEUE *e;
+
+    while (running && running->seq <= seq)
+      {
+	e = running;
+	running = e->next;
+	free (e);
+      }
+  }
+
+  TEST_CM_ENQUEUE *running;
+  UINT last_seq;
+};
+
+INT
+TestCmEvent::GetStatus (CM_STATUS & status)
+{
+  queue->finish (seq);
+  status = CM_STATUS_FINISHED;
+  return CM_SUCCESS;
+}
+
+INT
+TestCmEvent::WaitForTaskFinished (DWORD dwTimeOutMs)
+{
+  queue->finish (seq);
+  return CM_SUCCESS;
+}
+
+BOOL
+TestCmDevice::busy (const void *task_or_thread_space)
+{
+  TestCmObject *o;
+  TestCmQueue *q;
+  TEST_CM_ENQUEUE *e;
+
+  for (o = objects; o; o = o->next)
+    {
+      q = dynamic_cast < TestCmQueue * >(o);
+      for (e = q ? q->running : NULL; e; e = e->next)
+	if (e->task == task_or_thread_space
+	    || e->thread_space == task_or_thread_space)
+	  return TRUE;
+    }
+  return FALSE;
+}
+
+INT
+TestCmDevice::CreateBuffer (UINT size, CmBuffer * &pSurface)
+{
+  pSurface = size ? new TestCmSurface (this) : NULL;
+  return pSurface ? CM_SUCCESS : CM_FAILURE;
+}
+
+INT
+TestCmDevice::CreateBuffer (CmOsResource * pCmOsResource,
+			    CmBuffer * &pSurface)
+{
+  pSurface = pCmOsResource && pCmOsResource->bo ?
+    new TestCmSurface (this) : NULL;
+  return pSurface ? CM_SUCCESS : CM_FAILURE;
+}
+
+INT
+TestCmDevice::CreateSurface2D (UINT width, UINT height,
+			       CM_SURFACE_FORMAT format,
+			       CmSurface2D * &pSurface)
+{
+  pSurface = width && height ? new TestCmSurface (this) : NULL;
+  return pSurface ? CM_SUCCESS : CM_FAILURE;
+}
+
+INT
+TestCmDevice::CreateSurface2D (CmOsResource * pCmOsResource,
+			       CmSurface2D * &pSurface)
+{
+  pSurface = pCmOsResource && pCmOsResource->bo ?
+    new TestCmSurface (this) : NULL;
+  return pSurface ? CM_SUCCESS : CM_FAILURE;
+}
+
+INT
+TestCmDevice::DestroySurface (CmBuffer * &pSurface)
+{
+  delete (TestCmSurface *) pSurface;
+  pSurface = NULL;
+  return CM_SUCCESS;
+}
+
+INT
+TestCmDevice::DestroySurface (CmSurface2D * &pSurface)
+{
+  delete (TestCmSurface *) pSurface;
+  pSurface = NULL;
+  return CM_SUCCESS;
+}
+
+INT
+TestCmDevice::CreateQueue (CmQueue * &pQueue)
+{
+  pQueue = new TestCmQueue (this);
+  return CM_SUCCESS;
+}
+
+INT
+TestCmDevice::LoadProgram (void *pCommonISACode, const UINT size,
+			   CmProgram * &pProgram, const char *options)
+{
+  pProgram = pCommonISACode && size ? new CmProgram (this) : NULL;
+  return pProgram ? CM_SUCCESS : CM_FAILURE;
+}
+
+INT
+TestCmDevice::CreateKernel (CmProgram * pProgram, const char *kernelName,
+			    CmKernel * &pKernel, const char *options)
+{
+  pKernel = pProgram && kernelName ? new TestCmKernel (this) : NULL;
+  return pKernel ? CM_SUCCESS : CM_FAILURE;
+}
+
+INT
+TestCmDevice::DestroyKernel (CmKernel * &pKernel)
+{
+  delete (TestCmKernel *) pKernel;
+  pKernel = NULL;
+  return CM_SUCCESS;
+}
+
+INT
+TestCmDevice::DestroyProgram (CmProgram * &pProgram)
+{
+  delete pProgram;
+  pProgram = NULL;
+  return CM_SUCCESS;
+}
+
+INT
+TestCmDevice::CreateTask (CmTask * &pTask)
+{
+  pTask = new TestCmTask (this);
+  return CM_SUCCESS;
+}
+
+INT
+TestCmDevice::DestroyTask (CmTask * &pTask)
+{
+  TestCmTask *task = (TestCmTask *) pTask;
+
+  if (busy (task))
+    cmrt_stats.busy_destroys++;
+  delete task;
+  pTask = NULL;
+  return CM_SUCCESS;
+}
+
+INT
+TestCmDevice::CreateThreadSpace (UINT width, UINT height,
+				 CmThreadSpace * &pTS)
+{
+  pTS = width && height ? new TestCmThreadSpace (this) : NULL;
+  return pTS ? CM_SUCCESS : CM_FAILURE;
+}
+
+INT
+TestCmDevice::DestroyThreadSpace (CmThreadSpace * &pTS)
+{
+  TestCmThreadSpace *ts = (TestCmThreadSpace *) pTS;
+
+  if (busy (ts))
+    cmrt_stats.busy_destroys++;
+  delete ts;
+  pTS = NULL;
+  return CM_SUCCESS;
+}
+
+INT
+TestCmDevice::GetSurface2DInfo (UINT width, UINT height,
+				CM_SURFACE_FORMAT format, UINT & pitch,
+				UINT & physicalSize)
+{
+  UINT cpp;
+
+  switch (format)
+    {
+    case VA_CM_FMT_A8:
+    case VA_CM_FMT_NV12:
+      cpp = 1;
+      break;
+    case VA_CM_FMT_V8U8:
+      cpp = 2;
+      break;
+    default:
+      cpp = 4;
+      break;
+    }
+  pitch = TEST_ALIGN (width * cpp, 64);
+  physicalSize = pitch * height;
+  if (format == VA_CM_FMT_NV12)
+    physicalSize += physicalSize / 2;
+  return width && height ? CM_SUCCESS : CM_FAILURE;
+}
+
+INT
+CreateCmDevice (CmDevice * &pD, UINT & version,
+		CmDriverContext * drivercontext, UINT DevCreateOption)
+{
+  pD = drivercontext && drivercontext->bufmgr ? new TestCmDevice : NULL;
+  return pD ? CM_SUCCESS : CM_FAILURE;
+}
+
+INT
+DestroyCmDevice (CmDevice * &pD)
+{
+  delete (TestCmDevice *) pD;
+  pD = NULL;
+  return CM_SUCCESS;
+}
+
+VOID
+test_cmrt_enable (void)
+{
+  setenv (MEDIA_BUFMGR_MOCK_CMRT_ENV, "1", 1);
+}
+
+VOID
+test_cmrt_get_stats (TEST_CMRT_STATS * stats)
+{
+  *stats = cmrt_stats;
+}
+
+VOID
+test_cmrt_reset_stats (void)
+{
+  cmrt_stats.devices = 0;
+  cmrt_stats.programs = 0;
+  cmrt_stats.kernels = 0;
+  cmrt_stats.tasks = 0;
+  cmrt_stats.thread_spaces = 0;
+  cmrt_stats.surfaces = 0;
+  cmrt_stats.events = 0;
+  cmrt_stats.enqueues = 0;
+  cmrt_stats.busy_destroys = 0;
+}
+
+VAStatus
+test_vp9_decoder_open (TEST_VA * t, TEST_VP9_DECODER * dec, INT width,
+		       INT height, UINT decode_mode)
+{
+  VAConfigAttrib attrib;
+  VAStatus status;
+  UINT i;
+
+  memset (dec, 0, sizeof (*dec));
+  for (i = 0; i < TEST_VP9_NUM_REFS; i++)
+    dec->refs[i] = VA_INVALID_SURFACE;
+  dec->target = VA_INVALID_SURFACE;
+  attrib.type = VAConfigAttribHybridDecodeMode;
+  attrib.value = decode_mode;
+  status = t->vtable.vaCreateConfig (&t->ctx, VAProfileVP9Profile0,
+				     VAEntrypointVLD, &attrib, 1,
+				     &dec->config);
+  if (status != VA_STATUS_SUCCESS)
+    return status;
+  status = t->vtable.vaCreateSurfaces2 (&t->ctx, VA_RT_FORMAT_YUV420,
+					width, height, dec->surfaces,
+					TEST_VP9_NUM_SURFACES, NULL, 0);
+  if (status != VA_STATUS_SUCCESS)
+    return status;
+  return t->vtable.vaCreateContext (&t->ctx, dec->config, width, height,
+				    VA_PROGRESSIVE, dec->surfaces,
+				    TEST_VP9_NUM_SURFACES, &dec->context);
+}
+
+/* a surface no reference slot holds */
+static VASurfaceID
+free_surface (TEST_VP9_DECODER * dec)
+{
+  UINT i, j;
+
+  for (i = 0; i < TEST_VP9_NUM_SURFACES; i++)
+    {
+      for (j = 0; j < TEST_VP9_NUM_REFS; j++)
+	if (dec->refs[j] == dec->surfaces[i])
+	  break;
+      if (j == TEST_VP9_NUM_REFS)
+	return dec->surfaces[i];
+    }
+  TEST_CHECK (!"no free surface");
+  return VA_INVALID_SURFACE;
+}
+
+VAStatus
+test_vp9_decode_frame (TEST_VA * t, TEST_VP9_DECODER * dec,
+		       const TEST_VP9_FRAME * f, BYTE * data, UINT size)
+{
+  INTEL_HOSTVLD_VP9_FRAME_HEADER_INFO info;
+  VADecPictureParameterBufferVP9 pp;
+  VASliceParameterBufferVP9 slice;
+  VABufferID buffers[3];
+  VASurfaceID target;
+  VAStatus status;
+  UINT i, j;
+
+  memset (&info, 0, sizeof (info));
+  for (i = 0; i < TEST_VP9_NUM_REFS; i++)
+    {
+      info.dwRefSlotWidth[i] = dec->ref_width[i];
+      info.dwRefSlotHeight[i] = dec->ref_height[i];
+    }
+  status = Intel_HostvldVp9_PeekFrameHeader (data, size, &info);
+  if (status != VA_STATUS_SUCCESS)
+    return status;
+  TEST_CHECK (!(f->profile & 1) && !f->show_existing_frame
+	      && !f->segmentation && info.bSizeKnown);
+
+  memset (&pp, 0, sizeof (pp));
+  pp.profile = f->profile;
+#if VA_CHECK_VERSION(0,39,0)
+  pp.bit_depth = info.dwBitDepth;
+#endif
+  pp.frame_width = info.dwWidth;
+  pp.frame_height = info.dwHeight;
+  for (i = 0; i < TEST_VP9_NUM_REFS; i++)
+    pp.reference_frames[i] = dec->refs[i];
+  pp.pic_fields.bits.subsampling_x = 1;
+  pp.pic_fields.bits.subsampling_y = 1;
+  pp.pic_fields.bits.frame_type = !f->key_frame;
+  pp.pic_fields.bits.show_frame = f->show_frame;
+  pp.pic_fields.bits.error_resilient_mode = f->error_resilient;
+  pp.pic_fields.bits.intra_only = f->intra_only;
+  pp.pic_fields.bits.allow_high_precision_mv = 1;
+  pp.pic_fields.bits.mcomp_filter_type = f->interp_filter;
+  pp.pic_fields.bits.frame_parallel_decoding_mode = f->error_resilient;
+  pp.pic_fields.bits.refresh_frame_context = !f->error_resilient;
+  pp.pic_fields.bits.frame_context_idx = f->frame_context_idx;
+  pp.pic_fields.bits.last_ref_frame = f->ref_frame_idx[0];
+  pp.pic_fields.bits.golden_ref_frame = f->ref_frame_idx[1];
+  pp.pic_fields.bits.alt_ref_frame = f->ref_frame_idx[2];
+  pp.pic_fields.bits.alt_ref_frame_sign_bias = 1;
+  pp.pic_fields.bits.lossless_flag = info.bLossless;
+  pp.filter_level = f->filter_level;
+  pp.sharpness_level = f->sharpness;
+  pp.log2_tile_rows = f->log2_tile_rows;
+  pp.log2_tile_columns = f->log2_tile_cols;
+  pp.frame_header_length_in_bytes = info.dwUncompressedHeaderSize;
+  pp.first_partition_size = info.dwCompressedHeaderSize;
+  memset (pp.mb_segment_tree_probs, 255, sizeof (pp.mb_segment_tree_probs));
+  memset (pp.segment_pred_probs, 255, sizeof (pp.segment_pred_probs));
+
+  /* only the quantizer scales reach the output, the values don't matter */
+  memset (&slice, 0, sizeof (slice));
+  slice.slice_data_size = size;
+  for (i = 0; i < 4; i++)
+    for (j = 0; j < 2; j++)
+      slice.seg_param[0].filter_level[i][j] = f->filter_level;
+  slice.seg_param[0].luma_ac_quant_scale = 4 + f->base_q_idx * 4;
+  slice.seg_param[0].luma_dc_quant_scale = 4 + f->base_q_idx * 3;
+  slice.seg_param[0].chroma_ac_quant_scale = 4 + f->base_q_idx * 4;
+  slice.seg_param[0].chroma_dc_quant_scale = 4 + f->base_q_idx * 3;
+
+  TEST_CHECK_VA (t->vtable.vaCreateBuffer (&t->ctx, dec->context,
+					   VAPictureParameterBufferType,
+					   sizeof (pp), 1, &pp, &buffers[0]));
+  TEST_CHECK_VA (t->vtable.vaCreateBuffer (&t->ctx, dec->context,
+					   VASliceParameterBufferType,
+					   sizeof (slice), 1, &slice,
+					   &buffers[1]));
+  TEST_CHECK_VA (t->vtable.vaCreateBuffer (&t->ctx, dec->context,
+					   VASliceDataBufferType, size, 1,
+					   data, &buffers[2]));
+
+  target = free_surface (dec);
+  dec->target = target;
+  status = t->vtable.vaBeginPicture (&t->ctx, dec->context, target);
+  if (status == VA_STATUS_SUCCESS)
+    status = t->vtable.vaRenderPicture (&t->ctx, dec->context, buffers, 3);
+  if (status == VA_STATUS_SUCCESS)
+    status = t->vtable.vaEndPicture (&t->ctx, dec->context);
+  for (i = 0; i < 3; i++)
+    t->vtable.vaDestroyBuffer (&t->ctx, buffers[i]);
+  if (status != VA_STATUS_SUCCESS)
+    return status;
+
+  for (i = 0; i < TEST_VP9_NUM_REFS; i++)
+    if (info.dwRefreshFrameFlags & (1 << i))
+      {
+	dec->refs[i] = target;
+	dec->ref_width[i] = info.dwWidth;
+	dec->ref_height[i] = info.dwHeight;
+      }
+  return t->vtable.vaSyncSurface (&t->ctx, target);
+}
+
+VOID
+test_vp9_decoder_close (TEST_VA * t, TEST_VP9_DECODER * dec)
+{
+  TEST_CHECK_VA (t->vtable.vaDestroyContext (&t->ctx, dec->context));
+  TEST_CHECK_VA (t->vtable.vaDestroySurfaces (&t->ctx, dec->surfaces,
+					      TEST_VP9_NUM_SURFACES));
+  TEST_CHECK_VA (t->vtable.vaDestroyConfig (&t->ctx, dec->config));
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * A CM runtime on the CPU, so that the VP9 decoder runs through the VA
+ * entry points on the mock bufmgr. It implements the part of the cmrt
+ * interface the decoder calls and counts the objects created. Programs
+ * and kernels are never run: the surfaces of a decoded frame hold what
+ * HostVLD wrote and nothing else.
+ *
+ * A program linking test_cmrt_enable() gets these CreateCmDevice and
+ * DestroyCmDevice instead of libcmrt's, since the driver is linked into
+ * the program.
+ *
+ * An enqueued task is taken as running until an event of a later or the
+ * same enqueue on its queue is waited for. Destroying a task or a thread
+ * space a running task uses is counted in busy_destroys.
+ */
+
+#ifndef _TEST_CMRT_H
+#define _TEST_CMRT_H
+#include "test_va.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _test_cmrt_stats
+{
+  /* created since the last reset */
+  UINT devices;
+  UINT programs;
+  UINT kernels;
+  UINT tasks;
+  UINT thread_spaces;
+  UINT surfaces;		/* buffers and 2D surfaces of any kind */
+  UINT events;
+  UINT enqueues;
+  /* alive now */
+  UINT live_devices;
+  UINT live_programs;
+  UINT live_tasks;
+  UINT live_thread_spaces;
+  UINT live_events;
+  UINT busy_destroys;
+} TEST_CMRT_STATS;
+
+/* Lets the decoder create its CM device on the mock bufmgr. */
+VOID test_cmrt_enable (void);
+VOID test_cmrt_get_stats (TEST_CMRT_STATS * stats);
+/* Zeroes the creation counters and busy_destroys. */
+VOID test_cmrt_reset_stats (void);
+
+/*
+ * VP9 profile 0 decode session on width x height surfaces, one more than
+ * the reference slots so that a frame never decodes into a reference.
+ */
+#define TEST_VP9_NUM_REFS	8
+#define TEST_VP9_NUM_SURFACES	(TEST_VP9_NUM_REFS + 1)
+
+typedef struct _test_vp9_decoder
+{
+  VAConfigID config;
+  VAContextID context;
+  VASurfaceID surfaces[TEST_VP9_NUM_SURFACES];
+  /* the surface of each reference slot and the frame size it holds */
+  VASurfaceID refs[TEST_VP9_NUM_REFS];
+  UINT ref_width[TEST_VP9_NUM_REFS];
+  UINT ref_height[TEST_VP9_NUM_REFS];
+  /* the render target of the last frame */
+  VASurfaceID target;
+} TEST_VP9_DECODER;
+
+/* decode_mode is a VA_HYBRID_DECODE_MODE_* value */
+VAStatus test_vp9_decoder_open (TEST_VA * t, TEST_VP9_DECODER * dec,
+				INT width, INT height, UINT decode_mode);
+/*
+ * Decodes f, written into data with test_vp9_write_tiled_frame, into a
+ * surface no slot holds, which then goes into the refreshed slots. f is
+ * 4:2:0 and may be of profile 2, which the session refuses.
+ */
+VAStatus test_vp9_decode_frame (TEST_VA * t, TEST_VP9_DECODER * dec,
+				const TEST_VP9_FRAME * f, BYTE * data,
+				UINT size);
+VOID test_vp9_decoder_close (TEST_VA * t, TEST_VP9_DECODER * dec);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,157 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+/*
+ * Drives the CURBE shadows of an encoder GPE context through a random mix
+ * of CPU rebuilds, GPU patches (a direct heap write after
+ * media_gpe_context_curbe_invalidate), slot switches and heap rotation.
+ * A reference copy of what every heap and slot must hold is kept: each
+ * curbe_begin must hand out exactly that, and after each curbe_end the
+ * heap must be byte for byte what rewriting the whole CURBE would leave.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_va.h"
+#include "media_drv_encoder.h"
+
+#define STEPS		20000
+#define MAX_CURBE	4096
+
+static UINT seed = 1;
+
+static UINT
+rand_next (VOID)
+{
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+static BYTE model[MEDIA_GPE_MAX_FRAMES_IN_FLIGHT][MEDIA_GPE_MAX_CURBE_SLOTS]
+  [MAX_CURBE];
+
+static VOID
+heap_read (MEDIA_GPE_CTX * gpe_context, dri_bo * bo, UINT slot, BYTE * out)
+{
+  BYTE *heap = media_map_buffer_obj (bo);
+
+  memcpy (out, heap + gpe_context->curbe_slot_offset[slot],
+	  gpe_context->curbe_size);
+  media_unmap_buffer_obj (bo);
+}
+
+static VOID
+check_heap (MEDIA_GPE_CTX * gpe_context)
+{
+  BYTE heap[MAX_CURBE];
+
+  heap_read (gpe_context, gpe_context->dynamic_state.res.bo,
+	     gpe_context->curbe_slot, heap);
+  TEST_CHECK (!memcmp (heap, model[gpe_context->dynamic_state.ring_index]
+		       [gpe_context->curbe_slot], gpe_context->curbe_size));
+}
+
+/* Changes a few random dwords of a CURBE, sometimes none. */
+static VOID
+scribble (BYTE * curbe, UINT size)
+{
+  UINT n = rand_next () % 4, i;
+
+  for (i = 0; i < n; i++)
+    ((UINT *) curbe)[rand_next () % (size / 4)] = rand_next ();
+}
+
+int
+main (int argc, char **argv)
+{
+  TEST_VA t;
+  TEST_VP8_ENCODER enc;
+  MEDIA_DRV_CONTEXT *drv_ctx;
+  MEDIA_ENCODER_CTX *encoder_context;
+  MEDIA_GPE_CTX *gpe_context;
+  DYNAMIC_STATE *dynamic_state;
+  BYTE *curbe;
+  UINT size, heap, slot, step;
+
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+  drv_ctx = test_va_driver (&t);
+  TEST_CHECK_VA (test_vp8_encoder_open (&t, &enc, 176, 144,
+					VA_HYBRID_ENCODE_OUTPUT_MB_DATA));
+  TEST_CHECK_VA (test_vp8_encode_frame (&t, &enc, TRUE));
+  TEST_CHECK_VA (test_vp8_encode_frame (&t, &enc, FALSE));
+  encoder_context =
+    (MEDIA_ENCODER_CTX *) CONTEXT (enc.context)->hw_context;
+  gpe_context = &encoder_context->mbenc_context.gpe_context;
+  dynamic_state = &gpe_context->dynamic_state;
+  size = gpe_context->curbe_size;
+  TEST_CHECK (dynamic_state->ring_size >= 2 && size <= MAX_CURBE);
+
+  /* the frames encoded so far left the heaps and shadows in agreement */
+  for (heap = 0; heap < dynamic_state->ring_size; heap++)
+    for (slot = 0; slot < MEDIA_GPE_MAX_CURBE_SLOTS; slot++)
+      heap_read (gpe_context, dynamic_state->ring[heap].bo, slot,
+		 model[heap][slot]);
+
+  for (step = 0; step < STEPS; step++)
+    {
+      heap = dynamic_state->ring_index;
+      switch (rand_next () % 8)
+	{
+	case 0:
+	  media_gpe_context_next_frame (gpe_context);
+	  break;
+	case 1:
+	  media_gpe_context_select_curbe (gpe_context,
+					  rand_next () %
+					  MEDIA_GPE_MAX_CURBE_SLOTS);
+	  break;
+	case 2:
+	  /* the BRC update kernel patches the CURBE on the GPU */
+	  slot = gpe_context->curbe_slot;
+	  media_gpe_context_curbe_invalidate (gpe_context, slot);
+	  curbe = (BYTE *) media_map_buffer_obj (dynamic_state->res.bo) +
+	    gpe_context->curbe_offset;
+	  scribble (curbe, size);
+	  memcpy (model[heap][slot], curbe, size);
+	  media_unmap_buffer_obj (dynamic_state->res.bo);
+	  break;
+	default:
+	  slot = gpe_context->curbe_slot;
+	  curbe = media_gpe_context_curbe_begin (gpe_context);
+	  TEST_CHECK (!memcmp (curbe, model[heap][slot], size));
+	  scribble (curbe, size);
+	  memcpy (model[heap][slot], curbe, size);
+	  media_gpe_context_curbe_end (gpe_context);
+	  check_heap (gpe_context);
+	  break;
+	}
+    }
+
+  test_vp8_encoder_close (&t, &enc);
+  test_va_close (&t);
+  return 0;
+}
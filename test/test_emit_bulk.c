@@ -0,0 +1,366 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+/*
+ * The commands written through media_batchbuffer_reserve must match, dword
+ * for dword and reloc for reloc, what the per-dword OUT_BATCH emitters they
+ * replaced recorded. The ref_* functions below are those emitters.
+ */
+
+#include <stdlib.h>
+#include "test_va.h"
+#include "media_drv_hwcmds.h"
+#include "media_drv_hwcmds_g8.h"
+
+static STATUS
+ref_state_base_address (MEDIA_BATCH_BUFFER * batch,
+			STATE_BASE_ADDR_PARAMS * params)
+{
+  BEGIN_BATCH (batch, CMD_STATE_BASE_ADDRESS_LEN);
+  OUT_BATCH (batch, (CMD_STATE_BASE_ADDRESS | (CMD_STATE_BASE_ADDRESS_LEN - 2)));
+  OUT_BATCH (batch, 0);
+  if (params->surface_state.bo)
+    OUT_RELOC (batch, params->surface_state.bo, I915_GEM_DOMAIN_INSTRUCTION,
+	       0, BASE_ADDRESS_MODIFY);
+  else
+    OUT_BATCH (batch, 0);
+  if (params->dynamic_state.bo)
+    OUT_RELOC (batch, params->dynamic_state.bo,
+	       I915_GEM_DOMAIN_RENDER | I915_GEM_DOMAIN_SAMPLER,
+	       0, BASE_ADDRESS_MODIFY);
+  else
+    OUT_BATCH (batch, 0);
+  if (params->indirect_object.bo)
+    OUT_RELOC (batch, params->indirect_object.bo,
+	       I915_GEM_DOMAIN_SAMPLER, 0, BASE_ADDRESS_MODIFY);
+  else
+    OUT_BATCH (batch, 0);
+  if (params->instruction_buffer.bo)
+    OUT_RELOC (batch, params->instruction_buffer.bo,
+	       I915_GEM_DOMAIN_INSTRUCTION, 0, BASE_ADDRESS_MODIFY);
+  else
+    OUT_BATCH (batch, 0 | BASE_ADDRESS_MODIFY);
+  OUT_BATCH (batch, 0);
+  OUT_BATCH (batch, 0xFFFFF000 | BASE_ADDRESS_MODIFY);
+  OUT_BATCH (batch, 0);
+  OUT_BATCH (batch, 0xFFFFF000 | BASE_ADDRESS_MODIFY);
+  OUT_BATCH (batch, 0);
+  OUT_BATCH (batch, 0);
+  ADVANCE_BATCH (batch);
+  return SUCCESS;
+}
+
+static STATUS
+ref_state_base_address_g8 (MEDIA_BATCH_BUFFER * batch,
+			   STATE_BASE_ADDR_PARAMS * params)
+{
+  BEGIN_BATCH (batch, 16);
+  OUT_BATCH (batch, (CMD_STATE_BASE_ADDRESS | (16 - 2)));
+  OUT_BATCH (batch, 0 | BASE_ADDRESS_MODIFY);
+  OUT_BATCH (batch, 0);
+  OUT_BATCH (batch, 0);
+  if (params->surface_state.bo)
+    OUT_RELOC (batch, params->surface_state.bo, I915_GEM_DOMAIN_INSTRUCTION,
+	       0, BASE_ADDRESS_MODIFY);
+  else
+    OUT_BATCH (batch, 0);
+  OUT_BATCH (batch, 0);
+  if (params->dynamic_state.bo)
+    OUT_RELOC (batch, params->dynamic_state.bo,
+	       I915_GEM_DOMAIN_RENDER | I915_GEM_DOMAIN_SAMPLER,
+	       0, BASE_ADDRESS_MODIFY);
+  else
+    OUT_BATCH (batch, 0);
+  OUT_BATCH (batch, 0);
+  if (params->indirect_object.bo)
+    OUT_RELOC (batch, params->indirect_object.bo,
+	       I915_GEM_DOMAIN_SAMPLER, 0, BASE_ADDRESS_MODIFY);
+  else
+    OUT_BATCH (batch, 0);
+  OUT_BATCH (batch, 0);
+  if (params->instruction_buffer.bo)
+    OUT_RELOC (batch, params->instruction_buffer.bo,
+	       I915_GEM_DOMAIN_INSTRUCTION, 0, BASE_ADDRESS_MODIFY);
+  else
+    OUT_BATCH (batch, 0 | BASE_ADDRESS_MODIFY);
+  OUT_BATCH (batch, 0);
+  OUT_BATCH (batch, 0xFFFFF000 | BASE_ADDRESS_MODIFY);
+  OUT_BATCH (batch, 0xFFFFF000 | BASE_ADDRESS_MODIFY);
+  OUT_BATCH (batch, 0xFFFFF000 | BASE_ADDRESS_MODIFY);
+  OUT_BATCH (batch, 0xFFFFF000 | BASE_ADDRESS_MODIFY);
+  ADVANCE_BATCH (batch);
+  return SUCCESS;
+}
+
+static STATUS
+ref_curbe_load (MEDIA_BATCH_BUFFER * batch, CURBE_LOAD_PARAMS * params)
+{
+  BEGIN_BATCH (batch, 4);
+  OUT_BATCH (batch, CMD_MEDIA_CURBE_LOAD | (4 - 2));
+  OUT_BATCH (batch, 0);
+  OUT_BATCH (batch, params->curbe_size);
+  OUT_BATCH (batch, params->curbe_offset);
+  ADVANCE_BATCH (batch);
+  return SUCCESS;
+}
+
+static STATUS
+ref_id_load (MEDIA_BATCH_BUFFER * batch, ID_LOAD_PARAMS * params)
+{
+  BEGIN_BATCH (batch, 4);
+  OUT_BATCH (batch, CMD_MEDIA_INTERFACE_LOAD | (4 - 2));
+  OUT_BATCH (batch, 0);
+  OUT_BATCH (batch, params->idrt_size);
+  OUT_BATCH (batch, params->idrt_offset);
+  ADVANCE_BATCH (batch);
+  return SUCCESS;
+}
+
+static VOID
+ref_walker_out (MEDIA_BATCH_BUFFER * batch, MEDIA_OBJ_WALKER_PARAMS * params,
+		UINT use_scoreboard, UINT dw5_cmd, UINT dw10_cmd,
+		UINT dw11_cmd, UINT dw12_cmd)
+{
+  UINT mode = params->walker_mode;
+  UINT repel = (mode == SINGLE_MODE) ? 1 : 0;
+  UINT dual_mode = (mode == DUAL_MODE) ? 1 : 0;
+  UINT quad_mode = (mode == QUAD_MODE) ? 1 : 0;
+
+  BEGIN_BATCH (batch, CMD_MEDIA_OBJECT_WALKER_LEN);
+  OUT_BATCH (batch, CMD_MEDIA_OBJECT_WALKER | (CMD_MEDIA_OBJECT_WALKER_LEN - 2));
+  OUT_BATCH (batch, 0);
+  OUT_BATCH (batch, use_scoreboard << 21);
+  OUT_BATCH (batch, 0);
+  OUT_BATCH (batch, 0);
+  OUT_BATCH (batch, dw5_cmd);
+  OUT_BATCH (batch, ((dual_mode << 31) | (repel << 30) | (quad_mode << 29)));
+  OUT_BATCH (batch, ((0x3FF << 16) | 0x3FF));
+  OUT_BATCH (batch, ((params->frmfield_h_in_mb << 16) | params->frm_w_in_mb));
+  OUT_BATCH (batch, 0);
+  OUT_BATCH (batch, dw10_cmd);
+  OUT_BATCH (batch, dw11_cmd);
+  OUT_BATCH (batch, dw12_cmd);
+  OUT_BATCH (batch, ((params->frmfield_h_in_mb << 16) | params->frm_w_in_mb));
+  OUT_BATCH (batch, 0);
+  OUT_BATCH (batch, (0 | params->frm_w_in_mb));
+  OUT_BATCH (batch, (0 | (params->frmfield_h_in_mb << 16)));
+  ADVANCE_BATCH (batch);
+}
+
+static STATUS
+ref_walker (MEDIA_BATCH_BUFFER * batch, MEDIA_OBJ_WALKER_PARAMS * params)
+{
+  UINT dw5_cmd = 0, dw10_cmd = 0, dw11_cmd = 0, dw12_cmd = 0;
+  UINT use_scoreboard = 0;
+
+  if (params->mb_enc_iframe_dist_en || params->me_in_use)
+    {
+      dw10_cmd = (params->frm_w_in_mb - 1);
+      dw11_cmd = 1 << 16;
+      dw12_cmd = 0x1;
+    }
+  else
+    {
+      use_scoreboard = params->use_scoreboard;
+      if (params->hybrid_pak2_pattern_enabled_45_deg)
+	{
+	  dw11_cmd = 0x1;
+	  dw12_cmd = 1 << 16 | 0x3FF;
+	  dw5_cmd = 0x07;
+	}
+      else if ((params->pic_coding_type == I_FRM ||
+		(params->pic_coding_type == B_FRM &&
+		 !params->direct_spatial_mv_pred)) &&
+	       !params->force_26_degree)
+	{
+	  dw5_cmd = 0x3;
+	  dw11_cmd = 0x1;
+	  dw12_cmd = 1 << 16 | 0x3FF;
+	}
+      else
+	{
+	  dw5_cmd = 0x0F;
+	  dw11_cmd = 0x1;
+	  dw12_cmd = 1 << 16 | 0x3FE;
+	}
+    }
+  ref_walker_out (batch, params, use_scoreboard, dw5_cmd, dw10_cmd, dw11_cmd,
+		  dw12_cmd);
+  return SUCCESS;
+}
+
+static STATUS
+ref_walker_g8 (MEDIA_BATCH_BUFFER * batch, MEDIA_OBJ_WALKER_PARAMS * params)
+{
+  UINT dw5_cmd = 0, dw10_cmd = 0, dw11_cmd = 0, dw12_cmd = 0;
+
+  if (params->mb_enc_iframe_dist_en || params->me_in_use)
+    {
+      dw11_cmd = 1 << 16;
+      dw12_cmd = 0x1;
+    }
+  else if (params->walker_degree == DEGREE_46)
+    {
+      dw5_cmd = params->scoreboard_mask;
+      dw11_cmd = 0x1;
+      dw12_cmd = 1 << 16 | 0x3FF;
+    }
+  else if ((params->hybrid_pak2_pattern_enabled_45_deg) ||
+	   ((params->pic_coding_type == I_FRM ||
+	     (params->pic_coding_type == B_FRM &&
+	      !params->direct_spatial_mv_pred)) &&
+	    !params->force_26_degree))
+    {
+      dw5_cmd = 0x3;
+      dw11_cmd = 0x1;
+      dw12_cmd = 1 << 16 | 0x3FF;
+    }
+  else
+    {
+      dw5_cmd = 0x0F;
+      dw11_cmd = 0x1;
+      dw12_cmd = 1 << 16 | 0x3FE;
+    }
+  ref_walker_out (batch, params, params->use_scoreboard, dw5_cmd, dw10_cmd,
+		  dw11_cmd, dw12_cmd);
+  return SUCCESS;
+}
+
+typedef STATUS (*EMIT_FUNC) (MEDIA_BATCH_BUFFER * batch, VOID * params);
+
+/* Records ref and new with the same params into two batches, compares. */
+static VOID
+check_same (TEST_VA * t, EMIT_FUNC ref, EMIT_FUNC emit, VOID * params)
+{
+  dri_bufmgr *bufmgr = test_va_bufmgr (t);
+  MEDIA_BATCH_BUFFER *batch;
+  UINT n;
+
+  media_bufmgr_mock_clear_execs (bufmgr);
+  batch = test_va_batch (t);
+  ref (batch, params);
+  media_batchbuffer_submit (batch);
+  batch = test_va_batch (t);
+  emit (batch, params);
+  media_batchbuffer_submit (batch);
+  n = media_bufmgr_mock_num_execs (bufmgr);
+  TEST_CHECK (n == 2);
+  test_check_same_exec (media_bufmgr_mock_get_exec (bufmgr, 0),
+			media_bufmgr_mock_get_exec (bufmgr, 1));
+}
+
+static VOID
+test_state_base_address (TEST_VA * t)
+{
+  dri_bufmgr *bufmgr = test_va_bufmgr (t);
+  STATE_BASE_ADDR_PARAMS params;
+  MEDIA_RESOURCE res[4];
+  UINT mask, i;
+
+  for (i = 0; i < 4; i++)
+    media_allocate_resource (&res[i], bufmgr, (const BYTE *) "sba", 4096,
+			     4096);
+  for (mask = 0; mask < 16; mask++)
+    {
+      media_drv_memset (&params, sizeof (params));
+      if (mask & 1)
+	params.surface_state = res[0];
+      if (mask & 2)
+	params.dynamic_state = res[1];
+      if (mask & 4)
+	params.indirect_object = res[2];
+      if (mask & 8)
+	params.instruction_buffer = res[3];
+      check_same (t, (EMIT_FUNC) ref_state_base_address,
+		  (EMIT_FUNC) mediadrv_gen_state_base_address_cmd, &params);
+      check_same (t, (EMIT_FUNC) ref_state_base_address_g8,
+		  (EMIT_FUNC) mediadrv_gen_state_base_address_cmd_g8,
+		  &params);
+    }
+  for (i = 0; i < 4; i++)
+    media_bo_unreference (res[i].bo);
+}
+
+static VOID
+test_loads (TEST_VA * t)
+{
+  CURBE_LOAD_PARAMS curbe;
+  ID_LOAD_PARAMS id;
+
+  curbe.curbe_size = 0x1c0;
+  curbe.curbe_offset = 0x2040;
+  check_same (t, (EMIT_FUNC) ref_curbe_load,
+	      (EMIT_FUNC) mediadrv_gen_media_curbe_load_cmd, &curbe);
+  id.idrt_size = 0x20;
+  id.idrt_offset = 0x1080;
+  check_same (t, (EMIT_FUNC) ref_id_load,
+	      (EMIT_FUNC) mediadrv_gen_media_id_load_cmd, &id);
+}
+
+static VOID
+test_walkers (TEST_VA * t)
+{
+  static const UINT modes[] = { SINGLE_MODE, DUAL_MODE, QUAD_MODE };
+  MEDIA_OBJ_WALKER_PARAMS params;
+  UINT mode, type, bits;
+
+  for (mode = 0; mode < 3; mode++)
+    for (type = I_FRM; type <= B_FRM; type++)
+      for (bits = 0; bits < 128; bits++)
+	{
+	  media_drv_memset (&params, sizeof (params));
+	  params.walker_mode = modes[mode];
+	  params.pic_coding_type = type;
+	  params.frm_w_in_mb = 11;
+	  params.frmfield_h_in_mb = 9;
+	  params.scoreboard_mask = 0x5a;
+	  params.use_scoreboard = bits & 1;
+	  params.me_in_use = (bits >> 1) & 1;
+	  params.mb_enc_iframe_dist_en = (bits >> 2) & 1;
+	  params.hybrid_pak2_pattern_enabled_45_deg = (bits >> 3) & 1;
+	  params.direct_spatial_mv_pred = (bits >> 4) & 1;
+	  params.force_26_degree = (bits >> 5) & 1;
+	  params.walker_degree = ((bits >> 6) & 1) ? DEGREE_46 : 0;
+	  check_same (t, (EMIT_FUNC) ref_walker,
+		      (EMIT_FUNC) media_object_walker_cmd, &params);
+	  check_same (t, (EMIT_FUNC) ref_walker_g8,
+		      (EMIT_FUNC) media_object_walker_cmd_g8, &params);
+	}
+}
+
+int
+main (int argc, char **argv)
+{
+  TEST_VA t;
+
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+  test_state_base_address (&t);
+  test_loads (&t);
+  test_walkers (&t);
+  test_va_close (&t);
+  return 0;
+}
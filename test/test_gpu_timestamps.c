@@ -0,0 +1,296 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * The GPU timestamps of the encoder kernel phases, checked on the batches
+ * the mock records. Two encoders run the same frames, one with the
+ * timestamps on. Taking the timestamp stores out of its batches must give
+ * the other's batches back, but for the one flush that waits for the last
+ * phase at the end. Every phase must open with a store right in front of
+ * its walkers and close with one after the flushes that follow them. The
+ * reports go to the libva info callback, or the counters file when it is
+ * set.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "test_va.h"
+#include "media_drv_encoder.h"
+#include "media_drv_hwcmds.h"
+
+#define NUM_FRAMES	5
+
+static CHAR info_log[1 << 16];
+
+static void
+info_callback (VADriverContextP ctx, const char *message)
+{
+  UINT len = strlen (info_log);
+
+  TEST_CHECK (len + strlen (message) < sizeof (info_log));
+  strcpy (info_log + len, message);
+}
+
+static UINT
+count_lines (const CHAR * text, const CHAR * pattern)
+{
+  UINT n = 0;
+
+  while ((text = strstr (text, pattern)) != NULL)
+    {
+      n++;
+      text += strlen (pattern);
+    }
+  return n;
+}
+
+static const MEDIA_MOCK_RELOC *
+find_reloc (const MEDIA_MOCK_EXEC * exec, UINT dw)
+{
+  UINT i;
+
+  for (i = 0; i < exec->num_relocs; i++)
+    if (exec->relocs[i].offset == dw * 4)
+      return &exec->relocs[i];
+  return NULL;
+}
+
+/* same command, relocations compared by what they point into */
+static VOID
+check_same_cmd (const MEDIA_MOCK_EXEC * a, UINT i, const MEDIA_MOCK_EXEC * b,
+		UINT j)
+{
+  UINT len = test_cmd_len (a->cmds[i]), k;
+
+  TEST_CHECK (test_cmd_len (b->cmds[j]) == len);
+  for (k = 0; k < len; k++)
+    {
+      const MEDIA_MOCK_RELOC *ra = find_reloc (a, i + k);
+      const MEDIA_MOCK_RELOC *rb = find_reloc (b, j + k);
+
+      TEST_CHECK ((ra == NULL) == (rb == NULL));
+      if (ra)
+	{
+	  TEST_CHECK (ra->target_offset == rb->target_offset);
+	  TEST_CHECK (ra->read_domains == rb->read_domains);
+	  TEST_CHECK (ra->write_domain == rb->write_domain);
+	}
+      else
+	TEST_CHECK (a->cmds[i + k] == b->cmds[j + k]);
+    }
+}
+
+/* Returns the timestamp BO handle the frame wrote to and its phases. */
+static UINT
+check_frame (const MEDIA_MOCK_EXEC * plain, const MEDIA_MOCK_EXEC * timed,
+	     UINT * num_phases)
+{
+  UINT i, j = 0, op, prev = 0, tail = 0, handle = 0, phases = 0, walkers = 0;
+  BOOL open = FALSE, flushed = FALSE;
+
+  /* the command in front of the last store: the wait for the last phase,
+   * the only one the plain batch lacks */
+  for (i = 0; i < timed->used / 4; i += test_cmd_len (timed->cmds[i]))
+    {
+      if (test_cmd_op (timed->cmds[i]) == CMD_MI_STORE_REGISTER_MEM)
+	tail = prev;
+      prev = i;
+    }
+  TEST_CHECK (test_cmd_op (timed->cmds[tail]) == CMD_PIPE_CONTROL);
+  TEST_CHECK (timed->cmds[tail + 1] & CMD_PIPE_CONTROL_CS_STALL);
+
+  for (i = 0; i < timed->used / 4; i += test_cmd_len (timed->cmds[i]))
+    {
+      op = test_cmd_op (timed->cmds[i]);
+      if (op == CMD_MI_STORE_REGISTER_MEM)
+	{
+	  const MEDIA_MOCK_RELOC *reloc = find_reloc (timed, i + 2);
+
+	  TEST_CHECK (test_cmd_len (timed->cmds[i]) ==
+		      CMD_MI_STORE_REGISTER_MEM_LEN);
+	  TEST_CHECK (timed->cmds[i + 1] == MEDIA_RCS_TIMESTAMP_REG);
+	  TEST_CHECK (reloc != NULL);
+	  TEST_CHECK (handle == 0 || reloc->target_handle == handle);
+	  handle = reloc->target_handle;
+	  if (!open)
+	    {
+	      /* a phase opens right in front of its walkers */
+	      TEST_CHECK (reloc->target_offset == phases * 8);
+	      op = test_cmd_op (timed->cmds[i + CMD_MI_STORE_REGISTER_MEM_LEN]);
+	      TEST_CHECK (op == CMD_MEDIA_OBJECT_WALKER ||
+			  op == CMD_MI_SET_PREDICATE);
+	      open = TRUE;
+	      walkers = 0;
+	      flushed = FALSE;
+	    }
+	  else
+	    {
+	      /* and closes once the flushes after them are through */
+	      TEST_CHECK (reloc->target_offset == phases * 8 + 4);
+	      TEST_CHECK (walkers > 0 && flushed);
+	      open = FALSE;
+	      phases++;
+	    }
+	  continue;
+	}
+
+      if (op == CMD_MEDIA_OBJECT_WALKER)
+	{
+	  TEST_CHECK (open);
+	  walkers++;
+	}
+      else if (open && walkers &&
+	       (op == CMD_MEDIA_STATE_FLUSH || op == CMD_PIPE_CONTROL))
+	flushed = TRUE;
+
+      /* nor does the MI_NOOP padding in front of the batch end line up */
+      if (i == tail || timed->cmds[i] == 0)
+	continue;
+      while (j < plain->used / 4 && plain->cmds[j] == 0)
+	j++;
+      TEST_CHECK (j < plain->used / 4);
+      check_same_cmd (plain, j, timed, i);
+      j += test_cmd_len (plain->cmds[j]);
+    }
+  while (j < plain->used / 4 && plain->cmds[j] == 0)
+    j++;
+  TEST_CHECK (j == plain->used / 4);
+  TEST_CHECK (!open);
+
+  *num_phases = phases;
+  return handle;
+}
+
+int
+main (int argc, char **argv)
+{
+  MEDIA_ENCODER_CTX *encoder_context;
+  MEDIA_GPU_TIMESTAMPS *ts;
+  MEDIA_DRV_CONTEXT *drv_ctx;
+  TEST_VP8_ENCODER plain_enc, timed_enc;
+  TEST_VA plain, timed;
+  UINT handles[NUM_FRAMES], phases = 0, n, i;
+  CHAR counters[] = "/tmp/test_gpu_timestamps.XXXXXX";
+  CHAR line[256];
+  uint32_t *stamps;
+  FILE *file;
+  INT fd;
+
+  unsetenv ("VA_INTEL_DEBUG");
+  unsetenv (VA_INTEL_HYBRID_COUNTERS_FILE_ENV);
+  if (!test_va_open (&plain))
+    return TEST_SKIP;
+  TEST_CHECK_VA (test_vp8_encoder_open (&plain, &plain_enc, 176, 144,
+					VA_HYBRID_ENCODE_OUTPUT_MB_DATA));
+
+  setenv ("VA_INTEL_DEBUG", "0x80", 1);
+  TEST_CHECK (test_va_open (&timed));
+  timed.ctx.info_callback = info_callback;
+  TEST_CHECK_VA (test_vp8_encoder_open (&timed, &timed_enc, 176, 144,
+					VA_HYBRID_ENCODE_OUTPUT_MB_DATA));
+  drv_ctx = test_va_driver (&timed);
+  encoder_context =
+    (MEDIA_ENCODER_CTX *) CONTEXT (timed_enc.context)->hw_context;
+  ts = encoder_context->timestamps;
+  TEST_CHECK (ts != NULL && ts->file == NULL);
+
+  media_bufmgr_mock_clear_execs (test_va_bufmgr (&plain));
+  media_bufmgr_mock_clear_execs (test_va_bufmgr (&timed));
+  for (n = 0; n < NUM_FRAMES; n++)
+    {
+      UINT frame_phases;
+
+      TEST_CHECK_VA (test_vp8_encode_frame (&plain, &plain_enc, n == 0));
+      TEST_CHECK_VA (test_vp8_encode_frame (&timed, &timed_enc, n == 0));
+      TEST_CHECK (media_bufmgr_mock_num_execs (test_va_bufmgr (&plain)) ==
+		  n + 1);
+      TEST_CHECK (media_bufmgr_mock_num_execs (test_va_bufmgr (&timed)) ==
+		  n + 1);
+      handles[n] =
+	check_frame (media_bufmgr_mock_get_exec (test_va_bufmgr (&plain), n),
+		     media_bufmgr_mock_get_exec (test_va_bufmgr (&timed), n),
+		     &frame_phases);
+      /* scaling, MBEnc and MBPAK at least */
+      TEST_CHECK (frame_phases >= 3);
+      TEST_CHECK (ts->num_phases[ts->slot] == frame_phases);
+      phases += frame_phases;
+
+      /* frames in flight write to buffers of their own */
+      for (i = 1; i < VP8_ENCODE_FRAMES_IN_FLIGHT && i <= n; i++)
+	TEST_CHECK (handles[n] != handles[n - i]);
+      if (n >= VP8_ENCODE_FRAMES_IN_FLIGHT)
+	TEST_CHECK (handles[n] == handles[n - VP8_ENCODE_FRAMES_IN_FLIGHT]);
+
+      /*
+       * The mock stores nothing. The first phase of frame 0 gets 0x200
+       * ticks of 80 ns across the wrap of the low dword, read back when
+       * frame 3 takes the buffer over.
+       */
+      if (n == 0 || n == VP8_ENCODE_FRAMES_IN_FLIGHT)
+	{
+	  stamps = media_map_buffer_obj (ts->res[ts->slot].bo);
+	  TEST_CHECK (stamps != NULL);
+	  stamps[0] = n ? 0 : 0xffffff00;
+	  stamps[1] = n ? 0 : 0x00000100;
+	  media_unmap_buffer_obj (ts->res[ts->slot].bo);
+	}
+    }
+
+  test_vp8_encoder_close (&timed, &timed_enc);
+  test_vp8_encoder_close (&plain, &plain_enc);
+  TEST_CHECK (count_lines (info_log, " kernels: ") == NUM_FRAMES);
+  TEST_CHECK (count_lines (info_log, " us\n") == phases + NUM_FRAMES);
+  TEST_CHECK (count_lines (info_log, ": 41.0 us\n") == 2);
+  test_va_close (&timed);
+  test_va_close (&plain);
+
+  /* with the counters file set, nothing goes to the callback */
+  fd = mkstemp (counters);
+  TEST_CHECK (fd >= 0);
+  close (fd);
+  setenv (VA_INTEL_HYBRID_COUNTERS_FILE_ENV, counters, 1);
+  info_log[0] = '\0';
+  TEST_CHECK (test_va_open (&timed));
+  timed.ctx.info_callback = info_callback;
+  TEST_CHECK_VA (test_vp8_encoder_open (&timed, &timed_enc, 176, 144,
+					VA_HYBRID_ENCODE_OUTPUT_MB_DATA));
+  for (n = 0; n < 2; n++)
+    TEST_CHECK_VA (test_vp8_encode_frame (&timed, &timed_enc, n == 0));
+  test_vp8_encoder_close (&timed, &timed_enc);
+  test_va_close (&timed);
+  TEST_CHECK (info_log[0] == '\0');
+
+  file = fopen (counters, "r");
+  TEST_CHECK (file != NULL);
+  n = 0;
+  while (fgets (line, sizeof (line), file))
+    n += count_lines (line, " kernels: ");
+  fclose (file);
+  unlink (counters);
+  TEST_CHECK (n == 2);
+
+  return 0;
+}
@@ -0,0 +1,307 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * The linear shadow of derived image maps, on the Y tiled surfaces of the
+ * mock. A map hands out the linear copy of the whole BO. Bytes changed in
+ * the BO behind the driver's back show which maps refill the copy and
+ * which unmaps write rows back: only a map after the surface generation
+ * moved refills, and an unmap only writes the rows changed through the
+ * map. Surfaces without the attribute or with a linear BO map the BO, and
+ * so do surfaces whose BO was exported. An encode moves the generation of
+ * its input and its reconstructed frame.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_va.h"
+#include "media_drv_image.h"
+
+#define WIDTH		352
+#define HEIGHT		288
+
+static const BYTE *
+tiled_byte (const dri_bo * bo, UINT pitch, UINT x, UINT y)
+{
+  return (const BYTE *) bo->virtual + (y / 32 * (pitch / 128) + x / 128) *
+    4096 + x % 128 / 16 * 512 + y % 32 * 16 + x % 16;
+}
+
+/* the shadow holds the detiled BO, except for the stale row */
+static VOID
+check_linear (const BYTE * map, struct object_surface *obj_surface,
+	      UINT stale_row)
+{
+  dri_bo *bo = obj_surface->bo;
+  UINT pitch = obj_surface->width;
+  UINT x, y;
+  BOOL same;
+
+  TEST_CHECK (media_bo_map (bo, 0) == 0);
+  for (y = 0; y < bo->size / pitch; y++)
+    {
+      same = TRUE;
+      for (x = 0; x < pitch; x++)
+	same &= map[y * pitch + x] == *tiled_byte (bo, pitch, x, y);
+      TEST_CHECK (same == (y != stale_row));
+    }
+  media_bo_unmap (bo);
+}
+
+/* changes the BO without the driver seeing it */
+static VOID
+poke_row (struct object_surface *obj_surface, UINT y)
+{
+  dri_bo *bo = obj_surface->bo;
+  UINT x;
+
+  TEST_CHECK (media_bo_map (bo, 1) == 0);
+  for (x = 0; x < obj_surface->width; x++)
+    (*(BYTE *) tiled_byte (bo, obj_surface->width, x, y))++;
+  media_bo_unmap (bo);
+}
+
+static VOID
+create_surface (TEST_VA * t, VASurfaceID * surface, UINT fourcc,
+		INT shadow)
+{
+  VASurfaceAttrib attribs[2];
+  struct object_surface *obj_surface;
+  MEDIA_DRV_CONTEXT *drv_ctx = test_va_driver (t);
+  UINT num_attribs = 0, i;
+
+  memset (attribs, 0, sizeof (attribs));
+  attribs[num_attribs].type = VASurfaceAttribPixelFormat;
+  attribs[num_attribs].flags = VA_SURFACE_ATTRIB_SETTABLE;
+  attribs[num_attribs].value.type = VAGenericValueTypeInteger;
+  attribs[num_attribs++].value.value.i = fourcc;
+  if (shadow >= 0)
+    {
+      attribs[num_attribs].type = VASurfaceAttribHybridLinearShadow;
+      attribs[num_attribs].flags = VA_SURFACE_ATTRIB_SETTABLE;
+      attribs[num_attribs].value.type = VAGenericValueTypeInteger;
+      attribs[num_attribs++].value.value.i = shadow;
+    }
+  TEST_CHECK_VA (t->vtable.vaCreateSurfaces2 (&t->ctx, VA_RT_FORMAT_YUV420,
+					      WIDTH, HEIGHT, surface, 1,
+					      attribs, num_attribs));
+  obj_surface = SURFACE (*surface);
+  TEST_CHECK (obj_surface && obj_surface->bo);
+  TEST_CHECK (media_bo_map (obj_surface->bo, 1) == 0);
+  for (i = 0; i < obj_surface->bo->size; i++)
+    ((BYTE *) obj_surface->bo->virtual)[i] = rand ();
+  media_bo_unmap (obj_surface->bo);
+}
+
+static VOID
+test_shadow (TEST_VA * t, INT shadow)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = test_va_driver (t);
+  struct object_surface *obj_surface;
+  VASurfaceID surface;
+  VAImage image, put_image;
+  VAImageFormat format;
+  BYTE *map, *again;
+  UINT pitch;
+
+  create_surface (t, &surface, VA_FOURCC ('N', 'V', '1', '2'), shadow);
+  obj_surface = SURFACE (surface);
+  TEST_CHECK (obj_surface->flags & SURFACE_LINEAR_SHADOW);
+  pitch = obj_surface->width;
+  TEST_CHECK_VA (t->vtable.vaDeriveImage (&t->ctx, surface, &image));
+  TEST_CHECK (image.pitches[0] == pitch && image.pitches[1] == pitch);
+
+  /* the first map fills the copy, nested maps share it */
+  TEST_CHECK_VA (t->vtable.vaMapBuffer (&t->ctx, image.buf,
+					(VOID **) & map));
+  TEST_CHECK (map != obj_surface->bo->virtual);
+  check_linear (map, obj_surface, ~0u);
+  TEST_CHECK_VA (t->vtable.vaMapBuffer (&t->ctx, image.buf,
+					(VOID **) & again));
+  TEST_CHECK (again == map);
+  TEST_CHECK_VA (t->vtable.vaUnmapBuffer (&t->ctx, image.buf));
+  TEST_CHECK_VA (t->vtable.vaUnmapBuffer (&t->ctx, image.buf));
+
+  /* an unchanged surface maps without a refill, and an unmap writes back
+   * only what changed through the map */
+  poke_row (obj_surface, 7);
+  TEST_CHECK_VA (t->vtable.vaMapBuffer (&t->ctx, image.buf,
+					(VOID **) & map));
+  check_linear (map, obj_surface, 7);
+  map[5 * pitch + 9] ^= 0xff;
+  map[300 * pitch + pitch - 1] ^= 1;
+  TEST_CHECK_VA (t->vtable.vaUnmapBuffer (&t->ctx, image.buf));
+  TEST_CHECK (media_bo_map (obj_surface->bo, 0) == 0);
+  TEST_CHECK (*tiled_byte (obj_surface->bo, pitch, 9, 5) ==
+	      map[5 * pitch + 9]);
+  TEST_CHECK (*tiled_byte (obj_surface->bo, pitch, pitch - 1, 300) ==
+	      map[300 * pitch + pitch - 1]);
+  media_bo_unmap (obj_surface->bo);
+  check_linear (map, obj_surface, 7);
+
+  /* a put moves the generation, the next map refills */
+  memset (&format, 0, sizeof (format));
+  format.fourcc = VA_FOURCC ('N', 'V', '1', '2');
+  TEST_CHECK_VA (t->vtable.vaCreateImage (&t->ctx, &format, 64, 64,
+					  &put_image));
+  TEST_CHECK_VA (t->vtable.vaPutImage (&t->ctx, surface, put_image.image_id,
+				       0, 0, 64, 64, 16, 16, 64, 64));
+  TEST_CHECK_VA (t->vtable.vaMapBuffer (&t->ctx, image.buf,
+					(VOID **) & map));
+  check_linear (map, obj_surface, ~0u);
+  TEST_CHECK_VA (t->vtable.vaUnmapBuffer (&t->ctx, image.buf));
+
+  TEST_CHECK_VA (t->vtable.vaDestroyImage (&t->ctx, put_image.image_id));
+  TEST_CHECK_VA (t->vtable.vaDestroyImage (&t->ctx, image.image_id));
+  TEST_CHECK_VA (t->vtable.vaDestroySurfaces (&t->ctx, &surface, 1));
+}
+
+/* the BO itself, and no shadow allocated */
+static VOID
+test_no_shadow (TEST_VA * t, UINT fourcc, INT shadow)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = test_va_driver (t);
+  struct object_surface *obj_surface;
+  VASurfaceID surface;
+  VAImage image;
+  BYTE *map;
+
+  create_surface (t, &surface, fourcc, shadow);
+  obj_surface = SURFACE (surface);
+  TEST_CHECK_VA (t->vtable.vaDeriveImage (&t->ctx, surface, &image));
+  TEST_CHECK_VA (t->vtable.vaMapBuffer (&t->ctx, image.buf,
+					(VOID **) & map));
+  TEST_CHECK (map == obj_surface->bo->virtual);
+  TEST_CHECK (obj_surface->shadow == NULL);
+  TEST_CHECK_VA (t->vtable.vaUnmapBuffer (&t->ctx, image.buf));
+  TEST_CHECK_VA (t->vtable.vaDestroyImage (&t->ctx, image.image_id));
+  TEST_CHECK_VA (t->vtable.vaDestroySurfaces (&t->ctx, &surface, 1));
+}
+
+#if VA_CHECK_VERSION(0,36,0)
+/* after an export the BO is written behind the driver, maps go to it */
+static VOID
+test_export (TEST_VA * t)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = test_va_driver (t);
+  struct object_surface *obj_surface;
+  VASurfaceID surface;
+  VABufferInfo info;
+  VAImage image;
+  BYTE *map, *shadow, written;
+
+  create_surface (t, &surface, VA_FOURCC ('N', 'V', '1', '2'), 1);
+  obj_surface = SURFACE (surface);
+  TEST_CHECK_VA (t->vtable.vaDeriveImage (&t->ctx, surface, &image));
+
+  /* exported while mapped: the map keeps the copy until it is gone */
+  TEST_CHECK_VA (t->vtable.vaMapBuffer (&t->ctx, image.buf,
+					(VOID **) & shadow));
+  TEST_CHECK (shadow != obj_surface->bo->virtual);
+  memset (&info, 0, sizeof (info));
+  info.mem_type = VA_SURFACE_ATTRIB_MEM_TYPE_KERNEL_DRM;
+  TEST_CHECK_VA (t->vtable.vaAcquireBufferHandle (&t->ctx, image.buf,
+						  &info));
+  TEST_CHECK (!(obj_surface->flags & SURFACE_LINEAR_SHADOW));
+  TEST_CHECK_VA (t->vtable.vaMapBuffer (&t->ctx, image.buf,
+					(VOID **) & map));
+  TEST_CHECK (map == shadow);
+  written = shadow[3 * obj_surface->width + 1] ^= 0xff;
+  TEST_CHECK_VA (t->vtable.vaUnmapBuffer (&t->ctx, image.buf));
+  TEST_CHECK_VA (t->vtable.vaUnmapBuffer (&t->ctx, image.buf));
+  TEST_CHECK (obj_surface->shadow == NULL);
+  TEST_CHECK (media_bo_map (obj_surface->bo, 0) == 0);
+  TEST_CHECK (*tiled_byte (obj_surface->bo, obj_surface->width, 1, 3) ==
+	      written);
+  media_bo_unmap (obj_surface->bo);
+
+  /* a write by the importer shows in the next map */
+  poke_row (obj_surface, 7);
+  TEST_CHECK_VA (t->vtable.vaMapBuffer (&t->ctx, image.buf,
+					(VOID **) & map));
+  TEST_CHECK (map == obj_surface->bo->virtual);
+  TEST_CHECK (obj_surface->shadow == NULL);
+  TEST_CHECK_VA (t->vtable.vaUnmapBuffer (&t->ctx, image.buf));
+  TEST_CHECK_VA (t->vtable.vaReleaseBufferHandle (&t->ctx, image.buf));
+
+  TEST_CHECK_VA (t->vtable.vaDestroyImage (&t->ctx, image.image_id));
+  TEST_CHECK_VA (t->vtable.vaDestroySurfaces (&t->ctx, &surface, 1));
+}
+#endif
+
+static VOID
+test_encode (TEST_VA * t)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = test_va_driver (t);
+  TEST_VP8_ENCODER enc;
+  UINT before[TEST_VP8_NUM_SURFACES], input, generation, moved, frame, i;
+
+  TEST_CHECK_VA (test_vp8_encoder_open (t, &enc, WIDTH, HEIGHT,
+					VA_HYBRID_ENCODE_OUTPUT_MB_DATA));
+  for (frame = 0; frame < 2 * TEST_VP8_NUM_SURFACES; frame++)
+    {
+      input = SURFACE (enc.input)->generation;
+      for (i = 0; i < TEST_VP8_NUM_SURFACES; i++)
+	before[i] = SURFACE (enc.recon[i])->generation;
+      TEST_CHECK_VA (test_vp8_encode_frame (t, &enc, frame == 0));
+      TEST_CHECK (SURFACE (enc.input)->generation == input + 1);
+      for (i = 0, moved = 0; i < TEST_VP8_NUM_SURFACES; i++)
+	{
+	  generation = SURFACE (enc.recon[i])->generation;
+	  TEST_CHECK (generation == before[i] || generation == before[i] + 1);
+	  moved += generation != before[i];
+	}
+      TEST_CHECK (moved == 1);
+    }
+  test_vp8_encoder_close (t, &enc);
+}
+
+int
+main (int argc, char **argv)
+{
+  TEST_VA t;
+
+  srand (1);
+  unsetenv (VA_INTEL_HYBRID_LINEAR_SHADOW_ENV);
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+  test_shadow (&t, 1);
+  test_no_shadow (&t, VA_FOURCC ('N', 'V', '1', '2'), -1);
+  test_no_shadow (&t, VA_FOURCC ('N', 'V', '1', '2'), 0);
+  /* I420 surfaces are linear */
+  test_no_shadow (&t, VA_FOURCC ('I', '4', '2', '0'), 1);
+#if VA_CHECK_VERSION(0,36,0)
+  test_export (&t);
+#endif
+  test_encode (&t);
+
+  /* the environment turns it on for every surface, the attribute off */
+  setenv (VA_INTEL_HYBRID_LINEAR_SHADOW_ENV, "1", 1);
+  test_shadow (&t, -1);
+  test_no_shadow (&t, VA_FOURCC ('N', 'V', '1', '2'), 0);
+  unsetenv (VA_INTEL_HYBRID_LINEAR_SHADOW_ENV);
+  test_va_close (&t);
+  return 0;
+}
@@ -0,0 +1,410 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * The tiled <-> linear copies of vaGetImage/vaPutImage against a scalar
+ * reference that addresses every byte on its own. First on CPU buffers,
+ * for every tiling and bit 6 swizzle, NV12 to and from NV12 and I420, at
+ * random sub-rectangles of any parity: both copies start from the same
+ * random destination and must leave the same bytes everywhere. Then
+ * through the driver on the mock, whose surfaces are Y tiled, with NV12,
+ * I420 and YV12 images.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_va.h"
+#include "media_drv_image.h"
+
+#define NUM_RECTS	60
+#define SURFACE_PITCH	1024
+#define SURFACE_ROWS	96
+/* the chroma plane starts a whole tile row down, like the driver's */
+#define SURFACE_SIZE	(SURFACE_PITCH * (SURFACE_ROWS + SURFACE_ROWS / 2 + 16))
+#define IMAGE_WIDTH	720
+#define IMAGE_PITCH	736
+#define IMAGE_ROWS	80
+#define IMAGE_SIZE	(IMAGE_PITCH * IMAGE_ROWS * 2)
+
+static UINT
+test_rand (UINT n)
+{
+  return (UINT) rand () % n;
+}
+
+static VOID
+fill_random (BYTE * p, UINT size)
+{
+  UINT i;
+
+  for (i = 0; i < size; i++)
+    p[i] = rand ();
+}
+
+/* byte x of row y of a plane, one bit field at a time */
+static BYTE *
+ref_byte (const MEDIA_IMAGE_PLANE * plane, UINT x, UINT y)
+{
+  UINT row = plane->offset / plane->pitch + y;
+  UINT offset, bit6;
+
+  switch (plane->tiling)
+    {
+    case I915_TILING_X:
+      offset = (row / 8 * (plane->pitch / 512) + x / 512) * 4096
+	+ row % 8 * 512 + x % 512;
+      break;
+    case I915_TILING_Y:
+      offset = (row / 32 * (plane->pitch / 128) + x / 128) * 4096
+	+ x % 128 / 16 * 512 + row % 32 * 16 + x % 16;
+      break;
+    default:
+      return plane->base + plane->offset + y * plane->pitch + x;
+    }
+
+  if (plane->swizzle == I915_BIT_6_SWIZZLE_9)
+    bit6 = (offset >> 9) & 1;
+  else if (plane->swizzle == I915_BIT_6_SWIZZLE_9_10)
+    bit6 = ((offset >> 9) ^ (offset >> 10)) & 1;
+  else
+    bit6 = 0;
+  return plane->base + (offset ^ (bit6 << 6));
+}
+
+/* chroma sample x of row y, component 0 for U and 1 for V */
+static BYTE *
+ref_chroma (const MEDIA_IMAGE_LAYOUT * layout, UINT x, UINT y, UINT c)
+{
+  if (layout->num_planes == 2)
+    return ref_byte (&layout->plane[1], 2 * x + c, y);
+  return ref_byte (&layout->plane[1 + c], x, y);
+}
+
+/* chroma is clipped to what the rectangle covers in both layouts */
+static VOID
+ref_transfer (const MEDIA_IMAGE_LAYOUT * dst, UINT dst_x, UINT dst_y,
+	      const MEDIA_IMAGE_LAYOUT * src, UINT src_x, UINT src_y,
+	      UINT width, UINT height)
+{
+  UINT chroma_width, chroma_height, x, y, c;
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      *ref_byte (&dst->plane[0], dst_x + x, dst_y + y) =
+	*ref_byte (&src->plane[0], src_x + x, src_y + y);
+
+  chroma_width = MIN ((src_x + width + 1) / 2 - src_x / 2,
+		      (dst_x + width + 1) / 2 - dst_x / 2);
+  chroma_height = MIN ((src_y + height + 1) / 2 - src_y / 2,
+		       (dst_y + height + 1) / 2 - dst_y / 2);
+  for (y = 0; y < chroma_height; y++)
+    for (x = 0; x < chroma_width; x++)
+      for (c = 0; c < 2; c++)
+	*ref_chroma (dst, dst_x / 2 + x, dst_y / 2 + y, c) =
+	  *ref_chroma (src, src_x / 2 + x, src_y / 2 + y, c);
+}
+
+static VOID
+surface_layout (MEDIA_IMAGE_LAYOUT * layout, BYTE * base, UINT tiling,
+		UINT swizzle)
+{
+  UINT i;
+
+  memset (layout, 0, sizeof (*layout));
+  layout->fourcc = VA_FOURCC ('N', 'V', '1', '2');
+  layout->num_planes = 2;
+  layout->cpp = 1;
+  for (i = 0; i < 2; i++)
+    {
+      layout->plane[i].base = base;
+      layout->plane[i].offset = i * SURFACE_PITCH * SURFACE_ROWS;
+      layout->plane[i].pitch = SURFACE_PITCH;
+      layout->plane[i].tiling = tiling;
+      layout->plane[i].swizzle = swizzle;
+    }
+}
+
+static VOID
+image_layout (MEDIA_IMAGE_LAYOUT * layout, BYTE * base, BOOL planar)
+{
+  memset (layout, 0, sizeof (*layout));
+  layout->cpp = 1;
+  layout->plane[0].base = base;
+  layout->plane[0].pitch = IMAGE_PITCH;
+  layout->plane[1].base = base;
+  layout->plane[1].offset = IMAGE_PITCH * IMAGE_ROWS;
+  if (planar)
+    {
+      layout->fourcc = VA_FOURCC ('I', '4', '2', '0');
+      layout->num_planes = 3;
+      layout->plane[1].pitch = IMAGE_PITCH / 2;
+      layout->plane[2].base = base;
+      layout->plane[2].offset = IMAGE_PITCH * IMAGE_ROWS * 5 / 4;
+      layout->plane[2].pitch = IMAGE_PITCH / 2;
+    }
+  else
+    {
+      layout->fourcc = VA_FOURCC ('N', 'V', '1', '2');
+      layout->num_planes = 2;
+      layout->plane[1].pitch = IMAGE_PITCH;
+    }
+}
+
+/* a rectangle that fits both sides, at any parity */
+static VOID
+random_rect (UINT src_width, UINT src_height, UINT dst_width,
+	     UINT dst_height, UINT * src_x, UINT * src_y, UINT * dst_x,
+	     UINT * dst_y, UINT * width, UINT * height)
+{
+  *src_x = test_rand (src_width / 2);
+  *src_y = test_rand (src_height / 2);
+  *dst_x = test_rand (dst_width / 2);
+  *dst_y = test_rand (dst_height / 2);
+  *width = 1 + test_rand (MIN (src_width - *src_x, dst_width - *dst_x));
+  *height = 1 + test_rand (MIN (src_height - *src_y, dst_height - *dst_y));
+  /* now and then to the far edge, where the chroma rounds up */
+  if (test_rand (4) == 0)
+    *width = MIN (src_width - *src_x, dst_width - *dst_x);
+}
+
+static VOID
+check_transfer (const MEDIA_IMAGE_LAYOUT * dst,
+		const MEDIA_IMAGE_LAYOUT * ref_dst, const BYTE * dst_base,
+		const BYTE * ref_base, UINT dst_size,
+		const MEDIA_IMAGE_LAYOUT * src, UINT dst_width,
+		UINT dst_height, UINT src_width, UINT src_height)
+{
+  UINT src_x, src_y, dst_x, dst_y, width, height;
+
+  random_rect (src_width, src_height, dst_width, dst_height, &src_x, &src_y,
+	       &dst_x, &dst_y, &width, &height);
+  TEST_CHECK (media_image_transfer (dst, dst_x, dst_y, src, src_x, src_y,
+				    width, height) == VA_STATUS_SUCCESS);
+  ref_transfer (ref_dst, dst_x, dst_y, src, src_x, src_y, width, height);
+  if (memcmp (dst_base, ref_base, dst_size) != 0)
+    {
+      fprintf (stderr, "%ux%u from (%u,%u) to (%u,%u), tiling %u "
+	       "swizzle %u, %u to %u planes\n", width, height, src_x, src_y,
+	       dst_x, dst_y, MAX (src->plane[0].tiling, dst->plane[0].tiling),
+	       MAX (src->plane[0].swizzle, dst->plane[0].swizzle),
+	       src->num_planes, dst->num_planes);
+      TEST_CHECK (!"same bytes as the reference");
+    }
+}
+
+static VOID
+test_layouts (UINT tiling, UINT swizzle)
+{
+  MEDIA_IMAGE_LAYOUT surface, ref_surface, image, ref_image;
+  BYTE *surface_base, *ref_surface_base, *image_base, *ref_image_base;
+  UINT n;
+
+  surface_base = malloc (SURFACE_SIZE);
+  ref_surface_base = malloc (SURFACE_SIZE);
+  image_base = malloc (IMAGE_SIZE);
+  ref_image_base = malloc (IMAGE_SIZE);
+  TEST_CHECK (surface_base && ref_surface_base && image_base &&
+	      ref_image_base);
+  surface_layout (&surface, surface_base, tiling, swizzle);
+  surface_layout (&ref_surface, ref_surface_base, tiling, swizzle);
+
+  for (n = 0; n < NUM_RECTS; n++)
+    {
+      BOOL planar = n & 1;
+
+      image_layout (&image, image_base, planar);
+      image_layout (&ref_image, ref_image_base, planar);
+
+      /* get */
+      fill_random (surface_base, SURFACE_SIZE);
+      fill_random (image_base, IMAGE_SIZE);
+      memcpy (ref_image_base, image_base, IMAGE_SIZE);
+      check_transfer (&image, &ref_image, image_base, ref_image_base,
+		      IMAGE_SIZE, &surface, IMAGE_WIDTH, IMAGE_ROWS,
+		      SURFACE_PITCH, SURFACE_ROWS);
+
+      /* put */
+      fill_random (surface_base, SURFACE_SIZE);
+      memcpy (ref_surface_base, surface_base, SURFACE_SIZE);
+      check_transfer (&surface, &ref_surface, surface_base,
+		      ref_surface_base, SURFACE_SIZE, &image, SURFACE_PITCH,
+		      SURFACE_ROWS, IMAGE_WIDTH, IMAGE_ROWS);
+    }
+
+  free (surface_base);
+  free (ref_surface_base);
+  free (image_base);
+  free (ref_image_base);
+}
+
+/* the driver's surface and image through the reference addressing */
+static VOID
+map_surface (struct object_surface *obj_surface, MEDIA_IMAGE_LAYOUT * layout)
+{
+  UINT tiling, swizzle;
+
+  TEST_CHECK (media_bo_map (obj_surface->bo, 1) == 0);
+  media_bo_get_tiling (obj_surface->bo, &tiling, &swizzle);
+  surface_layout (layout, obj_surface->bo->virtual, tiling, swizzle);
+  layout->plane[0].pitch = obj_surface->width;
+  layout->plane[1].pitch = obj_surface->cb_cr_pitch;
+  layout->plane[1].offset = obj_surface->width * obj_surface->y_cb_offset;
+}
+
+static VOID
+map_image (struct object_image *obj_image, MEDIA_IMAGE_LAYOUT * layout)
+{
+  const VAImage *image = &obj_image->image;
+  BYTE *base;
+  UINT i, plane;
+
+  TEST_CHECK (media_bo_map (obj_image->bo, 1) == 0);
+  base = obj_image->bo->virtual;
+  memset (layout, 0, sizeof (*layout));
+  layout->num_planes = image->num_planes;
+  for (i = 0; i < image->num_planes; i++)
+    {
+      /* U first */
+      plane = image->format.fourcc == VA_FOURCC ('Y', 'V', '1', '2') && i ?
+	3 - i : i;
+      layout->plane[i].base = base;
+      layout->plane[i].offset = image->offsets[plane];
+      layout->plane[i].pitch = image->pitches[plane];
+    }
+}
+
+static VOID
+check_rect (const MEDIA_IMAGE_LAYOUT * a, UINT a_x, UINT a_y,
+	    const MEDIA_IMAGE_LAYOUT * b, UINT b_x, UINT b_y, UINT width,
+	    UINT height)
+{
+  UINT x, y, c;
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      TEST_CHECK (*ref_byte (&a->plane[0], a_x + x, a_y + y) ==
+		  *ref_byte (&b->plane[0], b_x + x, b_y + y));
+  for (y = 0; y < (height + 1) / 2; y++)
+    for (x = 0; x < (width + 1) / 2; x++)
+      for (c = 0; c < 2; c++)
+	TEST_CHECK (*ref_chroma (a, a_x / 2 + x, a_y / 2 + y, c) ==
+		    *ref_chroma (b, b_x / 2 + x, b_y / 2 + y, c));
+}
+
+static VOID
+test_driver (TEST_VA * t, UINT fourcc)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = test_va_driver (t);
+  struct object_surface *obj_surface[2];
+  struct object_image *obj_image;
+  MEDIA_IMAGE_LAYOUT surface_layout, image_layout;
+  VAImageFormat format;
+  VASurfaceID surfaces[2];
+  VAImage image;
+  UINT tiling, swizzle, i;
+
+  TEST_CHECK_VA (t->vtable.vaCreateSurfaces2 (&t->ctx, VA_RT_FORMAT_YUV420,
+					      352, 288, surfaces, 2, NULL,
+					      0));
+  for (i = 0; i < 2; i++)
+    {
+      obj_surface[i] = SURFACE (surfaces[i]);
+      TEST_CHECK (obj_surface[i] && obj_surface[i]->bo);
+      TEST_CHECK (media_bo_map (obj_surface[i]->bo, 1) == 0);
+      fill_random (obj_surface[i]->bo->virtual, obj_surface[i]->bo->size);
+      media_bo_unmap (obj_surface[i]->bo);
+    }
+  media_bo_get_tiling (obj_surface[0]->bo, &tiling, &swizzle);
+  TEST_CHECK (tiling == I915_TILING_Y);
+
+  memset (&format, 0, sizeof (format));
+  format.fourcc = fourcc;
+  TEST_CHECK_VA (t->vtable.vaCreateImage (&t->ctx, &format, 160, 96,
+					  &image));
+  obj_image = IMAGE (image.image_id);
+  TEST_CHECK (obj_image != NULL);
+
+  /* odd corner, the rectangle as large as the image */
+  TEST_CHECK_VA (t->vtable.vaGetImage (&t->ctx, surfaces[0], 33, 17, 160,
+				       96, image.image_id));
+  map_surface (obj_surface[0], &surface_layout);
+  map_image (obj_image, &image_layout);
+  check_rect (&image_layout, 0, 0, &surface_layout, 33, 17, 160, 96);
+  media_bo_unmap (obj_image->bo);
+  media_bo_unmap (obj_surface[0]->bo);
+
+  TEST_CHECK_VA (t->vtable.vaPutImage (&t->ctx, surfaces[1],
+				       image.image_id, 2, 4, 150, 90, 100,
+				       60, 150, 90));
+  map_surface (obj_surface[1], &surface_layout);
+  map_image (obj_image, &image_layout);
+  check_rect (&surface_layout, 100, 60, &image_layout, 2, 4, 150, 90);
+  media_bo_unmap (obj_image->bo);
+  media_bo_unmap (obj_surface[1]->bo);
+
+  /* out of the surface, out of the image, scaled */
+  TEST_CHECK (t->vtable.vaGetImage (&t->ctx, surfaces[0], 200, 0, 160, 96,
+				    image.image_id) ==
+	      VA_STATUS_ERROR_INVALID_PARAMETER);
+  TEST_CHECK (t->vtable.vaGetImage (&t->ctx, surfaces[0], 0, 0, 161, 96,
+				    image.image_id) ==
+	      VA_STATUS_ERROR_INVALID_PARAMETER);
+  TEST_CHECK (t->vtable.vaPutImage (&t->ctx, surfaces[1], image.image_id,
+				    0, 0, 160, 96, 0, 0, 320, 192) ==
+	      VA_STATUS_ERROR_UNIMPLEMENTED);
+
+  TEST_CHECK_VA (t->vtable.vaDestroyImage (&t->ctx, image.image_id));
+  TEST_CHECK_VA (t->vtable.vaDestroySurfaces (&t->ctx, surfaces, 2));
+}
+
+int
+main (int argc, char **argv)
+{
+  static const UINT swizzles[] = { I915_BIT_6_SWIZZLE_NONE,
+    I915_BIT_6_SWIZZLE_9, I915_BIT_6_SWIZZLE_9_10
+  };
+  TEST_VA t;
+  UINT i;
+
+  srand (1);
+  test_layouts (I915_TILING_NONE, I915_BIT_6_SWIZZLE_NONE);
+  for (i = 0; i < ARRAY_ELEMS (swizzles); i++)
+    {
+      TEST_CHECK (media_image_swizzle_supported (I915_TILING_X,
+						 swizzles[i]));
+      test_layouts (I915_TILING_X, swizzles[i]);
+      test_layouts (I915_TILING_Y, swizzles[i]);
+    }
+  TEST_CHECK (!media_image_swizzle_supported (I915_TILING_X,
+					      I915_BIT_6_SWIZZLE_9_10_11));
+
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+  test_driver (&t, VA_FOURCC ('N', 'V', '1', '2'));
+  test_driver (&t, VA_FOURCC ('I', '4', '2', '0'));
+  test_driver (&t, VA_FOURCC ('Y', 'V', '1', '2'));
+  test_va_close (&t);
+  return 0;
+}
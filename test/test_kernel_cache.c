@@ -0,0 +1,203 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Kernel loading at context creation. Two VP8 encode contexts share the
+ * instruction BO of every GPE context, which holds the kernels at the
+ * offsets the contexts use and goes away with the last of them. A VP9
+ * decode context on the mock CM runtime loads four programs; the scaling
+ * one comes with the first frame whose references differ in size.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_cmrt.h"
+#include "media_drv_encoder.h"
+
+#define NUM_GPE_CONTEXTS	7
+#define MAX_FRAME_SIZE		(64 * 1024)
+
+static VOID
+get_gpe_contexts (TEST_VA * t, TEST_VP8_ENCODER * enc,
+		  MEDIA_GPE_CTX * gpe_contexts[NUM_GPE_CONTEXTS])
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = test_va_driver (t);
+  MEDIA_ENCODER_CTX *encoder_context =
+    (MEDIA_ENCODER_CTX *) CONTEXT (enc->context)->hw_context;
+
+  gpe_contexts[0] = &encoder_context->me_context.gpe_context;
+  gpe_contexts[1] = &encoder_context->mbenc_context.gpe_context;
+  gpe_contexts[2] = &encoder_context->mbpak_context.gpe_context;
+  gpe_contexts[3] = &encoder_context->mbpak_context.gpe_context2;
+  gpe_contexts[4] = &encoder_context->scaling_context.gpe_context;
+  gpe_contexts[5] = &encoder_context->brc_init_reset_context.gpe_context;
+  gpe_contexts[6] = &encoder_context->brc_update_context.gpe_context;
+}
+
+/* every kernel of the context is where the context will point at it */
+static VOID
+check_kernels (MEDIA_GPE_CTX * gpe_context)
+{
+  dri_bo *bo = gpe_context->instruction_state.buff_obj.bo;
+  MEDIA_KERNEL *kernel;
+  INT i;
+
+  if (!bo)
+    return;
+  TEST_CHECK (media_bo_map (bo, 0) == 0);
+  for (i = 0; i < gpe_context->num_kernels; i++)
+    {
+      kernel = &gpe_context->kernels[i];
+      TEST_CHECK (kernel->kernel_offset + kernel->size <= bo->size);
+      TEST_CHECK (!memcmp ((BYTE *) bo->virtual + kernel->kernel_offset,
+			   kernel->bin, kernel->size));
+    }
+  media_bo_unmap (bo);
+}
+
+static VOID
+test_encoder (TEST_VA * t)
+{
+  MEDIA_GPE_CTX *a[NUM_GPE_CONTEXTS], *b[NUM_GPE_CONTEXTS];
+  TEST_VP8_ENCODER enc_a, enc_b;
+  UINT bos, bos_a, bos_b, kernel_bos, i, j;
+
+  bos = media_bufmgr_mock_num_bos (test_va_bufmgr (t));
+  TEST_CHECK_VA (test_vp8_encoder_open (t, &enc_a, 176, 144,
+					VA_HYBRID_ENCODE_OUTPUT_MB_DATA));
+  bos_a = media_bufmgr_mock_num_bos (test_va_bufmgr (t)) - bos;
+  TEST_CHECK_VA (test_vp8_encoder_open (t, &enc_b, 176, 144,
+					VA_HYBRID_ENCODE_OUTPUT_MB_DATA));
+  bos_b = media_bufmgr_mock_num_bos (test_va_bufmgr (t)) - bos - bos_a;
+  get_gpe_contexts (t, &enc_a, a);
+  get_gpe_contexts (t, &enc_b, b);
+
+  for (i = 0; i < NUM_GPE_CONTEXTS; i++)
+    {
+      /* some generations leave the ME and scaling contexts without kernels */
+      TEST_CHECK ((a[i]->instruction_state.buff_obj.bo != NULL) ==
+		  (a[i]->num_kernels != 0));
+      TEST_CHECK (a[i]->instruction_state.buff_obj.bo ==
+		  b[i]->instruction_state.buff_obj.bo);
+      TEST_CHECK (a[i]->num_kernels == b[i]->num_kernels);
+      for (j = 0; j < a[i]->num_kernels; j++)
+	TEST_CHECK (a[i]->kernels[j].kernel_offset ==
+		    b[i]->kernels[j].kernel_offset);
+      check_kernels (a[i]);
+    }
+  /* the second context allocated none of the kernel BOs */
+  for (i = 0, kernel_bos = 0; i < NUM_GPE_CONTEXTS; i++)
+    {
+      if (!a[i]->instruction_state.buff_obj.bo)
+	continue;
+      for (j = 0; j < i; j++)
+	if (a[j]->instruction_state.buff_obj.bo ==
+	    a[i]->instruction_state.buff_obj.bo)
+	  break;
+      kernel_bos += j == i;
+    }
+  TEST_CHECK (kernel_bos > 0 && bos_b + kernel_bos == bos_a);
+
+  /* the BOs outlive the first context and go with the second */
+  test_vp8_encoder_close (t, &enc_a);
+  for (i = 0; i < NUM_GPE_CONTEXTS; i++)
+    check_kernels (b[i]);
+  TEST_CHECK_VA (test_vp8_encode_frame (t, &enc_b, TRUE));
+  test_vp8_encoder_close (t, &enc_b);
+  media_surface_pool_trim (&test_va_driver (t)->surface_pool, 0, 0);
+  TEST_CHECK (media_bufmgr_mock_num_bos (test_va_bufmgr (t)) == bos);
+}
+
+static UINT
+make_frame (TEST_VP9_FRAME * f, UINT n, BOOL key_frame, UINT width,
+	    UINT height, BYTE * data)
+{
+  memset (f, 0, sizeof (*f));
+  f->key_frame = key_frame;
+  f->show_frame = TRUE;
+  f->width = width;
+  f->height = height;
+  f->refresh_frame_flags = key_frame ? 0xff : 0x01;
+  f->ref_frame_idx[1] = 1;
+  f->ref_frame_idx[2] = 2;
+  f->size_from_ref = -1;
+  f->interp_filter = 4;
+  f->filter_level = 20;
+  f->base_q_idx = 60;
+  f->tx_mode = 4;
+  return test_vp9_write_tiled_frame (f, key_frame ? 24000 : 6000, n, data,
+				     MAX_FRAME_SIZE);
+}
+
+static VOID
+test_decoder (TEST_VA * t)
+{
+  static BYTE data[MAX_FRAME_SIZE];
+  TEST_VP9_DECODER dec;
+  TEST_CMRT_STATS stats;
+  TEST_VP9_FRAME f;
+  UINT size;
+
+  test_cmrt_reset_stats ();
+  TEST_CHECK_VA (test_vp9_decoder_open (t, &dec, 352, 288,
+					VA_HYBRID_DECODE_MODE_NORMAL));
+  test_cmrt_get_stats (&stats);
+  TEST_CHECK (stats.devices == 1 && stats.programs == 4);
+
+  size = make_frame (&f, 0, TRUE, 352, 288, data);
+  TEST_CHECK_VA (test_vp9_decode_frame (t, &dec, &f, data, size));
+  size = make_frame (&f, 1, FALSE, 352, 288, data);
+  TEST_CHECK_VA (test_vp9_decode_frame (t, &dec, &f, data, size));
+  test_cmrt_get_stats (&stats);
+  TEST_CHECK (stats.enqueues > 0 && stats.programs == 4);
+
+  /* half the size of its references */
+  size = make_frame (&f, 2, FALSE, 176, 144, data);
+  TEST_CHECK_VA (test_vp9_decode_frame (t, &dec, &f, data, size));
+  test_cmrt_get_stats (&stats);
+  TEST_CHECK (stats.programs == 5);
+  size = make_frame (&f, 3, FALSE, 352, 288, data);
+  TEST_CHECK_VA (test_vp9_decode_frame (t, &dec, &f, data, size));
+  test_cmrt_get_stats (&stats);
+  TEST_CHECK (stats.programs == 5);
+
+  test_vp9_decoder_close (t, &dec);
+  test_cmrt_get_stats (&stats);
+  TEST_CHECK (stats.live_devices == 0 && stats.live_programs == 0);
+}
+
+int
+main (int argc, char **argv)
+{
+  TEST_VA t;
+
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+  test_cmrt_enable ();
+  test_encoder (&t);
+  test_decoder (&t);
+  test_va_close (&t);
+  return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Drives the VA entry points of the driver on the CPU mock: a few VP8
+ * frames through the encoder, and the VP9 decoder, which must refuse the
+ * context before the CM runtime sees the mock bufmgr. Every recorded
+ * batch must be terminated and carry its relocations inside the used
+ * range, and every buffer object must be released once the sessions are
+ * torn down.
+ */
+
+#include <stdlib.h>
+#include "test_va.h"
+#include "media_drv_hwcmds.h"
+
+static VOID
+check_execs (dri_bufmgr * bufmgr)
+{
+  const MEDIA_MOCK_EXEC *exec;
+  UINT i, j;
+
+  for (i = 0; i < media_bufmgr_mock_num_execs (bufmgr); i++)
+    {
+      exec = media_bufmgr_mock_get_exec (bufmgr, i);
+      TEST_CHECK (exec->used >= 8 && (exec->used & 7) == 0);
+      TEST_CHECK (exec->cmds[exec->used / 4 - 1] == MI_BATCH_BUFFER_END);
+      for (j = 0; j < exec->num_relocs; j++)
+	TEST_CHECK (exec->relocs[j].offset + 4 <= exec->used);
+    }
+}
+
+static VOID
+test_encode (TEST_VA * t)
+{
+  dri_bufmgr *bufmgr = test_va_bufmgr (t);
+  TEST_VP8_ENCODER enc;
+  UINT bos, execs;
+  INT i;
+
+  bos = media_bufmgr_mock_num_bos (bufmgr);
+  TEST_CHECK_VA (test_vp8_encoder_open (t, &enc, 176, 144,
+					VA_HYBRID_ENCODE_OUTPUT_MB_DATA));
+  for (i = 0; i < 4; i++)
+    {
+      execs = media_bufmgr_mock_num_execs (bufmgr);
+      TEST_CHECK_VA (test_vp8_encode_frame (t, &enc, i == 0));
+      /* every frame is recorded into one batch */
+      TEST_CHECK (media_bufmgr_mock_num_execs (bufmgr) == execs + 1);
+    }
+  check_execs (bufmgr);
+  test_vp8_encoder_close (t, &enc);
+  media_bufmgr_mock_clear_execs (bufmgr);
+  /* the destroyed surfaces park their BOs in the pool */
+  media_surface_pool_trim (&test_va_driver (t)->surface_pool, 0, 0);
+  TEST_CHECK (media_bufmgr_mock_num_bos (bufmgr) == bos);
+}
+
+static VOID
+test_decode (TEST_VA * t)
+{
+  VAConfigID config;
+  VAContextID context;
+  VASurfaceID surfaces[8];
+  VAStatus status;
+  UINT bos = media_bufmgr_mock_num_bos (test_va_bufmgr (t));
+
+  TEST_CHECK_VA (t->vtable.vaCreateConfig (&t->ctx, VAProfileVP9Profile0,
+					   VAEntrypointVLD, NULL, 0,
+					   &config));
+  TEST_CHECK_VA (t->vtable.vaCreateSurfaces2 (&t->ctx, VA_RT_FORMAT_YUV420,
+					      352, 288, surfaces, 8, NULL,
+					      0));
+  status = t->vtable.vaCreateContext (&t->ctx, config, 352, 288,
+				      VA_PROGRESSIVE, surfaces, 8, &context);
+  /* the CM runtime is never handed the mock bufmgr */
+  TEST_CHECK (status != VA_STATUS_SUCCESS);
+  t->vtable.vaDestroySurfaces (&t->ctx, surfaces, 8);
+  t->vtable.vaDestroyConfig (&t->ctx, config);
+  media_surface_pool_trim (&test_va_driver (t)->surface_pool, 0, 0);
+  TEST_CHECK (media_bufmgr_mock_num_bos (test_va_bufmgr (t)) == bos);
+}
+
+int
+main (int argc, char **argv)
+{
+  TEST_VA t;
+
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+  test_encode (&t);
+  test_decode (&t);
+  test_va_close (&t);
+  return 0;
+}
@@ -0,0 +1,314 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * The PutSurface render state cache, on Haswell, Broadwell and Skylake
+ * mocks. The same series of PutSurface calls is made twice, on a fresh
+ * driver each time: once with the cache, once with the cache invalidated
+ * before every call so all the state is written again. Every call must
+ * emit the same batches, with the same relocations to BOs of the same
+ * contents, both times. A repeated call must also leave the cached
+ * sampler state alone, and a changed one write it again.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_va.h"
+#include "media_drv_surface.h"
+#include "media_drv_render.h"
+
+#define SRC_WIDTH	352
+#define SRC_HEIGHT	288
+#define DST_WIDTH	640
+#define DST_HEIGHT	480
+#define MAX_RECORD	(64 * 1024)
+
+typedef struct _render_call
+{
+  UINT src;			/* 0 NV12, 1 I420 */
+  VARectangle src_rect;
+  VARectangle dst_rect;
+  UINT flags;
+  INT brightness;
+} RENDER_CALL;
+
+static const RENDER_CALL calls[] = {
+  {0, {0, 0, SRC_WIDTH, SRC_HEIGHT}, {0, 0, DST_WIDTH, DST_HEIGHT},
+   VA_SRC_BT601, 0},
+  {0, {0, 0, SRC_WIDTH, SRC_HEIGHT}, {0, 0, DST_WIDTH, DST_HEIGHT},
+   VA_SRC_BT601, 0},
+  {0, {16, 8, 320, 240}, {32, 16, 320, 240}, VA_SRC_BT601, 0},
+  {0, {16, 8, 320, 240}, {32, 16, 320, 240}, VA_SRC_BT709, 0},
+  {1, {0, 0, SRC_WIDTH, SRC_HEIGHT}, {0, 0, DST_WIDTH, DST_HEIGHT},
+   VA_SRC_BT709, 0},
+  {1, {0, 0, SRC_WIDTH, SRC_HEIGHT}, {8, 8, 352, 288}, VA_SRC_BT709, 0},
+  {0, {0, 0, SRC_WIDTH, SRC_HEIGHT}, {0, 0, DST_WIDTH, DST_HEIGHT},
+   VA_SRC_BT601, 0},
+  {0, {0, 0, SRC_WIDTH, SRC_HEIGHT}, {0, 0, DST_WIDTH, DST_HEIGHT},
+   VA_SRC_BT601, 20},
+  {0, {0, 0, SRC_WIDTH, SRC_HEIGHT}, {0, 0, DST_WIDTH, DST_HEIGHT},
+   VA_SRC_BT601 | VA_FILTER_SCALING_HQ, 20},
+  {0, {0, 0, SRC_WIDTH, SRC_HEIGHT}, {0, 0, DST_WIDTH, DST_HEIGHT},
+   VA_SRC_BT601, 20},
+};
+
+#define NUM_CALLS	(sizeof (calls) / sizeof (calls[0]))
+
+/* what a call emitted, with the contents of every BO a batch points at */
+typedef struct _render_record
+{
+  UINT len;
+  UINT words[MAX_RECORD];
+} RENDER_RECORD;
+
+static RENDER_RECORD records[2][NUM_CALLS];
+
+typedef struct _render_test
+{
+  TEST_VA t;
+  VASurfaceID surfaces[2];
+} RENDER_TEST;
+
+static VOID
+record (RENDER_RECORD * r, UINT word)
+{
+  TEST_CHECK (r->len < MAX_RECORD);
+  r->words[r->len++] = word;
+}
+
+static UINT
+bo_hash (dri_bufmgr * bufmgr, UINT handle)
+{
+  dri_bo *bo = media_bo_create_from_name (bufmgr, "render cache", handle);
+  UINT h = 2166136261u;
+  unsigned long i;
+
+  TEST_CHECK (bo != NULL);
+  TEST_CHECK (media_bo_map (bo, 0) == 0);
+  for (i = 0; i < bo->size; i++)
+    h = (h ^ ((BYTE *) bo->virtual)[i]) * 16777619u;
+  media_bo_unmap (bo);
+  media_bo_unreference (bo);
+  return h;
+}
+
+static VOID
+record_execs (TEST_VA * t, RENDER_RECORD * r)
+{
+  dri_bufmgr *bufmgr = test_va_bufmgr (t);
+  const MEDIA_MOCK_EXEC *exec;
+  UINT i, j;
+
+  r->len = 0;
+  for (i = 0; i < media_bufmgr_mock_num_execs (bufmgr); i++)
+    {
+      exec = media_bufmgr_mock_get_exec (bufmgr, i);
+      record (r, exec->ring);
+      record (r, exec->used);
+      for (j = 0; j < exec->used / 4; j++)
+	record (r, exec->cmds[j]);
+      record (r, exec->num_relocs);
+      for (j = 0; j < exec->num_relocs; j++)
+	{
+	  record (r, exec->relocs[j].offset);
+	  record (r, exec->relocs[j].target_handle);
+	  record (r, exec->relocs[j].target_offset);
+	  record (r, exec->relocs[j].read_domains);
+	  record (r, exec->relocs[j].write_domain);
+	  record (r, bo_hash (bufmgr, exec->relocs[j].target_handle));
+	}
+    }
+  TEST_CHECK (r->len > 0);
+}
+
+static VOID
+create_source (TEST_VA * t, VASurfaceID * surface, UINT fourcc)
+{
+  VASurfaceAttrib attrib;
+  VAImage image;
+  BYTE *map;
+  UINT i;
+
+  memset (&attrib, 0, sizeof (attrib));
+  attrib.type = VASurfaceAttribPixelFormat;
+  attrib.flags = VA_SURFACE_ATTRIB_SETTABLE;
+  attrib.value.type = VAGenericValueTypeInteger;
+  attrib.value.value.i = fourcc;
+  TEST_CHECK_VA (t->vtable.vaCreateSurfaces2 (&t->ctx, VA_RT_FORMAT_YUV420,
+					      SRC_WIDTH, SRC_HEIGHT, surface,
+					      1, &attrib, 1));
+  TEST_CHECK_VA (t->vtable.vaDeriveImage (&t->ctx, *surface, &image));
+  TEST_CHECK_VA (t->vtable.vaMapBuffer (&t->ctx, image.buf, (VOID **) & map));
+  for (i = 0; i < image.data_size; i++)
+    map[i] = i * 7;
+  TEST_CHECK_VA (t->vtable.vaUnmapBuffer (&t->ctx, image.buf));
+  TEST_CHECK_VA (t->vtable.vaDestroyImage (&t->ctx, image.image_id));
+}
+
+static BOOL
+render_open (RENDER_TEST * r, const CHAR * devid)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx;
+  struct media_render_state *render_state;
+  struct region *dest_region;
+
+  setenv (MEDIA_BUFMGR_MOCK_DEVID_ENV, devid, 1);
+  if (!test_va_open (&r->t))
+    return FALSE;
+  drv_ctx = test_va_driver (&r->t);
+  render_state = &drv_ctx->render_state;
+  TEST_CHECK (render_state->render_put_surface != NULL);
+
+  create_source (&r->t, &r->surfaces[0], VA_FOURCC ('N', 'V', '1', '2'));
+  create_source (&r->t, &r->surfaces[1], VA_FOURCC ('I', '4', '2', '0'));
+
+  /* what the DRI output would take from the drawable */
+  dest_region = calloc (1, sizeof (*dest_region));
+  TEST_CHECK (dest_region != NULL);
+  dest_region->width = DST_WIDTH;
+  dest_region->height = DST_HEIGHT;
+  dest_region->cpp = 4;
+  dest_region->pitch = DST_WIDTH * 4;
+  dest_region->bo = media_bo_alloc (drv_ctx->drv_data.bufmgr,
+				    "rendering buffer",
+				    dest_region->pitch * DST_HEIGHT, 4096);
+  TEST_CHECK (dest_region->bo != NULL);
+  media_bo_get_tiling (dest_region->bo, &dest_region->tiling,
+		       &dest_region->swizzle);
+  render_state->draw_region = dest_region;
+  return TRUE;
+}
+
+static VOID
+render_close (RENDER_TEST * r)
+{
+  TEST_CHECK_VA (r->t.vtable.vaDestroySurfaces (&r->t.ctx, r->surfaces, 2));
+  test_va_close (&r->t);
+  unsetenv (MEDIA_BUFMGR_MOCK_DEVID_ENV);
+}
+
+static VOID
+put_surface (RENDER_TEST * r, const RENDER_CALL * call)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = test_va_driver (&r->t);
+
+  /* vaSetDisplayAttributes does not store anything yet */
+  drv_ctx->brightness_attrib->value = call->brightness;
+  media_bufmgr_mock_clear_execs (test_va_bufmgr (&r->t));
+  media_render_put_surface (&r->t.ctx, SURFACE (r->surfaces[call->src]),
+			    &call->src_rect, &call->dst_rect, call->flags);
+}
+
+/* the sampler state: a byte of it changed behind the driver's back */
+static BYTE *
+sampler_byte (MEDIA_DRV_CONTEXT * drv_ctx, BOOL gen75)
+{
+  struct media_render_state *render_state = &drv_ctx->render_state;
+
+  if (gen75)
+    {
+      TEST_CHECK (media_bo_map (render_state->wm.sampler, 1) == 0);
+      return (BYTE *) render_state->wm.sampler->virtual;
+    }
+  TEST_CHECK (media_bo_map (render_state->dynamic_state.bo, 1) == 0);
+  return (BYTE *) render_state->dynamic_state.bo->virtual +
+    render_state->sampler_offset;
+}
+
+static VOID
+test_reuse (RENDER_TEST * r, BOOL gen75)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = test_va_driver (&r->t);
+  BYTE *sampler, saved;
+
+  put_surface (r, &calls[0]);
+  sampler = sampler_byte (drv_ctx, gen75);
+  saved = *sampler;
+  *sampler ^= 0xff;
+
+  /* the same source, destination and flags keep it */
+  put_surface (r, &calls[0]);
+  TEST_CHECK (*sampler == (BYTE) (saved ^ 0xff));
+  put_surface (r, &calls[2]);
+  TEST_CHECK (*sampler == (BYTE) (saved ^ 0xff));
+
+  /* another color standard writes it again */
+  put_surface (r, &calls[3]);
+  TEST_CHECK (*sampler == saved);
+}
+
+static VOID
+test_device (const CHAR * devid, BOOL gen75)
+{
+  RENDER_TEST r;
+  UINT pass, i, j;
+
+  for (pass = 0; pass < 2; pass++)
+    {
+      TEST_CHECK (render_open (&r, devid));
+      for (i = 0; i < NUM_CALLS; i++)
+	{
+	  /* the second pass writes every state as if nothing was cached */
+	  if (pass)
+	    media_render_cache_invalidate (&r.t.ctx);
+	  put_surface (&r, &calls[i]);
+	  record_execs (&r.t, &records[pass][i]);
+	}
+      render_close (&r);
+    }
+
+  for (i = 0; i < NUM_CALLS; i++)
+    {
+      const RENDER_RECORD *a = &records[0][i], *b = &records[1][i];
+
+      for (j = 0; j < a->len && j < b->len; j++)
+	if (a->words[j] != b->words[j])
+	  {
+	    fprintf (stderr, "%s call %u word %u: 0x%08x != 0x%08x\n", devid,
+		     i, j, a->words[j], b->words[j]);
+	    exit (1);
+	  }
+      TEST_CHECK (a->len == b->len);
+    }
+
+  TEST_CHECK (render_open (&r, devid));
+  test_reuse (&r, gen75);
+  render_close (&r);
+}
+
+int
+main (int argc, char **argv)
+{
+  RENDER_TEST r;
+
+  if (!render_open (&r, "0x0412"))
+    return TEST_SKIP;
+  render_close (&r);
+
+  test_device ("0x0412", TRUE);	/* Haswell GT2 */
+  test_device ("0x1616", FALSE);	/* Broadwell GT2 */
+  test_device ("0x1912", FALSE);	/* Skylake GT2 */
+  return 0;
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * The buffer store slab, on two driver instances on the mock. A block
+ * goes back to the instance it came from, whichever thread frees it, and
+ * is handed out again zeroed. Each class keeps at most
+ * MEDIA_SLAB_CACHE_DEPTH blocks and large blocks are never kept. Blocks a
+ * thread freed stay with the instance after the thread exits, until
+ * vaTerminate (run under a leak checker to see them go).
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_va.h"
+#include "media_drv_slab.h"
+
+#define BLOCK_SIZE	100
+#define NUM_BLOCKS	(MEDIA_SLAB_CACHE_DEPTH + 4)
+
+typedef struct _slab_thread
+{
+  TEST_VA *t;
+  VOID *blocks[NUM_BLOCKS];
+  UINT num_blocks;
+  VABufferID buffer;
+} SLAB_THREAD;
+
+static UINT
+slab_class (UINT size)
+{
+  UINT slab_class = 0;
+
+  while ((1U << (MEDIA_SLAB_MIN_SHIFT + slab_class)) <
+	 size + MEDIA_SLAB_HEADER_SIZE)
+    slab_class++;
+  return slab_class;
+}
+
+static VOID *
+free_main (VOID * arg)
+{
+  SLAB_THREAD *s = (SLAB_THREAD *) arg;
+  UINT i;
+
+  for (i = 0; i < s->num_blocks; i++)
+    media_slab_free (s->blocks[i]);
+  return NULL;
+}
+
+static VOID *
+create_main (VOID * arg)
+{
+  SLAB_THREAD *s = (SLAB_THREAD *) arg;
+  BYTE data[BLOCK_SIZE - MEDIA_BUFFER_STORE_SIZE];	/* the same class */
+
+  memset (data, 0x5a, sizeof (data));
+  TEST_CHECK_VA (s->t->vtable.vaCreateBuffer (&s->t->ctx, VA_INVALID_ID,
+					      VAEncMiscParameterBufferType,
+					      sizeof (data), 1, data,
+					      &s->buffer));
+  return NULL;
+}
+
+static VOID
+run (SLAB_THREAD * s, VOID * (*main) (VOID *))
+{
+  pthread_t thread;
+
+  TEST_CHECK (pthread_create (&thread, NULL, main, s) == 0);
+  TEST_CHECK (pthread_join (thread, NULL) == 0);
+}
+
+int
+main (int argc, char **argv)
+{
+  UINT cls = slab_class (BLOCK_SIZE);
+  MEDIA_SLAB *slab, *other_slab;
+  TEST_VA t, other;
+  SLAB_THREAD s;
+  VOID *block, *other_block;
+  UINT i;
+
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+  TEST_CHECK (test_va_open (&other));
+  slab = &test_va_driver (&t)->slab;
+  other_slab = &test_va_driver (&other)->slab;
+  memset (&s, 0, sizeof (s));
+  s.t = &t;
+
+  /* freed on another thread, handed out again here, zeroed */
+  block = media_slab_alloc (slab, BLOCK_SIZE);
+  TEST_CHECK (block != NULL);
+  memset (block, 0xff, BLOCK_SIZE);
+  s.blocks[0] = block;
+  s.num_blocks = 1;
+  run (&s, free_main);
+  TEST_CHECK (slab->num_free[cls] == 1);
+  TEST_CHECK (media_slab_alloc (slab, BLOCK_SIZE) == block);
+  for (i = 0; i < BLOCK_SIZE; i++)
+    TEST_CHECK (((BYTE *) block)[i] == 0);
+  TEST_CHECK (slab->num_free[cls] == 0);
+
+  /* to the instance it came from, not the one of the last alloc */
+  s.blocks[0] = block;
+  s.blocks[1] = other_block = media_slab_alloc (other_slab, BLOCK_SIZE);
+  s.num_blocks = 2;
+  run (&s, free_main);
+  TEST_CHECK (slab->num_free[cls] == 1 && other_slab->num_free[cls] == 1);
+  TEST_CHECK (media_slab_alloc (other_slab, BLOCK_SIZE) == other_block);
+  TEST_CHECK (media_slab_alloc (slab, BLOCK_SIZE) == block);
+
+  /* the cache depth, and large blocks */
+  for (i = 0; i < NUM_BLOCKS; i++)
+    s.blocks[i] = media_slab_alloc (slab, BLOCK_SIZE);
+  s.num_blocks = NUM_BLOCKS;
+  run (&s, free_main);
+  TEST_CHECK (slab->num_free[cls] == MEDIA_SLAB_CACHE_DEPTH);
+  s.blocks[0] = media_slab_alloc (slab, MEDIA_SLAB_MAX_SIZE + 1);
+  TEST_CHECK (s.blocks[0] != NULL);
+  s.num_blocks = 1;
+  run (&s, free_main);
+  TEST_CHECK (slab->num_free[cls] == MEDIA_SLAB_CACHE_DEPTH);
+
+  /* a buffer store made on a thread that has exited */
+  run (&s, create_main);
+  TEST_CHECK (slab->num_free[cls] == MEDIA_SLAB_CACHE_DEPTH - 1);
+  TEST_CHECK_VA (t.vtable.vaDestroyBuffer (&t.ctx, s.buffer));
+  TEST_CHECK (slab->num_free[cls] == MEDIA_SLAB_CACHE_DEPTH);
+
+  media_slab_free (block);
+  media_slab_free (other_block);
+  test_va_close (&other);
+  test_va_close (&t);
+  return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+/*
+ * The state commands prebuilt per GPE context must emit, dword for dword
+ * and reloc for reloc, what the per-command emitters record for the same
+ * context: STATE_BASE_ADDRESS, MEDIA_VFE_STATE and the CURBE and
+ * interface descriptor loads. Every context of the VP8 encoder is checked
+ * after two frames, once the PAK phases have set their scoreboards.
+ */
+
+#include <stdlib.h>
+#include "test_va.h"
+#include "media_drv_hwcmds.h"
+#include "media_drv_encoder.h"
+
+#define ALL_STATE_CMDS	(MEDIA_STATE_CMDS_SBA | MEDIA_STATE_CMDS_VFE |	\
+			 MEDIA_STATE_CMDS_CURBE_LOAD |			\
+			 MEDIA_STATE_CMDS_ID_LOAD)
+
+static VOID
+emit_per_command (MEDIA_BATCH_BUFFER * batch, MEDIA_GPE_CTX * gpe_context,
+		  UINT idrt_offset)
+{
+  STATE_BASE_ADDR_PARAMS state_base_addr_params;
+  VFE_STATE_PARAMS vfe_state_params;
+  CURBE_LOAD_PARAMS curbe_load_params;
+  ID_LOAD_PARAMS id_load_params;
+
+  media_drv_memset (&state_base_addr_params,
+		    sizeof (state_base_addr_params));
+  state_base_addr_params.surface_state.bo =
+    gpe_context->surface_state_binding_table.res.bo;
+  state_base_addr_params.dynamic_state.bo = gpe_context->dynamic_state.res.bo;
+  state_base_addr_params.instruction_buffer.bo =
+    gpe_context->instruction_state.buff_obj.bo;
+  mediadrv_gen_state_base_address_cmd (batch, &state_base_addr_params);
+
+  media_drv_memset (&vfe_state_params, sizeof (vfe_state_params));
+  vfe_state_params.gpgpu_mode = gpe_context->vfe_state.gpgpu_mode;
+  vfe_state_params.max_num_threads = gpe_context->vfe_state.max_num_threads;
+  vfe_state_params.num_urb_entries = gpe_context->vfe_state.num_urb_entries;
+  vfe_state_params.urb_entry_size = gpe_context->vfe_state.urb_entry_size;
+  vfe_state_params.curbe_allocation_size =
+    gpe_context->vfe_state.curbe_allocation_size;
+  vfe_state_params.scoreboard_enable = 1;
+  vfe_state_params.scoreboardDW5 = gpe_context->vfe_state.vfe_desc5.dword;
+  vfe_state_params.scoreboardDW6 = gpe_context->vfe_state.vfe_desc6.dword;
+  vfe_state_params.scoreboardDW7 = gpe_context->vfe_state.vfe_desc7.dword;
+  mediadrv_gen_media_vfe_state_cmd (batch, &vfe_state_params);
+
+  curbe_load_params.curbe_size = gpe_context->curbe_size;
+  curbe_load_params.curbe_offset = gpe_context->curbe_offset;
+  mediadrv_gen_media_curbe_load_cmd (batch, &curbe_load_params);
+  id_load_params.idrt_size = gpe_context->idrt_size;
+  id_load_params.idrt_offset = idrt_offset;
+  mediadrv_gen_media_id_load_cmd (batch, &id_load_params);
+}
+
+static VOID
+check_context (TEST_VA * t, MEDIA_ENCODER_CTX * encoder_context,
+	       MEDIA_GPE_CTX * gpe_context)
+{
+  dri_bufmgr *bufmgr = test_va_bufmgr (t);
+  MEDIA_BATCH_BUFFER *batch;
+  UINT idrt_offset = gpe_context->idrt_offset + gpe_context->idrt_size;
+
+  encoder_context->mediadrv_gen_state_cmds_build (gpe_context);
+  media_bufmgr_mock_clear_execs (bufmgr);
+
+  batch = test_va_batch (t);
+  emit_per_command (batch, gpe_context, idrt_offset);
+  media_batchbuffer_submit (batch);
+
+  batch = test_va_batch (t);
+  mediadrv_gen_state_cmds_emit (batch, gpe_context, ALL_STATE_CMDS,
+				gpe_context->curbe_offset, idrt_offset);
+  media_batchbuffer_submit (batch);
+
+  TEST_CHECK (media_bufmgr_mock_num_execs (bufmgr) == 2);
+  test_check_same_exec (media_bufmgr_mock_get_exec (bufmgr, 0),
+			media_bufmgr_mock_get_exec (bufmgr, 1));
+}
+
+int
+main (int argc, char **argv)
+{
+  TEST_VA t;
+  TEST_VP8_ENCODER enc;
+  MEDIA_DRV_CONTEXT *drv_ctx;
+  MEDIA_ENCODER_CTX *encoder_context;
+
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+  drv_ctx = test_va_driver (&t);
+  TEST_CHECK_VA (test_vp8_encoder_open (&t, &enc, 176, 144,
+					VA_HYBRID_ENCODE_OUTPUT_MB_DATA));
+  TEST_CHECK_VA (test_vp8_encode_frame (&t, &enc, TRUE));
+  TEST_CHECK_VA (test_vp8_encode_frame (&t, &enc, FALSE));
+  encoder_context =
+    (MEDIA_ENCODER_CTX *) CONTEXT (enc.context)->hw_context;
+
+  check_context (&t, encoder_context,
+		 &encoder_context->scaling_context.gpe_context);
+  check_context (&t, encoder_context,
+		 &encoder_context->me_context.gpe_context);
+  check_context (&t, encoder_context,
+		 &encoder_context->mbenc_context.gpe_context);
+  check_context (&t, encoder_context,
+		 &encoder_context->mbpak_context.gpe_context);
+  check_context (&t, encoder_context,
+		 &encoder_context->mbpak_context.gpe_context2);
+  check_context (&t, encoder_context,
+		 &encoder_context->brc_init_reset_context.gpe_context);
+  check_context (&t, encoder_context,
+		 &encoder_context->brc_update_context.gpe_context);
+
+  test_vp8_encoder_close (&t, &enc);
+  test_va_close (&t);
+  return 0;
+}
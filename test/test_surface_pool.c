@@ -0,0 +1,176 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * The surface BO pool, through vaCreateSurfaces/vaDestroySurfaces on the
+ * mock. A surface of the same size gets the BO of a destroyed one back,
+ * without a pass over its contents; another size does not. BOs a derived image still holds or that
+ * were exported through flink are not reused. Idle BOs are trimmed when a
+ * surface is released, not when one is created. The counters go to the
+ * libva info callback at vaTerminate.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_va.h"
+#include "media_drv_surface.h"
+
+static CHAR info_log[4096];
+
+static void
+info_callback (VADriverContextP ctx, const char *message)
+{
+  UINT len = strlen (info_log);
+
+  TEST_CHECK (len + strlen (message) < sizeof (info_log));
+  strcpy (info_log + len, message);
+}
+
+/*
+ * The BO of a new surface, holding fill throughout, which is 0 for a new
+ * BO and what the last user left for a reused one. It is left filled with
+ * 0x5a for the next user.
+ */
+static dri_bo *
+create_surface (TEST_VA * t, VASurfaceID * surface, INT width, INT height,
+		BYTE fill)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = test_va_driver (t);
+  struct object_surface *obj_surface;
+  dri_bo *bo;
+  UINT i;
+
+  TEST_CHECK_VA (t->vtable.vaCreateSurfaces2 (&t->ctx, VA_RT_FORMAT_YUV420,
+					      width, height, surface, 1, NULL,
+					      0));
+  obj_surface = SURFACE (*surface);
+  TEST_CHECK (obj_surface && obj_surface->bo);
+  bo = obj_surface->bo;
+  TEST_CHECK (media_bo_map (bo, 1) == 0);
+  for (i = 0; i < bo->size; i++)
+    TEST_CHECK (((BYTE *) bo->virtual)[i] == fill);
+  memset (bo->virtual, 0x5a, bo->size);
+  media_bo_unmap (bo);
+  return bo;
+}
+
+static VOID
+destroy_surface (TEST_VA * t, VASurfaceID surface)
+{
+  TEST_CHECK_VA (t->vtable.vaDestroySurfaces (&t->ctx, &surface, 1));
+}
+
+static VOID
+check_stats (MEDIA_SURFACE_POOL * pool, UINT hits, UINT misses,
+	     UINT rejected, UINT trimmed)
+{
+  MEDIA_SURFACE_POOL_STATS stats;
+
+  media_surface_pool_get_stats (pool, &stats);
+  TEST_CHECK (stats.hits == hits);
+  TEST_CHECK (stats.misses == misses);
+  TEST_CHECK (stats.acquires == hits + misses);
+  TEST_CHECK (stats.rejected == rejected);
+  TEST_CHECK (stats.trimmed == trimmed);
+}
+
+int
+main (int argc, char **argv)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx;
+  MEDIA_SURFACE_POOL *pool;
+  VASurfaceID a, b, big;
+  VABufferInfo info;
+  VAImage image;
+  dri_bo *bo;
+  UINT handle;
+  TEST_VA t;
+
+  setenv ("VA_INTEL_DEBUG", "0x10", 1);
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+  unsetenv ("VA_INTEL_DEBUG");
+  t.ctx.info_callback = info_callback;
+  drv_ctx = test_va_driver (&t);
+  pool = &drv_ctx->surface_pool;
+
+  /* the same size takes the BO back as it was left */
+  bo = create_surface (&t, &a, 352, 288, 0);
+  destroy_surface (&t, a);
+  TEST_CHECK (create_surface (&t, &a, 352, 288, 0x5a) == bo);
+  check_stats (pool, 1, 1, 0, 0);
+
+  /* another pitch does not */
+  bo = create_surface (&t, &big, 1920, 1080, 0);
+  destroy_surface (&t, big);
+  TEST_CHECK (create_surface (&t, &b, 352, 288, 0) != bo);
+  check_stats (pool, 1, 3, 0, 0);
+  destroy_surface (&t, b);
+
+  /* a derived image still holds the BO */
+  TEST_CHECK_VA (t.vtable.vaDeriveImage (&t.ctx, a, &image));
+  handle = SURFACE (a)->bo->handle;
+  destroy_surface (&t, a);
+  check_stats (pool, 1, 3, 1, 0);
+  TEST_CHECK_VA (t.vtable.vaDestroyImage (&t.ctx, image.image_id));
+  bo = create_surface (&t, &a, 352, 288, 0x5a);
+  TEST_CHECK (bo->handle != handle);
+  check_stats (pool, 2, 3, 1, 0);
+
+  /* a BO that left through flink */
+  TEST_CHECK_VA (t.vtable.vaDeriveImage (&t.ctx, a, &image));
+  memset (&info, 0, sizeof (info));
+  info.mem_type = VA_SURFACE_ATTRIB_MEM_TYPE_KERNEL_DRM;
+  TEST_CHECK_VA (t.vtable.vaAcquireBufferHandle (&t.ctx, image.buf, &info));
+  TEST_CHECK_VA (t.vtable.vaReleaseBufferHandle (&t.ctx, image.buf));
+  TEST_CHECK_VA (t.vtable.vaDestroyImage (&t.ctx, image.image_id));
+  destroy_surface (&t, a);
+  check_stats (pool, 2, 3, 2, 0);
+  TEST_CHECK (create_surface (&t, &a, 352, 288, 0) != bo);
+  check_stats (pool, 2, 4, 2, 0);
+
+  /* an idle BO outlives a create, and goes with the next release */
+  TEST_CHECK (pool->cached != NULL && pool->cached->pitch == 1920 &&
+	      pool->cached->next == NULL);
+  pool->cached->released_ms -= MEDIA_SURFACE_POOL_MAX_AGE_MS + 1;
+  create_surface (&t, &b, 176, 144, 0);
+  check_stats (pool, 2, 5, 2, 0);
+  TEST_CHECK (pool->cached != NULL && pool->cached->pitch == 1920);
+  destroy_surface (&t, b);
+  check_stats (pool, 2, 5, 2, 1);
+  TEST_CHECK (pool->cached != NULL && pool->cached->pitch != 1920 &&
+	      pool->cached->next == NULL);
+
+  /* trimming to nothing */
+  media_surface_pool_trim (pool, 0, MEDIA_SURFACE_POOL_MAX_AGE_MS);
+  check_stats (pool, 2, 5, 2, 2);
+  TEST_CHECK (pool->cached == NULL && pool->stats.cached_bytes == 0);
+
+  destroy_surface (&t, a);
+  test_va_close (&t);
+  TEST_CHECK (strstr (info_log, "surface bo pool: acquires=7 hits=2 "
+		      "misses=5 releases=7 rejected=2 trimmed=2") != NULL);
+  return 0;
+}
@@ -0,0 +1,401 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "config.h"
+#include "test_va.h"
+
+VAStatus VA_DRIVER_INIT_FUNC (VADriverContextP ctx);
+
+BOOL
+test_va_open (TEST_VA * t)
+{
+  memset (t, 0, sizeof (*t));
+  setenv (MEDIA_BUFMGR_ENV, MEDIA_BUFMGR_MOCK, 1);
+
+  t->drm_state.fd = -1;
+  t->drm_state.auth_type = VA_DRM_AUTH_CUSTOM;
+  t->ctx.drm_state = &t->drm_state;
+  t->ctx.vtable = &t->vtable;
+  t->ctx.vtable_vpp = &t->vtable_vpp;
+  t->ctx.display_type = VA_DISPLAY_DRM;
+
+  return VA_DRIVER_INIT_FUNC (&t->ctx) == VA_STATUS_SUCCESS;
+}
+
+VOID
+test_va_close (TEST_VA * t)
+{
+  if (t->ctx.pDriverData)
+    t->vtable.vaTerminate (&t->ctx);
+}
+
+MEDIA_DRV_CONTEXT *
+test_va_driver (TEST_VA * t)
+{
+  return (MEDIA_DRV_CONTEXT *) t->ctx.pDriverData;
+}
+
+dri_bufmgr *
+test_va_bufmgr (TEST_VA * t)
+{
+  return test_va_driver (t)->drv_data.bufmgr;
+}
+
+VOID
+test_va_fill_surface (TEST_VA * t, VASurfaceID surface, INT width,
+		      INT height, UINT frame_num)
+{
+  VAImage image;
+  BYTE *map;
+  INT x, y;
+
+  TEST_CHECK_VA (t->vtable.vaDeriveImage (&t->ctx, surface, &image));
+  TEST_CHECK_VA (t->vtable.vaMapBuffer (&t->ctx, image.buf, (VOID **) & map));
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      map[image.offsets[0] + y * image.pitches[0] + x] =
+	(BYTE) (x + y + frame_num * 3);
+  for (y = 0; y < height / 2; y++)
+    for (x = 0; x < width; x++)
+      map[image.offsets[1] + y * image.pitches[1] + x] =
+	(BYTE) (128 + ((x + frame_num) & 15));
+  TEST_CHECK_VA (t->vtable.vaUnmapBuffer (&t->ctx, image.buf));
+  TEST_CHECK_VA (t->vtable.vaDestroyImage (&t->ctx, image.image_id));
+}
+
+static UINT
+test_hash (UINT a, UINT b, UINT c)
+{
+  UINT h = a * 0x9e3779b1u ^ b * 0x85ebca6bu ^ c * 0xc2b2ae35u;
+
+  h ^= h >> 15;
+  h *= 0x2c1b3c6du;
+  h ^= h >> 12;
+  return h;
+}
+
+VOID
+test_va_fill_scene (TEST_VA * t, VASurfaceID surface, INT width, INT height,
+		    UINT scene, UINT frame_num, INT motion, INT brightness)
+{
+  /* scenes differ in block size, contrast and mean */
+  UINT block_shift = 3 + scene % 3;
+  INT contrast = 48 + (INT) (test_hash (scene, 1, 2) % 64);
+  INT mean = 64 + (INT) (test_hash (scene, 3, 4) % 128);
+  VAImage image;
+  BYTE *map;
+  INT x, y;
+
+  TEST_CHECK_VA (t->vtable.vaDeriveImage (&t->ctx, surface, &image));
+  TEST_CHECK_VA (t->vtable.vaMapBuffer (&t->ctx, image.buf, (VOID **) & map));
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+	UINT u = x + frame_num * motion + 4096;
+	INT v = mean + brightness +
+	  (INT) (test_hash (scene, u >> block_shift, y >> block_shift) %
+		 (2 * contrast + 1)) - contrast +
+	  (INT) (test_hash (scene, u, y) & 7) - 4;
+
+	map[image.offsets[0] + y * image.pitches[0] + x] =
+	  (BYTE) MIN (MAX (v, 0), 255);
+      }
+  for (y = 0; y < height / 2; y++)
+    memset (map + image.offsets[1] + y * image.pitches[1], 128, width);
+  TEST_CHECK_VA (t->vtable.vaUnmapBuffer (&t->ctx, image.buf));
+  TEST_CHECK_VA (t->vtable.vaDestroyImage (&t->ctx, image.image_id));
+}
+
+VOID
+test_va_fill_shapes (TEST_VA * t, VASurfaceID surface, INT width,
+		     INT height, UINT scene, UINT frame_num, INT motion,
+		     INT brightness)
+{
+  /* scenes differ in the layout and contrast of their large shapes */
+  DOUBLE fx = 2 * M_PI * (1 + test_hash (scene, 1, 0) % 3) / width;
+  DOUBLE fy = 2 * M_PI * (1 + test_hash (scene, 2, 0) % 3) / height;
+  DOUBLE phase = 2 * M_PI * (test_hash (scene, 3, 0) % 64) / 64;
+  DOUBLE amplitude = 24 + test_hash (scene, 4, 0) % 32;
+  INT mean = 72 + (INT) (test_hash (scene, 5, 0) % 112);
+  UINT block_shift = 2 + scene % 2;
+  VAImage image;
+  BYTE *map;
+  INT x, y;
+
+  TEST_CHECK_VA (t->vtable.vaDeriveImage (&t->ctx, surface, &image));
+  TEST_CHECK_VA (t->vtable.vaMapBuffer (&t->ctx, image.buf, (VOID **) & map));
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+	UINT u = x + frame_num * motion + 4096;
+	DOUBLE shape = amplitude * sin (fx * u + phase) +
+	  amplitude / 2 * sin (fx * 3 * u - fy * 2 * y) +
+	  amplitude * cos (fy * y + phase);
+	INT v = mean + brightness + (INT) shape +
+	  (INT) (test_hash (scene, u >> block_shift, y >> block_shift) % 33) -
+	  16 + (INT) (test_hash (scene, u, y) & 7) - 4;
+
+	map[image.offsets[0] + y * image.pitches[0] + x] =
+	  (BYTE) MIN (MAX (v, 0), 255);
+      }
+  for (y = 0; y < height / 2; y++)
+    memset (map + image.offsets[1] + y * image.pitches[1], 128, width);
+  TEST_CHECK_VA (t->vtable.vaUnmapBuffer (&t->ctx, image.buf));
+  TEST_CHECK_VA (t->vtable.vaDestroyImage (&t->ctx, image.image_id));
+}
+
+VAStatus
+test_vp8_encoder_open (TEST_VA * t, TEST_VP8_ENCODER * enc, INT width,
+		       INT height, UINT encode_output)
+{
+  VAConfigAttrib attribs[3];
+  VASurfaceID surfaces[TEST_VP8_NUM_SURFACES + 1];
+  VAStatus status;
+  INT i;
+
+  memset (enc, 0, sizeof (*enc));
+  enc->width = width;
+  enc->height = height;
+  enc->next_recon = VA_INVALID_SURFACE;
+
+  attribs[0].type = VAConfigAttribRTFormat;
+  attribs[0].value = VA_RT_FORMAT_YUV420;
+  attribs[1].type = VAConfigAttribRateControl;
+  attribs[1].value = VA_RC_CQP;
+  attribs[2].type = VAConfigAttribHybridEncodeOutput;
+  attribs[2].value = encode_output;
+  status = t->vtable.vaCreateConfig (&t->ctx, VAProfileVP8Version0_3,
+				     VAEntrypointEncSlice, attribs, 3,
+				     &enc->config);
+  if (status != VA_STATUS_SUCCESS)
+    return status;
+
+  status = t->vtable.vaCreateSurfaces2 (&t->ctx, VA_RT_FORMAT_YUV420,
+					width, height, surfaces,
+					TEST_VP8_NUM_SURFACES + 1, NULL, 0);
+  if (status != VA_STATUS_SUCCESS)
+    return status;
+  enc->input = surfaces[0];
+  for (i = 0; i < TEST_VP8_NUM_SURFACES; i++)
+    enc->recon[i] = surfaces[i + 1];
+
+  status = t->vtable.vaCreateContext (&t->ctx, enc->config, width, height,
+				      VA_PROGRESSIVE, surfaces,
+				      TEST_VP8_NUM_SURFACES + 1,
+				      &enc->context);
+  if (status != VA_STATUS_SUCCESS)
+    return status;
+
+  /* the hybrid encoder takes the coded buffer as a surface holding the
+   * MB code and MV records, 1 KB per MB is plenty for both */
+  return t->vtable.vaCreateSurfaces2 (&t->ctx, VA_RT_FORMAT_YUV420,
+				      TEST_VP8_CODED_WIDTH,
+				      ALIGN (((width + 15) / 16) *
+					     ((height + 15) / 16) * 1024 /
+					     TEST_VP8_CODED_WIDTH * 2 / 3 +
+					     16, 16), &enc->coded_buf, 1,
+				      NULL, 0);
+}
+
+static VABufferID
+test_va_buffer (TEST_VA * t, VAContextID context, VABufferType type,
+		UINT size, VOID * data)
+{
+  VABufferID id;
+
+  TEST_CHECK_VA (t->vtable.vaCreateBuffer (&t->ctx, context, type, size, 1,
+					   data, &id));
+  return id;
+}
+
+VAStatus
+test_vp8_encode_frame (TEST_VA * t, TEST_VP8_ENCODER * enc, BOOL key_frame)
+{
+  VAEncSequenceParameterBufferVP8 seq;
+  VAEncPictureParameterBufferVP8 pic;
+  VAQMatrixBufferVP8 quant;
+  BYTE misc[sizeof (VAEncMiscParameterBuffer) +
+	    sizeof (VAEncMiscParameterTemporalLayerStructure)];
+  VABufferID buffers[4];
+  INT num_buffers = 3;
+  VAStatus status;
+  UINT cur = enc->frame_num % TEST_VP8_NUM_SURFACES;
+  UINT last = (enc->frame_num + TEST_VP8_NUM_SURFACES - 1) %
+    TEST_VP8_NUM_SURFACES;
+  INT i;
+
+  test_va_fill_surface (t, enc->input, enc->width, enc->height,
+			enc->frame_num);
+
+  memset (&seq, 0, sizeof (seq));
+  seq.frame_width = enc->width;
+  seq.frame_height = enc->height;
+  seq.kf_max_dist = 30;
+  seq.intra_period = 30;
+  for (i = 0; i < 4; i++)
+    seq.reference_frames[i] = enc->recon[i];
+
+  memset (&pic, 0, sizeof (pic));
+  pic.reconstructed_frame = enc->recon[cur];
+  if (enc->next_recon != VA_INVALID_SURFACE)
+    pic.reconstructed_frame = enc->next_recon;
+  enc->next_recon = VA_INVALID_SURFACE;
+  pic.ref_last_frame = key_frame ? VA_INVALID_SURFACE : enc->recon[last];
+  pic.ref_gf_frame = key_frame ? VA_INVALID_SURFACE : enc->recon[last];
+  pic.ref_arf_frame = key_frame ? VA_INVALID_SURFACE : enc->recon[last];
+  pic.coded_buf = enc->coded_buf;
+  pic.ref_flags.bits.force_kf = key_frame;
+  pic.pic_flags.bits.frame_type = key_frame ? 0 : 1;
+  pic.pic_flags.bits.show_frame = 1;
+  pic.pic_flags.bits.refresh_last = 1;
+  pic.pic_flags.bits.mb_no_coeff_skip = 1;
+  pic.loop_filter_level[0] = 10;
+
+  memset (&quant, 0, sizeof (quant));
+  for (i = 0; i < 4; i++)
+    quant.quantization_index[i] = 40;
+
+  buffers[0] = test_va_buffer (t, enc->context,
+			       VAEncSequenceParameterBufferType,
+			       sizeof (seq), &seq);
+  buffers[1] = test_va_buffer (t, enc->context,
+			       VAEncPictureParameterBufferType,
+			       sizeof (pic), &pic);
+  buffers[2] = test_va_buffer (t, enc->context, VAQMatrixBufferType,
+			       sizeof (quant), &quant);
+  if (enc->layers)
+    {
+      VAEncMiscParameterBuffer *misc_param =
+	(VAEncMiscParameterBuffer *) misc;
+
+      misc_param->type = VAEncMiscParameterTypeTemporalLayerStructure;
+      memcpy (misc_param->data, enc->layers, sizeof (*enc->layers));
+      buffers[num_buffers++] =
+	test_va_buffer (t, enc->context, VAEncMiscParameterBufferType,
+			sizeof (misc), misc);
+    }
+
+  status = t->vtable.vaBeginPicture (&t->ctx, enc->context, enc->input);
+  if (status == VA_STATUS_SUCCESS)
+    status = t->vtable.vaRenderPicture (&t->ctx, enc->context, buffers,
+					num_buffers);
+  if (status == VA_STATUS_SUCCESS)
+    status = t->vtable.vaEndPicture (&t->ctx, enc->context);
+  if (status == VA_STATUS_SUCCESS)
+    status = t->vtable.vaSyncSurface (&t->ctx, enc->input);
+
+  for (i = 0; i < num_buffers; i++)
+    t->vtable.vaDestroyBuffer (&t->ctx, buffers[i]);
+  enc->frame_num++;
+  return status;
+}
+
+VOID
+test_vp8_encoder_close (TEST_VA * t, TEST_VP8_ENCODER * enc)
+{
+  VASurfaceID surfaces[TEST_VP8_NUM_SURFACES + 1];
+  INT i;
+
+  t->vtable.vaDestroySurfaces (&t->ctx, &enc->coded_buf, 1);
+  t->vtable.vaDestroyContext (&t->ctx, enc->context);
+  surfaces[0] = enc->input;
+  for (i = 0; i < TEST_VP8_NUM_SURFACES; i++)
+    surfaces[i + 1] = enc->recon[i];
+  t->vtable.vaDestroySurfaces (&t->ctx, surfaces, TEST_VP8_NUM_SURFACES + 1);
+  t->vtable.vaDestroyConfig (&t->ctx, enc->config);
+}
+
+MEDIA_BATCH_BUFFER *
+test_va_batch (TEST_VA * t)
+{
+  return media_batchbuffer_new (&test_va_driver (t)->drv_data,
+				I915_EXEC_RENDER, 0);
+}
+
+VOID
+test_check_same_exec (const MEDIA_MOCK_EXEC * a, const MEDIA_MOCK_EXEC * b)
+{
+  UINT i;
+
+  TEST_CHECK (a->ring == b->ring);
+  TEST_CHECK (a->used == b->used);
+  for (i = 0; i < a->used / 4; i++)
+    if (a->cmds[i] != b->cmds[i])
+      {
+	fprintf (stderr, "dword %u: 0x%08x != 0x%08x\n", i, a->cmds[i],
+		 b->cmds[i]);
+	exit (1);
+      }
+  TEST_CHECK (a->num_relocs == b->num_relocs);
+  for (i = 0; i < a->num_relocs; i++)
+    {
+      TEST_CHECK (a->relocs[i].offset == b->relocs[i].offset);
+      TEST_CHECK (a->relocs[i].target_handle == b->relocs[i].target_handle);
+      TEST_CHECK (a->relocs[i].target_offset == b->relocs[i].target_offset);
+      TEST_CHECK (a->relocs[i].read_domains == b->relocs[i].read_domains);
+      TEST_CHECK (a->relocs[i].write_domain == b->relocs[i].write_domain);
+    }
+}
+
+UINT
+test_cmd_len (UINT dw)
+{
+  switch (dw >> 29)
+    {
+    case 0:
+      /* MI opcodes below 0x10 have no length field */
+      if (((dw >> 23) & 0x3f) < 0x10)
+	return 1;
+      return (dw & 0x3f) + 2;
+    case 3:
+      /* PIPELINE_SELECT is a single dword */
+      if (((dw >> 27) & 3) == 1 && ((dw >> 24) & 7) == 1)
+	return 1;
+      return (dw & 0xff) + 2;
+    default:
+      return (dw & 0xff) + 2;
+    }
+}
+
+UINT
+test_cmd_op (UINT dw)
+{
+  if ((dw >> 29) == 0)
+    return dw & 0xff800000;
+  return dw & 0xffff0000;
+}
+
+unsigned long long
+test_now_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _TEST_VA_H
+#define _TEST_VA_H
+#include <stdio.h>
+#include <va/va.h>
+#include <va/va_backend.h>
+#include <va/va_drmcommon.h>
+#include "media_drv_init.h"
+#include "media_drv_driver.h"
+#include "media_drv_bufmgr.h"
+#include "media_drv_batchbuffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* automake: a test that exits with this code is reported as skipped */
+#define TEST_SKIP	77
+
+#define TEST_CHECK(cond) do {						\
+        if (!(cond)) {							\
+            fprintf (stderr, "%s:%d: check failed: %s\n",		\
+                     __FILE__, __LINE__, #cond);			\
+            exit (1);							\
+        }								\
+    } while (0)
+
+#define TEST_CHECK_VA(call) do {					\
+        VAStatus test_va_status = (call);				\
+        if (test_va_status != VA_STATUS_SUCCESS) {			\
+            fprintf (stderr, "%s:%d: %s returned 0x%x\n",		\
+                     __FILE__, __LINE__, #call, test_va_status);	\
+            exit (1);							\
+        }								\
+    } while (0)
+
+/*
+ * A driver instance running on the CPU mock buffer manager, created the
+ * way libva would load it but without a DRM device.
+ */
+typedef struct _test_va
+{
+  struct VADriverContext ctx;
+  struct VADriverVTable vtable;
+  struct VADriverVTableVPP vtable_vpp;
+  struct drm_state drm_state;
+} TEST_VA;
+
+BOOL test_va_open (TEST_VA * t);
+VOID test_va_close (TEST_VA * t);
+MEDIA_DRV_CONTEXT *test_va_driver (TEST_VA * t);
+dri_bufmgr *test_va_bufmgr (TEST_VA * t);
+
+/* Fills the surface with a moving gradient, distinct for each frame_num. */
+VOID test_va_fill_surface (TEST_VA * t, VASurfaceID surface, INT width,
+			   INT height, UINT frame_num);
+
+/*
+ * Synthetic clips for the host side encoder analysis: a block texture of
+ * its own for every scene, panned by motion pixels a frame, with
+ * brightness added to every luma sample for fades and flashes.
+ */
+VOID test_va_fill_scene (TEST_VA * t, VASurfaceID surface, INT width,
+			 INT height, UINT scene, UINT frame_num, INT motion,
+			 INT brightness);
+
+/*
+ * The same clips made of large smooth shapes with finer block detail on
+ * top, which motion search can follow across a pan the way it follows
+ * real footage; used by the scene cut tests.
+ */
+VOID test_va_fill_shapes (TEST_VA * t, VASurfaceID surface, INT width,
+			  INT height, UINT scene, UINT frame_num, INT motion,
+			  INT brightness);
+
+/* VP8 encode session in CQP mode, reconstructing into a small ring */
+#define TEST_VP8_NUM_SURFACES	4
+#define TEST_VP8_CODED_WIDTH	1024
+
+typedef struct _test_vp8_encoder
+{
+  INT width;
+  INT height;
+  VAConfigID config;
+  VAContextID context;
+  VASurfaceID input;
+  VASurfaceID recon[TEST_VP8_NUM_SURFACES];
+  VASurfaceID coded_buf;
+  UINT frame_num;
+  /* sent with every frame when set */
+  const VAEncMiscParameterTemporalLayerStructure *layers;
+  /* the next frame reconstructs into it when valid, else round robin */
+  VASurfaceID next_recon;
+} TEST_VP8_ENCODER;
+
+VAStatus test_vp8_encoder_open (TEST_VA * t, TEST_VP8_ENCODER * enc,
+				INT width, INT height, UINT encode_output);
+VAStatus test_vp8_encode_frame (TEST_VA * t, TEST_VP8_ENCODER * enc,
+				BOOL key_frame);
+VOID test_vp8_encoder_close (TEST_VA * t, TEST_VP8_ENCODER * enc);
+
+/*
+ * Command stream decoding for the batches the mock records: the length in
+ * dwords of the command starting with dw, and its opcode bits to compare
+ * against the CMD_* values of media_drv_hwcmds.h.
+ */
+UINT test_cmd_len (UINT dw);
+UINT test_cmd_op (UINT dw);
+
+/* A render batch on the driver's buffer manager. */
+MEDIA_BATCH_BUFFER *test_va_batch (TEST_VA * t);
+
+/* Fails unless the two recorded execs hold the same dwords and relocs. */
+VOID test_check_same_exec (const MEDIA_MOCK_EXEC * a,
+			   const MEDIA_MOCK_EXEC * b);
+
+/*
+ * VP9 frame headers for the decoder tests, see test_vp9_bits.c. Inter
+ * frames take their size from active reference size_from_ref, or code it
+ * when that is -1; interp_filter 4 is switchable.
+ */
+typedef struct _test_vp9_frame
+{
+  UINT profile;
+  BOOL show_existing_frame;
+  UINT frame_to_show;
+  BOOL key_frame;
+  BOOL show_frame;
+  BOOL error_resilient;
+  BOOL intra_only;
+  UINT bit_depth;
+  UINT color_space;
+  UINT width;
+  UINT height;
+  BOOL render_size;
+  UINT refresh_frame_flags;
+  UINT ref_frame_idx[3];
+  INT size_from_ref;
+  UINT interp_filter;
+  UINT frame_context_idx;
+  UINT filter_level;
+  UINT sharpness;
+  BOOL lf_deltas;
+  UINT base_q_idx;
+  INT delta_q_y_dc;
+  INT delta_q_uv_dc;
+  INT delta_q_uv_ac;
+  BOOL segmentation;
+  UINT log2_tile_cols;
+  UINT log2_tile_rows;
+  UINT tx_mode;
+  UINT tile_bytes;		/* filler after the compressed header */
+} TEST_VP9_FRAME;
+
+/* Returns the frame size in bytes. */
+UINT test_vp9_write_frame (const TEST_VP9_FRAME * f, BYTE * buf, UINT size);
+VOID test_vp9_tile_cols_range (UINT width, UINT * min_log2,
+			       UINT * max_log2);
+
+/*
+ * The frame header followed by about tile_bytes of pseudo random tile
+ * data, split evenly over the tiles with the size marker of every tile but
+ * the last, ready for HostVLD. Returns the frame size in bytes.
+ */
+UINT test_vp9_write_tiled_frame (const TEST_VP9_FRAME * f, UINT tile_bytes,
+				 UINT seed, BYTE * buf, UINT size);
+
+/* Time in nanoseconds for the micro-benchmarks. */
+unsigned long long test_now_ns (void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,155 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * The VP8 encoder clears only the parts of the coded buffer no kernel
+ * rewrites: the segment and frame headers, and the MVs of I frames. Each
+ * output mode encodes the same frames twice. The reference session
+ * clears the whole buffer before every frame, as the driver used to. The
+ * other session leaves stale bytes in the regions the driver clears, and
+ * zeroes the MB code and the MVs of P frames in place of the kernels,
+ * which do not run on the mock. Every frame must read back the same bytes
+ * from both: segment status, size and the packed frame.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_va.h"
+#include "media_drv_encoder.h"
+
+#define NUM_FRAMES	6
+#define STALE		0xa5
+
+static const BOOL key_frames[NUM_FRAMES] = { TRUE, FALSE, FALSE, TRUE,
+  FALSE, FALSE
+};
+
+static VOID
+fill (dri_bo * bo, UINT offset, UINT size, BYTE value)
+{
+  TEST_CHECK (media_bo_map (bo, 1) == 0);
+  if (offset < bo->size)
+    memset ((BYTE *) bo->virtual + offset, value,
+	    MIN (size, bo->size - offset));
+  media_bo_unmap (bo);
+}
+
+/* Returns a copy of the coded buffer of every frame. */
+static BYTE *
+run_session (TEST_VA * t, UINT encode_output, BOOL full_clear,
+	     UINT * bo_size)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = test_va_driver (t);
+  MEDIA_ENCODER_CTX *encoder_context;
+  struct coded_buffer_segment *segment;
+  TEST_VP8_ENCODER enc;
+  BYTE *frames;
+  UINT header_size, n;
+  dri_bo *bo;
+
+  TEST_CHECK_VA (test_vp8_encoder_open (t, &enc, 176, 144, encode_output));
+  encoder_context =
+    (MEDIA_ENCODER_CTX *) CONTEXT (enc.context)->hw_context;
+  header_size = MAX (encoder_context->mb_data_offset,
+		     I965_CODEDBUFFER_HEADER_SIZE);
+  bo = SURFACE (enc.coded_buf)->bo;
+  TEST_CHECK (bo != NULL);
+  *bo_size = bo->size;
+  frames = malloc (NUM_FRAMES * bo->size);
+  TEST_CHECK (frames != NULL);
+
+  fill (bo, 0, bo->size, 0);
+  for (n = 0; n < NUM_FRAMES; n++)
+    {
+      if (full_clear)
+	fill (bo, 0, bo->size, 0);
+      else
+	{
+	  /* on hardware, MBPAK writes every MB code record */
+	  fill (bo, header_size, encoder_context->mv_offset - header_size, 0);
+	  /* stale bytes where the driver clears */
+	  fill (bo, 0, header_size, STALE);
+	  /* on hardware, MBEnc writes the MVs of P frames */
+	  fill (bo, encoder_context->mv_offset, encoder_context->mv_in_bytes,
+		key_frames[n] ? STALE : 0);
+	}
+
+      TEST_CHECK_VA (test_vp8_encode_frame (t, &enc, key_frames[n]));
+      TEST_CHECK_VA (t->vtable.vaSyncSurface (&t->ctx, enc.coded_buf));
+
+      TEST_CHECK (media_bo_map (bo, 0) == 0);
+      memcpy (frames + n * bo->size, bo->virtual, bo->size);
+      segment = (struct coded_buffer_segment *) bo->virtual;
+      if (encode_output == VA_HYBRID_ENCODE_OUTPUT_BITSTREAM)
+	{
+	  TEST_CHECK (segment->base.status == 0);
+	  TEST_CHECK (segment->base.size > 0);
+	}
+      media_bo_unmap (bo);
+    }
+
+  test_vp8_encoder_close (t, &enc);
+  return frames;
+}
+
+static VOID
+test_output (TEST_VA * t, UINT encode_output)
+{
+  BYTE *reference, *targeted;
+  UINT size, targeted_size, n;
+
+  reference = run_session (t, encode_output, TRUE, &size);
+  targeted = run_session (t, encode_output, FALSE, &targeted_size);
+  TEST_CHECK (size == targeted_size);
+  for (n = 0; n < NUM_FRAMES; n++)
+    {
+      const struct coded_buffer_segment *a =
+	(const struct coded_buffer_segment *) (reference + n * size);
+      const struct coded_buffer_segment *b =
+	(const struct coded_buffer_segment *) (targeted + n * size);
+
+      TEST_CHECK (a->base.status == b->base.status);
+      TEST_CHECK (a->base.size == b->base.size);
+      TEST_CHECK (a->base.bit_offset == b->base.bit_offset);
+      TEST_CHECK (memcmp (reference + n * size + sizeof (*a),
+			  targeted + n * size + sizeof (*b),
+			  size - sizeof (*a)) == 0);
+    }
+  free (reference);
+  free (targeted);
+}
+
+int
+main (int argc, char **argv)
+{
+  TEST_VA t;
+
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+  test_output (&t, VA_HYBRID_ENCODE_OUTPUT_MB_DATA);
+  test_output (&t, VA_HYBRID_ENCODE_OUTPUT_BITSTREAM);
+  test_va_close (&t);
+  return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * The ring of per frame dynamic state heaps of the VP8 encoder, checked on
+ * the batches the mock records. Every kernel context holds one heap per
+ * frame in flight, all with the same interface descriptors. A frame's
+ * batch must point every kernel at the heap of that frame only, so the
+ * CURBEs of the next frames never land in a heap the GPU may still read.
+ * The heaps are reused round robin, and a frame allocates no new BOs once
+ * the ring is full.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_va.h"
+#include "media_drv_encoder.h"
+
+#define NUM_FRAMES	(4 * VP8_ENCODE_FRAMES_IN_FLIGHT)
+
+/* 0 for none, else 1 + the ring entry of the context the exec points at */
+static UINT
+exec_ring_entry (const MEDIA_MOCK_EXEC * exec, const MEDIA_GPE_CTX * gpe_ctx)
+{
+  const DYNAMIC_STATE *dynamic_state = &gpe_ctx->dynamic_state;
+  UINT entry = 0, i, j;
+
+  for (i = 0; i < exec->num_relocs; i++)
+    for (j = 0; j < dynamic_state->ring_size; j++)
+      {
+	if (exec->relocs[i].target_handle !=
+	    (uint32_t) dynamic_state->ring[j].bo->handle)
+	  continue;
+	/* no other frame's heap */
+	TEST_CHECK (entry == 0 || entry == j + 1);
+	entry = j + 1;
+      }
+
+  return entry;
+}
+
+/* the descriptors are written once at init, then copied to every entry */
+static VOID
+check_descriptors (const MEDIA_GPE_CTX * gpe_ctx)
+{
+  const DYNAMIC_STATE *dynamic_state = &gpe_ctx->dynamic_state;
+  UINT size = gpe_ctx->idrt_size * gpe_ctx->num_kernels;
+  BYTE *first;
+  UINT i;
+
+  first = media_map_buffer_obj (dynamic_state->ring[0].bo);
+  TEST_CHECK (first != NULL);
+  for (i = 1; i < dynamic_state->ring_size; i++)
+    {
+      BYTE *map = media_map_buffer_obj (dynamic_state->ring[i].bo);
+
+      TEST_CHECK (map != NULL);
+      TEST_CHECK (dynamic_state->ring[i].bo != dynamic_state->ring[0].bo);
+      TEST_CHECK (memcmp (map + gpe_ctx->idrt_offset,
+			  first + gpe_ctx->idrt_offset, size) == 0);
+      media_unmap_buffer_obj (dynamic_state->ring[i].bo);
+    }
+  media_unmap_buffer_obj (dynamic_state->ring[0].bo);
+}
+
+int
+main (int argc, char **argv)
+{
+  MEDIA_GPE_CTX *gpe_ctx_list[VP8_ENCODE_NUM_GPE_CTX];
+  INT phase[VP8_ENCODE_NUM_GPE_CTX];
+  MEDIA_ENCODER_CTX *encoder_context;
+  MEDIA_DRV_CONTEXT *drv_ctx;
+  TEST_VP8_ENCODER enc;
+  dri_bufmgr *bufmgr;
+  UINT bos = 0, used = 0, n, c;
+  TEST_VA t;
+
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+  drv_ctx = test_va_driver (&t);
+  bufmgr = test_va_bufmgr (&t);
+  TEST_CHECK_VA (test_vp8_encoder_open (&t, &enc, 176, 144,
+					VA_HYBRID_ENCODE_OUTPUT_MB_DATA));
+  encoder_context =
+    (MEDIA_ENCODER_CTX *) CONTEXT (enc.context)->hw_context;
+
+  media_encoder_gpe_contexts (encoder_context, gpe_ctx_list);
+  for (c = 0; c < VP8_ENCODE_NUM_GPE_CTX; c++)
+    {
+      TEST_CHECK (gpe_ctx_list[c]->dynamic_state.ring_size ==
+		  VP8_ENCODE_FRAMES_IN_FLIGHT);
+      check_descriptors (gpe_ctx_list[c]);
+      phase[c] = -1;
+    }
+
+  media_bufmgr_mock_clear_execs (bufmgr);
+  for (n = 0; n < NUM_FRAMES; n++)
+    {
+      const MEDIA_MOCK_EXEC *exec;
+      UINT entry;
+
+      TEST_CHECK_VA (test_vp8_encode_frame (&t, &enc, n == 0));
+      TEST_CHECK (media_bufmgr_mock_num_execs (bufmgr) == n + 1);
+      exec = media_bufmgr_mock_get_exec (bufmgr, n);
+
+      for (c = 0; c < VP8_ENCODE_NUM_GPE_CTX; c++)
+	{
+	  entry = exec_ring_entry (exec, gpe_ctx_list[c]);
+	  if (entry == 0)
+	    continue;
+	  /* every context steps to its next heap with each frame */
+	  if (phase[c] < 0)
+	    {
+	      phase[c] = (entry - 1 + VP8_ENCODE_FRAMES_IN_FLIGHT -
+			  n % VP8_ENCODE_FRAMES_IN_FLIGHT) %
+		VP8_ENCODE_FRAMES_IN_FLIGHT;
+	      used++;
+	    }
+	  TEST_CHECK (entry - 1 ==
+		      (phase[c] + n) % VP8_ENCODE_FRAMES_IN_FLIGHT);
+	  TEST_CHECK (gpe_ctx_list[c]->dynamic_state.res.bo ==
+		      gpe_ctx_list[c]->dynamic_state.ring[entry - 1].bo);
+	}
+
+      /* once every heap was used, a frame allocates nothing */
+      if (n == VP8_ENCODE_FRAMES_IN_FLIGHT)
+	bos = media_bufmgr_mock_num_bos (bufmgr);
+      else if (n > VP8_ENCODE_FRAMES_IN_FLIGHT)
+	TEST_CHECK (media_bufmgr_mock_num_bos (bufmgr) == bos);
+    }
+  /* the CQP encode runs at least scaling, MBENC and MBPAK */
+  TEST_CHECK (used >= 3);
+
+  test_vp8_encoder_close (&t, &enc);
+  test_va_close (&t);
+  return 0;
+}
@@ -0,0 +1,329 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * The VP8 lookahead on a synthetic clip of three scenes (still, slow pan,
+ * fast pan) with a stub coded size model standing in for MBPAK: a frame
+ * comes out at MODEL_SCALE * cost / qstep(qp) bits, with MODEL_SCALE
+ * unknown to the lookahead. For every window depth, the window must slide
+ * over the surfaces the application lists, the QP hint must hit the
+ * planned size once the model is calibrated, the plan must spend the
+ * budget of the clip, give more to the harder scenes and keep the QP
+ * steady inside a scene. Both BRC update curbes must carry the plan.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_va.h"
+#include "media_drv_defines.h"
+#include "media_drv_hw_g75.h"
+#include "media_drv_hw_g7.h"
+#include "media_drv_encoder_vp8_lookahead.h"
+
+#define WIDTH		320
+#define HEIGHT		240
+#define MB_COLS		(WIDTH / 16)
+#define MB_ROWS		(HEIGHT / 16)
+#define NUM_SCENES	3
+#define SCENE_FRAMES	40
+#define NUM_FRAMES	(NUM_SCENES * SCENE_FRAMES)
+#define NUM_SURFACES	(VP8_LOOKAHEAD_MAX_DEPTH + 1)
+#define BITS_PER_FRAME	40000.0
+#define MODEL_SCALE	2000.0
+#define START_QP	60
+
+static const INT scene_motion[NUM_SCENES] = { 0, 1, 12 };
+
+typedef struct _clip_stats
+{
+  UINT target[NUM_FRAMES];
+  DOUBLE bits[NUM_FRAMES];
+} CLIP_STATS;
+
+static VOID
+fill_frame (TEST_VA * t, const VASurfaceID * surfaces, UINT n)
+{
+  UINT scene = n / SCENE_FRAMES;
+
+  test_va_fill_scene (t, surfaces[n % NUM_SURFACES], WIDTH, HEIGHT, scene,
+		      n, scene_motion[scene], 0);
+}
+
+typedef VOID (*SET_CURBE_BRC_UPDATE) (struct encode_state *,
+				      MEDIA_BRC_UPDATE_PARAMS_VP8 *);
+
+/*
+ * The plan moves the target fullness and sets the QP; unplanned, gen7
+ * starts the kernel from the base QP and gen7.5 from zero.
+ */
+static VOID
+check_curbe (SET_CURBE_BRC_UPDATE set_curbe, BOOL base_qp, BOOL key_frame,
+	     BOOL planned, UINT target_bits, UINT qp_hint)
+{
+  MEDIA_CURBE_DATA_BRC_UPDATE_G75 cmd;
+  MEDIA_BRC_UPDATE_PARAMS_VP8 params;
+  MEDIA_FRAME_UPDATE frame_update;
+  VAEncPictureParameterBufferVP8 pic;
+  VAQMatrixBufferVP8 q;
+  struct buffer_store pic_store, q_store;
+  struct encode_state encode_state;
+  DOUBLE fullness = 1000000.0;
+  INT i;
+
+  memset (&pic, 0, sizeof (pic));
+  memset (&q, 0, sizeof (q));
+  for (i = 0; i < 4; i++)
+    q.quantization_index[i] = 40 + 2 * i;
+  pic_store.buffer = (BYTE *) & pic;
+  q_store.buffer = (BYTE *) & q;
+  memset (&encode_state, 0, sizeof (encode_state));
+  encode_state.pic_param_ext = &pic_store;
+  encode_state.q_matrix = &q_store;
+
+  memset (&frame_update, 0, sizeof (frame_update));
+  memset (&params, 0, sizeof (params));
+  params.frame_width_in_mbs = MB_COLS;
+  params.frame_height_in_mbs = MB_ROWS;
+  params.pic_coding_type = key_frame ? FRAME_TYPE_I : FRAME_TYPE_P;
+  params.frame_number = 5;
+  params.brc_init_current_target_buf_full_in_bits = &fullness;
+  params.brc_init_reset_input_bits_per_frame = BITS_PER_FRAME;
+  params.brc_init_reset_buf_size_in_bits = 10000000;
+  params.frame_update = &frame_update;
+  params.lookahead_target_bits = target_bits;
+  params.qp_hint_valid = planned;
+  params.qp_hint = qp_hint;
+  params.curbe_cmd_buff = &cmd;
+  set_curbe (&encode_state, &params);
+
+  TEST_CHECK (cmd.dw0.target_size ==
+	      (UINT) (1000000.0 + target_bits - BITS_PER_FRAME));
+  TEST_CHECK (fullness == 1000000.0 + target_bits);
+  if (planned)
+    TEST_CHECK (cmd.dw19.qp == qp_hint);
+  else
+    TEST_CHECK (cmd.dw19.qp == (base_qp ? q.quantization_index[0] : 0));
+  if (key_frame && planned)
+    {
+      TEST_CHECK (cmd.dw17.key_frame_qp_seg0 == qp_hint);
+      TEST_CHECK (cmd.dw17.key_frame_qp_seg3 ==
+		  MIN (qp_hint + 6, MAX_QP_VP8_G75));
+    }
+  else
+    TEST_CHECK (cmd.dw17.key_frame_qp_seg0 == q.quantization_index[0]);
+}
+
+/* the costs kept from the previous window match a fresh analysis */
+static VOID
+check_cached_costs (TEST_VA * t, const MEDIA_VP8_LOOKAHEAD * lookahead,
+		    const VAEncMiscParameterVP8HybridLookahead * param,
+		    VASurfaceID current)
+{
+  MEDIA_VP8_LOOKAHEAD *fresh;
+  UINT i;
+
+  fresh = media_vp8_lookahead_create (MB_COLS, MB_ROWS);
+  TEST_CHECK (fresh != NULL);
+  media_vp8_lookahead_set_window (fresh, param);
+  media_vp8_lookahead_analyze (&t->ctx, fresh, current);
+  TEST_CHECK (fresh->num_frames == lookahead->num_frames);
+  for (i = 0; i < fresh->num_frames; i++)
+    TEST_CHECK (fresh->frames[i].intra_cost ==
+		lookahead->frames[i].intra_cost);
+  for (i = 1; i < fresh->num_frames; i++)
+    TEST_CHECK (fresh->frames[i].cost == lookahead->frames[i].cost);
+  media_vp8_lookahead_destroy (fresh);
+}
+
+static VOID
+run_clip (TEST_VA * t, const VASurfaceID * surfaces, UINT depth,
+	  CLIP_STATS * stats)
+{
+  VAEncMiscParameterVP8HybridLookahead param;
+  MEDIA_VP8_LOOKAHEAD *lookahead;
+  UINT prev_bytes = 0, prev_qp = 0, filled = 0;
+  UINT n, i;
+
+  lookahead = media_vp8_lookahead_create (MB_COLS, MB_ROWS);
+  TEST_CHECK (lookahead != NULL);
+
+  for (n = 0; n < NUM_FRAMES; n++)
+    {
+      const MEDIA_VP8_LOOKAHEAD_FRAME *cur;
+      BOOL key_frame = n == 0, planned;
+      UINT target_bits, qp_hint, qp;
+      DOUBLE cost;
+
+      /* the application fills a surface as it enters the window */
+      memset (&param, 0, sizeof (param));
+      param.depth = depth;
+      param.num_surfaces = MIN (depth - 1, NUM_FRAMES - 1 - n);
+      for (i = 0; i < param.num_surfaces; i++)
+	param.surfaces[i] = surfaces[(n + 1 + i) % NUM_SURFACES];
+      for (; filled <= n + param.num_surfaces; filled++)
+	fill_frame (t, surfaces, filled);
+
+      media_vp8_lookahead_set_window (lookahead, &param);
+      media_vp8_lookahead_analyze (&t->ctx, lookahead,
+				   surfaces[n % NUM_SURFACES]);
+      TEST_CHECK (lookahead->num_frames == 1 + param.num_surfaces);
+      TEST_CHECK (lookahead->frames[0].surface ==
+		  surfaces[n % NUM_SURFACES]);
+      for (i = 0; i < param.num_surfaces; i++)
+	TEST_CHECK (lookahead->frames[i + 1].surface == param.surfaces[i]);
+      if (n % 10 == 5)
+	check_cached_costs (t, lookahead, &param, surfaces[n % NUM_SURFACES]);
+
+      planned = media_vp8_lookahead_plan (lookahead, key_frame,
+					  BITS_PER_FRAME, prev_bytes,
+					  prev_qp, &target_bits, &qp_hint);
+      /* the model is calibrated on the first frame */
+      TEST_CHECK (planned == (n > 0));
+      TEST_CHECK (target_bits >= BITS_PER_FRAME / 4);
+      TEST_CHECK (target_bits <= BITS_PER_FRAME * (key_frame ? 8 : 4));
+      if (depth == 1)
+	TEST_CHECK (target_bits + 1 >= BITS_PER_FRAME
+		    && target_bits <= BITS_PER_FRAME);
+      check_curbe (media_set_curbe_vp8_brc_update, FALSE, key_frame,
+		   planned, target_bits, qp_hint);
+      check_curbe (media_set_curbe_vp8_brc_update_g7, TRUE, key_frame,
+		   planned, target_bits, qp_hint);
+
+      /* stub MBPAK */
+      qp = planned ? qp_hint : START_QP;
+      cur = &lookahead->frames[0];
+      cost = (key_frame ? cur->intra_cost : cur->cost) + MB_COLS * MB_ROWS;
+      stats->bits[n] = MODEL_SCALE * cost / quant_ac_vp8_g75[qp];
+      stats->target[n] = target_bits;
+      prev_bytes = (UINT) (stats->bits[n] / 8);
+      prev_qp = qp;
+
+      /* the next QP step would have gone over the target */
+      if (planned && qp > 0 && qp < MAX_QP_VP8 - 1)
+	{
+	  TEST_CHECK (stats->bits[n] <= target_bits * 1.01);
+	  TEST_CHECK (MODEL_SCALE * cost / quant_ac_vp8_g75[qp - 1] >
+		      target_bits * 0.99);
+	}
+    }
+
+  media_vp8_lookahead_destroy (lookahead);
+}
+
+static VOID
+check_clip (UINT depth, const CLIP_STATS * stats)
+{
+  DOUBLE total_bits = 0, scene_target[NUM_SCENES];
+  UINT n, s;
+
+  for (n = 0; n < NUM_FRAMES; n++)
+    total_bits += stats->bits[n];
+
+  for (s = 0; s < NUM_SCENES; s++)
+    {
+      scene_target[s] = 0;
+      for (n = s * SCENE_FRAMES + 1; n < (s + 1) * SCENE_FRAMES; n++)
+	scene_target[s] += stats->target[n];
+      scene_target[s] /= SCENE_FRAMES - 1;
+    }
+
+  printf ("depth %2u: %5.1f%% of the budget, kbits/frame %5.1f %5.1f %5.1f\n",
+	  depth, 100.0 * total_bits / (BITS_PER_FRAME * NUM_FRAMES),
+	  scene_target[0] / 1000, scene_target[1] / 1000,
+	  scene_target[2] / 1000);
+
+  if (depth < SCENE_FRAMES)
+    return;
+
+  /*
+   * A window the length of a scene moves bits from the still scene to the
+   * pans; it plans without feedback, so the clip lands near the budget.
+   */
+  TEST_CHECK (total_bits > 0.9 * BITS_PER_FRAME * NUM_FRAMES);
+  TEST_CHECK (total_bits < 1.1 * BITS_PER_FRAME * NUM_FRAMES);
+  TEST_CHECK (scene_target[0] < scene_target[1]);
+  TEST_CHECK (scene_target[1] < scene_target[2]);
+}
+
+static VOID
+test_set_window (VOID)
+{
+  VAEncMiscParameterVP8HybridLookahead param;
+  MEDIA_VP8_LOOKAHEAD *lookahead;
+  UINT i;
+
+  lookahead = media_vp8_lookahead_create (MB_COLS, MB_ROWS);
+  TEST_CHECK (lookahead != NULL);
+  memset (&param, 0, sizeof (param));
+  for (i = 0; i < VP8_LOOKAHEAD_MAX_DEPTH - 1; i++)
+    param.surfaces[i] = 100 + i;
+
+  param.depth = 0;
+  param.num_surfaces = 5;
+  media_vp8_lookahead_set_window (lookahead, &param);
+  TEST_CHECK (lookahead->depth == 1 && lookahead->num_upcoming == 0);
+
+  param.depth = 1000;
+  param.num_surfaces = 1000;
+  media_vp8_lookahead_set_window (lookahead, &param);
+  TEST_CHECK (lookahead->depth == VP8_LOOKAHEAD_MAX_DEPTH);
+  TEST_CHECK (lookahead->num_upcoming == VP8_LOOKAHEAD_MAX_DEPTH - 1);
+
+  param.depth = 8;
+  param.num_surfaces = 3;
+  media_vp8_lookahead_set_window (lookahead, &param);
+  TEST_CHECK (lookahead->depth == 8 && lookahead->num_upcoming == 3);
+  TEST_CHECK (lookahead->upcoming[2] == 102);
+
+  media_vp8_lookahead_destroy (lookahead);
+}
+
+int
+main (int argc, char **argv)
+{
+  static const UINT depths[] = { 1, 2, 8, SCENE_FRAMES };
+  VASurfaceID surfaces[NUM_SURFACES];
+  CLIP_STATS stats;
+  TEST_VA t;
+  UINT i;
+
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+
+  test_set_window ();
+
+  TEST_CHECK_VA (t.vtable.vaCreateSurfaces2 (&t.ctx, VA_RT_FORMAT_YUV420,
+					     WIDTH, HEIGHT, surfaces,
+					     NUM_SURFACES, NULL, 0));
+  for (i = 0; i < sizeof (depths) / sizeof (depths[0]); i++)
+    {
+      run_clip (&t, surfaces, depths[i], &stats);
+      check_clip (depths[i], &stats);
+    }
+  t.vtable.vaDestroySurfaces (&t.ctx, surfaces, NUM_SURFACES);
+
+  test_va_close (&t);
+  return 0;
+}
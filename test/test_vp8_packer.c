@@ -0,0 +1,1938 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * The CPU VP8 packer against a reference decoder written from RFC 6386:
+ * random MBPAK records are packed from a coded buffer on the mock bufmgr
+ * and the frame is parsed back, which must give every header field, mode,
+ * motion vector and quantized level of the records. Key and inter frames
+ * are covered with one to eight token partitions, some of them empty. The
+ * decoder stops at the levels, reconstruction has nothing left to check
+ * about the packing.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_va.h"
+#include "media_drv_hw_g75.h"
+#include "media_drv_encoder_vp8_packer.h"
+
+enum
+{
+  REF_DC_PRED,
+  REF_V_PRED,
+  REF_H_PRED,
+  REF_TM_PRED,
+  REF_B_PRED,
+  REF_NEARESTMV,
+  REF_NEARMV,
+  REF_ZEROMV,
+  REF_NEWMV,
+  REF_SPLITMV,
+  REF_NUM_MODES
+};
+
+enum
+{
+  REF_B_DC_PRED,
+  REF_B_TM_PRED,
+  REF_B_VE_PRED,
+  REF_B_HE_PRED,
+  REF_B_LD_PRED,
+  REF_B_RD_PRED,
+  REF_B_VR_PRED,
+  REF_B_VL_PRED,
+  REF_B_HD_PRED,
+  REF_B_HU_PRED,
+  REF_NUM_B_MODES
+};
+
+enum
+{
+  REF_LEFT4X4,
+  REF_ABOVE4X4,
+  REF_ZERO4X4,
+  REF_NEW4X4
+};
+
+enum
+{
+  REF_INTRA_FRAME,
+  REF_LAST_FRAME,
+  REF_GOLDEN_FRAME,
+  REF_ALTREF_FRAME
+};
+
+/* MV probabilities */
+#define REF_MVP_IS_SHORT	0
+#define REF_MVP_SIGN		1
+#define REF_MVP_SHORT		2
+#define REF_MVP_BITS		9
+#define REF_MVP_COUNT		19
+#define REF_MV_LONG_BITS	10
+
+static const signed char ref_ymode_tree[8] = {
+  -REF_DC_PRED, 2, 4, 6, -REF_V_PRED, -REF_H_PRED, -REF_TM_PRED, -REF_B_PRED
+};
+
+static const signed char ref_kf_ymode_tree[8] = {
+  -REF_B_PRED, 2, 4, 6, -REF_DC_PRED, -REF_V_PRED, -REF_H_PRED, -REF_TM_PRED
+};
+
+static const signed char ref_uv_mode_tree[6] = {
+  -REF_DC_PRED, 2, -REF_V_PRED, 4, -REF_H_PRED, -REF_TM_PRED
+};
+
+static const signed char ref_bmode_tree[18] = {
+  -REF_B_DC_PRED, 2,
+  -REF_B_TM_PRED, 4,
+  -REF_B_VE_PRED, 6,
+  8, 12,
+  -REF_B_HE_PRED, 10,
+  -REF_B_RD_PRED, -REF_B_VR_PRED,
+  -REF_B_LD_PRED, 14,
+  -REF_B_VL_PRED, 16,
+  -REF_B_HD_PRED, -REF_B_HU_PRED
+};
+
+static const signed char ref_mv_ref_tree[8] = {
+  -REF_ZEROMV, 2, -REF_NEARESTMV, 4, -REF_NEARMV, 6, -REF_NEWMV, -REF_SPLITMV
+};
+
+static const signed char ref_sub_mv_ref_tree[6] = {
+  -REF_LEFT4X4, 2, -REF_ABOVE4X4, 4, -REF_ZERO4X4, -REF_NEW4X4
+};
+
+/* 16x8, 8x16, 8x8 and 4x4 */
+static const signed char ref_mbsplit_tree[6] = { -3, 2, -2, 4, -0, -1 };
+
+static const signed char ref_small_mv_tree[14] = {
+  2, 8, 4, 6, -0, -1, -2, -3, 10, 12, -4, -5, -6, -7
+};
+
+static const BYTE ref_kf_ymode_prob[4] = { 145, 156, 163, 128 };
+static const BYTE ref_ymode_prob[4] = { 112, 86, 140, 37 };
+static const BYTE ref_kf_uv_mode_prob[3] = { 142, 114, 183 };
+static const BYTE ref_uv_mode_prob[3] = { 162, 101, 204 };
+static const BYTE ref_bmode_prob[REF_NUM_B_MODES - 1] = {
+  120, 90, 79, 133, 87, 85, 80, 111, 151
+};
+
+static const BYTE ref_mbsplit_prob[3] = { 110, 111, 150 };
+static const BYTE ref_mbsplit_count[4] = { 2, 2, 4, 16 };
+static const BYTE ref_mbsplits[4][16] = {
+  {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1},
+  {0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1},
+  {0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 3, 3, 2, 2, 3, 3},
+  {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15}
+};
+
+/* by above zero, left zero, left == above */
+static const BYTE ref_sub_mv_ref_prob[8][3] = {
+  {147, 136, 18},
+  {223, 1, 34},
+  {106, 145, 1},
+  {208, 1, 1},
+  {179, 121, 1},
+  {223, 1, 34},
+  {179, 121, 1},
+  {208, 1, 1}
+};
+
+static const BYTE ref_mode_contexts[6][4] = {
+  {7, 1, 1, 143},
+  {14, 18, 14, 107},
+  {135, 64, 57, 68},
+  {60, 56, 128, 65},
+  {159, 134, 128, 34},
+  {234, 188, 128, 28}
+};
+
+static const BYTE ref_default_mv_probs[2][REF_MVP_COUNT] = {
+  {162, 128, 225, 146, 172, 147, 214, 39, 156,
+   128, 129, 132, 75, 145, 178, 206, 239, 254, 254},
+  {164, 128, 204, 170, 119, 235, 140, 230, 228,
+   128, 130, 130, 74, 148, 180, 203, 236, 254, 254}
+};
+
+static const BYTE ref_mv_update_probs[2][REF_MVP_COUNT] = {
+  {237, 246, 253, 253, 254, 254, 254, 254, 254,
+   254, 254, 254, 254, 254, 250, 250, 252, 254, 254},
+  {231, 243, 245, 253, 254, 254, 254, 254, 254,
+   254, 254, 254, 254, 254, 251, 251, 254, 254, 254}
+};
+
+static const BYTE ref_zigzag[16] = {
+  0, 1, 4, 8, 5, 2, 3, 6, 9, 12, 13, 10, 7, 11, 14, 15
+};
+
+static const BYTE ref_coef_bands[16] = {
+  0, 1, 2, 3, 6, 4, 5, 6, 6, 6, 6, 6, 6, 6, 6, 7
+};
+
+/* DCT_CAT1 to DCT_CAT6, zero terminated */
+static const BYTE ref_cat_probs[6][12] = {
+  {159},
+  {165, 145},
+  {173, 148, 140},
+  {176, 155, 140, 135},
+  {180, 157, 141, 134, 130},
+  {254, 254, 243, 230, 196, 177, 153, 140, 133, 130, 129}
+};
+
+static const UINT ref_cat_base[6] = { 5, 7, 11, 19, 35, 67 };
+
+static const BYTE ref_kf_bmode_probs[REF_NUM_B_MODES][REF_NUM_B_MODES]
+  [REF_NUM_B_MODES - 1] = {
+  {
+   {231, 120, 48, 89, 115, 113, 120, 152, 112},
+   {152, 179, 64, 126, 170, 118, 46, 70, 95},
+   {175, 69, 143, 80, 85, 82, 72, 155, 103},
+   {56, 58, 10, 171, 218, 189, 17, 13, 152},
+   {144, 71, 10, 38, 171, 213, 144, 34, 26},
+   {114, 26, 17, 163, 44, 195, 21, 10, 173},
+   {121, 24, 80, 195, 26, 62, 44, 64, 85},
+   {170, 46, 55, 19, 136, 160, 33, 206, 71},
+   {63, 20, 8, 114, 114, 208, 12, 9, 226},
+   {81, 40, 11, 96, 182, 84, 29, 16, 36}
+   },
+  {
+   {134, 183, 89, 137, 98, 101, 106, 165, 148},
+   {72, 187, 100, 130, 157, 111, 32, 75, 80},
+   {66, 102, 167, 99, 74, 62, 40, 234, 128},
+   {41, 53, 9, 178, 241, 141, 26, 8, 107},
+   {104, 79, 12, 27, 217, 255, 87, 17, 7},
+   {74, 43, 26, 146, 73, 166, 49, 23, 157},
+   {65, 38, 105, 160, 51, 52, 31, 115, 128},
+   {87, 68, 71, 44, 114, 51, 15, 186, 23},
+   {47, 41, 14, 110, 182, 183, 21, 17, 194},
+   {66, 45, 25, 102, 197, 189, 23, 18, 22}
+   },
+  {
+   {88, 88, 147, 150, 42, 46, 45, 196, 205},
+   {43, 97, 183, 117, 85, 38, 35, 179, 61},
+   {39, 53, 200, 87, 26, 21, 43, 232, 171},
+   {56, 34, 51, 104, 114, 102, 29, 93, 77},
+   {107, 54, 32, 26, 51, 1, 81, 43, 31},
+   {39, 28, 85, 171, 58, 165, 90, 98, 64},
+   {34, 22, 116, 206, 23, 34, 43, 166, 73},
+   {68, 25, 106, 22, 64, 171, 36, 225, 114},
+   {34, 19, 21, 102, 132, 188, 16, 76, 124},
+   {62, 18, 78, 95, 85, 57, 50, 48, 51}
+   },
+  {
+   {193, 101, 35, 159, 215, 111, 89, 46, 111},
+   {60, 148, 31, 172, 219, 228, 21, 18, 111},
+   {112, 113, 77, 85, 179, 255, 38, 120, 114},
+   {40, 42, 1, 196, 245, 209, 10, 25, 109},
+   {100, 80, 8, 43, 154, 1, 51, 26, 71},
+   {88, 43, 29, 140, 166, 213, 37, 43, 154},
+   {61, 63, 30, 155, 67, 45, 68, 1, 209},
+   {142, 78, 78, 16, 255, 128, 34, 197, 171},
+   {41, 40, 5, 102, 211, 183, 4, 1, 221},
+   {51, 50, 17, 168, 209, 192, 23, 25, 82}
+   },
+  {
+   {125, 98, 42, 88, 104, 85, 117, 175, 82},
+   {95, 84, 53, 89, 128, 100, 113, 101, 45},
+   {75, 79, 123, 47, 51, 128, 81, 171, 1},
+   {57, 17, 5, 71, 102, 57, 53, 41, 49},
+   {115, 21, 2, 10, 102, 255, 166, 23, 6},
+   {38, 33, 13, 121, 57, 73, 26, 1, 85},
+   {41, 10, 67, 138, 77, 110, 90, 47, 114},
+   {101, 29, 16, 10, 85, 128, 101, 196, 26},
+   {57, 18, 10, 102, 102, 213, 34, 20, 43},
+   {117, 20, 15, 36, 163, 128, 68, 1, 26}
+   },
+  {
+   {138, 31, 36, 171, 27, 166, 38, 44, 229},
+   {67, 87, 58, 169, 82, 115, 26, 59, 179},
+   {63, 59, 90, 180, 59, 166, 93, 73, 154},
+   {40, 40, 21, 116, 143, 209, 34, 39, 175},
+   {57, 46, 22, 24, 128, 1, 54, 17, 37},
+   {47, 15, 16, 183, 34, 223, 49, 45, 183},
+   {46, 17, 33, 183, 6, 98, 15, 32, 183},
+   {65, 32, 73, 115, 28, 128, 23, 128, 205},
+   {40, 3, 9, 115, 51, 192, 18, 6, 223},
+   {87, 37, 9, 115, 59, 77, 64, 21, 47}
+   },
+  {
+   {104, 55, 44, 218, 9, 54, 53, 130, 226},
+   {64, 90, 70, 205, 40, 41, 23, 26, 57},
+   {54, 57, 112, 184, 5, 41, 38, 166, 213},
+   {30, 34, 26, 133, 152, 116, 10, 32, 134},
+   {75, 32, 12, 51, 192, 255, 160, 43, 51},
+   {39, 19, 53, 221, 26, 114, 32, 73, 255},
+   {31, 9, 65, 234, 2, 15, 1, 118, 73},
+   {88, 31, 35, 67, 102, 85, 55, 186, 85},
+   {56, 21, 23, 111, 59, 205, 45, 37, 192},
+   {55, 38, 70, 124, 73, 102, 1, 34, 98}
+   },
+  {
+   {102, 61, 71, 37, 34, 53, 31, 243, 192},
+   {69, 60, 71, 38, 73, 119, 28, 222, 37},
+   {68, 45, 128, 34, 1, 47, 11, 245, 171},
+   {62, 17, 19, 70, 146, 85, 55, 62, 70},
+   {75, 15, 9, 9, 64, 255, 184, 119, 16},
+   {37, 43, 37, 154, 100, 163, 85, 160, 1},
+   {63, 9, 92, 136, 28, 64, 32, 201, 85},
+   {86, 6, 28, 5, 64, 255, 25, 248, 1},
+   {56, 8, 17, 132, 137, 255, 55, 116, 128},
+   {58, 15, 20, 82, 135, 57, 26, 121, 40}
+   },
+  {
+   {164, 50, 31, 137, 154, 133, 25, 35, 218},
+   {51, 103, 44, 131, 131, 123, 31, 6, 158},
+   {86, 40, 64, 135, 148, 224, 45, 183, 128},
+   {22, 26, 17, 131, 240, 154, 14, 1, 209},
+   {83, 12, 13, 54, 192, 255, 68, 47, 28},
+   {45, 16, 21, 91, 64, 222, 7, 1, 197},
+   {56, 21, 39, 155, 60, 138, 23, 102, 213},
+   {85, 26, 85, 85, 128, 128, 32, 146, 171},
+   {18, 11, 7, 63, 144, 171, 4, 4, 246},
+   {35, 27, 10, 146, 174, 171, 12, 26, 128}
+   },
+  {
+   {190, 80, 35, 99, 180, 80, 126, 54, 45},
+   {85, 126, 47, 87, 176, 51, 41, 20, 32},
+   {101, 75, 128, 139, 118, 146, 116, 128, 85},
+   {56, 41, 15, 176, 236, 85, 37, 9, 62},
+   {146, 36, 19, 30, 171, 255, 97, 27, 20},
+   {71, 30, 17, 119, 118, 255, 17, 18, 138},
+   {101, 38, 60, 138, 55, 70, 43, 26, 142},
+   {138, 45, 61, 62, 219, 1, 81, 188, 64},
+   {32, 41, 20, 117, 151, 142, 20, 21, 163},
+   {112, 19, 12, 61, 195, 128, 48, 4, 24}
+   }
+};
+
+static const BYTE ref_default_coef_probs[4][8][3][11] = {
+  {
+   {
+    {128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128},
+    {128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128},
+    {128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128}
+    },
+   {
+    {253, 136, 254, 255, 228, 219, 128, 128, 128, 128, 128},
+    {189, 129, 242, 255, 227, 213, 255, 219, 128, 128, 128},
+    {106, 126, 227, 252, 214, 209, 255, 255, 128, 128, 128}
+    },
+   {
+    {1, 98, 248, 255, 236, 226, 255, 255, 128, 128, 128},
+    {181, 133, 238, 254, 221, 234, 255, 154, 128, 128, 128},
+    {78, 134, 202, 247, 198, 180, 255, 219, 128, 128, 128}
+    },
+   {
+    {1, 185, 249, 255, 243, 255, 128, 128, 128, 128, 128},
+    {184, 150, 247, 255, 236, 224, 128, 128, 128, 128, 128},
+    {77, 110, 216, 255, 236, 230, 128, 128, 128, 128, 128}
+    },
+   {
+    {1, 101, 251, 255, 241, 255, 128, 128, 128, 128, 128},
+    {170, 139, 241, 252, 236, 209, 255, 255, 128, 128, 128},
+    {37, 116, 196, 243, 228, 255, 255, 255, 128, 128, 128}
+    },
+   {
+    {1, 204, 254, 255, 245, 255, 128, 128, 128, 128, 128},
+    {207, 160, 250, 255, 238, 128, 128, 128, 128, 128, 128},
+    {102, 103, 231, 255, 211, 171, 128, 128, 128, 128, 128}
+    },
+   {
+    {1, 152, 252, 255, 240, 255, 128, 128, 128, 128, 128},
+    {177, 135, 243, 255, 234, 225, 128, 128, 128, 128, 128},
+    {80, 129, 211, 255, 194, 224, 128, 128, 128, 128, 128}
+    },
+   {
+    {1, 1, 255, 128, 128, 128, 128, 128, 128, 128, 128},
+    {246, 1, 255, 128, 128, 128, 128, 128, 128, 128, 128},
+    {255, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128}
+    }
+   },
+  {
+   {
+    {198, 35, 237, 223, 193, 187, 162, 160, 145, 155, 62},
+    {131, 45, 198, 221, 172, 176, 220, 157, 252, 221, 1},
+    {68, 47, 146, 208, 149, 167, 221, 162, 255, 223, 128}
+    },
+   {
+    {1, 149, 241, 255, 221, 224, 255, 255, 128, 128, 128},
+    {184, 141, 234, 253, 222, 220, 255, 199, 128, 128, 128},
+    {81, 99, 181, 242, 176, 190, 249, 202, 255, 255, 128}
+    },
+   {
+    {1, 129, 232, 253, 214, 197, 242, 196, 255, 255, 128},
+    {99, 121, 210, 250, 201, 198, 255, 202, 128, 128, 128},
+    {23, 91, 163, 242, 170, 187, 247, 210, 255, 255, 128}
+    },
+   {
+    {1, 200, 246, 255, 234, 255, 128, 128, 128, 128, 128},
+    {109, 178, 241, 255, 231, 245, 255, 255, 128, 128, 128},
+    {44, 130, 201, 253, 205, 192, 255, 255, 128, 128, 128}
+    },
+   {
+    {1, 132, 239, 251, 219, 209, 255, 165, 128, 128, 128},
+    {94, 136, 225, 251, 218, 190, 255, 255, 128, 128, 128},
+    {22, 100, 174, 245, 186, 161, 255, 199, 128, 128, 128}
+    },
+   {
+    {1, 182, 249, 255, 232, 235, 128, 128, 128, 128, 128},
+    {124, 143, 241, 255, 227, 234, 128, 128, 128, 128, 128},
+    {35, 77, 181, 251, 193, 211, 255, 205, 128, 128, 128}
+    },
+   {
+    {1, 157, 247, 255, 236, 231, 255, 255, 128, 128, 128},
+    {121, 141, 235, 255, 225, 227, 255, 255, 128, 128, 128},
+    {45, 99, 188, 251, 195, 217, 255, 224, 128, 128, 128}
+    },
+   {
+    {1, 1, 251, 255, 213, 255, 128, 128, 128, 128, 128},
+    {203, 1, 248, 255, 255, 128, 128, 128, 128, 128, 128},
+    {137, 1, 177, 255, 224, 255, 128, 128, 128, 128, 128}
+    }
+   },
+  {
+   {
+    {253, 9, 248, 251, 207, 208, 255, 192, 128, 128, 128},
+    {175, 13, 224, 243, 193, 185, 249, 198, 255, 255, 128},
+    {73, 17, 171, 221, 161, 179, 236, 167, 255, 234, 128}
+    },
+   {
+    {1, 95, 247, 253, 212, 183, 255, 255, 128, 128, 128},
+    {239, 90, 244, 250, 211, 209, 255, 255, 128, 128, 128},
+    {155, 77, 195, 248, 188, 195, 255, 255, 128, 128, 128}
+    },
+   {
+    {1, 24, 239, 251, 218, 219, 255, 205, 128, 128, 128},
+    {201, 51, 219, 255, 196, 186, 128, 128, 128, 128, 128},
+    {69, 46, 190, 239, 201, 218, 255, 228, 128, 128, 128}
+    },
+   {
+    {1, 191, 251, 255, 255, 128, 128, 128, 128, 128, 128},
+    {223, 165, 249, 255, 213, 255, 128, 128, 128, 128, 128},
+    {141, 124, 248, 255, 255, 128, 128, 128, 128, 128, 128}
+    },
+   {
+    {1, 16, 248, 255, 255, 128, 128, 128, 128, 128, 128},
+    {190, 36, 230, 255, 236, 255, 128, 128, 128, 128, 128},
+    {149, 1, 255, 128, 128, 128, 128, 128, 128, 128, 128}
+    },
+   {
+    {1, 226, 255, 128, 128, 128, 128, 128, 128, 128, 128},
+    {247, 192, 255, 128, 128, 128, 128, 128, 128, 128, 128},
+    {240, 128, 255, 128, 128, 128, 128, 128, 128, 128, 128}
+    },
+   {
+    {1, 134, 252, 255, 255, 128, 128, 128, 128, 128, 128},
+    {213, 62, 250, 255, 255, 128, 128, 128, 128, 128, 128},
+    {55, 93, 255, 128, 128, 128, 128, 128, 128, 128, 128}
+    },
+   {
+    {128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128},
+    {128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128},
+    {128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128}
+    }
+   },
+  {
+   {
+    {202, 24, 213, 235, 186, 191, 220, 160, 240, 175, 255},
+    {126, 38, 182, 232, 169, 184, 228, 174, 255, 187, 128},
+    {61, 46, 138, 219, 151, 178, 240, 170, 255, 216, 128}
+    },
+   {
+    {1, 112, 230, 250, 199, 191, 247, 159, 255, 255, 128},
+    {166, 109, 228, 252, 211, 215, 255, 174, 128, 128, 128},
+    {39, 77, 162, 232, 172, 180, 245, 178, 255, 255, 128}
+    },
+   {
+    {1, 52, 220, 246, 198, 199, 249, 220, 255, 255, 128},
+    {124, 74, 191, 243, 183, 193, 250, 221, 255, 255, 128},
+    {24, 71, 130, 219, 154, 170, 243, 182, 255, 255, 128}
+    },
+   {
+    {1, 182, 225, 249, 219, 240, 255, 224, 128, 128, 128},
+    {149, 150, 226, 252, 216, 205, 255, 171, 128, 128, 128},
+    {28, 108, 170, 242, 183, 194, 254, 223, 255, 255, 128}
+    },
+   {
+    {1, 81, 230, 252, 204, 203, 255, 192, 128, 128, 128},
+    {123, 102, 209, 247, 188, 196, 255, 233, 128, 128, 128},
+    {20, 95, 153, 243, 164, 173, 255, 203, 128, 128, 128}
+    },
+   {
+    {1, 222, 248, 255, 216, 213, 128, 128, 128, 128, 128},
+    {168, 175, 246, 252, 235, 205, 255, 255, 128, 128, 128},
+    {47, 116, 215, 255, 211, 212, 255, 255, 128, 128, 128}
+    },
+   {
+    {1, 121, 236, 253, 212, 214, 255, 255, 128, 128, 128},
+    {141, 84, 213, 252, 201, 202, 255, 219, 128, 128, 128},
+    {42, 80, 160, 240, 162, 185, 255, 205, 128, 128, 128}
+    },
+   {
+    {1, 1, 255, 128, 128, 128, 128, 128, 128, 128, 128},
+    {244, 1, 255, 128, 128, 128, 128, 128, 128, 128, 128},
+    {238, 1, 255, 128, 128, 128, 128, 128, 128, 128, 128}
+    }
+   }
+};
+
+static const BYTE ref_coef_update_probs[4][8][3][11] = {
+  {
+   {
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {176, 246, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {223, 241, 252, 255, 255, 255, 255, 255, 255, 255, 255},
+    {249, 253, 253, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 244, 252, 255, 255, 255, 255, 255, 255, 255, 255},
+    {234, 254, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {253, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 246, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {239, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {254, 255, 254, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 248, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {251, 255, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {251, 254, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {254, 255, 254, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 254, 253, 255, 254, 255, 255, 255, 255, 255, 255},
+    {250, 255, 254, 255, 254, 255, 255, 255, 255, 255, 255},
+    {254, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    }
+   },
+  {
+   {
+    {217, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {225, 252, 241, 253, 255, 255, 254, 255, 255, 255, 255},
+    {234, 250, 241, 250, 253, 255, 253, 254, 255, 255, 255}
+    },
+   {
+    {255, 254, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {223, 254, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {238, 253, 254, 254, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 248, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {249, 254, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 253, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {247, 254, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {252, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 254, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {253, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 254, 253, 255, 255, 255, 255, 255, 255, 255, 255},
+    {250, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {254, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    }
+   },
+  {
+   {
+    {186, 251, 250, 255, 255, 255, 255, 255, 255, 255, 255},
+    {234, 251, 244, 254, 255, 255, 255, 255, 255, 255, 255},
+    {251, 251, 243, 253, 254, 255, 254, 255, 255, 255, 255}
+    },
+   {
+    {255, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {236, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {251, 253, 253, 254, 254, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 254, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {254, 254, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 254, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {254, 254, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {254, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {254, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    }
+   },
+  {
+   {
+    {248, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {250, 254, 252, 254, 255, 255, 255, 255, 255, 255, 255},
+    {248, 254, 249, 253, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 253, 253, 255, 255, 255, 255, 255, 255, 255, 255},
+    {246, 253, 253, 255, 255, 255, 255, 255, 255, 255, 255},
+    {252, 254, 251, 254, 254, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 254, 252, 255, 255, 255, 255, 255, 255, 255, 255},
+    {248, 254, 253, 255, 255, 255, 255, 255, 255, 255, 255},
+    {253, 255, 254, 254, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 251, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {245, 251, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {253, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 251, 253, 255, 255, 255, 255, 255, 255, 255, 255},
+    {252, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 254, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 252, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {249, 255, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 254, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 255, 253, 255, 255, 255, 255, 255, 255, 255, 255},
+    {250, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    },
+   {
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {254, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+    {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}
+    }
+   }
+};
+
+/* Bool decoder, RFC 6386 section 7.3 */
+
+typedef struct _ref_bool
+{
+  const BYTE *pos;
+  const BYTE *end;
+  UINT value;
+  UINT range;
+  INT bit_count;
+  UINT overrun;			/* bytes read past the end */
+} REF_BOOL;
+
+/*
+ * A decoder keeps two bytes ahead of the current bit and reads zeros past
+ * the end of a partition, the last symbols may pull that much from beyond
+ * the flushed bytes.
+ */
+#define REF_MAX_OVERRUN		2
+
+static UINT
+ref_bool_byte (REF_BOOL * br)
+{
+  if (br->pos < br->end)
+    return *br->pos++;
+  br->overrun++;
+  return 0;
+}
+
+static VOID
+ref_bool_init (REF_BOOL * br, const BYTE * data, UINT size)
+{
+  br->pos = data;
+  br->end = data + size;
+  br->overrun = 0;
+  br->value = ref_bool_byte (br) << 8;
+  br->value |= ref_bool_byte (br);
+  br->range = 255;
+  br->bit_count = 0;
+}
+
+static INT
+ref_bool_read (REF_BOOL * br, INT prob)
+{
+  UINT split = 1 + (((br->range - 1) * prob) >> 8);
+  UINT big_split = split << 8;
+  INT bit;
+
+  if (br->value >= big_split)
+    {
+      bit = 1;
+      br->range -= split;
+      br->value -= big_split;
+    }
+  else
+    {
+      bit = 0;
+      br->range = split;
+    }
+
+  while (br->range < 128)
+    {
+      br->value <<= 1;
+      br->range <<= 1;
+      if (++br->bit_count == 8)
+	{
+	  br->bit_count = 0;
+	  br->value |= ref_bool_byte (br);
+	}
+    }
+  return bit;
+}
+
+static UINT
+ref_bool_literal (REF_BOOL * br, INT bits)
+{
+  UINT v = 0;
+
+  while (bits--)
+    v = (v << 1) | ref_bool_read (br, 128);
+  return v;
+}
+
+/* optional magnitude and sign, the header deltas */
+static INT
+ref_bool_signed (REF_BOOL * br, INT bits)
+{
+  INT v;
+
+  if (!ref_bool_literal (br, 1))
+    return 0;
+  v = ref_bool_literal (br, bits);
+  return ref_bool_literal (br, 1) ? -v : v;
+}
+
+static INT
+ref_bool_tree (REF_BOOL * br, const signed char *tree, const BYTE * probs)
+{
+  INT i = 0;
+
+  while ((i = tree[i + ref_bool_read (br, probs[i >> 1])]) > 0)
+    ;
+  return -i;
+}
+
+/* Decoder state */
+
+typedef struct _ref_mv
+{
+  INT row;
+  INT col;
+} REF_MV;
+
+typedef struct _ref_mb
+{
+  INT y_mode;
+  INT uv_mode;
+  INT ref_frame;
+  INT segment_id;
+  INT skip;
+  INT split_type;
+  INT b_modes[16];
+  REF_MV mv;			/* quarter pel, of block 15 for SPLITMV */
+  REF_MV mvs[16];
+  INT16 coeffs[25][16];
+} REF_MB;
+
+typedef struct _ref_header
+{
+  BOOL key_frame;
+  UINT version;
+  BOOL show_frame;
+  UINT width;
+  UINT height;
+  UINT color_space;
+  UINT clamping_type;
+  BOOL segmentation_enabled;
+  BOOL update_mb_segmentation_map;
+  BOOL update_segment_feature_data;
+  BOOL segment_abs_delta;
+  INT segment_quant[4];
+  INT segment_lf[4];
+  BYTE segment_probs[3];
+  UINT filter_type;
+  UINT filter_level;
+  UINT sharpness;
+  BOOL lf_adj_enable;
+  INT ref_lf_delta[4];
+  INT mode_lf_delta[4];
+  UINT num_partitions;
+  UINT q_index;
+  INT q_delta[5];		/* y1 dc, y2 dc, y2 ac, uv dc, uv ac */
+  BOOL refresh_entropy_probs;
+  BOOL refresh_golden;
+  BOOL refresh_alternate;
+  UINT copy_to_golden;
+  UINT copy_to_alternate;
+  BOOL sign_bias[4];
+  BOOL refresh_last;
+  BOOL mb_no_coeff_skip;
+  BYTE prob_skip_false;
+  BYTE prob_intra;
+  BYTE prob_last;
+  BYTE prob_gf;
+} REF_HEADER;
+
+typedef struct _ref_probs
+{
+  BYTE coef[4][8][3][11];
+  BYTE ymode[4];
+  BYTE uv_mode[3];
+  BYTE mv[2][REF_MVP_COUNT];
+} REF_PROBS;
+
+typedef struct _ref_decoder
+{
+  UINT mb_cols;
+  UINT mb_rows;
+  UINT mb_stride;
+  REF_MB *mb_info;		/* with a zeroed border row and column */
+  REF_MB *mbs;
+  BYTE *above_ctx;
+  REF_HEADER hdr;
+  REF_PROBS probs;
+  UINT mode_count[REF_NUM_MODES];
+  UINT sub_mv_count[4];
+} REF_DECODER;
+
+#define REF_MB_AT(dec, row, col) \
+  ((dec)->mbs + (row) * (dec)->mb_stride + (col))
+
+static VOID
+ref_decoder_init (REF_DECODER * dec, UINT mb_cols, UINT mb_rows)
+{
+  memset (dec, 0, sizeof (*dec));
+  dec->mb_cols = mb_cols;
+  dec->mb_rows = mb_rows;
+  dec->mb_stride = mb_cols + 1;
+  dec->mb_info = (REF_MB *) calloc ((mb_rows + 1) * dec->mb_stride + 1,
+				    sizeof (REF_MB));
+  dec->above_ctx = (BYTE *) malloc (mb_cols * 9);
+  TEST_CHECK (dec->mb_info != NULL && dec->above_ctx != NULL);
+  dec->mbs = dec->mb_info + dec->mb_stride + 1;
+}
+
+static VOID
+ref_decoder_fini (REF_DECODER * dec)
+{
+  free (dec->mb_info);
+  free (dec->above_ctx);
+}
+
+/* Frame header, RFC 6386 section 9 */
+
+static VOID
+ref_decode_header (REF_DECODER * dec, REF_BOOL * br)
+{
+  REF_HEADER *hdr = &dec->hdr;
+  REF_PROBS *probs = &dec->probs;
+  INT i, j, k, l;
+
+  if (hdr->key_frame)
+    {
+      hdr->color_space = ref_bool_literal (br, 1);
+      hdr->clamping_type = ref_bool_literal (br, 1);
+    }
+
+  hdr->segmentation_enabled = ref_bool_literal (br, 1);
+  hdr->update_mb_segmentation_map = FALSE;
+  hdr->update_segment_feature_data = FALSE;
+  if (hdr->segmentation_enabled)
+    {
+      hdr->update_mb_segmentation_map = ref_bool_literal (br, 1);
+      hdr->update_segment_feature_data = ref_bool_literal (br, 1);
+      if (hdr->update_segment_feature_data)
+	{
+	  hdr->segment_abs_delta = ref_bool_literal (br, 1);
+	  for (i = 0; i < 4; i++)
+	    hdr->segment_quant[i] = ref_bool_signed (br, 7);
+	  for (i = 0; i < 4; i++)
+	    hdr->segment_lf[i] = ref_bool_signed (br, 6);
+	}
+      if (hdr->update_mb_segmentation_map)
+	{
+	  for (i = 0; i < 3; i++)
+	    hdr->segment_probs[i] = ref_bool_literal (br, 1) ?
+	      ref_bool_literal (br, 8) : 255;
+	}
+    }
+
+  hdr->filter_type = ref_bool_literal (br, 1);
+  hdr->filter_level = ref_bool_literal (br, 6);
+  hdr->sharpness = ref_bool_literal (br, 3);
+  hdr->lf_adj_enable = ref_bool_literal (br, 1);
+  if (hdr->lf_adj_enable && ref_bool_literal (br, 1))
+    {
+      for (i = 0; i < 4; i++)
+	hdr->ref_lf_delta[i] = ref_bool_signed (br, 6);
+      for (i = 0; i < 4; i++)
+	hdr->mode_lf_delta[i] = ref_bool_signed (br, 6);
+    }
+
+  hdr->num_partitions = 1 << ref_bool_literal (br, 2);
+
+  hdr->q_index = ref_bool_literal (br, 7);
+  for (i = 0; i < 5; i++)
+    hdr->q_delta[i] = ref_bool_signed (br, 4);
+
+  if (hdr->key_frame)
+    {
+      hdr->refresh_golden = TRUE;
+      hdr->refresh_alternate = TRUE;
+      hdr->copy_to_golden = 0;
+      hdr->copy_to_alternate = 0;
+      hdr->sign_bias[REF_GOLDEN_FRAME] = FALSE;
+      hdr->sign_bias[REF_ALTREF_FRAME] = FALSE;
+      hdr->refresh_entropy_probs = ref_bool_literal (br, 1);
+      hdr->refresh_last = TRUE;
+    }
+  else
+    {
+      hdr->refresh_golden = ref_bool_literal (br, 1);
+      hdr->refresh_alternate = ref_bool_literal (br, 1);
+      hdr->copy_to_golden =
+	hdr->refresh_golden ? 0 : ref_bool_literal (br, 2);
+      hdr->copy_to_alternate =
+	hdr->refresh_alternate ? 0 : ref_bool_literal (br, 2);
+      hdr->sign_bias[REF_GOLDEN_FRAME] = ref_bool_literal (br, 1);
+      hdr->sign_bias[REF_ALTREF_FRAME] = ref_bool_literal (br, 1);
+      hdr->refresh_entropy_probs = ref_bool_literal (br, 1);
+      hdr->refresh_last = ref_bool_literal (br, 1);
+    }
+
+  for (i = 0; i < 4; i++)
+    for (j = 0; j < 8; j++)
+      for (k = 0; k < 3; k++)
+	for (l = 0; l < 11; l++)
+	  if (ref_bool_read (br, ref_coef_update_probs[i][j][k][l]))
+	    probs->coef[i][j][k][l] = ref_bool_literal (br, 8);
+
+  hdr->mb_no_coeff_skip = ref_bool_literal (br, 1);
+  hdr->prob_skip_false =
+    hdr->mb_no_coeff_skip ? ref_bool_literal (br, 8) : 0;
+
+  if (!hdr->key_frame)
+    {
+      hdr->prob_intra = ref_bool_literal (br, 8);
+      hdr->prob_last = ref_bool_literal (br, 8);
+      hdr->prob_gf = ref_bool_literal (br, 8);
+      if (ref_bool_literal (br, 1))
+	for (i = 0; i < 4; i++)
+	  probs->ymode[i] = ref_bool_literal (br, 8);
+      if (ref_bool_literal (br, 1))
+	for (i = 0; i < 3; i++)
+	  probs->uv_mode[i] = ref_bool_literal (br, 8);
+      for (i = 0; i < 2; i++)
+	for (j = 0; j < REF_MVP_COUNT; j++)
+	  if (ref_bool_read (br, ref_mv_update_probs[i][j]))
+	    {
+	      UINT x = ref_bool_literal (br, 7);
+
+	      probs->mv[i][j] = x ? x << 1 : 1;
+	    }
+    }
+}
+
+/* Modes and motion vectors, RFC 6386 sections 11, 16 and 17 */
+
+static BOOL
+ref_mv_equal (REF_MV a, REF_MV b)
+{
+  return a.row == b.row && a.col == b.col;
+}
+
+static BOOL
+ref_mv_zero (REF_MV mv)
+{
+  return !mv.row && !mv.col;
+}
+
+static REF_MV
+ref_clamp_mv (const REF_DECODER * dec, REF_MV mv, INT row, INT col)
+{
+  /* up to one MB past the frame edges, in quarter pels */
+  INT to_left = -((col * 16) << 2) - (16 << 2);
+  INT to_right = (((dec->mb_cols - 1 - col) * 16) << 2) + (16 << 2);
+  INT to_top = -((row * 16) << 2) - (16 << 2);
+  INT to_bottom = (((dec->mb_rows - 1 - row) * 16) << 2) + (16 << 2);
+
+  mv.col = mv.col < to_left ? to_left : mv.col > to_right ? to_right : mv.col;
+  mv.row = mv.row < to_top ? to_top : mv.row > to_bottom ? to_bottom : mv.row;
+  return mv;
+}
+
+static INT
+ref_read_mv_component (REF_BOOL * br, const BYTE * p)
+{
+  INT x = 0;
+  INT i;
+
+  if (ref_bool_read (br, p[REF_MVP_IS_SHORT]))
+    {
+      for (i = 0; i < 3; i++)
+	x += ref_bool_read (br, p[REF_MVP_BITS + i]) << i;
+      for (i = REF_MV_LONG_BITS - 1; i > 3; i--)
+	x += ref_bool_read (br, p[REF_MVP_BITS + i]) << i;
+      /* bit 3 is implicit below 16 */
+      if (!(x & 0xfff0) || ref_bool_read (br, p[REF_MVP_BITS + 3]))
+	x += 8;
+    }
+  else
+    x = ref_bool_tree (br, ref_small_mv_tree, p + REF_MVP_SHORT);
+
+  if (x && ref_bool_read (br, p[REF_MVP_SIGN]))
+    x = -x;
+  return x;
+}
+
+static REF_MV
+ref_read_mv (REF_DECODER * dec, REF_BOOL * br, REF_MV base)
+{
+  base.row += ref_read_mv_component (br, dec->probs.mv[0]);
+  base.col += ref_read_mv_component (br, dec->probs.mv[1]);
+  return base;
+}
+
+static VOID
+ref_find_near_mvs (const REF_DECODER * dec, const REF_MB * mb, INT row,
+		   INT col, REF_MV * best, REF_MV * nearest, REF_MV * nearby,
+		   INT cnt[4])
+{
+  const REF_MB *above = mb - dec->mb_stride;
+  const REF_MB *left = mb - 1;
+  const REF_MB *above_left = above - 1;
+  const REF_MB *neighbours[3] = { above, left, above_left };
+  static const INT weights[3] = { 2, 2, 1 };
+  REF_MV near_mvs[4];
+  INT n = 0;
+  INT i;
+
+  memset (near_mvs, 0, sizeof (near_mvs));
+  memset (cnt, 0, 4 * sizeof (INT));
+
+  for (i = 0; i < 3; i++)
+    {
+      const REF_MB *m = neighbours[i];
+      REF_MV this_mv = m->mv;
+
+      if (m->ref_frame == REF_INTRA_FRAME)
+	continue;
+      if (ref_mv_zero (this_mv))
+	{
+	  cnt[0] += weights[i];
+	  continue;
+	}
+      if (dec->hdr.sign_bias[m->ref_frame] !=
+	  dec->hdr.sign_bias[mb->ref_frame])
+	{
+	  this_mv.row = -this_mv.row;
+	  this_mv.col = -this_mv.col;
+	}
+      if (!ref_mv_equal (this_mv, near_mvs[n]))
+	near_mvs[++n] = this_mv;
+      cnt[n] += weights[i];
+    }
+
+  /* with three distinct MVs the above-left one may repeat the nearest */
+  if (cnt[3] && ref_mv_equal (near_mvs[3], near_mvs[1]))
+    cnt[1] += 1;
+
+  cnt[3] = (above->y_mode == REF_SPLITMV) * 2 +
+    (left->y_mode == REF_SPLITMV) * 2 + (above_left->y_mode == REF_SPLITMV);
+
+  if (cnt[2] > cnt[1])
+    {
+      INT tmp = cnt[1];
+      REF_MV tmp_mv = near_mvs[1];
+
+      cnt[1] = cnt[2];
+      cnt[2] = tmp;
+      near_mvs[1] = near_mvs[2];
+      near_mvs[2] = tmp_mv;
+    }
+  if (cnt[1] >= cnt[0])
+    near_mvs[0] = near_mvs[1];
+
+  *best = ref_clamp_mv (dec, near_mvs[0], row, col);
+  *nearest = ref_clamp_mv (dec, near_mvs[1], row, col);
+  *nearby = ref_clamp_mv (dec, near_mvs[2], row, col);
+}
+
+static VOID
+ref_read_split_mv (REF_DECODER * dec, REF_BOOL * br, REF_MB * mb,
+		   REF_MV best)
+{
+  const REF_MB *above = mb - dec->mb_stride;
+  const REF_MB *left = mb - 1;
+  INT part, b;
+
+  mb->split_type = ref_bool_tree (br, ref_mbsplit_tree, ref_mbsplit_prob);
+
+  for (part = 0; part < ref_mbsplit_count[mb->split_type]; part++)
+    {
+      REF_MV left_mv, above_mv, mv;
+      INT k, sub_mode;
+
+      for (k = 0; ref_mbsplits[mb->split_type][k] != part; k++)
+	;
+
+      if (k & 3)
+	left_mv = mb->mvs[k - 1];
+      else
+	left_mv = left->y_mode == REF_SPLITMV ? left->mvs[k + 3] : left->mv;
+      if (k >= 4)
+	above_mv = mb->mvs[k - 4];
+      else
+	above_mv = above->y_mode == REF_SPLITMV ?
+	  above->mvs[k + 12] : above->mv;
+
+      sub_mode = ref_bool_tree (br, ref_sub_mv_ref_tree,
+				ref_sub_mv_ref_prob[ref_mv_zero (above_mv) << 2
+						    | ref_mv_zero (left_mv) <<
+						    1 | ref_mv_equal (left_mv,
+								      above_mv)]);
+      dec->sub_mv_count[sub_mode]++;
+      switch (sub_mode)
+	{
+	case REF_LEFT4X4:
+	  mv = left_mv;
+	  break;
+	case REF_ABOVE4X4:
+	  mv = above_mv;
+	  break;
+	case REF_ZERO4X4:
+	  mv.row = mv.col = 0;
+	  break;
+	default:
+	  mv = ref_read_mv (dec, br, best);
+	  break;
+	}
+
+      /* later partitions see this one as their left or above */
+      for (b = k; b < 16; b++)
+	if (ref_mbsplits[mb->split_type][b] == part)
+	  mb->mvs[b] = mv;
+    }
+  mb->mv = mb->mvs[15];
+}
+
+static VOID
+ref_fill_b_modes (REF_MB * mb)
+{
+  static const INT implied[4] = {
+    REF_B_DC_PRED, REF_B_VE_PRED, REF_B_HE_PRED, REF_B_TM_PRED
+  };
+  INT b;
+
+  for (b = 0; b < 16; b++)
+    mb->b_modes[b] = implied[mb->y_mode];
+}
+
+static VOID
+ref_read_mb_modes (REF_DECODER * dec, REF_BOOL * br, REF_MB * mb, INT row,
+		   INT col)
+{
+  const REF_HEADER *hdr = &dec->hdr;
+  const REF_MB *above = mb - dec->mb_stride;
+  const REF_MB *left = mb - 1;
+  INT b;
+
+  if (hdr->segmentation_enabled && hdr->update_mb_segmentation_map)
+    mb->segment_id = ref_bool_read (br, hdr->segment_probs[0]) ?
+      2 + ref_bool_read (br, hdr->segment_probs[2]) :
+      ref_bool_read (br, hdr->segment_probs[1]);
+  mb->skip = hdr->mb_no_coeff_skip ?
+    ref_bool_read (br, hdr->prob_skip_false) : 0;
+  mb->split_type = 0;
+  memset (&mb->mv, 0, sizeof (mb->mv));
+  memset (mb->mvs, 0, sizeof (mb->mvs));
+
+  if (hdr->key_frame)
+    {
+      mb->ref_frame = REF_INTRA_FRAME;
+      mb->y_mode = ref_bool_tree (br, ref_kf_ymode_tree, ref_kf_ymode_prob);
+      if (mb->y_mode == REF_B_PRED)
+	{
+	  for (b = 0; b < 16; b++)
+	    {
+	      INT a = b < 4 ? above->b_modes[b + 12] : mb->b_modes[b - 4];
+	      INT l = (b & 3) ? mb->b_modes[b - 1] : left->b_modes[b + 3];
+
+	      mb->b_modes[b] = ref_bool_tree (br, ref_bmode_tree,
+					      ref_kf_bmode_probs[a][l]);
+	    }
+	}
+      else
+	ref_fill_b_modes (mb);
+      mb->uv_mode = ref_bool_tree (br, ref_uv_mode_tree, ref_kf_uv_mode_prob);
+    }
+  else if (!ref_bool_read (br, hdr->prob_intra))
+    {
+      mb->ref_frame = REF_INTRA_FRAME;
+      mb->y_mode = ref_bool_tree (br, ref_ymode_tree, dec->probs.ymode);
+      if (mb->y_mode == REF_B_PRED)
+	{
+	  for (b = 0; b < 16; b++)
+	    mb->b_modes[b] = ref_bool_tree (br, ref_bmode_tree,
+					    ref_bmode_prob);
+	}
+      else
+	ref_fill_b_modes (mb);
+      mb->uv_mode = ref_bool_tree (br, ref_uv_mode_tree, dec->probs.uv_mode);
+    }
+  else
+    {
+      REF_MV best, nearest, nearby;
+      BYTE probs[4];
+      INT cnt[4];
+
+      if (!ref_bool_read (br, hdr->prob_last))
+	mb->ref_frame = REF_LAST_FRAME;
+      else
+	mb->ref_frame = ref_bool_read (br, hdr->prob_gf) ?
+	  REF_ALTREF_FRAME : REF_GOLDEN_FRAME;
+      mb->uv_mode = REF_DC_PRED;
+
+      ref_find_near_mvs (dec, mb, row, col, &best, &nearest, &nearby, cnt);
+      for (b = 0; b < 4; b++)
+	probs[b] = ref_mode_contexts[cnt[b]][b];
+      mb->y_mode = ref_bool_tree (br, ref_mv_ref_tree, probs);
+
+      switch (mb->y_mode)
+	{
+	case REF_NEARESTMV:
+	  mb->mv = nearest;
+	  break;
+	case REF_NEARMV:
+	  mb->mv = nearby;
+	  break;
+	case REF_NEWMV:
+	  mb->mv = ref_read_mv (dec, br, best);
+	  break;
+	case REF_SPLITMV:
+	  ref_read_split_mv (dec, br, mb, best);
+	  break;
+	default:
+	  break;
+	}
+      if (mb->y_mode != REF_SPLITMV)
+	for (b = 0; b < 16; b++)
+	  mb->mvs[b] = mb->mv;
+    }
+
+  dec->mode_count[mb->y_mode]++;
+}
+
+/* Tokens, RFC 6386 section 13 */
+
+/* Returns the index after the last token, EOB included. */
+static INT
+ref_read_block (REF_BOOL * br, const BYTE (*probs)[3][11], INT ctx,
+		INT first, INT16 * coeffs)
+{
+  const BYTE *p = probs[ref_coef_bands[first]][ctx];
+  INT n = first;
+
+  while (n < 16)
+    {
+      INT v, cat;
+
+      if (!ref_bool_read (br, p[0]))
+	break;			/* EOB */
+      while (!ref_bool_read (br, p[1]))
+	{
+	  /* a zero is never followed by EOB */
+	  if (++n == 16)
+	    return 16;
+	  p = probs[ref_coef_bands[n]][0];
+	}
+
+      if (!ref_bool_read (br, p[2]))
+	v = 1;
+      else if (!ref_bool_read (br, p[3]))
+	v = !ref_bool_read (br, p[4]) ? 2 : 3 + ref_bool_read (br, p[5]);
+      else
+	{
+	  const BYTE *extra;
+
+	  if (!ref_bool_read (br, p[6]))
+	    cat = ref_bool_read (br, p[7]);
+	  else if (!ref_bool_read (br, p[8]))
+	    cat = 2 + ref_bool_read (br, p[9]);
+	  else
+	    cat = 4 + ref_bool_read (br, p[10]);
+	  v = 0;
+	  for (extra = ref_cat_probs[cat]; *extra; extra++)
+	    v = (v << 1) | ref_bool_read (br, *extra);
+	  v += ref_cat_base[cat];
+	}
+
+      coeffs[ref_zigzag[n]] = ref_bool_read (br, 128) ? -v : v;
+      if (++n < 16)
+	p = probs[ref_coef_bands[n]][v > 1 ? 2 : 1];
+    }
+  return n;
+}
+
+/* contexts: 0-3 Y, 4-5 U, 6-7 V, 8 Y2 */
+static VOID
+ref_read_mb_tokens (REF_DECODER * dec, REF_BOOL * br, REF_MB * mb,
+		    BYTE * above, BYTE * left)
+{
+  BOOL has_y2 = mb->y_mode != REF_B_PRED && mb->y_mode != REF_SPLITMV;
+  INT type = 3, first = 0;
+  INT b, n;
+
+  memset (mb->coeffs, 0, sizeof (mb->coeffs));
+  if (mb->skip)
+    {
+      memset (above, 0, 8);
+      memset (left, 0, 8);
+      if (has_y2)
+	above[8] = left[8] = 0;
+      return;
+    }
+
+  if (has_y2)
+    {
+      n = ref_read_block (br, dec->probs.coef[1], above[8] + left[8], 0,
+			  mb->coeffs[24]);
+      above[8] = left[8] = n > 0;
+      type = 0;
+      first = 1;
+    }
+
+  for (b = 0; b < 16; b++)
+    {
+      BYTE *a = above + (b & 3);
+      BYTE *l = left + (b >> 2);
+
+      n = ref_read_block (br, dec->probs.coef[type], *a + *l, first,
+			  mb->coeffs[b]);
+      *a = *l = n > first;
+    }
+
+  for (b = 16; b < 24; b++)
+    {
+      INT plane = b < 20 ? 4 : 6;
+      BYTE *a = above + plane + (b & 1);
+      BYTE *l = left + plane + ((b >> 1) & 1);
+
+      n = ref_read_block (br, dec->probs.coef[2], *a + *l, 0, mb->coeffs[b]);
+      *a = *l = n > 0;
+    }
+}
+
+/* Frame, RFC 6386 sections 9.1 and 9.5 */
+
+static BOOL
+ref_decode_frame (REF_DECODER * dec, const BYTE * data, UINT size)
+{
+  REF_HEADER *hdr = &dec->hdr;
+  REF_BOOL br, parts[8];
+  REF_PROBS saved;
+  UINT tag, first_size, pos = 3, i;
+  UINT row, col;
+
+  if (size < 3)
+    return FALSE;
+  tag = data[0] | data[1] << 8 | data[2] << 16;
+  hdr->key_frame = !(tag & 1);
+  hdr->version = (tag >> 1) & 7;
+  hdr->show_frame = (tag >> 4) & 1;
+  first_size = tag >> 5;
+
+  if (hdr->key_frame)
+    {
+      if (size < 10 || data[3] != 0x9d || data[4] != 0x01 || data[5] != 0x2a)
+	return FALSE;
+      hdr->width = (data[6] | data[7] << 8) & 0x3fff;
+      hdr->height = (data[8] | data[9] << 8) & 0x3fff;
+      if ((hdr->width + 15) / 16 != dec->mb_cols ||
+	  (hdr->height + 15) / 16 != dec->mb_rows)
+	return FALSE;
+      pos = 10;
+
+      memcpy (dec->probs.coef, ref_default_coef_probs,
+	      sizeof (dec->probs.coef));
+      memcpy (dec->probs.ymode, ref_ymode_prob, sizeof (dec->probs.ymode));
+      memcpy (dec->probs.uv_mode, ref_uv_mode_prob,
+	      sizeof (dec->probs.uv_mode));
+      memcpy (dec->probs.mv, ref_default_mv_probs, sizeof (dec->probs.mv));
+    }
+
+  if (pos + first_size > size)
+    return FALSE;
+  saved = dec->probs;
+  ref_bool_init (&br, data + pos, first_size);
+  ref_decode_header (dec, &br);
+  for (row = 0; row < dec->mb_rows; row++)
+    for (col = 0; col < dec->mb_cols; col++)
+      ref_read_mb_modes (dec, &br, REF_MB_AT (dec, row, col), row, col);
+  if (br.overrun > REF_MAX_OVERRUN)
+    return FALSE;
+  pos += first_size;
+
+  /* the partition sizes but the last one's */
+  if (pos + 3 * (hdr->num_partitions - 1) > size)
+    return FALSE;
+  {
+    const BYTE *sizes = data + pos;
+
+    pos += 3 * (hdr->num_partitions - 1);
+    for (i = 0; i < hdr->num_partitions; i++)
+      {
+	UINT part_size = i + 1 < hdr->num_partitions ?
+	  sizes[3 * i] | sizes[3 * i + 1] << 8 | sizes[3 * i + 2] << 16 :
+	  size - pos;
+
+	if (pos + part_size > size)
+	  return FALSE;
+	ref_bool_init (&parts[i], data + pos, part_size);
+	pos += part_size;
+      }
+  }
+
+  memset (dec->above_ctx, 0, dec->mb_cols * 9);
+  for (row = 0; row < dec->mb_rows; row++)
+    {
+      REF_BOOL *part = &parts[row % hdr->num_partitions];
+      BYTE left[9];
+
+      memset (left, 0, sizeof (left));
+      for (col = 0; col < dec->mb_cols; col++)
+	ref_read_mb_tokens (dec, part, REF_MB_AT (dec, row, col),
+			    dec->above_ctx + col * 9, left);
+    }
+  for (i = 0; i < hdr->num_partitions; i++)
+    if (parts[i].overrun > REF_MAX_OVERRUN)
+      return FALSE;
+
+  if (!hdr->refresh_entropy_probs)
+    dec->probs = saved;
+  return TRUE;
+}
+
+/* MBPAK records */
+
+#define CODED_OUTPUT_BYTES(num_mbs)	((num_mbs) * 1024 + 65536)
+
+static UINT
+rnd (UINT * seed)
+{
+  *seed = *seed * 1103515245 + 12345;
+  return (*seed >> 16) & 0x7fff;
+}
+
+static VOID
+make_block (UINT * seed, INT16 * coeffs, INT first)
+{
+  INT kind = rnd (seed) % 6;
+  INT eob = 1 + rnd (seed) % 16;
+  INT i;
+
+  memset (coeffs, 0, 16 * sizeof (INT16));
+  if (!kind)
+    return;
+  for (i = first; i < eob; i++)
+    {
+      INT v;
+
+      if (kind == 1)
+	v = (INT) (rnd (seed) % 3) - 1;
+      else if (kind < 5)
+	v = (INT) (rnd (seed) % 41) - 20;
+      else
+	/* every DCT_CAT up to the largest level */
+	v = 1 + (rnd (seed) * 3 + rnd (seed)) % 2048;
+      if (rnd (seed) & 1)
+	v = -v;
+      coeffs[ref_zigzag[i]] = v;
+    }
+}
+
+static UINT
+mv_record (REF_MV mv)
+{
+  return (UINT16) mv.col | (UINT) (UINT16) mv.row << 16;
+}
+
+static REF_MV
+mv_from_record (UINT rec)
+{
+  REF_MV mv;
+
+  mv.col = (INT16) (rec & 0xffff);
+  mv.row = (INT16) (rec >> 16);
+  return mv;
+}
+
+/* zero, a neighbour's MV, the previous pick or a new one */
+static REF_MV
+pick_mv (UINT * seed, const REF_MV * candidates, INT num_candidates,
+	 REF_MV prev)
+{
+  UINT kind = rnd (seed) % 8;
+  REF_MV mv;
+
+  if (kind == 0)
+    mv.row = mv.col = 0;
+  else if (kind < 4)
+    mv = candidates[rnd (seed) % num_candidates];
+  else if (kind < 6)
+    mv = prev;
+  else
+    {
+      mv.row = (INT) (rnd (seed) % 513) - 256;
+      mv.col = (INT) (rnd (seed) % 513) - 256;
+    }
+  return mv;
+}
+
+static VOID
+make_mb (UINT * seed, BOOL key_frame, UINT mb_cols, UINT index,
+	 VP8_PAK_MB_CODE * code, UINT * mv_rec)
+{
+  UINT dw0 = (rnd (seed) % 4) << 8;
+  BOOL has_y2;
+  INT b;
+
+  memset (code, 0, sizeof (*code));
+
+  if (key_frame || rnd (seed) % 6 == 0)
+    {
+      UINT luma = rnd (seed) % 5;
+
+      dw0 |= luma | (rnd (seed) % 4) << 4;
+      for (b = 0; b < 16; b++)
+	code->sub_modes[b >> 3] |= (rnd (seed) % REF_NUM_B_MODES) <<
+	  ((b & 7) * 4);
+      memset (mv_rec, 0, 16 * sizeof (UINT));
+      has_y2 = luma != REF_B_PRED;
+    }
+  else
+    {
+      /* the left, above and above-left MBs, as far as they exist */
+      REF_MV candidates[3], prev;
+      INT num_candidates = 0;
+      UINT split = rnd (seed) % 4 == 0;
+      UINT split_type = rnd (seed) % 4;
+      INT part;
+
+      if (index % mb_cols)
+	candidates[num_candidates++] = mv_from_record (mv_rec[-16 + 15]);
+      if (index >= mb_cols)
+	candidates[num_candidates++] =
+	  mv_from_record (mv_rec[-16 * (INT) mb_cols + 15]);
+      if (index % mb_cols && index >= mb_cols)
+	candidates[num_candidates++] =
+	  mv_from_record (mv_rec[-16 * ((INT) mb_cols + 1) + 15]);
+      if (!num_candidates)
+	{
+	  candidates[0].row = candidates[0].col = 0;
+	  num_candidates = 1;
+	}
+      prev = candidates[0];
+
+      dw0 |= 1 << 3 | (1 + rnd (seed) % 3) << 6 | split << 10 |
+	split_type << 12;
+      for (part = 0; part < (split ? ref_mbsplit_count[split_type] : 1);
+	   part++)
+	{
+	  prev = pick_mv (seed, candidates, num_candidates, prev);
+	  for (b = 0; b < 16; b++)
+	    if (!split || ref_mbsplits[split_type][b] == part)
+	      mv_rec[b] = mv_record (prev);
+	}
+      has_y2 = !split;
+    }
+  code->dw0 = dw0;
+
+  /* some MBs without coefficients for the skip flag */
+  if (rnd (seed) % 4 == 0)
+    return;
+  for (b = 0; b < 16; b++)
+    make_block (seed, code->coeffs[b], has_y2);
+  for (b = 16; b < 24; b++)
+    make_block (seed, code->coeffs[b], 0);
+  if (has_y2)
+    make_block (seed, code->coeffs[24], 0);
+}
+
+/* Round trip */
+
+typedef struct _pack_test
+{
+  INT width;
+  INT height;
+  BOOL key_frame;
+  UINT log2_partitions;
+  BOOL segmentation;
+  BOOL skip;
+  UINT seed;
+} PACK_TEST;
+
+static VOID
+check_header (const REF_HEADER * hdr,
+	      const VAEncSequenceParameterBufferVP8 * seq,
+	      const VAEncPictureParameterBufferVP8 * pic,
+	      const VAQMatrixBufferVP8 * q)
+{
+  static const INT delta_order[5] = {
+    QUAND_INDEX_Y1_DC_VP8, QUAND_INDEX_Y2_DC_VP8, QUAND_INDEX_Y2_AC_VP8,
+    QUAND_INDEX_UV_DC_VP8, QUAND_INDEX_UV_AC_VP8
+  };
+  INT i;
+
+  TEST_CHECK (hdr->key_frame == !pic->pic_flags.bits.frame_type);
+  TEST_CHECK (hdr->version == pic->pic_flags.bits.version);
+  TEST_CHECK (hdr->show_frame == pic->pic_flags.bits.show_frame);
+  if (hdr->key_frame)
+    {
+      TEST_CHECK (hdr->width == seq->frame_width);
+      TEST_CHECK (hdr->height == seq->frame_height);
+      TEST_CHECK (hdr->color_space == pic->pic_flags.bits.color_space);
+      TEST_CHECK (hdr->clamping_type == pic->pic_flags.bits.clamping_type);
+    }
+  else
+    {
+      TEST_CHECK (hdr->refresh_golden ==
+		  pic->pic_flags.bits.refresh_golden_frame);
+      TEST_CHECK (hdr->refresh_alternate ==
+		  pic->pic_flags.bits.refresh_alternate_frame);
+      TEST_CHECK (hdr->refresh_golden || hdr->copy_to_golden ==
+		  pic->pic_flags.bits.copy_buffer_to_golden);
+      TEST_CHECK (hdr->refresh_alternate || hdr->copy_to_alternate ==
+		  pic->pic_flags.bits.copy_buffer_to_alternate);
+      TEST_CHECK (hdr->sign_bias[REF_GOLDEN_FRAME] ==
+		  pic->pic_flags.bits.sign_bias_golden);
+      TEST_CHECK (hdr->sign_bias[REF_ALTREF_FRAME] ==
+		  pic->pic_flags.bits.sign_bias_alternate);
+      TEST_CHECK (hdr->refresh_last == pic->pic_flags.bits.refresh_last);
+    }
+  TEST_CHECK (hdr->refresh_entropy_probs ==
+	      pic->pic_flags.bits.refresh_entropy_probs);
+
+  TEST_CHECK (hdr->segmentation_enabled ==
+	      pic->pic_flags.bits.segmentation_enabled);
+  if (hdr->segmentation_enabled)
+    {
+      TEST_CHECK (hdr->update_mb_segmentation_map ==
+		  pic->pic_flags.bits.update_mb_segmentation_map);
+      TEST_CHECK (hdr->update_segment_feature_data ==
+		  pic->pic_flags.bits.update_segment_feature_data);
+      if (hdr->update_segment_feature_data)
+	{
+	  TEST_CHECK (hdr->segment_abs_delta);
+	  for (i = 0; i < 4; i++)
+	    {
+	      TEST_CHECK (hdr->segment_quant[i] == q->quantization_index[i]);
+	      TEST_CHECK (hdr->segment_lf[i] == pic->loop_filter_level[i]);
+	    }
+	}
+    }
+
+  TEST_CHECK (hdr->filter_type == pic->pic_flags.bits.loop_filter_type);
+  TEST_CHECK (hdr->filter_level == pic->loop_filter_level[0]);
+  TEST_CHECK (hdr->sharpness == pic->sharpness_level);
+  TEST_CHECK (hdr->lf_adj_enable ==
+	      pic->pic_flags.bits.loop_filter_adj_enable);
+  if (hdr->lf_adj_enable)
+    for (i = 0; i < 4; i++)
+      {
+	TEST_CHECK (hdr->ref_lf_delta[i] == pic->ref_lf_delta[i]);
+	TEST_CHECK (hdr->mode_lf_delta[i] == pic->mode_lf_delta[i]);
+      }
+
+  TEST_CHECK (hdr->num_partitions ==
+	      1U << pic->pic_flags.bits.num_token_partitions);
+  TEST_CHECK (hdr->q_index == q->quantization_index[0]);
+  for (i = 0; i < 5; i++)
+    TEST_CHECK (hdr->q_delta[i] == q->quantization_index_delta[delta_order[i]]);
+  TEST_CHECK (hdr->mb_no_coeff_skip == pic->pic_flags.bits.mb_no_coeff_skip);
+}
+
+static VOID
+check_mb (const REF_DECODER * dec, const REF_MB * mb,
+	  const VP8_PAK_MB_CODE * code, const UINT * mv_rec)
+{
+  UINT dw0 = code->dw0;
+  BOOL coded = FALSE;
+  INT b, i;
+
+  if (dec->hdr.segmentation_enabled)
+    TEST_CHECK (mb->segment_id == (INT) VP8_PAK_MB_SEGMENT_ID (dw0));
+
+  if (dec->hdr.key_frame || !VP8_PAK_MB_INTER (dw0))
+    {
+      TEST_CHECK (mb->ref_frame == REF_INTRA_FRAME);
+      TEST_CHECK (mb->y_mode == (INT) VP8_PAK_MB_LUMA_MODE (dw0));
+      TEST_CHECK (mb->uv_mode == (INT) VP8_PAK_MB_CHROMA_MODE (dw0));
+      if (mb->y_mode == REF_B_PRED)
+	for (b = 0; b < 16; b++)
+	  TEST_CHECK (mb->b_modes[b] ==
+		      (INT) ((code->sub_modes[b >> 3] >> ((b & 7) * 4)) &
+			     0xf));
+    }
+  else
+    {
+      TEST_CHECK (mb->ref_frame == (INT) VP8_PAK_MB_REF_FRAME (dw0));
+      if (VP8_PAK_MB_SPLIT (dw0))
+	{
+	  TEST_CHECK (mb->y_mode == REF_SPLITMV);
+	  TEST_CHECK (mb->split_type == (INT) VP8_PAK_MB_SPLIT_TYPE (dw0));
+	}
+      else
+	TEST_CHECK (mb->y_mode >= REF_NEARESTMV && mb->y_mode <= REF_NEWMV);
+      for (b = 0; b < 16; b++)
+	TEST_CHECK (ref_mv_equal (mb->mvs[b], mv_from_record (mv_rec[b])));
+    }
+
+  for (b = 0; b < 25; b++)
+    for (i = 0; i < 16; i++)
+      coded |= code->coeffs[b][i] != 0;
+  if (dec->hdr.mb_no_coeff_skip)
+    TEST_CHECK (mb->skip == !coded);
+  TEST_CHECK (memcmp (mb->coeffs, code->coeffs, sizeof (mb->coeffs)) == 0);
+}
+
+static VOID
+pack_and_check (TEST_VA * t, REF_DECODER * dec, MEDIA_VP8_PACKER * packer,
+		const PACK_TEST * pt)
+{
+  UINT mb_cols = (pt->width + 15) / 16;
+  UINT mb_rows = (pt->height + 15) / 16;
+  UINT num_mbs = mb_cols * mb_rows;
+  UINT code_stride = MB_CODE_SIZE_VP8 * sizeof (UINT);
+  UINT code_offset = I965_CODEDBUFFER_HEADER_SIZE +
+    CODED_OUTPUT_BYTES (num_mbs);
+  UINT mv_offset = code_offset + num_mbs * code_stride;
+  VAEncSequenceParameterBufferVP8 seq;
+  VAEncPictureParameterBufferVP8 pic;
+  VAQMatrixBufferVP8 q;
+  struct buffer_store seq_store, pic_store, q_store;
+  struct encode_state encode_state;
+  struct object_surface coded_surface;
+  struct coded_buffer_segment *segment;
+  VP8_PAK_MB_CODE *codes;
+  UINT *mv_recs;
+  UINT seed = pt->seed;
+  dri_bo *bo;
+  UINT i, row, col;
+
+  TEST_CHECK (sizeof (VP8_PAK_MB_CODE) == code_stride);
+
+  memset (&seq, 0, sizeof (seq));
+  seq.frame_width = pt->width;
+  seq.frame_height = pt->height;
+
+  memset (&pic, 0, sizeof (pic));
+  pic.pic_flags.bits.frame_type = !pt->key_frame;
+  pic.pic_flags.bits.show_frame = 1;
+  pic.pic_flags.bits.color_space = pt->seed & 1;
+  pic.pic_flags.bits.loop_filter_type = (pt->seed >> 1) & 1;
+  pic.pic_flags.bits.num_token_partitions = pt->log2_partitions;
+  pic.pic_flags.bits.segmentation_enabled = pt->segmentation;
+  pic.pic_flags.bits.update_mb_segmentation_map = pt->segmentation;
+  pic.pic_flags.bits.update_segment_feature_data = pt->key_frame;
+  pic.pic_flags.bits.loop_filter_adj_enable = 1;
+  pic.pic_flags.bits.refresh_entropy_probs = 1;
+  pic.pic_flags.bits.refresh_golden_frame = pt->key_frame;
+  pic.pic_flags.bits.copy_buffer_to_golden = 1;
+  pic.pic_flags.bits.copy_buffer_to_alternate = 2;
+  pic.pic_flags.bits.sign_bias_golden = 1;
+  pic.pic_flags.bits.refresh_last = 1;
+  pic.pic_flags.bits.mb_no_coeff_skip = pt->skip;
+  for (i = 0; i < 4; i++)
+    {
+      pic.loop_filter_level[i] = 10 + 7 * i;
+      pic.ref_lf_delta[i] = (INT) i * 3 - 4;
+      pic.mode_lf_delta[i] = 5 - (INT) i * 4;
+    }
+  pic.sharpness_level = 3;
+
+  memset (&q, 0, sizeof (q));
+  for (i = 0; i < 4; i++)
+    q.quantization_index[i] = 20 + 25 * i;
+  for (i = 0; i < 5; i++)
+    q.quantization_index_delta[i] = (INT) i * 4 - 8;
+
+  /* records as MBPAK leaves them, behind the room for the packed frame */
+  codes = (VP8_PAK_MB_CODE *) malloc (num_mbs * sizeof (*codes));
+  mv_recs = (UINT *) malloc (num_mbs * MB_MV_CODE_SIZE_VP8);
+  TEST_CHECK (codes != NULL && mv_recs != NULL);
+  for (i = 0; i < num_mbs; i++)
+    make_mb (&seed, pt->key_frame, mb_cols, i, &codes[i], mv_recs + 16 * i);
+
+  bo = media_bo_alloc (test_va_bufmgr (t), "coded buffer",
+		       mv_offset + num_mbs * MB_MV_CODE_SIZE_VP8, 4096);
+  TEST_CHECK (bo != NULL);
+  TEST_CHECK (media_bo_subdata (bo, code_offset, num_mbs * code_stride,
+				codes) == 0);
+  TEST_CHECK (media_bo_subdata (bo, mv_offset,
+				num_mbs * MB_MV_CODE_SIZE_VP8, mv_recs) == 0);
+
+  seq_store.buffer = (BYTE *) & seq;
+  pic_store.buffer = (BYTE *) & pic;
+  q_store.buffer = (BYTE *) & q;
+  memset (&encode_state, 0, sizeof (encode_state));
+  encode_state.seq_param_ext = &seq_store;
+  encode_state.pic_param_ext = &pic_store;
+  encode_state.q_matrix = &q_store;
+  memset (&coded_surface, 0, sizeof (coded_surface));
+  coded_surface.bo = bo;
+  encode_state.coded_buf_surface = &coded_surface;
+
+  TEST_CHECK_VA (media_vp8_packer_submit (packer, &encode_state,
+					  code_offset, code_stride,
+					  mv_offset, MB_MV_CODE_SIZE_VP8, 0));
+  /* the coded surface waits for the packer until the frame is read */
+  TEST_CHECK (media_vp8_packer_sync_surface (&coded_surface));
+  media_vp8_packer_wait (packer);
+  TEST_CHECK (coded_surface.private_data == NULL);
+
+  TEST_CHECK (media_bo_map (bo, 0) == 0);
+  segment = (struct coded_buffer_segment *) bo->virtual;
+  TEST_CHECK (segment->base.status == 0);
+  TEST_CHECK (segment->base.size > 0);
+  TEST_CHECK (segment->base.size <= CODED_OUTPUT_BYTES (num_mbs));
+  TEST_CHECK (ref_decode_frame (dec, (const BYTE *) bo->virtual +
+				I965_CODEDBUFFER_HEADER_SIZE,
+				segment->base.size));
+  media_bo_unmap (bo);
+
+  check_header (&dec->hdr, &seq, &pic, &q);
+  for (row = 0; row < mb_rows; row++)
+    for (col = 0; col < mb_cols; col++)
+      {
+	i = row * mb_cols + col;
+	check_mb (dec, REF_MB_AT (dec, row, col), &codes[i], mv_recs + 16 * i);
+      }
+
+  media_bo_unreference (bo);
+  free (codes);
+  free (mv_recs);
+}
+
+static const PACK_TEST pack_tests[] = {
+  /* width, height, key, log2 partitions, segmentation, skip, seed */
+  {176, 144, TRUE, 0, TRUE, TRUE, 1},
+  {176, 144, FALSE, 2, TRUE, TRUE, 2},
+  {176, 144, FALSE, 1, FALSE, FALSE, 3},
+  {176, 144, TRUE, 3, FALSE, TRUE, 4},
+  {176, 144, FALSE, 3, TRUE, TRUE, 5},
+  /* more partitions than MB rows */
+  {40, 24, TRUE, 3, TRUE, TRUE, 6},
+  {40, 24, FALSE, 2, FALSE, TRUE, 7},
+  {320, 240, TRUE, 1, TRUE, FALSE, 8},
+  {320, 240, FALSE, 0, FALSE, TRUE, 9},
+  {320, 240, FALSE, 3, TRUE, TRUE, 10},
+};
+
+int
+main (int argc, char **argv)
+{
+  UINT mode_count[REF_NUM_MODES], sub_mv_count[4];
+  TEST_VA t;
+  UINT i, j;
+
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+
+  memset (mode_count, 0, sizeof (mode_count));
+  memset (sub_mv_count, 0, sizeof (sub_mv_count));
+  for (i = 0; i < sizeof (pack_tests) / sizeof (pack_tests[0]);)
+    {
+      const PACK_TEST *first = &pack_tests[i];
+      UINT mb_cols = (first->width + 15) / 16;
+      UINT mb_rows = (first->height + 15) / 16;
+      MEDIA_VP8_PACKER *packer = media_vp8_packer_create (mb_cols, mb_rows);
+      REF_DECODER dec;
+
+      TEST_CHECK (packer != NULL);
+      ref_decoder_init (&dec, mb_cols, mb_rows);
+      /* one stream per size, starting with its key frame */
+      for (; i < sizeof (pack_tests) / sizeof (pack_tests[0]) &&
+	   pack_tests[i].width == first->width &&
+	   pack_tests[i].height == first->height; i++)
+	pack_and_check (&t, &dec, packer, &pack_tests[i]);
+
+      for (j = 0; j < REF_NUM_MODES; j++)
+	mode_count[j] += dec.mode_count[j];
+      for (j = 0; j < 4; j++)
+	sub_mv_count[j] += dec.sub_mv_count[j];
+      ref_decoder_fini (&dec);
+      media_vp8_packer_destroy (packer);
+    }
+
+  /* the records reached every mode the packer can choose */
+  for (j = 0; j < REF_NUM_MODES; j++)
+    TEST_CHECK (mode_count[j] > 0);
+  for (j = 0; j < 4; j++)
+    TEST_CHECK (sub_mv_count[j] > 0);
+
+  test_va_close (&t);
+  return 0;
+}
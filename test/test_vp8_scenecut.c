@@ -0,0 +1,158 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Precision and recall of the VP8 scene cut detector on a synthetic clip
+ * with known cuts. The scenes pan at up to one MB a frame and carry the
+ * usual false alarms: single frame flashes and fades to black. Every cut
+ * must be found on its frame and nothing else may fire; the minimum key
+ * frame distance must hold off cuts that come too soon.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_va.h"
+#include "media_drv_encoder_vp8_scenecut.h"
+
+#define WIDTH		320
+#define HEIGHT		240
+
+typedef struct _test_scene
+{
+  UINT frames;
+  INT motion;
+  UINT flash_at;		/* 0 for none */
+  UINT fade_from;		/* 0 for none, fades out to the end */
+} TEST_SCENE;
+
+static const TEST_SCENE scenes[] = {
+  {24, 0, 0, 0},
+  {16, 2, 8, 0},
+  {30, 16, 0, 0},
+  {12, 1, 0, 0},
+  {20, 8, 5, 12},
+  {18, 0, 0, 0},
+  {9, 4, 0, 0},
+  {25, 16, 14, 0},
+  {14, 0, 0, 4},
+  {22, 3, 0, 0},
+  {16, 12, 6, 0},
+  {20, 0, 0, 0},
+};
+
+#define NUM_SCENES	(sizeof (scenes) / sizeof (scenes[0]))
+
+static INT
+scene_brightness (const TEST_SCENE * scene, UINT i)
+{
+  if (scene->flash_at && i == scene->flash_at)
+    return 80;
+  if (scene->fade_from && i >= scene->fade_from)
+    return -6 * (INT) (i - scene->fade_from + 1);
+  return 0;
+}
+
+/* scores the cuts against the truth, a cut counts on its frame only */
+static VOID
+run_clip (TEST_VA * t, VASurfaceID surface, UINT min_key_dist,
+	  UINT * true_pos, UINT * false_pos, UINT * false_neg)
+{
+  MEDIA_VP8_SCENE_CUT *scene_cut;
+  UINT s, i, frame_num = 0, last_key = 0;
+
+  scene_cut = media_vp8_scene_cut_create (WIDTH / 16, HEIGHT / 16);
+  TEST_CHECK (scene_cut != NULL);
+
+  *true_pos = *false_pos = *false_neg = 0;
+  for (s = 0; s < NUM_SCENES; s++)
+    {
+      for (i = 0; i < scenes[s].frames; i++, frame_num++)
+	{
+	  BOOL key_frame = frame_num == 0, cut, truth;
+
+	  test_va_fill_shapes (t, surface, WIDTH, HEIGHT, s, frame_num,
+			       scenes[s].motion,
+			       scene_brightness (&scenes[s], i));
+	  cut = media_vp8_scene_cut_detect (&t->ctx, scene_cut, surface,
+					    key_frame, min_key_dist);
+	  TEST_CHECK (!(key_frame && cut));
+
+	  /* a cut too close to the last key frame is not one */
+	  truth = s > 0 && i == 0 && frame_num - last_key >= min_key_dist;
+	  if (cut)
+	    last_key = frame_num;
+	  if (cut && truth)
+	    (*true_pos)++;
+	  else if (cut)
+	    (*false_pos)++;
+	  else if (truth)
+	    (*false_neg)++;
+	}
+    }
+
+  media_vp8_scene_cut_destroy (scene_cut);
+}
+
+int
+main (int argc, char **argv)
+{
+  UINT true_pos, false_pos, false_neg, min_scene = ~0u;
+  VASurfaceID surface;
+  TEST_VA t;
+  UINT s;
+
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+
+  TEST_CHECK_VA (t.vtable.vaCreateSurfaces2 (&t.ctx, VA_RT_FORMAT_YUV420,
+					     WIDTH, HEIGHT, &surface, 1,
+					     NULL, 0));
+
+  run_clip (&t, surface, 0, &true_pos, &false_pos, &false_neg);
+  printf ("%u cuts: precision %.2f, recall %.2f\n",
+	  (UINT) NUM_SCENES - 1,
+	  true_pos + false_pos ?
+	  (DOUBLE) true_pos / (true_pos + false_pos) : 1.0,
+	  (DOUBLE) true_pos / (true_pos + false_neg));
+  TEST_CHECK (true_pos == NUM_SCENES - 1);
+  TEST_CHECK (false_pos == 0 && false_neg == 0);
+
+  /*
+   * Cuts closer than the key frame distance are held off, and the ones
+   * after them must still be found.
+   */
+  for (s = 1; s < NUM_SCENES; s++)
+    min_scene = MIN (min_scene, scenes[s - 1].frames);
+  run_clip (&t, surface, min_scene, &true_pos, &false_pos, &false_neg);
+  TEST_CHECK (true_pos == NUM_SCENES - 1);
+  TEST_CHECK (false_pos == 0 && false_neg == 0);
+  run_clip (&t, surface, 20, &true_pos, &false_pos, &false_neg);
+  TEST_CHECK (true_pos > 0 && true_pos < NUM_SCENES - 1);
+  TEST_CHECK (false_pos == 0 && false_neg == 0);
+
+  t.vtable.vaDestroySurfaces (&t.ctx, &surface, 1);
+  test_va_close (&t);
+  return 0;
+}
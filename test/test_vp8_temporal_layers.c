@@ -0,0 +1,367 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Reference structure of VP8 temporal layers. Every frame is checked
+ * against a model of the three reference slots: the layer the pattern
+ * gives it, the slots it predicts from and the one it refreshes, as the
+ * driver left them in the picture parameters the kernels read, in the
+ * reference surfaces and in the frame header the packer wrote. No frame
+ * may predict from a frame of a higher layer, so the upper layers can be
+ * dropped.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_va.h"
+#include "media_drv_encoder.h"
+
+#define NUM_FRAMES	20
+#define KEY_FRAME_AT	11
+
+/* Bool decoder, RFC 6386 section 7.3, for the frame header flags only */
+
+typedef struct _test_bool
+{
+  const BYTE *pos;
+  const BYTE *end;
+  UINT value;
+  UINT range;
+  INT bit_count;
+} TEST_BOOL;
+
+static UINT
+bool_byte (TEST_BOOL * br)
+{
+  return br->pos < br->end ? *br->pos++ : 0;
+}
+
+static UINT
+bool_literal (TEST_BOOL * br, INT bits)
+{
+  UINT v = 0;
+
+  while (bits--)
+    {
+      UINT split = 1 + (((br->range - 1) * 128) >> 8);
+
+      v <<= 1;
+      if (br->value >= split << 8)
+	{
+	  v |= 1;
+	  br->range -= split;
+	  br->value -= split << 8;
+	}
+      else
+	br->range = split;
+      while (br->range < 128)
+	{
+	  br->value <<= 1;
+	  br->range <<= 1;
+	  if (++br->bit_count == 8)
+	    {
+	      br->bit_count = 0;
+	      br->value |= bool_byte (br);
+	    }
+	}
+    }
+  return v;
+}
+
+/* optional magnitude and sign */
+static VOID
+bool_skip_signed (TEST_BOOL * br, INT bits)
+{
+  if (bool_literal (br, 1))
+    bool_literal (br, bits + 1);
+}
+
+typedef struct _test_frame_header
+{
+  BOOL key_frame;
+  BOOL refresh[VP8_NUM_REFS];
+  UINT copy_to_golden;
+  UINT copy_to_alternate;
+  BOOL sign_bias_golden;
+  BOOL sign_bias_alternate;
+  BOOL refresh_entropy_probs;
+} TEST_FRAME_HEADER;
+
+/* RFC 6386 section 19.2, up to refresh_last */
+static VOID
+parse_frame_header (const BYTE * data, UINT size, TEST_FRAME_HEADER * hdr)
+{
+  TEST_BOOL br;
+  UINT offset, i;
+
+  TEST_CHECK (size > 10);
+  memset (hdr, 0, sizeof (*hdr));
+  hdr->key_frame = !(data[0] & 1);
+  offset = hdr->key_frame ? 10 : 3;
+  if (hdr->key_frame)
+    TEST_CHECK (data[3] == 0x9d && data[4] == 0x01 && data[5] == 0x2a);
+
+  br.pos = data + offset;
+  br.end = data + size;
+  br.value = bool_byte (&br) << 8;
+  br.value |= bool_byte (&br);
+  br.range = 255;
+  br.bit_count = 0;
+
+  if (hdr->key_frame)
+    bool_literal (&br, 2);	/* color space, clamping */
+  if (bool_literal (&br, 1))	/* segmentation_enabled */
+    {
+      BOOL update_map = bool_literal (&br, 1);
+
+      if (bool_literal (&br, 1))	/* update_segment_feature_data */
+	{
+	  bool_literal (&br, 1);
+	  for (i = 0; i < 4; i++)
+	    bool_skip_signed (&br, 7);
+	  for (i = 0; i < 4; i++)
+	    bool_skip_signed (&br, 6);
+	}
+      if (update_map)
+	for (i = 0; i < 3; i++)
+	  if (bool_literal (&br, 1))
+	    bool_literal (&br, 8);
+    }
+  bool_literal (&br, 1 + 6 + 3);	/* filter type, level, sharpness */
+  if (bool_literal (&br, 1) && bool_literal (&br, 1))
+    for (i = 0; i < 8; i++)
+      bool_skip_signed (&br, 6);
+  bool_literal (&br, 2);	/* partitions */
+  bool_literal (&br, 7);	/* y_ac_qi */
+  for (i = 0; i < 5; i++)
+    bool_skip_signed (&br, 4);
+
+  if (hdr->key_frame)
+    {
+      hdr->refresh_entropy_probs = bool_literal (&br, 1);
+      for (i = 0; i < VP8_NUM_REFS; i++)
+	hdr->refresh[i] = TRUE;
+      return;
+    }
+  hdr->refresh[VP8_REF_GOLDEN] = bool_literal (&br, 1);
+  hdr->refresh[VP8_REF_ALTREF] = bool_literal (&br, 1);
+  if (!hdr->refresh[VP8_REF_GOLDEN])
+    hdr->copy_to_golden = bool_literal (&br, 2);
+  if (!hdr->refresh[VP8_REF_ALTREF])
+    hdr->copy_to_alternate = bool_literal (&br, 2);
+  hdr->sign_bias_golden = bool_literal (&br, 1);
+  hdr->sign_bias_alternate = bool_literal (&br, 1);
+  hdr->refresh_entropy_probs = bool_literal (&br, 1);
+  hdr->refresh[VP8_REF_LAST] = bool_literal (&br, 1);
+}
+
+/* what the reference slots hold, and the layer of the frame in each */
+typedef struct _test_slots
+{
+  VASurfaceID surface[VP8_NUM_REFS];
+  UINT layer[VP8_NUM_REFS];
+} TEST_SLOTS;
+
+/* a reconstructed surface no slot holds */
+static VASurfaceID
+free_recon (const TEST_VP8_ENCODER * enc, const TEST_SLOTS * slots)
+{
+  UINT i, j;
+
+  for (i = 0; i < TEST_VP8_NUM_SURFACES; i++)
+    {
+      for (j = 0; j < VP8_NUM_REFS; j++)
+	if (slots->surface[j] == enc->recon[i])
+	  break;
+      if (j == VP8_NUM_REFS)
+	return enc->recon[i];
+    }
+  TEST_CHECK (0);
+  return VA_INVALID_SURFACE;
+}
+
+static VOID
+check_frame (TEST_VA * t, const TEST_VP8_ENCODER * enc, BOOL key_frame,
+	     UINT layer, TEST_SLOTS * slots)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = test_va_driver (t);
+  struct object_context *obj_context = CONTEXT (enc->context);
+  MEDIA_ENCODER_CTX *encoder_context =
+    (MEDIA_ENCODER_CTX *) obj_context->hw_context;
+  struct encode_state *encode_state = &obj_context->codec_state.encode;
+  VAEncPictureParameterBufferVP8 *pic =
+    (VAEncPictureParameterBufferVP8 *) encode_state->pic_param_ext->buffer;
+  struct object_surface *ref_object[VP8_NUM_REFS];
+  VASurfaceID ref_id[VP8_NUM_REFS];
+  BOOL no_ref[VP8_NUM_REFS], refresh[VP8_NUM_REFS];
+  struct coded_buffer_segment *segment;
+  TEST_FRAME_HEADER hdr;
+  dri_bo *bo;
+  UINT ctrl = 0, i, j;
+
+  ref_id[VP8_REF_LAST] = pic->ref_last_frame;
+  ref_id[VP8_REF_GOLDEN] = pic->ref_gf_frame;
+  ref_id[VP8_REF_ALTREF] = pic->ref_arf_frame;
+  ref_object[VP8_REF_LAST] = encode_state->ref_last_frame;
+  ref_object[VP8_REF_GOLDEN] = encode_state->ref_gf_frame;
+  ref_object[VP8_REF_ALTREF] = encode_state->ref_arf_frame;
+  no_ref[VP8_REF_LAST] = pic->ref_flags.bits.no_ref_last;
+  no_ref[VP8_REF_GOLDEN] = pic->ref_flags.bits.no_ref_gf;
+  no_ref[VP8_REF_ALTREF] = pic->ref_flags.bits.no_ref_arf;
+  refresh[VP8_REF_LAST] = pic->pic_flags.bits.refresh_last;
+  refresh[VP8_REF_GOLDEN] = pic->pic_flags.bits.refresh_golden_frame;
+  refresh[VP8_REF_ALTREF] = pic->pic_flags.bits.refresh_alternate_frame;
+
+  TEST_CHECK (encoder_context->temporal_layers != NULL);
+  TEST_CHECK (encoder_context->temporal_refs.layer == layer);
+  TEST_CHECK ((encoder_context->pic_coding_type == FRAME_TYPE_I) ==
+	      key_frame);
+
+  /* the slots up to the layer's own, each surface once */
+  for (i = 0; i < VP8_NUM_REFS && !key_frame; i++)
+    {
+      BOOL ref = i <= layer && slots->surface[i] != VA_INVALID_SURFACE;
+
+      for (j = 0; j < i; j++)
+	if (ref && slots->surface[j] == slots->surface[i] && (ctrl & 1 << j))
+	  ref = FALSE;
+      if (!ref)
+	continue;
+      ctrl |= 1 << i;
+      TEST_CHECK (slots->layer[i] <= layer);
+      TEST_CHECK (slots->surface[i] != pic->reconstructed_frame);
+    }
+  TEST_CHECK (encoder_context->ref_frame_ctrl == ctrl);
+  for (i = 0; i < VP8_NUM_REFS; i++)
+    {
+      TEST_CHECK (no_ref[i] == !(ctrl & 1 << i));
+      if (ctrl & 1 << i)
+	{
+	  TEST_CHECK (ref_id[i] == slots->surface[i]);
+	  TEST_CHECK (ref_object[i] == SURFACE (slots->surface[i]));
+	}
+      TEST_CHECK (refresh[i] == (key_frame || i == layer));
+    }
+  TEST_CHECK (!pic->pic_flags.bits.copy_buffer_to_golden &&
+	      !pic->pic_flags.bits.copy_buffer_to_alternate);
+  TEST_CHECK (key_frame || !pic->pic_flags.bits.refresh_entropy_probs);
+
+  /* the frame header says the same */
+  TEST_CHECK_VA (t->vtable.vaSyncSurface (&t->ctx, enc->coded_buf));
+  bo = SURFACE (enc->coded_buf)->bo;
+  TEST_CHECK (media_bo_map (bo, 0) == 0);
+  segment = (struct coded_buffer_segment *) bo->virtual;
+  TEST_CHECK (segment->base.status == 0);
+  parse_frame_header ((BYTE *) bo->virtual + I965_CODEDBUFFER_HEADER_SIZE,
+		      segment->base.size, &hdr);
+  media_bo_unmap (bo);
+  TEST_CHECK (hdr.key_frame == key_frame);
+  for (i = 0; i < VP8_NUM_REFS; i++)
+    TEST_CHECK (hdr.refresh[i] == refresh[i]);
+  TEST_CHECK (hdr.copy_to_golden == 0 && hdr.copy_to_alternate == 0);
+  TEST_CHECK (!hdr.sign_bias_golden && !hdr.sign_bias_alternate);
+  TEST_CHECK (key_frame || !hdr.refresh_entropy_probs);
+
+  for (i = 0; i < VP8_NUM_REFS; i++)
+    if (refresh[i])
+      {
+	slots->surface[i] = pic->reconstructed_frame;
+	slots->layer[i] = layer;
+      }
+}
+
+/* pattern is the one the driver should pick from the structure */
+static VOID
+run_structure (TEST_VA * t,
+	       const VAEncMiscParameterTemporalLayerStructure * layers,
+	       const UINT * pattern, UINT periodicity)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = test_va_driver (t);
+  TEST_VP8_ENCODER enc;
+  TEST_SLOTS slots;
+  UINT layers_seen = 0, index = 0, n, i;
+  dri_bo *bo;
+
+  TEST_CHECK_VA (test_vp8_encoder_open (t, &enc, 176, 144,
+					VA_HYBRID_ENCODE_OUTPUT_BITSTREAM));
+  bo = SURFACE (enc.coded_buf)->bo;
+  enc.layers = layers;
+  for (i = 0; i < VP8_NUM_REFS; i++)
+    slots.surface[i] = VA_INVALID_SURFACE;
+
+  for (n = 0; n < NUM_FRAMES; n++)
+    {
+      BOOL key_frame = n == 0 || n == KEY_FRAME_AT;
+
+      /* key frames restart the pattern */
+      if (key_frame)
+	index = 0;
+      enc.next_recon = free_recon (&enc, &slots);
+      /* the kernels do not run on the mock, no MB code from the last
+       * frame's output either */
+      TEST_CHECK (media_bo_map (bo, 1) == 0);
+      memset (bo->virtual, 0, bo->size);
+      media_bo_unmap (bo);
+      TEST_CHECK_VA (test_vp8_encode_frame (t, &enc, key_frame));
+      check_frame (t, &enc, key_frame, pattern[index], &slots);
+      layers_seen |= 1 << pattern[index];
+      index = (index + 1) % periodicity;
+    }
+  TEST_CHECK (layers_seen == (1u << layers->number_of_layers) - 1);
+
+  test_vp8_encoder_close (t, &enc);
+}
+
+int
+main (int argc, char **argv)
+{
+  static const UINT pattern_2[] = { 0, 1 };
+  static const UINT pattern_3[] = { 0, 2, 1, 2 };
+  static const UINT pattern_app[] = { 0, 1, 0, 2, 0, 1 };
+  VAEncMiscParameterTemporalLayerStructure layers;
+  TEST_VA t;
+
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+
+  /* no usable pattern from the application: the defaults */
+  memset (&layers, 0, sizeof (layers));
+  layers.number_of_layers = 2;
+  run_structure (&t, &layers, pattern_2, 2);
+  layers.number_of_layers = 3;
+  run_structure (&t, &layers, pattern_3, 4);
+  /* a pattern that skips a layer is not taken either */
+  layers.periodicity = 2;
+  layers.layer_id[1] = 1;
+  run_structure (&t, &layers, pattern_3, 4);
+
+  /* the application's own */
+  layers.periodicity = ARRAY_ELEMS (pattern_app);
+  memcpy (layers.layer_id, pattern_app, sizeof (pattern_app));
+  run_structure (&t, &layers, pattern_app, ARRAY_ELEMS (pattern_app));
+
+  test_va_close (&t);
+  return 0;
+}
@@ -0,0 +1,377 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * A VP9 frame header writer for the decoder tests: the uncompressed header
+ * bit by bit in syntax order, then a compressed header holding the
+ * transform mode, written with the boolean encoder of libvpx.
+ */
+
+#include <string.h>
+#include "test_va.h"
+
+#define VP9_SYNC_CODE	0x498342
+#define VP9_CS_SRGB	7
+
+typedef struct _test_bits
+{
+  BYTE *buf;
+  UINT size;
+  UINT bit;
+} TEST_BITS;
+
+static VOID
+put_bits (TEST_BITS * b, UINT value, UINT num_bits)
+{
+  while (num_bits--)
+    {
+      UINT byte = b->bit >> 3;
+
+      TEST_CHECK (byte < b->size);
+      if ((b->bit & 7) == 0)
+	b->buf[byte] = 0;
+      b->buf[byte] |= ((value >> num_bits) & 1) << (7 - (b->bit & 7));
+      b->bit++;
+    }
+}
+
+/* su(n): magnitude then sign */
+static VOID
+put_signed (TEST_BITS * b, INT value, UINT num_bits)
+{
+  put_bits (b, value < 0 ? -value : value, num_bits);
+  put_bits (b, value < 0, 1);
+}
+
+static VOID
+put_delta_q (TEST_BITS * b, INT delta)
+{
+  put_bits (b, delta != 0, 1);
+  if (delta != 0)
+    put_signed (b, delta, 4);
+}
+
+typedef struct _test_bool_encoder
+{
+  BYTE *buf;
+  UINT size;
+  UINT pos;
+  UINT low;
+  UINT range;
+  INT count;
+} TEST_BOOL_ENCODER;
+
+static VOID
+bool_write (TEST_BOOL_ENCODER * e, UINT bit, UINT prob)
+{
+  UINT split = 1 + (((e->range - 1) * prob) >> 8);
+  UINT range = bit ? e->range - split : split;
+  UINT low = e->low + (bit ? split : 0);
+  INT shift = 0;
+
+  while ((range << shift) < 128)
+    shift++;
+  range <<= shift;
+  e->count += shift;
+  if (e->count >= 0)
+    {
+      INT offset = shift - e->count;
+
+      if ((low << (offset - 1)) & 0x80000000)
+	{
+	  INT x = e->pos - 1;
+
+	  while (x >= 0 && e->buf[x] == 0xff)
+	    e->buf[x--] = 0;
+	  e->buf[x]++;
+	}
+      TEST_CHECK (e->pos < e->size);
+      e->buf[e->pos++] = (low >> (24 - offset)) & 0xff;
+      low <<= offset;
+      shift = e->count;
+      low &= 0xffffff;
+      e->count -= 8;
+    }
+  e->low = low << shift;
+  e->range = range;
+}
+
+static VOID
+bool_literal (TEST_BOOL_ENCODER * e, UINT value, UINT num_bits)
+{
+  while (num_bits--)
+    bool_write (e, (value >> num_bits) & 1, 128);
+}
+
+static VOID
+put_color_config (TEST_BITS * b, const TEST_VP9_FRAME * f)
+{
+  if (f->profile >= 2)
+    put_bits (b, f->bit_depth == 12, 1);
+  put_bits (b, f->color_space, 3);
+  if (f->color_space != VP9_CS_SRGB)
+    {
+      put_bits (b, 0, 1);	/* color range */
+      if (f->profile == 1 || f->profile == 3)
+	put_bits (b, 0x4, 3);	/* 4:2:2, reserved */
+    }
+  else if (f->profile == 1 || f->profile == 3)
+    put_bits (b, 0, 1);
+}
+
+static VOID
+put_frame_size (TEST_BITS * b, const TEST_VP9_FRAME * f)
+{
+  put_bits (b, f->width - 1, 16);
+  put_bits (b, f->height - 1, 16);
+  put_bits (b, f->render_size, 1);
+  if (f->render_size)
+    {
+      put_bits (b, f->width / 2 - 1, 16);
+      put_bits (b, f->height / 2 - 1, 16);
+    }
+}
+
+VOID
+test_vp9_tile_cols_range (UINT width, UINT * min_log2, UINT * max_log2)
+{
+  UINT sb64_cols = (width + 63) / 64;
+
+  *min_log2 = 0;
+  while ((64u << *min_log2) < sb64_cols)
+    (*min_log2)++;
+  *max_log2 = 1;
+  while ((sb64_cols >> *max_log2) >= 4)
+    (*max_log2)++;
+  (*max_log2)--;
+}
+
+UINT
+test_vp9_write_frame (const TEST_VP9_FRAME * f, BYTE * buf, UINT size)
+{
+  TEST_BITS b = { buf, size, 0 };
+  TEST_BOOL_ENCODER e;
+  UINT header_size_pos, header_bytes, min_log2, max_log2, i, j;
+  BOOL lossless;
+
+  put_bits (&b, 2, 2);		/* frame marker */
+  put_bits (&b, f->profile & 1, 1);
+  put_bits (&b, f->profile >> 1, 1);
+  if (f->profile == 3)
+    put_bits (&b, 0, 1);
+  put_bits (&b, f->show_existing_frame, 1);
+  if (f->show_existing_frame)
+    {
+      put_bits (&b, f->frame_to_show, 3);
+      return (b.bit + 7) >> 3;
+    }
+
+  put_bits (&b, !f->key_frame, 1);
+  put_bits (&b, f->show_frame, 1);
+  put_bits (&b, f->error_resilient, 1);
+  if (f->key_frame)
+    {
+      put_bits (&b, VP9_SYNC_CODE, 24);
+      put_color_config (&b, f);
+      put_frame_size (&b, f);
+    }
+  else
+    {
+      if (!f->show_frame)
+	put_bits (&b, f->intra_only, 1);
+      if (!f->error_resilient)
+	put_bits (&b, 0, 2);	/* reset frame context */
+      if (f->intra_only)
+	{
+	  put_bits (&b, VP9_SYNC_CODE, 24);
+	  if (f->profile > 0)
+	    put_color_config (&b, f);
+	  put_bits (&b, f->refresh_frame_flags, 8);
+	  put_frame_size (&b, f);
+	}
+      else
+	{
+	  put_bits (&b, f->refresh_frame_flags, 8);
+	  for (i = 0; i < 3; i++)
+	    {
+	      put_bits (&b, f->ref_frame_idx[i], 3);
+	      put_bits (&b, i == 2, 1);	/* sign bias */
+	    }
+	  for (i = 0; i < 3; i++)
+	    {
+	      put_bits (&b, (INT) i == f->size_from_ref, 1);
+	      if ((INT) i == f->size_from_ref)
+		break;
+	    }
+	  if (i == 3)
+	    put_frame_size (&b, f);
+	  else
+	    {
+	      put_bits (&b, f->render_size, 1);
+	      if (f->render_size)
+		put_bits (&b, 0, 32);
+	    }
+	  put_bits (&b, 1, 1);	/* allow high precision mv */
+	  put_bits (&b, f->interp_filter == 4, 1);
+	  if (f->interp_filter != 4)
+	    put_bits (&b, f->interp_filter, 2);
+	}
+    }
+
+  if (!f->error_resilient)
+    put_bits (&b, 0x2, 2);	/* refresh frame context, not parallel */
+  put_bits (&b, f->frame_context_idx, 2);
+
+  /* loop filter */
+  put_bits (&b, f->filter_level, 6);
+  put_bits (&b, f->sharpness, 3);
+  put_bits (&b, f->lf_deltas, 1);
+  if (f->lf_deltas)
+    {
+      put_bits (&b, 1, 1);
+      for (i = 0; i < 4 + 2; i++)
+	{
+	  put_bits (&b, i & 1, 1);
+	  if (i & 1)
+	    put_signed (&b, (INT) i - 3, 6);
+	}
+    }
+
+  /* quantization */
+  put_bits (&b, f->base_q_idx, 8);
+  put_delta_q (&b, f->delta_q_y_dc);
+  put_delta_q (&b, f->delta_q_uv_dc);
+  put_delta_q (&b, f->delta_q_uv_ac);
+  lossless = f->base_q_idx == 0 && f->delta_q_y_dc == 0
+    && f->delta_q_uv_dc == 0 && f->delta_q_uv_ac == 0;
+
+  /* segmentation: every optional part present */
+  put_bits (&b, f->segmentation, 1);
+  if (f->segmentation)
+    {
+      put_bits (&b, 1, 1);	/* update map */
+      for (i = 0; i < 7; i++)
+	{
+	  put_bits (&b, i & 1, 1);
+	  if (i & 1)
+	    put_bits (&b, 100 + i, 8);
+	}
+      put_bits (&b, 1, 1);	/* temporal update */
+      for (i = 0; i < 3; i++)
+	{
+	  put_bits (&b, 1, 1);
+	  put_bits (&b, 200 + i, 8);
+	}
+      put_bits (&b, 1, 1);	/* update data */
+      put_bits (&b, 0, 1);	/* delta */
+      for (i = 0; i < 8; i++)
+	for (j = 0; j < 4; j++)
+	  {
+	    static const UINT bits[4] = { 8, 6, 2, 0 };
+	    BOOL enabled = (i + j) % 3 == 0;
+
+	    put_bits (&b, enabled, 1);
+	    if (enabled && bits[j])
+	      put_bits (&b, i, bits[j]);
+	    if (enabled && j < 2)
+	      put_bits (&b, i & 1, 1);
+	  }
+    }
+
+  /* tile info */
+  test_vp9_tile_cols_range (f->width, &min_log2, &max_log2);
+  TEST_CHECK (f->log2_tile_cols >= min_log2 && f->log2_tile_cols <= max_log2);
+  for (i = min_log2; i < f->log2_tile_cols; i++)
+    put_bits (&b, 1, 1);
+  if (f->log2_tile_cols < max_log2)
+    put_bits (&b, 0, 1);
+  put_bits (&b, f->log2_tile_rows > 0, 1);
+  if (f->log2_tile_rows > 0)
+    put_bits (&b, f->log2_tile_rows > 1, 1);
+
+  header_size_pos = b.bit;
+  put_bits (&b, 0, 16);
+  header_bytes = (b.bit + 7) >> 3;
+
+  /* compressed header: marker, then the transform mode */
+  memset (&e, 0, sizeof (e));
+  e.buf = buf + header_bytes;
+  e.size = size - header_bytes;
+  e.range = 255;
+  e.count = -24;
+  bool_write (&e, 0, 128);
+  if (!lossless)
+    {
+      bool_literal (&e, f->tx_mode > 3 ? 3 : f->tx_mode, 2);
+      if (f->tx_mode >= 3)
+	bool_literal (&e, f->tx_mode == 4, 1);
+    }
+  for (i = 0; i < 32; i++)
+    bool_write (&e, 0, 128);
+  if ((e.buf[e.pos - 1] & 0xe0) == 0xc0)
+    e.buf[e.pos++] = 0;
+
+  b.bit = header_size_pos;
+  put_bits (&b, e.pos, 16);
+
+  /* stand-in tile data */
+  TEST_CHECK (header_bytes + e.pos + f->tile_bytes <= size);
+  for (i = 0; i < f->tile_bytes; i++)
+    buf[header_bytes + e.pos + i] = (BYTE) (i * 7 + 1);
+
+  return header_bytes + e.pos + f->tile_bytes;
+}
+
+UINT
+test_vp9_write_tiled_frame (const TEST_VP9_FRAME * f, UINT tile_bytes,
+			    UINT seed, BYTE * buf, UINT size)
+{
+  TEST_VP9_FRAME header = *f;
+  UINT num_tiles = (1 << f->log2_tile_cols) << f->log2_tile_rows;
+  UINT tile_size = tile_bytes / num_tiles + 1;
+  UINT pos, i, j;
+
+  header.tile_bytes = 0;
+  pos = test_vp9_write_frame (&header, buf, size);
+  for (i = 0; i < num_tiles; i++)
+    {
+      TEST_CHECK (pos + 4 + tile_size <= size);
+      if (i < num_tiles - 1)
+	{
+	  buf[pos++] = tile_size >> 24;
+	  buf[pos++] = tile_size >> 16;
+	  buf[pos++] = tile_size >> 8;
+	  buf[pos++] = tile_size;
+	}
+      for (j = 0; j < tile_size; j++)
+	{
+	  seed = seed * 1103515245 + 12345;
+	  buf[pos++] = seed >> 16;
+	}
+      /* the first bool of a tile is its marker and must be 0 */
+      buf[pos - tile_size] &= 0x7f;
+    }
+  return pos;
+}
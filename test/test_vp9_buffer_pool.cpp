@@ -0,0 +1,274 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * The size-class pool of the VP9 decoder: host blocks are found again by
+ * address, the cache stays under a limit that follows the largest working
+ * set, idle blocks age out, and concurrent users keep the books balanced.
+ * The bo flavour runs on the CPU mock.
+ */
+
+#include <stdlib.h>
+#include <malloc.h>
+#include <pthread.h>
+#include "test_va.h"
+#include "intel_hybrid_vp9_buffer_pool.h"
+
+#define NUM_BUFFERS	200
+#define NUM_THREADS	4
+
+static size_t
+random_size (unsigned int *seed)
+{
+  return 1 + rand_r (seed) % (512 * 1024);
+}
+
+static VOID
+check_idle (PINTEL_HYBRID_VP9_BUFFER_POOL pool)
+{
+  INTEL_HYBRID_VP9_POOL_STATS stats;
+
+  Intel_HybridVp9_BufferPool_GetStats (pool, &stats);
+  TEST_CHECK (stats.InUseBytes == 0);
+  TEST_CHECK (stats.dwAcquires == stats.dwReleases);
+  TEST_CHECK (stats.dwAcquires == stats.dwHits + stats.dwMisses);
+  TEST_CHECK (stats.CachedBytes <= stats.MaxCachedBytes);
+}
+
+static VOID
+test_class_size (VOID)
+{
+  size_t size, class_size, prev = 0;
+
+  for (size = 1; size < 64 * 1024 * 1024; size += size / 3 + 1)
+    {
+      class_size = Intel_HybridVp9_BufferPool_ClassSize (size);
+      TEST_CHECK (class_size >= size);
+      TEST_CHECK (class_size % INTEL_HYBRID_VP9_POOL_PAGE_SIZE == 0);
+      /* 4 classes per power of two waste at most a quarter */
+      TEST_CHECK (class_size <= INTEL_HYBRID_VP9_POOL_PAGE_SIZE
+		  || class_size - size < class_size / 4 + INTEL_HYBRID_VP9_POOL_PAGE_SIZE);
+      TEST_CHECK (class_size >= prev);
+      prev = class_size;
+    }
+}
+
+static VOID
+test_host (VOID)
+{
+  INTEL_HYBRID_VP9_BUFFER_POOL pool;
+  INTEL_HYBRID_VP9_POOL_STATS stats;
+  void *buffers[NUM_BUFFERS];
+  size_t sizes[NUM_BUFFERS];
+  unsigned int seed = 1;
+  void *foreign;
+  INT i, j;
+
+  TEST_CHECK_VA (Intel_HybridVp9_BufferPool_Init (&pool, NULL));
+  for (i = 0; i < NUM_BUFFERS; i++)
+    {
+      sizes[i] = random_size (&seed);
+      buffers[i] = Intel_HybridVp9_BufferPool_AllocHost (&pool, sizes[i]);
+      TEST_CHECK (buffers[i] != NULL);
+      TEST_CHECK (((uintptr_t) buffers[i] & (INTEL_HYBRID_VP9_POOL_PAGE_SIZE - 1)) == 0);
+      memset (buffers[i], i, sizes[i]);
+    }
+
+  /* a buffer the pool doesn't know goes back to the system */
+  foreign = memalign (INTEL_HYBRID_VP9_POOL_PAGE_SIZE, 4096);
+  Intel_HybridVp9_BufferPool_FreeHost (&pool, foreign);
+
+  /* free in a shuffled order; each buffer must still hold its own bytes */
+  for (i = NUM_BUFFERS - 1; i > 0; i--)
+    {
+      void *buffer = buffers[i];
+      size_t size = sizes[i];
+
+      j = rand_r (&seed) % (i + 1);
+      buffers[i] = buffers[j];
+      sizes[i] = sizes[j];
+      buffers[j] = buffer;
+      sizes[j] = size;
+    }
+  for (i = 0; i < NUM_BUFFERS; i++)
+    Intel_HybridVp9_BufferPool_FreeHost (&pool, buffers[i]);
+  check_idle (&pool);
+
+  /* the same working set again is served from the cache */
+  Intel_HybridVp9_BufferPool_GetStats (&pool, &stats);
+  TEST_CHECK (stats.MaxCachedBytes == stats.PeakInUseBytes * INTEL_HYBRID_VP9_POOL_CACHED_WORKING_SETS);
+  for (i = 0; i < NUM_BUFFERS; i++)
+    buffers[i] = Intel_HybridVp9_BufferPool_AllocHost (&pool, sizes[i]);
+  for (i = 0; i < NUM_BUFFERS; i++)
+    Intel_HybridVp9_BufferPool_FreeHost (&pool, buffers[i]);
+  Intel_HybridVp9_BufferPool_GetStats (&pool, &stats);
+  TEST_CHECK (stats.dwHits == NUM_BUFFERS);
+  TEST_CHECK (stats.dwTrimmed == 0);
+  check_idle (&pool);
+
+  /* blocks idle for longer than the window are returned */
+  for (i = 0; i <= INTEL_HYBRID_VP9_POOL_IDLE_FRAMES; i++)
+    Intel_HybridVp9_BufferPool_Tick (&pool);
+  Intel_HybridVp9_BufferPool_GetStats (&pool, &stats);
+  TEST_CHECK (stats.CachedBytes == 0);
+  TEST_CHECK (stats.dwTrimmed == stats.dwMisses);
+  Intel_HybridVp9_BufferPool_Destroy (&pool);
+}
+
+static VOID
+test_cache_limit (VOID)
+{
+  INTEL_HYBRID_VP9_BUFFER_POOL pool;
+  INTEL_HYBRID_VP9_POOL_STATS stats;
+  void *buffers[NUM_BUFFERS];
+  INT i, round;
+
+  TEST_CHECK_VA (Intel_HybridVp9_BufferPool_Init (&pool, NULL));
+  Intel_HybridVp9_BufferPool_GetStats (&pool, &stats);
+  TEST_CHECK (stats.MaxCachedBytes == INTEL_HYBRID_VP9_POOL_MIN_CACHED_SIZE);
+
+  /* 40MB in flight: the limit grows to two such working sets */
+  for (i = 0; i < 40; i++)
+    buffers[i] = Intel_HybridVp9_BufferPool_AllocHost (&pool, 1024 * 1024);
+  for (i = 0; i < 40; i++)
+    Intel_HybridVp9_BufferPool_FreeHost (&pool, buffers[i]);
+  Intel_HybridVp9_BufferPool_GetStats (&pool, &stats);
+  TEST_CHECK (stats.MaxCachedBytes == 80 * 1024 * 1024);
+  TEST_CHECK (stats.CachedBytes == 40 * 1024 * 1024);
+  TEST_CHECK (stats.dwTrimmed == 0);
+
+  /* sizes the cache can't serve push the oldest blocks out */
+  for (round = 0; round < 4; round++)
+    {
+      size_t size = (3 + round) * 1024 * 1024;
+
+      for (i = 0; i < 10; i++)
+	buffers[i] = Intel_HybridVp9_BufferPool_AllocHost (&pool, size);
+      for (i = 0; i < 10; i++)
+	Intel_HybridVp9_BufferPool_FreeHost (&pool, buffers[i]);
+      Intel_HybridVp9_BufferPool_Tick (&pool);
+      check_idle (&pool);
+    }
+  Intel_HybridVp9_BufferPool_GetStats (&pool, &stats);
+  TEST_CHECK (stats.dwTrimmed > 0);
+  TEST_CHECK (stats.MaxCachedBytes == stats.PeakInUseBytes * INTEL_HYBRID_VP9_POOL_CACHED_WORKING_SETS);
+  Intel_HybridVp9_BufferPool_Destroy (&pool);
+}
+
+static void *
+thread_main (void *arg)
+{
+  PINTEL_HYBRID_VP9_BUFFER_POOL pool = (PINTEL_HYBRID_VP9_BUFFER_POOL) arg;
+  unsigned int seed = (unsigned int) (uintptr_t) pthread_self ();
+  unsigned char *buffers[8] = { NULL };
+  size_t sizes[8] = { 0 };
+  INT i, slot;
+
+  for (i = 0; i < 4000; i++)
+    {
+      slot = rand_r (&seed) % 8;
+      if (buffers[slot])
+	{
+	  TEST_CHECK (buffers[slot][sizes[slot] - 1] == (unsigned char) slot);
+	  Intel_HybridVp9_BufferPool_FreeHost (pool, buffers[slot]);
+	  buffers[slot] = NULL;
+	}
+      else
+	{
+	  sizes[slot] = random_size (&seed);
+	  buffers[slot] = (unsigned char *)
+	    Intel_HybridVp9_BufferPool_AllocHost (pool, sizes[slot]);
+	  TEST_CHECK (buffers[slot] != NULL);
+	  buffers[slot][sizes[slot] - 1] = (unsigned char) slot;
+	}
+      if (i % 64 == 0)
+	Intel_HybridVp9_BufferPool_Tick (pool);
+    }
+  for (slot = 0; slot < 8; slot++)
+    Intel_HybridVp9_BufferPool_FreeHost (pool, buffers[slot]);
+  return NULL;
+}
+
+static VOID
+test_threads (VOID)
+{
+  INTEL_HYBRID_VP9_BUFFER_POOL pool;
+  pthread_t threads[NUM_THREADS];
+  INT i;
+
+  TEST_CHECK_VA (Intel_HybridVp9_BufferPool_Init (&pool, NULL));
+  for (i = 0; i < NUM_THREADS; i++)
+    TEST_CHECK (pthread_create (&threads[i], NULL, thread_main, &pool) == 0);
+  for (i = 0; i < NUM_THREADS; i++)
+    pthread_join (threads[i], NULL);
+  check_idle (&pool);
+  Intel_HybridVp9_BufferPool_Destroy (&pool);
+}
+
+static VOID
+test_bo (TEST_VA * t)
+{
+  dri_bufmgr *bufmgr = test_va_bufmgr (t);
+  INTEL_HYBRID_VP9_BUFFER_POOL pool;
+  INTEL_HYBRID_VP9_POOL_STATS stats;
+  PINTEL_HYBRID_VP9_POOL_BLOCK block, again;
+  UINT bos;
+
+  bos = media_bufmgr_mock_num_bos (bufmgr);
+  TEST_CHECK_VA (Intel_HybridVp9_BufferPool_Init (&pool, &t->ctx));
+  block = Intel_HybridVp9_BufferPool_Acquire (&pool, INTEL_HYBRID_VP9_POOL_BO, 100000);
+  TEST_CHECK (block != NULL && block->bo != NULL && block->pBuffer != NULL);
+  TEST_CHECK (block->bo->size >= Intel_HybridVp9_BufferPool_ClassSize (100000));
+  Intel_HybridVp9_BufferPool_Release (&pool, block);
+
+  /* a host request never gets a cached bo */
+  Intel_HybridVp9_BufferPool_FreeHost (&pool,
+				       Intel_HybridVp9_BufferPool_AllocHost (&pool, 100000));
+  again = Intel_HybridVp9_BufferPool_Acquire (&pool, INTEL_HYBRID_VP9_POOL_BO, 90000);
+  TEST_CHECK (again == block);
+  Intel_HybridVp9_BufferPool_Release (&pool, again);
+  Intel_HybridVp9_BufferPool_GetStats (&pool, &stats);
+  TEST_CHECK (stats.dwHits == 1 && stats.dwMisses == 2);
+  check_idle (&pool);
+
+  Intel_HybridVp9_BufferPool_Destroy (&pool);
+  TEST_CHECK (media_bufmgr_mock_num_bos (bufmgr) == bos);
+}
+
+int
+main (int argc, char **argv)
+{
+  TEST_VA t;
+
+  test_class_size ();
+  test_host ();
+  test_cache_limit ();
+  test_threads ();
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+  test_bo (&t);
+  test_va_close (&t);
+  return 0;
+}
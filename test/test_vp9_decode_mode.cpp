@@ -0,0 +1,289 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * The key frame only decode mode: the config attribute is reported for
+ * VP9 decode only, and HostVLD writes the same planes for a key frame
+ * whether it parsed the inter frames before it or, with context
+ * adaptation off, saw nothing but key frames. Through the VA entry points
+ * on the mock CM runtime, the inter frames of a GOP are dropped unparsed
+ * and their render targets are left as they were.
+ */
+
+#include <stdlib.h>
+#include "test_vp9_hostvld.h"
+#include "test_cmrt.h"
+#include "media_drv_surface.h"
+
+#define GOP_SIZE	6
+#define NUM_FRAMES	(GOP_SIZE * 8)
+#define MAX_FRAME_SIZE	(64 * 1024)
+
+static VOID
+test_attributes (TEST_VA * t)
+{
+  VAConfigAttrib attrib;
+  VAConfigID config;
+
+  attrib.type = VAConfigAttribHybridDecodeMode;
+  TEST_CHECK_VA (t->vtable.vaGetConfigAttributes (&t->ctx,
+						  VAProfileVP9Profile0,
+						  VAEntrypointVLD, &attrib,
+						  1));
+  TEST_CHECK (attrib.value == (VA_HYBRID_DECODE_MODE_NORMAL |
+			       VA_HYBRID_DECODE_MODE_KEYFRAME_ONLY));
+  TEST_CHECK_VA (t->vtable.vaGetConfigAttributes (&t->ctx,
+						  VAProfileVP8Version0_3,
+						  VAEntrypointEncSlice,
+						  &attrib, 1));
+  TEST_CHECK (attrib.value == VA_ATTRIB_NOT_SUPPORTED);
+
+  attrib.value = VA_HYBRID_DECODE_MODE_KEYFRAME_ONLY;
+  TEST_CHECK_VA (t->vtable.vaCreateConfig (&t->ctx, VAProfileVP9Profile0,
+					   VAEntrypointVLD, &attrib, 1,
+					   &config));
+  TEST_CHECK_VA (t->vtable.vaDestroyConfig (&t->ctx, config));
+}
+
+static VOID
+make_frame (UINT n, TEST_VP9_FRAME * f)
+{
+  UINT min_log2, max_log2;
+
+  memset (f, 0, sizeof (*f));
+  f->width = 704;
+  f->height = 480;
+  f->key_frame = n % GOP_SIZE == 0;
+  f->show_frame = TRUE;
+  f->refresh_frame_flags = f->key_frame ? 0xff : 1 << (n % 3);
+  f->ref_frame_idx[0] = 0;
+  f->ref_frame_idx[1] = 1;
+  f->ref_frame_idx[2] = 2;
+  f->size_from_ref = 0;
+  f->interp_filter = n % 5;
+  f->error_resilient = n % 7 == 5;
+  f->frame_context_idx = n % 4;
+  f->filter_level = 8 + n % 24;
+  f->sharpness = n % 8;
+  f->lf_deltas = n & 1;
+  f->base_q_idx = 20 + (n * 37) % 200;
+  f->tx_mode = n % 5;
+  test_vp9_tile_cols_range (f->width, &min_log2, &max_log2);
+  f->log2_tile_cols = min_log2 + n % (max_log2 - min_log2 + 1);
+  f->log2_tile_rows = n % 3;
+
+  /* a hidden intra only frame in some of the groups */
+  if (n % (2 * GOP_SIZE) == 3)
+    {
+      f->intra_only = TRUE;
+      f->show_frame = FALSE;
+      f->error_resilient = FALSE;
+    }
+}
+
+static VOID
+test_key_frame_output (void)
+{
+  static BYTE data[MAX_FRAME_SIZE];
+  unsigned long long hash[NUM_FRAMES / GOP_SIZE];
+  TEST_HOSTVLD normal, key_only;
+  TEST_VP9_FRAME f;
+  UINT n, size, i;
+
+  TEST_CHECK (test_hostvld_open (&normal, FALSE));
+  normal.clear_planes = TRUE;
+  for (n = 0; n < NUM_FRAMES; n++)
+    {
+      make_frame (n, &f);
+      size = test_vp9_write_tiled_frame (&f, f.key_frame ? 24000 : 6000, n,
+					 data, sizeof (data));
+      TEST_CHECK_VA (test_hostvld_decode (&normal, &f, data, size));
+      if (f.key_frame)
+	hash[n / GOP_SIZE] = test_hostvld_hash (&normal);
+    }
+  test_hostvld_close (&normal);
+
+  /* different tile data gives different planes */
+  for (i = 1; i < NUM_FRAMES / GOP_SIZE; i++)
+    TEST_CHECK (hash[i] != hash[i - 1]);
+
+  TEST_CHECK (test_hostvld_open (&key_only, TRUE));
+  key_only.clear_planes = TRUE;
+  for (n = 0; n < NUM_FRAMES; n += GOP_SIZE)
+    {
+      make_frame (n, &f);
+      size = test_vp9_write_tiled_frame (&f, 24000, n, data, sizeof (data));
+      TEST_CHECK_VA (test_hostvld_decode (&key_only, &f, data, size));
+      TEST_CHECK (test_hostvld_hash (&key_only) == hash[n / GOP_SIZE]);
+    }
+
+  /* a tile with its marker bit set fails the frame before the loop filter */
+  make_frame (0, &f);
+  size = test_vp9_write_tiled_frame (&f, 24000, 0, data, sizeof (data));
+  data[size - (24000 >> (f.log2_tile_cols + f.log2_tile_rows)) - 1] |= 0x80;
+  TEST_CHECK (test_hostvld_decode (&key_only, &f, data, size)
+	      != VA_STATUS_SUCCESS);
+  test_hostvld_close (&key_only);
+}
+
+/* what a decode may change about a surface */
+typedef struct _surface_state
+{
+  dri_bo *bo;
+  VOID *private_data;
+  unsigned long long hash;
+} SURFACE_STATE;
+
+static VOID
+get_surface_state (TEST_VA * t, VASurfaceID surface, SURFACE_STATE * state)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = test_va_driver (t);
+  struct object_surface *obj_surface = SURFACE (surface);
+  UINT i;
+
+  state->bo = obj_surface->bo;
+  state->private_data = obj_surface->private_data;
+  state->hash = 14695981039346656037ULL;
+  if (!state->bo)
+    return;
+  TEST_CHECK (media_bo_map (state->bo, 0) == 0);
+  for (i = 0; i < state->bo->size; i++)
+    state->hash = (state->hash ^ ((BYTE *) state->bo->virt)[i]) *
+      1099511628211ULL;
+  media_bo_unmap (state->bo);
+}
+
+/* marks whatever storage the surface already has */
+static VOID
+fill_surface (TEST_VA * t, VASurfaceID surface, UINT seed)
+{
+  MEDIA_DRV_CONTEXT *drv_ctx = test_va_driver (t);
+  struct object_surface *obj_surface = SURFACE (surface);
+  UINT i;
+
+  if (!obj_surface->bo)
+    return;
+  TEST_CHECK (media_bo_map (obj_surface->bo, 1) == 0);
+  for (i = 0; i < obj_surface->bo->size; i++)
+    ((BYTE *) obj_surface->bo->virt)[i] = i * 7 + seed;
+  media_bo_unmap (obj_surface->bo);
+}
+
+/*
+ * A GOP frame with two tile rows. Inter frames get the size marker bit
+ * of their first tile set, which fails them if they are parsed.
+ */
+static UINT
+make_gop_frame (UINT n, TEST_VP9_FRAME * f, BYTE * data)
+{
+  UINT size;
+
+  memset (f, 0, sizeof (*f));
+  f->width = 352;
+  f->height = 288;
+  f->key_frame = n % GOP_SIZE == 0;
+  f->show_frame = TRUE;
+  f->refresh_frame_flags = f->key_frame ? 0xff : 1 << (n % 3);
+  f->ref_frame_idx[1] = 1;
+  f->ref_frame_idx[2] = 2;
+  f->size_from_ref = 0;
+  f->interp_filter = 4;
+  f->filter_level = 20;
+  f->base_q_idx = 60;
+  f->tx_mode = 4;
+  f->log2_tile_rows = 1;
+  size = test_vp9_write_tiled_frame (f, f->key_frame ? 24000 : 6000, n,
+				     data, MAX_FRAME_SIZE);
+  if (!f->key_frame)
+    data[size - (6000 >> 1) - 1] |= 0x80;
+  return size;
+}
+
+static VOID
+test_va_key_frames_only (TEST_VA * t)
+{
+  static BYTE data[MAX_FRAME_SIZE];
+  SURFACE_STATE before[TEST_VP9_NUM_SURFACES], after;
+  TEST_VP9_DECODER dec;
+  TEST_CMRT_STATS stats;
+  TEST_VP9_FRAME f;
+  UINT n, size, i, dropped = 0;
+
+  /* decoding the inter frames would fail them */
+  TEST_CHECK_VA (test_vp9_decoder_open (t, &dec, 352, 288,
+					VA_HYBRID_DECODE_MODE_NORMAL));
+  size = make_gop_frame (0, &f, data);
+  TEST_CHECK_VA (test_vp9_decode_frame (t, &dec, &f, data, size));
+  size = make_gop_frame (1, &f, data);
+  TEST_CHECK (test_vp9_decode_frame (t, &dec, &f, data, size)
+	      != VA_STATUS_SUCCESS);
+  test_vp9_decoder_close (t, &dec);
+
+  TEST_CHECK_VA (test_vp9_decoder_open (t, &dec, 352, 288,
+					VA_HYBRID_DECODE_MODE_KEYFRAME_ONLY));
+  for (i = 0; i < TEST_VP9_NUM_SURFACES; i++)
+    fill_surface (t, dec.surfaces[i], i);
+  for (n = 0; n < 3 * GOP_SIZE; n++)
+    {
+      for (i = 0; i < TEST_VP9_NUM_SURFACES; i++)
+	get_surface_state (t, dec.surfaces[i], &before[i]);
+      size = make_gop_frame (n, &f, data);
+      test_cmrt_reset_stats ();
+      TEST_CHECK_VA (test_vp9_decode_frame (t, &dec, &f, data, size));
+      test_cmrt_get_stats (&stats);
+
+      for (i = 0; dec.surfaces[i] != dec.target; i++)
+	;
+      get_surface_state (t, dec.target, &after);
+      if (f.key_frame)
+	{
+	  TEST_CHECK (stats.enqueues > 0);
+	  TEST_CHECK (after.bo != NULL && after.private_data != NULL);
+	  continue;
+	}
+      TEST_CHECK (stats.enqueues == 0 && stats.surfaces == 0);
+      TEST_CHECK (after.bo == before[i].bo);
+      TEST_CHECK (after.private_data == before[i].private_data);
+      TEST_CHECK (after.hash == before[i].hash);
+      dropped++;
+    }
+  TEST_CHECK (dropped == 3 * (GOP_SIZE - 1));
+  test_vp9_decoder_close (t, &dec);
+}
+
+int
+main (int argc, char **argv)
+{
+  TEST_VA t;
+
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+  test_cmrt_enable ();
+  test_attributes (&t);
+  test_va_key_frames_only (&t);
+  test_va_close (&t);
+  test_key_frame_output ();
+  return 0;
+}
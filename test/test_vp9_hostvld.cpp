@@ -0,0 +1,306 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * HostVLD driven without the MDF host, see test_vp9_hostvld.h. The plane
+ * sizes follow Intel_HybridVp9Decode_MdfHost_PlanLayout; the 2D planes
+ * get a 64 byte pitch where the CM runtime would pick its own.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_vp9_hostvld.h"
+
+#define TEST_ALIGN(x, a)	(((x) + (a) - 1) & ~((a) - 1))
+#define NUM_PLANES		24
+
+typedef struct _test_plane
+{
+  void **buffer;
+  UINT bytes;
+} TEST_PLANE;
+
+static VOID
+plane_1d (TEST_PLANE ** plane, INTEL_HOSTVLD_VP9_1D_BUFFER * buffer,
+	  UINT elements, UINT bpp)
+{
+  buffer->dwSize = elements;
+  (*plane)->buffer = &buffer->pBuffer;
+  (*plane)->bytes = elements * bpp;
+  (*plane)++;
+}
+
+static VOID
+plane_2d (TEST_PLANE ** plane, INTEL_HOSTVLD_VP9_2D_BUFFER * buffer,
+	  UINT width, UINT height)
+{
+  buffer->dwWidth = width;
+  buffer->dwHeight = height;
+  buffer->dwPitch = TEST_ALIGN (width, 64);
+  /* like the padded CM surfaces: a block crossing the bottom of the frame
+     is written whole */
+  buffer->dwSize = buffer->dwPitch * TEST_ALIGN (height, 8);
+  (*plane)->buffer = (void **) &buffer->pu8Buffer;
+  (*plane)->bytes = buffer->dwSize;
+  (*plane)++;
+}
+
+/* Points planes at every buffer of out, sized for a width x height frame. */
+static VOID
+get_planes (INTEL_HOSTVLD_VP9_OUTPUT_BUFFER * out, UINT width, UINT height,
+	    TEST_PLANE * planes)
+{
+  UINT w = TEST_ALIGN (width, 64), h = TEST_ALIGN (height, 64);
+  UINT w8 = width >> 3, h8 = height >> 3;
+  TEST_PLANE *p = planes;
+
+  plane_1d (&p, &out->TransformCoeff[INTEL_HOSTVLD_VP9_YUV_PLANE_Y],
+	    w * h, sizeof (uint16_t));
+  plane_1d (&p, &out->TransformCoeff[INTEL_HOSTVLD_VP9_YUV_PLANE_U],
+	    (w >> 1) * (h >> 1), sizeof (uint16_t));
+  plane_1d (&p, &out->TransformCoeff[INTEL_HOSTVLD_VP9_YUV_PLANE_V],
+	    (w >> 1) * (h >> 1), sizeof (uint16_t));
+  plane_1d (&p, &out->TransformSize[INTEL_HOSTVLD_VP9_YUV_PLANE_Y],
+	    (w >> 3) * (h >> 3), 1);
+  plane_1d (&p, &out->TransformSize[INTEL_HOSTVLD_VP9_YUV_PLANE_UV],
+	    (w >> 3) * (h >> 3), 1);
+  plane_1d (&p, &out->CoeffStatus[INTEL_HOSTVLD_VP9_YUV_PLANE_Y],
+	    (w >> 2) * (h >> 2), 1);
+  plane_1d (&p, &out->CoeffStatus[INTEL_HOSTVLD_VP9_YUV_PLANE_UV],
+	    (w >> 3) * (h >> 3), 1);
+  plane_1d (&p, &out->QP[INTEL_HOSTVLD_VP9_YUV_PLANE_Y],
+	    (w >> 3) * (h >> 3) * 2, sizeof (uint16_t));
+  plane_1d (&p, &out->QP[INTEL_HOSTVLD_VP9_YUV_PLANE_UV],
+	    (w >> 3) * (h >> 3) * 2, sizeof (uint16_t));
+  plane_1d (&p, &out->TransformType, (w >> 2) * (h >> 2), 1);
+  plane_1d (&p, &out->TileIndex, (w >> 5) + 2, 1);
+  plane_1d (&p, &out->PredictionMode[INTEL_HOSTVLD_VP9_YUV_PLANE_Y],
+	    (w >> 2) * (h >> 2), 1);
+  plane_1d (&p, &out->PredictionMode[INTEL_HOSTVLD_VP9_YUV_PLANE_UV],
+	    (w >> 3) * (h >> 3), 1);
+  plane_1d (&p, &out->BlockSize, (w >> 3) * (h >> 3), 1);
+  plane_1d (&p, &out->ReferenceFrame, (w >> 3) * (h >> 3),
+	    sizeof (uint16_t));
+  plane_1d (&p, &out->FilterType, (w >> 3) * (h >> 3), 1);
+  plane_1d (&p, &out->MotionVector, (w >> 2) * (h >> 2), sizeof (uint64_t));
+  plane_2d (&p, &out->VerticalEdgeMask[INTEL_HOSTVLD_VP9_YUV_PLANE_Y],
+	    (w8 + 1) >> 1, h8);
+  plane_2d (&p, &out->VerticalEdgeMask[INTEL_HOSTVLD_VP9_YUV_PLANE_UV],
+	    (w8 + 3) >> 2, (h8 + 1) >> 1);
+  plane_2d (&p, &out->HorizontalEdgeMask[INTEL_HOSTVLD_VP9_YUV_PLANE_Y],
+	    (w8 + 1) >> 1, h8);
+  plane_2d (&p, &out->HorizontalEdgeMask[INTEL_HOSTVLD_VP9_YUV_PLANE_UV],
+	    (w8 + 3) >> 2, (h8 + 1) >> 1);
+  plane_2d (&p, &out->FilterLevel, w8, h8);
+  plane_2d (&p, &out->Threshold, 4, 64);
+  TEST_CHECK (p - planes == NUM_PLANES - 1);
+  p->buffer = NULL;
+}
+
+static VAStatus
+sync_cb (void *state, PINTEL_HOSTVLD_VP9_VIDEO_BUFFER video,
+	 uint32_t curr, uint32_t prev)
+{
+  TEST_HOSTVLD *h = (TEST_HOSTVLD *) state;
+  PINTEL_VP9_PIC_PARAMS pp = video->pVp9PicParams;
+  UINT width = TEST_ALIGN (pp->FrameWidthMinus1 + 1, 8);
+  UINT height = TEST_ALIGN (pp->FrameHeightMinus1 + 1, 8);
+  TEST_PLANE planes[NUM_PLANES], *p;
+
+  TEST_CHECK (curr < h->num_slots && prev < h->num_slots);
+  if (width > h->slot_width[curr] || height > h->slot_height[curr])
+    {
+      get_planes (&h->output[curr], h->slot_width[curr],
+		  h->slot_height[curr], planes);
+      for (p = planes; p->buffer; p++)
+	free (*p->buffer);
+      get_planes (&h->output[curr], width, height, planes);
+      for (p = planes; p->buffer; p++)
+	{
+	  *p->buffer = calloc (p->bytes, 1);
+	  TEST_CHECK (*p->buffer != NULL);
+	}
+      h->slot_width[curr] = width;
+      h->slot_height[curr] = height;
+      video->dwReallocCount++;
+    }
+  else
+    {
+      get_planes (&h->output[curr], h->slot_width[curr],
+		  h->slot_height[curr], planes);
+      for (p = planes; p->buffer; p++)
+	{
+	  /* the driver clears the coefficient status of every frame */
+	  if (h->clear_planes
+	      || *p->buffer ==
+	      h->output[curr].CoeffStatus[INTEL_HOSTVLD_VP9_YUV_PLANE_Y].pBuffer
+	      || *p->buffer ==
+	      h->output[curr].CoeffStatus[INTEL_HOSTVLD_VP9_YUV_PLANE_UV].pBuffer)
+	    memset (*p->buffer, 0, p->bytes);
+	}
+    }
+
+  /* the previous frame's vectors are read in place, not swapped */
+  video->PrevMotionVector = h->output[prev].MotionVector;
+  video->PrevReferenceFrame = h->output[prev].ReferenceFrame;
+  h->last_slot = curr;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+render_cb (void *state, uint32_t curr, uint32_t prev)
+{
+  return VA_STATUS_SUCCESS;
+}
+
+BOOL
+test_hostvld_open (TEST_HOSTVLD * h, BOOL key_frame_only)
+{
+  INTEL_HOSTVLD_VP9_CALLBACKS callbacks;
+  uint32_t num_slots;
+
+  memset (h, 0, sizeof (*h));
+  if (Intel_HybridVp9_BufferPool_Init (&h->pool, NULL) != VA_STATUS_SUCCESS)
+    return FALSE;
+
+  callbacks.pfnHostVldRenderCb = render_cb;
+  callbacks.pfnHostVldSyncCb = sync_cb;
+  callbacks.pvStandardState = h;
+  callbacks.pBufferPool = &h->pool;
+  callbacks.bKeyFrameOnly = key_frame_only;
+  if (Intel_HostvldVp9_Create (&h->handle, &callbacks) != VA_STATUS_SUCCESS)
+    return FALSE;
+  Intel_HostvldVp9_QueryBufferSize (h->handle, &num_slots);
+  TEST_CHECK (num_slots <= TEST_HOSTVLD_MAX_SLOTS);
+  h->num_slots = num_slots;
+  Intel_HostvldVp9_SetOutputBuffer (h->handle, h->output);
+  return TRUE;
+}
+
+VOID
+test_hostvld_close (TEST_HOSTVLD * h)
+{
+  TEST_PLANE planes[NUM_PLANES], *p;
+  UINT i;
+
+  Intel_HostvldVp9_Destroy (h->handle);
+  for (i = 0; i < h->num_slots; i++)
+    {
+      get_planes (&h->output[i], h->slot_width[i], h->slot_height[i],
+		  planes);
+      for (p = planes; p->buffer; p++)
+	free (*p->buffer);
+    }
+  Intel_HybridVp9_BufferPool_Destroy (&h->pool);
+}
+
+VAStatus
+test_hostvld_decode (TEST_HOSTVLD * h, const TEST_VP9_FRAME * f,
+		     BYTE * data, UINT size)
+{
+  INTEL_HOSTVLD_VP9_FRAME_HEADER_INFO info;
+  PINTEL_VP9_PIC_PARAMS pp = &h->pic_params;
+  UINT i, j;
+  VAStatus status;
+
+  /* the header sizes come from the frame, everything else from f */
+  memset (&info, 0, sizeof (info));
+  for (i = 0; i < INTEL_HOSTVLD_VP9_REF_SLOT_NUM; i++)
+    {
+      info.dwRefSlotWidth[i] = f->width;
+      info.dwRefSlotHeight[i] = f->height;
+    }
+  status = Intel_HostvldVp9_PeekFrameHeader (data, size, &info);
+  if (status != VA_STATUS_SUCCESS)
+    return status;
+  TEST_CHECK (f->profile == 0 && !f->show_existing_frame
+	      && !f->segmentation);
+
+  memset (pp, 0, sizeof (*pp));
+  pp->FrameWidthMinus1 = f->width - 1;
+  pp->FrameHeightMinus1 = f->height - 1;
+  pp->PicFlags.fields.frame_type = !f->key_frame;
+  pp->PicFlags.fields.show_frame = f->show_frame;
+  pp->PicFlags.fields.error_resilient_mode = f->error_resilient;
+  pp->PicFlags.fields.intra_only = f->intra_only;
+  pp->PicFlags.fields.LastRefIdx = f->ref_frame_idx[0];
+  pp->PicFlags.fields.GoldenRefIdx = f->ref_frame_idx[1];
+  pp->PicFlags.fields.AltRefIdx = f->ref_frame_idx[2];
+  pp->PicFlags.fields.AltRefSignBias = 1;
+  pp->PicFlags.fields.allow_high_precision_mv = 1;
+  pp->PicFlags.fields.mcomp_filter_type = f->interp_filter;
+  pp->PicFlags.fields.frame_parallel_decoding_mode = f->error_resilient;
+  pp->PicFlags.fields.refresh_frame_context = !f->error_resilient;
+  pp->PicFlags.fields.frame_context_idx = f->frame_context_idx;
+  pp->PicFlags.fields.LosslessFlag = info.bLossless;
+  for (i = 0; i < 8; i++)
+    pp->RefFrameList[i] = i;
+  pp->CurrPic = 8;
+  pp->filter_level = f->filter_level;
+  pp->sharpness_level = f->sharpness;
+  pp->log2_tile_rows = f->log2_tile_rows;
+  pp->log2_tile_columns = f->log2_tile_cols;
+  pp->UncompressedHeaderLengthInBytes = info.dwUncompressedHeaderSize;
+  pp->FirstPartitionSize = info.dwCompressedHeaderSize;
+  memset (pp->SegTreeProbs, 255, sizeof (pp->SegTreeProbs));
+  memset (pp->SegPredProbs, 255, sizeof (pp->SegPredProbs));
+  pp->BSBytesInBuffer = size;
+
+  /* only the quantizer scales reach the output, the values don't matter */
+  memset (&h->seg_params, 0, sizeof (h->seg_params));
+  for (i = 0; i < 4; i++)
+    for (j = 0; j < 2; j++)
+      h->seg_params.SegData[0].FilterLevel[i][j] = f->filter_level;
+  h->seg_params.SegData[0].LumaACQuantScale = 4 + f->base_q_idx * 4;
+  h->seg_params.SegData[0].LumaDCQuantScale = 4 + f->base_q_idx * 3;
+  h->seg_params.SegData[0].ChromaACQuantScale = 4 + f->base_q_idx * 4;
+  h->seg_params.SegData[0].ChromaDCQuantScale = 4 + f->base_q_idx * 3;
+
+  memset (&h->video, 0, sizeof (h->video));
+  h->video.pVp9PicParams = pp;
+  h->video.pVp9SegmentData = &h->seg_params;
+  h->video.pbBitsData = data;
+  h->video.dwBitsSize = size;
+
+  status = Intel_HostvldVp9_Initialize (h->handle, &h->video);
+  if (status == VA_STATUS_SUCCESS)
+    status = Intel_HostvldVp9_Execute (h->handle);
+  return status;
+}
+
+unsigned long long
+test_hostvld_hash (TEST_HOSTVLD * h)
+{
+  TEST_PLANE planes[NUM_PLANES], *p;
+  unsigned long long hash = 0xcbf29ce484222325ull;
+  UINT i;
+
+  get_planes (&h->output[h->last_slot], h->slot_width[h->last_slot],
+	      h->slot_height[h->last_slot], planes);
+  for (p = planes; p->buffer; p++)
+    for (i = 0; i < p->bytes; i++)
+      hash = (hash ^ ((BYTE *) * p->buffer)[i]) * 0x100000001b3ull;
+  return hash;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * HostVLD on its own, for the decoder tests and benchmarks that can't go
+ * through the VA entry points without the CM runtime: the output planes
+ * are plain host memory sized like the MDF host planes, the render
+ * callback does nothing, and the picture parameters are derived from the
+ * TEST_VP9_FRAME the frame was written from.
+ */
+
+#ifndef _TEST_VP9_HOSTVLD_H
+#define _TEST_VP9_HOSTVLD_H
+#include "test_va.h"
+#include "intel_hybrid_hostvld_vp9.h"
+
+#define TEST_HOSTVLD_MAX_SLOTS	4
+
+typedef struct _test_hostvld
+{
+  INTEL_HOSTVLD_VP9_HANDLE handle;
+  INTEL_HYBRID_VP9_BUFFER_POOL pool;
+  INTEL_HOSTVLD_VP9_OUTPUT_BUFFER output[TEST_HOSTVLD_MAX_SLOTS];
+  UINT slot_width[TEST_HOSTVLD_MAX_SLOTS];	/* size the planes fit */
+  UINT slot_height[TEST_HOSTVLD_MAX_SLOTS];
+  UINT num_slots;
+  UINT last_slot;		/* slot of the last decoded frame */
+  BOOL clear_planes;		/* zero every plane before each frame */
+  INTEL_VP9_PIC_PARAMS pic_params;
+  INTEL_VP9_SEGMENT_PARAMS seg_params;
+  INTEL_HOSTVLD_VP9_VIDEO_BUFFER video;
+} TEST_HOSTVLD;
+
+BOOL test_hostvld_open (TEST_HOSTVLD * h, BOOL key_frame_only);
+VOID test_hostvld_close (TEST_HOSTVLD * h);
+
+/* Parses data, written from f, into the planes of the next slot. */
+VAStatus test_hostvld_decode (TEST_HOSTVLD * h, const TEST_VP9_FRAME * f,
+			      BYTE * data, UINT size);
+
+/* FNV-1a over every output plane of the last decoded frame. */
+unsigned long long test_hostvld_hash (TEST_HOSTVLD * h);
+
+#endif
@@ -0,0 +1,136 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * CM objects of the VP9 decoder on the mock CM runtime. Once a frame of
+ * every type has been decoded, frames of the same size create no task
+ * and no thread space. Thread spaces rebuilt for another frame size or
+ * for references of another height are never destroyed under a task
+ * still running.
+ *
+ * The width is not a multiple of 4, so that every reference is padded.
+ */
+
+#include <string.h>
+#include "test_cmrt.h"
+
+#define WIDTH			350
+#define HEIGHT			288
+#define MAX_FRAME_SIZE		(64 * 1024)
+
+static UINT frame_num;
+
+static VOID
+decode (TEST_VA * t, TEST_VP9_DECODER * dec, BOOL key_frame, UINT height,
+	UINT refresh_frame_flags, UINT ref1, UINT ref2)
+{
+  static BYTE data[MAX_FRAME_SIZE];
+  TEST_VP9_FRAME f;
+  UINT size;
+
+  memset (&f, 0, sizeof (f));
+  f.key_frame = key_frame;
+  f.show_frame = TRUE;
+  f.width = WIDTH;
+  f.height = height;
+  f.refresh_frame_flags = refresh_frame_flags;
+  f.ref_frame_idx[1] = ref1;
+  f.ref_frame_idx[2] = ref2;
+  f.size_from_ref = -1;
+  f.interp_filter = 4;
+  f.filter_level = 20;
+  f.base_q_idx = 60;
+  f.tx_mode = 4;
+  size = test_vp9_write_tiled_frame (&f, key_frame ? 24000 : 6000,
+				     frame_num++, data, MAX_FRAME_SIZE);
+  TEST_CHECK_VA (test_vp9_decode_frame (t, dec, &f, data, size));
+}
+
+static VOID
+test_steady_state (TEST_VA * t)
+{
+  TEST_VP9_DECODER dec;
+  TEST_CMRT_STATS stats;
+  UINT i;
+
+  TEST_CHECK_VA (test_vp9_decoder_open (t, &dec, WIDTH, HEIGHT,
+					VA_HYBRID_DECODE_MODE_NORMAL));
+  decode (t, &dec, TRUE, HEIGHT, 0xff, 0, 0);
+  decode (t, &dec, FALSE, HEIGHT, 0x01, 1, 2);
+
+  test_cmrt_reset_stats ();
+  for (i = 0; i < 8; i++)
+    decode (t, &dec, FALSE, HEIGHT, 1 << (i % 3), 1, 2);
+  test_cmrt_get_stats (&stats);
+  TEST_CHECK (stats.enqueues > 0);
+  TEST_CHECK (stats.tasks == 0);
+  TEST_CHECK (stats.thread_spaces == 0);
+  TEST_CHECK (stats.busy_destroys == 0);
+
+  test_vp9_decoder_close (t, &dec);
+}
+
+static VOID
+test_size_changes (TEST_VA * t)
+{
+  TEST_VP9_DECODER dec;
+  TEST_CMRT_STATS stats;
+
+  test_cmrt_reset_stats ();
+  TEST_CHECK_VA (test_vp9_decoder_open (t, &dec, WIDTH, HEIGHT,
+					VA_HYBRID_DECODE_MODE_NORMAL));
+  decode (t, &dec, TRUE, HEIGHT, 0xff, 0, 0);
+
+  /* two new sizes, each predicted from slot 0 only */
+  decode (t, &dec, FALSE, 200, 0x02, 0, 0);
+  decode (t, &dec, FALSE, 240, 0x04, 0, 0);
+  /* pads references of two heights, neither padded yet */
+  decode (t, &dec, FALSE, HEIGHT, 0x01, 1, 2);
+  decode (t, &dec, FALSE, HEIGHT, 0x01, 1, 2);
+
+  test_cmrt_get_stats (&stats);
+  TEST_CHECK (stats.thread_spaces > 0);
+  TEST_CHECK (stats.busy_destroys == 0);
+
+  test_vp9_decoder_close (t, &dec);
+  test_cmrt_get_stats (&stats);
+  TEST_CHECK (stats.busy_destroys == 0);
+  TEST_CHECK (stats.live_tasks == 0 && stats.live_thread_spaces == 0);
+  TEST_CHECK (stats.live_devices == 0);
+}
+
+int
+main (int argc, char **argv)
+{
+  TEST_VA t;
+
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+  test_cmrt_enable ();
+  test_steady_state (&t);
+  test_size_changes (&t);
+  test_va_close (&t);
+  return 0;
+}
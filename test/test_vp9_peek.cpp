@@ -0,0 +1,256 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Intel_HostvldVp9_PeekFrameHeader against frames written from known
+ * fields: random headers of every frame type and profile must read back
+ * exactly, sizes inherited from reference slots resolve only when the
+ * caller knows the slot, and every truncation of a header is rejected
+ * without reading past the buffer.
+ */
+
+#include <stdlib.h>
+#include "test_va.h"
+#include "intel_hybrid_hostvld_vp9.h"
+
+#define NUM_FRAMES	4000
+#define MAX_FRAME_SIZE	1024
+
+static UINT
+random_bits (unsigned int *seed, UINT num_bits)
+{
+  return (UINT) rand_r (seed) & ((1u << num_bits) - 1);
+}
+
+static VOID
+random_frame (unsigned int *seed, TEST_VP9_FRAME * f)
+{
+  UINT min_log2, max_log2, i;
+
+  memset (f, 0, sizeof (*f));
+  f->profile = random_bits (seed, 2);
+  f->key_frame = random_bits (seed, 2) == 0;
+  f->show_frame = random_bits (seed, 1);
+  f->error_resilient = random_bits (seed, 2) == 0;
+  f->intra_only = !f->key_frame && !f->show_frame && random_bits (seed, 1);
+  f->bit_depth = f->profile >= 2 ? (random_bits (seed, 1) ? 12 : 10) : 8;
+  f->color_space = random_bits (seed, 3);
+  f->width = 1 + random_bits (seed, 12);
+  f->height = 1 + random_bits (seed, 12);
+  f->render_size = random_bits (seed, 1) && f->width > 1 && f->height > 1;
+  f->refresh_frame_flags = random_bits (seed, 8);
+  for (i = 0; i < 3; i++)
+    f->ref_frame_idx[i] = random_bits (seed, 3);
+  f->size_from_ref = (INT) random_bits (seed, 2) - 1;
+  if (f->size_from_ref > 2)
+    f->size_from_ref = -1;
+  f->interp_filter = random_bits (seed, 3) % 5;
+  f->frame_context_idx = random_bits (seed, 2);
+  f->filter_level = random_bits (seed, 6);
+  f->sharpness = random_bits (seed, 3);
+  f->lf_deltas = random_bits (seed, 1);
+  f->base_q_idx = random_bits (seed, 1) ? random_bits (seed, 8) : 0;
+  if (random_bits (seed, 1))
+    {
+      f->delta_q_y_dc = (INT) random_bits (seed, 4) - 7;
+      f->delta_q_uv_dc = (INT) random_bits (seed, 4) - 7;
+      f->delta_q_uv_ac = (INT) random_bits (seed, 4) - 7;
+    }
+  f->segmentation = random_bits (seed, 1);
+  test_vp9_tile_cols_range (f->width, &min_log2, &max_log2);
+  f->log2_tile_cols = min_log2 + random_bits (seed, 3) % (max_log2 - min_log2 + 1);
+  f->log2_tile_rows = random_bits (seed, 2) % 3;
+  f->tx_mode = random_bits (seed, 3) % 5;
+  f->tile_bytes = 8 + random_bits (seed, 6);
+}
+
+static VOID
+check_frame (const TEST_VP9_FRAME * f, const BYTE * frame, UINT frame_size,
+	     BOOL slot_known)
+{
+  INTEL_HOSTVLD_VP9_FRAME_HEADER_INFO info;
+  BOOL inter = !f->key_frame && !f->intra_only;
+  BOOL lossless;
+  UINT i;
+
+  memset (&info, 0, sizeof (info));
+  if (inter && f->size_from_ref >= 0 && slot_known)
+    {
+      info.dwRefSlotWidth[f->ref_frame_idx[f->size_from_ref]] = f->width;
+      info.dwRefSlotHeight[f->ref_frame_idx[f->size_from_ref]] = f->height;
+    }
+  TEST_CHECK_VA (Intel_HostvldVp9_PeekFrameHeader (frame, frame_size, &info));
+
+  TEST_CHECK (info.dwProfile == f->profile);
+  TEST_CHECK (!info.bShowExistingFrame);
+  TEST_CHECK (!!info.bKeyFrame == !!f->key_frame);
+  TEST_CHECK (!!info.bIntraOnly == !!f->intra_only);
+  TEST_CHECK (!!info.bShowFrame == !!f->show_frame);
+  TEST_CHECK (!!info.bErrorResilientMode == !!f->error_resilient);
+  if (f->key_frame)
+    TEST_CHECK (info.dwBitDepth == f->bit_depth);
+  else if (f->intra_only)
+    TEST_CHECK (info.dwBitDepth == (f->profile > 0 ? f->bit_depth : 8));
+  else
+    TEST_CHECK (info.dwBitDepth == (f->profile >= 2 ? 0 : 8));
+  TEST_CHECK (info.dwRefreshFrameFlags
+	      == (f->key_frame ? 0xff : f->refresh_frame_flags));
+  if (inter)
+    for (i = 0; i < 3; i++)
+      TEST_CHECK (info.dwRefFrameIdx[i] == f->ref_frame_idx[i]);
+
+  if (inter && f->size_from_ref >= 0 && !slot_known)
+    {
+      /* the tile syntax depends on the width */
+      TEST_CHECK (!info.bSizeKnown);
+      return;
+    }
+
+  lossless = f->base_q_idx == 0 && f->delta_q_y_dc == 0
+    && f->delta_q_uv_dc == 0 && f->delta_q_uv_ac == 0;
+  TEST_CHECK (info.bSizeKnown);
+  TEST_CHECK (info.dwWidth == f->width && info.dwHeight == f->height);
+  TEST_CHECK (info.dwBaseQIndex == f->base_q_idx);
+  TEST_CHECK (!!info.bLossless == lossless);
+  TEST_CHECK (info.dwLog2TileColumns == f->log2_tile_cols);
+  TEST_CHECK (info.dwLog2TileRows == f->log2_tile_rows);
+  TEST_CHECK (info.dwTxMode == (lossless ? 0 : f->tx_mode));
+  TEST_CHECK (info.dwUncompressedHeaderSize + info.dwCompressedHeaderSize
+	      + f->tile_bytes == frame_size);
+}
+
+/* Every prefix that cuts into the headers must be refused, and must not be
+ * read past: each one is copied into a buffer of exactly its size. */
+static VOID
+check_truncations (const BYTE * frame, UINT frame_size)
+{
+  INTEL_HOSTVLD_VP9_FRAME_HEADER_INFO info;
+  UINT headers, size;
+  BYTE *copy;
+
+  memset (&info, 0, sizeof (info));
+  TEST_CHECK_VA (Intel_HostvldVp9_PeekFrameHeader (frame, frame_size, &info));
+  if (!info.bSizeKnown)
+    return;
+  headers = info.dwUncompressedHeaderSize + info.dwCompressedHeaderSize;
+  for (size = 1; size < headers; size++)
+    {
+      copy = (BYTE *) malloc (size);
+      memcpy (copy, frame, size);
+      memset (&info, 0, sizeof (info));
+      TEST_CHECK (Intel_HostvldVp9_PeekFrameHeader (copy, size, &info)
+		  != VA_STATUS_SUCCESS);
+      free (copy);
+    }
+}
+
+static VOID
+test_random_frames (VOID)
+{
+  TEST_VP9_FRAME f;
+  BYTE frame[MAX_FRAME_SIZE];
+  unsigned int seed = 1;
+  UINT frame_size, n;
+
+  for (n = 0; n < NUM_FRAMES; n++)
+    {
+      random_frame (&seed, &f);
+      frame_size = test_vp9_write_frame (&f, frame, sizeof (frame));
+      check_frame (&f, frame, frame_size, TRUE);
+      check_frame (&f, frame, frame_size, FALSE);
+      if (n % 16 == 0)
+	check_truncations (frame, frame_size);
+    }
+}
+
+static VOID
+test_show_existing (VOID)
+{
+  INTEL_HOSTVLD_VP9_FRAME_HEADER_INFO info;
+  TEST_VP9_FRAME f;
+  BYTE frame[4];
+  UINT slot;
+
+  for (slot = 0; slot < 8; slot++)
+    {
+      memset (&f, 0, sizeof (f));
+      f.profile = slot & 3;
+      f.show_existing_frame = TRUE;
+      f.frame_to_show = slot;
+      memset (&info, 0, sizeof (info));
+      TEST_CHECK_VA (Intel_HostvldVp9_PeekFrameHeader
+		     (frame, test_vp9_write_frame (&f, frame, sizeof (frame)),
+		      &info));
+      TEST_CHECK (info.bShowExistingFrame && info.bShowFrame);
+      TEST_CHECK (info.dwFrameToShow == slot);
+      TEST_CHECK (info.dwProfile == f.profile);
+    }
+}
+
+static VOID
+test_invalid (VOID)
+{
+  INTEL_HOSTVLD_VP9_FRAME_HEADER_INFO info;
+  TEST_VP9_FRAME f;
+  BYTE frame[MAX_FRAME_SIZE];
+  UINT frame_size;
+
+  memset (&f, 0, sizeof (f));
+  f.key_frame = TRUE;
+  f.show_frame = TRUE;
+  f.width = 352;
+  f.height = 288;
+  f.base_q_idx = 60;
+  f.tile_bytes = 16;
+  frame_size = test_vp9_write_frame (&f, frame, sizeof (frame));
+
+  memset (&info, 0, sizeof (info));
+  TEST_CHECK (Intel_HostvldVp9_PeekFrameHeader (NULL, frame_size, &info)
+	      == VA_STATUS_ERROR_INVALID_PARAMETER);
+  TEST_CHECK (Intel_HostvldVp9_PeekFrameHeader (frame, 0, &info)
+	      == VA_STATUS_ERROR_INVALID_PARAMETER);
+
+  /* frame marker */
+  frame[0] ^= 0x40;
+  TEST_CHECK (Intel_HostvldVp9_PeekFrameHeader (frame, frame_size, &info)
+	      == VA_STATUS_ERROR_INVALID_PARAMETER);
+  frame[0] ^= 0x40;
+
+  /* sync code, which follows the 6 bits of frame marker to error resilient */
+  frame[1] ^= 0x01;
+  TEST_CHECK (Intel_HostvldVp9_PeekFrameHeader (frame, frame_size, &info)
+	      == VA_STATUS_ERROR_INVALID_PARAMETER);
+  frame[1] ^= 0x01;
+  TEST_CHECK_VA (Intel_HostvldVp9_PeekFrameHeader (frame, frame_size, &info));
+}
+
+int
+main (int argc, char **argv)
+{
+  test_random_frames ();
+  test_show_existing ();
+  test_invalid ();
+  return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright ©  2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * VP9 decode is offered for profile 0 only. The higher profiles are
+ * refused when the config is created, and a profile 2 frame sent to a
+ * profile 0 context fails without breaking the session.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_cmrt.h"
+
+#define MAX_FRAME_SIZE		(64 * 1024)
+
+static VOID
+test_config (TEST_VA * t)
+{
+  VAProfile *profiles;
+  VAEntrypoint *entrypoints;
+  VAConfigAttrib attrib;
+  VAConfigID config;
+  INT num_profiles, num_entrypoints, i, vp9_profiles;
+
+  profiles = malloc (t->ctx.max_profiles * sizeof (*profiles));
+  entrypoints = malloc (t->ctx.max_entrypoints * sizeof (*entrypoints));
+  TEST_CHECK (profiles && entrypoints);
+
+  TEST_CHECK_VA (t->vtable.vaQueryConfigProfiles (&t->ctx, profiles,
+						  &num_profiles));
+  for (i = 0, vp9_profiles = 0; i < num_profiles; i++)
+    {
+      TEST_CHECK (profiles[i] != VAProfileVP9Profile1);
+      TEST_CHECK (profiles[i] != VAProfileVP9Profile2);
+      TEST_CHECK (profiles[i] != VAProfileVP9Profile3);
+      vp9_profiles += profiles[i] == VAProfileVP9Profile0;
+    }
+  TEST_CHECK (vp9_profiles == 1);
+
+  TEST_CHECK (t->vtable.vaQueryConfigEntrypoints (&t->ctx,
+						  VAProfileVP9Profile2,
+						  entrypoints,
+						  &num_entrypoints)
+	      == VA_STATUS_ERROR_UNSUPPORTED_PROFILE);
+  TEST_CHECK (t->vtable.vaCreateConfig (&t->ctx, VAProfileVP9Profile2,
+					VAEntrypointVLD, NULL, 0, &config)
+	      == VA_STATUS_ERROR_UNSUPPORTED_PROFILE);
+
+  attrib.type = VAConfigAttribRTFormat;
+  TEST_CHECK_VA (t->vtable.vaGetConfigAttributes (&t->ctx,
+						  VAProfileVP9Profile0,
+						  VAEntrypointVLD, &attrib,
+						  1));
+  TEST_CHECK (attrib.value == VA_RT_FORMAT_YUV420);
+
+  free (entrypoints);
+  free (profiles);
+}
+
+static UINT
+make_frame (TEST_VP9_FRAME * f, UINT n, UINT profile, BOOL key_frame,
+	    BYTE * data)
+{
+  memset (f, 0, sizeof (*f));
+  f->profile = profile;
+  f->bit_depth = profile >= 2 ? 10 : 8;
+  f->key_frame = key_frame;
+  f->show_frame = TRUE;
+  f->width = 352;
+  f->height = 288;
+  f->refresh_frame_flags = key_frame ? 0xff : 0x01;
+  f->size_from_ref = 0;
+  f->interp_filter = 4;
+  f->filter_level = 20;
+  f->base_q_idx = 60;
+  f->tx_mode = 4;
+  return test_vp9_write_tiled_frame (f, key_frame ? 24000 : 6000, n, data,
+				     MAX_FRAME_SIZE);
+}
+
+static VOID
+test_high_bit_depth_frame (TEST_VA * t)
+{
+  static BYTE data[MAX_FRAME_SIZE];
+  TEST_VP9_DECODER dec;
+  TEST_VP9_FRAME f;
+  UINT size;
+
+  TEST_CHECK_VA (test_vp9_decoder_open (t, &dec, 352, 288,
+					VA_HYBRID_DECODE_MODE_NORMAL));
+  size = make_frame (&f, 0, 0, TRUE, data);
+  TEST_CHECK_VA (test_vp9_decode_frame (t, &dec, &f, data, size));
+
+  size = make_frame (&f, 1, 2, TRUE, data);
+  TEST_CHECK (test_vp9_decode_frame (t, &dec, &f, data, size)
+	      == VA_STATUS_ERROR_UNSUPPORTED_PROFILE);
+
+  /* the references of the 8-bit key frame are still there */
+  size = make_frame (&f, 2, 0, FALSE, data);
+  TEST_CHECK_VA (test_vp9_decode_frame (t, &dec, &f, data, size));
+  test_vp9_decoder_close (t, &dec);
+}
+
+int
+main (int argc, char **argv)
+{
+  TEST_VA t;
+
+  if (!test_va_open (&t))
+    return TEST_SKIP;
+  test_cmrt_enable ();
+  test_config (&t);
+  test_high_bit_depth_frame (&t);
+  test_va_close (&t);
+  return 0;
+}